@@ -48,6 +48,11 @@ struct literal_string {
 	char string[0];
 } __attribute__((packed));
 
+struct set_string_ref {
+	/* Offset of the string from the set data. */
+	uint16_t offset;
+} __attribute__((packed));
+
 enum filter_op {
 	FILTER_OP_UNKNOWN			= 0,
 
@@ -164,6 +169,33 @@ enum filter_op {
 	FILTER_OP_EQ_STAR_GLOB_STRING		= 77,
 	FILTER_OP_NE_STAR_GLOB_STRING		= 78,
 
+	/* set membership: apply to ax, against immediate set */
+	FILTER_OP_IN_S64_SET			= 79,
+	FILTER_OP_IN_STRING_SET			= 80,
+
+	/*
+	 * load immediate literal string without wildcards or escapes,
+	 * and "prefix*" star globbing pattern. Specialized forms of
+	 * FILTER_OP_LOAD_STRING and FILTER_OP_LOAD_STAR_GLOB_STRING.
+	 */
+	FILTER_OP_LOAD_EXACT_STRING		= 81,
+	FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING	= 82,
+
+	/*
+	 * s64 field ref compared to immediate, pushing the result.
+	 * Fused load, load and compare, produced by the optimizer.
+	 */
+	FILTER_OP_FIELD_EQ_IMM_S64		= 83,
+	FILTER_OP_FIELD_NE_IMM_S64		= 84,
+	FILTER_OP_FIELD_GT_IMM_S64		= 85,
+	FILTER_OP_FIELD_LT_IMM_S64		= 86,
+	FILTER_OP_FIELD_GE_IMM_S64		= 87,
+	FILTER_OP_FIELD_LE_IMM_S64		= 88,
+
+	/* integer element of an array or sequence field */
+	FILTER_OP_LOAD_FIELD_REF_INDEX		= 89,
+	FILTER_OP_LOAD_FIELD_REF_INDEX_S64	= 90,
+
 	NR_FILTER_OPS,
 };
 
@@ -197,4 +229,39 @@ struct return_op {
 	filter_opcode_t op;
 } __attribute__((packed));
 
+/*
+ * Element "index" of an array or sequence field. The element type is
+ * filled at link time.
+ */
+struct field_index_ref {
+	/* Initially, symbol offset. After link, field offset. */
+	uint16_t offset;
+	uint32_t index;
+	uint8_t elem_size;	/* In bytes */
+	uint8_t elem_signed;
+	uint8_t elem_reverse;	/* Reverse byte order */
+	uint8_t user;		/* Elements in user space */
+} __attribute__((packed));
+
+/* "field <op> imm", laid out as a load_op of the field ref. */
+struct field_cmp_imm_op {
+	filter_opcode_t op;
+	struct field_ref ref;
+	struct literal_numeric imm;
+} __attribute__((packed));
+
+/*
+ * The set of nr_elem elements follows the instruction, over len bytes.
+ * Elements are sorted in ascending order, without duplicates. S64 sets
+ * are an array of struct literal_numeric. String sets are an array of
+ * struct set_string_ref, followed by the null-terminated strings they
+ * refer to, in strcmp() order.
+ */
+struct set_op {
+	filter_opcode_t op;
+	uint16_t nr_elem;
+	uint16_t len;
+	char data[0];
+} __attribute__((packed));
+
 #endif /* _FILTER_BYTECODE_H */
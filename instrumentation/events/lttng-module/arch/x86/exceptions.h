@@ -7,6 +7,58 @@
 #undef TRACE_SYSTEM
 #define TRACE_SYSTEM x86_exceptions
 
+#ifndef ONCE_LTTNG_EXCEPTIONS_H
+#define ONCE_LTTNG_EXCEPTIONS_H
+
+#include <linux/mm.h>
+#include <linux/sched.h>
+#include <linux/hardirq.h>
+#include <wrapper/file.h>
+
+/*
+ * Summary key of a page fault, with the SUMMARY action: the inode number
+ * of the file mapped at the faulting address, LTTNG_FAULT_ANON for an
+ * anonymous mapping, LTTNG_FAULT_UNRESOLVED when the mapping could not
+ * be looked up: faults never wait for the mmap_sem, so those taken while
+ * it is held for writing, or in interrupt context, are unresolved.
+ */
+#define LTTNG_FAULT_ANON	0ULL
+#define LTTNG_FAULT_UNRESOLVED	(~1ULL)
+
+static inline uint64_t __lttng_fault_mapping(unsigned long address)
+{
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma;
+	uint64_t key = LTTNG_FAULT_UNRESOLVED;
+
+	if (!mm || in_interrupt() || address >= TASK_SIZE)
+		return key;
+	if (!down_read_trylock(&mm->mmap_sem))
+		return key;
+	vma = find_vma(mm, address);
+	if (vma && vma->vm_start <= address) {
+		if (vma->vm_file)
+			key = vma->vm_file->lttng_f_dentry->d_inode->i_ino;
+		else
+			key = LTTNG_FAULT_ANON;
+	}
+	up_read(&mm->mmap_sem);
+	return key;
+}
+
+/*
+ * Summary subkey of a page fault: the process id (at most 22 bits), and
+ * the low byte of the error code as recorded, i.e. the fault type (read,
+ * write, fetch, user, protection).
+ */
+static inline uint32_t __lttng_fault_subkey(unsigned long error_code)
+{
+	return ((uint32_t) task_tgid_nr(current) << 8)
+		| (unsigned char) error_code;
+}
+
+#endif /* ONCE_LTTNG_EXCEPTIONS_H */
+
 LTTNG_TRACEPOINT_EVENT_CLASS(x86_exceptions_class,
 
 	TP_PROTO(unsigned long address, struct pt_regs *regs,
@@ -24,6 +76,8 @@ LTTNG_TRACEPOINT_EVENT_CLASS(x86_exceptions_class,
 		 * larger if error codes are added to the kernel.
 		 */
 		ctf_integer_hex(unsigned char, error_code, error_code)
+		ctf_summary_key(__lttng_fault_mapping(address),
+			__lttng_fault_subkey(error_code))
 	)
 )
 
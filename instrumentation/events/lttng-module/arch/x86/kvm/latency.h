@@ -0,0 +1,39 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kvm_x86_latency
+
+#if !defined(LTTNG_TRACE_KVM_X86_LATENCY_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_KVM_X86_LATENCY_H
+
+#include <probes/lttng-tracepoint-event.h>
+#include <linux/types.h>
+
+/**
+ * kvm_x86_latency_exit - vcpu entered again after a VM exit
+ * @vcpu_id: vcpu id
+ * @exit_reason: reason of the VM exit
+ * @duration: time from its kvm_exit to the next kvm_entry, in ns
+ *
+ * Emitted by the kvm x86 latency probe instead of the records of the
+ * exit and of the entry. With the SUMMARY action, exits are counted and
+ * their time in the host added up per vcpu and exit reason.
+ */
+LTTNG_TRACEPOINT_EVENT(kvm_x86_latency_exit,
+
+	TP_PROTO(unsigned int vcpu_id, unsigned int exit_reason, u64 duration),
+
+	TP_ARGS(vcpu_id, exit_reason, duration),
+
+	TP_FIELDS(
+		ctf_integer(unsigned int, vcpu_id, vcpu_id)
+		ctf_integer(unsigned int, exit_reason, exit_reason)
+		ctf_integer(u64, duration, duration)
+		ctf_summary_key(vcpu_id, exit_reason)
+		ctf_summary_value(duration)
+		ctf_duration(exit_reason, duration)
+	)
+)
+
+#endif /* LTTNG_TRACE_KVM_X86_LATENCY_H */
+
+/* This part must be outside protection */
+#include <probes/define_trace.h>
@@ -136,7 +136,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS(block_buffer,
 
 	TP_FIELDS (
 		ctf_integer(dev_t, dev, bh->b_bdev->bd_dev)
-		ctf_integer(sector_t, sector, bh->b_blocknr)
+		ctf_integer_delta(sector_t, sector, bh->b_blocknr)
 		ctf_integer(size_t, size, bh->b_size)
 	)
 )
@@ -200,7 +200,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS_CODE(block_rq_with_error,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev,
 			rq->rq_disk ? disk_devt(rq->rq_disk) : 0)
-		ctf_integer(sector_t, sector, tp_locvar->sector)
+		ctf_integer_delta(sector_t, sector, tp_locvar->sector)
 		ctf_integer(unsigned int, nr_sector, tp_locvar->nr_sector)
 		ctf_integer(int, errors, rq->errors)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
@@ -243,7 +243,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS_CODE(block_rq_with_error,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev,
 			rq->rq_disk ? disk_devt(rq->rq_disk) : 0)
-		ctf_integer(sector_t, sector, tp_locvar->sector)
+		ctf_integer_delta(sector_t, sector, tp_locvar->sector)
 		ctf_integer(unsigned int, nr_sector, tp_locvar->nr_sector)
 		ctf_integer(int, errors, rq->errors)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
@@ -328,13 +328,15 @@ LTTNG_TRACEPOINT_EVENT_CODE(block_rq_complete,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev,
 			rq->rq_disk ? disk_devt(rq->rq_disk) : 0)
-		ctf_integer(sector_t, sector, blk_rq_pos(rq))
+		ctf_integer_delta(sector_t, sector, blk_rq_pos(rq))
 		ctf_integer(unsigned int, nr_sector, nr_bytes >> 9)
 		ctf_integer(int, errors, rq->errors)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_req_op(rq), lttng_req_rw(rq), nr_bytes)
 		ctf_sequence_hex(unsigned char, cmd,
 			tp_locvar->cmd, size_t, tp_locvar->cmd_len)
+		ctf_agg_key(rq->rq_disk ? disk_devt(rq->rq_disk) : 0)
+		ctf_agg_value(nr_bytes)
 	),
 
 	TP_code_post()
@@ -372,13 +374,15 @@ LTTNG_TRACEPOINT_EVENT_CODE(block_rq_complete,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev,
 			rq->rq_disk ? disk_devt(rq->rq_disk) : 0)
-		ctf_integer(sector_t, sector, blk_rq_pos(rq))
+		ctf_integer_delta(sector_t, sector, blk_rq_pos(rq))
 		ctf_integer(unsigned int, nr_sector, nr_bytes >> 9)
 		ctf_integer(int, errors, rq->errors)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_req_op(rq), lttng_req_rw(rq), nr_bytes)
 		ctf_sequence_hex(unsigned char, cmd,
 			tp_locvar->cmd, size_t, tp_locvar->cmd_len)
+		ctf_agg_key(rq->rq_disk ? disk_devt(rq->rq_disk) : 0)
+		ctf_agg_value(nr_bytes)
 	),
 
 	TP_code_post()
@@ -441,7 +445,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS_CODE(block_rq,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev,
 			rq->rq_disk ? disk_devt(rq->rq_disk) : 0)
-		ctf_integer(sector_t, sector, tp_locvar->sector)
+		ctf_integer_delta(sector_t, sector, tp_locvar->sector)
 		ctf_integer(unsigned int, nr_sector, tp_locvar->nr_sector)
 		ctf_integer(unsigned int, bytes, tp_locvar->bytes)
 		ctf_integer(pid_t, tid, current->pid)
@@ -488,7 +492,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS_CODE(block_rq,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev,
 			rq->rq_disk ? disk_devt(rq->rq_disk) : 0)
-		ctf_integer(sector_t, sector, tp_locvar->sector)
+		ctf_integer_delta(sector_t, sector, tp_locvar->sector)
 		ctf_integer(unsigned int, nr_sector, tp_locvar->nr_sector)
 		ctf_integer(unsigned int, bytes, tp_locvar->bytes)
 		ctf_integer(pid_t, tid, current->pid)
@@ -555,13 +559,13 @@ LTTNG_TRACEPOINT_EVENT(block_bio_bounce,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev, bio->bi_bdev ? bio->bi_bdev->bd_dev : 0)
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0))
-		ctf_integer(sector_t, sector, bio->bi_iter.bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_iter.bi_sector)
 		ctf_integer(unsigned int, nr_sector, bio_sectors(bio))
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio),
 			bio->bi_iter.bi_size)
 #else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0)) */
-		ctf_integer(sector_t, sector, bio->bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_sector)
 		ctf_integer(unsigned int, nr_sector, bio->bi_size >> 9)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio),
@@ -596,14 +600,14 @@ LTTNG_TRACEPOINT_EVENT(block_bio_complete,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev, bio->bi_bdev->bd_dev)
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0))
-		ctf_integer(sector_t, sector, bio->bi_iter.bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_iter.bi_sector)
 		ctf_integer(unsigned int, nr_sector, bio_sectors(bio))
 		ctf_integer(int, error, error)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio),
 			bio->bi_iter.bi_size)
 #else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0)) */
-		ctf_integer(sector_t, sector, bio->bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_sector)
 		ctf_integer(unsigned int, nr_sector, bio->bi_size >> 9)
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,38))
 		ctf_integer(int, error, error)
@@ -626,13 +630,13 @@ LTTNG_TRACEPOINT_EVENT_CLASS(block_bio_merge,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev, bio->bi_bdev->bd_dev)
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0))
-		ctf_integer(sector_t, sector, bio->bi_iter.bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_iter.bi_sector)
 		ctf_integer(unsigned int, nr_sector, bio_sectors(bio))
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio),
 			bio->bi_iter.bi_size)
 #else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0)) */
-		ctf_integer(sector_t, sector, bio->bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_sector)
 		ctf_integer(unsigned int, nr_sector, bio->bi_size >> 9)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio), bio->bi_size)
@@ -688,13 +692,13 @@ LTTNG_TRACEPOINT_EVENT(block_bio_queue,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev, bio->bi_bdev->bd_dev)
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0))
-		ctf_integer(sector_t, sector, bio->bi_iter.bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_iter.bi_sector)
 		ctf_integer(unsigned int, nr_sector, bio_sectors(bio))
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio),
 			bio->bi_iter.bi_size)
 #else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0)) */
-		ctf_integer(sector_t, sector, bio->bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_sector)
 		ctf_integer(unsigned int, nr_sector, bio->bi_size >> 9)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio), bio->bi_size)
@@ -712,7 +716,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS(block_bio,
 
 	TP_FIELDS(
 		ctf_integer(dev_t, dev, bio->bi_bdev ? bio->bi_bdev->bd_dev : 0)
-		ctf_integer(sector_t, sector, bio->bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_sector)
 		ctf_integer(unsigned int, nr_sector, bio->bi_size >> 9)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio), bio->bi_size)
@@ -775,7 +779,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS(block_get_rq,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev, bio ? bio->bi_bdev->bd_dev : 0)
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0))
-		ctf_integer(sector_t, sector, bio ? bio->bi_iter.bi_sector : 0)
+		ctf_integer_delta(sector_t, sector, bio ? bio->bi_iter.bi_sector : 0)
 		ctf_integer(unsigned int, nr_sector,
 			bio ? bio_sectors(bio) : 0)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
@@ -783,7 +787,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS(block_get_rq,
 			bio ? lttng_bio_rw(bio) : 0,
 			bio ? bio->bi_iter.bi_size : 0)
 #else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0)) */
-		ctf_integer(sector_t, sector, bio ? bio->bi_sector : 0)
+		ctf_integer_delta(sector_t, sector, bio ? bio->bi_sector : 0)
 		ctf_integer(unsigned int, nr_sector,
 			bio ? bio->bi_size >> 9 : 0)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
@@ -936,12 +940,12 @@ LTTNG_TRACEPOINT_EVENT(block_split,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev, bio->bi_bdev->bd_dev)
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0))
-		ctf_integer(sector_t, sector, bio->bi_iter.bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_iter.bi_sector)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio),
 			bio->bi_iter.bi_size)
 #else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0)) */
-		ctf_integer(sector_t, sector, bio->bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_sector)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio), bio->bi_size)
 #endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0)) */
@@ -975,13 +979,13 @@ LTTNG_TRACEPOINT_EVENT(block_remap,
 	TP_FIELDS(
 		ctf_integer(dev_t, dev, bio->bi_bdev->bd_dev)
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0))
-		ctf_integer(sector_t, sector, bio->bi_iter.bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_iter.bi_sector)
 		ctf_integer(unsigned int, nr_sector, bio_sectors(bio))
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio),
 			bio->bi_iter.bi_size)
 #else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0)) */
-		ctf_integer(sector_t, sector, bio->bi_sector)
+		ctf_integer_delta(sector_t, sector, bio->bi_sector)
 		ctf_integer(unsigned int, nr_sector, bio->bi_size >> 9)
 		blk_rwbs_ctf_integer(unsigned int, rwbs,
 			lttng_bio_op(bio), lttng_bio_rw(bio), bio->bi_size)
@@ -1012,7 +1016,7 @@ LTTNG_TRACEPOINT_EVENT(block_rq_remap,
 
 	TP_FIELDS(
 		ctf_integer(dev_t, dev, disk_devt(rq->rq_disk))
-		ctf_integer(sector_t, sector, blk_rq_pos(rq))
+		ctf_integer_delta(sector_t, sector, blk_rq_pos(rq))
 		ctf_integer(unsigned int, nr_sector, blk_rq_sectors(rq))
 		ctf_integer(dev_t, old_dev, dev)
 		ctf_integer(sector_t, old_sector, from)
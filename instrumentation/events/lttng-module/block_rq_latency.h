@@ -0,0 +1,38 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM block_rq
+
+#if !defined(LTTNG_TRACE_BLOCK_RQ_LATENCY_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_BLOCK_RQ_LATENCY_H
+
+#include <probes/lttng-tracepoint-event.h>
+#include <linux/types.h>
+
+/**
+ * block_rq_latency - block IO request completed, paired with its issue
+ * @dev: device of the request
+ * @sector: first sector of the request
+ * @nr_sector: number of sectors of the request
+ * @latency: time from block_rq_issue to block_rq_complete, in ns
+ *
+ * Emitted by the block latency probe instead of the records of both
+ * ends of the request.
+ */
+LTTNG_TRACEPOINT_EVENT(block_rq_latency,
+
+	TP_PROTO(dev_t dev, sector_t sector, unsigned int nr_sector,
+		u64 latency),
+
+	TP_ARGS(dev, sector, nr_sector, latency),
+
+	TP_FIELDS(
+		ctf_integer(dev_t, dev, dev)
+		ctf_integer(sector_t, sector, sector)
+		ctf_integer(unsigned int, nr_sector, nr_sector)
+		ctf_integer(u64, latency, latency)
+	)
+)
+
+#endif /* LTTNG_TRACE_BLOCK_RQ_LATENCY_H */
+
+/* This part must be outside protection */
+#include <probes/define_trace.h>
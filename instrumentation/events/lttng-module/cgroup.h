@@ -0,0 +1,183 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cgroup
+
+#if !defined(LTTNG_TRACE_CGROUP_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_CGROUP_H
+
+#include <probes/lttng-tracepoint-event.h>
+#include <linux/cgroup.h>
+#include <linux/sched.h>
+#include <linux/version.h>
+
+#ifndef _TRACE_CGROUP_DEF_
+#define _TRACE_CGROUP_DEF_
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,7,0))
+#define lttng_cgroup_id_type		u64
+#define lttng_cgroup_id(cgrp)		cgroup_id(cgrp)
+#else
+#define lttng_cgroup_id_type		int
+#define lttng_cgroup_id(cgrp)		((cgrp)->id)
+#endif
+#endif /* _TRACE_CGROUP_DEF_ */
+
+LTTNG_TRACEPOINT_EVENT_CLASS(cgroup_root,
+
+	TP_PROTO(struct cgroup_root *root),
+
+	TP_ARGS(root),
+
+	TP_FIELDS(
+		ctf_integer(int, root, root->hierarchy_id)
+		ctf_integer_hex(unsigned int, ss_mask, root->subsys_mask)
+		ctf_string(name, root->name)
+	)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup_root, cgroup_setup_root,
+
+	TP_PROTO(struct cgroup_root *root),
+
+	TP_ARGS(root)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup_root, cgroup_destroy_root,
+
+	TP_PROTO(struct cgroup_root *root),
+
+	TP_ARGS(root)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup_root, cgroup_remount,
+
+	TP_PROTO(struct cgroup_root *root),
+
+	TP_ARGS(root)
+)
+
+LTTNG_TRACEPOINT_EVENT_CLASS(cgroup,
+
+	TP_PROTO(struct cgroup *cgrp, const char *path),
+
+	TP_ARGS(cgrp, path),
+
+	TP_FIELDS(
+		ctf_integer(int, root, cgrp->root->hierarchy_id)
+		ctf_integer(lttng_cgroup_id_type, id, lttng_cgroup_id(cgrp))
+		ctf_integer(int, level, cgrp->level)
+		ctf_string(path, path)
+	)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup, cgroup_mkdir,
+
+	TP_PROTO(struct cgroup *cgrp, const char *path),
+
+	TP_ARGS(cgrp, path)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup, cgroup_rmdir,
+
+	TP_PROTO(struct cgroup *cgrp, const char *path),
+
+	TP_ARGS(cgrp, path)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup, cgroup_release,
+
+	TP_PROTO(struct cgroup *cgrp, const char *path),
+
+	TP_ARGS(cgrp, path)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup, cgroup_rename,
+
+	TP_PROTO(struct cgroup *cgrp, const char *path),
+
+	TP_ARGS(cgrp, path)
+)
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0))
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup, cgroup_freeze,
+
+	TP_PROTO(struct cgroup *cgrp, const char *path),
+
+	TP_ARGS(cgrp, path)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup, cgroup_unfreeze,
+
+	TP_PROTO(struct cgroup *cgrp, const char *path),
+
+	TP_ARGS(cgrp, path)
+)
+#endif
+
+LTTNG_TRACEPOINT_EVENT_CLASS(cgroup_migrate,
+
+	TP_PROTO(struct cgroup *dst_cgrp, const char *path,
+		struct task_struct *task, bool threadgroup),
+
+	TP_ARGS(dst_cgrp, path, task, threadgroup),
+
+	TP_FIELDS(
+		ctf_integer(int, dst_root, dst_cgrp->root->hierarchy_id)
+		ctf_integer(lttng_cgroup_id_type, dst_id,
+			lttng_cgroup_id(dst_cgrp))
+		ctf_integer(int, dst_level, dst_cgrp->level)
+		ctf_string(dst_path, path)
+		ctf_integer(pid_t, pid, task->pid)
+		ctf_array_text(char, comm, task->comm, TASK_COMM_LEN)
+	)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup_migrate, cgroup_attach_task,
+
+	TP_PROTO(struct cgroup *dst_cgrp, const char *path,
+		struct task_struct *task, bool threadgroup),
+
+	TP_ARGS(dst_cgrp, path, task, threadgroup)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup_migrate, cgroup_transfer_tasks,
+
+	TP_PROTO(struct cgroup *dst_cgrp, const char *path,
+		struct task_struct *task, bool threadgroup),
+
+	TP_ARGS(dst_cgrp, path, task, threadgroup)
+)
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0))
+LTTNG_TRACEPOINT_EVENT_CLASS(cgroup_event,
+
+	TP_PROTO(struct cgroup *cgrp, const char *path, int val),
+
+	TP_ARGS(cgrp, path, val),
+
+	TP_FIELDS(
+		ctf_integer(int, root, cgrp->root->hierarchy_id)
+		ctf_integer(lttng_cgroup_id_type, id, lttng_cgroup_id(cgrp))
+		ctf_integer(int, level, cgrp->level)
+		ctf_string(path, path)
+		ctf_integer(int, val, val)
+	)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup_event, cgroup_notify_populated,
+
+	TP_PROTO(struct cgroup *cgrp, const char *path, int val),
+
+	TP_ARGS(cgrp, path, val)
+)
+
+LTTNG_TRACEPOINT_EVENT_INSTANCE(cgroup_event, cgroup_notify_frozen,
+
+	TP_PROTO(struct cgroup *cgrp, const char *path, int val),
+
+	TP_ARGS(cgrp, path, val)
+)
+#endif
+
+#endif /* LTTNG_TRACE_CGROUP_H */
+
+/* This part must be outside protection */
+#include <probes/define_trace.h>
@@ -0,0 +1,95 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM io_uring
+
+#if !defined(LTTNG_TRACE_IO_URING_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_IO_URING_H
+
+#include <probes/lttng-tracepoint-event.h>
+#include <linux/types.h>
+#include <linux/version.h>
+
+LTTNG_TRACEPOINT_EVENT(io_uring_create,
+
+	TP_PROTO(int fd, void *ctx, u32 sq_entries, u32 cq_entries, u32 flags),
+
+	TP_ARGS(fd, ctx, sq_entries, cq_entries, flags),
+
+	TP_FIELDS(
+		ctf_integer(int, fd, fd)
+		ctf_integer_hex(void *, ctx, ctx)
+		ctf_integer(u32, sq_entries, sq_entries)
+		ctf_integer(u32, cq_entries, cq_entries)
+		ctf_integer_hex(u32, flags, flags)
+	)
+)
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,14,0))
+LTTNG_TRACEPOINT_EVENT(io_uring_submit_sqe,
+
+	TP_PROTO(void *ctx, void *req, u8 opcode, u64 user_data, u32 flags,
+		bool force_nonblock, bool sq_thread),
+
+	TP_ARGS(ctx, req, opcode, user_data, flags, force_nonblock,
+		sq_thread),
+
+	TP_FIELDS(
+		ctf_integer_hex(void *, ctx, ctx)
+		ctf_integer_hex(void *, req, req)
+		ctf_integer(u8, opcode, opcode)
+		ctf_integer_hex(u64, user_data, user_data)
+		ctf_integer_hex(u32, flags, flags)
+		ctf_integer(bool, force_nonblock, force_nonblock)
+		ctf_integer(bool, sq_thread, sq_thread)
+	)
+)
+#else
+LTTNG_TRACEPOINT_EVENT(io_uring_submit_sqe,
+
+	TP_PROTO(void *ctx, u8 opcode, u64 user_data, bool force_nonblock,
+		bool sq_thread),
+
+	TP_ARGS(ctx, opcode, user_data, force_nonblock, sq_thread),
+
+	TP_FIELDS(
+		ctf_integer_hex(void *, ctx, ctx)
+		ctf_integer(u8, opcode, opcode)
+		ctf_integer_hex(u64, user_data, user_data)
+		ctf_integer(bool, force_nonblock, force_nonblock)
+		ctf_integer(bool, sq_thread, sq_thread)
+	)
+)
+#endif
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,12,0))
+LTTNG_TRACEPOINT_EVENT(io_uring_complete,
+
+	TP_PROTO(void *ctx, u64 user_data, long res, unsigned cflags),
+
+	TP_ARGS(ctx, user_data, res, cflags),
+
+	TP_FIELDS(
+		ctf_integer_hex(void *, ctx, ctx)
+		ctf_integer_hex(u64, user_data, user_data)
+		ctf_integer(long, res, res)
+		ctf_integer_hex(unsigned int, cflags, cflags)
+	)
+)
+#else
+LTTNG_TRACEPOINT_EVENT(io_uring_complete,
+
+	TP_PROTO(void *ctx, u64 user_data, long res),
+
+	TP_ARGS(ctx, user_data, res),
+
+	TP_FIELDS(
+		ctf_integer_hex(void *, ctx, ctx)
+		ctf_integer_hex(u64, user_data, user_data)
+		ctf_integer(long, res, res)
+	)
+)
+#endif
+
+#endif /* LTTNG_TRACE_IO_URING_H */
+
+/* This part must be outside protection */
+#include <probes/define_trace.h>
@@ -0,0 +1,43 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM io_uring_latency
+
+#if !defined(LTTNG_TRACE_IO_URING_LATENCY_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_IO_URING_LATENCY_H
+
+#include <probes/lttng-tracepoint-event.h>
+#include <linux/types.h>
+
+/**
+ * io_uring_latency - io_uring request completed, paired with its submission
+ * @ctx: ring of the request
+ * @opcode: operation of the request
+ * @user_data: user data of the request
+ * @res: result posted in its completion
+ * @latency: time from io_uring_submit_sqe to io_uring_complete, in ns
+ *
+ * Emitted by the io_uring latency probe instead of the records of both
+ * ends of the request. With the SUMMARY action, requests are counted and
+ * their latency added up per ring and operation.
+ */
+LTTNG_TRACEPOINT_EVENT(io_uring_latency,
+
+	TP_PROTO(void *ctx, u8 opcode, u64 user_data, long res, u64 latency),
+
+	TP_ARGS(ctx, opcode, user_data, res, latency),
+
+	TP_FIELDS(
+		ctf_integer_hex(void *, ctx, ctx)
+		ctf_integer(u8, opcode, opcode)
+		ctf_integer_hex(u64, user_data, user_data)
+		ctf_integer(long, res, res)
+		ctf_integer(u64, latency, latency)
+		ctf_summary_key((unsigned long) ctx, opcode)
+		ctf_summary_value(latency)
+		ctf_duration(opcode, latency)
+	)
+)
+
+#endif /* LTTNG_TRACE_IO_URING_LATENCY_H */
+
+/* This part must be outside protection */
+#include <probes/define_trace.h>
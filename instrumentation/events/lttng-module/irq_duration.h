@@ -0,0 +1,58 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM irq_duration
+
+#if !defined(LTTNG_TRACE_IRQ_DURATION_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_IRQ_DURATION_H
+
+#include <probes/lttng-tracepoint-event.h>
+#include <linux/types.h>
+
+/**
+ * irq_duration_handler - irq action handler returned
+ * @irq: irq number
+ * @ret: return value of the handler
+ * @duration: time from its irq_handler_entry to its irq_handler_exit, in ns
+ *
+ * Emitted by the irq duration probe instead of the records of the entry
+ * and of the exit. The handler names are listed by the statedump
+ * lttng_statedump_interrupt events.
+ */
+LTTNG_TRACEPOINT_EVENT(irq_duration_handler,
+
+	TP_PROTO(int irq, int ret, u64 duration),
+
+	TP_ARGS(irq, ret, duration),
+
+	TP_FIELDS(
+		ctf_integer(int, irq, irq)
+		ctf_integer(int, ret, ret)
+		ctf_integer(u64, duration, duration)
+		ctf_duration(irq, duration)
+	)
+)
+
+/**
+ * irq_duration_softirq - softirq handler returned
+ * @vec: softirq vector number
+ * @duration: time from its softirq_entry to its softirq_exit, in ns
+ *
+ * Emitted by the irq duration probe instead of the records of the entry
+ * and of the exit.
+ */
+LTTNG_TRACEPOINT_EVENT(irq_duration_softirq,
+
+	TP_PROTO(unsigned int vec, u64 duration),
+
+	TP_ARGS(vec, duration),
+
+	TP_FIELDS(
+		ctf_integer(unsigned int, vec, vec)
+		ctf_integer(u64, duration, duration)
+		ctf_duration(vec, duration)
+	)
+)
+
+#endif /* LTTNG_TRACE_IRQ_DURATION_H */
+
+/* This part must be outside protection */
+#include <probes/define_trace.h>
@@ -20,10 +20,11 @@ LTTNG_TRACEPOINT_EVENT_CLASS(kmem_alloc,
 
 	TP_FIELDS(
 		ctf_integer_hex(unsigned long, call_site, call_site)
-		ctf_integer_hex(const void *, ptr, ptr)
+		ctf_integer_hex_delta(const void *, ptr, ptr)
 		ctf_integer(size_t, bytes_req, bytes_req)
 		ctf_integer(size_t, bytes_alloc, bytes_alloc)
 		ctf_integer(gfp_t, gfp_flags, gfp_flags)
+		ctf_alloc_site(call_site, bytes_req, bytes_alloc)
 	)
 )
 
@@ -58,11 +59,12 @@ LTTNG_TRACEPOINT_EVENT_CLASS(kmem_alloc_node,
 
 	TP_FIELDS(
 		ctf_integer_hex(unsigned long, call_site, call_site)
-		ctf_integer_hex(const void *, ptr, ptr)
+		ctf_integer_hex_delta(const void *, ptr, ptr)
 		ctf_integer(size_t, bytes_req, bytes_req)
 		ctf_integer(size_t, bytes_alloc, bytes_alloc)
 		ctf_integer(gfp_t, gfp_flags, gfp_flags)
 		ctf_integer(int, node, node)
+		ctf_alloc_site(call_site, bytes_req, bytes_alloc)
 	)
 )
 
@@ -94,7 +96,8 @@ LTTNG_TRACEPOINT_EVENT_CLASS(kmem_free,
 
 	TP_FIELDS(
 		ctf_integer_hex(unsigned long, call_site, call_site)
-		ctf_integer_hex(const void *, ptr, ptr)
+		ctf_integer_hex_delta(const void *, ptr, ptr)
+		ctf_free_site(call_site)
 	)
 )
 
@@ -129,6 +132,7 @@ LTTNG_TRACEPOINT_EVENT_MAP(mm_page_free_direct, kmem_mm_page_free_direct,
 		ctf_integer_hex(struct page *, page, page)
 		ctf_integer(unsigned long, pfn, page_to_pfn(page))
 		ctf_integer(unsigned int, order, order)
+		ctf_free_site(0)
 	)
 )
 
@@ -163,6 +167,9 @@ LTTNG_TRACEPOINT_EVENT_MAP(mm_page_alloc, kmem_mm_page_alloc,
 		ctf_integer(unsigned int, order, order)
 		ctf_integer(gfp_t, gfp_flags, gfp_flags)
 		ctf_integer(int, migratetype, migratetype)
+		/* The tracepoint has no call site: pages count under 0. */
+		ctf_alloc_site(0, page ? PAGE_SIZE << order : 0,
+			page ? PAGE_SIZE << order : 0)
 	)
 )
 
@@ -0,0 +1,59 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lock_contention
+
+#if !defined(LTTNG_TRACE_LOCK_CONTENTION_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_LOCK_CONTENTION_H
+
+#include <probes/lttng-tracepoint-event.h>
+#include <linux/lockdep.h>
+#include <linux/types.h>
+
+/**
+ * lock_contention_wait - contended lock acquired
+ * @lock: lockdep map of the lock
+ * @wait: time from its lock_contended to its lock_acquired, in ns
+ *
+ * Emitted by the lock contention probe for each contended acquisition.
+ * Meant for map channels with the DURATION key, which keep a wait time
+ * histogram per lock class.
+ */
+LTTNG_TRACEPOINT_EVENT(lock_contention_wait,
+
+	TP_PROTO(struct lockdep_map *lock, u64 wait),
+
+	TP_ARGS(lock, wait),
+
+	TP_FIELDS(
+		ctf_string(name, lock->name)
+		ctf_integer(u64, wait, wait)
+		ctf_duration((unsigned long) lock->key, wait)
+	)
+)
+
+/**
+ * lock_contention_slow - lock acquired after a long wait
+ * @lock: lockdep map of the lock
+ * @ip: call site of the acquisition
+ * @wait: time from its lock_contended to its lock_acquired, in ns
+ *
+ * Emitted by the lock contention probe instead of the lock_contended
+ * and lock_acquired records, for waits above its threshold.
+ */
+LTTNG_TRACEPOINT_EVENT(lock_contention_slow,
+
+	TP_PROTO(struct lockdep_map *lock, unsigned long ip, u64 wait),
+
+	TP_ARGS(lock, ip, wait),
+
+	TP_FIELDS(
+		ctf_string(name, lock->name)
+		ctf_integer_hex(void *, lockdep_addr, lock)
+		ctf_integer_hex(unsigned long, ip, ip)
+		ctf_integer(u64, wait, wait)
+	)
+)
+
+#endif /* LTTNG_TRACE_LOCK_CONTENTION_H */
+
+/* This part must be outside protection */
+#include <probes/define_trace.h>
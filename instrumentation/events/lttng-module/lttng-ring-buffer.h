@@ -0,0 +1,104 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM lttng_ring_buffer
+
+#if !defined(LTTNG_TRACE_LTTNG_RING_BUFFER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_LTTNG_RING_BUFFER_H
+
+#include <probes/lttng-tracepoint-event.h>
+#include <linux/types.h>
+
+/*
+ * Events of the tracer about its own ring buffers, emitted by the lib ring
+ * buffer from its slow paths. They are meant to be enabled in a channel of
+ * their own: recording them in the channel they describe makes each of its
+ * switches emit an event into the next sub-buffer.
+ */
+
+/**
+ * lttng_ring_buffer_switch - sub-buffer closed
+ * @channel: channel name
+ * @cpu: buffer cpu, -1 for global buffers
+ * @data_size: bytes of the sub-buffer holding data, without padding
+ * @subbuf_size: sub-buffer size
+ */
+LTTNG_TRACEPOINT_EVENT(lttng_ring_buffer_switch,
+
+	TP_PROTO(const char *channel, int cpu, unsigned long data_size,
+		unsigned long subbuf_size),
+
+	TP_ARGS(channel, cpu, data_size, subbuf_size),
+
+	TP_FIELDS(
+		ctf_string(channel, channel)
+		ctf_integer(int, cpu, cpu)
+		ctf_integer(unsigned long, data_size, data_size)
+		ctf_integer(unsigned int, fill_ratio,
+			(unsigned int) (data_size * 100 / subbuf_size))
+	)
+)
+
+/**
+ * lttng_ring_buffer_reserve_slow - reservation took the slow path
+ * @channel: channel name
+ * @cpu: buffer cpu, -1 for global buffers
+ * @size: size of the record being reserved
+ */
+LTTNG_TRACEPOINT_EVENT(lttng_ring_buffer_reserve_slow,
+
+	TP_PROTO(const char *channel, int cpu, size_t size),
+
+	TP_ARGS(channel, cpu, size),
+
+	TP_FIELDS(
+		ctf_string(channel, channel)
+		ctf_integer(int, cpu, cpu)
+		ctf_integer(size_t, size, size)
+	)
+)
+
+/**
+ * lttng_ring_buffer_lost_records - records lost since the previous switch
+ * @channel: channel name
+ * @cpu: buffer cpu, -1 for global buffers
+ * @lost: records lost because the buffer was full, wrapped, or too small
+ *
+ * Emitted at the sub-buffer switch following the losses.
+ */
+LTTNG_TRACEPOINT_EVENT(lttng_ring_buffer_lost_records,
+
+	TP_PROTO(const char *channel, int cpu, unsigned long lost),
+
+	TP_ARGS(channel, cpu, lost),
+
+	TP_FIELDS(
+		ctf_string(channel, channel)
+		ctf_integer(int, cpu, cpu)
+		ctf_integer(unsigned long, lost, lost)
+	)
+)
+
+/**
+ * lttng_ring_buffer_reader_wait - sub-buffer got by the reader
+ * @channel: channel name
+ * @cpu: buffer cpu, -1 for global buffers
+ * @seq_num: packet sequence number
+ * @wait: time from the packet end to the get, in trace clock units
+ */
+LTTNG_TRACEPOINT_EVENT(lttng_ring_buffer_reader_wait,
+
+	TP_PROTO(const char *channel, int cpu, u64 seq_num, u64 wait),
+
+	TP_ARGS(channel, cpu, seq_num, wait),
+
+	TP_FIELDS(
+		ctf_string(channel, channel)
+		ctf_integer(int, cpu, cpu)
+		ctf_integer(u64, seq_num, seq_num)
+		ctf_integer(u64, wait, wait)
+	)
+)
+
+#endif /* LTTNG_TRACE_LTTNG_RING_BUFFER_H */
+
+/* This part must be outside protection */
+#include <probes/define_trace.h>
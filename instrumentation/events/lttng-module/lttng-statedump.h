@@ -29,6 +29,20 @@ LTTNG_TRACEPOINT_EVENT(lttng_statedump_end,
 	TP_FIELDS()
 )
 
+/*
+ * Emitted at the end of each phase of the statedump, with its duration in
+ * trace clock units.
+ */
+LTTNG_TRACEPOINT_EVENT(lttng_statedump_phase,
+	TP_PROTO(struct lttng_session *session, const char *phase,
+		u64 duration),
+	TP_ARGS(session, phase, duration),
+	TP_FIELDS(
+		ctf_string(phase, phase)
+		ctf_integer(u64, duration, duration)
+	)
+)
+
 LTTNG_TRACEPOINT_EVENT(lttng_statedump_process_state,
 	TP_PROTO(struct lttng_session *session,
 		struct task_struct *p,
@@ -78,14 +92,34 @@ LTTNG_TRACEPOINT_EVENT(lttng_statedump_process_state,
 LTTNG_TRACEPOINT_EVENT(lttng_statedump_file_descriptor,
 	TP_PROTO(struct lttng_session *session,
 		struct task_struct *p, int fd, const char *filename,
-		unsigned int flags, fmode_t fmode),
-	TP_ARGS(session, p, fd, filename, flags, fmode),
+		unsigned int flags, fmode_t fmode,
+		unsigned long ino, dev_t dev),
+	TP_ARGS(session, p, fd, filename, flags, fmode, ino, dev),
 	TP_FIELDS(
 		ctf_integer(pid_t, pid, p->tgid)
 		ctf_integer(int, fd, fd)
 		ctf_integer_oct(unsigned int, flags, flags)
 		ctf_integer_hex(fmode_t, fmode, fmode)
 		ctf_string(filename, filename)
+		ctf_integer(unsigned long, ino, ino)
+		ctf_integer(dev_t, dev, dev)
+	)
+)
+
+/* File descriptor of a file whose path the session already dumped. */
+LTTNG_TRACEPOINT_EVENT(lttng_statedump_file_descriptor_inode,
+	TP_PROTO(struct lttng_session *session,
+		struct task_struct *p, int fd,
+		unsigned int flags, fmode_t fmode,
+		unsigned long ino, dev_t dev),
+	TP_ARGS(session, p, fd, flags, fmode, ino, dev),
+	TP_FIELDS(
+		ctf_integer(pid_t, pid, p->tgid)
+		ctf_integer(int, fd, fd)
+		ctf_integer_oct(unsigned int, flags, flags)
+		ctf_integer_hex(fmode_t, fmode, fmode)
+		ctf_integer(unsigned long, ino, ino)
+		ctf_integer(dev_t, dev, dev)
 	)
 )
 
@@ -138,6 +172,82 @@ LTTNG_TRACEPOINT_EVENT(lttng_statedump_interrupt,
 	)
 )
 
+/*
+ * Loaded modules, at statedump and as they are loaded and unloaded, for
+ * the sessions which dumped the symbols.
+ */
+LTTNG_TRACEPOINT_EVENT(lttng_statedump_module,
+	TP_PROTO(struct lttng_session *session,
+		const char *name, unsigned long base, unsigned long size),
+	TP_ARGS(session, name, base, size),
+	TP_FIELDS(
+		ctf_string(name, name)
+		ctf_integer_hex(unsigned long, base, base)
+		ctf_integer(unsigned long, size, size)
+	)
+)
+
+LTTNG_TRACEPOINT_EVENT(lttng_statedump_module_unload,
+	TP_PROTO(struct lttng_session *session,
+		const char *name, unsigned long base),
+	TP_ARGS(session, name, base),
+	TP_FIELDS(
+		ctf_string(name, name)
+		ctf_integer_hex(unsigned long, base, base)
+	)
+)
+
+/* The module of a symbol is the one whose range holds its address. */
+LTTNG_TRACEPOINT_EVENT(lttng_statedump_symbol,
+	TP_PROTO(struct lttng_session *session,
+		unsigned long address, const char *name),
+	TP_ARGS(session, address, name),
+	TP_FIELDS(
+		ctf_integer_hex(unsigned long, address, address)
+		ctf_string(name, name)
+	)
+)
+
+/* Softirq vectors, with the address of their handler. */
+LTTNG_TRACEPOINT_EVENT(lttng_statedump_softirq,
+	TP_PROTO(struct lttng_session *session,
+		unsigned int vec, const char *name, unsigned long action),
+	TP_ARGS(session, vec, name, action),
+	TP_FIELDS(
+		ctf_integer(unsigned int, vec, vec)
+		ctf_string(name, name)
+		ctf_integer_hex(unsigned long, action, action)
+	)
+)
+
+/* Active swap areas, sizes in pages. */
+LTTNG_TRACEPOINT_EVENT(lttng_statedump_swap_file,
+	TP_PROTO(struct lttng_session *session,
+		unsigned int type, const char *filename,
+		unsigned long pages, unsigned long inuse_pages, int prio),
+	TP_ARGS(session, type, filename, pages, inuse_pages, prio),
+	TP_FIELDS(
+		ctf_integer(unsigned int, type, type)
+		ctf_string(filename, filename)
+		ctf_integer(unsigned long, pages, pages)
+		ctf_integer(unsigned long, inuse_pages, inuse_pages)
+		ctf_integer(int, prio, prio)
+	)
+)
+
+#ifdef CONFIG_X86
+/* Interrupt descriptor table entries with a handler. */
+LTTNG_TRACEPOINT_EVENT(lttng_statedump_idt_vector,
+	TP_PROTO(struct lttng_session *session,
+		unsigned int vector, unsigned long handler),
+	TP_ARGS(session, vector, handler),
+	TP_FIELDS(
+		ctf_integer(unsigned int, vector, vector)
+		ctf_integer_hex(unsigned long, handler, handler)
+	)
+)
+#endif
+
 #endif /*  LTTNG_TRACE_LTTNG_STATEDUMP_H */
 
 /* This part must be outside protection */
@@ -48,6 +48,14 @@ LTTNG_TRACEPOINT_EVENT(lttng_test_filter_event,
 	)
 )
 
+LTTNG_TRACEPOINT_EVENT(lttng_test_payload_event,
+	TP_PROTO(const char *payload, size_t len),
+	TP_ARGS(payload, len),
+	TP_FIELDS(
+		ctf_sequence(char, payload, payload, size_t, len)
+	)
+)
+
 #endif /*  LTTNG_TRACE_LTTNG_TEST_H */
 
 /* This part must be outside protection */
@@ -180,6 +180,8 @@ LTTNG_TRACEPOINT_EVENT_CLASS(mm_vmscan_direct_reclaim_end_template,
 
 	TP_FIELDS(
 		ctf_integer(unsigned long, nr_reclaimed, nr_reclaimed)
+		ctf_summary_key(lttng_cgroup_id(), 0)
+		ctf_summary_value(nr_reclaimed)
 	)
 )
 
@@ -303,6 +305,8 @@ LTTNG_TRACEPOINT_EVENT(mm_vmscan_lru_isolate,
 		ctf_integer(int, order, order)
 		ctf_integer(unsigned long, nr_requested, nr_requested)
 		ctf_integer(unsigned long, nr_scanned, nr_scanned)
+		ctf_summary_key(lttng_cgroup_id(), 0)
+		ctf_summary_value(nr_scanned)
 		ctf_integer(unsigned long, nr_skipped, nr_skipped)
 		ctf_integer(unsigned long, nr_taken, nr_taken)
 		ctf_integer(isolate_mode_t, isolate_mode, isolate_mode)
@@ -331,6 +335,8 @@ LTTNG_TRACEPOINT_EVENT_CLASS(mm_vmscan_lru_isolate_template,
 		ctf_integer(int, order, order)
 		ctf_integer(unsigned long, nr_requested, nr_requested)
 		ctf_integer(unsigned long, nr_scanned, nr_scanned)
+		ctf_summary_key(lttng_cgroup_id(), 0)
+		ctf_summary_value(nr_scanned)
 		ctf_integer(unsigned long, nr_taken, nr_taken)
 		ctf_integer(isolate_mode_t, isolate_mode, isolate_mode)
 		ctf_integer(int, file, file)
@@ -405,6 +411,8 @@ LTTNG_TRACEPOINT_EVENT_CLASS(mm_vmscan_lru_isolate_template,
 		ctf_integer(int, order, order)
 		ctf_integer(unsigned long, nr_requested, nr_requested)
 		ctf_integer(unsigned long, nr_scanned, nr_scanned)
+		ctf_summary_key(lttng_cgroup_id(), 0)
+		ctf_summary_value(nr_scanned)
 		ctf_integer(unsigned long, nr_taken, nr_taken)
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(3,5,0))
 		ctf_integer(unsigned long, nr_lumpy_taken, nr_lumpy_taken)
@@ -528,6 +536,8 @@ LTTNG_TRACEPOINT_EVENT(mm_vmscan_lru_shrink_inactive,
 		ctf_integer(int, nid, nid)
 		ctf_integer(unsigned long, nr_scanned, nr_scanned)
 		ctf_integer(unsigned long, nr_reclaimed, nr_reclaimed)
+		ctf_summary_key(lttng_cgroup_id(), 0)
+		ctf_summary_value(nr_reclaimed)
 		ctf_integer(unsigned long, nr_dirty, nr_dirty)
 		ctf_integer(unsigned long, nr_writeback, nr_writeback)
 		ctf_integer(unsigned long, nr_congested, nr_congested)
@@ -552,6 +562,8 @@ LTTNG_TRACEPOINT_EVENT(mm_vmscan_lru_shrink_inactive,
 		ctf_integer(int, nid, nid)
 		ctf_integer(unsigned long, nr_scanned, nr_scanned)
 		ctf_integer(unsigned long, nr_reclaimed, nr_reclaimed)
+		ctf_summary_key(lttng_cgroup_id(), 0)
+		ctf_summary_value(nr_reclaimed)
 		ctf_integer(int, priority, priority)
 		ctf_integer(int, reclaim_flags, trace_shrink_flags(file))
 	)
@@ -570,6 +582,8 @@ LTTNG_TRACEPOINT_EVENT(mm_vmscan_lru_shrink_inactive,
 		ctf_integer(int, zid, zone_idx(zone))
 		ctf_integer(unsigned long, nr_scanned, nr_scanned)
 		ctf_integer(unsigned long, nr_reclaimed, nr_reclaimed)
+		ctf_summary_key(lttng_cgroup_id(), 0)
+		ctf_summary_value(nr_reclaimed)
 		ctf_integer(int, priority, priority)
 		ctf_integer(int, reclaim_flags, trace_shrink_flags(file))
 	)
@@ -588,6 +602,8 @@ LTTNG_TRACEPOINT_EVENT(mm_vmscan_lru_shrink_inactive,
 		ctf_integer(int, zid, zid)
 		ctf_integer(unsigned long, nr_scanned, nr_scanned)
 		ctf_integer(unsigned long, nr_reclaimed, nr_reclaimed)
+		ctf_summary_key(lttng_cgroup_id(), 0)
+		ctf_summary_value(nr_reclaimed)
 		ctf_integer(int, priority, priority)
 		ctf_integer(int, reclaim_flags, reclaim_flags)
 	)
@@ -375,6 +375,30 @@ static inline unsigned char __get_network_header_type(struct sk_buff *skb)
 	return NH_NONE;
 }
 
+/*
+ * Flow key of the net events: computes the flow hash if the device did
+ * not provide it, caching it in the skb as the stack itself does.
+ */
+static inline u32 __lttng_net_flow_hash(struct sk_buff *skb)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0))
+	return skb_get_hash(skb);
+#elif (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35))
+	return skb_get_rxhash(skb);
+#else
+	return 0;
+#endif
+}
+
+/*
+ * Bytes of packet data captured from the current data pointer of the skb:
+ * the link layer header on transmit, the network header on receive.
+ */
+static inline uint16_t __lttng_net_caplen(struct sk_buff *skb)
+{
+	return min3(skb->len, ACCESS_ONCE(payload_snaplen), 65535U);
+}
+
 #endif
 
 LTTNG_TRACEPOINT_ENUM(net_network_header,
@@ -407,9 +431,11 @@ LTTNG_TRACEPOINT_EVENT(net_dev_xmit,
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,40))
 		ctf_integer(unsigned int, len, skb_len)
 		ctf_string(name, dev->name)
+		ctf_flow_key(__lttng_net_flow_hash(skb), skb_len)
 #else
 		ctf_integer(unsigned int, len, skb->len)
 		ctf_string(name, skb->dev->name)
+		ctf_flow_key(__lttng_net_flow_hash(skb), skb->len)
 #endif
 	)
 )
@@ -421,6 +447,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS(net_dev_template,
 	TP_ARGS(skb),
 
 	TP_FIELDS(
+		ctf_flow_key(__lttng_net_flow_hash(skb), skb->len)
 		ctf_integer_hex(void *, skbaddr, skb)
 		ctf_integer(unsigned int, len, skb->len)
 		ctf_string(name, skb->dev->name)
@@ -471,6 +498,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS(net_dev_template,
 				 */
 			)
 		)
+		ctf_sequence_skb(payload, skb, __lttng_net_caplen(skb))
 	)
 )
 
@@ -154,7 +154,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS(sched_wakeup_template,
 	TP_ARGS(p),
 
 	TP_FIELDS(
-		ctf_array_text(char, comm, p->comm, TASK_COMM_LEN)
+		ctf_array_text_dict(comm, p->comm, TASK_COMM_LEN)
 		ctf_integer(pid_t, tid, p->pid)
 		ctf_integer(int, prio, p->prio - MAX_RT_PRIO)
 		ctf_integer(int, target_cpu, task_cpu(p))
@@ -263,7 +263,7 @@ LTTNG_TRACEPOINT_EVENT(sched_switch,
 #endif /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35)) */
 
 	TP_FIELDS(
-		ctf_array_text(char, prev_comm,	prev->comm, TASK_COMM_LEN)
+		ctf_array_text_dict(prev_comm, prev->comm, TASK_COMM_LEN)
 		ctf_integer(pid_t, prev_tid, prev->pid)
 		ctf_integer(int, prev_prio, prev->prio - MAX_RT_PRIO)
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0))
@@ -273,7 +273,48 @@ LTTNG_TRACEPOINT_EVENT(sched_switch,
 #else
 		ctf_integer(long, prev_state, prev->state)
 #endif
-		ctf_array_text(char, next_comm, next->comm, TASK_COMM_LEN)
+		ctf_array_text_dict(next_comm, next->comm, TASK_COMM_LEN)
+		ctf_integer(pid_t, next_tid, next->pid)
+		ctf_integer(int, next_prio, next->prio - MAX_RT_PRIO)
+	)
+)
+
+/*
+ * Compact variant of sched_switch, for traces dominated by it: no comm
+ * (readers get it from the statedump, exec and comm events), and a
+ * fixed-size payload laid out without alignment padding, recorded
+ * without going through the dynamic length stack.
+ */
+LTTNG_TRACEPOINT_EVENT_MAP(sched_switch, sched_switch_compact,
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0))
+	TP_PROTO(bool preempt,
+		 struct task_struct *prev,
+		 struct task_struct *next),
+
+	TP_ARGS(preempt, prev, next),
+#elif (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35))
+	TP_PROTO(struct task_struct *prev,
+		 struct task_struct *next),
+
+	TP_ARGS(prev, next),
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35)) */
+	TP_PROTO(struct rq *rq, struct task_struct *prev,
+		 struct task_struct *next),
+
+	TP_ARGS(rq, prev, next),
+#endif /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35)) */
+
+	TP_FIELDS(
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0))
+		ctf_integer(long, prev_state, __trace_sched_switch_state(preempt, prev))
+#elif (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35))
+		ctf_integer(long, prev_state, __trace_sched_switch_state(prev))
+#else
+		ctf_integer(long, prev_state, prev->state)
+#endif
+		ctf_integer(pid_t, prev_tid, prev->pid)
+		ctf_integer(int, prev_prio, prev->prio - MAX_RT_PRIO)
 		ctf_integer(pid_t, next_tid, next->pid)
 		ctf_integer(int, next_prio, next->prio - MAX_RT_PRIO)
 	)
@@ -462,7 +503,7 @@ LTTNG_TRACEPOINT_EVENT(sched_process_exec,
 	TP_ARGS(p, old_pid, bprm),
 
 	TP_FIELDS(
-		ctf_string(filename, bprm->filename)
+		ctf_string_dict(filename, bprm->filename)
 		ctf_integer(pid_t, tid, p->pid)
 		ctf_integer(pid_t, old_tid, old_pid)
 	)
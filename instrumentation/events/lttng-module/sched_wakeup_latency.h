@@ -0,0 +1,35 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM sched_wakeup
+
+#if !defined(LTTNG_TRACE_SCHED_WAKEUP_LATENCY_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_SCHED_WAKEUP_LATENCY_H
+
+#include <probes/lttng-tracepoint-event.h>
+#include <linux/types.h>
+
+/**
+ * sched_wakeup_latency - woken up task scheduled in
+ * @tid: thread id of the task
+ * @prio: priority of the task
+ * @latency: time from its sched_wakeup to its sched_switch, in ns
+ *
+ * Emitted by the sched latency probe on the CPU the task is switched
+ * in on, instead of the records of the wakeup and of the switch.
+ */
+LTTNG_TRACEPOINT_EVENT(sched_wakeup_latency,
+
+	TP_PROTO(pid_t tid, int prio, u64 latency),
+
+	TP_ARGS(tid, prio, latency),
+
+	TP_FIELDS(
+		ctf_integer(pid_t, tid, tid)
+		ctf_integer(int, prio, prio)
+		ctf_integer(u64, latency, latency)
+	)
+)
+
+#endif /* LTTNG_TRACE_SCHED_WAKEUP_LATENCY_H */
+
+/* This part must be outside protection */
+#include <probes/define_trace.h>
@@ -9,6 +9,26 @@
 #include <linux/netdevice.h>
 #include <linux/version.h>
 
+#ifndef ONCE_LTTNG_SKB_H
+#define ONCE_LTTNG_SKB_H
+
+/*
+ * Flow key of the skb events: the skb is being freed, so only a flow
+ * hash already computed is used, 0 otherwise.
+ */
+static inline u32 __lttng_skb_flow_hash(struct sk_buff *skb)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0))
+	return skb->hash;
+#elif (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35))
+	return skb->rxhash;
+#else
+	return 0;
+#endif
+}
+
+#endif /* ONCE_LTTNG_SKB_H */
+
 /*
  * Tracepoint for free an sk_buff:
  */
@@ -24,6 +44,8 @@ LTTNG_TRACEPOINT_EVENT_MAP(kfree_skb,
 		ctf_integer_hex(void *, skbaddr, skb)
 		ctf_integer_hex(void *, location, location)
 		ctf_integer_network(unsigned short, protocol, skb->protocol)
+		ctf_flow_key(__lttng_skb_flow_hash(skb), skb->len)
+		ctf_summary_key((unsigned long) location, ntohs(skb->protocol))
 	)
 )
 
@@ -38,6 +60,7 @@ LTTNG_TRACEPOINT_EVENT_MAP(consume_skb,
 
 	TP_FIELDS(
 		ctf_integer_hex(void *, skbaddr, skb)
+		ctf_flow_key(__lttng_skb_flow_hash(skb), skb->len)
 	)
 )
 #endif
@@ -0,0 +1,60 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM workqueue_latency
+
+#if !defined(LTTNG_TRACE_WORKQUEUE_LATENCY_H) || defined(TRACE_HEADER_MULTI_READ)
+#define LTTNG_TRACE_WORKQUEUE_LATENCY_H
+
+#include <probes/lttng-tracepoint-event.h>
+#include <linux/types.h>
+
+/**
+ * workqueue_latency_delay - queued work started
+ * @function: work function
+ * @delay: time from its workqueue_queue_work to its
+ *         workqueue_execute_start, in ns
+ *
+ * Emitted by the workqueue latency probe when a work starts executing.
+ * Only needed for histograms of the queue delay.
+ */
+LTTNG_TRACEPOINT_EVENT(workqueue_latency_delay,
+
+	TP_PROTO(void *function, u64 delay),
+
+	TP_ARGS(function, delay),
+
+	TP_FIELDS(
+		ctf_integer_hex(void *, function, function)
+		ctf_integer(u64, delay, delay)
+		ctf_duration((unsigned long) function, delay)
+	)
+)
+
+/**
+ * workqueue_latency_exec - work returned
+ * @function: work function
+ * @delay: time from its workqueue_queue_work to its
+ *         workqueue_execute_start, in ns, 0 if not known
+ * @duration: time from its workqueue_execute_start to its
+ *            workqueue_execute_end, in ns
+ *
+ * Emitted by the workqueue latency probe instead of the four records of
+ * a work item.
+ */
+LTTNG_TRACEPOINT_EVENT(workqueue_latency_exec,
+
+	TP_PROTO(void *function, u64 delay, u64 duration),
+
+	TP_ARGS(function, delay, duration),
+
+	TP_FIELDS(
+		ctf_integer_hex(void *, function, function)
+		ctf_integer(u64, delay, delay)
+		ctf_integer(u64, duration, duration)
+		ctf_duration((unsigned long) function, duration)
+	)
+)
+
+#endif /* LTTNG_TRACE_WORKQUEUE_LATENCY_H */
+
+/* This part must be outside protection */
+#include <probes/define_trace.h>
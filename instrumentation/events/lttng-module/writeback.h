@@ -43,6 +43,12 @@ static inline struct backing_dev_info *lttng_inode_to_bdi(struct inode *inode)
 }
 #endif /* #if (LINUX_VERSION_CODE < KERNEL_VERSION(4,0,0)) */
 
+/* Summary key of the events of a bdi: its device number, 0 if none. */
+static inline dev_t lttng_bdi_devt(struct backing_dev_info *bdi)
+{
+	return bdi && bdi->dev ? bdi->dev->devt : 0;
+}
+
 #endif
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,0,0))
@@ -85,6 +91,8 @@ LTTNG_TRACEPOINT_EVENT(writeback_dirty_page,
 			mapping ? dev_name(lttng_inode_to_bdi(mapping->host)->dev) : "(unknown)", 32)
 		ctf_integer(unsigned long, ino, mapping ? mapping->host->i_ino : 0)
 		ctf_integer(pgoff_t, index, page->index)
+		ctf_summary_key(mapping ?
+			lttng_bdi_devt(lttng_inode_to_bdi(mapping->host)) : 0, 0)
 	)
 )
 
@@ -137,6 +145,8 @@ LTTNG_TRACEPOINT_EVENT(writeback_dirty_page,
 			mapping ? dev_name(mapping->backing_dev_info->dev) : "(unknown)", 32)
 		ctf_integer(unsigned long, ino, mapping ? mapping->host->i_ino : 0)
 		ctf_integer(pgoff_t, index, page->index)
+		ctf_summary_key(mapping ?
+			lttng_bdi_devt(mapping->backing_dev_info) : 0, 0)
 	)
 )
 
@@ -353,6 +363,7 @@ LTTNG_TRACEPOINT_EVENT_CLASS(writeback_wbc_class,
 #endif
 		ctf_integer(long, range_start, (long) wbc->range_start)
 		ctf_integer(long, range_end, (long) wbc->range_end)
+		ctf_summary_key(lttng_bdi_devt(bdi), 0)
 	)
 )
 
@@ -887,4 +887,204 @@ SC_LTTNG_TRACEPOINT_EVENT(socketpair,
 )
 #endif /* (defined(CONFIG_X86_64) && !defined(LTTNG_SC_COMPAT)) || defined(CONFIG_ARM64) || defined(CONFIG_ARM) */
 
+/*
+ * Struct payloads of pointer arguments are copied from user-space with
+ * bounded sizes, without faulting. Compat system calls use the 32-bit
+ * user layouts.
+ */
+#ifndef ONCE_LTTNG_TRACE_SYSCALL_PAYLOADS_H
+#define ONCE_LTTNG_TRACE_SYSCALL_PAYLOADS_H
+
+struct lttng_syscall_timespec {
+	long tv_sec;
+	long tv_nsec;
+};
+
+struct lttng_syscall_compat_timespec {
+	int32_t tv_sec;
+	int32_t tv_nsec;
+};
+
+struct lttng_syscall_iovec {
+	unsigned long iov_base;
+	unsigned long iov_len;
+};
+
+struct lttng_syscall_compat_iovec {
+	uint32_t iov_base;
+	uint32_t iov_len;
+};
+
+/* Maximum number of iovec lengths recorded. */
+#define LTTNG_SYSCALL_IOVEC_MAX_LEN	8
+
+#define LTTNG_SYSCALL_SOCKADDR_LEN(_addrlen)				\
+	((_addrlen) <= 0 ? 0U :						\
+		min_t(unsigned int, (_addrlen), sizeof(struct sockaddr_storage)))
+#endif /* ONCE_LTTNG_TRACE_SYSCALL_PAYLOADS_H */
+
+#undef LTTNG_SYSCALL_TIMESPEC
+#undef LTTNG_SYSCALL_IOVEC
+#ifdef LTTNG_SC_COMPAT
+#define LTTNG_SYSCALL_TIMESPEC	struct lttng_syscall_compat_timespec
+#define LTTNG_SYSCALL_IOVEC	struct lttng_syscall_compat_iovec
+#else
+#define LTTNG_SYSCALL_TIMESPEC	struct lttng_syscall_timespec
+#define LTTNG_SYSCALL_IOVEC	struct lttng_syscall_iovec
+#endif
+
+#define LTTNG_SYSCALL_TIMESPEC_fields(_name, _uts)				\
+	ctf_user_integer(int64_t, _name##_sec,					\
+		((LTTNG_SYSCALL_TIMESPEC __user *) (_uts))->tv_sec)		\
+	ctf_user_integer(long, _name##_nsec,					\
+		((LTTNG_SYSCALL_TIMESPEC __user *) (_uts))->tv_nsec)
+
+#define OVERRIDE_32_nanosleep
+#define OVERRIDE_64_nanosleep
+SC_LTTNG_TRACEPOINT_EVENT(nanosleep,
+	TP_PROTO(sc_exit(long ret,) struct timespec * rqtp, struct timespec * rmtp),
+	TP_ARGS(sc_exit(ret,) rqtp, rmtp),
+	TP_FIELDS(sc_exit(ctf_integer(long, ret, ret))
+		sc_in(ctf_integer_hex(struct timespec *, rqtp, rqtp))
+		sc_in(LTTNG_SYSCALL_TIMESPEC_fields(rqtp, rqtp))
+		sc_out(ctf_integer_hex(struct timespec *, rmtp, rmtp))
+		sc_out(LTTNG_SYSCALL_TIMESPEC_fields(rmtp, rmtp))
+	)
+)
+
+#define OVERRIDE_32_clock_nanosleep
+#define OVERRIDE_64_clock_nanosleep
+SC_LTTNG_TRACEPOINT_EVENT(clock_nanosleep,
+	TP_PROTO(sc_exit(long ret,) const clockid_t which_clock, int flags,
+		const struct timespec * rqtp, struct timespec * rmtp),
+	TP_ARGS(sc_exit(ret,) which_clock, flags, rqtp, rmtp),
+	TP_FIELDS(sc_exit(ctf_integer(long, ret, ret))
+		sc_in(ctf_integer(const clockid_t, which_clock, which_clock))
+		sc_in(ctf_integer(int, flags, flags))
+		sc_in(ctf_integer_hex(const struct timespec *, rqtp, rqtp))
+		sc_in(LTTNG_SYSCALL_TIMESPEC_fields(rqtp, rqtp))
+		sc_out(ctf_integer_hex(struct timespec *, rmtp, rmtp))
+		sc_out(LTTNG_SYSCALL_TIMESPEC_fields(rmtp, rmtp))
+	)
+)
+
+/*
+ * The lengths of the first LTTNG_SYSCALL_IOVEC_MAX_LEN iovec are
+ * recorded on entry; overflow is set when vlen is larger. A fault stops
+ * the copy at the faulting iovec.
+ */
+#define LTTNG_SYSCALL_IOVEC_locvar					\
+	unsigned long iov_len[LTTNG_SYSCALL_IOVEC_MAX_LEN];		\
+	unsigned int iov_length;					\
+	uint8_t overflow;
+
+#define LTTNG_SYSCALL_IOVEC_code_pre						\
+	tp_locvar->iov_length = 0;						\
+	tp_locvar->overflow = 0;						\
+	sc_in(									\
+		{								\
+			const LTTNG_SYSCALL_IOVEC __user *uiov =		\
+				(const LTTNG_SYSCALL_IOVEC __user *) vec;	\
+			LTTNG_SYSCALL_IOVEC iov;				\
+			unsigned int i, nr = vlen;				\
+										\
+			if (vlen > LTTNG_SYSCALL_IOVEC_MAX_LEN) {		\
+				nr = LTTNG_SYSCALL_IOVEC_MAX_LEN;		\
+				tp_locvar->overflow = 1;			\
+			}							\
+			for (i = 0; i < nr; i++) {				\
+				if (lib_ring_buffer_copy_from_user_check_nofault(\
+						&iov, &uiov[i], sizeof(iov)))	\
+					break;					\
+				tp_locvar->iov_len[i] = iov.iov_len;		\
+			}							\
+			tp_locvar->iov_length = i;				\
+		}								\
+	)
+
+#define LTTNG_SYSCALL_IOVEC_fields						\
+	sc_in(ctf_integer(uint8_t, overflow, tp_locvar->overflow))		\
+	sc_in(ctf_sequence(unsigned long, iov_len, tp_locvar->iov_len,		\
+		unsigned int, tp_locvar->iov_length))
+
+#define OVERRIDE_32_readv
+#define OVERRIDE_64_readv
+SC_LTTNG_TRACEPOINT_EVENT_CODE(readv,
+	TP_PROTO(sc_exit(long ret,) unsigned long fd, const struct iovec * vec,
+		unsigned long vlen),
+	TP_ARGS(sc_exit(ret,) fd, vec, vlen),
+	TP_locvar(
+		LTTNG_SYSCALL_IOVEC_locvar
+	),
+	TP_code_pre(
+		LTTNG_SYSCALL_IOVEC_code_pre
+	),
+	TP_FIELDS(
+		sc_exit(ctf_integer(long, ret, ret))
+		sc_in(ctf_integer(unsigned long, fd, fd))
+		sc_inout(ctf_integer_hex(const struct iovec *, vec, vec))
+		sc_in(ctf_integer(unsigned long, vlen, vlen))
+		LTTNG_SYSCALL_IOVEC_fields
+	),
+	TP_code_post()
+)
+
+#define OVERRIDE_32_writev
+#define OVERRIDE_64_writev
+SC_LTTNG_TRACEPOINT_EVENT_CODE(writev,
+	TP_PROTO(sc_exit(long ret,) unsigned long fd, const struct iovec * vec,
+		unsigned long vlen),
+	TP_ARGS(sc_exit(ret,) fd, vec, vlen),
+	TP_locvar(
+		LTTNG_SYSCALL_IOVEC_locvar
+	),
+	TP_code_pre(
+		LTTNG_SYSCALL_IOVEC_code_pre
+	),
+	TP_FIELDS(
+		sc_exit(ctf_integer(long, ret, ret))
+		sc_in(ctf_integer(unsigned long, fd, fd))
+		sc_inout(ctf_integer_hex(const struct iovec *, vec, vec))
+		sc_in(ctf_integer(unsigned long, vlen, vlen))
+		LTTNG_SYSCALL_IOVEC_fields
+	),
+	TP_code_post()
+)
+
+#if (defined(CONFIG_X86_64) && !defined(LTTNG_SC_COMPAT)) || defined(CONFIG_ARM64) || defined(CONFIG_ARM)
+#define OVERRIDE_32_bind
+#define OVERRIDE_64_bind
+SC_LTTNG_TRACEPOINT_EVENT(bind,
+	TP_PROTO(sc_exit(long ret,) int fd, struct sockaddr * umyaddr, int addrlen),
+	TP_ARGS(sc_exit(ret,) fd, umyaddr, addrlen),
+	TP_FIELDS(
+		sc_exit(ctf_integer(long, ret, ret))
+		sc_in(ctf_integer(int, fd, fd))
+		sc_in(ctf_integer_hex(struct sockaddr *, umyaddr, umyaddr))
+		sc_in(ctf_integer(int, addrlen, addrlen))
+		sc_in(ctf_user_sequence(uint8_t, addr, umyaddr,
+			unsigned int, LTTNG_SYSCALL_SOCKADDR_LEN(addrlen)))
+	)
+)
+
+#define OVERRIDE_32_sendto
+#define OVERRIDE_64_sendto
+SC_LTTNG_TRACEPOINT_EVENT(sendto,
+	TP_PROTO(sc_exit(long ret,) int fd, void * buff, size_t len,
+		unsigned int flags, struct sockaddr * addr, int addr_len),
+	TP_ARGS(sc_exit(ret,) fd, buff, len, flags, addr, addr_len),
+	TP_FIELDS(
+		sc_exit(ctf_integer(long, ret, ret))
+		sc_in(ctf_integer(int, fd, fd))
+		sc_in(ctf_integer_hex(void *, buff, buff))
+		sc_in(ctf_integer(size_t, len, len))
+		sc_in(ctf_integer(unsigned int, flags, flags))
+		sc_in(ctf_integer_hex(struct sockaddr *, addr, addr))
+		sc_in(ctf_integer(int, addr_len, addr_len))
+		sc_in(ctf_user_sequence(uint8_t, dest_addr, addr,
+			unsigned int, LTTNG_SYSCALL_SOCKADDR_LEN(addr_len)))
+	)
+)
+#endif /* (defined(CONFIG_X86_64) && !defined(LTTNG_SC_COMPAT)) || defined(CONFIG_ARM64) || defined(CONFIG_ARM) */
+
 #endif /* CREATE_SYSCALL_TABLE */
@@ -47,6 +47,26 @@ LTTNG_TRACEPOINT_EVENT(compat_syscall_exit_unknown,
 		ctf_array(unsigned long, args, args, UNKNOWN_SYSCALL_NRARGS)
 	)
 )
+
+/* Emitted at exit in place of the entry and exit records. */
+LTTNG_TRACEPOINT_EVENT(syscall_latency,
+	TP_PROTO(int id, long ret, uint64_t duration),
+	TP_ARGS(id, ret, duration),
+	TP_FIELDS(
+		ctf_integer(int, id, id)
+		ctf_integer(long, ret, ret)
+		ctf_integer(uint64_t, duration, duration)
+	)
+)
+LTTNG_TRACEPOINT_EVENT(compat_syscall_latency,
+	TP_PROTO(int id, long ret, uint64_t duration),
+	TP_ARGS(id, ret, duration),
+	TP_FIELDS(
+		ctf_integer(int, id, id)
+		ctf_integer(long, ret, ret)
+		ctf_integer(uint64_t, duration, duration)
+	)
+)
 #endif /*  _TRACE_SYSCALLS_UNKNOWN_H */
 
 /* This part must be outside protection */
@@ -0,0 +1,55 @@
+#!/bin/sh
+
+# Extract the system call metadata of the running kernel and generate the
+# integers and pointers system call headers of its architecture from it.
+# Must be run as root from the instrumentation/syscalls directory, on a
+# kernel configured as described in the README. The headers still need
+# to be selected in headers/syscalls_integers.h and syscalls_pointers.h.
+#
+# example usage:
+#
+# lttng-syscalls-extract-headers.sh <arch> <bitness> [<kernel_build_dir>]
+# lttng-syscalls-extract-headers.sh arm-64 64
+# lttng-syscalls-extract-headers.sh x86-64 64 /usr/src/linux
+
+ARCH=$1
+BITNESS=$2
+KERNELDIR=${3:-/lib/modules/$(uname -r)/build}
+KVERSION=$(uname -r | sed 's/[^0-9.].*//')
+EXTRACTOR=lttng-syscalls-extractor
+INPUTFILE=${ARCH}-syscalls-${KVERSION}
+
+if [ x"$ARCH" = x"" ]; then
+	echo "Error: Please specify architecture as first argument (e.g. \"x86-64\")"
+	exit 1
+fi
+
+if [ x"$BITNESS" != x"32" ] && [ x"$BITNESS" != x"64" ]; then
+	echo "Error: Please specify bitness as second argument (\"32\" or \"64\")"
+	exit 1
+fi
+
+make -C ${KERNELDIR} M=$(pwd)/${EXTRACTOR} modules || exit 1
+
+# The extractor module always fails to load once the metadata is dumped.
+dmesg -C
+insmod ${EXTRACTOR}/${EXTRACTOR}.ko
+make -C ${KERNELDIR} M=$(pwd)/${EXTRACTOR} clean
+
+mkdir -p ${KVERSION}
+dmesg | sed -n '/\] BEGIN$/,/\] SUCCESS$/p' | sed '1d;$d' > ${KVERSION}/${INPUTFILE}
+
+if [ ! -s ${KVERSION}/${INPUTFILE} ]; then
+	echo "Error: No system call metadata found in the kernel log"
+	rm -f ${KVERSION}/${INPUTFILE}
+	exit 1
+fi
+
+for CLASS in integers pointers; do
+	sh lttng-syscalls-generate-headers.sh ${CLASS} ${KVERSION} ${INPUTFILE} ${BITNESS} || exit 1
+	# Architectures without overrides still need an override header.
+	if [ ! -e headers/${INPUTFILE}_${CLASS}_override.h ]; then
+		printf '/*\n * this is a place-holder for %s %s syscall definition override.\n */\n' \
+			${ARCH} ${CLASS} > headers/${INPUTFILE}_${CLASS}_override.h
+	fi
+done
@@ -29,9 +29,17 @@
 #include <linux/slab.h>
 #include <linux/kallsyms.h>
 #include <linux/dcache.h>
+#include <linux/version.h>
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,5,0))
+#include <linux/trace_events.h>
+#else
 #include <linux/ftrace_event.h>
+#endif
 #include <trace/syscall.h>
 #include <asm/syscall.h>
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,7,0))
+#include <linux/kprobes.h>
+#endif
 
 #ifndef CONFIG_FTRACE_SYSCALLS
 #error "You need to set CONFIG_FTRACE_SYSCALLS=y"
@@ -44,6 +52,28 @@
 static struct syscall_metadata **__start_syscalls_metadata;
 static struct syscall_metadata **__stop_syscalls_metadata;
 
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,7,0))
+/* kallsyms_lookup_name is not exported anymore: find it with a kprobe. */
+static __init
+unsigned long extractor_lookup_name(const char *name)
+{
+	unsigned long (*lookup)(const char *name);
+	struct kprobe kp = { .symbol_name = "kallsyms_lookup_name" };
+
+	if (register_kprobe(&kp) < 0)
+		return 0;
+	lookup = (void *) kp.addr;
+	unregister_kprobe(&kp);
+	return lookup(name);
+}
+#else
+static __init
+unsigned long extractor_lookup_name(const char *name)
+{
+	return kallsyms_lookup_name(name);
+}
+#endif
+
 static __init
 struct syscall_metadata *find_syscall_meta(unsigned long syscall)
 {
@@ -62,9 +92,13 @@ int init_module(void)
 	struct syscall_metadata *meta;
 	int i;
 
-	__start_syscalls_metadata = (void *) kallsyms_lookup_name("__start_syscalls_metadata");
-	__stop_syscalls_metadata = (void *) kallsyms_lookup_name("__stop_syscalls_metadata");
+	__start_syscalls_metadata = (void *) extractor_lookup_name("__start_syscalls_metadata");
+	__stop_syscalls_metadata = (void *) extractor_lookup_name("__stop_syscalls_metadata");
+
+	if (!__start_syscalls_metadata || !__stop_syscalls_metadata)
+		return -ENOENT;
 
+	printk("BEGIN\n");
 	for (i = 0; i < NR_syscalls; i++) {
 		int j;
 
@@ -0,0 +1,127 @@
+/*
+ * lttng_tournament_tree.c
+ *
+ * Tournament tree of pointers keyed by 64-bit values, lowest key first.
+ *
+ * Copyright 2026 - agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <linux/slab.h>
+#include <linux/log2.h>
+#include <lib/prio_heap/lttng_tournament_tree.h>
+
+/*
+ * Present leaves win over absent ones, lowest key first, lowest leaf index
+ * on equal keys so the order is total.
+ */
+static
+int leaf_wins(const struct lttng_tournament_tree *tree,
+		unsigned int a, unsigned int b)
+{
+	const struct lttng_tournament_leaf *la = &tree->leaves[a],
+		*lb = &tree->leaves[b];
+
+	if (!la->ptr)
+		return 0;
+	if (!lb->ptr)
+		return 1;
+	if (la->key != lb->key)
+		return la->key < lb->key;
+	return a < b;
+}
+
+/* Winning leaf of the subtree rooted at node i. */
+static
+unsigned int subtree_winner(const struct lttng_tournament_tree *tree,
+		unsigned int i)
+{
+	return i >= tree->nr_leaves ? i - tree->nr_leaves : tree->nodes[i];
+}
+
+/*
+ * The runner-up lost a match to the winner, against the winner of one of
+ * the sibling subtrees along the winner's path.
+ */
+static
+void update_runner_up(struct lttng_tournament_tree *tree)
+{
+	unsigned int winner = tree->nodes[1], runner_up = winner, node;
+
+	for (node = winner + tree->nr_leaves; node > 1; node >>= 1) {
+		unsigned int sibling = subtree_winner(tree, node ^ 1);
+
+		if (runner_up == winner || leaf_wins(tree, sibling, runner_up))
+			runner_up = sibling;
+	}
+	tree->runner_up = runner_up;
+}
+
+int lttng_tournament_tree_init(struct lttng_tournament_tree *tree,
+		unsigned int nr_leaves, gfp_t gfpmask)
+{
+	unsigned int node;
+
+	tree->nr_leaves = roundup_pow_of_two(max(nr_leaves, 1U));
+	tree->nodes = kcalloc(max(tree->nr_leaves, 2U), sizeof(*tree->nodes),
+			gfpmask);
+	if (!tree->nodes)
+		return -ENOMEM;
+	tree->leaves = kcalloc(tree->nr_leaves, sizeof(*tree->leaves),
+			gfpmask);
+	if (!tree->leaves) {
+		kfree(tree->nodes);
+		return -ENOMEM;
+	}
+	/* All leaves are absent: the leftmost leaf wins each subtree. */
+	for (node = tree->nr_leaves - 1; node >= 1; node--)
+		tree->nodes[node] = subtree_winner(tree, node << 1);
+	tree->runner_up = 0;
+	return 0;
+}
+
+void lttng_tournament_tree_free(struct lttng_tournament_tree *tree)
+{
+	kfree(tree->nodes);
+	kfree(tree->leaves);
+}
+
+void lttng_tournament_tree_update(struct lttng_tournament_tree *tree,
+		unsigned int leaf, void *p, u64 key)
+{
+	unsigned int node;
+
+	tree->leaves[leaf].ptr = p;
+	tree->leaves[leaf].key = key;
+	/*
+	 * Fast path for runs of elements from the same leaf: the winner
+	 * keeps winning as long as it does not pass the runner-up.
+	 */
+	if (p && leaf == tree->nodes[1]
+			&& !leaf_wins(tree, tree->runner_up, leaf))
+		return;
+	for (node = (leaf + tree->nr_leaves) >> 1; node >= 1; node >>= 1) {
+		unsigned int l = subtree_winner(tree, node << 1),
+			r = subtree_winner(tree, (node << 1) + 1);
+
+		tree->nodes[node] = leaf_wins(tree, r, l) ? r : l;
+	}
+	update_runner_up(tree);
+}
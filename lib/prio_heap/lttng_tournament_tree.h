@@ -0,0 +1,107 @@
+#ifndef _LTTNG_TOURNAMENT_TREE_H
+#define _LTTNG_TOURNAMENT_TREE_H
+
+/*
+ * lttng_tournament_tree.h
+ *
+ * Tournament tree of pointers keyed by 64-bit values, lowest key first.
+ *
+ * Copyright 2026 - agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <linux/types.h>
+#include <linux/gfp.h>
+
+/*
+ * One leaf per source (e.g. per cpu), present or not. Internal nodes hold
+ * the index of the leaf winning their subtree, so updating any leaf costs
+ * log2(nr_leaves) comparisons over two small arrays, without dereferencing
+ * the elements. The runner-up of the current winner is kept, so a winner
+ * whose key grows without passing the runner-up is updated in O(1).
+ */
+struct lttng_tournament_leaf {
+	u64 key;
+	void *ptr;			/* NULL if the leaf is absent */
+};
+
+struct lttng_tournament_tree {
+	unsigned int nr_leaves;		/* Power of two */
+	unsigned int runner_up;		/* Leaf closest to the winner */
+	unsigned int *nodes;		/* nodes[1]: winner, [0] unused */
+	struct lttng_tournament_leaf *leaves;
+};
+
+/**
+ * lttng_tournament_tree_init - initialize the tree
+ * @tree: the tree to initialize
+ * @nr_leaves: number of leaves, rounded up to a power of two
+ * @gfp: allocation flags
+ *
+ * All leaves start absent. Returns -ENOMEM if out of memory.
+ */
+extern int lttng_tournament_tree_init(struct lttng_tournament_tree *tree,
+		unsigned int nr_leaves, gfp_t gfpmask);
+
+/**
+ * lttng_tournament_tree_free - free the tree
+ * @tree: the tree to free
+ */
+extern void lttng_tournament_tree_free(struct lttng_tournament_tree *tree);
+
+/**
+ * lttng_tournament_tree_update - set, re-key or remove a leaf
+ * @tree: the tree to be operated on
+ * @leaf: the leaf index
+ * @p: the element, or NULL to remove the leaf
+ * @key: the element key
+ *
+ * Never allocates memory.
+ */
+extern void lttng_tournament_tree_update(struct lttng_tournament_tree *tree,
+		unsigned int leaf, void *p, u64 key);
+
+/**
+ * lttng_tournament_tree_top - return the element with the lowest key
+ * @tree: the tree to be operated on
+ *
+ * Returns NULL if all leaves are absent.
+ */
+static inline
+void *lttng_tournament_tree_top(const struct lttng_tournament_tree *tree)
+{
+	return tree->leaves[tree->nodes[1]].ptr;
+}
+
+/**
+ * lttng_tournament_tree_get - return the element of a leaf
+ * @tree: the tree to be operated on
+ * @leaf: the leaf index
+ *
+ * Returns NULL if the leaf is absent.
+ */
+static inline
+void *lttng_tournament_tree_get(const struct lttng_tournament_tree *tree,
+		unsigned int leaf)
+{
+	return tree->leaves[leaf].ptr;
+}
+
+#endif /* _LTTNG_TOURNAMENT_TREE_H */
@@ -35,6 +35,7 @@
 #include <linux/fs.h>
 #include <linux/mm.h>
 #include <linux/uaccess.h>
+#include <linux/string.h>
 
 /* Internal helpers */
 #include <wrapper/ringbuffer/backend_internal.h>
@@ -44,6 +45,9 @@
 
 /* Ring buffer backend access (read/write) */
 
+extern unsigned long lib_ring_buffer_backend_get_pages(
+		struct lib_ring_buffer_backend *bufb);
+
 extern size_t lib_ring_buffer_read(struct lib_ring_buffer_backend *bufb,
 				   size_t offset, void *dest, size_t len);
 
@@ -51,6 +55,10 @@ extern int __lib_ring_buffer_copy_to_user(struct lib_ring_buffer_backend *bufb,
 					  size_t offset, void __user *dest,
 					  size_t len);
 
+extern int lib_ring_buffer_copy_wsb_to_user(struct lib_ring_buffer_backend *bufb,
+					    size_t offset, void __user *dest,
+					    size_t len);
+
 extern int lib_ring_buffer_read_cstr(struct lib_ring_buffer_backend *bufb,
 				     size_t offset, void *dest, size_t len);
 
@@ -81,7 +89,7 @@ lib_ring_buffer_read_offset_address(struct lib_ring_buffer_backend *bufb,
  * This function copies "len" bytes of data from a source pointer to a buffer
  * backend, at the current context offset. This is more or less a buffer
  * backend-specific memcpy() operation. Calls the slow path (_ring_buffer_write)
- * if copy is crossing a page boundary.
+ * if copy is crossing a page boundary, unless sub-buffers are contiguous.
  */
 static inline __attribute__((always_inline))
 void lib_ring_buffer_write(const struct lib_ring_buffer_config *config,
@@ -101,7 +109,8 @@ void lib_ring_buffer_write(const struct lib_ring_buffer_config *config,
 	offset &= chanb->buf_size - 1;
 	index = (offset & (chanb->subbuf_size - 1)) >> PAGE_SHIFT;
 	pagecpy = min_t(size_t, len, (-offset) & ~PAGE_MASK);
-	if (likely(pagecpy == len))
+	if (likely(pagecpy == len)
+			|| lib_ring_buffer_backend_contig(config))
 		lib_ring_buffer_do_copy(config,
 					backend_pages->p[index].virt
 					    + (offset & ~PAGE_MASK),
@@ -142,7 +151,8 @@ void lib_ring_buffer_memset(const struct lib_ring_buffer_config *config,
 	offset &= chanb->buf_size - 1;
 	index = (offset & (chanb->subbuf_size - 1)) >> PAGE_SHIFT;
 	pagecpy = min_t(size_t, len, (-offset) & ~PAGE_MASK);
-	if (likely(pagecpy == len))
+	if (likely(pagecpy == len)
+			|| lib_ring_buffer_backend_contig(config))
 		lib_ring_buffer_do_memset(backend_pages->p[index].virt
 					  + (offset & ~PAGE_MASK),
 					  c, len);
@@ -183,6 +193,12 @@ size_t lib_ring_buffer_do_strcpy(const struct lib_ring_buffer_config *config,
  * Returns the number of bytes copied. Does *not* terminate @dest with
  * NULL terminating character.
  *
+ * The @len bytes are copied at once and the string end is then looked
+ * for in @dest, so @dest content past the returned count is undefined
+ * and the caller pads it. @len is sized by a prior length measurement of
+ * the string, so this does not read user memory past the pages it
+ * spans.
+ *
  * This function deals with userspace pointers, it should never be called
  * directly without having the src pointer checked with access_ok()
  * previously.
@@ -191,18 +207,12 @@ static inline __attribute__((always_inline))
 size_t lib_ring_buffer_do_strcpy_from_user_inatomic(const struct lib_ring_buffer_config *config,
 		char *dest, const char __user *src, size_t len)
 {
-	size_t count;
+	size_t copied;
 
-	for (count = 0; count < len; count++) {
-		int ret;
-		char c;
-
-		ret = __copy_from_user_inatomic(&c, src + count, 1);
-		if (ret || !c)
-			break;
-		lib_ring_buffer_do_copy(config, &dest[count], &c, 1);
-	}
-	return count;
+	if (unlikely(!len))
+		return 0;
+	copied = len - __copy_from_user_inatomic(dest, src, len);
+	return strnlen(dest, copied);
 }
 
 /**
@@ -239,27 +249,19 @@ void lib_ring_buffer_strcpy(const struct lib_ring_buffer_config *config,
 	offset &= chanb->buf_size - 1;
 	index = (offset & (chanb->subbuf_size - 1)) >> PAGE_SHIFT;
 	pagecpy = min_t(size_t, len, (-offset) & ~PAGE_MASK);
-	if (likely(pagecpy == len)) {
+	if (likely(pagecpy == len)
+			|| lib_ring_buffer_backend_contig(config)) {
+		char *dest = backend_pages->p[index].virt
+				+ (offset & ~PAGE_MASK);
 		size_t count;
 
-		count = lib_ring_buffer_do_strcpy(config,
-					backend_pages->p[index].virt
-					    + (offset & ~PAGE_MASK),
-					src, len - 1);
-		offset += count;
+		count = lib_ring_buffer_do_strcpy(config, dest, src, len - 1);
 		/* Padding */
-		if (unlikely(count < len - 1)) {
-			size_t pad_len = len - 1 - count;
-
-			lib_ring_buffer_do_memset(backend_pages->p[index].virt
-						+ (offset & ~PAGE_MASK),
-					pad, pad_len);
-			offset += pad_len;
-		}
+		if (unlikely(count < len - 1))
+			lib_ring_buffer_do_memset(dest + count, pad,
+					len - 1 - count);
 		/* Ending '\0' */
-		lib_ring_buffer_do_memset(backend_pages->p[index].virt
-					+ (offset & ~PAGE_MASK),
-				'\0', 1);
+		lib_ring_buffer_do_memset(dest + len - 1, '\0', 1);
 	} else {
 		_lib_ring_buffer_strcpy(bufb, offset, src, len, 0, pad);
 	}
@@ -267,7 +269,7 @@ void lib_ring_buffer_strcpy(const struct lib_ring_buffer_config *config,
 }
 
 /**
- * lib_ring_buffer_copy_from_user_inatomic - write userspace data to a buffer backend
+ * lib_ring_buffer_copy_from_user_uaccess - write userspace data to a buffer backend
  * @config : ring buffer instance configuration
  * @ctx: ring buffer context. (input arguments only)
  * @src : userspace source pointer to copy from
@@ -277,10 +279,11 @@ void lib_ring_buffer_strcpy(const struct lib_ring_buffer_config *config,
  * buffer backend, at the current context offset. This is more or less a buffer
  * backend-specific memcpy() operation. Calls the slow path
  * (_ring_buffer_write_from_user_inatomic) if copy is crossing a page boundary.
- * Disable the page fault handler to ensure we never try to take the mmap_sem.
+ * Must be called with page faults disabled, so we never try to take the
+ * mmap_sem: this lets the caller copy several fields within one section.
  */
 static inline __attribute__((always_inline))
-void lib_ring_buffer_copy_from_user_inatomic(const struct lib_ring_buffer_config *config,
+void lib_ring_buffer_copy_from_user_uaccess(const struct lib_ring_buffer_config *config,
 				    struct lib_ring_buffer_ctx *ctx,
 				    const void __user *src, size_t len)
 {
@@ -290,7 +293,6 @@ void lib_ring_buffer_copy_from_user_inatomic(const struct lib_ring_buffer_config
 	size_t offset = ctx->buf_offset;
 	struct lib_ring_buffer_backend_pages *backend_pages;
 	unsigned long ret;
-	mm_segment_t old_fs = get_fs();
 
 	if (unlikely(!len))
 		return;
@@ -300,12 +302,11 @@ void lib_ring_buffer_copy_from_user_inatomic(const struct lib_ring_buffer_config
 	index = (offset & (chanb->subbuf_size - 1)) >> PAGE_SHIFT;
 	pagecpy = min_t(size_t, len, (-offset) & ~PAGE_MASK);
 
-	set_fs(KERNEL_DS);
-	pagefault_disable();
 	if (unlikely(!access_ok(VERIFY_READ, src, len)))
 		goto fill_buffer;
 
-	if (likely(pagecpy == len)) {
+	if (likely(pagecpy == len)
+			|| lib_ring_buffer_backend_contig(config)) {
 		ret = lib_ring_buffer_do_copy_from_user_inatomic(
 			backend_pages->p[index].virt + (offset & ~PAGE_MASK),
 			src, len);
@@ -316,15 +317,11 @@ void lib_ring_buffer_copy_from_user_inatomic(const struct lib_ring_buffer_config
 	} else {
 		_lib_ring_buffer_copy_from_user_inatomic(bufb, offset, src, len, 0);
 	}
-	pagefault_enable();
-	set_fs(old_fs);
 	ctx->buf_offset += len;
 
 	return;
 
 fill_buffer:
-	pagefault_enable();
-	set_fs(old_fs);
 	/*
 	 * In the error path we call the slow path version to avoid
 	 * the pollution of static inline code.
@@ -332,8 +329,26 @@ fill_buffer:
 	_lib_ring_buffer_memset(bufb, offset, 0, len, 0);
 }
 
+/*
+ * As lib_ring_buffer_copy_from_user_uaccess, disabling the page fault
+ * handler around the copy.
+ */
+static inline __attribute__((always_inline))
+void lib_ring_buffer_copy_from_user_inatomic(const struct lib_ring_buffer_config *config,
+				    struct lib_ring_buffer_ctx *ctx,
+				    const void __user *src, size_t len)
+{
+	mm_segment_t old_fs = get_fs();
+
+	set_fs(KERNEL_DS);
+	pagefault_disable();
+	lib_ring_buffer_copy_from_user_uaccess(config, ctx, src, len);
+	pagefault_enable();
+	set_fs(old_fs);
+}
+
 /**
- * lib_ring_buffer_strcpy_from_user_inatomic - write userspace string data to a buffer backend
+ * lib_ring_buffer_strcpy_from_user_uaccess - write userspace string data to a buffer backend
  * @config : ring buffer instance configuration
  * @ctx: ring buffer context (input arguments only)
  * @src : userspace source pointer to copy from
@@ -347,11 +362,11 @@ fill_buffer:
  * character is found in @src before @len - 1 characters are copied, pad
  * the buffer with @pad characters (e.g. '#'). Calls the slow path
  * (_ring_buffer_strcpy_from_user_inatomic) if copy is crossing a page
- * boundary. Disable the page fault handler to ensure we never try to
- * take the mmap_sem.
+ * boundary. Must be called with page faults disabled, so we never try
+ * to take the mmap_sem.
  */
 static inline
-void lib_ring_buffer_strcpy_from_user_inatomic(const struct lib_ring_buffer_config *config,
+void lib_ring_buffer_strcpy_from_user_uaccess(const struct lib_ring_buffer_config *config,
 		struct lib_ring_buffer_ctx *ctx,
 		const void __user *src, size_t len, int pad)
 {
@@ -360,7 +375,6 @@ void lib_ring_buffer_strcpy_from_user_inatomic(const struct lib_ring_buffer_conf
 	size_t index, pagecpy;
 	size_t offset = ctx->buf_offset;
 	struct lib_ring_buffer_backend_pages *backend_pages;
-	mm_segment_t old_fs = get_fs();
 
 	if (unlikely(!len))
 		return;
@@ -370,45 +384,31 @@ void lib_ring_buffer_strcpy_from_user_inatomic(const struct lib_ring_buffer_conf
 	index = (offset & (chanb->subbuf_size - 1)) >> PAGE_SHIFT;
 	pagecpy = min_t(size_t, len, (-offset) & ~PAGE_MASK);
 
-	set_fs(KERNEL_DS);
-	pagefault_disable();
 	if (unlikely(!access_ok(VERIFY_READ, src, len)))
 		goto fill_buffer;
 
-	if (likely(pagecpy == len)) {
+	if (likely(pagecpy == len)
+			|| lib_ring_buffer_backend_contig(config)) {
+		char *dest = backend_pages->p[index].virt
+				+ (offset & ~PAGE_MASK);
 		size_t count;
 
-		count = lib_ring_buffer_do_strcpy_from_user_inatomic(config,
-					backend_pages->p[index].virt
-					    + (offset & ~PAGE_MASK),
-					src, len - 1);
-		offset += count;
+		count = lib_ring_buffer_do_strcpy_from_user_inatomic(config, dest, src, len - 1);
 		/* Padding */
-		if (unlikely(count < len - 1)) {
-			size_t pad_len = len - 1 - count;
-
-			lib_ring_buffer_do_memset(backend_pages->p[index].virt
-						+ (offset & ~PAGE_MASK),
-					pad, pad_len);
-			offset += pad_len;
-		}
+		if (unlikely(count < len - 1))
+			lib_ring_buffer_do_memset(dest + count, pad,
+					len - 1 - count);
 		/* Ending '\0' */
-		lib_ring_buffer_do_memset(backend_pages->p[index].virt
-					+ (offset & ~PAGE_MASK),
-				'\0', 1);
+		lib_ring_buffer_do_memset(dest + len - 1, '\0', 1);
 	} else {
 		_lib_ring_buffer_strcpy_from_user_inatomic(bufb, offset, src,
 					len, 0, pad);
 	}
-	pagefault_enable();
-	set_fs(old_fs);
 	ctx->buf_offset += len;
 
 	return;
 
 fill_buffer:
-	pagefault_enable();
-	set_fs(old_fs);
 	/*
 	 * In the error path we call the slow path version to avoid
 	 * the pollution of static inline code.
@@ -418,6 +418,24 @@ fill_buffer:
 	_lib_ring_buffer_memset(bufb, offset, '\0', 1, 0);
 }
 
+/*
+ * As lib_ring_buffer_strcpy_from_user_uaccess, disabling the page fault
+ * handler around the copy.
+ */
+static inline
+void lib_ring_buffer_strcpy_from_user_inatomic(const struct lib_ring_buffer_config *config,
+		struct lib_ring_buffer_ctx *ctx,
+		const void __user *src, size_t len, int pad)
+{
+	mm_segment_t old_fs = get_fs();
+
+	set_fs(KERNEL_DS);
+	pagefault_disable();
+	lib_ring_buffer_strcpy_from_user_uaccess(config, ctx, src, len, pad);
+	pagefault_enable();
+	set_fs(old_fs);
+}
+
 /*
  * This accessor counts the number of unread records in a buffer.
  * It only provides a consistent value if no reads not writes are performed
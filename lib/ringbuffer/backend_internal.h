@@ -36,12 +36,15 @@
 int lib_ring_buffer_backend_create(struct lib_ring_buffer_backend *bufb,
 				   struct channel_backend *chan, int cpu);
 void channel_backend_unregister_notifiers(struct channel_backend *chanb);
+void channel_backend_stop_deferred_create(struct channel_backend *chanb);
 void lib_ring_buffer_backend_free(struct lib_ring_buffer_backend *bufb);
 int channel_backend_init(struct channel_backend *chanb,
 			 const char *name,
 			 const struct lib_ring_buffer_config *config,
 			 void *priv, size_t subbuf_size,
-			 size_t num_subbuf);
+			 size_t num_subbuf,
+			 const struct cpumask *alloc_cpumask,
+			 struct lib_ring_buffer_page_pool *page_pool);
 void channel_backend_free(struct channel_backend *chanb);
 
 void lib_ring_buffer_backend_reset(struct lib_ring_buffer_backend *bufb);
@@ -66,6 +69,20 @@ extern void _lib_ring_buffer_strcpy_from_user_inatomic(struct lib_ring_buffer_ba
 		size_t offset, const char __user *src, size_t len,
 		size_t pagecpy, int pad);
 
+/*
+ * Return 1 if the pages of each sub-buffer are contiguous in the kernel
+ * address space, so accesses within a sub-buffer never need to handle page
+ * crossing. The backend is a compile-time constant of the client
+ * configuration, so this is resolved at compile time.
+ */
+static inline
+int lib_ring_buffer_backend_contig(const struct lib_ring_buffer_config *config)
+{
+	return config->backend == RING_BUFFER_PAGE_CONTIG
+		|| config->backend == RING_BUFFER_VMAP
+		|| config->backend == RING_BUFFER_STATIC;
+}
+
 /*
  * Subbuffer ID bits for overwrite mode. Need to fit within a single word to be
  * exchanged atomically.
@@ -137,6 +154,28 @@ unsigned long subbuffer_id_get_index(const struct lib_ring_buffer_config *config
 		return id;
 }
 
+/*
+ * Return 1 if the pages of sub-buffer "idx" can be written to. Only
+ * RING_BUFFER_PAGE_LAZY buffers have sub-buffers without pages. Reads
+ * the pages after the populated flag.
+ */
+static inline
+int lib_ring_buffer_backend_populated(const struct lib_ring_buffer_config *config,
+				      struct lib_ring_buffer_backend *bufb,
+				      unsigned long idx)
+{
+	unsigned long sb_bindex;
+
+	if (config->backend != RING_BUFFER_PAGE_LAZY)
+		return 1;
+	sb_bindex = subbuffer_id_get_index(config,
+			ACCESS_ONCE(bufb->buf_wsb[idx].id));
+	if (!ACCESS_ONCE(bufb->array[sb_bindex]->populated))
+		return 0;
+	smp_rmb();
+	return 1;
+}
+
 static inline
 unsigned long subbuffer_id_is_noref(const struct lib_ring_buffer_config *config,
 				    unsigned long id)
@@ -234,7 +273,9 @@ struct lib_ring_buffer_backend_pages *
 
 /*
  * The ring buffer can count events recorded and overwritten per buffer,
- * but it is disabled by default due to its performance overhead.
+ * but it is disabled by default due to its performance overhead. Channels
+ * set with lib_ring_buffer_channel_set_no_record_count() are not counted
+ * even then.
  */
 #ifdef LTTNG_RING_BUFFER_COUNT_EVENTS
 static inline
@@ -244,9 +285,24 @@ void subbuffer_count_record(const struct lib_ring_buffer_config *config,
 {
 	unsigned long sb_bindex;
 
+	if (unlikely(bufb->chan->no_record_count))
+		return;
 	sb_bindex = subbuffer_id_get_index(config, bufb->buf_wsb[idx].id);
 	v_inc(config, &bufb->array[sb_bindex]->records_commit);
 }
+
+static inline
+void subbuffer_count_records(const struct lib_ring_buffer_config *config,
+			     struct lib_ring_buffer_backend *bufb,
+			     unsigned long idx, unsigned int nr)
+{
+	unsigned long sb_bindex;
+
+	if (unlikely(bufb->chan->no_record_count))
+		return;
+	sb_bindex = subbuffer_id_get_index(config, bufb->buf_wsb[idx].id);
+	v_add(config, nr, &bufb->array[sb_bindex]->records_commit);
+}
 #else /* LTTNG_RING_BUFFER_COUNT_EVENTS */
 static inline
 void subbuffer_count_record(const struct lib_ring_buffer_config *config,
@@ -254,6 +310,13 @@ void subbuffer_count_record(const struct lib_ring_buffer_config *config,
 			    unsigned long idx)
 {
 }
+
+static inline
+void subbuffer_count_records(const struct lib_ring_buffer_config *config,
+			     struct lib_ring_buffer_backend *bufb,
+			     unsigned long idx, unsigned int nr)
+{
+}
 #endif /* #else LTTNG_RING_BUFFER_COUNT_EVENTS */
 
 /*
@@ -433,6 +496,46 @@ void lib_ring_buffer_set_noref_offset(const struct lib_ring_buffer_config *confi
 	subbuffer_id_set_noref_offset(config, &bufb->buf_wsb[idx].id, offset);
 }
 
+/**
+ * exchange_sb_index - Exchange a writer subbuffer with a reader-owned one.
+ *
+ * Overwrite mode only. Fails with -EAGAIN if the writer subbuffer is in use,
+ * or does not hold the expected consumed count.
+ */
+static inline
+int exchange_sb_index(const struct lib_ring_buffer_config *config,
+		      struct lib_ring_buffer_backend *bufb,
+		      struct lib_ring_buffer_backend_subbuffer *rsb,
+		      unsigned long consumed_idx,
+		      unsigned long consumed_count)
+{
+	unsigned long old_id, new_id;
+
+	/*
+	 * Exchange the target writer subbuffer with our own unused
+	 * subbuffer. No need to use ACCESS_ONCE() here to read the
+	 * old_wpage, because the value read will be confirmed by the
+	 * following cmpxchg().
+	 */
+	old_id = bufb->buf_wsb[consumed_idx].id;
+	if (unlikely(!subbuffer_id_is_noref(config, old_id)))
+		return -EAGAIN;
+	/*
+	 * Make sure the offset count we are expecting matches the one
+	 * indicated by the writer.
+	 */
+	if (unlikely(!subbuffer_id_compare_offset(config, old_id,
+						  consumed_count)))
+		return -EAGAIN;
+	CHAN_WARN_ON(bufb->chan, !subbuffer_id_is_noref(config, rsb->id));
+	subbuffer_id_set_noref_offset(config, &rsb->id, consumed_count);
+	new_id = cmpxchg(&bufb->buf_wsb[consumed_idx].id, old_id, rsb->id);
+	if (unlikely(old_id != new_id))
+		return -EAGAIN;
+	rsb->id = new_id;
+	return 0;
+}
+
 /**
  * update_read_sb_index - Read-side subbuffer index update.
  */
@@ -443,34 +546,9 @@ int update_read_sb_index(const struct lib_ring_buffer_config *config,
 			 unsigned long consumed_idx,
 			 unsigned long consumed_count)
 {
-	unsigned long old_id, new_id;
-
 	if (config->mode == RING_BUFFER_OVERWRITE) {
-		/*
-		 * Exchange the target writer subbuffer with our own unused
-		 * subbuffer. No need to use ACCESS_ONCE() here to read the
-		 * old_wpage, because the value read will be confirmed by the
-		 * following cmpxchg().
-		 */
-		old_id = bufb->buf_wsb[consumed_idx].id;
-		if (unlikely(!subbuffer_id_is_noref(config, old_id)))
-			return -EAGAIN;
-		/*
-		 * Make sure the offset count we are expecting matches the one
-		 * indicated by the writer.
-		 */
-		if (unlikely(!subbuffer_id_compare_offset(config, old_id,
-							  consumed_count)))
-			return -EAGAIN;
-		CHAN_WARN_ON(bufb->chan,
-			     !subbuffer_id_is_noref(config, bufb->buf_rsb.id));
-		subbuffer_id_set_noref_offset(config, &bufb->buf_rsb.id,
-					      consumed_count);
-		new_id = cmpxchg(&bufb->buf_wsb[consumed_idx].id, old_id,
-				 bufb->buf_rsb.id);
-		if (unlikely(old_id != new_id))
-			return -EAGAIN;
-		bufb->buf_rsb.id = new_id;
+		return exchange_sb_index(config, bufb, &bufb->buf_rsb,
+					 consumed_idx, consumed_count);
 	} else {
 		/* No page exchange, use the writer page directly */
 		bufb->buf_rsb.id = bufb->buf_wsb[consumed_idx].id;
@@ -25,6 +25,7 @@
 
 #include <linux/cpumask.h>
 #include <linux/types.h>
+#include <linux/workqueue.h>
 #include <lttng-kernel-version.h>
 #include <lttng-cpuhotplug.h>
 
@@ -38,6 +39,7 @@ struct lib_ring_buffer_backend_pages {
 	union v_atomic records_commit;	/* current records committed count */
 	union v_atomic records_unread;	/* records to read */
 	unsigned long data_size;	/* Amount of data to read from subbuf */
+	int populated;			/* Pages allocated (RING_BUFFER_PAGE_LAZY) */
 	struct lib_ring_buffer_backend_page p[];
 };
 
@@ -61,12 +63,15 @@ struct lib_ring_buffer_backend_counts {
  */
 struct channel;
 struct lib_ring_buffer;
+struct lib_ring_buffer_crash_channel;
 
 struct lib_ring_buffer_backend {
 	/* Array of ring_buffer_backend_subbuffer for writer */
 	struct lib_ring_buffer_backend_subbuffer *buf_wsb;
 	/* ring_buffer_backend_subbuffer for reader */
 	struct lib_ring_buffer_backend_subbuffer buf_rsb;
+	/* Array of ring_buffer_backend_subbuffer swapped out by snapshots */
+	struct lib_ring_buffer_backend_subbuffer *buf_psb;
 	/* Array of lib_ring_buffer_backend_counts for the packet counter */
 	struct lib_ring_buffer_backend_counts *buf_cnt;
 	/*
@@ -75,13 +80,33 @@ struct lib_ring_buffer_backend {
 	 */
 	struct lib_ring_buffer_backend_pages **array;
 	unsigned int num_pages_per_subbuf;
+	void *linear_addr;		/*
+					 * Linear mapping of the buffer
+					 * (RING_BUFFER_VMAP and STATIC).
+					 */
 
 	struct channel *chan;		/* Associated channel */
 	int cpu;			/* This buffer's cpu. -1 if global. */
+	int node;			/*
+					 * NUMA node holding the buffer pages.
+					 * -1 if global or spread over nodes.
+					 */
 	union v_atomic records_read;	/* Number of records read */
+	uint64_t *crash_pages;		/* Post-mortem page table, or NULL */
 	unsigned int allocated:1;	/* is buffer allocated ? */
 };
 
+/*
+ * Page budget shared by the buffers of several channels. Buffers draw
+ * their pages from it when they are allocated, or for
+ * RING_BUFFER_PAGE_LAZY as their sub-buffers get populated, and give
+ * them back when freed. RING_BUFFER_STATIC buffers are not accounted.
+ */
+struct lib_ring_buffer_page_pool {
+	atomic_long_t nr_pages;		/* Pages drawn */
+	unsigned long max_pages;	/* 0: unlimited */
+};
+
 struct channel_backend {
 	unsigned long buf_size;		/* Size of the buffer */
 	unsigned long subbuf_size;	/* Sub-buffer size */
@@ -92,6 +117,9 @@ struct channel_backend {
 					 */
 	unsigned int buf_size_order;	/* Order of buffer size */
 	unsigned int extra_reader_sb:1;	/* has extra reader subbuffer ? */
+	unsigned int snapshot_pool:1;	/* has snapshot subbuffer pool ? */
+	unsigned int hp_defer_create:1;	/* Create hotplugged buffers later */
+	struct lib_ring_buffer_page_pool *page_pool;	/* NULL: none */
 	struct lib_ring_buffer *buf;	/* Channel per-cpu buffers */
 
 	unsigned long num_subbuf;	/* Number of sub-buffers for writer */
@@ -111,7 +139,13 @@ struct channel_backend {
 	 */
 	struct lib_ring_buffer_config config; /* Ring buffer configuration */
 	cpumask_var_t cpumask;		/* Allocated per-cpu buffers cpumask */
+	cpumask_var_t alloc_cpumask;	/* CPUs getting a buffer */
+	struct delayed_work populate_work;	/* RING_BUFFER_PAGE_LAZY worker */
+	cpumask_var_t hp_pending_cpumask;	/* Buffers awaiting creation */
+	struct work_struct hp_create_work;	/* Deferred buffer creation */
 	char name[NAME_MAX];		/* Channel name */
+	/* Post-mortem layout descriptor, NULL without oops consistency */
+	struct lib_ring_buffer_crash_channel *crash;
 };
 
 #endif /* _LIB_RING_BUFFER_BACKEND_TYPES_H */
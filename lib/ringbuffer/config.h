@@ -77,6 +77,12 @@ struct lib_ring_buffer_client_cb {
 			    struct channel *chan, struct lib_ring_buffer *buf,
 			    size_t offset, size_t *header_len,
 			    size_t *payload_len, u64 *timestamp);
+
+	/*
+	 * Called from the switch timer of the buffer, before the periodic
+	 * sub-buffer switch.
+	 */
+	void (*buffer_switch_timer) (struct lib_ring_buffer *buf);
 };
 
 /*
@@ -104,6 +110,34 @@ struct lib_ring_buffer_client_cb {
  * RING_BUFFER_ALLOC_GLOBAL and RING_BUFFER_SYNC_GLOBAL :
  *   Global shared buffer with global synchronization.
  *
+ * cluster:
+ *
+ * RING_BUFFER_CLUSTER_CPU gives each cpu its own buffer.
+ *
+ * RING_BUFFER_CLUSTER_SMT and RING_BUFFER_CLUSTER_LLC make the cpus of an
+ * SMT sibling group, or sharing a last-level cache, write to a single
+ * buffer, owned by the first of them online at channel creation. Requires
+ * RING_BUFFER_ALLOC_PER_CPU, RING_BUFFER_SYNC_GLOBAL and
+ * RING_BUFFER_NO_IPI_BARRIER. Contention on the buffer stays within the
+ * cache shared by its writers. Cpus keep the buffer they were first
+ * given across hotplug, and cpus first brought online after channel
+ * creation get their own buffer. Timers of a shared buffer run while its
+ * owner is online.
+ *
+ * ipi:
+ *
+ * RING_BUFFER_NO_IPI_BARRIER orders the writer stores with a write barrier
+ * before each commit count update, paired with a read barrier after the
+ * reader loads the commit count in get_subbuf(). Readers never interrupt
+ * the traced cpus. The write barrier is a compiler barrier on total store
+ * order architectures.
+ *
+ * RING_BUFFER_IPI_BARRIER keeps only a compiler barrier on the writer
+ * side, upgraded into a memory barrier by an IPI sent to the writer cpus
+ * by get_subbuf() (skipped on total store order architectures). It trades
+ * reader-side interrupts of the traced cpus for the cost of the write
+ * barrier on weakly ordered architectures.
+ *
  * wakeup:
  *
  * RING_BUFFER_WAKEUP_BY_TIMER uses per-cpu timers to poll the
@@ -115,14 +149,71 @@ struct lib_ring_buffer_client_cb {
  * ready to read. Lower latencies before the reader is woken up. Mainly suitable
  * for drivers.
  *
+ * A RING_BUFFER_WAKEUP_BY_TIMER channel created without read timer can
+ * have its writers wake up readers, see
+ * lib_ring_buffer_channel_set_writer_wakeup(). The wakeup is then deferred
+ * through a per-buffer irq_work, which makes it safe from any tracing
+ * context, NMI included.
+ *
  * RING_BUFFER_WAKEUP_NONE does not perform any wakeup whatsoever. The client
  * has the responsibility to perform wakeups.
+ *
+ * backend:
+ *
+ * RING_BUFFER_PAGE allocates the buffer page by page.
+ *
+ * RING_BUFFER_PAGE_CONTIG allocates each sub-buffer as a single physically
+ * contiguous higher-order page block. Writes within a sub-buffer never need
+ * to handle page crossing, at the cost of requiring sub-buffers no larger
+ * than the maximum page allocation order, and of failing channel creation
+ * when memory is too fragmented.
+ *
+ * RING_BUFFER_VMAP allocates the buffer page by page, and maps it in a
+ * virtually contiguous kernel range. Writes within a sub-buffer never need to
+ * handle page crossing either, without requiring higher-order allocations, at
+ * the cost of vmalloc address space and of TLB misses on the writer side.
+ *
+ * RING_BUFFER_PAGE_LAZY allocates the buffer page by page, but only
+ * populates the sub-buffers the writer is about to reach: a worker keeps
+ * a couple of sub-buffers populated ahead of the write position,
+ * so buffers of cpus which trace little never commit their whole memory.
+ * Records reaching a sub-buffer not populated yet are accounted as lost
+ * because the buffer is full. Not available with RING_BUFFER_MMAP output.
+ * Populated sub-buffers stay allocated until the buffer is freed.
+ *
+ * RING_BUFFER_STATIC carves each buffer out of a physical memory region
+ * reserved at boot (e.g. memmap=nn$ss on x86, or a reserved-mem node), given
+ * to the lttng-lib-ring-buffer module with the static_mem_start and
+ * static_mem_size parameters. Buffers are linear, need no page allocation,
+ * and are placed first-fit, so the same channels created in the same order
+ * land at the same physical addresses across boots, where a kdump kernel can
+ * find them. Combine with RING_BUFFER_OOPS_CONSISTENCY to recover their
+ * content after a crash.
+ *
+ * splice:
+ *
+ * RING_BUFFER_SPLICE_PAGE_SWAP moves the spliced pages out of the buffer,
+ * replacing each of them by a newly allocated page.
+ *
+ * RING_BUFFER_SPLICE_PAGE_REF splices references to the buffer pages. The
+ * pages of the sub-buffer are reused by the writer after put_subbuf, at
+ * which point only the pages still referenced by a pipe or a socket are
+ * replaced. Streaming pages which are released by the time the reader puts
+ * the sub-buffer then needs no page allocation. Only applies to the
+ * RING_BUFFER_PAGE backend; RING_BUFFER_PAGE_LAZY uses
+ * RING_BUFFER_SPLICE_PAGE_SWAP. The RING_BUFFER_PAGE_CONTIG, RING_BUFFER_VMAP
+ * and RING_BUFFER_STATIC backends do not support RING_BUFFER_SPLICE output.
  */
 struct lib_ring_buffer_config {
 	enum {
 		RING_BUFFER_ALLOC_PER_CPU,
 		RING_BUFFER_ALLOC_GLOBAL,
 	} alloc;
+	enum {
+		RING_BUFFER_CLUSTER_CPU,
+		RING_BUFFER_CLUSTER_SMT,	/* SMT siblings */
+		RING_BUFFER_CLUSTER_LLC,	/* Last-level cache */
+	} cluster;
 	enum {
 		RING_BUFFER_SYNC_PER_CPU,	/* Wait-free */
 		RING_BUFFER_SYNC_GLOBAL,	/* Lock-free */
@@ -134,14 +225,36 @@ struct lib_ring_buffer_config {
 	enum {
 		RING_BUFFER_SPLICE,
 		RING_BUFFER_MMAP,
-		RING_BUFFER_READ,		/* TODO */
+		RING_BUFFER_READ,		/* read()/readv() only */
 		RING_BUFFER_ITERATOR,
 		RING_BUFFER_NONE,
 	} output;
+	enum {
+		RING_BUFFER_SPLICE_PAGE_SWAP,	/* Replaced when spliced */
+		RING_BUFFER_SPLICE_PAGE_REF,	/*
+						 * Referenced when spliced,
+						 * replaced at put_subbuf
+						 * if still in use.
+						 */
+	} splice;
 	enum {
 		RING_BUFFER_PAGE,
-		RING_BUFFER_VMAP,		/* TODO */
-		RING_BUFFER_STATIC,		/* TODO */
+		RING_BUFFER_PAGE_CONTIG,	/*
+						 * Physically contiguous
+						 * sub-buffers.
+						 */
+		RING_BUFFER_VMAP,		/*
+						 * Virtually contiguous
+						 * buffer.
+						 */
+		RING_BUFFER_PAGE_LAZY,		/*
+						 * Pages allocated ahead
+						 * of the writer.
+						 */
+		RING_BUFFER_STATIC,		/*
+						 * Memory reserved at
+						 * boot.
+						 */
 	} backend;
 	enum {
 		RING_BUFFER_NO_OOPS_CONSISTENCY,
@@ -159,6 +272,23 @@ struct lib_ring_buffer_config {
 						 * (takes spinlock).
 						 */
 	} wakeup;
+	enum {
+		RING_BUFFER_COMMIT_DENSE,	/* counters packed in arrays */
+		RING_BUFFER_COMMIT_CACHELINE,	/*
+						 * one cache line per
+						 * sub-buffer counter, avoids
+						 * false sharing between the
+						 * writer and the reader.
+						 */
+	} commit_layout;
+	enum {
+		RING_BUFFER_SNAPSHOT_COPY,	/* snapshots read in place */
+		RING_BUFFER_SNAPSHOT_SWAP,	/*
+						 * overwrite mode: snapshots
+						 * swap sub-buffers out to a
+						 * pool as large as the buffer.
+						 */
+	} snapshot;
 	/*
 	 * tsc_bits: timestamp bits saved at each record.
 	 *   0 and 64 disable the timestamp compression scheme.
@@ -200,6 +330,11 @@ struct lib_ring_buffer_ctx {
 					 */
 	u64 tsc;			/* time-stamp counter value */
 	unsigned int rflags;		/* reservation flags */
+	size_t batch_size;		/*
+					 * Size of the whole slot reserved by
+					 * lib_ring_buffer_reserve_batch(), 0
+					 * if not part of a contiguous batch.
+					 */
 	/* Cache backend pages pointer chasing. */
 	struct lib_ring_buffer_backend_pages *backend_pages;
 };
@@ -225,6 +360,7 @@ void lib_ring_buffer_ctx_init(struct lib_ring_buffer_ctx *ctx,
 	ctx->largest_align = largest_align;
 	ctx->cpu = cpu;
 	ctx->rflags = 0;
+	ctx->batch_size = 0;
 	ctx->backend_pages = NULL;
 }
 
@@ -297,6 +433,18 @@ void lib_ring_buffer_align_ctx(struct lib_ring_buffer_ctx *ctx,
 						 alignment);
 }
 
+/*
+ * With total store order, the compiler barrier used by writers with
+ * RING_BUFFER_IPI_BARRIER already orders their stores as seen by remote
+ * readers, which can therefore skip the memory barrier IPI.
+ */
+#if defined(CONFIG_X86) && !defined(CONFIG_X86_PPRO_FENCE) \
+	&& !defined(CONFIG_X86_OOSTORE)
+#define LIB_RING_BUFFER_TSO	1
+#else
+#define LIB_RING_BUFFER_TSO	0
+#endif
+
 /*
  * lib_ring_buffer_check_config() returns 0 on success.
  * Used internally to check for valid configurations at channel creation.
@@ -310,6 +458,17 @@ int lib_ring_buffer_check_config(const struct lib_ring_buffer_config *config,
 	    && config->sync == RING_BUFFER_SYNC_PER_CPU
 	    && switch_timer_interval)
 		return -EINVAL;
+	if (config->backend == RING_BUFFER_PAGE_LAZY
+	    && config->output == RING_BUFFER_MMAP)
+		return -EINVAL;
+	if (config->cluster != RING_BUFFER_CLUSTER_CPU
+	    && (config->alloc != RING_BUFFER_ALLOC_PER_CPU
+		|| config->sync != RING_BUFFER_SYNC_GLOBAL
+		|| config->ipi != RING_BUFFER_NO_IPI_BARRIER))
+		return -EINVAL;
+	if (config->snapshot == RING_BUFFER_SNAPSHOT_SWAP
+	    && config->mode != RING_BUFFER_OVERWRITE)
+		return -EINVAL;
 	return 0;
 }
 
@@ -0,0 +1,123 @@
+#ifndef _LIB_RING_BUFFER_CRASH_H
+#define _LIB_RING_BUFFER_CRASH_H
+
+/*
+ * lib/ringbuffer/crash.h
+ *
+ * Ring Buffer Library post-mortem buffer layout descriptors.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Each channel configured with RING_BUFFER_OOPS_CONSISTENCY is described
+ * by a struct lib_ring_buffer_crash_channel, listed from the
+ * lib_ring_buffer_crash_root symbol. The layout of these descriptors only
+ * changes along with LIB_RING_BUFFER_CRASH_VERSION, so extraction tools
+ * reading a vmcore do not depend on the internal ring buffer structures.
+ *
+ * Addresses are kernel virtual addresses, except for the page table
+ * entries, which are physical addresses. Positions, counters and
+ * sub-buffer ids are unsigned longs of root->word_size bytes.
+ *
+ * To read buffer "i" of a channel:
+ * - the write position is at buffers[i].offset, the read position at
+ *   buffers[i].consumed,
+ * - writer sub-buffer "n" (0 <= n < num_subbuf) is held by the backend
+ *   sub-buffer of index (id & sb_index_mask), where id is found at
+ *   buffers[i].wsb + n * root->sb_id_stride,
+ * - page "j" of backend sub-buffer "b" (0 <= b < num_subbuf_alloc) is at
+ *   the physical address held by entry b * pages_per_subbuf + j of the
+ *   uint64_t page table at buffers[i].pages, 0 if not populated,
+ * - the commit count of writer sub-buffer "n" is at buffers[i].commit_hot
+ *   + n * commit_hot_stride + root->commit_hot_cc, and its count of
+ *   consecutive commits at root->commit_hot_seq instead of commit_hot_cc:
+ *   the sub-buffer holds complete records up to the latter, modulo the
+ *   sub-buffer size.
+ */
+
+#include <linux/types.h>
+
+#define LIB_RING_BUFFER_CRASH_MAGIC		0x4c54544e47524243ULL	/* "LTTNGRBC" */
+#define LIB_RING_BUFFER_CRASH_CHANNEL_MAGIC	0x4c54544e47434841ULL	/* "LTTNGCHA" */
+#define LIB_RING_BUFFER_CRASH_VERSION		1
+#define LIB_RING_BUFFER_CRASH_NAME_LEN		64
+
+struct lib_ring_buffer_crash_buffer {
+	int32_t cpu;			/* -1 for a global buffer */
+	uint32_t allocated;		/* Other fields valid if set */
+	uint64_t offset;		/* Address of the write position */
+	uint64_t consumed;		/* Address of the read position */
+	uint64_t commit_hot;		/* Address of the commit counters */
+	uint64_t wsb;			/* Address of the writer sub-buffer ids */
+	uint64_t rsb;			/* Address of the reader sub-buffer id */
+	uint64_t pages;			/* Address of the page table */
+} __attribute__((packed));
+
+struct lib_ring_buffer_crash_channel {
+	uint64_t magic;			/* LIB_RING_BUFFER_CRASH_CHANNEL_MAGIC */
+	uint64_t next;			/* Next channel, 0 for the last one */
+	char name[LIB_RING_BUFFER_CRASH_NAME_LEN];
+	uint64_t priv;			/* Client descriptor, 0 if none */
+	uint64_t subbuf_size;		/* Bytes */
+	uint64_t sb_index_mask;		/* Backend index bits of the ids */
+	uint32_t num_subbuf;		/* Writer sub-buffers */
+	uint32_t num_subbuf_alloc;	/* With reader and snapshot pool ones */
+	uint32_t pages_per_subbuf;
+	uint32_t commit_hot_stride;	/* Bytes between commit counters */
+	uint32_t mode;			/* 0: discard, 1: overwrite */
+	uint32_t nr_buffers;		/* Entries of buffers, by cpu if per-cpu */
+	struct lib_ring_buffer_crash_buffer buffers[];
+} __attribute__((packed));
+
+struct lib_ring_buffer_crash_root {
+	uint64_t magic;			/* LIB_RING_BUFFER_CRASH_MAGIC */
+	uint32_t version;		/* LIB_RING_BUFFER_CRASH_VERSION */
+	uint32_t root_size;		/* Sizes of the descriptors */
+	uint32_t channel_size;		/* Without the buffers */
+	uint32_t buffer_size;
+	uint32_t word_size;		/* Size of an unsigned long */
+	uint32_t page_size;
+	uint32_t sb_id_stride;		/* Bytes between sub-buffer ids */
+	uint32_t commit_hot_cc;		/* Offsets in a commit counter */
+	uint32_t commit_hot_seq;
+	uint32_t padding;
+	uint64_t channels;		/* First channel, 0 if none */
+} __attribute__((packed));
+
+struct channel;
+struct channel_backend;
+struct lib_ring_buffer;
+struct lib_ring_buffer_backend;
+
+extern struct lib_ring_buffer_crash_root lib_ring_buffer_crash_root;
+
+/*
+ * Set the client descriptor of a channel, an address of the client's
+ * choosing, kept in its vmcore for as long as the channel exists.
+ */
+void lib_ring_buffer_crash_set_priv(struct channel *chan, void *priv);
+
+/* Internal, called by the ring buffer frontend and backend. */
+int lib_ring_buffer_crash_channel_create(struct channel_backend *chanb);
+void lib_ring_buffer_crash_channel_destroy(struct channel_backend *chanb);
+int lib_ring_buffer_crash_buffer_create(struct lib_ring_buffer *buf);
+void lib_ring_buffer_crash_buffer_destroy(struct lib_ring_buffer *buf);
+void lib_ring_buffer_crash_update_pages(struct lib_ring_buffer_backend *bufb,
+		unsigned long sb_bindex);
+
+#endif /* _LIB_RING_BUFFER_CRASH_H */
@@ -72,6 +72,20 @@ struct channel *channel_create(const struct lib_ring_buffer_config *config,
 			       unsigned int switch_timer_interval,
 			       unsigned int read_timer_interval);
 
+/*
+ * As channel_create, with per-cpu buffers only for the cpus of
+ * alloc_cpumask, and pages drawn from page_pool. Both can be NULL.
+ */
+extern
+struct channel *channel_create_limited(
+		const struct lib_ring_buffer_config *config,
+		const char *name, void *priv, void *buf_addr,
+		size_t subbuf_size, size_t num_subbuf,
+		unsigned int switch_timer_interval,
+		unsigned int read_timer_interval,
+		const struct cpumask *alloc_cpumask,
+		struct lib_ring_buffer_page_pool *page_pool);
+
 /*
  * channel_destroy returns the private data pointer. It finalizes all channel's
  * buffers, waits for readers to release all references, and destroys the
@@ -106,6 +120,11 @@ extern void lib_ring_buffer_release_read(struct lib_ring_buffer *buf);
 extern int lib_ring_buffer_snapshot(struct lib_ring_buffer *buf,
 				    unsigned long *consumed,
 				    unsigned long *produced);
+extern int lib_ring_buffer_snapshot_since(struct lib_ring_buffer *buf,
+		uint64_t timestamp, unsigned long *consumed,
+		unsigned long *produced);
+extern int lib_ring_buffer_snapshot_swap(struct lib_ring_buffer *buf,
+		unsigned long *consumed, unsigned long *produced);
 extern void lib_ring_buffer_move_consumer(struct lib_ring_buffer *buf,
 					  unsigned long consumed_new);
 
@@ -113,6 +132,34 @@ extern int lib_ring_buffer_get_subbuf(struct lib_ring_buffer *buf,
 				      unsigned long consumed);
 extern void lib_ring_buffer_put_subbuf(struct lib_ring_buffer *buf);
 
+/*
+ * Live read of the packet being written, without switching it.
+ */
+extern int lib_ring_buffer_get_committed_prefix(struct lib_ring_buffer *buf,
+		unsigned long *packet, unsigned long *len);
+
+/*
+ * Additional readers, each reading every sub-buffer in turn:
+ * open, many get_next_subbuf/put_next_subbuf, release.
+ */
+extern struct lib_ring_buffer_reader *lib_ring_buffer_reader_open(
+		struct lib_ring_buffer *buf);
+extern void lib_ring_buffer_reader_release(
+		struct lib_ring_buffer_reader *reader);
+extern int lib_ring_buffer_reader_get_next_subbuf(
+		struct lib_ring_buffer_reader *reader);
+extern void lib_ring_buffer_reader_put_next_subbuf(
+		struct lib_ring_buffer_reader *reader);
+
+extern void lib_ring_buffer_rotate_position(struct lib_ring_buffer *buf,
+					    uint64_t *seq_num,
+					    unsigned long *consumed);
+
+extern void lib_ring_buffer_packet_index_write(struct lib_ring_buffer *buf,
+		const struct lib_ring_buffer_packet_index *index);
+extern int lib_ring_buffer_packet_index_read(struct lib_ring_buffer *buf,
+		uint64_t seq_num, struct lib_ring_buffer_packet_index *index);
+
 void lib_ring_buffer_set_quiescent_channel(struct channel *chan);
 void lib_ring_buffer_clear_quiescent_channel(struct channel *chan);
 
@@ -156,6 +203,21 @@ unsigned long lib_ring_buffer_get_consumed(const struct lib_ring_buffer_config *
 	return atomic_long_read(&buf->consumed);
 }
 
+/*
+ * Highest distance between the writer and the reader seen by the timers
+ * of the buffer, or now, since the previous call.
+ */
+static inline
+unsigned long lib_ring_buffer_reset_peak_lag(
+				const struct lib_ring_buffer_config *config,
+				struct lib_ring_buffer *buf)
+{
+	unsigned long lag = lib_ring_buffer_get_offset(config, buf)
+			- lib_ring_buffer_get_consumed(config, buf);
+
+	return max(xchg(&buf->peak_lag, 0), lag);
+}
+
 /*
  * Must call lib_ring_buffer_is_finalized before reading counters (memory
  * ordering enforced with respect to trace teardown).
@@ -184,6 +246,27 @@ int lib_ring_buffer_channel_is_disabled(const struct channel *chan)
 	return atomic_read(&chan->record_disabled);
 }
 
+/*
+ * Let the writers of a RING_BUFFER_WAKEUP_BY_TIMER channel without read
+ * timer wake up its readers through irq_work when they deliver a
+ * sub-buffer. Should be called before the buffers are opened for reading.
+ */
+static inline
+int lib_ring_buffer_channel_set_writer_wakeup(
+				const struct lib_ring_buffer_config *config,
+				struct channel *chan)
+{
+#ifdef CONFIG_IRQ_WORK
+	if (config->wakeup != RING_BUFFER_WAKEUP_BY_TIMER
+			|| chan->read_timer_interval)
+		return -EINVAL;
+	ACCESS_ONCE(chan->writer_wakeup) = 1;
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
 static inline
 unsigned long lib_ring_buffer_get_read_data_size(
 				const struct lib_ring_buffer_config *config,
@@ -192,6 +275,26 @@ unsigned long lib_ring_buffer_get_read_data_size(
 	return subbuffer_get_read_data_size(config, &buf->backend);
 }
 
+static inline
+unsigned long lib_ring_buffer_reader_get_read_data_size(
+				const struct lib_ring_buffer_config *config,
+				struct lib_ring_buffer_reader *reader)
+{
+	return reader->buf->backend.array[reader->sb_bindex]->data_size;
+}
+
+/*
+ * Leave the records of the channel out of the records_count and
+ * records_overrun counters of its buffers, sparing the writers the
+ * per-record update of the sub-buffer records counter when the ring
+ * buffer counts events. Should be called before tracing starts.
+ */
+static inline
+void lib_ring_buffer_channel_set_no_record_count(struct channel *chan)
+{
+	ACCESS_ONCE(chan->no_record_count) = 1;
+}
+
 static inline
 unsigned long lib_ring_buffer_get_records_count(
 				const struct lib_ring_buffer_config *config,
@@ -232,6 +335,13 @@ unsigned long lib_ring_buffer_get_records_lost_big(
 	return v_read(config, &buf->records_lost_big);
 }
 
+static inline
+unsigned long lib_ring_buffer_channel_get_records_lost_pending(
+				struct channel *chan)
+{
+	return atomic_long_read(&chan->records_lost_pending);
+}
+
 static inline
 unsigned long lib_ring_buffer_get_records_read(
 				const struct lib_ring_buffer_config *config,
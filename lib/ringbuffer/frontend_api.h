@@ -33,6 +33,58 @@
 #include <wrapper/percpu-defs.h>
 #include <linux/errno.h>
 #include <linux/prefetch.h>
+#include <linux/hardirq.h>
+
+/*
+ * Nesting levels of the writers on a CPU: thread, softirq, irq, and one
+ * for traps or tracer recursion. NMIs get one more, so an NMI coming
+ * over a full nesting still records.
+ *
+ * Reserve and commit are NMI-safe: they only use cmpxchg and atomic
+ * adds on the buffer counters, never take a lock, and leave the reader
+ * wakeups to the timer when the configuration uses
+ * RING_BUFFER_WAKEUP_BY_TIMER, as the LTTng discard and overwrite
+ * clients do. Records of NMIs are dropped with -EIO when the trace
+ * clock cannot be read from NMI context.
+ */
+#define RING_BUFFER_MAX_NESTING		4
+#define RING_BUFFER_NMI_NESTING		(RING_BUFFER_MAX_NESTING + 1)
+
+/**
+ * lib_ring_buffer_get_cpu_preempt_off - Precedes reserve/commit, atomic context.
+ *
+ * Same as lib_ring_buffer_get_cpu(), for callers already running with
+ * preemption disabled within a RCU-sched read-side critical section, such
+ * as tracepoint probes. Only keeps the ring buffer nesting count.
+ */
+static inline
+int lib_ring_buffer_get_cpu_preempt_off(const struct lib_ring_buffer_config *config)
+{
+	int cpu, nesting;
+
+	cpu = smp_processor_id();
+	nesting = ++per_cpu(lib_ring_buffer_nesting, cpu);
+	barrier();
+
+	if (unlikely(nesting > RING_BUFFER_MAX_NESTING)) {
+		if (in_nmi() && nesting <= RING_BUFFER_NMI_NESTING)
+			return cpu;
+		WARN_ON_ONCE(1);
+		per_cpu(lib_ring_buffer_nesting, cpu)--;
+		return -EPERM;
+	} else
+		return cpu;
+}
+
+/**
+ * lib_ring_buffer_put_cpu_preempt_off - Follows reserve/commit, atomic context.
+ */
+static inline
+void lib_ring_buffer_put_cpu_preempt_off(const struct lib_ring_buffer_config *config)
+{
+	barrier();
+	(*lttng_this_cpu_ptr(&lib_ring_buffer_nesting))--;
+}
 
 /**
  * lib_ring_buffer_get_cpu - Precedes ring buffer reserve/commit.
@@ -51,20 +103,13 @@
 static inline
 int lib_ring_buffer_get_cpu(const struct lib_ring_buffer_config *config)
 {
-	int cpu, nesting;
+	int cpu;
 
 	rcu_read_lock_sched_notrace();
-	cpu = smp_processor_id();
-	nesting = ++per_cpu(lib_ring_buffer_nesting, cpu);
-	barrier();
-
-	if (unlikely(nesting > 4)) {
-		WARN_ON_ONCE(1);
-		per_cpu(lib_ring_buffer_nesting, cpu)--;
+	cpu = lib_ring_buffer_get_cpu_preempt_off(config);
+	if (unlikely(cpu < 0))
 		rcu_read_unlock_sched_notrace();
-		return -EPERM;
-	} else
-		return cpu;
+	return cpu;
 }
 
 /**
@@ -73,8 +118,7 @@ int lib_ring_buffer_get_cpu(const struct lib_ring_buffer_config *config)
 static inline
 void lib_ring_buffer_put_cpu(const struct lib_ring_buffer_config *config)
 {
-	barrier();
-	(*lttng_this_cpu_ptr(&lib_ring_buffer_nesting))--;
+	lib_ring_buffer_put_cpu_preempt_off(config);
 	rcu_read_unlock_sched_notrace();
 }
 
@@ -104,7 +148,8 @@ int lib_ring_buffer_try_reserve(const struct lib_ring_buffer_config *config,
 	 * commit counter to increment it and commit seq value to compare it to
 	 * the commit counter.
 	 */
-	prefetch(&buf->commit_hot[subbuf_index(*o_begin, chan)]);
+	prefetch(lib_ring_buffer_commit_hot(config, buf,
+			subbuf_index(*o_begin, chan)));
 
 	if (last_tsc_overflow(config, buf, ctx->tsc))
 		ctx->rflags |= RING_BUFFER_RFLAG_FULL_TSC;
@@ -147,7 +192,8 @@ int lib_ring_buffer_try_reserve(const struct lib_ring_buffer_config *config,
  *
  * Return :
  *  0 on success.
- * -EAGAIN if channel is disabled.
+ * -EAGAIN if channel is disabled, or if the buffer of the CPU is not
+ *  created yet.
  * -ENOSPC if event size is too large for packet.
  * -ENOBUFS if there is currently not enough space in buffer for the event.
  * -EIO if data cannot be written into the buffer for any other reason.
@@ -165,10 +211,20 @@ int lib_ring_buffer_reserve(const struct lib_ring_buffer_config *config,
 	if (unlikely(atomic_read(&chan->record_disabled)))
 		return -EAGAIN;
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
+	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
 		buf = per_cpu_ptr(chan->backend.buf, ctx->cpu);
-	else
+		/*
+		 * NULL while the buffer of a hotplugged CPU is being
+		 * created, otherwise the buffer the CPU writes to.
+		 */
+		buf = rcu_dereference_raw(buf->cluster);
+		if (unlikely(!buf)) {
+			atomic_long_inc(&chan->records_lost_pending);
+			return -EAGAIN;
+		}
+	} else {
 		buf = chan->backend.buf;
+	}
 	if (unlikely(atomic_read(&buf->record_disabled)))
 		return -EAGAIN;
 	ctx->buf = buf;
@@ -210,6 +266,151 @@ slow_path:
 	return lib_ring_buffer_reserve_slow(ctx);
 }
 
+/*
+ * lib_ring_buffer_try_reserve_batch is called by
+ * lib_ring_buffer_reserve_batch(). It is not part of the API per se.
+ *
+ * All records of the batch share the same time-stamp. They are laid out
+ * back to back, starting at the current write offset, and must all fit
+ * within the current sub-buffer.
+ *
+ * returns 0 if reserve ok, or 1 if the slow path must be taken.
+ */
+static inline
+int lib_ring_buffer_try_reserve_batch(const struct lib_ring_buffer_config *config,
+				struct lib_ring_buffer_ctx *ctxs, unsigned int nr,
+				unsigned long *o_begin, unsigned long *o_end,
+				unsigned long *o_old)
+{
+	struct channel *chan = ctxs[0].chan;
+	struct lib_ring_buffer *buf = ctxs[0].buf;
+	unsigned long offset;
+	unsigned int i;
+	u64 tsc;
+
+	*o_begin = v_read(config, &buf->offset);
+	*o_old = *o_begin;
+
+	tsc = lib_ring_buffer_clock_read(chan);
+	if ((int64_t) tsc == -EIO)
+		return 1;
+
+	prefetch(lib_ring_buffer_commit_hot(config, buf,
+			subbuf_index(*o_begin, chan)));
+
+	/* Only the first record of the batch can need a full TSC. */
+	if (last_tsc_overflow(config, buf, tsc))
+		ctxs[0].rflags |= RING_BUFFER_RFLAG_FULL_TSC;
+
+	if (unlikely(subbuf_offset(*o_begin, chan) == 0))
+		return 1;
+
+	offset = *o_begin;
+	for (i = 0; i < nr; i++) {
+		struct lib_ring_buffer_ctx *ctx = &ctxs[i];
+		size_t before_hdr_pad = 0;
+
+		ctx->buf = buf;
+		ctx->tsc = tsc;
+		ctx->slot_size = record_header_size(config, chan, offset,
+						    &before_hdr_pad, ctx);
+		ctx->slot_size +=
+			lib_ring_buffer_align(offset + ctx->slot_size,
+					      ctx->largest_align) + ctx->data_size;
+		ctx->pre_offset = offset;
+		ctx->buf_offset = offset + before_hdr_pad;
+		offset += ctx->slot_size;
+	}
+	if (unlikely((subbuf_offset(*o_begin, chan) + offset - *o_begin)
+		     > chan->backend.subbuf_size))
+		return 1;
+
+	*o_end = offset;
+
+	if (unlikely((subbuf_offset(*o_end, chan)) == 0))
+		return 1;
+
+	return 0;
+}
+
+/**
+ * lib_ring_buffer_reserve_batch - Reserve space for several records at once.
+ * @config: ring buffer instance configuration.
+ * @ctxs: array of @nr ring buffer contexts (input and output). Must be
+ *        already initialized, all for the same channel and cpu.
+ * @nr: number of records to reserve.
+ *
+ * Atomic wait-free reservation of @nr consecutive slots with a single update
+ * of the write offset. All records share the same time-stamp. When the batch
+ * does not fit in the current sub-buffer, fall back on reserving the records
+ * one by one, which may partially succeed.
+ *
+ * The records reserved must be committed with a single call to
+ * lib_ring_buffer_commit_batch() using the returned record count. Discarding
+ * records of a batch is not supported.
+ *
+ * Return :
+ *  number of records reserved (1 to @nr) on success.
+ *  Otherwise the lib_ring_buffer_reserve() error for the first record.
+ */
+static inline
+int lib_ring_buffer_reserve_batch(const struct lib_ring_buffer_config *config,
+				  struct lib_ring_buffer_ctx *ctxs,
+				  unsigned int nr)
+{
+	struct channel *chan = ctxs[0].chan;
+	struct lib_ring_buffer *buf;
+	unsigned long o_begin, o_end, o_old;
+	unsigned int i;
+	int ret;
+
+	if (unlikely(atomic_read(&chan->record_disabled)))
+		return -EAGAIN;
+
+	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
+		buf = per_cpu_ptr(chan->backend.buf, ctxs[0].cpu);
+		/*
+		 * NULL while the buffer of a hotplugged CPU is being
+		 * created, otherwise the buffer the CPU writes to.
+		 */
+		buf = rcu_dereference_raw(buf->cluster);
+		if (unlikely(!buf)) {
+			atomic_long_inc(&chan->records_lost_pending);
+			return -EAGAIN;
+		}
+	} else {
+		buf = chan->backend.buf;
+	}
+	if (unlikely(atomic_read(&buf->record_disabled)))
+		return -EAGAIN;
+	ctxs[0].buf = buf;
+
+	if (unlikely(lib_ring_buffer_try_reserve_batch(config, ctxs, nr,
+						&o_begin, &o_end, &o_old)))
+		goto slow_path;
+
+	if (unlikely(v_cmpxchg(config, &buf->offset, o_old, o_end)
+		     != o_old))
+		goto slow_path;
+
+	save_last_tsc(config, buf, ctxs[0].tsc);
+	lib_ring_buffer_reserve_push_reader(buf, chan, o_end - 1);
+	lib_ring_buffer_clear_noref(config, &buf->backend,
+				subbuf_index(o_end - 1, chan));
+	ctxs[0].batch_size = o_end - o_begin;
+	return nr;
+
+slow_path:
+	for (i = 0; i < nr; i++) {
+		ctxs[i].batch_size = 0;
+		ctxs[i].rflags &= ~RING_BUFFER_RFLAG_FULL_TSC;
+		ret = lib_ring_buffer_reserve(config, &ctxs[i]);
+		if (unlikely(ret))
+			return i ? i : ret;
+	}
+	return nr;
+}
+
 /**
  * lib_ring_buffer_switch - Perform a sub-buffer switch for a per-cpu buffer.
  * @config: ring buffer instance configuration.
@@ -250,7 +451,8 @@ void lib_ring_buffer_commit(const struct lib_ring_buffer_config *config,
 	unsigned long offset_end = ctx->buf_offset;
 	unsigned long endidx = subbuf_index(offset_end - 1, chan);
 	unsigned long commit_count;
-	struct commit_counters_hot *cc_hot = &buf->commit_hot[endidx];
+	struct commit_counters_hot *cc_hot =
+		lib_ring_buffer_commit_hot(config, buf, endidx);
 
 	/*
 	 * Must count record before incrementing the commit count.
@@ -303,6 +505,54 @@ void lib_ring_buffer_commit(const struct lib_ring_buffer_config *config,
 			offset_end, commit_count, cc_hot);
 }
 
+/**
+ * lib_ring_buffer_commit_batch - Commit records reserved as a batch.
+ * @config: ring buffer instance configuration.
+ * @ctxs: ring buffer contexts passed to lib_ring_buffer_reserve_batch().
+ * @nr: number of records returned by lib_ring_buffer_reserve_batch().
+ *
+ * A contiguous batch is committed with a single commit count update and
+ * delivery check. Records reserved one by one by the fallback path are
+ * committed individually.
+ */
+static inline
+void lib_ring_buffer_commit_batch(const struct lib_ring_buffer_config *config,
+				  const struct lib_ring_buffer_ctx *ctxs,
+				  unsigned int nr)
+{
+	struct channel *chan = ctxs[0].chan;
+	struct lib_ring_buffer *buf = ctxs[0].buf;
+	unsigned long offset_end, endidx, commit_count;
+	struct commit_counters_hot *cc_hot;
+	unsigned int i;
+
+	if (!ctxs[0].batch_size) {
+		for (i = 0; i < nr; i++)
+			lib_ring_buffer_commit(config, &ctxs[i]);
+		return;
+	}
+
+	offset_end = ctxs[nr - 1].buf_offset;
+	endidx = subbuf_index(offset_end - 1, chan);
+	cc_hot = lib_ring_buffer_commit_hot(config, buf, endidx);
+
+	subbuffer_count_records(config, &buf->backend, endidx, nr);
+
+	/* See lib_ring_buffer_commit() for barrier and ordering rationale. */
+	if (config->ipi == RING_BUFFER_IPI_BARRIER)
+		barrier();
+	else
+		smp_wmb();
+
+	v_add(config, ctxs[0].batch_size, &cc_hot->cc);
+	commit_count = v_read(config, &cc_hot->cc);
+
+	lib_ring_buffer_check_deliver(config, buf, chan, offset_end - 1,
+				      commit_count, endidx, ctxs[0].tsc);
+	lib_ring_buffer_write_commit_counter(config, buf, chan,
+			offset_end, commit_count, cc_hot);
+}
+
 /**
  * lib_ring_buffer_try_discard_reserve - Try discarding a record.
  * @config: ring buffer instance configuration.
@@ -31,7 +31,7 @@
 #include <wrapper/ringbuffer/config.h>
 #include <wrapper/ringbuffer/backend_types.h>
 #include <wrapper/ringbuffer/frontend_types.h>
-#include <lib/prio_heap/lttng_prio_heap.h>	/* For per-CPU read-side iterator */
+#include <lib/prio_heap/lttng_tournament_tree.h>	/* For per-CPU read-side iterator */
 
 /* Buffer offset macros */
 
@@ -50,6 +50,14 @@ unsigned long buf_trunc_val(unsigned long offset, struct channel *chan)
 	return buf_trunc(offset, chan) >> chan->backend.buf_size_order;
 }
 
+/* Sequence number of the packet at position "offset". */
+static inline
+uint64_t packet_seq_num(unsigned long offset, struct channel *chan)
+{
+	return (uint64_t) chan->backend.num_subbuf * buf_trunc_val(offset, chan)
+		+ subbuf_index(offset, chan);
+}
+
 /* buf_offset mask selects only the offset within the current buffer. */
 static inline
 unsigned long buf_offset(unsigned long offset, struct channel *chan)
@@ -90,7 +98,8 @@ unsigned long subbuf_index(unsigned long offset, struct channel *chan)
  * Last TSC comparison functions. Check if the current TSC overflows tsc_bits
  * bits from the last TSC read. When overflows are detected, the full 64-bit
  * timestamp counter should be written in the record header. Reads and writes
- * last_tsc atomically.
+ * last_tsc atomically. Clients with variable-size timestamps can also ask for
+ * an upper bound of the delta from the last TSC.
  */
 
 #if (BITS_PER_LONG == 32)
@@ -123,6 +132,16 @@ int last_tsc_overflow(const struct lib_ring_buffer_config *config,
 	else
 		return 0;
 }
+
+/*
+ * Only the high-order bits of the last TSC are kept: the delta is unknown.
+ */
+static inline
+u64 last_tsc_delta(const struct lib_ring_buffer_config *config,
+		   struct lib_ring_buffer *buf, u64 tsc)
+{
+	return ~0ULL;
+}
 #else
 static inline
 void save_last_tsc(const struct lib_ring_buffer_config *config,
@@ -147,6 +166,20 @@ int last_tsc_overflow(const struct lib_ring_buffer_config *config,
 	else
 		return 0;
 }
+
+/*
+ * Time elapsed since the last TSC saved. Concurrent updates only make it
+ * larger than the delta from the record physically preceding a reservation.
+ */
+static inline
+u64 last_tsc_delta(const struct lib_ring_buffer_config *config,
+		   struct lib_ring_buffer *buf, u64 tsc)
+{
+	if (config->tsc_bits == 0 || config->tsc_bits == 64)
+		return ~0ULL;
+
+	return tsc - v_read(config, &buf->last_tsc);
+}
 #endif
 
 extern
@@ -171,8 +204,32 @@ void lib_ring_buffer_switch_remote(struct lib_ring_buffer *buf);
 extern
 void lib_ring_buffer_switch_remote_empty(struct lib_ring_buffer *buf);
 
+extern
+void lib_ring_buffer_cpu_ready(struct channel *chan, int cpu);
+
 /* Buffer write helpers */
 
+/*
+ * Position of the slowest reader of the buffer, additional readers
+ * included. The writer does not reuse the sub-buffers after it in
+ * discard mode.
+ */
+static inline
+unsigned long lib_ring_buffer_slowest_consumed(struct lib_ring_buffer *buf)
+{
+	unsigned long consumed, readers_consumed;
+
+	consumed = atomic_long_read(&buf->consumed);
+	if (likely(!ACCESS_ONCE(buf->nr_readers)))
+		return consumed;
+	/* Read the readers count before the position of the slowest. */
+	smp_rmb();
+	readers_consumed = atomic_long_read(&buf->readers_consumed);
+	if ((long) (readers_consumed - consumed) < 0)
+		return readers_consumed;
+	return consumed;
+}
+
 static inline
 void lib_ring_buffer_reserve_push_reader(struct lib_ring_buffer *buf,
 					 struct channel *chan,
@@ -243,7 +300,8 @@ int lib_ring_buffer_reserve_committed(const struct lib_ring_buffer_config *confi
 	do {
 		offset = v_read(config, &buf->offset);
 		idx = subbuf_index(offset, chan);
-		commit_count = v_read(config, &buf->commit_hot[idx].cc);
+		commit_count = v_read(config,
+			&lib_ring_buffer_commit_hot(config, buf, idx)->cc);
 	} while (offset != v_read(config, &buf->offset));
 
 	return ((buf_trunc(offset, chan) >> chan->backend.num_subbuf_order)
@@ -29,10 +29,15 @@
  */
 
 #include <linux/kref.h>
+#include <linux/cache.h>
+#include <linux/hrtimer.h>
+#ifdef CONFIG_IRQ_WORK
+#include <linux/irq_work.h>
+#endif
 #include <wrapper/ringbuffer/config.h>
 #include <wrapper/ringbuffer/backend_types.h>
 #include <wrapper/spinlock.h>
-#include <lib/prio_heap/lttng_prio_heap.h>	/* For per-CPU read-side iterator */
+#include <lib/prio_heap/lttng_tournament_tree.h>	/* For per-CPU read-side iterator */
 #include <lttng-cpuhotplug.h>
 
 /*
@@ -43,8 +48,8 @@ enum switch_mode { SWITCH_ACTIVE, SWITCH_FLUSH };
 
 /* channel-level read-side iterator */
 struct channel_iter {
-	/* Prio heap of buffers. Lowest timestamps at the top. */
-	struct lttng_ptr_heap heap;	/* Heap of struct lib_ring_buffer ptrs */
+	/* Per-cpu buffers with data. Lowest timestamp at the top. */
+	struct lttng_tournament_tree tree;	/* Of struct lib_ring_buffer ptrs */
 	struct list_head empty_head;	/* Empty buffers linked-list head */
 	int read_open;			/* Opened for reading ? */
 	u64 last_qs;			/* Last quiescent state timestamp */
@@ -68,8 +73,10 @@ struct channel {
 
 	struct channel_backend backend;		/* Associated backend */
 
-	unsigned long switch_timer_interval;	/* Buffer flush (jiffies) */
-	unsigned long read_timer_interval;	/* Reader wakeup (jiffies) */
+	unsigned long switch_timer_interval;	/* Buffer flush (us) */
+	unsigned long read_timer_interval;	/* Reader wakeup (us) */
+	int writer_wakeup;			/* Writers wake up readers */
+	int no_record_count;			/* No per-record counting */
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0))
 	struct lttng_cpuhp_node cpuhp_prepare;
 	struct lttng_cpuhp_node cpuhp_online;
@@ -83,6 +90,11 @@ struct channel {
 	struct notifier_block tick_nohz_notifier; /* CPU nohz notifier */
 	wait_queue_head_t read_wait;		/* reader wait queue */
 	wait_queue_head_t hp_wait;		/* CPU hotplug wait queue */
+	atomic_long_t records_lost_pending;	/*
+						 * Records lost while the
+						 * buffer of their CPU is
+						 * being created
+						 */
 	int finalized;				/* Has channel been finalized */
 	struct channel_iter iter;		/* Channel read-side iterator */
 	struct kref ref;			/* Reference count */
@@ -118,6 +130,23 @@ struct lib_ring_buffer_iter {
 };
 
 /* ring buffer state */
+/*
+ * Index entry of a delivered sub-buffer, filled by the client when the
+ * packet is closed. The entry of the packet of sequence number s is at
+ * s modulo the number of sub-buffers: it is valid while its seq_num is
+ * s, and invalidated before being rewritten.
+ */
+struct lib_ring_buffer_packet_index {
+	uint64_t timestamp_begin;
+	uint64_t timestamp_end;
+	uint64_t content_size;
+	uint64_t packet_size;
+	uint64_t events_discarded;
+	uint64_t stream_id;
+	uint64_t stream_instance_id;
+	uint64_t seq_num;
+};
+
 struct lib_ring_buffer {
 	/* First 32 bytes cache-hot cacheline */
 	union v_atomic offset;		/* Current offset in the buffer */
@@ -132,6 +161,11 @@ struct lib_ring_buffer {
 	union v_atomic last_tsc;	/*
 					 * Last timestamp written in the buffer.
 					 */
+	struct lib_ring_buffer *cluster;	/*
+					 * Buffer this cpu writes to, with
+					 * RING_BUFFER_CLUSTER_* other than
+					 * CPU.
+					 */
 
 	struct lib_ring_buffer_backend backend;	/* Associated backend */
 
@@ -145,24 +179,118 @@ struct lib_ring_buffer {
 	union v_atomic records_lost_full;	/* Buffer full */
 	union v_atomic records_lost_wrap;	/* Nested wrap-around */
 	union v_atomic records_lost_big;	/* Events too big */
+	atomic_long_t records_lost_traced;	/*
+					 * Records lost at the last
+					 * lost records event
+					 */
 	union v_atomic records_count;	/* Number of records written */
 	union v_atomic records_overrun;	/* Number of overwritten records */
 	wait_queue_head_t read_wait;	/* reader buffer-level wait queue */
 	wait_queue_head_t write_wait;	/* writer buffer-level wait queue (for metadata only) */
+	wait_queue_head_t readers_wait;	/* additional readers wait queue */
 	int finalized;			/* buffer has been finalized */
-	struct timer_list switch_timer;	/* timer for periodical switch */
-	struct timer_list read_timer;	/* timer for read poll */
+	struct hrtimer switch_timer;	/* timer for periodical switch */
+	struct hrtimer read_timer;	/* timer for read poll */
+#ifdef CONFIG_IRQ_WORK
+	struct irq_work wakeup_work;	/* Deferred writer wakeup */
+#endif
+	unsigned int switch_timer_shift;	/* Switch timer backoff */
+	unsigned int read_timer_shift;	/* Read timer backoff */
+	unsigned int timer_backoff_max;	/* Max backoff shift, set by reader */
+	unsigned long switch_timer_offset;	/* Offset at last switch timer */
 	raw_spinlock_t raw_tick_nohz_spinlock;	/* nohz entry lock/trylock */
 	struct lib_ring_buffer_iter iter;	/* read-side iterator */
 	unsigned long get_subbuf_consumed;	/* Read-side consumed */
 	unsigned long prod_snapshot;	/* Producer count snapshot */
 	unsigned long cons_snapshot;	/* Consumer count snapshot */
+	unsigned long incr_snapshot_produced;	/*
+					 * Producer count at last
+					 * incremental snapshot
+					 */
+	int incr_snapshot_valid;	/* Incremental snapshot taken */
+	unsigned long swap_snapshot_begin;	/*
+					 * Sub-buffers swapped out to the
+					 * snapshot pool, from begin to end
+					 */
+	unsigned long swap_snapshot_end;
+	unsigned long partial_packet;	/* Packet of the partial reads */
+	unsigned long partial_offset;	/* Bytes of it already returned */
+	int partial_read;		/* Reader reads packets partially */
+	struct lib_ring_buffer_compress *compress;	/* Reader compression state */
+	/* Read timer wakeup coalescing, set by the reader */
+	unsigned long wakeup_subbuf_threshold;	/* Sub-buffers ready (0/1: any) */
+	unsigned long wakeup_deadline;	/* Max delay in jiffies */
+	unsigned long wakeup_pending_since;	/* Data ready since (jiffies) */
+	int wakeup_pending;		/* Data ready, reader not woken */
+	unsigned long peak_lag;		/* Highest reader lag seen by timers */
+	/* Last rotation position, set by the tracer under its own lock */
+	uint64_t rotate_id;		/* Rotation of the position, 0: none */
+	uint64_t rotate_seq_num;	/* First packet after the position */
+	unsigned long rotate_consumed;	/* Consumed count at the position */
+	struct lib_ring_buffer_ctrl_page *ctrl_page;	/*
+							 * Positions published
+							 * to mmap readers
+							 */
+	struct lib_ring_buffer_packet_index *packet_index;
+					/* Index entry per sub-buffer */
+	/* Additional readers, discard mode only */
+	struct list_head readers_head;	/* Protected by readers_lock */
+	spinlock_t readers_lock;
+	int nr_readers;			/* Additional readers opened */
+	atomic_long_t readers_consumed;	/* Slowest additional reader */
 	unsigned int get_subbuf:1,	/* Sub-buffer being held by reader */
 		switch_timer_enabled:1,	/* Protected by ring_buffer_nohz_lock */
 		read_timer_enabled:1,	/* Protected by ring_buffer_nohz_lock */
 		quiescent:1;
 };
 
+/*
+ * Additional reader of a buffer, with its own read position. The
+ * writer does not reuse the sub-buffers it has not consumed yet.
+ */
+struct lib_ring_buffer_reader {
+	struct lib_ring_buffer *buf;
+	struct list_head node;		/* buf->readers_head */
+	unsigned long consumed;		/* Position of the next sub-buffer */
+	unsigned long sb_bindex;	/* Backend index of the held one */
+	int get_subbuf;			/* Sub-buffer being held */
+};
+
+/*
+ * Distance between the counters of two consecutive sub-buffers in the
+ * commit_hot and commit_cold arrays.
+ */
+static inline
+size_t lib_ring_buffer_commit_stride(const struct lib_ring_buffer_config *config,
+				     size_t size)
+{
+	if (config->commit_layout == RING_BUFFER_COMMIT_CACHELINE)
+		return ALIGN(size, SMP_CACHE_BYTES);
+	return size;
+}
+
+static inline
+struct commit_counters_hot *
+	lib_ring_buffer_commit_hot(const struct lib_ring_buffer_config *config,
+				   struct lib_ring_buffer *buf,
+				   unsigned long idx)
+{
+	return (struct commit_counters_hot *) ((char *) buf->commit_hot
+		+ idx * lib_ring_buffer_commit_stride(config,
+				sizeof(struct commit_counters_hot)));
+}
+
+static inline
+struct commit_counters_cold *
+	lib_ring_buffer_commit_cold(const struct lib_ring_buffer_config *config,
+				    struct lib_ring_buffer *buf,
+				    unsigned long idx)
+{
+	return (struct commit_counters_cold *) ((char *) buf->commit_cold
+		+ idx * lib_ring_buffer_commit_stride(config,
+				sizeof(struct commit_counters_cold)));
+}
+
 static inline
 void *channel_get_private(struct channel *chan)
 {
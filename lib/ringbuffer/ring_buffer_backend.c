@@ -28,12 +28,232 @@
 #include <linux/cpu.h>
 #include <linux/mm.h>
 #include <linux/vmalloc.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/io.h>
+#include <linux/version.h>
 
 #include <wrapper/vmalloc.h>	/* for wrapper_vmalloc_sync_all() */
+#include <wrapper/vzalloc.h>
+#include <wrapper/topology.h>
 #include <wrapper/ringbuffer/config.h>
 #include <wrapper/ringbuffer/backend.h>
+#include <wrapper/ringbuffer/crash.h>
 #include <wrapper/ringbuffer/frontend.h>
 
+static unsigned long static_mem_start;
+module_param(static_mem_start, ulong, 0444);
+MODULE_PARM_DESC(static_mem_start,
+	"Physical address of the memory reserved at boot for static buffers");
+
+static unsigned long static_mem_size;
+module_param(static_mem_size, ulong, 0444);
+MODULE_PARM_DESC(static_mem_size,
+	"Size of the memory reserved at boot for static buffers");
+
+/* Pages of the static memory region in use, protected by static_mem_lock. */
+static void *static_mem_virt;
+static unsigned long *static_mem_map;
+static unsigned long static_mem_nr_pages;
+static DEFINE_MUTEX(static_mem_lock);
+
+/*
+ * First-fit allocation within the static memory region, so buffers keep
+ * their physical placement across boots.
+ */
+static
+void *lib_ring_buffer_static_alloc(unsigned long nr_pages)
+{
+	unsigned long idx;
+	void *addr = NULL;
+
+	mutex_lock(&static_mem_lock);
+	if (!static_mem_map)
+		goto end;
+	idx = bitmap_find_next_zero_area(static_mem_map, static_mem_nr_pages,
+			0, nr_pages, 0);
+	if (idx >= static_mem_nr_pages)
+		goto end;
+	bitmap_set(static_mem_map, idx, nr_pages);
+	addr = static_mem_virt + (idx << PAGE_SHIFT);
+end:
+	mutex_unlock(&static_mem_lock);
+	return addr;
+}
+
+static
+void lib_ring_buffer_static_free(void *addr, unsigned long nr_pages)
+{
+	mutex_lock(&static_mem_lock);
+	bitmap_clear(static_mem_map, (addr - static_mem_virt) >> PAGE_SHIFT,
+			nr_pages);
+	mutex_unlock(&static_mem_lock);
+}
+
+static
+unsigned long lib_ring_buffer_static_pfn(void *addr)
+{
+	return (static_mem_start >> PAGE_SHIFT)
+		+ ((addr - static_mem_virt) >> PAGE_SHIFT);
+}
+
+/*
+ * Per-cpu buffer pages are allocated on the node of their cpu, only falling
+ * back on remote nodes when the local node is out of memory. bufb->node is
+ * set to -1 if any page ends up outside of the local node.
+ */
+static
+struct page *lib_ring_buffer_alloc_pages(struct lib_ring_buffer_backend *bufb,
+					 unsigned int order)
+{
+	struct page *page;
+
+	if (bufb->cpu >= 0) {
+		page = alloc_pages_node(bufb->node,
+				GFP_KERNEL | __GFP_NOWARN | __GFP_ZERO
+					| __GFP_THISNODE,
+				order);
+		if (likely(page))
+			return page;
+	}
+	page = alloc_pages_node(cpu_to_node(max(bufb->cpu, 0)),
+			GFP_KERNEL | __GFP_NOWARN | __GFP_ZERO, order);
+	if (page && page_to_nid(page) != bufb->node)
+		bufb->node = -1;
+	return page;
+}
+
+/*
+ * RING_BUFFER_PAGE_LAZY: sub-buffers populated ahead of the sub-buffer being
+ * written, and period of the worker populating them.
+ */
+#define RING_BUFFER_LAZY_AHEAD		2
+#define RING_BUFFER_LAZY_PERIOD_MS	10
+
+static
+int lib_ring_buffer_page_pool_charge(struct channel_backend *chanb,
+				     unsigned long nr_pages)
+{
+	struct lib_ring_buffer_page_pool *pool = chanb->page_pool;
+
+	if (!pool)
+		return 0;
+	if (atomic_long_add_return(nr_pages, &pool->nr_pages)
+			> pool->max_pages && pool->max_pages) {
+		atomic_long_sub(nr_pages, &pool->nr_pages);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static
+void lib_ring_buffer_page_pool_uncharge(struct channel_backend *chanb,
+					unsigned long nr_pages)
+{
+	struct lib_ring_buffer_page_pool *pool = chanb->page_pool;
+
+	if (pool)
+		atomic_long_sub(nr_pages, &pool->nr_pages);
+}
+
+static
+int lib_ring_buffer_backend_populate(struct lib_ring_buffer_backend *bufb,
+				     unsigned long sb_bindex)
+{
+	struct lib_ring_buffer_backend_pages *rpages = bufb->array[sb_bindex];
+	unsigned long j;
+
+	if (rpages->populated)
+		return 0;
+	if (lib_ring_buffer_page_pool_charge(&bufb->chan->backend,
+			bufb->num_pages_per_subbuf))
+		return -ENOMEM;
+	for (j = 0; j < bufb->num_pages_per_subbuf; j++) {
+		struct page *page;
+
+		page = lib_ring_buffer_alloc_pages(bufb, 0);
+		if (unlikely(!page))
+			goto error;
+		rpages->p[j].virt = page_address(page);
+		rpages->p[j].pfn = page_to_pfn(page);
+	}
+	/* Zeroed pages are set before writers see them populated. */
+	smp_wmb();
+	ACCESS_ONCE(rpages->populated) = 1;
+	lib_ring_buffer_crash_update_pages(bufb, sb_bindex);
+	return 0;
+
+error:
+	while (j--)
+		__free_page(pfn_to_page(rpages->p[j].pfn));
+	lib_ring_buffer_page_pool_uncharge(&bufb->chan->backend,
+		bufb->num_pages_per_subbuf);
+	return -ENOMEM;
+}
+
+static
+void lib_ring_buffer_backend_depopulate(struct lib_ring_buffer_backend *bufb,
+					struct lib_ring_buffer_backend_pages *rpages)
+{
+	unsigned long j;
+
+	if (!rpages->populated)
+		return;
+	for (j = 0; j < bufb->num_pages_per_subbuf; j++)
+		__free_page(pfn_to_page(rpages->p[j].pfn));
+	lib_ring_buffer_page_pool_uncharge(&bufb->chan->backend,
+		bufb->num_pages_per_subbuf);
+	rpages->populated = 0;
+}
+
+/*
+ * Populate the sub-buffers following the one being written. The reader may
+ * exchange a sub-buffer concurrently: the one it hands over was populated
+ * while it was the reader sub-buffer.
+ */
+static
+void lib_ring_buffer_backend_populate_ahead(const struct lib_ring_buffer_config *config,
+					    struct lib_ring_buffer *buf)
+{
+	struct channel *chan = buf->backend.chan;
+	unsigned long sb_index, sb_bindex, i;
+
+	sb_index = subbuf_index(v_read(config, &buf->offset), chan);
+	for (i = 0; i <= RING_BUFFER_LAZY_AHEAD; i++) {
+		sb_bindex = subbuffer_id_get_index(config,
+			ACCESS_ONCE(buf->backend.buf_wsb[(sb_index + i)
+				& (chan->backend.num_subbuf - 1)].id));
+		if (lib_ring_buffer_backend_populate(&buf->backend, sb_bindex))
+			return;
+	}
+}
+
+static
+void lib_ring_buffer_backend_populate_work(struct work_struct *work)
+{
+	struct channel_backend *chanb = container_of(work,
+			struct channel_backend, populate_work.work);
+	const struct lib_ring_buffer_config *config = &chanb->config;
+	int cpu;
+
+	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
+		get_online_cpus();
+		for_each_possible_cpu(cpu) {
+			struct lib_ring_buffer *buf = per_cpu_ptr(chanb->buf, cpu);
+
+			if (!buf->backend.allocated)
+				continue;
+			lib_ring_buffer_backend_populate_ahead(config, buf);
+		}
+		put_online_cpus();
+	} else {
+		lib_ring_buffer_backend_populate_ahead(config, chanb->buf);
+	}
+	schedule_delayed_work(&chanb->populate_work,
+		max_t(unsigned long,
+			msecs_to_jiffies(RING_BUFFER_LAZY_PERIOD_MS), 1));
+}
+
 /**
  * lib_ring_buffer_backend_allocate - allocate a channel buffer
  * @config: ring buffer instance configuration
@@ -60,10 +280,25 @@ int lib_ring_buffer_backend_allocate(const struct lib_ring_buffer_config *config
 	subbuf_size = chanb->subbuf_size;
 	num_subbuf_alloc = num_subbuf;
 
+	if (config->backend == RING_BUFFER_PAGE_CONTIG
+			&& get_order(subbuf_size) >= MAX_ORDER)
+		return -EINVAL;
+
 	if (extra_reader_sb) {
 		num_pages += num_pages_per_subbuf; /* Add pages for reader */
 		num_subbuf_alloc++;
 	}
+	if (chanb->snapshot_pool) {
+		/* Add pages for the snapshot pool, after the reader's */
+		num_pages += num_pages_per_subbuf * num_subbuf;
+		num_subbuf_alloc += num_subbuf;
+	}
+
+	/* Given back by depopulating each sub-buffer. */
+	if (config->backend != RING_BUFFER_PAGE_LAZY
+			&& config->backend != RING_BUFFER_STATIC
+			&& lib_ring_buffer_page_pool_charge(chanb, num_pages))
+		return -ENOMEM;
 
 	pages = vmalloc_node(ALIGN(sizeof(*pages) * num_pages,
 				   1 << INTERNODE_CACHE_SHIFT),
@@ -79,10 +314,52 @@ int lib_ring_buffer_backend_allocate(const struct lib_ring_buffer_config *config
 	if (unlikely(!bufb->array))
 		goto array_error;
 
-	for (i = 0; i < num_pages; i++) {
-		pages[i] = alloc_pages_node(cpu_to_node(max(bufb->cpu, 0)),
-				GFP_KERNEL | __GFP_NOWARN | __GFP_ZERO, 0);
-		if (unlikely(!pages[i]))
+	if (config->backend == RING_BUFFER_PAGE_CONTIG) {
+		unsigned int order = get_order(subbuf_size);
+
+		/*
+		 * Allocate each sub-buffer as a single block, then split it
+		 * so the pages can be freed and mapped individually.
+		 */
+		for (i = 0; i < num_pages; i += num_pages_per_subbuf) {
+			struct page *page;
+
+			page = lib_ring_buffer_alloc_pages(bufb, order);
+			pages[i] = page;
+			if (unlikely(!page))
+				goto depopulate;
+			split_page(page, order);
+			for (j = 0; j < num_pages_per_subbuf; j++)
+				pages[i + j] = page + j;
+		}
+	} else if (config->backend == RING_BUFFER_STATIC) {
+		unsigned long pfn;
+
+		bufb->linear_addr = lib_ring_buffer_static_alloc(num_pages);
+		if (unlikely(!bufb->linear_addr))
+			goto depopulate;
+		memset(bufb->linear_addr, 0, num_pages << PAGE_SHIFT);
+		pfn = lib_ring_buffer_static_pfn(bufb->linear_addr);
+		for (i = 0; i < num_pages; i++) {
+			pages[i] = pfn_to_page(pfn + i);
+			if (page_to_nid(pages[i]) != bufb->node)
+				bufb->node = -1;
+		}
+	} else if (config->backend != RING_BUFFER_PAGE_LAZY) {
+		for (i = 0; i < num_pages; i++) {
+			pages[i] = lib_ring_buffer_alloc_pages(bufb, 0);
+			if (unlikely(!pages[i]))
+				goto depopulate;
+		}
+	}
+	if (config->backend == RING_BUFFER_VMAP) {
+		/*
+		 * Map the whole buffer, sub-buffer after sub-buffer, so each
+		 * sub-buffer is virtually contiguous without requiring
+		 * higher-order allocations.
+		 */
+		bufb->linear_addr = vmap(pages, num_pages, VM_MAP, PAGE_KERNEL);
+		if (unlikely(!bufb->linear_addr))
 			goto depopulate;
 	}
 	bufb->num_pages_per_subbuf = num_pages_per_subbuf;
@@ -116,11 +393,25 @@ int lib_ring_buffer_backend_allocate(const struct lib_ring_buffer_config *config
 
 	/* Assign read-side subbuffer table */
 	if (extra_reader_sb)
-		bufb->buf_rsb.id = subbuffer_id(config, 0, 1,
-						num_subbuf_alloc - 1);
+		bufb->buf_rsb.id = subbuffer_id(config, 0, 1, num_subbuf);
 	else
 		bufb->buf_rsb.id = subbuffer_id(config, 0, 1, 0);
 
+	/* Allocate and assign snapshot pool subbuffer table */
+	if (chanb->snapshot_pool) {
+		bufb->buf_psb = kzalloc_node(ALIGN(
+				sizeof(struct lib_ring_buffer_backend_subbuffer)
+				* num_subbuf,
+				1 << INTERNODE_CACHE_SHIFT),
+				GFP_KERNEL | __GFP_NOWARN,
+				cpu_to_node(max(bufb->cpu, 0)));
+		if (unlikely(!bufb->buf_psb))
+			goto free_wsb;
+		for (i = 0; i < num_subbuf; i++)
+			bufb->buf_psb[i].id = subbuffer_id(config, 0, 1,
+							num_subbuf + 1 + i);
+	}
+
 	/* Allocate subbuffer packet counter table */
 	bufb->buf_cnt = kzalloc_node(ALIGN(
 				sizeof(struct lib_ring_buffer_backend_counts)
@@ -129,19 +420,42 @@ int lib_ring_buffer_backend_allocate(const struct lib_ring_buffer_config *config
 			GFP_KERNEL | __GFP_NOWARN,
 			cpu_to_node(max(bufb->cpu, 0)));
 	if (unlikely(!bufb->buf_cnt))
-		goto free_wsb;
+		goto free_psb;
 
 	/* Assign pages to page index */
 	for (i = 0; i < num_subbuf_alloc; i++) {
+		if (config->output == RING_BUFFER_MMAP) {
+			bufb->array[i]->mmap_offset = mmap_offset;
+			mmap_offset += subbuf_size;
+		}
+		if (config->backend == RING_BUFFER_PAGE_LAZY)
+			continue;
+		bufb->array[i]->populated = 1;
 		for (j = 0; j < num_pages_per_subbuf; j++) {
 			CHAN_WARN_ON(chanb, page_idx > num_pages);
-			bufb->array[i]->p[j].virt = page_address(pages[page_idx]);
+			if (config->backend == RING_BUFFER_VMAP
+					|| config->backend == RING_BUFFER_STATIC)
+				bufb->array[i]->p[j].virt = bufb->linear_addr
+					+ (page_idx << PAGE_SHIFT);
+			else
+				bufb->array[i]->p[j].virt =
+					page_address(pages[page_idx]);
 			bufb->array[i]->p[j].pfn = page_to_pfn(pages[page_idx]);
 			page_idx++;
 		}
-		if (config->output == RING_BUFFER_MMAP) {
-			bufb->array[i]->mmap_offset = mmap_offset;
-			mmap_offset += subbuf_size;
+	}
+
+	/*
+	 * Populate the sub-buffer the writer starts in, the ones following
+	 * it, and the reader and pool sub-buffers, which are handed over to
+	 * the writer.
+	 */
+	if (config->backend == RING_BUFFER_PAGE_LAZY) {
+		for (i = 0; i < num_subbuf_alloc; i++) {
+			if (i > RING_BUFFER_LAZY_AHEAD && i < num_subbuf)
+				continue;
+			if (lib_ring_buffer_backend_populate(bufb, i))
+				goto free_cnt;
 		}
 	}
 
@@ -153,19 +467,40 @@ int lib_ring_buffer_backend_allocate(const struct lib_ring_buffer_config *config
 	vfree(pages);
 	return 0;
 
+free_cnt:
+	kfree(bufb->buf_cnt);
+free_psb:
+	kfree(bufb->buf_psb);
 free_wsb:
 	kfree(bufb->buf_wsb);
 free_array:
-	for (i = 0; (i < num_subbuf_alloc && bufb->array[i]); i++)
+	for (i = 0; (i < num_subbuf_alloc && bufb->array[i]); i++) {
+		if (config->backend == RING_BUFFER_PAGE_LAZY)
+			lib_ring_buffer_backend_depopulate(bufb, bufb->array[i]);
 		kfree(bufb->array[i]);
+	}
+	if (config->backend == RING_BUFFER_VMAP && bufb->linear_addr) {
+		vunmap(bufb->linear_addr);
+		bufb->linear_addr = NULL;
+	}
 depopulate:
 	/* Free all allocated pages */
-	for (i = 0; (i < num_pages && pages[i]); i++)
-		__free_page(pages[i]);
+	if (config->backend == RING_BUFFER_STATIC) {
+		if (bufb->linear_addr)
+			lib_ring_buffer_static_free(bufb->linear_addr,
+					num_pages);
+		bufb->linear_addr = NULL;
+	} else if (config->backend != RING_BUFFER_PAGE_LAZY) {
+		for (i = 0; (i < num_pages && pages[i]); i++)
+			__free_page(pages[i]);
+	}
 	kfree(bufb->array);
 array_error:
 	vfree(pages);
 pages_error:
+	if (config->backend != RING_BUFFER_PAGE_LAZY
+			&& config->backend != RING_BUFFER_STATIC)
+		lib_ring_buffer_page_pool_uncharge(chanb, num_pages);
 	return -ENOMEM;
 }
 
@@ -176,6 +511,7 @@ int lib_ring_buffer_backend_create(struct lib_ring_buffer_backend *bufb,
 
 	bufb->chan = container_of(chanb, struct channel, backend);
 	bufb->cpu = cpu;
+	bufb->node = cpu >= 0 ? cpu_to_node(cpu) : -1;
 
 	return lib_ring_buffer_backend_allocate(config, bufb, chanb->buf_size,
 						chanb->num_subbuf,
@@ -185,19 +521,29 @@ int lib_ring_buffer_backend_create(struct lib_ring_buffer_backend *bufb,
 void lib_ring_buffer_backend_free(struct lib_ring_buffer_backend *bufb)
 {
 	struct channel_backend *chanb = &bufb->chan->backend;
-	unsigned long i, j, num_subbuf_alloc;
+	const struct lib_ring_buffer_config *config = &chanb->config;
+	unsigned long i, num_subbuf_alloc;
 
 	num_subbuf_alloc = chanb->num_subbuf;
 	if (chanb->extra_reader_sb)
 		num_subbuf_alloc++;
+	if (chanb->snapshot_pool)
+		num_subbuf_alloc += chanb->num_subbuf;
 
 	kfree(bufb->buf_wsb);
+	kfree(bufb->buf_psb);
 	kfree(bufb->buf_cnt);
+	if (config->backend == RING_BUFFER_VMAP)
+		vunmap(bufb->linear_addr);
 	for (i = 0; i < num_subbuf_alloc; i++) {
-		for (j = 0; j < bufb->num_pages_per_subbuf; j++)
-			__free_page(pfn_to_page(bufb->array[i]->p[j].pfn));
+		if (config->backend != RING_BUFFER_STATIC)
+			lib_ring_buffer_backend_depopulate(bufb, bufb->array[i]);
 		kfree(bufb->array[i]);
 	}
+	if (config->backend == RING_BUFFER_STATIC)
+		lib_ring_buffer_static_free(bufb->linear_addr,
+				num_subbuf_alloc * bufb->num_pages_per_subbuf);
+	bufb->linear_addr = NULL;
 	kfree(bufb->array);
 	bufb->allocated = 0;
 }
@@ -212,14 +558,21 @@ void lib_ring_buffer_backend_reset(struct lib_ring_buffer_backend *bufb)
 	num_subbuf_alloc = chanb->num_subbuf;
 	if (chanb->extra_reader_sb)
 		num_subbuf_alloc++;
+	if (chanb->snapshot_pool)
+		num_subbuf_alloc += chanb->num_subbuf;
 
 	for (i = 0; i < chanb->num_subbuf; i++)
 		bufb->buf_wsb[i].id = subbuffer_id(config, 0, 1, i);
 	if (chanb->extra_reader_sb)
 		bufb->buf_rsb.id = subbuffer_id(config, 0, 1,
-						num_subbuf_alloc - 1);
+						chanb->num_subbuf);
 	else
 		bufb->buf_rsb.id = subbuffer_id(config, 0, 1, 0);
+	if (chanb->snapshot_pool) {
+		for (i = 0; i < chanb->num_subbuf; i++)
+			bufb->buf_psb[i].id = subbuffer_id(config, 0, 1,
+					chanb->num_subbuf + 1 + i);
+	}
 
 	for (i = 0; i < num_subbuf_alloc; i++) {
 		/* Don't reset mmap_offset */
@@ -228,7 +581,7 @@ void lib_ring_buffer_backend_reset(struct lib_ring_buffer_backend *bufb)
 		bufb->array[i]->data_size = 0;
 		/* Don't reset backend page and virt addresses */
 	}
-	/* Don't reset num_pages_per_subbuf, cpu, allocated */
+	/* Don't reset num_pages_per_subbuf, cpu, node, allocated */
 	v_set(config, &bufb->records_read, 0);
 }
 
@@ -243,12 +596,117 @@ void channel_backend_reset(struct channel_backend *chanb)
 
 	/*
 	 * Don't reset buf_size, subbuf_size, subbuf_size_order,
-	 * num_subbuf_order, buf_size_order, extra_reader_sb, num_subbuf,
+	 * num_subbuf_order, buf_size_order, extra_reader_sb, snapshot_pool,
+	 * num_subbuf, page_pool,
 	 * priv, notifiers, config, cpumask and name.
 	 */
 	chanb->start_tsc = config->cb.ring_buffer_clock_read(chan);
 }
 
+static
+const struct cpumask *lib_ring_buffer_cluster_cpumask(
+		const struct lib_ring_buffer_config *config, int cpu)
+{
+	switch (config->cluster) {
+	case RING_BUFFER_CLUSTER_SMT:
+		return lttng_topology_smt_cpumask(cpu);
+	case RING_BUFFER_CLUSTER_LLC:
+		return lttng_topology_llc_cpumask(cpu);
+	case RING_BUFFER_CLUSTER_CPU:
+	default:
+		return cpumask_of(cpu);
+	}
+}
+
+/*
+ * Create the buffer of a per-cpu channel cpu, or point it to the buffer
+ * of the first online cpu of its cluster. Cpus are set up in increasing
+ * order at channel creation, so that buffer already exists. A cpu being
+ * brought up may not be part of its cluster mask yet, in which case it
+ * gets its own buffer. Called with cpu hotplug held.
+ */
+static
+int lib_ring_buffer_cpu_create(struct channel_backend *chanb, int cpu)
+{
+	const struct lib_ring_buffer_config *config = &chanb->config;
+	struct lib_ring_buffer *buf = per_cpu_ptr(chanb->buf, cpu);
+	int ret;
+
+	/* Left without buffer, and thus without timers nor stream. */
+	if (!cpumask_test_cpu(cpu, chanb->alloc_cpumask))
+		return 0;
+	if (config->cluster != RING_BUFFER_CLUSTER_CPU) {
+		struct lib_ring_buffer *owner;
+		int owner_cpu;
+
+		if (buf->cluster)
+			return 0;
+		owner_cpu = cpumask_first_and(
+			lib_ring_buffer_cluster_cpumask(config, cpu),
+			cpu_online_mask);
+		if (owner_cpu < nr_cpu_ids && owner_cpu != cpu) {
+			owner = per_cpu_ptr(chanb->buf, owner_cpu);
+			if (owner->backend.allocated) {
+				rcu_assign_pointer(buf->cluster, owner);
+				return 0;
+			}
+		}
+	}
+	ret = lib_ring_buffer_create(buf, chanb, cpu);
+	if (ret)
+		return ret;
+	/* Writers of the CPU may already be running, see reserve. */
+	rcu_assign_pointer(buf->cluster, buf);
+	return 0;
+}
+
+/*
+ * Buffers of CPUs brought up after the channel creation are allocated
+ * by a worker rather than by the hotplug prepare callback, so bringing
+ * up many CPUs does not wait for the allocation of each of their
+ * buffers in turn. The buffer of a CPU is allocated on its node, as at
+ * channel creation. Records written on the CPU in the meantime are
+ * counted as lost.
+ */
+static
+void lib_ring_buffer_hp_create_work(struct work_struct *work)
+{
+	struct channel_backend *chanb = container_of(work,
+			struct channel_backend, hp_create_work);
+	struct channel *chan = container_of(chanb, struct channel, backend);
+	int cpu, ret;
+
+	get_online_cpus();
+	for_each_cpu(cpu, chanb->hp_pending_cpumask) {
+		cpumask_clear_cpu(cpu, chanb->hp_pending_cpumask);
+		ret = lib_ring_buffer_cpu_create(chanb, cpu);
+		if (ret) {
+			printk(KERN_ERR
+			  "lib_ring_buffer_hp_create_work: cpu %d "
+			  "buffer creation failed\n", cpu);
+			continue;
+		}
+		lib_ring_buffer_cpu_ready(chan, cpu);
+	}
+	put_online_cpus();
+}
+
+/*
+ * Called with CPU hotplug held, from the prepare callback.
+ */
+static
+int lib_ring_buffer_cpu_create_deferred(struct channel_backend *chanb,
+		unsigned int cpu)
+{
+	if (!chanb->hp_defer_create)
+		return lib_ring_buffer_cpu_create(chanb, cpu);
+	if (per_cpu_ptr(chanb->buf, cpu)->backend.allocated)
+		return 0;
+	cpumask_set_cpu(cpu, chanb->hp_pending_cpumask);
+	queue_work(system_unbound_wq, &chanb->hp_create_work);
+	return 0;
+}
+
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0))
 
 /*
@@ -264,13 +722,11 @@ int lttng_cpuhp_rb_backend_prepare(unsigned int cpu,
 	struct channel_backend *chanb = container_of(node,
 			struct channel_backend, cpuhp_prepare);
 	const struct lib_ring_buffer_config *config = &chanb->config;
-	struct lib_ring_buffer *buf;
 	int ret;
 
 	CHAN_WARN_ON(chanb, config->alloc == RING_BUFFER_ALLOC_GLOBAL);
 
-	buf = per_cpu_ptr(chanb->buf, cpu);
-	ret = lib_ring_buffer_create(buf, chanb, cpu);
+	ret = lib_ring_buffer_cpu_create_deferred(chanb, cpu);
 	if (ret) {
 		printk(KERN_ERR
 		  "ring_buffer_cpu_hp_callback: cpu %d "
@@ -302,7 +758,6 @@ int lib_ring_buffer_cpu_hp_callback(struct notifier_block *nb,
 	struct channel_backend *chanb = container_of(nb, struct channel_backend,
 						     cpu_hp_notifier);
 	const struct lib_ring_buffer_config *config = &chanb->config;
-	struct lib_ring_buffer *buf;
 	int ret;
 
 	CHAN_WARN_ON(chanb, config->alloc == RING_BUFFER_ALLOC_GLOBAL);
@@ -310,8 +765,7 @@ int lib_ring_buffer_cpu_hp_callback(struct notifier_block *nb,
 	switch (action) {
 	case CPU_UP_PREPARE:
 	case CPU_UP_PREPARE_FROZEN:
-		buf = per_cpu_ptr(chanb->buf, cpu);
-		ret = lib_ring_buffer_create(buf, chanb, cpu);
+		ret = lib_ring_buffer_cpu_create_deferred(chanb, cpu);
 		if (ret) {
 			printk(KERN_ERR
 			  "ring_buffer_cpu_hp_callback: cpu %d "
@@ -342,6 +796,8 @@ int lib_ring_buffer_cpu_hp_callback(struct notifier_block *nb,
  * @parent: dentry of parent directory, %NULL for root directory
  * @subbuf_size: size of sub-buffers (> PAGE_SIZE, power of 2)
  * @num_subbuf: number of sub-buffers (power of 2)
+ * @alloc_cpumask: cpus of per-cpu buffers, %NULL for all possible cpus
+ * @page_pool: pool the buffer pages are drawn from, %NULL for none
  *
  * Returns channel pointer if successful, %NULL otherwise.
  *
@@ -354,7 +810,9 @@ int lib_ring_buffer_cpu_hp_callback(struct notifier_block *nb,
 int channel_backend_init(struct channel_backend *chanb,
 			 const char *name,
 			 const struct lib_ring_buffer_config *config,
-			 void *priv, size_t subbuf_size, size_t num_subbuf)
+			 void *priv, size_t subbuf_size, size_t num_subbuf,
+			 const struct cpumask *alloc_cpumask,
+			 struct lib_ring_buffer_page_pool *page_pool)
 {
 	struct channel *chan = container_of(chanb, struct channel, backend);
 	unsigned int i;
@@ -381,8 +839,18 @@ int channel_backend_init(struct channel_backend *chanb,
 	 */
 	if (config->mode == RING_BUFFER_OVERWRITE && num_subbuf < 2)
 		return -EINVAL;
+	/*
+	 * Splicing hands buffer pages out to pipes: contiguous backends
+	 * cannot have them replaced without breaking their linear mapping.
+	 */
+	if (config->output == RING_BUFFER_SPLICE
+			&& lib_ring_buffer_backend_contig(config))
+		return -EINVAL;
 
-	ret = subbuffer_id_check_index(config, num_subbuf);
+	/* The snapshot pool doubles the sub-buffer index range. */
+	ret = subbuffer_id_check_index(config,
+			config->snapshot == RING_BUFFER_SNAPSHOT_SWAP ?
+				2 * num_subbuf : num_subbuf);
 	if (ret)
 		return ret;
 
@@ -394,13 +862,35 @@ int channel_backend_init(struct channel_backend *chanb,
 	chanb->num_subbuf_order = get_count_order(num_subbuf);
 	chanb->extra_reader_sb =
 			(config->mode == RING_BUFFER_OVERWRITE) ? 1 : 0;
+	chanb->snapshot_pool =
+			(config->snapshot == RING_BUFFER_SNAPSHOT_SWAP) ? 1 : 0;
 	chanb->num_subbuf = num_subbuf;
+	chanb->page_pool = page_pool;
 	strlcpy(chanb->name, name, NAME_MAX);
 	memcpy(&chanb->config, config, sizeof(chanb->config));
+	INIT_DELAYED_WORK(&chanb->populate_work,
+			  lib_ring_buffer_backend_populate_work);
+	INIT_WORK(&chanb->hp_create_work, lib_ring_buffer_hp_create_work);
+
+	ret = lib_ring_buffer_crash_channel_create(chanb);
+	if (ret)
+		return ret;
 
 	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
 		if (!zalloc_cpumask_var(&chanb->cpumask, GFP_KERNEL))
-			return -ENOMEM;
+			goto free_crash;
+		if (!zalloc_cpumask_var(&chanb->hp_pending_cpumask,
+					GFP_KERNEL)) {
+			free_cpumask_var(chanb->cpumask);
+			goto free_crash;
+		}
+		if (!alloc_cpumask_var(&chanb->alloc_cpumask, GFP_KERNEL)) {
+			free_cpumask_var(chanb->hp_pending_cpumask);
+			free_cpumask_var(chanb->cpumask);
+			goto free_crash;
+		}
+		cpumask_copy(chanb->alloc_cpumask,
+			alloc_cpumask ? : cpu_possible_mask);
 	}
 
 	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
@@ -437,16 +927,14 @@ int channel_backend_init(struct channel_backend *chanb,
 
 			get_online_cpus();
 			for_each_online_cpu(i) {
-				ret = lib_ring_buffer_create(per_cpu_ptr(chanb->buf, i),
-							 chanb, i);
+				ret = lib_ring_buffer_cpu_create(chanb, i);
 				if (ret)
 					goto free_bufs;	/* cpu hotplug locked */
 			}
 			put_online_cpus();
 #else
 			for_each_possible_cpu(i) {
-				ret = lib_ring_buffer_create(per_cpu_ptr(chanb->buf, i),
-							 chanb, i);
+				ret = lib_ring_buffer_cpu_create(chanb, i);
 				if (ret)
 					goto free_bufs;
 			}
@@ -462,6 +950,8 @@ int channel_backend_init(struct channel_backend *chanb,
 			goto free_bufs;
 	}
 	chanb->start_tsc = config->cb.ring_buffer_clock_read(chan);
+	if (config->backend == RING_BUFFER_PAGE_LAZY)
+		schedule_delayed_work(&chanb->populate_work, 0);
 
 	return 0;
 
@@ -489,11 +979,36 @@ free_bufs:
 	} else
 		kfree(chanb->buf);
 free_cpumask:
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
+	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
+		free_cpumask_var(chanb->alloc_cpumask);
+		free_cpumask_var(chanb->hp_pending_cpumask);
 		free_cpumask_var(chanb->cpumask);
+	}
+free_crash:
+	lib_ring_buffer_crash_channel_destroy(chanb);
 	return -ENOMEM;
 }
 
+/**
+ * channel_backend_stop_deferred_create - stop creating hotplugged buffers
+ * @chanb: the channel backend
+ *
+ * Buffers of CPUs brought up from now on are created by the prepare
+ * callback itself, and pending creations are cancelled. Must not be
+ * called with CPU hotplug held.
+ */
+void channel_backend_stop_deferred_create(struct channel_backend *chanb)
+{
+	const struct lib_ring_buffer_config *config = &chanb->config;
+
+	if (config->alloc != RING_BUFFER_ALLOC_PER_CPU)
+		return;
+	get_online_cpus();
+	chanb->hp_defer_create = 0;
+	put_online_cpus();
+	cancel_work_sync(&chanb->hp_create_work);
+}
+
 /**
  * channel_backend_unregister_notifiers - unregister notifiers
  * @chan: the channel
@@ -515,6 +1030,8 @@ void channel_backend_unregister_notifiers(struct channel_backend *chanb)
 		unregister_hotcpu_notifier(&chanb->cpu_hp_notifier);
 #endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)) */
 	}
+	if (config->backend == RING_BUFFER_PAGE_LAZY)
+		cancel_delayed_work_sync(&chanb->populate_work);
 }
 
 /**
@@ -528,6 +1045,8 @@ void channel_backend_free(struct channel_backend *chanb)
 	const struct lib_ring_buffer_config *config = &chanb->config;
 	unsigned int i;
 
+	if (config->backend == RING_BUFFER_PAGE_LAZY)
+		cancel_delayed_work_sync(&chanb->populate_work);
 	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
 		for_each_possible_cpu(i) {
 			struct lib_ring_buffer *buf = per_cpu_ptr(chanb->buf, i);
@@ -536,6 +1055,8 @@ void channel_backend_free(struct channel_backend *chanb)
 				continue;
 			lib_ring_buffer_free(buf);
 		}
+		free_cpumask_var(chanb->alloc_cpumask);
+		free_cpumask_var(chanb->hp_pending_cpumask);
 		free_cpumask_var(chanb->cpumask);
 		free_percpu(chanb->buf);
 	} else {
@@ -545,6 +1066,7 @@ void channel_backend_free(struct channel_backend *chanb)
 		lib_ring_buffer_free(buf);
 		kfree(buf);
 	}
+	lib_ring_buffer_crash_channel_destroy(chanb);
 }
 
 /**
@@ -857,6 +1379,32 @@ void _lib_ring_buffer_strcpy_from_user_inatomic(struct lib_ring_buffer_backend *
 }
 EXPORT_SYMBOL_GPL(_lib_ring_buffer_strcpy_from_user_inatomic);
 
+/**
+ * lib_ring_buffer_backend_get_pages - number of pages held by a buffer
+ * @bufb : buffer backend
+ *
+ * Only counts the populated sub-buffers of RING_BUFFER_PAGE_LAZY
+ * buffers, which may change concurrently.
+ */
+unsigned long lib_ring_buffer_backend_get_pages(
+		struct lib_ring_buffer_backend *bufb)
+{
+	struct channel_backend *chanb = &bufb->chan->backend;
+	unsigned long i, num_subbuf_alloc, nr_pages = 0;
+
+	if (!bufb->allocated)
+		return 0;
+	num_subbuf_alloc = chanb->num_subbuf + chanb->extra_reader_sb;
+	if (chanb->snapshot_pool)
+		num_subbuf_alloc += chanb->num_subbuf;
+	for (i = 0; i < num_subbuf_alloc; i++) {
+		if (ACCESS_ONCE(bufb->array[i]->populated))
+			nr_pages += bufb->num_pages_per_subbuf;
+	}
+	return nr_pages;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_backend_get_pages);
+
 /**
  * lib_ring_buffer_read - read data from ring_buffer_buffer.
  * @bufb : buffer backend
@@ -882,7 +1430,11 @@ size_t lib_ring_buffer_read(struct lib_ring_buffer_backend *bufb, size_t offset,
 	if (unlikely(!len))
 		return 0;
 	for (;;) {
-		pagecpy = min_t(size_t, len, PAGE_SIZE - (offset & ~PAGE_MASK));
+		if (lib_ring_buffer_backend_contig(config))
+			pagecpy = len;
+		else
+			pagecpy = min_t(size_t, len,
+					PAGE_SIZE - (offset & ~PAGE_MASK));
 		id = bufb->buf_rsb.id;
 		sb_bindex = subbuffer_id_get_index(config, id);
 		rpages = bufb->array[sb_bindex];
@@ -933,7 +1485,11 @@ int __lib_ring_buffer_copy_to_user(struct lib_ring_buffer_backend *bufb,
 	if (unlikely(!len))
 		return 0;
 	for (;;) {
-		pagecpy = min_t(size_t, len, PAGE_SIZE - (offset & ~PAGE_MASK));
+		if (lib_ring_buffer_backend_contig(config))
+			pagecpy = len;
+		else
+			pagecpy = min_t(size_t, len,
+					PAGE_SIZE - (offset & ~PAGE_MASK));
 		id = bufb->buf_rsb.id;
 		sb_bindex = subbuffer_id_get_index(config, id);
 		rpages = bufb->array[sb_bindex];
@@ -959,6 +1515,64 @@ int __lib_ring_buffer_copy_to_user(struct lib_ring_buffer_backend *bufb,
 }
 EXPORT_SYMBOL_GPL(__lib_ring_buffer_copy_to_user);
 
+/**
+ * lib_ring_buffer_copy_wsb_to_user - read data being written to userspace
+ * @bufb : buffer backend
+ * @offset : offset within the buffer
+ * @dest : destination userspace address
+ * @len : length to copy to destination
+ *
+ * Reads from the sub-buffer the writer owns at offset, rather than from
+ * the sub-buffer of the reader. The caller makes sure the range is
+ * committed and that it cannot be overwritten during the copy.
+ * access_ok() must have been performed on dest addresses prior to call this
+ * function.
+ * Returns -EFAULT on error, 0 if ok.
+ */
+int lib_ring_buffer_copy_wsb_to_user(struct lib_ring_buffer_backend *bufb,
+				     size_t offset, void __user *dest,
+				     size_t len)
+{
+	struct channel_backend *chanb = &bufb->chan->backend;
+	const struct lib_ring_buffer_config *config = &chanb->config;
+	size_t index;
+	ssize_t pagecpy;
+	struct lib_ring_buffer_backend_pages *wpages;
+	unsigned long sb_bindex, id;
+
+	offset &= chanb->buf_size - 1;
+	index = (offset & (chanb->subbuf_size - 1)) >> PAGE_SHIFT;
+	if (unlikely(!len))
+		return 0;
+	id = ACCESS_ONCE(bufb->buf_wsb[offset >> chanb->subbuf_size_order].id);
+	sb_bindex = subbuffer_id_get_index(config, id);
+	wpages = bufb->array[sb_bindex];
+	for (;;) {
+		if (lib_ring_buffer_backend_contig(config))
+			pagecpy = len;
+		else
+			pagecpy = min_t(size_t, len,
+					PAGE_SIZE - (offset & ~PAGE_MASK));
+		if (__copy_to_user(dest,
+			       wpages->p[index].virt + (offset & ~PAGE_MASK),
+			       pagecpy))
+			return -EFAULT;
+		len -= pagecpy;
+		if (likely(!len))
+			break;
+		dest += pagecpy;
+		offset += pagecpy;
+		index = (offset & (chanb->subbuf_size - 1)) >> PAGE_SHIFT;
+		/*
+		 * Underlying layer should never ask for reads across
+		 * subbuffers.
+		 */
+		CHAN_WARN_ON(chanb, !(offset & (chanb->subbuf_size - 1)));
+	}
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_copy_wsb_to_user);
+
 /**
  * lib_ring_buffer_read_cstr - read a C-style string from ring_buffer.
  * @bufb : buffer backend
@@ -993,7 +1607,11 @@ int lib_ring_buffer_read_cstr(struct lib_ring_buffer_backend *bufb, size_t offse
 		CHAN_WARN_ON(chanb, config->mode == RING_BUFFER_OVERWRITE
 			     && subbuffer_id_is_noref(config, id));
 		str = (char *)rpages->p[index].virt + (offset & ~PAGE_MASK);
-		pagelen = PAGE_SIZE - (offset & ~PAGE_MASK);
+		if (lib_ring_buffer_backend_contig(config))
+			pagelen = chanb->subbuf_size
+				- (offset & (chanb->subbuf_size - 1));
+		else
+			pagelen = PAGE_SIZE - (offset & ~PAGE_MASK);
 		strpagelen = strnlen(str, pagelen);
 		if (len) {
 			pagecpy = min_t(size_t, len, strpagelen);
@@ -1058,7 +1676,8 @@ EXPORT_SYMBOL_GPL(lib_ring_buffer_read_get_pfn);
  * Should be used to get the current subbuffer header pointer. Given we know
  * it's never on a page boundary, it's safe to read/write directly
  * from/to this address, as long as the read/write is never bigger than a
- * page size.
+ * page size. With contiguous backends, the whole remainder of the
+ * sub-buffer can be accessed from this address.
  */
 void *lib_ring_buffer_read_offset_address(struct lib_ring_buffer_backend *bufb,
 					  size_t offset)
@@ -1110,3 +1729,61 @@ void *lib_ring_buffer_offset_address(struct lib_ring_buffer_backend *bufb,
 	return rpages->p[index].virt + (offset & ~PAGE_MASK);
 }
 EXPORT_SYMBOL_GPL(lib_ring_buffer_offset_address);
+
+/*
+ * Map the memory region reserved at boot for RING_BUFFER_STATIC buffers.
+ * It must be covered by struct pages, which are needed by the mmap and
+ * splice outputs.
+ */
+int lib_ring_buffer_backend_init(void)
+{
+	unsigned long pfn, start_pfn;
+
+	if (!static_mem_size)
+		return 0;
+	if (!PAGE_ALIGNED(static_mem_start) || !PAGE_ALIGNED(static_mem_size)) {
+		printk(KERN_ERR "LTTng: static buffer memory must be page aligned\n");
+		return -EINVAL;
+	}
+	start_pfn = static_mem_start >> PAGE_SHIFT;
+	static_mem_nr_pages = static_mem_size >> PAGE_SHIFT;
+	for (pfn = start_pfn; pfn < start_pfn + static_mem_nr_pages; pfn++) {
+		if (!pfn_valid(pfn)) {
+			printk(KERN_ERR "LTTng: static buffer memory at 0x%lx has no struct page\n",
+				pfn << PAGE_SHIFT);
+			return -EINVAL;
+		}
+	}
+	static_mem_map = lttng_vzalloc(BITS_TO_LONGS(static_mem_nr_pages)
+			* sizeof(unsigned long));
+	if (!static_mem_map)
+		return -ENOMEM;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0))
+	static_mem_virt = memremap(static_mem_start, static_mem_size,
+			MEMREMAP_WB);
+#else
+	static_mem_virt = (void __force *) ioremap_cache(static_mem_start,
+			static_mem_size);
+#endif
+	if (!static_mem_virt) {
+		vfree(static_mem_map);
+		static_mem_map = NULL;
+		return -ENOMEM;
+	}
+	/* Probes write to the buffers, they must not take vmalloc faults. */
+	wrapper_vmalloc_sync_all();
+	return 0;
+}
+
+void lib_ring_buffer_backend_exit(void)
+{
+	if (!static_mem_map)
+		return;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0))
+	memunmap(static_mem_virt);
+#else
+	iounmap((void __iomem __force *) static_mem_virt);
+#endif
+	vfree(static_mem_map);
+	static_mem_map = NULL;
+}
@@ -0,0 +1,144 @@
+/*
+ * ring_buffer_compress.c
+ *
+ * Consumer-side LZ4 compression of the sub-buffer held by the reader.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
+
+#include <wrapper/lz4.h>
+#include <wrapper/ringbuffer/backend.h>
+#include <wrapper/ringbuffer/frontend.h>
+#include <wrapper/ringbuffer/vfs.h>
+
+#ifdef LTTNG_HAVE_LZ4
+
+struct lib_ring_buffer_compress {
+	void *wrkmem;		/* LZ4 work memory */
+	void *src;		/* Linearized sub-buffer */
+	void *dst;		/* Compressed sub-buffer */
+	size_t dst_size;
+};
+
+static
+struct lib_ring_buffer_compress *
+	lib_ring_buffer_compress_alloc(struct channel *chan)
+{
+	struct lib_ring_buffer_compress *compress;
+
+	compress = kzalloc(sizeof(*compress), GFP_KERNEL);
+	if (!compress)
+		return NULL;
+	compress->wrkmem = vmalloc(LTTNG_LZ4_MEM_COMPRESS);
+	if (!compress->wrkmem)
+		goto error;
+	compress->src = vmalloc(chan->backend.subbuf_size);
+	if (!compress->src)
+		goto error;
+	compress->dst_size = lttng_lz4_compress_bound(chan->backend.subbuf_size);
+	compress->dst = vmalloc(compress->dst_size);
+	if (!compress->dst)
+		goto error;
+	return compress;
+
+error:
+	vfree(compress->src);
+	vfree(compress->wrkmem);
+	kfree(compress);
+	return NULL;
+}
+
+/**
+ * lib_ring_buffer_compress_subbuf - compress the sub-buffer held by the reader
+ * @buf: ring buffer
+ * @ucompress: user-space request, see struct lib_ring_buffer_compressed_subbuf
+ *
+ * Compresses the padded content of the sub-buffer currently held by the
+ * reader (GET_SUBBUF/GET_NEXT_SUBBUF) into the user-space buffer described
+ * by @ucompress, and stores the compressed size in its compressed_len
+ * field. Returns -EOVERFLOW with compressed_len set if the destination is
+ * too small. This runs in consumer context, never on the tracing fast path.
+ */
+long lib_ring_buffer_compress_subbuf(struct lib_ring_buffer *buf,
+		struct lib_ring_buffer_compressed_subbuf __user *ucompress)
+{
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	struct lib_ring_buffer_compressed_subbuf req;
+	struct lib_ring_buffer_compress *compress;
+	unsigned long len;
+	size_t compressed_len;
+	int ret;
+
+	if (!buf->get_subbuf)
+		return -EINVAL;
+	if (copy_from_user(&req, ucompress, sizeof(req)))
+		return -EFAULT;
+	if (!buf->compress) {
+		buf->compress = lib_ring_buffer_compress_alloc(chan);
+		if (!buf->compress)
+			return -ENOMEM;
+	}
+	compress = buf->compress;
+
+	len = PAGE_ALIGN(lib_ring_buffer_get_read_data_size(config, buf));
+	lib_ring_buffer_read(&buf->backend, buf->get_subbuf_consumed,
+			compress->src, len);
+	compressed_len = compress->dst_size;
+	ret = lttng_lz4_compress(compress->src, len, compress->dst,
+			&compressed_len, compress->wrkmem);
+	if (ret)
+		return ret;
+	if (put_user((uint64_t) compressed_len, &ucompress->compressed_len))
+		return -EFAULT;
+	if (compressed_len > req.dst_len)
+		return -EOVERFLOW;
+	if (copy_to_user((void __user *) (unsigned long) req.dst,
+			compress->dst, compressed_len))
+		return -EFAULT;
+	return 0;
+}
+
+void lib_ring_buffer_compress_free(struct lib_ring_buffer *buf)
+{
+	struct lib_ring_buffer_compress *compress = buf->compress;
+
+	if (!compress)
+		return;
+	vfree(compress->dst);
+	vfree(compress->src);
+	vfree(compress->wrkmem);
+	kfree(compress);
+	buf->compress = NULL;
+}
+
+#else /* #ifdef LTTNG_HAVE_LZ4 */
+
+long lib_ring_buffer_compress_subbuf(struct lib_ring_buffer *buf,
+		struct lib_ring_buffer_compressed_subbuf __user *ucompress)
+{
+	return -ENOSYS;
+}
+
+void lib_ring_buffer_compress_free(struct lib_ring_buffer *buf)
+{
+}
+
+#endif /* #else #ifdef LTTNG_HAVE_LZ4 */
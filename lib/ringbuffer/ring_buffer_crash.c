@@ -0,0 +1,216 @@
+/*
+ * ring_buffer_crash.c
+ *
+ * Post-mortem layout descriptors of the ring buffers, listed from a known
+ * symbol so crash and drgn scripts can extract the buffers from a vmcore.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+
+#include <wrapper/ringbuffer/backend.h>
+#include <wrapper/ringbuffer/crash.h>
+#include <wrapper/ringbuffer/frontend.h>
+
+struct lib_ring_buffer_crash_root lib_ring_buffer_crash_root = {
+	.magic = LIB_RING_BUFFER_CRASH_MAGIC,
+	.version = LIB_RING_BUFFER_CRASH_VERSION,
+	.root_size = sizeof(struct lib_ring_buffer_crash_root),
+	.channel_size = sizeof(struct lib_ring_buffer_crash_channel),
+	.buffer_size = sizeof(struct lib_ring_buffer_crash_buffer),
+	.word_size = sizeof(unsigned long),
+	.page_size = PAGE_SIZE,
+	.sb_id_stride = sizeof(struct lib_ring_buffer_backend_subbuffer),
+	.commit_hot_cc = offsetof(struct commit_counters_hot, cc),
+	.commit_hot_seq = offsetof(struct commit_counters_hot, seq),
+};
+EXPORT_SYMBOL_GPL(lib_ring_buffer_crash_root);
+
+/* Protects the channel list of the root. */
+static DEFINE_MUTEX(crash_mutex);
+
+static
+int crash_enabled(const struct lib_ring_buffer_config *config)
+{
+	return config->oops == RING_BUFFER_OOPS_CONSISTENCY;
+}
+
+static
+unsigned long crash_num_subbuf_alloc(struct channel_backend *chanb)
+{
+	unsigned long num_subbuf_alloc = chanb->num_subbuf;
+
+	if (chanb->extra_reader_sb)
+		num_subbuf_alloc++;
+	if (chanb->snapshot_pool)
+		num_subbuf_alloc += chanb->num_subbuf;
+	return num_subbuf_alloc;
+}
+
+static
+struct lib_ring_buffer_crash_buffer *crash_buffer(struct lib_ring_buffer *buf)
+{
+	struct lib_ring_buffer_crash_channel *desc =
+		buf->backend.chan->backend.crash;
+
+	if (!desc)
+		return NULL;
+	return &desc->buffers[max(buf->backend.cpu, 0)];
+}
+
+int lib_ring_buffer_crash_channel_create(struct channel_backend *chanb)
+{
+	const struct lib_ring_buffer_config *config = &chanb->config;
+	struct lib_ring_buffer_crash_channel *desc;
+	unsigned int nr_buffers, i;
+
+	if (!crash_enabled(config))
+		return 0;
+	nr_buffers = config->alloc == RING_BUFFER_ALLOC_PER_CPU ?
+			nr_cpu_ids : 1;
+	desc = vzalloc(sizeof(*desc) + nr_buffers * sizeof(desc->buffers[0]));
+	if (!desc)
+		return -ENOMEM;
+	desc->magic = LIB_RING_BUFFER_CRASH_CHANNEL_MAGIC;
+	strlcpy(desc->name, chanb->name, sizeof(desc->name));
+	desc->subbuf_size = chanb->subbuf_size;
+	desc->sb_index_mask = config->mode == RING_BUFFER_OVERWRITE ?
+			SB_ID_INDEX_MASK : ~0ULL;
+	desc->num_subbuf = chanb->num_subbuf;
+	desc->num_subbuf_alloc = crash_num_subbuf_alloc(chanb);
+	desc->pages_per_subbuf = chanb->subbuf_size >> PAGE_SHIFT;
+	desc->commit_hot_stride = lib_ring_buffer_commit_stride(config,
+			sizeof(struct commit_counters_hot));
+	desc->mode = config->mode;
+	desc->nr_buffers = nr_buffers;
+	for (i = 0; i < nr_buffers; i++)
+		desc->buffers[i].cpu =
+			config->alloc == RING_BUFFER_ALLOC_PER_CPU ? i : -1;
+	chanb->crash = desc;
+
+	mutex_lock(&crash_mutex);
+	desc->next = lib_ring_buffer_crash_root.channels;
+	/* Descriptor initialized before it is reachable from the root. */
+	smp_wmb();
+	ACCESS_ONCE(lib_ring_buffer_crash_root.channels) =
+		(uint64_t) (unsigned long) desc;
+	mutex_unlock(&crash_mutex);
+	return 0;
+}
+
+/*
+ * Called once the buffers of the channel are freed.
+ */
+void lib_ring_buffer_crash_channel_destroy(struct channel_backend *chanb)
+{
+	struct lib_ring_buffer_crash_channel *desc = chanb->crash;
+	uint64_t *link;
+
+	if (!desc)
+		return;
+	mutex_lock(&crash_mutex);
+	for (link = &lib_ring_buffer_crash_root.channels; *link;
+			link = &((struct lib_ring_buffer_crash_channel *)
+				(unsigned long) *link)->next) {
+		if (*link == (uint64_t) (unsigned long) desc) {
+			ACCESS_ONCE(*link) = desc->next;
+			break;
+		}
+	}
+	mutex_unlock(&crash_mutex);
+	chanb->crash = NULL;
+	vfree(desc);
+}
+
+void lib_ring_buffer_crash_set_priv(struct channel *chan, void *priv)
+{
+	struct lib_ring_buffer_crash_channel *desc = chan->backend.crash;
+
+	if (!desc)
+		return;
+	ACCESS_ONCE(desc->priv) = (uint64_t) (unsigned long) priv;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_crash_set_priv);
+
+/*
+ * Called with the sub-buffer pages allocated or replaced, before they are
+ * written to. Pages of sub-buffers not populated are listed as 0.
+ */
+void lib_ring_buffer_crash_update_pages(struct lib_ring_buffer_backend *bufb,
+		unsigned long sb_bindex)
+{
+	struct lib_ring_buffer_backend_pages *rpages = bufb->array[sb_bindex];
+	uint64_t *pages = bufb->crash_pages;
+	unsigned long j;
+
+	if (!pages)
+		return;
+	pages += sb_bindex * bufb->num_pages_per_subbuf;
+	for (j = 0; j < bufb->num_pages_per_subbuf; j++)
+		ACCESS_ONCE(pages[j]) = rpages->populated ?
+			(uint64_t) rpages->p[j].pfn << PAGE_SHIFT : 0;
+}
+
+/*
+ * Called once the backend and the commit counters of the buffer are
+ * allocated.
+ */
+int lib_ring_buffer_crash_buffer_create(struct lib_ring_buffer *buf)
+{
+	struct lib_ring_buffer_backend *bufb = &buf->backend;
+	struct lib_ring_buffer_crash_buffer *desc = crash_buffer(buf);
+	unsigned long i, num_subbuf_alloc;
+
+	if (!desc)
+		return 0;
+	num_subbuf_alloc = crash_num_subbuf_alloc(&bufb->chan->backend);
+	bufb->crash_pages = vzalloc_node(num_subbuf_alloc
+			* bufb->num_pages_per_subbuf * sizeof(uint64_t),
+			cpu_to_node(max(bufb->cpu, 0)));
+	if (!bufb->crash_pages)
+		return -ENOMEM;
+	for (i = 0; i < num_subbuf_alloc; i++)
+		lib_ring_buffer_crash_update_pages(bufb, i);
+	desc->offset = (uint64_t) (unsigned long) &buf->offset;
+	desc->consumed = (uint64_t) (unsigned long) &buf->consumed;
+	desc->commit_hot = (uint64_t) (unsigned long) buf->commit_hot;
+	desc->wsb = (uint64_t) (unsigned long) bufb->buf_wsb;
+	desc->rsb = (uint64_t) (unsigned long) &bufb->buf_rsb;
+	desc->pages = (uint64_t) (unsigned long) bufb->crash_pages;
+	/* Addresses set before the descriptor is marked allocated. */
+	smp_wmb();
+	ACCESS_ONCE(desc->allocated) = 1;
+	return 0;
+}
+
+void lib_ring_buffer_crash_buffer_destroy(struct lib_ring_buffer *buf)
+{
+	struct lib_ring_buffer_crash_buffer *desc = crash_buffer(buf);
+
+	if (desc) {
+		ACCESS_ONCE(desc->allocated) = 0;
+		/* Marked unallocated before its page table is freed. */
+		smp_wmb();
+	}
+	vfree(buf->backend.crash_pages);
+	buf->backend.crash_pages = NULL;
+}
@@ -52,18 +52,35 @@
  */
 
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
 #include <linux/module.h>
 #include <linux/percpu.h>
+#include <linux/rcupdate.h>
 
 #include <wrapper/ringbuffer/config.h>
 #include <wrapper/ringbuffer/backend.h>
+#include <wrapper/ringbuffer/crash.h>
 #include <wrapper/ringbuffer/frontend.h>
 #include <wrapper/ringbuffer/iterator.h>
 #include <wrapper/ringbuffer/nohz.h>
+#include <wrapper/ringbuffer/vfs.h>
 #include <wrapper/atomic.h>
 #include <wrapper/kref.h>
+#include <wrapper/isolation.h>
+#include <wrapper/poll.h>
 #include <wrapper/percpu-defs.h>
-#include <wrapper/timer.h>
+
+/* Define the tracepoints, but do not build the probes */
+#define CREATE_TRACE_POINTS
+#define TRACE_INCLUDE_PATH instrumentation/events/lttng-module
+#define TRACE_INCLUDE_FILE lttng-ring-buffer
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-module/lttng-ring-buffer.h>
+
+DEFINE_TRACE(lttng_ring_buffer_switch);
+DEFINE_TRACE(lttng_ring_buffer_reserve_slow);
+DEFINE_TRACE(lttng_ring_buffer_lost_records);
+DEFINE_TRACE(lttng_ring_buffer_reader_wait);
 
 /*
  * Internal structure representing offsets to use at a sub-buffer switch.
@@ -96,17 +113,20 @@ void lib_ring_buffer_print_errors(struct channel *chan,
 static
 void _lib_ring_buffer_switch_remote(struct lib_ring_buffer *buf,
 		enum switch_mode mode);
+static
+void lib_ring_buffer_reader_sync(struct lib_ring_buffer *buf);
 
 static
-int lib_ring_buffer_poll_deliver(const struct lib_ring_buffer_config *config,
-				 struct lib_ring_buffer *buf,
-			         struct channel *chan)
+int lib_ring_buffer_poll_deliver_at(const struct lib_ring_buffer_config *config,
+				    struct lib_ring_buffer *buf,
+				    struct channel *chan,
+				    unsigned long consumed_old)
 {
-	unsigned long consumed_old, consumed_idx, commit_count, write_offset;
+	unsigned long consumed_idx, commit_count, write_offset;
 
-	consumed_old = atomic_long_read(&buf->consumed);
 	consumed_idx = subbuf_index(consumed_old, chan);
-	commit_count = v_read(config, &buf->commit_cold[consumed_idx].cc_sb);
+	commit_count = v_read(config,
+		&lib_ring_buffer_commit_cold(config, buf, consumed_idx)->cc_sb);
 	/*
 	 * No memory barrier here, since we are only interested
 	 * in a statistically correct polling result. The next poll will
@@ -138,6 +158,70 @@ int lib_ring_buffer_poll_deliver(const struct lib_ring_buffer_config *config,
 	return 1;
 }
 
+static
+int lib_ring_buffer_poll_deliver(const struct lib_ring_buffer_config *config,
+				 struct lib_ring_buffer *buf,
+			         struct channel *chan)
+{
+	return lib_ring_buffer_poll_deliver_at(config, buf, chan,
+			atomic_long_read(&buf->consumed));
+}
+
+/*
+ * Additional readers wait on their own queue, so they are woken up
+ * whenever the slowest of them has data, without waking up the reader
+ * of the buffer.
+ */
+static
+void lib_ring_buffer_wakeup_readers(const struct lib_ring_buffer_config *config,
+				    struct lib_ring_buffer *buf,
+				    struct channel *chan)
+{
+	if (!ACCESS_ONCE(buf->nr_readers))
+		return;
+	smp_rmb();
+	if (lib_ring_buffer_poll_deliver_at(config, buf, chan,
+			atomic_long_read(&buf->readers_consumed)))
+		wake_up_interruptible(&buf->readers_wait);
+}
+
+/*
+ * Control page updates. Concurrent writers may publish out of order, so
+ * only push the produced position forward. Readers treat these values as
+ * hints.
+ */
+static
+void lib_ring_buffer_ctrl_publish_produced(struct lib_ring_buffer *buf,
+					   unsigned long produced)
+{
+	struct lib_ring_buffer_ctrl_page *ctrl_page = buf->ctrl_page;
+
+	if (!ctrl_page)
+		return;
+	if ((long) (produced - (unsigned long) ACCESS_ONCE(ctrl_page->produced)) > 0)
+		ACCESS_ONCE(ctrl_page->produced) = produced;
+}
+
+static
+void lib_ring_buffer_ctrl_publish_consumed(struct lib_ring_buffer *buf)
+{
+	struct lib_ring_buffer_ctrl_page *ctrl_page = buf->ctrl_page;
+
+	if (!ctrl_page)
+		return;
+	ACCESS_ONCE(ctrl_page->consumed) = atomic_long_read(&buf->consumed);
+}
+
+static
+void lib_ring_buffer_ctrl_publish_finalized(struct lib_ring_buffer *buf)
+{
+	struct lib_ring_buffer_ctrl_page *ctrl_page = buf->ctrl_page;
+
+	if (!ctrl_page)
+		return;
+	ACCESS_ONCE(ctrl_page->finalized) = 1;
+}
+
 /*
  * Must be called under cpu hotplug protection.
  */
@@ -145,13 +229,29 @@ void lib_ring_buffer_free(struct lib_ring_buffer *buf)
 {
 	struct channel *chan = buf->backend.chan;
 
+#ifdef CONFIG_IRQ_WORK
+	irq_work_sync(&buf->wakeup_work);
+#endif
 	lib_ring_buffer_print_errors(chan, buf, buf->backend.cpu);
+	lib_ring_buffer_compress_free(buf);
+	lib_ring_buffer_crash_buffer_destroy(buf);
+	free_page((unsigned long) buf->ctrl_page);
+	kfree(buf->packet_index);
 	kfree(buf->commit_hot);
 	kfree(buf->commit_cold);
 
 	lib_ring_buffer_backend_free(&buf->backend);
 }
 
+static void lib_ring_buffer_packet_index_reset(struct lib_ring_buffer *buf)
+{
+	struct channel *chan = buf->backend.chan;
+	unsigned int i;
+
+	for (i = 0; i < chan->backend.num_subbuf; i++)
+		buf->packet_index[i].seq_num = -1ULL;
+}
+
 /**
  * lib_ring_buffer_reset - Reset ring buffer to initial values.
  * @buf: Ring buffer.
@@ -174,9 +274,13 @@ void lib_ring_buffer_reset(struct lib_ring_buffer *buf)
 	lib_ring_buffer_iterator_reset(buf);
 	v_set(config, &buf->offset, 0);
 	for (i = 0; i < chan->backend.num_subbuf; i++) {
-		v_set(config, &buf->commit_hot[i].cc, 0);
-		v_set(config, &buf->commit_hot[i].seq, 0);
-		v_set(config, &buf->commit_cold[i].cc_sb, 0);
+		struct commit_counters_hot *cc_hot =
+			lib_ring_buffer_commit_hot(config, buf, i);
+
+		v_set(config, &cc_hot->cc, 0);
+		v_set(config, &cc_hot->seq, 0);
+		v_set(config,
+			&lib_ring_buffer_commit_cold(config, buf, i)->cc_sb, 0);
 	}
 	atomic_long_set(&buf->consumed, 0);
 	atomic_set(&buf->record_disabled, 0);
@@ -186,9 +290,13 @@ void lib_ring_buffer_reset(struct lib_ring_buffer *buf)
 	v_set(config, &buf->records_lost_full, 0);
 	v_set(config, &buf->records_lost_wrap, 0);
 	v_set(config, &buf->records_lost_big, 0);
+	atomic_long_set(&buf->records_lost_traced, 0);
 	v_set(config, &buf->records_count, 0);
 	v_set(config, &buf->records_overrun, 0);
+	lib_ring_buffer_packet_index_reset(buf);
 	buf->finalized = 0;
+	buf->incr_snapshot_valid = 0;
+	buf->swap_snapshot_begin = buf->swap_snapshot_end = 0;
 }
 EXPORT_SYMBOL_GPL(lib_ring_buffer_reset);
 
@@ -219,6 +327,23 @@ EXPORT_SYMBOL_GPL(channel_reset);
 /*
  * Must be called under cpu hotplug protection.
  */
+#ifdef CONFIG_IRQ_WORK
+/*
+ * Wakeup deferred by a writer which delivered a sub-buffer, run from
+ * interrupt context where the wait queue locks can be taken.
+ */
+static void lib_ring_buffer_wakeup_work(struct irq_work *entry)
+{
+	struct lib_ring_buffer *buf =
+		container_of(entry, struct lib_ring_buffer, wakeup_work);
+	struct channel *chan = buf->backend.chan;
+
+	wake_up_interruptible(&buf->read_wait);
+	wake_up_interruptible(&chan->read_wait);
+	lib_ring_buffer_wakeup_readers(&chan->backend.config, buf, chan);
+}
+#endif
+
 int lib_ring_buffer_create(struct lib_ring_buffer *buf,
 			   struct channel_backend *chanb, int cpu)
 {
@@ -244,7 +369,8 @@ int lib_ring_buffer_create(struct lib_ring_buffer *buf,
 		return ret;
 
 	buf->commit_hot =
-		kzalloc_node(ALIGN(sizeof(*buf->commit_hot)
+		kzalloc_node(ALIGN(lib_ring_buffer_commit_stride(config,
+					sizeof(*buf->commit_hot))
 				   * chan->backend.num_subbuf,
 				   1 << INTERNODE_CACHE_SHIFT),
 			GFP_KERNEL | __GFP_NOWARN,
@@ -255,7 +381,8 @@ int lib_ring_buffer_create(struct lib_ring_buffer *buf,
 	}
 
 	buf->commit_cold =
-		kzalloc_node(ALIGN(sizeof(*buf->commit_cold)
+		kzalloc_node(ALIGN(lib_ring_buffer_commit_stride(config,
+					sizeof(*buf->commit_cold))
 				   * chan->backend.num_subbuf,
 				   1 << INTERNODE_CACHE_SHIFT),
 			GFP_KERNEL | __GFP_NOWARN,
@@ -265,8 +392,34 @@ int lib_ring_buffer_create(struct lib_ring_buffer *buf,
 		goto free_commit;
 	}
 
+	buf->packet_index =
+		kzalloc_node(sizeof(*buf->packet_index)
+				   * chan->backend.num_subbuf,
+			GFP_KERNEL | __GFP_NOWARN,
+			cpu_to_node(max(cpu, 0)));
+	if (!buf->packet_index) {
+		ret = -ENOMEM;
+		goto free_commit_cold;
+	}
+	lib_ring_buffer_packet_index_reset(buf);
+
+	if (config->output == RING_BUFFER_MMAP) {
+		buf->ctrl_page = (struct lib_ring_buffer_ctrl_page *)
+			get_zeroed_page(GFP_KERNEL);
+		if (!buf->ctrl_page) {
+			ret = -ENOMEM;
+			goto free_packet_index;
+		}
+	}
+
 	init_waitqueue_head(&buf->read_wait);
 	init_waitqueue_head(&buf->write_wait);
+	init_waitqueue_head(&buf->readers_wait);
+	INIT_LIST_HEAD(&buf->readers_head);
+	spin_lock_init(&buf->readers_lock);
+#ifdef CONFIG_IRQ_WORK
+	init_irq_work(&buf->wakeup_work, lib_ring_buffer_wakeup_work);
+#endif
 	raw_spin_lock_init(&buf->raw_tick_nohz_spinlock);
 
 	/*
@@ -278,12 +431,17 @@ int lib_ring_buffer_create(struct lib_ring_buffer *buf,
 	subbuffer_id_clear_noref(config, &buf->backend.buf_wsb[0].id);
 	tsc = config->cb.ring_buffer_clock_read(buf->backend.chan);
 	config->cb.buffer_begin(buf, tsc, 0);
-	v_add(config, subbuf_header_size, &buf->commit_hot[0].cc);
+	v_add(config, subbuf_header_size,
+		&lib_ring_buffer_commit_hot(config, buf, 0)->cc);
+
+	ret = lib_ring_buffer_crash_buffer_create(buf);
+	if (ret)
+		goto free_init;
 
 	if (config->cb.buffer_create) {
 		ret = config->cb.buffer_create(buf, priv, cpu, chanb->name);
 		if (ret)
-			goto free_init;
+			goto free_crash;
 	}
 
 	/*
@@ -303,7 +461,13 @@ int lib_ring_buffer_create(struct lib_ring_buffer *buf,
 	return 0;
 
 	/* Error handling */
+free_crash:
+	lib_ring_buffer_crash_buffer_destroy(buf);
 free_init:
+	free_page((unsigned long) buf->ctrl_page);
+free_packet_index:
+	kfree(buf->packet_index);
+free_commit_cold:
 	kfree(buf->commit_cold);
 free_commit:
 	kfree(buf->commit_hot);
@@ -312,30 +476,135 @@ free_chanbuf:
 	return ret;
 }
 
-static void switch_buffer_timer(unsigned long data)
+/*
+ * Start a buffer timer. Per-cpu buffer timers are pinned on the buffer's
+ * cpu: hrtimers are enqueued on the cpu calling hrtimer_start(), so remote
+ * cpus are reached through an IPI.
+ *
+ * Timers which can safely run remotely (@remote_safe) are pinned on a
+ * housekeeping cpu instead when the buffer belongs to a nohz_full cpu, so
+ * isolated cpus are not interrupted by tracing timers.
+ *
+ * @local is set when called from the buffer's cpu with interrupts off, e.g.
+ * by the tick nohz notifier, where no IPI can be sent: the timer is then
+ * pinned on the buffer's cpu.
+ */
+struct lib_ring_buffer_timer_start {
+	struct hrtimer *timer;
+	ktime_t period;
+};
+
+static void lib_ring_buffer_timer_start_local(void *info)
+{
+	struct lib_ring_buffer_timer_start *start = info;
+
+	hrtimer_start(start->timer, start->period, HRTIMER_MODE_REL_PINNED);
+}
+
+static void lib_ring_buffer_timer_start(struct lib_ring_buffer *buf,
+					struct hrtimer *timer,
+					ktime_t period, int remote_safe,
+					int local)
 {
-	struct lib_ring_buffer *buf = (struct lib_ring_buffer *)data;
 	struct channel *chan = buf->backend.chan;
 	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	struct lib_ring_buffer_timer_start start = {
+		.timer = timer,
+		.period = period,
+	};
+	int cpu, target_cpu;
+
+	if (config->alloc != RING_BUFFER_ALLOC_PER_CPU) {
+		hrtimer_start(timer, period, HRTIMER_MODE_REL);
+		return;
+	}
+	cpu = get_cpu();
+	target_cpu = buf->backend.cpu;
+	if (remote_safe && !local && lttng_cpu_is_isolated(target_cpu))
+		target_cpu = lttng_housekeeping_any_cpu();
+	if (cpu == target_cpu || WARN_ON_ONCE(local))
+		lib_ring_buffer_timer_start_local(&start);
+	else
+		smp_call_function_single(target_cpu,
+				lib_ring_buffer_timer_start_local, &start, 1);
+	put_cpu();
+}
+
+/*
+ * Timer period, in microseconds, lengthened by the backoff shift.
+ */
+static ktime_t lib_ring_buffer_timer_period(unsigned long interval,
+					    unsigned int shift)
+{
+	return ns_to_ktime(((u64) interval * NSEC_PER_USEC) << shift);
+}
+
+/*
+ * Adaptive timer backoff: double the timer period, up to the limit set by
+ * the reader, each time the timer fires on an idle or quiescent buffer.
+ * Go back to the base period as soon as the buffer is active.
+ */
+static void lib_ring_buffer_timer_backoff(struct lib_ring_buffer *buf,
+					  unsigned int *shift, int active)
+{
+	if (active && !buf->quiescent)
+		*shift = 0;
+	else if (*shift < ACCESS_ONCE(buf->timer_backoff_max))
+		(*shift)++;
+}
+
+/*
+ * Keep track of the highest distance between the writer and the reader,
+ * for the tracer to size the buffers.
+ */
+static void lib_ring_buffer_sample_lag(const struct lib_ring_buffer_config *config,
+				       struct lib_ring_buffer *buf)
+{
+	unsigned long lag = lib_ring_buffer_get_offset(config, buf)
+			- lib_ring_buffer_get_consumed(config, buf);
+
+	if (lag > ACCESS_ONCE(buf->peak_lag))
+		ACCESS_ONCE(buf->peak_lag) = lag;
+}
+
+static enum hrtimer_restart switch_buffer_timer(struct hrtimer *timer)
+{
+	struct lib_ring_buffer *buf =
+		container_of(timer, struct lib_ring_buffer, switch_timer);
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	unsigned long offset;
 
 	/*
-	 * Only flush buffers periodically if readers are active.
+	 * Only flush buffers periodically if readers are active. Readers
+	 * reading packets partially do not need them to be closed.
 	 */
-	if (atomic_long_read(&buf->active_readers))
-		lib_ring_buffer_switch_slow(buf, SWITCH_ACTIVE);
+	if (atomic_long_read(&buf->active_readers)) {
+		if (config->cb.buffer_switch_timer)
+			config->cb.buffer_switch_timer(buf);
+		if (!ACCESS_ONCE(buf->partial_read))
+			lib_ring_buffer_switch_slow(buf, SWITCH_ACTIVE);
+	}
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
-		lttng_mod_timer_pinned(&buf->switch_timer,
-				 jiffies + chan->switch_timer_interval);
-	else
-		mod_timer(&buf->switch_timer,
-			  jiffies + chan->switch_timer_interval);
+	lib_ring_buffer_sample_lag(config, buf);
+
+	/* Idle if nothing was written since the previous period. */
+	offset = lib_ring_buffer_get_offset(config, buf);
+	lib_ring_buffer_timer_backoff(buf, &buf->switch_timer_shift,
+				      offset != buf->switch_timer_offset);
+	buf->switch_timer_offset = offset;
+
+	hrtimer_forward_now(timer,
+		lib_ring_buffer_timer_period(chan->switch_timer_interval,
+					     buf->switch_timer_shift));
+	return HRTIMER_RESTART;
 }
 
 /*
  * Called with ring_buffer_nohz_lock held for per-cpu buffers.
  */
-static void lib_ring_buffer_start_switch_timer(struct lib_ring_buffer *buf)
+static void lib_ring_buffer_start_switch_timer(struct lib_ring_buffer *buf,
+					       int local)
 {
 	struct channel *chan = buf->backend.chan;
 	const struct lib_ring_buffer_config *config = &chan->backend.config;
@@ -343,18 +612,16 @@ static void lib_ring_buffer_start_switch_timer(struct lib_ring_buffer *buf)
 	if (!chan->switch_timer_interval || buf->switch_timer_enabled)
 		return;
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
-		lttng_init_timer_pinned(&buf->switch_timer);
-	else
-		init_timer(&buf->switch_timer);
-
+	hrtimer_init(&buf->switch_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	buf->switch_timer.function = switch_buffer_timer;
-	buf->switch_timer.expires = jiffies + chan->switch_timer_interval;
-	buf->switch_timer.data = (unsigned long)buf;
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
-		add_timer_on(&buf->switch_timer, buf->backend.cpu);
-	else
-		add_timer(&buf->switch_timer);
+	buf->switch_timer_shift = 0;
+	/*
+	 * Sub-buffer switch is remote-safe only with global synchronization,
+	 * where buffer updates use SMP-safe atomic operations.
+	 */
+	lib_ring_buffer_timer_start(buf, &buf->switch_timer,
+		lib_ring_buffer_timer_period(chan->switch_timer_interval, 0),
+		config->sync == RING_BUFFER_SYNC_GLOBAL, local);
 	buf->switch_timer_enabled = 1;
 }
 
@@ -368,39 +635,84 @@ static void lib_ring_buffer_stop_switch_timer(struct lib_ring_buffer *buf)
 	if (!chan->switch_timer_interval || !buf->switch_timer_enabled)
 		return;
 
-	del_timer_sync(&buf->switch_timer);
+	hrtimer_cancel(&buf->switch_timer);
 	buf->switch_timer_enabled = 0;
 }
 
+/*
+ * Wakeup coalescing for the read timer: when the reader set a threshold,
+ * only wake it up once that many sub-buffers are ready, or once data has
+ * been waiting for longer than the deadline.
+ */
+static
+int lib_ring_buffer_read_timer_should_wakeup(const struct lib_ring_buffer_config *config,
+					     struct lib_ring_buffer *buf,
+					     struct channel *chan)
+{
+	unsigned long threshold, nr_ready;
+
+	if (!lib_ring_buffer_poll_deliver(config, buf, chan)) {
+		buf->wakeup_pending = 0;
+		return 0;
+	}
+	threshold = ACCESS_ONCE(buf->wakeup_subbuf_threshold);
+	if (threshold <= 1)
+		return 1;
+	nr_ready = (subbuf_trunc(lib_ring_buffer_get_offset(config, buf), chan)
+		- subbuf_trunc(lib_ring_buffer_get_consumed(config, buf), chan))
+			>> chan->backend.subbuf_size_order;
+	if (nr_ready >= threshold)
+		goto wakeup;
+	if (!buf->wakeup_pending) {
+		buf->wakeup_pending = 1;
+		buf->wakeup_pending_since = jiffies;
+		return 0;
+	}
+	if (time_after_eq(jiffies, buf->wakeup_pending_since
+			+ ACCESS_ONCE(buf->wakeup_deadline)))
+		goto wakeup;
+	return 0;
+
+wakeup:
+	buf->wakeup_pending = 0;
+	return 1;
+}
+
 /*
  * Polling timer to check the channels for data.
  */
-static void read_buffer_timer(unsigned long data)
+static enum hrtimer_restart read_buffer_timer(struct hrtimer *timer)
 {
-	struct lib_ring_buffer *buf = (struct lib_ring_buffer *)data;
+	struct lib_ring_buffer *buf =
+		container_of(timer, struct lib_ring_buffer, read_timer);
 	struct channel *chan = buf->backend.chan;
 	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	int active = 0;
 
 	CHAN_WARN_ON(chan, !buf->backend.allocated);
 
-	if (atomic_long_read(&buf->active_readers)
-	    && lib_ring_buffer_poll_deliver(config, buf, chan)) {
-		wake_up_interruptible(&buf->read_wait);
-		wake_up_interruptible(&chan->read_wait);
+	if (atomic_long_read(&buf->active_readers)) {
+		active = lib_ring_buffer_poll_deliver(config, buf, chan);
+		if (lib_ring_buffer_read_timer_should_wakeup(config, buf, chan)) {
+			wake_up_interruptible(&buf->read_wait);
+			wake_up_interruptible(&chan->read_wait);
+		}
 	}
-
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
-		lttng_mod_timer_pinned(&buf->read_timer,
-				 jiffies + chan->read_timer_interval);
-	else
-		mod_timer(&buf->read_timer,
-			  jiffies + chan->read_timer_interval);
+	lib_ring_buffer_wakeup_readers(config, buf, chan);
+	lib_ring_buffer_sample_lag(config, buf);
+
+	lib_ring_buffer_timer_backoff(buf, &buf->read_timer_shift, active);
+	hrtimer_forward_now(timer,
+		lib_ring_buffer_timer_period(chan->read_timer_interval,
+					     buf->read_timer_shift));
+	return HRTIMER_RESTART;
 }
 
 /*
  * Called with ring_buffer_nohz_lock held for per-cpu buffers.
  */
-static void lib_ring_buffer_start_read_timer(struct lib_ring_buffer *buf)
+static void lib_ring_buffer_start_read_timer(struct lib_ring_buffer *buf,
+					     int local)
 {
 	struct channel *chan = buf->backend.chan;
 	const struct lib_ring_buffer_config *config = &chan->backend.config;
@@ -410,19 +722,13 @@ static void lib_ring_buffer_start_read_timer(struct lib_ring_buffer *buf)
 	    || buf->read_timer_enabled)
 		return;
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
-		lttng_init_timer_pinned(&buf->read_timer);
-	else
-		init_timer(&buf->read_timer);
-
+	hrtimer_init(&buf->read_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	buf->read_timer.function = read_buffer_timer;
-	buf->read_timer.expires = jiffies + chan->read_timer_interval;
-	buf->read_timer.data = (unsigned long)buf;
-
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
-		add_timer_on(&buf->read_timer, buf->backend.cpu);
-	else
-		add_timer(&buf->read_timer);
+	buf->read_timer_shift = 0;
+	/* The read timer only reads buffer state: it is remote-safe. */
+	lib_ring_buffer_timer_start(buf, &buf->read_timer,
+		lib_ring_buffer_timer_period(chan->read_timer_interval, 0), 1,
+		local);
 	buf->read_timer_enabled = 1;
 }
 
@@ -439,7 +745,7 @@ static void lib_ring_buffer_stop_read_timer(struct lib_ring_buffer *buf)
 	    || !buf->read_timer_enabled)
 		return;
 
-	del_timer_sync(&buf->read_timer);
+	hrtimer_cancel(&buf->read_timer);
 	/*
 	 * do one more check to catch data that has been written in the last
 	 * timer period.
@@ -448,9 +754,40 @@ static void lib_ring_buffer_stop_read_timer(struct lib_ring_buffer *buf)
 		wake_up_interruptible(&buf->read_wait);
 		wake_up_interruptible(&chan->read_wait);
 	}
+	lib_ring_buffer_wakeup_readers(config, buf, chan);
 	buf->read_timer_enabled = 0;
 }
 
+/*
+ * With RING_BUFFER_CLUSTER_* other than CPU, the per-cpu buffer structure
+ * of a cpu writing to the buffer of another is unused: timers and hotplug
+ * handling only apply to buffers owned by their cpu. So do they to
+ * buffers created, which a hotplugged cpu may still be waiting for.
+ */
+static
+bool lib_ring_buffer_cpu_owned(const struct lib_ring_buffer_config *config,
+		struct lib_ring_buffer *buf)
+{
+	return buf->cluster == buf;
+}
+
+/*
+ * Called by the backend worker once it created the buffer of a cpu
+ * brought up after the channel creation, with CPU hotplug held. Starts
+ * what the online callback skipped while the buffer was missing.
+ */
+void lib_ring_buffer_cpu_ready(struct channel *chan, int cpu)
+{
+	struct lib_ring_buffer *buf = per_cpu_ptr(chan->backend.buf, cpu);
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+
+	wake_up_interruptible(&chan->hp_wait);
+	if (!cpu_online(cpu) || !lib_ring_buffer_cpu_owned(config, buf))
+		return;
+	lib_ring_buffer_start_switch_timer(buf, 0);
+	lib_ring_buffer_start_read_timer(buf, 0);
+}
+
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0))
 
 enum cpuhp_state lttng_rb_hp_prepare;
@@ -478,6 +815,8 @@ int lttng_cpuhp_rb_frontend_dead(unsigned int cpu,
 
 	CHAN_WARN_ON(chan, config->alloc == RING_BUFFER_ALLOC_GLOBAL);
 
+	if (!lib_ring_buffer_cpu_owned(config, buf))
+		return 0;
 	/*
 	 * Performing a buffer switch on a remote CPU. Performed by
 	 * the CPU responsible for doing the hotunplug after the target
@@ -500,8 +839,10 @@ int lttng_cpuhp_rb_frontend_online(unsigned int cpu,
 	CHAN_WARN_ON(chan, config->alloc == RING_BUFFER_ALLOC_GLOBAL);
 
 	wake_up_interruptible(&chan->hp_wait);
-	lib_ring_buffer_start_switch_timer(buf);
-	lib_ring_buffer_start_read_timer(buf);
+	if (!lib_ring_buffer_cpu_owned(config, buf))
+		return 0;
+	lib_ring_buffer_start_switch_timer(buf, 0);
+	lib_ring_buffer_start_read_timer(buf, 0);
 	return 0;
 }
 EXPORT_SYMBOL_GPL(lttng_cpuhp_rb_frontend_online);
@@ -516,6 +857,8 @@ int lttng_cpuhp_rb_frontend_offline(unsigned int cpu,
 
 	CHAN_WARN_ON(chan, config->alloc == RING_BUFFER_ALLOC_GLOBAL);
 
+	if (!lib_ring_buffer_cpu_owned(config, buf))
+		return 0;
 	lib_ring_buffer_stop_switch_timer(buf);
 	lib_ring_buffer_stop_read_timer(buf);
 	return 0;
@@ -550,14 +893,20 @@ int lib_ring_buffer_cpu_hp_callback(struct notifier_block *nb,
 
 	CHAN_WARN_ON(chan, config->alloc == RING_BUFFER_ALLOC_GLOBAL);
 
+	if (!lib_ring_buffer_cpu_owned(config, buf)) {
+		if (action == CPU_ONLINE || action == CPU_ONLINE_FROZEN)
+			wake_up_interruptible(&chan->hp_wait);
+		return NOTIFY_DONE;
+	}
+
 	switch (action) {
 	case CPU_DOWN_FAILED:
 	case CPU_DOWN_FAILED_FROZEN:
 	case CPU_ONLINE:
 	case CPU_ONLINE_FROZEN:
 		wake_up_interruptible(&chan->hp_wait);
-		lib_ring_buffer_start_switch_timer(buf);
-		lib_ring_buffer_start_read_timer(buf);
+		lib_ring_buffer_start_switch_timer(buf, 0);
+		lib_ring_buffer_start_read_timer(buf, 0);
 		return NOTIFY_OK;
 
 	case CPU_DOWN_PREPARE:
@@ -605,7 +954,8 @@ static int notrace ring_buffer_tick_nohz_callback(struct notifier_block *nb,
 	struct lib_ring_buffer *buf;
 	int cpu = smp_processor_id();
 
-	if (config->alloc != RING_BUFFER_ALLOC_PER_CPU) {
+	if (config->alloc != RING_BUFFER_ALLOC_PER_CPU
+	    || config->cluster != RING_BUFFER_CLUSTER_CPU) {
 		/*
 		 * We don't support keeping the system idle with global buffers
 		 * and streaming active. In order to do so, we would need to
@@ -628,6 +978,9 @@ static int notrace ring_buffer_tick_nohz_callback(struct notifier_block *nb,
 			wake_up_interruptible(&buf->read_wait);
 			wake_up_interruptible(&chan->read_wait);
 		}
+		if (config->wakeup == RING_BUFFER_WAKEUP_BY_TIMER
+		    && chan->read_timer_interval)
+			lib_ring_buffer_wakeup_readers(config, buf, chan);
 		if (chan->switch_timer_interval)
 			lib_ring_buffer_switch_slow(buf, SWITCH_ACTIVE);
 		raw_spin_unlock(&buf->raw_tick_nohz_spinlock);
@@ -640,8 +993,9 @@ static int notrace ring_buffer_tick_nohz_callback(struct notifier_block *nb,
 		break;
 	case TICK_NOHZ_RESTART:
 		spin_lock(lttng_this_cpu_ptr(&ring_buffer_nohz_lock));
-		lib_ring_buffer_start_read_timer(buf);
-		lib_ring_buffer_start_switch_timer(buf);
+		/* Interrupts are off: no IPI, the timers stay on this cpu. */
+		lib_ring_buffer_start_read_timer(buf, 1);
+		lib_ring_buffer_start_switch_timer(buf, 1);
 		spin_unlock(lttng_this_cpu_ptr(&ring_buffer_nohz_lock));
 		break;
 	}
@@ -675,6 +1029,7 @@ static void channel_unregister_notifiers(struct channel *chan)
 {
 	const struct lib_ring_buffer_config *config = &chan->backend.config;
 
+	channel_backend_stop_deferred_create(&chan->backend);
 	channel_iterator_unregister_notifiers(chan);
 	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
 #ifdef CONFIG_NO_HZ
@@ -711,6 +1066,9 @@ static void channel_unregister_notifiers(struct channel *chan)
 			for_each_online_cpu(cpu) {
 				struct lib_ring_buffer *buf = per_cpu_ptr(chan->backend.buf,
 								      cpu);
+
+				if (!lib_ring_buffer_cpu_owned(config, buf))
+					continue;
 				lib_ring_buffer_stop_switch_timer(buf);
 				lib_ring_buffer_stop_read_timer(buf);
 			}
@@ -720,6 +1078,9 @@ static void channel_unregister_notifiers(struct channel *chan)
 			for_each_possible_cpu(cpu) {
 				struct lib_ring_buffer *buf = per_cpu_ptr(chan->backend.buf,
 								      cpu);
+
+				if (!lib_ring_buffer_cpu_owned(config, buf))
+					continue;
 				lib_ring_buffer_stop_switch_timer(buf);
 				lib_ring_buffer_stop_read_timer(buf);
 			}
@@ -746,6 +1107,12 @@ static void lib_ring_buffer_set_quiescent(struct lib_ring_buffer *buf)
 static void lib_ring_buffer_clear_quiescent(struct lib_ring_buffer *buf)
 {
 	buf->quiescent = false;
+	/*
+	 * Timers slowed down while quiescent go back to their base period
+	 * at their next expiry.
+	 */
+	buf->switch_timer_shift = 0;
+	buf->read_timer_shift = 0;
 }
 
 void lib_ring_buffer_set_quiescent_channel(struct channel *chan)
@@ -799,6 +1166,15 @@ static void channel_free(struct channel *chan)
 	}
 	channel_iterator_free(chan);
 	channel_backend_free(&chan->backend);
+	/*
+	 * The file of a resized LTTng channel can still have epoll waiters
+	 * on the replaced channel. epoll drops them within a RCU grace
+	 * period.
+	 */
+	if (waitqueue_active(&chan->hp_wait)) {
+		lttng_wake_up_pollfree(&chan->hp_wait);
+		synchronize_rcu();
+	}
 	kfree(chan);
 }
 
@@ -825,6 +1201,33 @@ struct channel *channel_create(const struct lib_ring_buffer_config *config,
 		   size_t subbuf_size,
 		   size_t num_subbuf, unsigned int switch_timer_interval,
 		   unsigned int read_timer_interval)
+{
+	return channel_create_limited(config, name, priv, buf_addr,
+			subbuf_size, num_subbuf, switch_timer_interval,
+			read_timer_interval, NULL, NULL);
+}
+EXPORT_SYMBOL_GPL(channel_create);
+
+/**
+ * channel_create_limited - Create channel with restricted resources.
+ * @alloc_cpumask: cpus given a per-cpu buffer, %NULL for all of them
+ * @page_pool: pool the buffer pages are drawn from, %NULL for none
+ *
+ * As channel_create. Records of the cpus outside alloc_cpumask are lost,
+ * and no stream is opened for them. The iterator output expects the
+ * buffers of every online cpu, hence takes no cpumask. Creation fails
+ * if the pool cannot provide the pages allocated upfront, and
+ * RING_BUFFER_PAGE_LAZY sub-buffers it cannot provide are left
+ * unpopulated: their records are lost.
+ */
+struct channel *channel_create_limited(
+		const struct lib_ring_buffer_config *config,
+		const char *name, void *priv, void *buf_addr,
+		size_t subbuf_size, size_t num_subbuf,
+		unsigned int switch_timer_interval,
+		unsigned int read_timer_interval,
+		const struct cpumask *alloc_cpumask,
+		struct lib_ring_buffer_page_pool *page_pool)
 {
 	int ret;
 	struct channel *chan;
@@ -832,13 +1235,17 @@ struct channel *channel_create(const struct lib_ring_buffer_config *config,
 	if (lib_ring_buffer_check_config(config, switch_timer_interval,
 					 read_timer_interval))
 		return NULL;
+	if (alloc_cpumask && (config->alloc != RING_BUFFER_ALLOC_PER_CPU
+			|| config->output == RING_BUFFER_ITERATOR))
+		return NULL;
 
 	chan = kzalloc(sizeof(struct channel), GFP_KERNEL);
 	if (!chan)
 		return NULL;
 
 	ret = channel_backend_init(&chan->backend, name, config, priv,
-				   subbuf_size, num_subbuf);
+				   subbuf_size, num_subbuf, alloc_cpumask,
+				   page_pool);
 	if (ret)
 		goto error;
 
@@ -847,8 +1254,8 @@ struct channel *channel_create(const struct lib_ring_buffer_config *config,
 		goto error_free_backend;
 
 	chan->commit_count_mask = (~0UL >> chan->backend.num_subbuf_order);
-	chan->switch_timer_interval = usecs_to_jiffies(switch_timer_interval);
-	chan->read_timer_interval = usecs_to_jiffies(read_timer_interval);
+	chan->switch_timer_interval = switch_timer_interval;
+	chan->read_timer_interval = read_timer_interval;
 	kref_init(&chan->ref);
 	init_waitqueue_head(&chan->read_wait);
 	init_waitqueue_head(&chan->hp_wait);
@@ -884,9 +1291,12 @@ struct channel *channel_create(const struct lib_ring_buffer_config *config,
 			for_each_online_cpu(cpu) {
 				struct lib_ring_buffer *buf = per_cpu_ptr(chan->backend.buf,
 								       cpu);
+
+				if (!lib_ring_buffer_cpu_owned(config, buf))
+					continue;
 				spin_lock(&per_cpu(ring_buffer_nohz_lock, cpu));
-				lib_ring_buffer_start_switch_timer(buf);
-				lib_ring_buffer_start_read_timer(buf);
+				lib_ring_buffer_start_switch_timer(buf, 0);
+				lib_ring_buffer_start_read_timer(buf, 0);
 				spin_unlock(&per_cpu(ring_buffer_nohz_lock, cpu));
 			}
 			chan->cpu_hp_enable = 1;
@@ -895,9 +1305,12 @@ struct channel *channel_create(const struct lib_ring_buffer_config *config,
 			for_each_possible_cpu(cpu) {
 				struct lib_ring_buffer *buf = per_cpu_ptr(chan->backend.buf,
 								      cpu);
+
+				if (!lib_ring_buffer_cpu_owned(config, buf))
+					continue;
 				spin_lock(&per_cpu(ring_buffer_nohz_lock, cpu));
-				lib_ring_buffer_start_switch_timer(buf);
-				lib_ring_buffer_start_read_timer(buf);
+				lib_ring_buffer_start_switch_timer(buf, 0);
+				lib_ring_buffer_start_read_timer(buf, 0);
 				spin_unlock(&per_cpu(ring_buffer_nohz_lock, cpu));
 			}
 #endif
@@ -913,11 +1326,18 @@ struct channel *channel_create(const struct lib_ring_buffer_config *config,
 				       &chan->tick_nohz_notifier);
 #endif /* defined(CONFIG_NO_HZ) && defined(CONFIG_LIB_RING_BUFFER) */
 
+		/*
+		 * From now on, buffers of hotplugged CPUs are created by
+		 * the backend worker. The read-side iterator expects the
+		 * buffers of online CPUs to exist.
+		 */
+		if (config->output != RING_BUFFER_ITERATOR)
+			chan->backend.hp_defer_create = 1;
 	} else {
 		struct lib_ring_buffer *buf = chan->backend.buf;
 
-		lib_ring_buffer_start_switch_timer(buf);
-		lib_ring_buffer_start_read_timer(buf);
+		lib_ring_buffer_start_switch_timer(buf, 0);
+		lib_ring_buffer_start_read_timer(buf, 0);
 	}
 
 	return chan;
@@ -935,7 +1355,7 @@ error:
 	kfree(chan);
 	return NULL;
 }
-EXPORT_SYMBOL_GPL(channel_create);
+EXPORT_SYMBOL_GPL(channel_create_limited);
 
 static
 void channel_release(struct kref *kref)
@@ -983,7 +1403,9 @@ void *channel_destroy(struct channel *chan)
 			 */
 			smp_wmb();
 			ACCESS_ONCE(buf->finalized) = 1;
+			lib_ring_buffer_ctrl_publish_finalized(buf);
 			wake_up_interruptible(&buf->read_wait);
+			wake_up_interruptible(&buf->readers_wait);
 		}
 	} else {
 		struct lib_ring_buffer *buf = chan->backend.buf;
@@ -997,7 +1419,9 @@ void *channel_destroy(struct channel *chan)
 		 */
 		smp_wmb();
 		ACCESS_ONCE(buf->finalized) = 1;
+		lib_ring_buffer_ctrl_publish_finalized(buf);
 		wake_up_interruptible(&buf->read_wait);
+		wake_up_interruptible(&buf->readers_wait);
 	}
 	ACCESS_ONCE(chan->finalized) = 1;
 	wake_up_interruptible(&chan->hp_wait);
@@ -1012,10 +1436,15 @@ struct lib_ring_buffer *channel_get_ring_buffer(
 					const struct lib_ring_buffer_config *config,
 					struct channel *chan, int cpu)
 {
+	struct lib_ring_buffer *buf;
+
 	if (config->alloc == RING_BUFFER_ALLOC_GLOBAL)
 		return chan->backend.buf;
-	else
-		return per_cpu_ptr(chan->backend.buf, cpu);
+	buf = per_cpu_ptr(chan->backend.buf, cpu);
+	/* Cpus sharing the buffer of their cluster map to it. */
+	if (config->cluster != RING_BUFFER_CLUSTER_CPU && buf->cluster)
+		buf = buf->cluster;
+	return buf;
 }
 EXPORT_SYMBOL_GPL(channel_get_ring_buffer);
 
@@ -1029,31 +1458,280 @@ int lib_ring_buffer_open_read(struct lib_ring_buffer *buf)
 		atomic_long_dec(&buf->active_readers);
 		return -EOVERFLOW;
 	}
-	lttng_smp_mb__after_atomic();
-	return 0;
-}
-EXPORT_SYMBOL_GPL(lib_ring_buffer_open_read);
-
-void lib_ring_buffer_release_read(struct lib_ring_buffer *buf)
-{
-	struct channel *chan = buf->backend.chan;
-
-	CHAN_WARN_ON(chan, atomic_long_read(&buf->active_readers) != 1);
-	lttng_smp_mb__before_atomic();
-	atomic_long_dec(&buf->active_readers);
-	kref_put(&chan->ref, channel_release);
-}
-EXPORT_SYMBOL_GPL(lib_ring_buffer_release_read);
-
-/*
- * Promote compiler barrier to a smp_mb().
- * For the specific ring buffer case, this IPI call should be removed if the
- * architecture does not reorder writes.  This should eventually be provided by
- * a separate architecture-specific infrastructure.
- */
-static void remote_mb(void *info)
-{
-	smp_mb();
+	buf->partial_offset = 0;
+	ACCESS_ONCE(buf->partial_read) = 0;
+	lttng_smp_mb__after_atomic();
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_open_read);
+
+void lib_ring_buffer_release_read(struct lib_ring_buffer *buf)
+{
+	struct channel *chan = buf->backend.chan;
+
+	CHAN_WARN_ON(chan, atomic_long_read(&buf->active_readers) != 1);
+	lttng_smp_mb__before_atomic();
+	atomic_long_dec(&buf->active_readers);
+	kref_put(&chan->ref, channel_release);
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_release_read);
+
+/*
+ * Called with readers_lock held, with at least one additional reader.
+ */
+static
+void lib_ring_buffer_readers_update(struct lib_ring_buffer *buf)
+{
+	struct lib_ring_buffer_reader *reader;
+	unsigned long slowest;
+
+	reader = list_first_entry(&buf->readers_head,
+			struct lib_ring_buffer_reader, node);
+	slowest = reader->consumed;
+	list_for_each_entry(reader, &buf->readers_head, node) {
+		if ((long) (reader->consumed - slowest) < 0)
+			slowest = reader->consumed;
+	}
+	atomic_long_set(&buf->readers_consumed, slowest);
+}
+
+/**
+ * lib_ring_buffer_reader_open - open an additional reader of a buffer
+ * @buf: ring buffer
+ *
+ * The reader starts at the sub-buffer the reader of the buffer consumes
+ * next. Discard mode only: in overwrite mode, the reader exchanges the
+ * sub-buffers it reads with its own. Returns the reader, or a negative
+ * error value encoded with ERR_PTR().
+ */
+struct lib_ring_buffer_reader *lib_ring_buffer_reader_open(
+		struct lib_ring_buffer *buf)
+{
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	struct lib_ring_buffer_reader *reader;
+	unsigned long consumed;
+
+	if (config->mode != RING_BUFFER_DISCARD)
+		return ERR_PTR(-EINVAL);
+	reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+	if (!reader)
+		return ERR_PTR(-ENOMEM);
+	if (!lttng_kref_get(&chan->ref)) {
+		kfree(reader);
+		return ERR_PTR(-EOVERFLOW);
+	}
+	reader->buf = buf;
+	consumed = atomic_long_read(&buf->consumed);
+	/* The pages of the sub-buffer held by the reader may be spliced. */
+	if (buf->get_subbuf)
+		consumed = subbuf_align(buf->get_subbuf_consumed, chan);
+	spin_lock(&buf->readers_lock);
+	reader->consumed = consumed;
+	list_add(&reader->node, &buf->readers_head);
+	lib_ring_buffer_readers_update(buf);
+	/* Publish the slowest position before the readers count. */
+	smp_wmb();
+	ACCESS_ONCE(buf->nr_readers) = buf->nr_readers + 1;
+	/*
+	 * Writers which did not see the reader may reuse the sub-buffers
+	 * consumed since: start after them.
+	 */
+	smp_mb();
+	consumed = atomic_long_read(&buf->consumed);
+	if ((long) (consumed - reader->consumed) > 0) {
+		reader->consumed = consumed;
+		lib_ring_buffer_readers_update(buf);
+	}
+	spin_unlock(&buf->readers_lock);
+	return reader;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_reader_open);
+
+void lib_ring_buffer_reader_release(struct lib_ring_buffer_reader *reader)
+{
+	struct lib_ring_buffer *buf = reader->buf;
+	struct channel *chan = buf->backend.chan;
+
+	spin_lock(&buf->readers_lock);
+	list_del(&reader->node);
+	ACCESS_ONCE(buf->nr_readers) = buf->nr_readers - 1;
+	if (buf->nr_readers)
+		lib_ring_buffer_readers_update(buf);
+	spin_unlock(&buf->readers_lock);
+	kfree(reader);
+	kref_put(&chan->ref, channel_release);
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_reader_release);
+
+/**
+ * lib_ring_buffer_reader_get_next_subbuf - get the next sub-buffer of an
+ * additional reader
+ * @reader: additional reader
+ *
+ * Returns -ENODATA if buffer is finalized, -EAGAIN if there is currently no
+ * data to read at the reader position, or 0 if the get operation succeeds.
+ * The sub-buffer is shared with the other readers: it is only read.
+ */
+int lib_ring_buffer_reader_get_next_subbuf(struct lib_ring_buffer_reader *reader)
+{
+	struct lib_ring_buffer *buf = reader->buf;
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	unsigned long consumed = reader->consumed, consumed_idx;
+	unsigned long commit_count, write_offset;
+	int finalized;
+
+	if (reader->get_subbuf) {
+		CHAN_WARN_ON(chan, 1);
+		return -EBUSY;
+	}
+retry:
+	finalized = ACCESS_ONCE(buf->finalized);
+	/*
+	 * Read finalized before counters.
+	 */
+	smp_rmb();
+	consumed_idx = subbuf_index(consumed, chan);
+	commit_count = v_read(config,
+		&lib_ring_buffer_commit_cold(config, buf, consumed_idx)->cc_sb);
+	lib_ring_buffer_reader_sync(buf);
+	write_offset = v_read(config, &buf->offset);
+
+	/* Same checks as lib_ring_buffer_get_subbuf(). */
+	if (((commit_count - chan->backend.subbuf_size)
+	     & chan->commit_count_mask)
+	    - (buf_trunc(consumed, chan)
+	       >> chan->backend.num_subbuf_order)
+	    != 0)
+		goto nodata;
+	if (subbuf_trunc(write_offset, chan) - subbuf_trunc(consumed, chan)
+	    == 0)
+		goto nodata;
+
+	/* Discard mode does not exchange sub-buffers: the writer id holds. */
+	reader->sb_bindex = subbuffer_id_get_index(config,
+			buf->backend.buf_wsb[consumed_idx].id);
+	reader->get_subbuf = 1;
+	return 0;
+
+nodata:
+	if (finalized)
+		return -ENODATA;
+	else if (raw_spin_is_locked(&buf->raw_tick_nohz_spinlock))
+		goto retry;
+	else
+		return -EAGAIN;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_reader_get_next_subbuf);
+
+/**
+ * lib_ring_buffer_reader_put_next_subbuf - release the sub-buffer of an
+ * additional reader and move its position forward
+ * @reader: additional reader
+ */
+void lib_ring_buffer_reader_put_next_subbuf(struct lib_ring_buffer_reader *reader)
+{
+	struct lib_ring_buffer *buf = reader->buf;
+	struct channel *chan = buf->backend.chan;
+
+	if (!reader->get_subbuf) {
+		CHAN_WARN_ON(chan, 1);
+		return;
+	}
+	reader->get_subbuf = 0;
+	/* Order the sub-buffer reads before the writer may reuse it. */
+	smp_mb();
+	spin_lock(&buf->readers_lock);
+	reader->consumed = subbuf_align(reader->consumed, chan);
+	lib_ring_buffer_readers_update(buf);
+	spin_unlock(&buf->readers_lock);
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_reader_put_next_subbuf);
+
+/*
+ * Promote compiler barrier to a smp_mb().
+ * For the specific ring buffer case, this IPI call should be removed if the
+ * architecture does not reorder writes.  This should eventually be provided by
+ * a separate architecture-specific infrastructure.
+ */
+static void remote_mb(void *info)
+{
+	smp_mb();
+}
+
+/*
+ * Order the commit count read by the reader before its reads of the
+ * buffer data, with respect to the writers of the buffer.
+ */
+static
+void lib_ring_buffer_reader_sync(struct lib_ring_buffer *buf)
+{
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+
+	/*
+	 * smp_call_function_single can fail if the remote CPU is offline,
+	 * this is OK because then there is no wmb to execute there.
+	 * If our thread is executing on the same CPU as the on the buffers
+	 * belongs to, we don't have to synchronize it at all. If we are
+	 * migrated, the scheduler will take care of the memory barriers.
+	 * Normally, smp_call_function_single() should ensure program order when
+	 * executing the remote function, which implies that it surrounds the
+	 * function execution with :
+	 * smp_mb()
+	 * send IPI
+	 * csd_lock_wait
+	 *                recv IPI
+	 *                smp_mb()
+	 *                exec. function
+	 *                smp_mb()
+	 *                csd unlock
+	 * smp_mb()
+	 *
+	 * However, smp_call_function_single() does not seem to clearly execute
+	 * such barriers. It depends on spinlock semantic to provide the barrier
+	 * before executing the IPI and, when busy-looping, csd_lock_wait only
+	 * executes smp_mb() when it has to wait for the other CPU.
+	 *
+	 * I don't trust this code. Therefore, let's add the smp_mb() sequence
+	 * required ourself, even if duplicated. It has no performance impact
+	 * anyway.
+	 *
+	 * smp_mb() is needed because smp_rmb() and smp_wmb() only order read vs
+	 * read and write vs write. They do not ensure core synchronization. We
+	 * really have to ensure total order between the 3 barriers running on
+	 * the 2 CPUs.
+	 *
+	 * On total store order architectures, the writer compiler barrier is
+	 * enough to order its stores as seen from this CPU, so the IPI is
+	 * skipped and the local read barrier suffices.
+	 */
+	if (config->ipi == RING_BUFFER_IPI_BARRIER && !LIB_RING_BUFFER_TSO) {
+		if (config->sync == RING_BUFFER_SYNC_PER_CPU
+		    && config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
+			if (raw_smp_processor_id() != buf->backend.cpu) {
+				/* Total order with IPI handler smp_mb() */
+				smp_mb();
+				smp_call_function_single(buf->backend.cpu,
+							 remote_mb, NULL, 1);
+				/* Total order with IPI handler smp_mb() */
+				smp_mb();
+			}
+		} else {
+			/* Total order with IPI handler smp_mb() */
+			smp_mb();
+			smp_call_function(remote_mb, NULL, 1);
+			/* Total order with IPI handler smp_mb() */
+			smp_mb();
+		}
+	} else {
+		/*
+		 * Local rmb to match the remote wmb to read the commit count
+		 * before the buffer data and the write offset.
+		 */
+		smp_rmb();
+	}
 }
 
 /**
@@ -1119,6 +1797,217 @@ nodata:
 }
 EXPORT_SYMBOL_GPL(lib_ring_buffer_snapshot);
 
+/**
+ * lib_ring_buffer_snapshot_since - snapshot the packets after a timestamp
+ * @buf: ring buffer
+ * @timestamp: oldest timestamp of interest, in trace clock units
+ * @consumed: consumed count indicating the position where to read
+ * @produced: produced count, indicates position when to stop reading
+ *
+ * Like lib_ring_buffer_snapshot, with the consumed count moved past the
+ * packets which end before @timestamp, as told by the packet index. In
+ * overwrite mode, the consumed count first skips the packets already
+ * overwritten. A packet without index entry ends the skip, so the range
+ * is never smaller than the packets after @timestamp.
+ */
+int lib_ring_buffer_snapshot_since(struct lib_ring_buffer *buf,
+		uint64_t timestamp, unsigned long *consumed,
+		unsigned long *produced)
+{
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	unsigned long pos;
+	int ret;
+
+	ret = lib_ring_buffer_snapshot(buf, consumed, produced);
+	if (ret)
+		return ret;
+	pos = *consumed;
+	if (config->mode == RING_BUFFER_OVERWRITE
+	    && *produced - pos > chan->backend.buf_size)
+		pos = *produced - chan->backend.buf_size;
+	for (; pos != *produced; pos += chan->backend.subbuf_size) {
+		struct lib_ring_buffer_packet_index index;
+
+		if (lib_ring_buffer_packet_index_read(buf,
+				packet_seq_num(pos, chan), &index)
+		    || index.timestamp_end >= timestamp)
+			break;
+	}
+	*consumed = pos;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_snapshot_since);
+
+/*
+ * Returns 1 if the sub-buffer at consumed count @consumed is swapped out
+ * to the snapshot pool.
+ */
+static
+int lib_ring_buffer_swapped_out(struct lib_ring_buffer *buf,
+				unsigned long consumed)
+{
+	return buf->backend.buf_psb
+		&& consumed - buf->swap_snapshot_begin
+			< buf->swap_snapshot_end - buf->swap_snapshot_begin;
+}
+
+/**
+ * lib_ring_buffer_snapshot_swap - snapshot by swapping sub-buffers out
+ * @buf: ring buffer
+ * @consumed: consumed count indicating the position where to read
+ * @produced: produced count, indicates position when to stop reading
+ *
+ * Like lib_ring_buffer_snapshot, for RING_BUFFER_SNAPSHOT_SWAP buffers.
+ * Each delivered sub-buffer of the range is exchanged with a sub-buffer
+ * of the snapshot pool, so writers continue on the pool pages and the
+ * snapshot is neither copied nor overwritten while it is read. The range
+ * starts after the last sub-buffer overwritten during the exchange, and
+ * ends before the first one still being committed. Sub-buffers of the
+ * range are then served from the pool by get_subbuf, until the next
+ * swap. Returns -EINVAL without snapshot pool, -EBUSY if the reader
+ * holds a sub-buffer, or the errors of lib_ring_buffer_snapshot.
+ */
+int lib_ring_buffer_snapshot_swap(struct lib_ring_buffer *buf,
+		unsigned long *consumed, unsigned long *produced)
+{
+	struct lib_ring_buffer_backend *bufb = &buf->backend;
+	struct channel *chan = bufb->chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	unsigned long begin, pos;
+	int ret;
+
+	if (!bufb->buf_psb)
+		return -EINVAL;
+	if (buf->get_subbuf)
+		return -EBUSY;
+	ret = lib_ring_buffer_snapshot(buf, consumed, produced);
+	if (ret)
+		return ret;
+	begin = *consumed;
+	if (*produced - begin > chan->backend.buf_size)
+		begin = *produced - chan->backend.buf_size;
+	for (pos = begin; pos != *produced; pos += chan->backend.subbuf_size) {
+		ret = exchange_sb_index(config, bufb,
+				&bufb->buf_psb[subbuf_index(pos, chan)],
+				subbuf_index(pos, chan),
+				buf_trunc_val(pos, chan));
+		if (!ret)
+			continue;
+		/* Still being committed, unless the writer wrapped over it. */
+		if (v_read(config, &buf->offset) - pos
+				< chan->backend.buf_size)
+			break;
+		begin = pos + chan->backend.subbuf_size;
+	}
+	buf->swap_snapshot_begin = begin;
+	buf->swap_snapshot_end = pos;
+	*consumed = begin;
+	*produced = pos;
+	if (begin == pos)
+		return -EAGAIN;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_snapshot_swap);
+
+/**
+ * lib_ring_buffer_rotate_position - get the packet boundary after the writer
+ * @buf: ring buffer
+ * @seq_num: sequence number of the first packet after the boundary
+ * @consumed: consumed count
+ *
+ * The boundary is the end of the packet being written, or the current
+ * position if no packet is open. No sub-buffer is switched: the
+ * boundary is reached by the writers at their own pace, and the reader
+ * tells packets apart by sequence number. Lock-free with respect to
+ * the writers.
+ */
+void lib_ring_buffer_rotate_position(struct lib_ring_buffer *buf,
+				     uint64_t *seq_num,
+				     unsigned long *consumed)
+{
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	unsigned long offset, idx;
+	uint64_t seq_cnt;
+
+	do {
+		offset = v_read(config, &buf->offset);
+		idx = subbuf_index(offset, chan);
+		seq_cnt = ACCESS_ONCE(buf->backend.buf_cnt[idx].seq_cnt);
+		/*
+		 * Read the packet count before checking that the writer
+		 * is still within the same sub-buffer.
+		 */
+		smp_rmb();
+	} while (subbuf_trunc(v_read(config, &buf->offset), chan)
+			!= subbuf_trunc(offset, chan));
+	*seq_num = chan->backend.num_subbuf * seq_cnt + idx;
+	if (subbuf_offset(offset, chan))
+		(*seq_num)++;
+	*consumed = atomic_long_read(&buf->consumed);
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_rotate_position);
+
+/**
+ * lib_ring_buffer_packet_index_write - publish the index entry of a packet
+ * @buf: ring buffer
+ * @index: index entry, identified by its sequence number
+ *
+ * Called by the client when the packet is closed, before it is
+ * delivered. The entry of a sub-buffer is written by the writer closing
+ * its packet only, so concurrent writes never share an entry.
+ */
+void lib_ring_buffer_packet_index_write(struct lib_ring_buffer *buf,
+		const struct lib_ring_buffer_packet_index *index)
+{
+	struct channel *chan = buf->backend.chan;
+	struct lib_ring_buffer_packet_index *entry;
+
+	entry = &buf->packet_index[index->seq_num
+			& (chan->backend.num_subbuf - 1)];
+	ACCESS_ONCE(entry->seq_num) = -1ULL;
+	/* Invalidate the entry before updating it. */
+	smp_wmb();
+	memcpy(entry, index, offsetof(struct lib_ring_buffer_packet_index,
+				seq_num));
+	/* Update the entry before validating it. */
+	smp_wmb();
+	ACCESS_ONCE(entry->seq_num) = index->seq_num;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_packet_index_write);
+
+/**
+ * lib_ring_buffer_packet_index_read - read the index entry of a packet
+ * @buf: ring buffer
+ * @seq_num: sequence number of the packet
+ * @index: index entry (output)
+ *
+ * Returns 0 on success, -ENOENT if the packet is not delivered yet, or
+ * was overwritten by a later packet. Lock-free with respect to the
+ * writers.
+ */
+int lib_ring_buffer_packet_index_read(struct lib_ring_buffer *buf,
+		uint64_t seq_num, struct lib_ring_buffer_packet_index *index)
+{
+	struct channel *chan = buf->backend.chan;
+	struct lib_ring_buffer_packet_index *entry;
+
+	entry = &buf->packet_index[seq_num & (chan->backend.num_subbuf - 1)];
+	if (ACCESS_ONCE(entry->seq_num) != seq_num)
+		return -ENOENT;
+	/* Read the sequence number before the entry. */
+	smp_rmb();
+	memcpy(index, entry, sizeof(*index));
+	/* Read the entry before checking it was not rewritten. */
+	smp_rmb();
+	if (ACCESS_ONCE(entry->seq_num) != seq_num)
+		return -ENOENT;
+	index->seq_num = seq_num;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_packet_index_read);
+
 /**
  * lib_ring_buffer_put_snapshot - move consumed counter forward
  *
@@ -1144,11 +2033,35 @@ void lib_ring_buffer_move_consumer(struct lib_ring_buffer *buf,
 	while ((long) consumed - (long) consumed_new < 0)
 		consumed = atomic_long_cmpxchg(&buf->consumed, consumed,
 					       consumed_new);
+	lib_ring_buffer_ctrl_publish_consumed(buf);
 	/* Wake-up the metadata producer */
 	wake_up_interruptible(&buf->write_wait);
 }
 EXPORT_SYMBOL_GPL(lib_ring_buffer_move_consumer);
 
+/*
+ * Emit the time the packet at "consumed" waited for the reader, from its
+ * packet index entry.
+ */
+static
+void lib_ring_buffer_trace_reader_wait(struct lib_ring_buffer *buf,
+				       unsigned long consumed)
+{
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	struct lib_ring_buffer_packet_index index;
+	u64 now;
+
+	if (lib_ring_buffer_packet_index_read(buf,
+			packet_seq_num(consumed, chan), &index))
+		return;
+	now = config->cb.ring_buffer_clock_read(chan);
+	trace_lttng_ring_buffer_reader_wait(chan->backend.name,
+		buf->backend.cpu, index.seq_num,
+		(s64) (now - index.timestamp_end) > 0 ?
+			now - index.timestamp_end : 0);
+}
+
 /**
  * lib_ring_buffer_get_subbuf - get exclusive access to subbuffer for reading
  * @buf: ring buffer
@@ -1174,6 +2087,20 @@ int lib_ring_buffer_get_subbuf(struct lib_ring_buffer *buf,
 		CHAN_WARN_ON(chan, 1);
 		return -EBUSY;
 	}
+	if (lib_ring_buffer_swapped_out(buf, consumed)) {
+		struct lib_ring_buffer_backend_subbuffer *psb;
+		unsigned long id;
+
+		/* Both sub-buffers are owned by the reader. */
+		psb = &buf->backend.buf_psb[subbuf_index(consumed, chan)];
+		id = psb->id;
+		psb->id = buf->backend.buf_rsb.id;
+		buf->backend.buf_rsb.id = id;
+		subbuffer_id_clear_noref(config, &buf->backend.buf_rsb.id);
+		buf->get_subbuf_consumed = consumed;
+		buf->get_subbuf = 1;
+		return 0;
+	}
 retry:
 	finalized = ACCESS_ONCE(buf->finalized);
 	/*
@@ -1182,69 +2109,15 @@ retry:
 	smp_rmb();
 	consumed_cur = atomic_long_read(&buf->consumed);
 	consumed_idx = subbuf_index(consumed, chan);
-	commit_count = v_read(config, &buf->commit_cold[consumed_idx].cc_sb);
+	commit_count = v_read(config,
+		&lib_ring_buffer_commit_cold(config, buf, consumed_idx)->cc_sb);
 	/*
 	 * Make sure we read the commit count before reading the buffer
 	 * data and the write offset. Correct consumed offset ordering
 	 * wrt commit count is insured by the use of cmpxchg to update
 	 * the consumed offset.
-	 * smp_call_function_single can fail if the remote CPU is offline,
-	 * this is OK because then there is no wmb to execute there.
-	 * If our thread is executing on the same CPU as the on the buffers
-	 * belongs to, we don't have to synchronize it at all. If we are
-	 * migrated, the scheduler will take care of the memory barriers.
-	 * Normally, smp_call_function_single() should ensure program order when
-	 * executing the remote function, which implies that it surrounds the
-	 * function execution with :
-	 * smp_mb()
-	 * send IPI
-	 * csd_lock_wait
-	 *                recv IPI
-	 *                smp_mb()
-	 *                exec. function
-	 *                smp_mb()
-	 *                csd unlock
-	 * smp_mb()
-	 *
-	 * However, smp_call_function_single() does not seem to clearly execute
-	 * such barriers. It depends on spinlock semantic to provide the barrier
-	 * before executing the IPI and, when busy-looping, csd_lock_wait only
-	 * executes smp_mb() when it has to wait for the other CPU.
-	 *
-	 * I don't trust this code. Therefore, let's add the smp_mb() sequence
-	 * required ourself, even if duplicated. It has no performance impact
-	 * anyway.
-	 *
-	 * smp_mb() is needed because smp_rmb() and smp_wmb() only order read vs
-	 * read and write vs write. They do not ensure core synchronization. We
-	 * really have to ensure total order between the 3 barriers running on
-	 * the 2 CPUs.
 	 */
-	if (config->ipi == RING_BUFFER_IPI_BARRIER) {
-		if (config->sync == RING_BUFFER_SYNC_PER_CPU
-		    && config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
-			if (raw_smp_processor_id() != buf->backend.cpu) {
-				/* Total order with IPI handler smp_mb() */
-				smp_mb();
-				smp_call_function_single(buf->backend.cpu,
-							 remote_mb, NULL, 1);
-				/* Total order with IPI handler smp_mb() */
-				smp_mb();
-			}
-		} else {
-			/* Total order with IPI handler smp_mb() */
-			smp_mb();
-			smp_call_function(remote_mb, NULL, 1);
-			/* Total order with IPI handler smp_mb() */
-			smp_mb();
-		}
-	} else {
-		/*
-		 * Local rmb to match the remote wmb to read the commit count
-		 * before the buffer data and the write offset.
-		 */
-		smp_rmb();
-	}
+	lib_ring_buffer_reader_sync(buf);
 
 	write_offset = v_read(config, &buf->offset);
 
@@ -1290,6 +2163,7 @@ retry:
 
 	buf->get_subbuf_consumed = consumed;
 	buf->get_subbuf = 1;
+	lib_ring_buffer_trace_reader_wait(buf, consumed);
 
 	return 0;
 
@@ -1346,6 +2220,18 @@ void lib_ring_buffer_put_subbuf(struct lib_ring_buffer *buf)
 		     && subbuffer_id_is_noref(config, bufb->buf_rsb.id));
 	subbuffer_id_set_noref(config, &bufb->buf_rsb.id);
 
+	/* Give a swapped out sub-buffer back to the snapshot pool. */
+	if (lib_ring_buffer_swapped_out(buf, consumed)) {
+		struct lib_ring_buffer_backend_subbuffer *psb;
+		unsigned long id;
+
+		psb = &bufb->buf_psb[subbuf_index(consumed, chan)];
+		id = psb->id;
+		psb->id = bufb->buf_rsb.id;
+		bufb->buf_rsb.id = id;
+		return;
+	}
+
 	/*
 	 * Exchange the reader subbuffer with the one we put in its place in the
 	 * writer subbuffer table. Expect the original consumed count. If
@@ -1364,6 +2250,70 @@ void lib_ring_buffer_put_subbuf(struct lib_ring_buffer *buf)
 }
 EXPORT_SYMBOL_GPL(lib_ring_buffer_put_subbuf);
 
+/**
+ * lib_ring_buffer_get_committed_prefix - get the readable part of the packet
+ * being written
+ * @buf: ring buffer
+ * @packet: position of the start of the packet being written
+ * @len: bytes of the packet, from its start, which are committed
+ *
+ * Only reports a prefix once every record reserved before it has been
+ * committed, as the commit count of the sub-buffer then matches the write
+ * offset within it. The packet header is written at the switch, so it is
+ * not up to date in the prefix. Discard mode only: the writer cannot reach
+ * the packet again before it is consumed.
+ *
+ * Returns -ENODATA if buffer is finalized, -EAGAIN if some record of the
+ * packet is not committed yet, if no packet is open, or if earlier packets
+ * are still to be consumed, or 0 on success.
+ */
+int lib_ring_buffer_get_committed_prefix(struct lib_ring_buffer *buf,
+		unsigned long *packet, unsigned long *len)
+{
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	unsigned long write_offset, consumed, commit_count;
+	int finalized;
+
+	if (config->mode != RING_BUFFER_DISCARD)
+		return -EINVAL;
+	finalized = ACCESS_ONCE(buf->finalized);
+	/*
+	 * Read finalized before counters.
+	 */
+	smp_rmb();
+	write_offset = v_read(config, &buf->offset);
+	/*
+	 * Read the write offset before the commit count: records reserved
+	 * after it can only make the commit count larger.
+	 */
+	smp_rmb();
+	commit_count = v_read(config, &lib_ring_buffer_commit_hot(config, buf,
+				subbuf_index(write_offset, chan))->cc);
+	/* Read the commit count before the buffer data. */
+	lib_ring_buffer_reader_sync(buf);
+	consumed = atomic_long_read(&buf->consumed);
+
+	if (subbuf_trunc(write_offset, chan) != subbuf_trunc(consumed, chan)
+	    || !subbuf_offset(write_offset, chan))
+		goto nodata;
+	if (((commit_count - (buf_trunc(write_offset, chan)
+			      >> chan->backend.num_subbuf_order))
+	     & chan->commit_count_mask)
+	    != subbuf_offset(write_offset, chan))
+		goto nodata;
+	*packet = subbuf_trunc(write_offset, chan);
+	*len = subbuf_offset(write_offset, chan);
+	return 0;
+
+nodata:
+	if (finalized)
+		return -ENODATA;
+	else
+		return -EAGAIN;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_get_committed_prefix);
+
 /*
  * cons_offset is an iterator on all subbuffer offsets between the reader
  * position and the writer position. (inclusive)
@@ -1378,8 +2328,10 @@ void lib_ring_buffer_print_subbuffer_errors(struct lib_ring_buffer *buf,
 	unsigned long cons_idx, commit_count, commit_count_sb;
 
 	cons_idx = subbuf_index(cons_offset, chan);
-	commit_count = v_read(config, &buf->commit_hot[cons_idx].cc);
-	commit_count_sb = v_read(config, &buf->commit_cold[cons_idx].cc_sb);
+	commit_count = v_read(config,
+		&lib_ring_buffer_commit_hot(config, buf, cons_idx)->cc);
+	commit_count_sb = v_read(config,
+		&lib_ring_buffer_commit_cold(config, buf, cons_idx)->cc_sb);
 
 	if (subbuf_offset(commit_count, chan) != 0)
 		printk(KERN_WARNING
@@ -1493,7 +2445,7 @@ void lib_ring_buffer_switch_old_start(struct lib_ring_buffer *buf,
 		barrier();
 	} else
 		smp_wmb();
-	cc_hot = &buf->commit_hot[oldidx];
+	cc_hot = lib_ring_buffer_commit_hot(config, buf, oldidx);
 	v_add(config, config->cb.subbuffer_header_size(), &cc_hot->cc);
 	commit_count = v_read(config, &cc_hot->cc);
 	/* Check if the written buffer has to be delivered */
@@ -1504,6 +2456,31 @@ void lib_ring_buffer_switch_old_start(struct lib_ring_buffer *buf,
 			commit_count, cc_hot);
 }
 
+/*
+ * Emit the switch of a sub-buffer holding data_size bytes, and the records
+ * lost since the previous lost records event, if any.
+ */
+static
+void lib_ring_buffer_trace_switch(struct lib_ring_buffer *buf,
+				  struct channel *chan,
+				  unsigned long data_size)
+{
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	unsigned long lost, prev;
+
+	trace_lttng_ring_buffer_switch(chan->backend.name, buf->backend.cpu,
+		data_size, chan->backend.subbuf_size);
+	lost = v_read(config, &buf->records_lost_full)
+		+ v_read(config, &buf->records_lost_wrap)
+		+ v_read(config, &buf->records_lost_big);
+	if (lost == atomic_long_read(&buf->records_lost_traced))
+		return;
+	prev = atomic_long_xchg(&buf->records_lost_traced, lost);
+	if (lost != prev)
+		trace_lttng_ring_buffer_lost_records(chan->backend.name,
+			buf->backend.cpu, lost - prev);
+}
+
 /*
  * lib_ring_buffer_switch_old_end: switch old subbuffer
  *
@@ -1540,7 +2517,7 @@ void lib_ring_buffer_switch_old_end(struct lib_ring_buffer *buf,
 		barrier();
 	} else
 		smp_wmb();
-	cc_hot = &buf->commit_hot[oldidx];
+	cc_hot = lib_ring_buffer_commit_hot(config, buf, oldidx);
 	v_add(config, padding_size, &cc_hot->cc);
 	commit_count = v_read(config, &cc_hot->cc);
 	lib_ring_buffer_check_deliver(config, buf, chan, offsets->old - 1,
@@ -1548,6 +2525,7 @@ void lib_ring_buffer_switch_old_end(struct lib_ring_buffer *buf,
 	lib_ring_buffer_write_commit_counter(config, buf, chan,
 			offsets->old + padding_size, commit_count,
 			cc_hot);
+	lib_ring_buffer_trace_switch(buf, chan, data_size);
 }
 
 /*
@@ -1583,7 +2561,7 @@ void lib_ring_buffer_switch_new_start(struct lib_ring_buffer *buf,
 		barrier();
 	} else
 		smp_wmb();
-	cc_hot = &buf->commit_hot[beginidx];
+	cc_hot = lib_ring_buffer_commit_hot(config, buf, beginidx);
 	v_add(config, config->cb.subbuffer_header_size(), &cc_hot->cc);
 	commit_count = v_read(config, &cc_hot->cc);
 	/* Check if the written buffer has to be delivered */
@@ -1675,8 +2653,12 @@ int lib_ring_buffer_try_switch_slow(enum switch_mode mode,
 
 		/* Test new buffer integrity */
 		sb_index = subbuf_index(offsets->begin, chan);
+		if (!lib_ring_buffer_backend_populated(config, &buf->backend,
+						       sb_index))
+			return -1;
 		commit_count = v_read(config,
-				&buf->commit_cold[sb_index].cc_sb);
+				&lib_ring_buffer_commit_cold(config, buf,
+							sb_index)->cc_sb);
 		reserve_commit_diff =
 		  (buf_trunc(offsets->begin, chan)
 		   >> chan->backend.num_subbuf_order)
@@ -1685,8 +2667,8 @@ int lib_ring_buffer_try_switch_slow(enum switch_mode mode,
 			/* Next subbuffer not being written to. */
 			if (unlikely(config->mode != RING_BUFFER_OVERWRITE &&
 				subbuf_trunc(offsets->begin, chan)
-				 - subbuf_trunc((unsigned long)
-				     atomic_long_read(&buf->consumed), chan)
+				 - subbuf_trunc(
+				     lib_ring_buffer_slowest_consumed(buf), chan)
 				>= chan->backend.buf_size)) {
 				/*
 				 * We do not overwrite non consumed buffers
@@ -1915,7 +2897,8 @@ retry:
 		 */
 		smp_rmb();
 		commit_count = v_read(config,
-				&buf->commit_cold[sb_index].cc_sb);
+				&lib_ring_buffer_commit_cold(config, buf,
+							sb_index)->cc_sb);
 		/* Read buf->commit_cold[sb_index].cc_sb before buf->offset. */
 		smp_rmb();
 		if (unlikely(offset_cmp != v_read(config, &buf->offset))) {
@@ -1935,8 +2918,8 @@ retry:
 			/* Next subbuffer not being written to. */
 			if (unlikely(config->mode != RING_BUFFER_OVERWRITE &&
 				subbuf_trunc(offsets->begin, chan)
-				 - subbuf_trunc((unsigned long)
-				     atomic_long_read(&buf->consumed), chan)
+				 - subbuf_trunc(
+				     lib_ring_buffer_slowest_consumed(buf), chan)
 				>= chan->backend.buf_size)) {
 				/*
 				 * We do not overwrite non consumed buffers
@@ -1963,6 +2946,15 @@ retry:
 			v_inc(config, &buf->records_lost_wrap);
 			return -EIO;
 		}
+		if (unlikely(!lib_ring_buffer_backend_populated(config,
+						&buf->backend, sb_index))) {
+			/*
+			 * The pages of the next subbuffer are not allocated
+			 * yet: record is lost.
+			 */
+			v_inc(config, &buf->records_lost_full);
+			return -ENOBUFS;
+		}
 		offsets->size =
 			config->cb.record_header_size(config, chan,
 						offsets->begin,
@@ -2009,7 +3001,7 @@ static struct lib_ring_buffer *get_current_buf(struct channel *chan, int cpu)
 	const struct lib_ring_buffer_config *config = &chan->backend.config;
 
 	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
-		return per_cpu_ptr(chan->backend.buf, cpu);
+		return channel_get_ring_buffer(config, chan, cpu);
 	else
 		return chan->backend.buf;
 }
@@ -2041,6 +3033,8 @@ int lib_ring_buffer_reserve_slow(struct lib_ring_buffer_ctx *ctx)
 
 	ctx->buf = buf = get_current_buf(chan, ctx->cpu);
 	offsets.size = 0;
+	trace_lttng_ring_buffer_reserve_slow(chan->backend.name,
+		buf->backend.cpu, ctx->data_size);
 
 	do {
 		ret = lib_ring_buffer_try_reserve_slow(buf, chan, &offsets,
@@ -2102,7 +3096,8 @@ void lib_ring_buffer_vmcore_check_deliver(const struct lib_ring_buffer_config *c
 				          unsigned long idx)
 {
 	if (config->oops == RING_BUFFER_OOPS_CONSISTENCY)
-		v_set(config, &buf->commit_hot[idx].seq, commit_count);
+		v_set(config, &lib_ring_buffer_commit_hot(config, buf, idx)->seq,
+			commit_count);
 }
 
 /*
@@ -2115,6 +3110,8 @@ void deliver_count_events(const struct lib_ring_buffer_config *config,
 		struct lib_ring_buffer *buf,
 		unsigned long idx)
 {
+	if (buf->backend.chan->no_record_count)
+		return;
 	v_add(config, subbuffer_get_records_count(config,
 			&buf->backend, idx),
 		&buf->records_count);
@@ -2175,7 +3172,8 @@ void lib_ring_buffer_check_deliver_slow(const struct lib_ring_buffer_config *con
 	 * commit_cold cc_sb update.
 	 */
 	smp_wmb();
-	if (likely(v_cmpxchg(config, &buf->commit_cold[idx].cc_sb,
+	if (likely(v_cmpxchg(config,
+			&lib_ring_buffer_commit_cold(config, buf, idx)->cc_sb,
 				 old_commit_count, old_commit_count + 1)
 		   == old_commit_count)) {
 		/*
@@ -2212,7 +3210,8 @@ void lib_ring_buffer_check_deliver_slow(const struct lib_ring_buffer_config *con
 		 */
 		smp_mb();
 		/* End of exclusive subbuffer access */
-		v_set(config, &buf->commit_cold[idx].cc_sb,
+		v_set(config,
+		      &lib_ring_buffer_commit_cold(config, buf, idx)->cc_sb,
 		      commit_count);
 		/*
 		 * Order later updates to reserve count after
@@ -2222,15 +3221,31 @@ void lib_ring_buffer_check_deliver_slow(const struct lib_ring_buffer_config *con
 		lib_ring_buffer_vmcore_check_deliver(config, buf,
 						 commit_count, idx);
 
+		if (config->output == RING_BUFFER_MMAP)
+			lib_ring_buffer_ctrl_publish_produced(buf,
+					subbuf_align(offset, chan));
+
 		/*
 		 * RING_BUFFER_WAKEUP_BY_WRITER wakeup is not lock-free.
+		 * Channels with writer wakeups enabled at run time defer it
+		 * to irq_work, which can be queued from any context.
 		 */
-		if (config->wakeup == RING_BUFFER_WAKEUP_BY_WRITER
-		    && atomic_long_read(&buf->active_readers)
-		    && lib_ring_buffer_poll_deliver(config, buf, chan)) {
-			wake_up_interruptible(&buf->read_wait);
-			wake_up_interruptible(&chan->read_wait);
+		if (config->wakeup == RING_BUFFER_WAKEUP_BY_WRITER) {
+			if (atomic_long_read(&buf->active_readers)
+			    && lib_ring_buffer_poll_deliver(config, buf, chan)) {
+				wake_up_interruptible(&buf->read_wait);
+				wake_up_interruptible(&chan->read_wait);
+			}
+			lib_ring_buffer_wakeup_readers(config, buf, chan);
 		}
+#ifdef CONFIG_IRQ_WORK
+		else if (config->wakeup == RING_BUFFER_WAKEUP_BY_TIMER
+		    && unlikely(ACCESS_ONCE(chan->writer_wakeup))
+		    && ((atomic_long_read(&buf->active_readers)
+			 && lib_ring_buffer_poll_deliver(config, buf, chan))
+			|| ACCESS_ONCE(buf->nr_readers)))
+			irq_work_queue(&buf->wakeup_work);
+#endif
 
 	}
 }
@@ -2242,13 +3257,14 @@ int __init init_lib_ring_buffer_frontend(void)
 
 	for_each_possible_cpu(cpu)
 		spin_lock_init(&per_cpu(ring_buffer_nohz_lock, cpu));
-	return 0;
+	return lib_ring_buffer_backend_init();
 }
 
 module_init(init_lib_ring_buffer_frontend);
 
 void __exit exit_lib_ring_buffer_frontend(void)
 {
+	lib_ring_buffer_backend_exit();
 }
 
 module_exit(exit_lib_ring_buffer_frontend);
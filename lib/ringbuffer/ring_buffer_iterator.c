@@ -2,8 +2,9 @@
  * ring_buffer_iterator.c
  *
  * Ring buffer and channel iterators. Get each event of a channel in order. Uses
- * a prio heap for per-cpu buffers, giving a O(log(NR_CPUS)) algorithmic
- * complexity for the "get next event" operation.
+ * a tournament tree for per-cpu buffers, giving a O(log(NR_CPUS)) algorithmic
+ * complexity for the "get next event" operation, and O(1) for runs of events
+ * from the same buffer.
  *
  * Copyright (C) 2010-2012 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
  *
@@ -30,6 +31,9 @@
 #include <linux/jiffies.h>
 #include <linux/delay.h>
 #include <linux/module.h>
+#include <linux/uio.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
 
 /*
  * Safety factor taking into account internal kernel interrupt latency.
@@ -120,20 +124,11 @@ restart:
 }
 EXPORT_SYMBOL_GPL(lib_ring_buffer_get_next_record);
 
-static int buf_is_higher(void *a, void *b)
-{
-	struct lib_ring_buffer *bufa = a;
-	struct lib_ring_buffer *bufb = b;
-
-	/* Consider lowest timestamps to be at the top of the heap */
-	return (bufa->iter.timestamp < bufb->iter.timestamp);
-}
-
 static
 void lib_ring_buffer_get_empty_buf_records(const struct lib_ring_buffer_config *config,
 					   struct channel *chan)
 {
-	struct lttng_ptr_heap *heap = &chan->iter.heap;
+	struct lttng_tournament_tree *tree = &chan->iter.tree;
 	struct lib_ring_buffer *buf, *tmp;
 	ssize_t len;
 
@@ -163,12 +158,13 @@ void lib_ring_buffer_get_empty_buf_records(const struct lib_ring_buffer_config *
 			break;
 		default:
 			/*
-			 * Insert buffer into the heap, remove from empty buffer
+			 * Insert buffer into the tree, remove from empty buffer
 			 * list.
 			 */
 			CHAN_WARN_ON(chan, len < 0);
 			list_del(&buf->iter.empty_node);
-			CHAN_WARN_ON(chan, lttng_heap_insert(heap, buf));
+			lttng_tournament_tree_update(tree, buf->backend.cpu,
+					buf, buf->iter.timestamp);
 		}
 	}
 }
@@ -190,7 +186,7 @@ void lib_ring_buffer_wait_for_qs(const struct lib_ring_buffer_config *config,
 	/*
 	 * We need to consider previously empty buffers.
 	 * Do a get next buf record on each of them. Add them to
-	 * the heap if they have data. If at least one of them
+	 * the tree if they have data. If at least one of them
 	 * don't have data, we need to wait for
 	 * switch_timer_interval + MAX_SYSTEM_LATENCY (so we are sure the
 	 * buffers have been switched either by the timer or idle entry) and
@@ -210,7 +206,7 @@ void lib_ring_buffer_wait_for_qs(const struct lib_ring_buffer_config *config,
 	 * TODO: we could optimize further by skipping the sleep if all
 	 * empty buffers belong to idle or offline cpus.
 	 */
-	wait_msecs = jiffies_to_msecs(chan->switch_timer_interval);
+	wait_msecs = DIV_ROUND_UP(chan->switch_timer_interval, USEC_PER_MSEC);
 	wait_msecs += MAX_SYSTEM_LATENCY;
 	msleep(wait_msecs);
 	lib_ring_buffer_get_empty_buf_records(config, chan);
@@ -240,7 +236,7 @@ ssize_t channel_get_next_record(struct channel *chan,
 {
 	const struct lib_ring_buffer_config *config = &chan->backend.config;
 	struct lib_ring_buffer *buf;
-	struct lttng_ptr_heap *heap;
+	struct lttng_tournament_tree *tree;
 	ssize_t len;
 
 	if (config->alloc == RING_BUFFER_ALLOC_GLOBAL) {
@@ -248,12 +244,12 @@ ssize_t channel_get_next_record(struct channel *chan,
 		return lib_ring_buffer_get_next_record(chan, *ret_buf);
 	}
 
-	heap = &chan->iter.heap;
+	tree = &chan->iter.tree;
 
 	/*
 	 * get next record for topmost buffer.
 	 */
-	buf = lttng_heap_maximum(heap);
+	buf = lttng_tournament_tree_top(tree);
 	if (buf) {
 		len = lib_ring_buffer_get_next_record(chan, buf);
 		/*
@@ -264,43 +260,46 @@ ssize_t channel_get_next_record(struct channel *chan,
 		case -EAGAIN:
 			buf->iter.timestamp = 0;
 			list_add(&buf->iter.empty_node, &chan->iter.empty_head);
-			/* Remove topmost buffer from the heap */
-			CHAN_WARN_ON(chan, lttng_heap_remove(heap) != buf);
+			/* Remove topmost buffer from the tree */
+			lttng_tournament_tree_update(tree, buf->backend.cpu,
+					NULL, 0);
 			break;
 		case -ENODATA:
 			/*
-			 * Buffer is finalized. Remove buffer from heap and
+			 * Buffer is finalized. Remove buffer from tree and
 			 * don't add to list of empty buffer, because it has no
 			 * more data to provide, ever.
 			 */
-			CHAN_WARN_ON(chan, lttng_heap_remove(heap) != buf);
+			lttng_tournament_tree_update(tree, buf->backend.cpu,
+					NULL, 0);
 			break;
 		case -EBUSY:
 			CHAN_WARN_ON(chan, 1);
 			break;
 		default:
 			/*
-			 * Reinsert buffer into the heap. Note that heap can be
-			 * partially empty, so we need to use
-			 * lttng_heap_replace_max().
+			 * Re-key the buffer with its next record timestamp.
+			 * While it stays below the runner-up, this does not
+			 * walk the tree.
 			 */
 			CHAN_WARN_ON(chan, len < 0);
-			CHAN_WARN_ON(chan, lttng_heap_replace_max(heap, buf) != buf);
+			lttng_tournament_tree_update(tree, buf->backend.cpu,
+					buf, buf->iter.timestamp);
 			break;
 		}
 	}
 
-	buf = lttng_heap_maximum(heap);
+	buf = lttng_tournament_tree_top(tree);
 	if (!buf || buf->iter.timestamp > chan->iter.last_qs) {
 		/*
 		 * Deal with buffers previously showing no data.
-		 * Add buffers containing data to the heap, update
+		 * Add buffers containing data to the tree, update
 		 * last_qs.
 		 */
 		lib_ring_buffer_wait_for_qs(config, chan);
 	}
 
-	*ret_buf = buf = lttng_heap_maximum(heap);
+	*ret_buf = buf = lttng_tournament_tree_top(tree);
 	if (buf) {
 		/*
 		 * If this warning triggers, you probably need to check your
@@ -324,7 +323,7 @@ ssize_t channel_get_next_record(struct channel *chan,
 		chan->iter.last_cpu = buf->backend.cpu;
 		return buf->iter.payload_len;
 	} else {
-		/* Heap is empty */
+		/* Tree is empty */
 		if (list_empty(&chan->iter.empty_head))
 			return -ENODATA;	/* All buffers finalized */
 		else
@@ -410,9 +409,8 @@ int channel_iterator_init(struct channel *chan)
 		int ret;
 
 		INIT_LIST_HEAD(&chan->iter.empty_head);
-		ret = lttng_heap_init(&chan->iter.heap,
-				num_possible_cpus(),
-				GFP_KERNEL, buf_is_higher);
+		ret = lttng_tournament_tree_init(&chan->iter.tree,
+				nr_cpu_ids, GFP_KERNEL);
 		if (ret)
 			return ret;
 
@@ -484,7 +482,7 @@ void channel_iterator_free(struct channel *chan)
 	const struct lib_ring_buffer_config *config = &chan->backend.config;
 
 	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
-		lttng_heap_free(&chan->iter.heap);
+		lttng_tournament_tree_free(&chan->iter.tree);
 }
 
 int lib_ring_buffer_iterator_open(struct lib_ring_buffer *buf)
@@ -571,9 +569,12 @@ void lib_ring_buffer_iterator_reset(struct lib_ring_buffer *buf)
 	if (buf->iter.state != ITER_GET_SUBBUF)
 		lib_ring_buffer_put_next_subbuf(buf);
 	buf->iter.state = ITER_GET_SUBBUF;
-	/* Remove from heap (if present). */
-	if (lttng_heap_cherrypick(&chan->iter.heap, buf))
+	/* Remove from tree (if present). */
+	if (lttng_tournament_tree_get(&chan->iter.tree, buf->backend.cpu)) {
+		lttng_tournament_tree_update(&chan->iter.tree,
+				buf->backend.cpu, NULL, 0);
 		list_add(&buf->iter.empty_node, &chan->iter.empty_head);
+	}
 	buf->iter.timestamp = 0;
 	buf->iter.header_len = 0;
 	buf->iter.payload_len = 0;
@@ -589,9 +590,12 @@ void channel_iterator_reset(struct channel *chan)
 	struct lib_ring_buffer *buf;
 	int cpu;
 
-	/* Empty heap, put into empty_head */
-	while ((buf = lttng_heap_remove(&chan->iter.heap)) != NULL)
+	/* Empty tree, put into empty_head */
+	while ((buf = lttng_tournament_tree_top(&chan->iter.tree)) != NULL) {
+		lttng_tournament_tree_update(&chan->iter.tree,
+				buf->backend.cpu, NULL, 0);
 		list_add(&buf->iter.empty_node, &chan->iter.empty_head);
+	}
 
 	for_each_channel_cpu(cpu, chan) {
 		buf = channel_get_ring_buffer(config, chan, cpu);
@@ -604,12 +608,71 @@ void channel_iterator_reset(struct channel *chan)
 	chan->iter.len_left = 0;
 }
 
+/*
+ * Records are gathered in a bounce page with plain memory copies, and
+ * copied out to the reader one page at a time rather than one record at
+ * a time.
+ */
+struct lib_ring_buffer_iter_read {
+	char *page;
+	size_t len;			/* Bytes gathered in page */
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+	struct iov_iter *to;
+#else
+	char __user *user_buf;
+#endif
+};
+
+static
+int lib_ring_buffer_iter_read_flush(struct lib_ring_buffer_iter_read *rd)
+{
+	if (!rd->len)
+		return 0;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+	if (copy_to_iter(rd->page, rd->len, rd->to) != rd->len)
+		return -EFAULT;
+#else
+	if (copy_to_user(rd->user_buf, rd->page, rd->len))
+		return -EFAULT;
+	rd->user_buf += rd->len;
+#endif
+	rd->len = 0;
+	return 0;
+}
+
+/*
+ * Gather "len" bytes at "offset" in the buffer. They are copied out of
+ * the ring buffer right away, while the iterator still holds the
+ * sub-buffer containing them.
+ */
+static
+int lib_ring_buffer_iter_read_gather(struct lib_ring_buffer_iter_read *rd,
+		struct lib_ring_buffer *buf, size_t offset, size_t len)
+{
+	while (len) {
+		size_t chunk = min_t(size_t, len, PAGE_SIZE - rd->len);
+		int ret;
+
+		lib_ring_buffer_read(&buf->backend, offset,
+				rd->page + rd->len, chunk);
+		rd->len += chunk;
+		offset += chunk;
+		len -= chunk;
+		if (rd->len == PAGE_SIZE) {
+			ret = lib_ring_buffer_iter_read_flush(rd);
+			if (ret)
+				return ret;
+		}
+	}
+	return 0;
+}
+
 /*
  * Ring buffer payload extraction read() implementation.
  */
 static
 ssize_t channel_ring_buffer_file_read(struct file *filp,
-				      char __user *user_buf,
+				      struct lib_ring_buffer_iter_read *rd,
 				      size_t count,
 				      loff_t *ppos,
 				      struct channel *chan,
@@ -621,8 +684,10 @@ ssize_t channel_ring_buffer_file_read(struct file *filp,
 	ssize_t len;
 
 	might_sleep();
-	if (!access_ok(VERIFY_WRITE, user_buf, count))
-		return -EFAULT;
+	rd->len = 0;
+	rd->page = (char *) __get_free_page(GFP_KERNEL);
+	if (!rd->page)
+		return -ENOMEM;
 
 	/* Finish copy of previous record */
 	if (*ppos != 0) {
@@ -631,7 +696,7 @@ ssize_t channel_ring_buffer_file_read(struct file *filp,
 			read_offset = *ppos;
 			if (config->alloc == RING_BUFFER_ALLOC_PER_CPU
 			    && fusionmerge)
-				buf = lttng_heap_maximum(&chan->iter.heap);
+				buf = lttng_tournament_tree_top(&chan->iter.tree);
 			CHAN_WARN_ON(chan, !buf);
 			goto skip_get_next;
 		}
@@ -701,25 +766,107 @@ skip_get_next:
 			chan->iter.len_left = len - copy_len;
 			*ppos = read_offset + copy_len;
 		}
-		if (__lib_ring_buffer_copy_to_user(&buf->backend, read_offset,
-					       &user_buf[read_count],
-					       copy_len)) {
+		if (lib_ring_buffer_iter_read_gather(rd, buf, read_offset,
+					copy_len)) {
 			/*
 			 * Leave the len_left and ppos values at their current
 			 * state, as we currently have a valid event to read.
 			 */
-			return -EFAULT;
+			read_count = -EFAULT;
+			goto end;
 		}
 		read_count += copy_len;
 	};
-	return read_count;
+	goto end;
 
 nodata:
 	*ppos = 0;
 	chan->iter.len_left = 0;
+end:
+	if (lib_ring_buffer_iter_read_flush(rd))
+		read_count = -EFAULT;
+	free_page((unsigned long) rd->page);
 	return read_count;
 }
 
+/*
+ * Read the record payload of a buffer, or of a channel in timestamp
+ * order across its buffers.
+ */
+static
+ssize_t lib_ring_buffer_file_read_rd(struct file *filp,
+		struct lib_ring_buffer_iter_read *rd, size_t count,
+		loff_t *ppos)
+{
+	struct inode *inode = filp->lttng_f_dentry->d_inode;
+	struct lib_ring_buffer *buf = inode->i_private;
+	struct channel *chan = buf->backend.chan;
+
+	return channel_ring_buffer_file_read(filp, rd, count, ppos,
+					     chan, buf, 0);
+}
+
+static
+ssize_t channel_file_read_rd(struct file *filp,
+		struct lib_ring_buffer_iter_read *rd, size_t count,
+		loff_t *ppos)
+{
+	struct inode *inode = filp->lttng_f_dentry->d_inode;
+	struct channel *chan = inode->i_private;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+
+	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
+		return channel_ring_buffer_file_read(filp, rd, count,
+						     ppos, chan, NULL, 1);
+	else {
+		struct lib_ring_buffer *buf =
+			channel_get_ring_buffer(config, chan, 0);
+		return channel_ring_buffer_file_read(filp, rd, count,
+						     ppos, chan, buf, 0);
+	}
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+
+/**
+ * lib_ring_buffer_file_read_iter - Read buffer record payload.
+ * @iocb: kernel I/O control block.
+ * @to: destination, one or many user buffers with readv().
+ *
+ * Returns a negative value on error, or the number of bytes read on success.
+ * The file position is used to save the position _within the current record_
+ * between calls to read().
+ */
+static
+ssize_t lib_ring_buffer_file_read_iter(struct kiocb *iocb,
+		struct iov_iter *to)
+{
+	struct lib_ring_buffer_iter_read rd = { .to = to };
+
+	return lib_ring_buffer_file_read_rd(iocb->ki_filp, &rd,
+			iov_iter_count(to), &iocb->ki_pos);
+}
+
+/**
+ * channel_file_read_iter - Read channel record payload.
+ * @iocb: kernel I/O control block.
+ * @to: destination, one or many user buffers with readv().
+ *
+ * Returns a negative value on error, or the number of bytes read on success.
+ * The file position is used to save the position _within the current record_
+ * between calls to read().
+ */
+static
+ssize_t channel_file_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct lib_ring_buffer_iter_read rd = { .to = to };
+
+	return channel_file_read_rd(iocb->ki_filp, &rd,
+			iov_iter_count(to), &iocb->ki_pos);
+}
+
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0)) */
+
 /**
  * lib_ring_buffer_file_read - Read buffer record payload.
  * @filp: file structure pointer.
@@ -737,12 +884,11 @@ ssize_t lib_ring_buffer_file_read(struct file *filp,
 			          size_t count,
 			          loff_t *ppos)
 {
-	struct inode *inode = filp->lttng_f_dentry->d_inode;
-	struct lib_ring_buffer *buf = inode->i_private;
-	struct channel *chan = buf->backend.chan;
+	struct lib_ring_buffer_iter_read rd = { .user_buf = user_buf };
 
-	return channel_ring_buffer_file_read(filp, user_buf, count, ppos,
-					     chan, buf, 0);
+	if (!access_ok(VERIFY_WRITE, user_buf, count))
+		return -EFAULT;
+	return lib_ring_buffer_file_read_rd(filp, &rd, count, ppos);
 }
 
 /**
@@ -762,21 +908,15 @@ ssize_t channel_file_read(struct file *filp,
 			  size_t count,
 			  loff_t *ppos)
 {
-	struct inode *inode = filp->lttng_f_dentry->d_inode;
-	struct channel *chan = inode->i_private;
-	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	struct lib_ring_buffer_iter_read rd = { .user_buf = user_buf };
 
-	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU)
-		return channel_ring_buffer_file_read(filp, user_buf, count,
-						     ppos, chan, NULL, 1);
-	else {
-		struct lib_ring_buffer *buf =
-			channel_get_ring_buffer(config, chan, 0);
-		return channel_ring_buffer_file_read(filp, user_buf, count,
-						     ppos, chan, buf, 0);
-	}
+	if (!access_ok(VERIFY_WRITE, user_buf, count))
+		return -EFAULT;
+	return channel_file_read_rd(filp, &rd, count, ppos);
 }
 
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0)) */
+
 static
 int lib_ring_buffer_file_open(struct inode *inode, struct file *file)
 {
@@ -841,7 +981,11 @@ const struct file_operations channel_payload_file_operations = {
 	.owner = THIS_MODULE,
 	.open = channel_file_open,
 	.release = channel_file_release,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+	.read_iter = channel_file_read_iter,
+#else
 	.read = channel_file_read,
+#endif
 	.llseek = vfs_lib_ring_buffer_no_llseek,
 };
 EXPORT_SYMBOL_GPL(channel_payload_file_operations);
@@ -850,7 +994,11 @@ const struct file_operations lib_ring_buffer_payload_file_operations = {
 	.owner = THIS_MODULE,
 	.open = lib_ring_buffer_file_open,
 	.release = lib_ring_buffer_file_release,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+	.read_iter = lib_ring_buffer_file_read_iter,
+#else
 	.read = lib_ring_buffer_file_read,
+#endif
 	.llseek = vfs_lib_ring_buffer_no_llseek,
 };
 EXPORT_SYMBOL_GPL(lib_ring_buffer_payload_file_operations);
@@ -85,17 +85,133 @@ static const struct vm_operations_struct lib_ring_buffer_mmap_ops = {
 	.fault = lib_ring_buffer_fault,
 };
 
+/*
+ * fault() vm_op implementation for the mappings of additional readers,
+ * restricted to the sub-buffer held by the reader.
+ */
+static int lib_ring_buffer_reader_fault_compat(struct vm_area_struct *vma,
+		struct vm_fault *vmf)
+{
+	struct lib_ring_buffer_reader *reader = vma->vm_private_data;
+	struct lib_ring_buffer *buf = reader->buf;
+	struct lib_ring_buffer_backend_pages *rpages;
+	unsigned long offset, pfn;
+
+	if (!ACCESS_ONCE(reader->get_subbuf))
+		return VM_FAULT_SIGBUS;
+	offset = vmf->pgoff << PAGE_SHIFT;
+	rpages = buf->backend.array[reader->sb_bindex];
+	if (!(offset >= rpages->mmap_offset
+	      && offset < rpages->mmap_offset +
+			  buf->backend.chan->backend.subbuf_size))
+		return VM_FAULT_SIGBUS;
+	pfn = rpages->p[(offset - rpages->mmap_offset) >> PAGE_SHIFT].pfn;
+	if (!pfn)
+		return VM_FAULT_SIGBUS;
+	get_page(pfn_to_page(pfn));
+	vmf->page = pfn_to_page(pfn);
+
+	return 0;
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0))
+static int lib_ring_buffer_reader_fault(struct vm_fault *vmf)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	return lib_ring_buffer_reader_fault_compat(vma, vmf);
+}
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0)) */
+static int lib_ring_buffer_reader_fault(struct vm_area_struct *vma,
+		struct vm_fault *vmf)
+{
+	return lib_ring_buffer_reader_fault_compat(vma, vmf);
+}
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0)) */
+
+static const struct vm_operations_struct lib_ring_buffer_reader_mmap_ops = {
+	.fault = lib_ring_buffer_reader_fault,
+};
+
+#define LIB_RING_BUFFER_MMAP_BATCH	32
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,8,0))
+static int lib_ring_buffer_insert_pages(struct vm_area_struct *vma,
+		unsigned long addr, struct page **pages, unsigned long nr)
+{
+	unsigned long left = nr;
+
+	return vm_insert_pages(vma, addr, pages, &left);
+}
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,8,0)) */
+static int lib_ring_buffer_insert_pages(struct vm_area_struct *vma,
+		unsigned long addr, struct page **pages, unsigned long nr)
+{
+	unsigned long i;
+	int ret;
+
+	for (i = 0; i < nr; i++) {
+		ret = vm_insert_page(vma, addr + (i << PAGE_SHIFT), pages[i]);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,8,0)) */
+
+/*
+ * Insert the pages of a buffer mapping at mmap time rather than on first
+ * access, by batches of contiguous pages. With mmap output, sub-buffers
+ * keep their offset in the mapping and their pages: the sub-buffer
+ * exchanges only change which of them the reader owns, so the mapping
+ * needs no refresh. Sub-buffers not populated yet, and pages the kernel
+ * refuses to insert, are left to the fault handler.
+ */
+static void lib_ring_buffer_mmap_populate(struct lib_ring_buffer *buf,
+		struct vm_area_struct *vma, unsigned long len)
+{
+	struct lib_ring_buffer_backend *bufb = &buf->backend;
+	unsigned long subbuf_size = bufb->chan->backend.subbuf_size;
+	struct page *pages[LIB_RING_BUFFER_MMAP_BATCH];
+	unsigned long i, j, nr;
+
+	for (i = 0; i < len / subbuf_size; i++) {
+		struct lib_ring_buffer_backend_pages *rpages = bufb->array[i];
+
+		if (!ACCESS_ONCE(rpages->populated))
+			continue;
+		/* Pages are set before the sub-buffer is seen populated. */
+		smp_rmb();
+		for (j = 0; j < bufb->num_pages_per_subbuf; j += nr) {
+			unsigned long k;
+
+			nr = min_t(unsigned long, LIB_RING_BUFFER_MMAP_BATCH,
+				bufb->num_pages_per_subbuf - j);
+			for (k = 0; k < nr; k++)
+				pages[k] = pfn_to_page(rpages->p[j + k].pfn);
+			if (lib_ring_buffer_insert_pages(vma,
+					vma->vm_start + rpages->mmap_offset
+						+ (j << PAGE_SHIFT),
+					pages, nr))
+				return;
+		}
+	}
+}
+
 /**
  *	lib_ring_buffer_mmap_buf: - mmap channel buffer to process address space
  *	@buf: ring buffer to map
  *	@vma: vm_area_struct describing memory to be mapped
+ *	@vm_ops: vm_ops of the buffer mapping
+ *	@priv: private data of the buffer mapping
  *
  *	Returns 0 if ok, negative on error
  *
  *	Caller should already have grabbed mmap_sem.
  */
 static int lib_ring_buffer_mmap_buf(struct lib_ring_buffer *buf,
-				    struct vm_area_struct *vma)
+				    struct vm_area_struct *vma,
+				    const struct vm_operations_struct *vm_ops,
+				    void *priv)
 {
 	unsigned long length = vma->vm_end - vma->vm_start;
 	struct channel *chan = buf->backend.chan;
@@ -108,24 +224,56 @@ static int lib_ring_buffer_mmap_buf(struct lib_ring_buffer *buf,
 	mmap_buf_len = chan->backend.buf_size;
 	if (chan->backend.extra_reader_sb)
 		mmap_buf_len += chan->backend.subbuf_size;
+	if (chan->backend.snapshot_pool)
+		mmap_buf_len += chan->backend.buf_size;
+
+	/* The control page is mapped read-only, right after the buffer. */
+	if (vma->vm_pgoff == (mmap_buf_len >> PAGE_SHIFT)) {
+		if (length != PAGE_SIZE || (vma->vm_flags & VM_WRITE))
+			return -EINVAL;
+		vma->vm_flags &= ~VM_MAYWRITE;
+		vma->vm_flags |= VM_DONTEXPAND;
+		return vm_insert_page(vma, vma->vm_start,
+				virt_to_page(buf->ctrl_page));
+	}
 
 	if (length != mmap_buf_len)
 		return -EINVAL;
 
-	vma->vm_ops = &lib_ring_buffer_mmap_ops;
+	vma->vm_ops = vm_ops;
 	vma->vm_flags |= VM_DONTEXPAND;
-	vma->vm_private_data = buf;
+	vma->vm_private_data = priv;
 
 	return 0;
 }
 
+/*
+ * The mappings of additional readers are left to their fault handler,
+ * which restricts them to the sub-buffer they hold.
+ */
 int lib_ring_buffer_mmap(struct file *filp, struct vm_area_struct *vma,
 		struct lib_ring_buffer *buf)
 {
-	return lib_ring_buffer_mmap_buf(buf, vma);
+	int ret;
+
+	ret = lib_ring_buffer_mmap_buf(buf, vma, &lib_ring_buffer_mmap_ops,
+					buf);
+	if (!ret && vma->vm_ops == &lib_ring_buffer_mmap_ops
+			&& !vma->vm_pgoff)
+		lib_ring_buffer_mmap_populate(buf, vma,
+				vma->vm_end - vma->vm_start);
+	return ret;
 }
 EXPORT_SYMBOL_GPL(lib_ring_buffer_mmap);
 
+int lib_ring_buffer_reader_mmap(struct file *filp, struct vm_area_struct *vma,
+		struct lib_ring_buffer_reader *reader)
+{
+	return lib_ring_buffer_mmap_buf(reader->buf, vma,
+					&lib_ring_buffer_reader_mmap_ops, reader);
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_reader_mmap);
+
 /**
  *	vfs_lib_ring_buffer_mmap - mmap file op
  *	@filp: the file
@@ -0,0 +1,149 @@
+/*
+ * ring_buffer_read.c
+ *
+ * Packet-granular read() of the sub-buffer held by the reader.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/uio.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+
+#include <wrapper/ringbuffer/backend.h>
+#include <wrapper/ringbuffer/frontend.h>
+#include <wrapper/ringbuffer/vfs.h>
+
+/*
+ * The consumer takes a sub-buffer with RING_BUFFER_GET_SUBBUF or
+ * RING_BUFFER_GET_NEXT_SUBBUF, which resets the file position, then reads
+ * up to RING_BUFFER_GET_PADDED_SUBBUF_SIZE bytes from it before putting it
+ * back. The file position is the offset within the held sub-buffer, and
+ * reading returns 0 at its end. Unlike splice, this copies, so it works
+ * for every output but the iterator, and with buffers that are not backed
+ * by pages the reader could steal.
+ *
+ * Returns the number of bytes to read at "pos", and sets "offset" to the
+ * matching buffer offset.
+ */
+static
+ssize_t lib_ring_buffer_subbuf_read_len(struct lib_ring_buffer *buf,
+		loff_t pos, size_t len, unsigned long *offset)
+{
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	unsigned long padded_size;
+
+	if (config->output == RING_BUFFER_ITERATOR
+			|| config->output == RING_BUFFER_NONE)
+		return -EINVAL;
+	if (!buf->get_subbuf)
+		return -EINVAL;
+	padded_size = PAGE_ALIGN(lib_ring_buffer_get_read_data_size(config,
+				buf));
+	if (pos < 0)
+		return -EINVAL;
+	if (pos >= padded_size)
+		return 0;
+	*offset = lib_ring_buffer_get_consumed(config, buf) + pos;
+	return min_t(size_t, len, padded_size - pos);
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+
+/*
+ * Copy from the held sub-buffer to an iov_iter, one page run at a time, or
+ * in a single copy with contiguous backends. Handles read(), readv() and
+ * io_uring reads into registered (fixed) buffers alike.
+ */
+ssize_t lib_ring_buffer_subbuf_read_iter(struct kiocb *iocb,
+		struct iov_iter *to, struct lib_ring_buffer *buf)
+{
+	struct channel_backend *chanb = &buf->backend.chan->backend;
+	const struct lib_ring_buffer_config *config = &chanb->config;
+	unsigned long offset;
+	ssize_t len, copied = 0;
+
+	len = lib_ring_buffer_subbuf_read_len(buf, iocb->ki_pos,
+			iov_iter_count(to), &offset);
+	if (len <= 0)
+		return len;
+	while (copied < len) {
+		size_t chunk = len - copied, ret;
+		void *addr;
+
+		if (!lib_ring_buffer_backend_contig(config))
+			chunk = min_t(size_t, chunk,
+				PAGE_SIZE - (offset & ~PAGE_MASK));
+		addr = lib_ring_buffer_read_offset_address(&buf->backend,
+				offset);
+		ret = copy_to_iter(addr, chunk, to);
+		copied += ret;
+		offset += ret;
+		if (ret < chunk)
+			break;
+	}
+	if (!copied)
+		return -EFAULT;
+	iocb->ki_pos += copied;
+	return copied;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_subbuf_read_iter);
+
+ssize_t vfs_lib_ring_buffer_subbuf_read_iter(struct kiocb *iocb,
+		struct iov_iter *to)
+{
+	struct lib_ring_buffer *buf = iocb->ki_filp->private_data;
+
+	return lib_ring_buffer_subbuf_read_iter(iocb, to, buf);
+}
+EXPORT_SYMBOL_GPL(vfs_lib_ring_buffer_subbuf_read_iter);
+
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0)) */
+
+ssize_t lib_ring_buffer_subbuf_read(struct file *filp,
+		char __user *user_buf, size_t count, loff_t *ppos,
+		struct lib_ring_buffer *buf)
+{
+	unsigned long offset;
+	ssize_t len;
+
+	len = lib_ring_buffer_subbuf_read_len(buf, *ppos, count, &offset);
+	if (len <= 0)
+		return len;
+	if (!access_ok(VERIFY_WRITE, user_buf, len))
+		return -EFAULT;
+	if (__lib_ring_buffer_copy_to_user(&buf->backend, offset,
+			user_buf, len))
+		return -EFAULT;
+	*ppos += len;
+	return len;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_subbuf_read);
+
+ssize_t vfs_lib_ring_buffer_subbuf_read(struct file *filp,
+		char __user *user_buf, size_t count, loff_t *ppos)
+{
+	struct lib_ring_buffer *buf = filp->private_data;
+
+	return lib_ring_buffer_subbuf_read(filp, user_buf, count, ppos, buf);
+}
+EXPORT_SYMBOL_GPL(vfs_lib_ring_buffer_subbuf_read);
+
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0)) */
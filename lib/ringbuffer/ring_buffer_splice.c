@@ -25,10 +25,13 @@
 
 #include <linux/module.h>
 #include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
 #include <linux/version.h>
 
 #include <wrapper/splice.h>
 #include <wrapper/ringbuffer/backend.h>
+#include <wrapper/ringbuffer/crash.h>
 #include <wrapper/ringbuffer/frontend.h>
 #include <wrapper/ringbuffer/vfs.h>
 
@@ -47,7 +50,8 @@ EXPORT_SYMBOL_GPL(vfs_lib_ring_buffer_no_llseek);
 
 /*
  * Release pages from the buffer so splice pipe_to_file can move them.
- * Called after the pipe has been populated with buffer pages.
+ * Called after the pipe has been populated with buffer pages. With
+ * RING_BUFFER_SPLICE_PAGE_REF, drops the reference of the pipe.
  */
 static void lib_ring_buffer_pipe_buf_release(struct pipe_inode_info *pipe,
 					     struct pipe_buffer *pbuf)
@@ -76,8 +80,69 @@ static void lib_ring_buffer_page_release(struct splice_pipe_desc *spd,
 	__free_page(spd->pages[i]);
 }
 
+static
+bool lib_ring_buffer_splice_page_ref(const struct lib_ring_buffer_config *config)
+{
+	return config->splice == RING_BUFFER_SPLICE_PAGE_REF
+		&& config->backend == RING_BUFFER_PAGE;
+}
+
+/**
+ * lib_ring_buffer_splice_release_subbuf - prepare the put of a spliced subbuf
+ * @buf: ring buffer
+ *
+ * With RING_BUFFER_SPLICE_PAGE_REF, replaces the pages of the sub-buffer
+ * held by the reader which are still referenced by a pipe or a socket,
+ * so the writer never writes to pages still being sent. A page only
+ * referenced by the buffer cannot gain new references. Must be called
+ * before put_subbuf; on -ENOMEM, the reader still holds the sub-buffer
+ * and may retry.
+ */
+int lib_ring_buffer_splice_release_subbuf(struct lib_ring_buffer *buf)
+{
+	struct lib_ring_buffer_backend *bufb = &buf->backend;
+	struct channel_backend *chanb = &bufb->chan->backend;
+	const struct lib_ring_buffer_config *config = &chanb->config;
+	struct lib_ring_buffer_backend_pages *rpages;
+	unsigned long i, nr_pages;
+
+	if (config->output != RING_BUFFER_SPLICE
+			|| !lib_ring_buffer_splice_page_ref(config)
+			|| !buf->get_subbuf)
+		return 0;
+	rpages = bufb->array[subbuffer_id_get_index(config, bufb->buf_rsb.id)];
+	nr_pages = chanb->subbuf_size >> PAGE_SHIFT;
+	for (i = 0; i < nr_pages; i++) {
+		struct page *page = pfn_to_page(rpages->p[i].pfn);
+		struct page *new_page;
+
+		if (page_count(page) == 1)
+			continue;
+		new_page = alloc_pages_node(cpu_to_node(max(bufb->cpu, 0)),
+					    GFP_KERNEL | __GFP_ZERO, 0);
+		if (!new_page)
+			return -ENOMEM;
+		/* Additional readers may not have read the page yet. */
+		if (ACCESS_ONCE(buf->nr_readers))
+			memcpy(page_address(new_page), rpages->p[i].virt,
+			       PAGE_SIZE);
+		rpages->p[i].pfn = page_to_pfn(new_page);
+		rpages->p[i].virt = page_address(new_page);
+		/* The pipe or socket holding the page frees it. */
+		put_page(page);
+	}
+	lib_ring_buffer_crash_update_pages(bufb,
+		subbuffer_id_get_index(config, bufb->buf_rsb.id));
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_splice_release_subbuf);
+
 /*
  *	subbuf_splice_actor - splice up to one subbuf's worth of data
+ *
+ * Splices as many pages as the pipe has free slots, so a pipe enlarged
+ * with F_SETPIPE_SZ is filled with a single call. Page arrays larger
+ * than the default pipe size are allocated.
  */
 static int subbuf_splice_actor(struct file *in,
 			       loff_t *ppos,
@@ -89,18 +154,19 @@ static int subbuf_splice_actor(struct file *in,
 	struct channel *chan = buf->backend.chan;
 	const struct lib_ring_buffer_config *config = &chan->backend.config;
 	unsigned int poff, subbuf_pages, nr_pages;
-	struct page *pages[PIPE_DEF_BUFFERS];
-	struct partial_page partial[PIPE_DEF_BUFFERS];
+	struct page *pages_stack[PIPE_DEF_BUFFERS];
+	struct partial_page partial_stack[PIPE_DEF_BUFFERS];
 	struct splice_pipe_desc spd = {
-		.pages = pages,
+		.pages = pages_stack,
 		.nr_pages = 0,
-		.partial = partial,
+		.partial = partial_stack,
 		.flags = flags,
 		.ops = &ring_buffer_pipe_buf_ops,
 		.spd_release = lib_ring_buffer_page_release,
 	};
 	unsigned long consumed_old, roffset;
 	unsigned long bytes_avail;
+	int ret;
 
 	/*
 	 * Check that a GET_SUBBUF ioctl has been done before.
@@ -116,9 +182,28 @@ static int subbuf_splice_actor(struct file *in,
 	 */
 	bytes_avail = chan->backend.subbuf_size;
 	WARN_ON(bytes_avail > chan->backend.buf_size);
+	if (*ppos >= bytes_avail)
+		return 0;
+	bytes_avail -= *ppos;
 	len = min_t(size_t, len, bytes_avail);
-	subbuf_pages = bytes_avail >> PAGE_SHIFT;
-	nr_pages = min_t(unsigned int, subbuf_pages, PIPE_DEF_BUFFERS);
+	subbuf_pages = PAGE_ALIGN(len) >> PAGE_SHIFT;
+	/*
+	 * Pages which do not fit in the pipe would be released by
+	 * splice_to_pipe(), after being taken from the buffer. Let
+	 * splice_to_pipe() wait for, or report, a full pipe with a
+	 * single page.
+	 */
+	nr_pages = min_t(unsigned int, subbuf_pages,
+			 max_t(unsigned int, wrapper_pipe_free_slots(pipe), 1));
+	if (nr_pages > PIPE_DEF_BUFFERS) {
+		spd.pages = kcalloc(nr_pages, sizeof(*spd.pages), GFP_KERNEL);
+		spd.partial = kcalloc(nr_pages, sizeof(*spd.partial),
+				      GFP_KERNEL);
+		if (!spd.pages || !spd.partial) {
+			ret = -ENOMEM;
+			goto end;
+		}
+	}
 	roffset = consumed_old & PAGE_MASK;
 	poff = consumed_old & ~PAGE_MASK;
 	printk_dbg(KERN_DEBUG "SPLICE actor len %zu pos %zd write_pos %ld\n",
@@ -135,21 +220,38 @@ static int subbuf_splice_actor(struct file *in,
 		printk_dbg(KERN_DEBUG "SPLICE actor loop len %zu roffset %ld\n",
 			   len, roffset);
 
-		/*
-		 * We have to replace the page we are moving into the splice
-		 * pipe.
-		 */
-		new_page = alloc_pages_node(cpu_to_node(max(buf->backend.cpu,
-							    0)),
-					    GFP_KERNEL | __GFP_ZERO, 0);
-		if (!new_page)
-			break;
-		new_pfn = page_to_pfn(new_page);
 		this_len = PAGE_SIZE - poff;
 		pfnp = lib_ring_buffer_read_get_pfn(&buf->backend, roffset, &virt);
 		spd.pages[spd.nr_pages] = pfn_to_page(*pfnp);
-		*pfnp = new_pfn;
-		*virt = page_address(new_page);
+		if (lib_ring_buffer_splice_page_ref(config)) {
+			/* Released by the pipe, replaced at put_subbuf. */
+			get_page(spd.pages[spd.nr_pages]);
+		} else if (ACCESS_ONCE(buf->nr_readers)) {
+			/*
+			 * Additional readers may not have read the page yet:
+			 * splice a copy of it.
+			 */
+			new_page = alloc_pages_node(
+					cpu_to_node(max(buf->backend.cpu, 0)),
+					GFP_KERNEL, 0);
+			if (!new_page)
+				break;
+			memcpy(page_address(new_page), *virt, PAGE_SIZE);
+			spd.pages[spd.nr_pages] = new_page;
+		} else {
+			/*
+			 * We have to replace the page we are moving into the
+			 * splice pipe.
+			 */
+			new_page = alloc_pages_node(
+					cpu_to_node(max(buf->backend.cpu, 0)),
+					GFP_KERNEL | __GFP_ZERO, 0);
+			if (!new_page)
+				break;
+			new_pfn = page_to_pfn(new_page);
+			*pfnp = new_pfn;
+			*virt = page_address(new_page);
+		}
 		spd.partial[spd.nr_pages].offset = poff;
 		spd.partial[spd.nr_pages].len = this_len;
 
@@ -157,11 +259,18 @@ static int subbuf_splice_actor(struct file *in,
 		roffset += PAGE_SIZE;
 		len -= this_len;
 	}
+	lib_ring_buffer_crash_update_pages(&buf->backend,
+		subbuffer_id_get_index(config, buf->backend.buf_rsb.id));
 
-	if (!spd.nr_pages)
-		return 0;
-
-	return wrapper_splice_to_pipe(pipe, &spd);
+	ret = 0;
+	if (spd.nr_pages)
+		ret = wrapper_splice_to_pipe(pipe, &spd);
+end:
+	if (spd.pages != pages_stack)
+		kfree(spd.pages);
+	if (spd.partial != partial_stack)
+		kfree(spd.partial);
+	return ret;
 }
 
 ssize_t lib_ring_buffer_splice_read(struct file *in, loff_t *ppos,
@@ -194,7 +303,10 @@ ssize_t lib_ring_buffer_splice_read(struct file *in, loff_t *ppos,
 
 	printk_dbg(KERN_DEBUG "SPLICE read len %zu pos %zd\n", len,
 		   (ssize_t)*ppos);
-	while (len && !spliced) {
+	while (len) {
+		/* Return what was spliced rather than wait for the pipe. */
+		if (spliced && !wrapper_pipe_free_slots(pipe))
+			break;
 		ret = subbuf_splice_actor(in, ppos, pipe, len, flags, buf);
 		printk_dbg(KERN_DEBUG "SPLICE read loop ret %d\n", ret);
 		if (ret < 0)
@@ -220,6 +332,71 @@ ssize_t lib_ring_buffer_splice_read(struct file *in, loff_t *ppos,
 }
 EXPORT_SYMBOL_GPL(lib_ring_buffer_splice_read);
 
+/**
+ * lib_ring_buffer_reader_splice_read - splice the sub-buffer held by an
+ * additional reader
+ *
+ * The pages of the sub-buffer are still read by the other readers of
+ * the buffer: copies of them are spliced. Same alignment requirements
+ * as lib_ring_buffer_splice_read().
+ */
+ssize_t lib_ring_buffer_reader_splice_read(struct file *in, loff_t *ppos,
+		struct pipe_inode_info *pipe, size_t len, unsigned int flags,
+		struct lib_ring_buffer_reader *reader)
+{
+	struct lib_ring_buffer *buf = reader->buf;
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	struct lib_ring_buffer_backend_pages *rpages;
+	struct page *pages[PIPE_DEF_BUFFERS];
+	struct partial_page partial[PIPE_DEF_BUFFERS];
+	struct splice_pipe_desc spd = {
+		.pages = pages,
+		.nr_pages = 0,
+		.partial = partial,
+		.flags = flags,
+		.ops = &ring_buffer_pipe_buf_ops,
+		.spd_release = lib_ring_buffer_page_release,
+	};
+	unsigned int nr_pages;
+	unsigned long index;
+	ssize_t ret;
+
+	if (config->output != RING_BUFFER_SPLICE)
+		return -EINVAL;
+	if (*ppos != PAGE_ALIGN(*ppos) || len != PAGE_ALIGN(len))
+		return -EINVAL;
+	if (!reader->get_subbuf)
+		return -EINVAL;
+	if (*ppos >= chan->backend.subbuf_size)
+		return 0;
+	len = min_t(size_t, len, chan->backend.subbuf_size - *ppos);
+	nr_pages = min_t(unsigned int, len >> PAGE_SHIFT,
+			 max_t(unsigned int, wrapper_pipe_free_slots(pipe), 1));
+	nr_pages = min_t(unsigned int, nr_pages, PIPE_DEF_BUFFERS);
+	rpages = buf->backend.array[reader->sb_bindex];
+	index = *ppos >> PAGE_SHIFT;
+	for (; spd.nr_pages < nr_pages; spd.nr_pages++, index++) {
+		struct page *page;
+
+		page = alloc_pages_node(cpu_to_node(max(buf->backend.cpu, 0)),
+					GFP_KERNEL, 0);
+		if (!page)
+			break;
+		memcpy(page_address(page), rpages->p[index].virt, PAGE_SIZE);
+		spd.pages[spd.nr_pages] = page;
+		spd.partial[spd.nr_pages].offset = 0;
+		spd.partial[spd.nr_pages].len = PAGE_SIZE;
+	}
+	if (!spd.nr_pages)
+		return -ENOMEM;
+	ret = wrapper_splice_to_pipe(pipe, &spd);
+	if (ret > 0)
+		*ppos += ret;
+	return ret;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_reader_splice_read);
+
 ssize_t vfs_lib_ring_buffer_splice_read(struct file *in, loff_t *ppos,
 				    struct pipe_inode_info *pipe, size_t len,
 				    unsigned int flags)
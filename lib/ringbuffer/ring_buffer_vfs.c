@@ -23,6 +23,8 @@
 #include <linux/module.h>
 #include <linux/fs.h>
 #include <linux/compat.h>
+#include <linux/uaccess.h>
+#include <linux/jiffies.h>
 
 #include <wrapper/ringbuffer/backend.h>
 #include <wrapper/ringbuffer/frontend.h>
@@ -180,6 +182,233 @@ unsigned int vfs_lib_ring_buffer_poll(struct file *filp, poll_table *wait)
 	return lib_ring_buffer_poll(filp, wait, buf);
 }
 
+/*
+ * Copy out and consume readable sub-buffers until there is no more data,
+ * no room left in the destination, or max_descs is reached. A sub-buffer
+ * which does not fit is released without being consumed. Returns 0 if at
+ * least one sub-buffer has been consumed, else the error of the first get.
+ */
+static
+long lib_ring_buffer_get_next_subbufs(struct lib_ring_buffer *buf,
+		struct lib_ring_buffer_get_subbufs __user *ureq)
+{
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	struct lib_ring_buffer_subbuf_desc __user *udescs;
+	struct lib_ring_buffer_get_subbufs req;
+	char __user *dst;
+	uint64_t dst_offset = 0;
+	uint32_t nr_descs = 0;
+	long ret = 0;
+
+	if (copy_from_user(&req, ureq, sizeof(req)))
+		return -EFAULT;
+	if (buf->get_subbuf)
+		return -EBUSY;
+	dst = (char __user *) (unsigned long) req.dst;
+	udescs = (struct lib_ring_buffer_subbuf_desc __user *)
+			(unsigned long) req.descs;
+	if (!access_ok(VERIFY_WRITE, dst, req.dst_len))
+		return -EFAULT;
+
+	while (nr_descs < req.max_descs) {
+		struct lib_ring_buffer_subbuf_desc desc;
+
+		ret = lib_ring_buffer_get_next_subbuf(buf);
+		if (ret)
+			break;
+		desc.offset = dst_offset;
+		desc.content_size = lib_ring_buffer_get_read_data_size(config,
+						buf);
+		desc.padded_size = PAGE_ALIGN(desc.content_size);
+		if (desc.padded_size > req.dst_len - dst_offset) {
+			lib_ring_buffer_put_subbuf(buf);
+			ret = -ENOSPC;
+			break;
+		}
+		if (__lib_ring_buffer_copy_to_user(&buf->backend,
+				buf->get_subbuf_consumed, dst + dst_offset,
+				desc.padded_size)
+				|| copy_to_user(&udescs[nr_descs], &desc,
+					sizeof(desc))) {
+			lib_ring_buffer_put_subbuf(buf);
+			ret = -EFAULT;
+			break;
+		}
+		lib_ring_buffer_put_next_subbuf(buf);
+		dst_offset += desc.padded_size;
+		nr_descs++;
+	}
+	if (put_user(nr_descs, &ureq->nr_descs))
+		return -EFAULT;
+	if (nr_descs)
+		return 0;
+	return ret;
+}
+
+static
+long lib_ring_buffer_set_wakeup_coalesce(struct lib_ring_buffer *buf,
+		struct lib_ring_buffer_wakeup_coalesce __user *ucoalesce)
+{
+	struct channel *chan = buf->backend.chan;
+	struct lib_ring_buffer_wakeup_coalesce coalesce;
+
+	if (copy_from_user(&coalesce, ucoalesce, sizeof(coalesce)))
+		return -EFAULT;
+	if (coalesce.nr_subbuf > chan->backend.num_subbuf)
+		return -EINVAL;
+	/* Without a deadline, the last packets could stay unread. */
+	if (coalesce.nr_subbuf > 1 && !coalesce.deadline_ms)
+		return -EINVAL;
+	ACCESS_ONCE(buf->wakeup_deadline) =
+		msecs_to_jiffies(coalesce.deadline_ms);
+	ACCESS_ONCE(buf->wakeup_subbuf_threshold) = coalesce.nr_subbuf;
+	return 0;
+}
+
+static
+long lib_ring_buffer_snapshot_incremental(struct lib_ring_buffer *buf)
+{
+	long ret;
+
+	ret = lib_ring_buffer_snapshot(buf, &buf->cons_snapshot,
+				       &buf->prod_snapshot);
+	if (ret)
+		return ret;
+	/*
+	 * Sub-buffers before the previous snapshot were already sampled,
+	 * unless they have been overwritten since.
+	 */
+	if (buf->incr_snapshot_valid
+	    && (long) (buf->incr_snapshot_produced - buf->cons_snapshot) > 0)
+		buf->cons_snapshot = buf->incr_snapshot_produced;
+	buf->incr_snapshot_produced = buf->prod_snapshot;
+	buf->incr_snapshot_valid = 1;
+	if (buf->cons_snapshot == buf->prod_snapshot)
+		return -EAGAIN;
+	return 0;
+}
+
+static
+long lib_ring_buffer_snapshot_since_ioctl(struct lib_ring_buffer *buf,
+		uint64_t __user *utimestamp)
+{
+	uint64_t timestamp;
+
+	if (get_user(timestamp, utimestamp))
+		return -EFAULT;
+	/* Close the current packet, as RING_BUFFER_SNAPSHOT does. */
+	if (!buf->quiescent)
+		lib_ring_buffer_switch_remote_empty(buf);
+	return lib_ring_buffer_snapshot_since(buf, timestamp,
+			&buf->cons_snapshot, &buf->prod_snapshot);
+}
+
+static
+long lib_ring_buffer_snapshot_swap_ioctl(struct lib_ring_buffer *buf)
+{
+	/* Close the current packet, as RING_BUFFER_SNAPSHOT does. */
+	if (!buf->quiescent)
+		lib_ring_buffer_switch_remote_empty(buf);
+	return lib_ring_buffer_snapshot_swap(buf, &buf->cons_snapshot,
+			&buf->prod_snapshot);
+}
+
+/*
+ * Return the rest of a closed packet if there is one, else the part of
+ * the packet being written committed since the previous partial read.
+ */
+static
+long lib_ring_buffer_get_partial_subbuf(struct lib_ring_buffer *buf,
+		struct lib_ring_buffer_partial_subbuf __user *ureq)
+{
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	struct lib_ring_buffer_partial_subbuf req;
+	unsigned long packet, offset, end, header_len = 0;
+	char __user *dst;
+	long ret;
+
+	if (copy_from_user(&req, ureq, sizeof(req)))
+		return -EFAULT;
+	if (buf->get_subbuf)
+		return -EBUSY;
+	if (config->mode != RING_BUFFER_DISCARD)
+		return -EINVAL;
+	dst = (char __user *) (unsigned long) req.dst;
+	if (!access_ok(VERIFY_WRITE, dst, req.dst_len))
+		return -EFAULT;
+	ACCESS_ONCE(buf->partial_read) = 1;
+
+	ret = lib_ring_buffer_get_next_subbuf(buf);
+	if (!ret) {
+		packet = buf->get_subbuf_consumed;
+		end = lib_ring_buffer_get_read_data_size(config, buf);
+		offset = 0;
+		if (packet == buf->partial_packet && buf->partial_offset) {
+			header_len = config->cb.subbuffer_header_size();
+			offset = max_t(unsigned long, buf->partial_offset,
+				       header_len);
+		}
+		if (header_len + end - offset > req.dst_len) {
+			lib_ring_buffer_put_subbuf(buf);
+			return -ENOSPC;
+		}
+		if (__lib_ring_buffer_copy_to_user(&buf->backend, packet,
+				dst, header_len)
+		    || __lib_ring_buffer_copy_to_user(&buf->backend,
+				packet + offset, dst + header_len,
+				end - offset)) {
+			lib_ring_buffer_put_subbuf(buf);
+			return -EFAULT;
+		}
+		lib_ring_buffer_put_next_subbuf(buf);
+		buf->partial_offset = 0;
+		req.flags = RING_BUFFER_PARTIAL_PACKET_END;
+	} else if (ret == -EAGAIN) {
+		ret = lib_ring_buffer_get_committed_prefix(buf, &packet, &end);
+		if (ret)
+			return ret;
+		if (packet != buf->partial_packet) {
+			buf->partial_packet = packet;
+			buf->partial_offset = 0;
+		}
+		offset = buf->partial_offset;
+		if (end <= offset)
+			return -EAGAIN;
+		if (!req.dst_len)
+			return -ENOSPC;
+		end = min_t(unsigned long, end, offset + req.dst_len);
+		if (lib_ring_buffer_copy_wsb_to_user(&buf->backend,
+				packet + offset, dst, end - offset))
+			return -EFAULT;
+		buf->partial_offset = end;
+		req.flags = 0;
+	} else {
+		return ret;
+	}
+	req.packet_offset = offset;
+	req.len = end - offset;
+	req.header_len = header_len;
+	if (copy_to_user(ureq, &req, sizeof(req)))
+		return -EFAULT;
+	return 0;
+}
+
+static
+long lib_ring_buffer_set_timer_backoff(struct lib_ring_buffer *buf,
+		uint32_t __user *ubackoff)
+{
+	uint32_t backoff;
+
+	if (get_user(backoff, ubackoff))
+		return -EFAULT;
+	if (backoff > RING_BUFFER_TIMER_BACKOFF_MAX)
+		return -EINVAL;
+	ACCESS_ONCE(buf->timer_backoff_max) = backoff;
+	return 0;
+}
+
 long lib_ring_buffer_ioctl(struct file *filp, unsigned int cmd,
 		unsigned long arg, struct lib_ring_buffer *buf)
 {
@@ -222,8 +451,15 @@ long lib_ring_buffer_ioctl(struct file *filp, unsigned int cmd,
 		return ret;
 	}
 	case RING_BUFFER_PUT_SUBBUF:
+	{
+		long ret;
+
+		ret = lib_ring_buffer_splice_release_subbuf(buf);
+		if (ret)
+			return ret;
 		lib_ring_buffer_put_subbuf(buf);
 		return 0;
+	}
 
 	case RING_BUFFER_GET_NEXT_SUBBUF:
 	{
@@ -237,8 +473,15 @@ long lib_ring_buffer_ioctl(struct file *filp, unsigned int cmd,
 		return ret;
 	}
 	case RING_BUFFER_PUT_NEXT_SUBBUF:
+	{
+		long ret;
+
+		ret = lib_ring_buffer_splice_release_subbuf(buf);
+		if (ret)
+			return ret;
 		lib_ring_buffer_put_next_subbuf(buf);
 		return 0;
+	}
 	case RING_BUFFER_GET_SUBBUF_SIZE:
 		return put_ulong(lib_ring_buffer_get_read_data_size(config, buf),
 				 arg);
@@ -261,6 +504,8 @@ long lib_ring_buffer_ioctl(struct file *filp, unsigned int cmd,
 		mmap_buf_len = chan->backend.buf_size;
 		if (chan->backend.extra_reader_sb)
 			mmap_buf_len += chan->backend.subbuf_size;
+		if (chan->backend.snapshot_pool)
+			mmap_buf_len += chan->backend.buf_size;
 		if (mmap_buf_len > INT_MAX)
 			return -EFBIG;
 		return put_ulong(mmap_buf_len, arg);
@@ -279,6 +524,48 @@ long lib_ring_buffer_ioctl(struct file *filp, unsigned int cmd,
 	case RING_BUFFER_FLUSH:
 		lib_ring_buffer_switch_remote(buf);
 		return 0;
+	case RING_BUFFER_GET_COMPRESSED_SUBBUF:
+		return lib_ring_buffer_compress_subbuf(buf,
+			(struct lib_ring_buffer_compressed_subbuf __user *) arg);
+	case RING_BUFFER_GET_NUMA_NODE:
+		return put_user((int32_t) buf->backend.node,
+				(int32_t __user *) arg);
+	case RING_BUFFER_GET_NEXT_SUBBUFS:
+		return lib_ring_buffer_get_next_subbufs(buf,
+			(struct lib_ring_buffer_get_subbufs __user *) arg);
+	case RING_BUFFER_SET_WAKEUP_COALESCE:
+		return lib_ring_buffer_set_wakeup_coalesce(buf,
+			(struct lib_ring_buffer_wakeup_coalesce __user *) arg);
+	case RING_BUFFER_SET_TIMER_BACKOFF:
+		return lib_ring_buffer_set_timer_backoff(buf,
+			(uint32_t __user *) arg);
+	case RING_BUFFER_SNAPSHOT_INCREMENTAL:
+		return lib_ring_buffer_snapshot_incremental(buf);
+	case RING_BUFFER_GET_PARTIAL_SUBBUF:
+		return lib_ring_buffer_get_partial_subbuf(buf,
+			(struct lib_ring_buffer_partial_subbuf __user *) arg);
+	case RING_BUFFER_SNAPSHOT_SINCE:
+		return lib_ring_buffer_snapshot_since_ioctl(buf,
+			(uint64_t __user *) arg);
+	case RING_BUFFER_SNAPSHOT_SWAP:
+		return lib_ring_buffer_snapshot_swap_ioctl(buf);
+	case RING_BUFFER_PUT_GET_NEXT_SUBBUF:
+	{
+		long ret;
+
+		if (buf->get_subbuf) {
+			ret = lib_ring_buffer_splice_release_subbuf(buf);
+			if (ret)
+				return ret;
+			lib_ring_buffer_put_next_subbuf(buf);
+		}
+		ret = lib_ring_buffer_get_next_subbuf(buf);
+		if (!ret) {
+			/* Set file position to zero at each successful "get" */
+			filp->f_pos = 0;
+		}
+		return ret;
+	}
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -308,6 +595,26 @@ EXPORT_SYMBOL_GPL(lib_ring_buffer_ioctl);
  *      RING_BUFFER_GET_MMAP_READ_OFFSET
  *              returns the offset of the subbuffer belonging to the reader.
  *              Should only be used for mmap clients.
+ *	RING_BUFFER_GET_COMPRESSED_SUBBUF
+ *		LZ4-compress the currently read sub-buffer into a user buffer.
+ *	RING_BUFFER_GET_NUMA_NODE
+ *		returns the NUMA node of the buffer pages, for reader placement.
+ *	RING_BUFFER_PUT_GET_NEXT_SUBBUF
+ *		Release the currently read sub-buffer, get the next one.
+ *	RING_BUFFER_GET_NEXT_SUBBUFS
+ *		Copy out and consume all readable sub-buffers at once.
+ *	RING_BUFFER_SET_WAKEUP_COALESCE
+ *		Coalesce read timer wakeups by sub-buffer count and deadline.
+ *	RING_BUFFER_SET_TIMER_BACKOFF
+ *		Let timers of idle buffers lengthen their period.
+ *	RING_BUFFER_SNAPSHOT_INCREMENTAL
+ *		Snapshot only the sub-buffers produced since the last one.
+ *	RING_BUFFER_GET_PARTIAL_SUBBUF
+ *		Read the committed part of the current packet, left open.
+ *	RING_BUFFER_SNAPSHOT_SINCE
+ *		Snapshot only the packets ending after a timestamp.
+ *	RING_BUFFER_SNAPSHOT_SWAP
+ *		Snapshot by swapping sub-buffers out to the snapshot pool.
  */
 static
 long vfs_lib_ring_buffer_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
@@ -364,8 +671,15 @@ long lib_ring_buffer_compat_ioctl(struct file *filp, unsigned int cmd,
 		return ret;
 	}
 	case RING_BUFFER_COMPAT_PUT_SUBBUF:
+	{
+		long ret;
+
+		ret = lib_ring_buffer_splice_release_subbuf(buf);
+		if (ret)
+			return ret;
 		lib_ring_buffer_put_subbuf(buf);
 		return 0;
+	}
 
 	case RING_BUFFER_COMPAT_GET_NEXT_SUBBUF:
 	{
@@ -379,8 +693,15 @@ long lib_ring_buffer_compat_ioctl(struct file *filp, unsigned int cmd,
 		return ret;
 	}
 	case RING_BUFFER_COMPAT_PUT_NEXT_SUBBUF:
+	{
+		long ret;
+
+		ret = lib_ring_buffer_splice_release_subbuf(buf);
+		if (ret)
+			return ret;
 		lib_ring_buffer_put_next_subbuf(buf);
 		return 0;
+	}
 	case RING_BUFFER_COMPAT_GET_SUBBUF_SIZE:
 	{
 		unsigned long data_size;
@@ -413,6 +734,8 @@ long lib_ring_buffer_compat_ioctl(struct file *filp, unsigned int cmd,
 		mmap_buf_len = chan->backend.buf_size;
 		if (chan->backend.extra_reader_sb)
 			mmap_buf_len += chan->backend.subbuf_size;
+		if (chan->backend.snapshot_pool)
+			mmap_buf_len += chan->backend.buf_size;
 		if (mmap_buf_len > UINT_MAX)
 			return -EFBIG;
 		return compat_put_ulong(mmap_buf_len, arg);
@@ -433,6 +756,52 @@ long lib_ring_buffer_compat_ioctl(struct file *filp, unsigned int cmd,
 	case RING_BUFFER_COMPAT_FLUSH:
 		lib_ring_buffer_switch_remote(buf);
 		return 0;
+	case RING_BUFFER_COMPAT_GET_COMPRESSED_SUBBUF:
+		return lib_ring_buffer_compress_subbuf(buf,
+			(struct lib_ring_buffer_compressed_subbuf __user *)
+				compat_ptr(arg));
+	case RING_BUFFER_COMPAT_GET_NUMA_NODE:
+		return put_user((int32_t) buf->backend.node,
+				(int32_t __user *) compat_ptr(arg));
+	case RING_BUFFER_COMPAT_GET_NEXT_SUBBUFS:
+		return lib_ring_buffer_get_next_subbufs(buf,
+			(struct lib_ring_buffer_get_subbufs __user *)
+				compat_ptr(arg));
+	case RING_BUFFER_COMPAT_SET_WAKEUP_COALESCE:
+		return lib_ring_buffer_set_wakeup_coalesce(buf,
+			(struct lib_ring_buffer_wakeup_coalesce __user *)
+				compat_ptr(arg));
+	case RING_BUFFER_COMPAT_SET_TIMER_BACKOFF:
+		return lib_ring_buffer_set_timer_backoff(buf,
+			(uint32_t __user *) compat_ptr(arg));
+	case RING_BUFFER_COMPAT_SNAPSHOT_INCREMENTAL:
+		return lib_ring_buffer_snapshot_incremental(buf);
+	case RING_BUFFER_COMPAT_GET_PARTIAL_SUBBUF:
+		return lib_ring_buffer_get_partial_subbuf(buf,
+			(struct lib_ring_buffer_partial_subbuf __user *)
+				compat_ptr(arg));
+	case RING_BUFFER_COMPAT_SNAPSHOT_SINCE:
+		return lib_ring_buffer_snapshot_since_ioctl(buf,
+			(uint64_t __user *) compat_ptr(arg));
+	case RING_BUFFER_COMPAT_SNAPSHOT_SWAP:
+		return lib_ring_buffer_snapshot_swap_ioctl(buf);
+	case RING_BUFFER_COMPAT_PUT_GET_NEXT_SUBBUF:
+	{
+		long ret;
+
+		if (buf->get_subbuf) {
+			ret = lib_ring_buffer_splice_release_subbuf(buf);
+			if (ret)
+				return ret;
+			lib_ring_buffer_put_next_subbuf(buf);
+		}
+		ret = lib_ring_buffer_get_next_subbuf(buf);
+		if (!ret) {
+			/* Set file position to zero at each successful "get" */
+			filp->f_pos = 0;
+		}
+		return ret;
+	}
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -449,12 +818,258 @@ long vfs_lib_ring_buffer_compat_ioctl(struct file *filp, unsigned int cmd,
 }
 #endif
 
+/*
+ * Additional readers of a buffer, see lib_ring_buffer_reader_open(). They
+ * only read sub-buffers sequentially, with the GET_NEXT_SUBBUF and
+ * PUT_NEXT_SUBBUF ioctls, through splice or mmap.
+ */
+
+unsigned int lib_ring_buffer_reader_poll(struct file *filp, poll_table *wait,
+		struct lib_ring_buffer_reader *reader)
+{
+	struct lib_ring_buffer *buf = reader->buf;
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	int finalized;
+
+	if (!(filp->f_mode & FMODE_READ))
+		return 0;
+	/* Not exclusive: every reader reads every sub-buffer. */
+	poll_wait(filp, &buf->readers_wait, wait);
+	finalized = lib_ring_buffer_is_finalized(config, buf);
+	if (lib_ring_buffer_channel_is_disabled(chan))
+		return POLLERR;
+retry:
+	if (subbuf_trunc(lib_ring_buffer_get_offset(config, buf), chan)
+	    - subbuf_trunc(reader->consumed, chan) == 0) {
+		if (finalized)
+			return POLLHUP;
+		if (raw_spin_is_locked(&buf->raw_tick_nohz_spinlock))
+			goto retry;
+		return 0;
+	}
+	return POLLIN | POLLRDNORM;
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_reader_poll);
+
+static
+unsigned int vfs_lib_ring_buffer_reader_poll(struct file *filp,
+		poll_table *wait)
+{
+	struct lib_ring_buffer_reader *reader = filp->private_data;
+
+	return lib_ring_buffer_reader_poll(filp, wait, reader);
+}
+
+static
+int vfs_lib_ring_buffer_reader_release(struct inode *inode, struct file *file)
+{
+	struct lib_ring_buffer_reader *reader = file->private_data;
+
+	lib_ring_buffer_reader_release(reader);
+	return 0;
+}
+
+static
+ssize_t vfs_lib_ring_buffer_reader_splice_read(struct file *in, loff_t *ppos,
+		struct pipe_inode_info *pipe, size_t len, unsigned int flags)
+{
+	struct lib_ring_buffer_reader *reader = in->private_data;
+
+	return lib_ring_buffer_reader_splice_read(in, ppos, pipe, len, flags,
+						  reader);
+}
+
+static
+int vfs_lib_ring_buffer_reader_mmap(struct file *filp,
+		struct vm_area_struct *vma)
+{
+	struct lib_ring_buffer_reader *reader = filp->private_data;
+
+	return lib_ring_buffer_reader_mmap(filp, vma, reader);
+}
+
+long lib_ring_buffer_reader_ioctl(struct file *filp, unsigned int cmd,
+		unsigned long arg, struct lib_ring_buffer_reader *reader)
+{
+	struct lib_ring_buffer *buf = reader->buf;
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+
+	if (lib_ring_buffer_channel_is_disabled(chan))
+		return -EIO;
+
+	switch (cmd) {
+	case RING_BUFFER_PUT_GET_NEXT_SUBBUF:
+		if (reader->get_subbuf)
+			lib_ring_buffer_reader_put_next_subbuf(reader);
+		/* Fall-through */
+	case RING_BUFFER_GET_NEXT_SUBBUF:
+	{
+		long ret;
+
+		ret = lib_ring_buffer_reader_get_next_subbuf(reader);
+		if (!ret) {
+			/* Set file position to zero at each successful "get" */
+			filp->f_pos = 0;
+		}
+		return ret;
+	}
+	case RING_BUFFER_PUT_NEXT_SUBBUF:
+		lib_ring_buffer_reader_put_next_subbuf(reader);
+		return 0;
+	case RING_BUFFER_GET_SUBBUF_SIZE:
+		return put_ulong(lib_ring_buffer_reader_get_read_data_size(config,
+					reader), arg);
+	case RING_BUFFER_GET_PADDED_SUBBUF_SIZE:
+		return put_ulong(PAGE_ALIGN(
+			lib_ring_buffer_reader_get_read_data_size(config,
+				reader)), arg);
+	case RING_BUFFER_GET_MAX_SUBBUF_SIZE:
+		return put_ulong(chan->backend.subbuf_size, arg);
+	case RING_BUFFER_GET_MMAP_LEN:
+	{
+		unsigned long mmap_buf_len;
+
+		if (config->output != RING_BUFFER_MMAP)
+			return -EINVAL;
+		mmap_buf_len = chan->backend.buf_size;
+		if (chan->backend.extra_reader_sb)
+			mmap_buf_len += chan->backend.subbuf_size;
+		if (chan->backend.snapshot_pool)
+			mmap_buf_len += chan->backend.buf_size;
+		if (mmap_buf_len > INT_MAX)
+			return -EFBIG;
+		return put_ulong(mmap_buf_len, arg);
+	}
+	case RING_BUFFER_GET_MMAP_READ_OFFSET:
+		if (config->output != RING_BUFFER_MMAP || !reader->get_subbuf)
+			return -EINVAL;
+		return put_ulong(buf->backend.array[reader->sb_bindex]->mmap_offset,
+				 arg);
+	case RING_BUFFER_GET_NUMA_NODE:
+		return put_user((int32_t) buf->backend.node,
+				(int32_t __user *) arg);
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_reader_ioctl);
+
+static
+long vfs_lib_ring_buffer_reader_ioctl(struct file *filp, unsigned int cmd,
+		unsigned long arg)
+{
+	struct lib_ring_buffer_reader *reader = filp->private_data;
+
+	return lib_ring_buffer_reader_ioctl(filp, cmd, arg, reader);
+}
+
+#ifdef CONFIG_COMPAT
+long lib_ring_buffer_reader_compat_ioctl(struct file *filp, unsigned int cmd,
+		unsigned long arg, struct lib_ring_buffer_reader *reader)
+{
+	struct lib_ring_buffer *buf = reader->buf;
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+
+	if (lib_ring_buffer_channel_is_disabled(chan))
+		return -EIO;
+
+	switch (cmd) {
+	case RING_BUFFER_COMPAT_GET_SUBBUF_SIZE:
+	{
+		unsigned long data_size;
+
+		data_size = lib_ring_buffer_reader_get_read_data_size(config,
+				reader);
+		if (data_size > UINT_MAX)
+			return -EFBIG;
+		return compat_put_ulong(data_size, arg);
+	}
+	case RING_BUFFER_COMPAT_GET_PADDED_SUBBUF_SIZE:
+	{
+		unsigned long size;
+
+		size = lib_ring_buffer_reader_get_read_data_size(config,
+				reader);
+		size = PAGE_ALIGN(size);
+		if (size > UINT_MAX)
+			return -EFBIG;
+		return compat_put_ulong(size, arg);
+	}
+	case RING_BUFFER_COMPAT_GET_MAX_SUBBUF_SIZE:
+		if (chan->backend.subbuf_size > UINT_MAX)
+			return -EFBIG;
+		return compat_put_ulong(chan->backend.subbuf_size, arg);
+	case RING_BUFFER_COMPAT_GET_MMAP_LEN:
+	{
+		unsigned long mmap_buf_len;
+
+		if (config->output != RING_BUFFER_MMAP)
+			return -EINVAL;
+		mmap_buf_len = chan->backend.buf_size;
+		if (chan->backend.extra_reader_sb)
+			mmap_buf_len += chan->backend.subbuf_size;
+		if (chan->backend.snapshot_pool)
+			mmap_buf_len += chan->backend.buf_size;
+		if (mmap_buf_len > UINT_MAX)
+			return -EFBIG;
+		return compat_put_ulong(mmap_buf_len, arg);
+	}
+	case RING_BUFFER_COMPAT_GET_MMAP_READ_OFFSET:
+	{
+		unsigned long read_offset;
+
+		if (config->output != RING_BUFFER_MMAP || !reader->get_subbuf)
+			return -EINVAL;
+		read_offset = buf->backend.array[reader->sb_bindex]->mmap_offset;
+		if (read_offset > UINT_MAX)
+			return -EINVAL;
+		return compat_put_ulong(read_offset, arg);
+	}
+	default:
+		/* The other commands of readers have the same number. */
+		return lib_ring_buffer_reader_ioctl(filp, cmd, arg, reader);
+	}
+}
+EXPORT_SYMBOL_GPL(lib_ring_buffer_reader_compat_ioctl);
+
+static
+long vfs_lib_ring_buffer_reader_compat_ioctl(struct file *filp,
+		unsigned int cmd, unsigned long arg)
+{
+	struct lib_ring_buffer_reader *reader = filp->private_data;
+
+	return lib_ring_buffer_reader_compat_ioctl(filp, cmd, arg, reader);
+}
+#endif
+
+const struct file_operations lib_ring_buffer_reader_file_operations = {
+	.owner = THIS_MODULE,
+	.release = vfs_lib_ring_buffer_reader_release,
+	.poll = vfs_lib_ring_buffer_reader_poll,
+	.splice_read = vfs_lib_ring_buffer_reader_splice_read,
+	.mmap = vfs_lib_ring_buffer_reader_mmap,
+	.unlocked_ioctl = vfs_lib_ring_buffer_reader_ioctl,
+	.llseek = vfs_lib_ring_buffer_no_llseek,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl = vfs_lib_ring_buffer_reader_compat_ioctl,
+#endif
+};
+EXPORT_SYMBOL_GPL(lib_ring_buffer_reader_file_operations);
+
 const struct file_operations lib_ring_buffer_file_operations = {
 	.owner = THIS_MODULE,
 	.open = vfs_lib_ring_buffer_open,
 	.release = vfs_lib_ring_buffer_release,
 	.poll = vfs_lib_ring_buffer_poll,
 	.splice_read = vfs_lib_ring_buffer_splice_read,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+	.read_iter = vfs_lib_ring_buffer_subbuf_read_iter,
+#else
+	.read = vfs_lib_ring_buffer_subbuf_read,
+#endif
 	.mmap = vfs_lib_ring_buffer_mmap,
 	.unlocked_ioctl = vfs_lib_ring_buffer_ioctl,
 	.llseek = vfs_lib_ring_buffer_no_llseek,
@@ -28,16 +28,20 @@
 
 #include <linux/fs.h>
 #include <linux/poll.h>
+#include <linux/version.h>
 
 /* VFS API */
 
 extern const struct file_operations lib_ring_buffer_file_operations;
+/* File operations of the additional readers of a buffer */
+extern const struct file_operations lib_ring_buffer_reader_file_operations;
 
 /*
  * Internal file operations.
  */
 
 struct lib_ring_buffer;
+struct lib_ring_buffer_reader;
 
 int lib_ring_buffer_open(struct inode *inode, struct file *file,
 		struct lib_ring_buffer *buf);
@@ -48,8 +52,17 @@ unsigned int lib_ring_buffer_poll(struct file *filp, poll_table *wait,
 ssize_t lib_ring_buffer_splice_read(struct file *in, loff_t *ppos,
 		struct pipe_inode_info *pipe, size_t len,
 		unsigned int flags, struct lib_ring_buffer *buf);
+int lib_ring_buffer_splice_release_subbuf(struct lib_ring_buffer *buf);
 int lib_ring_buffer_mmap(struct file *filp, struct vm_area_struct *vma,
 		struct lib_ring_buffer *buf);
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+ssize_t lib_ring_buffer_subbuf_read_iter(struct kiocb *iocb,
+		struct iov_iter *to, struct lib_ring_buffer *buf);
+#else
+ssize_t lib_ring_buffer_subbuf_read(struct file *filp,
+		char __user *user_buf, size_t count, loff_t *ppos,
+		struct lib_ring_buffer *buf);
+#endif
 
 /* Ring Buffer ioctl() and ioctl numbers */
 long lib_ring_buffer_ioctl(struct file *filp, unsigned int cmd,
@@ -59,6 +72,100 @@ long lib_ring_buffer_compat_ioctl(struct file *filp, unsigned int cmd,
 		unsigned long arg, struct lib_ring_buffer *buf);
 #endif
 
+unsigned int lib_ring_buffer_reader_poll(struct file *filp, poll_table *wait,
+		struct lib_ring_buffer_reader *reader);
+ssize_t lib_ring_buffer_reader_splice_read(struct file *in, loff_t *ppos,
+		struct pipe_inode_info *pipe, size_t len,
+		unsigned int flags, struct lib_ring_buffer_reader *reader);
+int lib_ring_buffer_reader_mmap(struct file *filp, struct vm_area_struct *vma,
+		struct lib_ring_buffer_reader *reader);
+long lib_ring_buffer_reader_ioctl(struct file *filp, unsigned int cmd,
+		unsigned long arg, struct lib_ring_buffer_reader *reader);
+#ifdef CONFIG_COMPAT
+long lib_ring_buffer_reader_compat_ioctl(struct file *filp, unsigned int cmd,
+		unsigned long arg, struct lib_ring_buffer_reader *reader);
+#endif
+
+/*
+ * Sub-buffer compression request. dst and dst_len describe the user-space
+ * destination, compressed_len is set to the compressed size on return.
+ */
+struct lib_ring_buffer_compressed_subbuf {
+	uint64_t dst;
+	uint64_t dst_len;
+	uint64_t compressed_len;
+} __attribute__((packed));
+
+/*
+ * Control page, mapped read-only by mmap'ing one page at offset
+ * RING_BUFFER_GET_MMAP_LEN for RING_BUFFER_MMAP buffers. The positions are
+ * hints updated by the kernel without synchronization with the reader: a
+ * consumer can test "produced - consumed >= max subbuf size" to know it
+ * will find a sub-buffer with RING_BUFFER_PUT_GET_NEXT_SUBBUF, and should
+ * still use poll() to wait for data.
+ */
+struct lib_ring_buffer_ctrl_page {
+	uint64_t produced;	/* End of the last delivered sub-buffer */
+	uint64_t consumed;	/* Consumer position */
+	uint32_t finalized;	/* Buffer is finalized, no more data */
+};
+
+/*
+ * Batched sub-buffer read. Each readable sub-buffer is copied, with its page
+ * padding, into the user-space buffer described by dst and dst_len, and
+ * described by one entry of the descs array (max_descs entries). On
+ * return, nr_descs holds the number of sub-buffers copied and consumed.
+ */
+struct lib_ring_buffer_subbuf_desc {
+	uint64_t offset;	/* Offset of the packet within dst */
+	uint64_t padded_size;	/* Size copied, page-aligned */
+	uint64_t content_size;	/* Size of data, without padding */
+} __attribute__((packed));
+
+struct lib_ring_buffer_get_subbufs {
+	uint64_t dst;
+	uint64_t dst_len;
+	uint64_t descs;
+	uint32_t max_descs;
+	uint32_t nr_descs;
+} __attribute__((packed));
+
+/*
+ * Read timer wakeup coalescing: wake the reader once nr_subbuf sub-buffers
+ * are ready, or once data has been ready for deadline_ms milliseconds.
+ * nr_subbuf of 0 or 1 wakes the reader as soon as a sub-buffer is ready.
+ */
+struct lib_ring_buffer_wakeup_coalesce {
+	uint32_t nr_subbuf;
+	uint32_t deadline_ms;
+} __attribute__((packed));
+
+/*
+ * Live partial read: the data of the oldest packet not consumed yet is
+ * copied to dst, from the first byte not returned by a previous partial
+ * read. It is the committed prefix of the packet being written, which is
+ * left open, or the rest of a packet closed since. packet_offset is the
+ * offset of the copied data within its packet, len the number of bytes
+ * copied. Once a packet is closed, it is consumed and flags holds
+ * RING_BUFFER_PARTIAL_PACKET_END; if its start was returned earlier, its
+ * final header, header_len bytes, then precedes the data in dst, as the
+ * packet header is only complete once the packet is closed.
+ */
+struct lib_ring_buffer_partial_subbuf {
+	uint64_t dst;
+	uint64_t dst_len;
+	uint64_t packet_offset;
+	uint64_t len;
+	uint32_t header_len;
+	uint32_t flags;
+} __attribute__((packed));
+
+#define RING_BUFFER_PARTIAL_PACKET_END	(1U << 0)
+
+long lib_ring_buffer_compress_subbuf(struct lib_ring_buffer *buf,
+		struct lib_ring_buffer_compressed_subbuf __user *ucompress);
+void lib_ring_buffer_compress_free(struct lib_ring_buffer *buf);
+
 ssize_t vfs_lib_ring_buffer_file_splice_read(struct file *in, loff_t *ppos,
 		struct pipe_inode_info *pipe, size_t len, unsigned int flags);
 loff_t vfs_lib_ring_buffer_no_llseek(struct file *file, loff_t offset,
@@ -67,6 +174,13 @@ int vfs_lib_ring_buffer_mmap(struct file *filp, struct vm_area_struct *vma);
 ssize_t vfs_lib_ring_buffer_splice_read(struct file *in, loff_t *ppos,
 		struct pipe_inode_info *pipe, size_t len,
 		unsigned int flags);
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+ssize_t vfs_lib_ring_buffer_subbuf_read_iter(struct kiocb *iocb,
+		struct iov_iter *to);
+#else
+ssize_t vfs_lib_ring_buffer_subbuf_read(struct file *filp,
+		char __user *user_buf, size_t count, loff_t *ppos);
+#endif
 
 /*
  * Use RING_BUFFER_GET_NEXT_SUBBUF / RING_BUFFER_PUT_NEXT_SUBBUF to read and
@@ -115,6 +229,60 @@ ssize_t vfs_lib_ring_buffer_splice_read(struct file *in, loff_t *ppos,
 #define RING_BUFFER_FLUSH			_IO(0xF6, 0x0C)
 /* Get the current version of the metadata cache (after a get_next). */
 #define RING_BUFFER_GET_METADATA_VERSION	_IOR(0xF6, 0x0D, uint64_t)
+/* LZ4-compress the current sub-buffer (after a get) into a user buffer. */
+#define RING_BUFFER_GET_COMPRESSED_SUBBUF \
+	_IOWR(0xF6, 0x0E, struct lib_ring_buffer_compressed_subbuf)
+/* returns the NUMA node of the buffer pages, -1 if global or spread. */
+#define RING_BUFFER_GET_NUMA_NODE		_IOR(0xF6, 0x0F, int32_t)
+/*
+ * Release the current sub-buffer if any, move consumer forward, then get
+ * the next sub-buffer that can be read, in a single system call.
+ */
+#define RING_BUFFER_PUT_GET_NEXT_SUBBUF		_IO(0xF6, 0x10)
+/* Copy out and consume every readable sub-buffer, see above. */
+#define RING_BUFFER_GET_NEXT_SUBBUFS \
+	_IOWR(0xF6, 0x11, struct lib_ring_buffer_get_subbufs)
+/* Set read timer wakeup coalescing, see above. */
+#define RING_BUFFER_SET_WAKEUP_COALESCE \
+	_IOW(0xF6, 0x12, struct lib_ring_buffer_wakeup_coalesce)
+/*
+ * Set the maximum adaptive backoff of the switch and read timers, as a
+ * power of two of their period (0: disabled). Timers of an idle or
+ * quiescent buffer double their period at each expiry, up to that limit.
+ */
+#define RING_BUFFER_SET_TIMER_BACKOFF		_IOW(0xF6, 0x13, uint32_t)
+#define RING_BUFFER_TIMER_BACKOFF_MAX		8
+/*
+ * Incremental snapshot: like RING_BUFFER_SNAPSHOT, with the consumer
+ * position starting at the end of the previous incremental snapshot, so only
+ * the sub-buffers produced since are iterated. Returns -EAGAIN if no
+ * sub-buffer was produced since. As with RING_BUFFER_SNAPSHOT, the current
+ * sub-buffer is not flushed: issue RING_BUFFER_FLUSH first to include it.
+ */
+#define RING_BUFFER_SNAPSHOT_INCREMENTAL	_IO(0xF6, 0x14)
+/*
+ * Partial read of the current packet, see above. Discard mode only. Once a
+ * reader has used it, the switch timer no longer closes the packets of the
+ * buffer: the reader gets the data at its own pace. Returns -EAGAIN if no
+ * new data is committed, -ENOSPC if a closed packet does not fit in dst.
+ */
+#define RING_BUFFER_GET_PARTIAL_SUBBUF \
+	_IOWR(0xF6, 0x15, struct lib_ring_buffer_partial_subbuf)
+/*
+ * Time-window snapshot: like RING_BUFFER_SNAPSHOT, with the consumer
+ * position past the packets ending before the given timestamp, in trace
+ * clock units, as told by the packet index. Useful to extract only the
+ * last moments of a flight recorder.
+ */
+#define RING_BUFFER_SNAPSHOT_SINCE		_IOW(0xF6, 0x16, uint64_t)
+/*
+ * Zero-copy snapshot of a RING_BUFFER_SNAPSHOT_SWAP buffer: like
+ * RING_BUFFER_SNAPSHOT, with the delivered sub-buffers swapped out to the
+ * snapshot pool. Writers continue on the pool pages, so the sub-buffers are
+ * read with RING_BUFFER_GET_SUBBUF without being overwritten, until the
+ * next swap. Returns -EINVAL without snapshot pool.
+ */
+#define RING_BUFFER_SNAPSHOT_SWAP		_IO(0xF6, 0x17)
 
 #ifdef CONFIG_COMPAT
 /* Get a snapshot of the current ring buffer producer and consumer positions */
@@ -149,6 +317,24 @@ ssize_t vfs_lib_ring_buffer_splice_read(struct file *in, loff_t *ppos,
 #define RING_BUFFER_COMPAT_FLUSH		RING_BUFFER_FLUSH
 /* Get the current version of the metadata cache (after a get_next). */
 #define RING_BUFFER_COMPAT_GET_METADATA_VERSION	RING_BUFFER_GET_METADATA_VERSION
+/* LZ4-compress the current sub-buffer (after a get) into a user buffer. */
+#define RING_BUFFER_COMPAT_GET_COMPRESSED_SUBBUF \
+	RING_BUFFER_GET_COMPRESSED_SUBBUF
+/* returns the NUMA node of the buffer pages, -1 if global or spread. */
+#define RING_BUFFER_COMPAT_GET_NUMA_NODE	RING_BUFFER_GET_NUMA_NODE
+/* Release the current sub-buffer and get the next one. */
+#define RING_BUFFER_COMPAT_PUT_GET_NEXT_SUBBUF	RING_BUFFER_PUT_GET_NEXT_SUBBUF
+/* Copy out and consume every readable sub-buffer. */
+#define RING_BUFFER_COMPAT_GET_NEXT_SUBBUFS	RING_BUFFER_GET_NEXT_SUBBUFS
+/* Set read timer wakeup coalescing. */
+#define RING_BUFFER_COMPAT_SET_WAKEUP_COALESCE	RING_BUFFER_SET_WAKEUP_COALESCE
+/* Set the maximum adaptive timer backoff. */
+#define RING_BUFFER_COMPAT_SET_TIMER_BACKOFF	RING_BUFFER_SET_TIMER_BACKOFF
+/* Snapshot the sub-buffers produced since the last incremental one. */
+#define RING_BUFFER_COMPAT_SNAPSHOT_INCREMENTAL	RING_BUFFER_SNAPSHOT_INCREMENTAL
+#define RING_BUFFER_COMPAT_GET_PARTIAL_SUBBUF	RING_BUFFER_GET_PARTIAL_SUBBUF
+#define RING_BUFFER_COMPAT_SNAPSHOT_SINCE	RING_BUFFER_SNAPSHOT_SINCE
+#define RING_BUFFER_COMPAT_SNAPSHOT_SWAP	RING_BUFFER_SNAPSHOT_SWAP
 #endif /* CONFIG_COMPAT */
 
 #endif /* _LIB_RING_BUFFER_VFS_H */
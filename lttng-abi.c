@@ -48,12 +48,14 @@
 #include <wrapper/ringbuffer/vfs.h>
 #include <wrapper/ringbuffer/backend.h>
 #include <wrapper/ringbuffer/frontend.h>
+#include <wrapper/ringbuffer/iterator.h>
 #include <wrapper/poll.h>
 #include <wrapper/file.h>
 #include <wrapper/kref.h>
 #include <lttng-string-utils.h>
 #include <lttng-abi.h>
 #include <lttng-abi-old.h>
+#include <lttng-clock.h>
 #include <lttng-events.h>
 #include <lttng-tracer.h>
 #include <lib/ringbuffer/frontend_types.h>
@@ -73,6 +75,21 @@ static struct file_operations lttng_stream_ring_buffer_file_operations;
 
 static int put_u64(uint64_t val, unsigned long arg);
 
+/* Packet checksums are computed by the kernel CRC32C library. */
+#if defined(CONFIG_LIBCRC32C) || defined(CONFIG_LIBCRC32C_MODULE)
+#define LTTNG_CHANNEL_FLAG_CRC32C_SUPPORTED	LTTNG_KERNEL_CHANNEL_FLAG_CRC32C
+#else
+#define LTTNG_CHANNEL_FLAG_CRC32C_SUPPORTED	0
+#endif
+
+/* Writer wakeups are deferred through irq_work. */
+#ifdef CONFIG_IRQ_WORK
+#define LTTNG_CHANNEL_FLAG_WRITER_WAKEUP_SUPPORTED	\
+	LTTNG_KERNEL_CHANNEL_FLAG_WRITER_WAKEUP
+#else
+#define LTTNG_CHANNEL_FLAG_WRITER_WAKEUP_SUPPORTED	0
+#endif
+
 /*
  * Teardown management: opened file descriptors keep a refcount on the module,
  * so it can only exit when all file descriptors are closed.
@@ -111,6 +128,41 @@ fd_error:
 	return ret;
 }
 
+static
+int lttng_clock_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	return lttng_clock_page_mmap(vma);
+}
+
+static const struct file_operations lttng_clock_fops = {
+	.owner = THIS_MODULE,
+	.mmap = lttng_clock_mmap,
+};
+
+static
+int lttng_abi_clock(void)
+{
+	struct file *clock_file;
+	int clock_fd, ret;
+
+	clock_fd = lttng_get_unused_fd();
+	if (clock_fd < 0)
+		return clock_fd;
+	clock_file = anon_inode_getfile("[lttng_clock]",
+					&lttng_clock_fops,
+					NULL, O_RDONLY);
+	if (IS_ERR(clock_file)) {
+		ret = PTR_ERR(clock_file);
+		goto file_error;
+	}
+	fd_install(clock_fd, clock_file);
+	return clock_fd;
+
+file_error:
+	put_unused_fd(clock_fd);
+	return ret;
+}
+
 static
 int lttng_abi_tracepoint_list(void)
 {
@@ -246,6 +298,15 @@ long lttng_abi_add_context(struct file *file,
 		return lttng_add_preemptible_to_ctx(ctx);
 	case LTTNG_KERNEL_CONTEXT_MIGRATABLE:
 		return lttng_add_migratable_to_ctx(ctx);
+	case LTTNG_KERNEL_CONTEXT_CGROUP_ID:
+		return lttng_add_cgroup_id_to_ctx(ctx);
+	case LTTNG_KERNEL_CONTEXT_NUMA_NODE:
+		return lttng_add_numa_node_to_ctx(ctx);
+	case LTTNG_KERNEL_CONTEXT_CPU_FREQUENCY:
+		return lttng_add_cpu_frequency_to_ctx(ctx);
+	case LTTNG_KERNEL_CONTEXT_CALLSTACK:
+		/* Channel file: the definitions are recorded in the channel. */
+		return lttng_add_callstack_to_ctx(ctx, file->private_data);
 	default:
 		return -EINVAL;
 	}
@@ -269,6 +330,10 @@ long lttng_abi_add_context(struct file *file,
  *		Returns after all previously running probes have completed
  *	LTTNG_KERNEL_TRACER_ABI_VERSION
  *		Returns the LTTng kernel tracer ABI version
+ *	LTTNG_KERNEL_CALIBRATE_MEASURE
+ *		Measures the cost of the probes on the calibration function
+ *	LTTNG_KERNEL_CLOCK
+ *		Returns a file descriptor mapping the trace clock page
  *
  * The returned session will be deleted when its file descriptor is closed.
  */
@@ -358,6 +423,31 @@ long lttng_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			return -EFAULT;
 		return ret;
 	}
+	case LTTNG_KERNEL_CALIBRATE_MEASURE:
+	{
+		struct lttng_kernel_calibrate_measure __user *umeasure =
+			(struct lttng_kernel_calibrate_measure __user *) arg;
+		struct lttng_kernel_calibrate_measure *measure;
+		int ret;
+
+		measure = kzalloc(sizeof(*measure), GFP_KERNEL);
+		if (!measure)
+			return -ENOMEM;
+		if (get_user(measure->iterations, &umeasure->iterations)) {
+			ret = -EFAULT;
+			goto measure_end;
+		}
+		ret = lttng_calibrate_measure(measure);
+		if (ret)
+			goto measure_end;
+		if (copy_to_user(umeasure, measure, sizeof(*measure)))
+			ret = -EFAULT;
+	measure_end:
+		kfree(measure);
+		return ret;
+	}
+	case LTTNG_KERNEL_CLOCK:
+		return lttng_abi_clock();
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -379,11 +469,49 @@ int lttng_abi_create_channel(struct file *session_file,
 	struct lttng_session *session = session_file->private_data;
 	const struct file_operations *fops = NULL;
 	const char *transport_name;
+	void *buf_addr = NULL;
 	struct lttng_channel *chan;
 	struct file *chan_file;
 	int chan_fd;
 	int ret = 0;
 
+	if (chan_param->flags & ~(LTTNG_KERNEL_CHANNEL_FLAG_UNTIMED
+			| LTTNG_KERNEL_CHANNEL_FLAG_GLOBAL
+			| LTTNG_KERNEL_CHANNEL_FLAG_LLC
+			| LTTNG_CHANNEL_FLAG_CRC32C_SUPPORTED
+			| LTTNG_KERNEL_CHANNEL_FLAG_HOT_IDS
+			| LTTNG_CHANNEL_FLAG_WRITER_WAKEUP_SUPPORTED
+			| LTTNG_KERNEL_CHANNEL_FLAG_SNAPSHOT_SWAP
+			| LTTNG_KERNEL_CHANNEL_FLAG_LAZY
+			| LTTNG_KERNEL_CHANNEL_FLAG_TRACKED_SYSCALLS
+			| LTTNG_KERNEL_CHANNEL_FLAG_NO_RECORD_COUNT))
+		return -EINVAL;
+	if (chan_param->flags && channel_type != PER_CPU_CHANNEL)
+		return -EINVAL;
+	if ((chan_param->flags & (LTTNG_KERNEL_CHANNEL_FLAG_GLOBAL
+				| LTTNG_KERNEL_CHANNEL_FLAG_LLC))
+			&& chan_param->output != LTTNG_KERNEL_SPLICE)
+		return -EINVAL;
+	if ((chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_GLOBAL)
+			&& (chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_LLC))
+		return -EINVAL;
+	if ((chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_SNAPSHOT_SWAP)
+			&& (!chan_param->overwrite
+				|| chan_param->output != LTTNG_KERNEL_SPLICE
+				|| (chan_param->flags
+					& (LTTNG_KERNEL_CHANNEL_FLAG_GLOBAL
+					| LTTNG_KERNEL_CHANNEL_FLAG_LLC))))
+		return -EINVAL;
+	if ((chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_LAZY)
+			&& (chan_param->output != LTTNG_KERNEL_SPLICE
+				|| (chan_param->flags
+					& (LTTNG_KERNEL_CHANNEL_FLAG_GLOBAL
+					| LTTNG_KERNEL_CHANNEL_FLAG_LLC
+					| LTTNG_KERNEL_CHANNEL_FLAG_SNAPSHOT_SWAP))))
+		return -EINVAL;
+	if ((chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_WRITER_WAKEUP)
+			&& chan_param->read_timer_interval)
+		return -EINVAL;
 	chan_fd = lttng_get_unused_fd();
 	if (chan_fd < 0) {
 		ret = chan_fd;
@@ -391,6 +519,7 @@ int lttng_abi_create_channel(struct file *session_file,
 	}
 	switch (channel_type) {
 	case PER_CPU_CHANNEL:
+	case MAP_CHANNEL:
 		fops = &lttng_channel_fops;
 		break;
 	case METADATA_CHANNEL:
@@ -407,7 +536,19 @@ int lttng_abi_create_channel(struct file *session_file,
 	}
 	switch (channel_type) {
 	case PER_CPU_CHANNEL:
-		if (chan_param->output == LTTNG_KERNEL_SPLICE) {
+		if (chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_GLOBAL) {
+			transport_name = chan_param->overwrite ?
+				"relay-overwrite-global" : "relay-discard-global";
+		} else if (chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_LLC) {
+			transport_name = chan_param->overwrite ?
+				"relay-overwrite-llc" : "relay-discard-llc";
+		} else if (chan_param->flags
+				& LTTNG_KERNEL_CHANNEL_FLAG_SNAPSHOT_SWAP) {
+			transport_name = "relay-overwrite-swap";
+		} else if (chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_LAZY) {
+			transport_name = chan_param->overwrite ?
+				"relay-overwrite-lazy" : "relay-discard-lazy";
+		} else if (chan_param->output == LTTNG_KERNEL_SPLICE) {
 			transport_name = chan_param->overwrite ?
 				"relay-overwrite" : "relay-discard";
 		} else if (chan_param->output == LTTNG_KERNEL_MMAP) {
@@ -425,6 +566,10 @@ int lttng_abi_create_channel(struct file *session_file,
 		else
 			return -EINVAL;
 		break;
+	case MAP_CHANNEL:
+		transport_name = "map";
+		buf_addr = &chan_param->map;
+		break;
 	default:
 		transport_name = "<unknown>";
 		break;
@@ -437,7 +582,7 @@ int lttng_abi_create_channel(struct file *session_file,
 	 * We tolerate no failure path after channel creation. It will stay
 	 * invariant for the rest of the session.
 	 */
-	chan = lttng_channel_create(session, transport_name, NULL,
+	chan = lttng_channel_create(session, transport_name, buf_addr,
 				  chan_param->subbuf_size,
 				  chan_param->num_subbuf,
 				  chan_param->switch_timer_interval,
@@ -447,6 +592,21 @@ int lttng_abi_create_channel(struct file *session_file,
 		ret = -EINVAL;
 		goto chan_error;
 	}
+	/* Kept at session start, unlike the other header types. */
+	if (chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_UNTIMED)
+		chan->header_type = 4;	/* untimed */
+	if (chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_CRC32C)
+		chan->packet_crc32c = 1;
+	if (chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_TRACKED_SYSCALLS)
+		chan->sc_tracked_tasks = 1;
+	if (chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_HOT_IDS)
+		lttng_channel_reserve_hot_ids(chan);
+	/* Cannot fail: data channels wake up by timer, none is set. */
+	if (chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_WRITER_WAKEUP)
+		(void) lib_ring_buffer_channel_set_writer_wakeup(
+				&chan->chan->backend.config, chan->chan);
+	if (chan_param->flags & LTTNG_KERNEL_CHANNEL_FLAG_NO_RECORD_COUNT)
+		lib_ring_buffer_channel_set_no_record_count(chan->chan);
 	chan->file = chan_file;
 	chan_file->private_data = chan;
 	fd_install(chan_fd, chan_file);
@@ -463,6 +623,397 @@ fd_error:
 	return ret;
 }
 
+#ifdef CONFIG_IRQ_WORK
+/*
+ * Whole records only: the read size must hold at least one. Blocks
+ * until a record is available, unless O_NONBLOCK is set.
+ */
+static
+ssize_t lttng_notification_read(struct file *filp, char __user *user_buf,
+		size_t count, loff_t *ppos)
+{
+	struct lttng_notification *notification = filp->private_data;
+	struct lib_ring_buffer *buf = notification->buf;
+	struct channel *chan = notification->chan;
+	ssize_t read_count = 0, len;
+	int ret;
+
+	if (count < sizeof(struct lttng_kernel_notification))
+		return -EINVAL;
+	mutex_lock(&notification->read_lock);
+	while (count - read_count >= sizeof(struct lttng_kernel_notification)) {
+		len = lib_ring_buffer_get_next_record(chan, buf);
+		if (len == -EAGAIN && !read_count
+				&& !(filp->f_flags & O_NONBLOCK)) {
+			ret = wait_event_interruptible(buf->read_wait,
+				((len = lib_ring_buffer_get_next_record(chan,
+					buf)), len != -EAGAIN));
+			if (ret) {
+				read_count = ret;
+				break;
+			}
+		}
+		if (len < 0) {
+			if (!read_count && len != -ENODATA)
+				read_count = len;
+			break;
+		}
+		/* The record is consumed, even if the copy fails. */
+		atomic_long_inc(&notification->consumed);
+		if (__lib_ring_buffer_copy_to_user(&buf->backend,
+				buf->iter.read_offset, &user_buf[read_count],
+				len)) {
+			if (!read_count)
+				read_count = -EFAULT;
+			break;
+		}
+		read_count += len;
+	}
+	mutex_unlock(&notification->read_lock);
+	return read_count;
+}
+
+static
+unsigned int lttng_notification_poll(struct file *filp,
+		poll_table *wait)
+{
+	struct lttng_notification *notification = filp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &notification->buf->read_wait, wait);
+	if (atomic_long_read(&notification->produced)
+			!= atomic_long_read(&notification->consumed))
+		mask |= POLLIN | POLLRDNORM;
+	return mask;
+}
+
+/**
+ *	lttng_notification_ioctl - lttng notification fd ioctl
+ *
+ *	@file: the file
+ *	@cmd: the command
+ *	@arg: command arg
+ *
+ *	This ioctl implements lttng commands:
+ *	LTTNG_KERNEL_NOTIFICATION_STATS
+ *		Returns the number of notifications produced and lost
+ */
+static
+long lttng_notification_ioctl(struct file *file, unsigned int cmd,
+		unsigned long arg)
+{
+	struct lttng_notification *notification = file->private_data;
+
+	switch (cmd) {
+	case LTTNG_KERNEL_NOTIFICATION_STATS:
+	{
+		struct lttng_kernel_notification_stats stats;
+
+		memset(&stats, 0, sizeof(stats));
+		stats.produced = atomic_long_read(&notification->produced);
+		stats.lost = atomic_long_read(&notification->lost);
+		if (copy_to_user((struct lttng_kernel_notification_stats __user *) arg,
+				&stats, sizeof(stats)))
+			return -EFAULT;
+		return 0;
+	}
+	default:
+		return -ENOIOCTLCMD;
+	}
+}
+
+static
+int lttng_notification_release(struct inode *inode, struct file *file)
+{
+	struct lttng_notification *notification = file->private_data;
+	struct file *session_file = notification->session->file;
+
+	lttng_notification_destroy(notification);
+	fput(session_file);
+	return 0;
+}
+
+static const struct file_operations lttng_notification_fops = {
+	.owner = THIS_MODULE,
+	.read = lttng_notification_read,
+	.poll = lttng_notification_poll,
+	.release = lttng_notification_release,
+	.unlocked_ioctl = lttng_notification_ioctl,
+#ifdef CONFIG_COMPAT
+	.compat_ioctl = lttng_notification_ioctl,
+#endif
+	.llseek = vfs_lib_ring_buffer_no_llseek,
+};
+
+static
+int lttng_abi_create_notification(struct file *session_file,
+		struct lttng_kernel_notification_channel *param)
+{
+	struct lttng_session *session = session_file->private_data;
+	struct lttng_notification *notification;
+	struct file *notification_file;
+	int notification_fd, ret;
+
+	notification_fd = lttng_get_unused_fd();
+	if (notification_fd < 0) {
+		ret = notification_fd;
+		goto fd_error;
+	}
+	/* The notification buffer holds a reference on the session. */
+	if (atomic_long_add_unless(&session_file->f_count,
+		1, INT_MAX) == INT_MAX) {
+		ret = -EOVERFLOW;
+		goto refcount_error;
+	}
+	notification = lttng_notification_create(session,
+			param->subbuf_size, param->num_subbuf);
+	if (IS_ERR(notification)) {
+		ret = PTR_ERR(notification);
+		goto create_error;
+	}
+	notification_file = anon_inode_getfile("[lttng_notification]",
+			&lttng_notification_fops, notification, O_RDONLY);
+	if (IS_ERR(notification_file)) {
+		ret = PTR_ERR(notification_file);
+		goto file_error;
+	}
+	fd_install(notification_fd, notification_file);
+	return notification_fd;
+
+file_error:
+	lttng_notification_destroy(notification);
+create_error:
+	atomic_long_dec(&session_file->f_count);
+refcount_error:
+	put_unused_fd(notification_fd);
+fd_error:
+	return ret;
+}
+#else
+static
+int lttng_abi_create_notification(struct file *session_file,
+		struct lttng_kernel_notification_channel *param)
+{
+	return -ENOSYS;
+}
+#endif
+
+/*
+ * The statedump completion file descriptor becomes readable once the
+ * statedump of the last asynchronous start of the session is done.
+ * Reading it returns the statedump result, as an int32_t.
+ */
+static
+ssize_t lttng_statedump_done_read(struct file *filp, char __user *user_buf,
+		size_t count, loff_t *ppos)
+{
+	struct lttng_session *session = filp->private_data;
+	int32_t result;
+	int ret;
+
+	if (count < sizeof(result))
+		return -EINVAL;
+	if (ACCESS_ONCE(session->statedump_pending)) {
+		if (filp->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = wait_event_interruptible(session->statedump_wait,
+				!ACCESS_ONCE(session->statedump_pending));
+		if (ret)
+			return ret;
+	}
+	smp_rmb();	/* Completion before result */
+	result = ACCESS_ONCE(session->statedump_ret);
+	if (copy_to_user(user_buf, &result, sizeof(result)))
+		return -EFAULT;
+	return sizeof(result);
+}
+
+static
+unsigned int lttng_statedump_done_poll(struct file *filp, poll_table *wait)
+{
+	struct lttng_session *session = filp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &session->statedump_wait, wait);
+	if (!ACCESS_ONCE(session->statedump_pending))
+		mask |= POLLIN | POLLRDNORM;
+	return mask;
+}
+
+static
+int lttng_statedump_done_release(struct inode *inode, struct file *file)
+{
+	struct lttng_session *session = file->private_data;
+
+	fput(session->file);
+	return 0;
+}
+
+static const struct file_operations lttng_statedump_done_fops = {
+	.owner = THIS_MODULE,
+	.read = lttng_statedump_done_read,
+	.poll = lttng_statedump_done_poll,
+	.release = lttng_statedump_done_release,
+	.llseek = vfs_lib_ring_buffer_no_llseek,
+};
+
+/*
+ * Starts the session, its statedump being recorded in the background,
+ * and returns the statedump completion file descriptor.
+ */
+static
+int lttng_abi_session_start_async(struct file *session_file)
+{
+	struct lttng_session *session = session_file->private_data;
+	struct file *done_file;
+	int done_fd, ret;
+
+	done_fd = lttng_get_unused_fd();
+	if (done_fd < 0) {
+		ret = done_fd;
+		goto fd_error;
+	}
+	/* The completion file holds a reference on the session. */
+	if (atomic_long_add_unless(&session_file->f_count,
+		1, INT_MAX) == INT_MAX) {
+		ret = -EOVERFLOW;
+		goto refcount_error;
+	}
+	done_file = anon_inode_getfile("[lttng_statedump]",
+			&lttng_statedump_done_fops, session, O_RDONLY);
+	if (IS_ERR(done_file)) {
+		ret = PTR_ERR(done_file);
+		goto file_error;
+	}
+	ret = lttng_session_enable_async(session);
+	if (ret)
+		goto enable_error;
+	fd_install(done_fd, done_file);
+	return done_fd;
+
+enable_error:
+	fput(done_file);	/* Drops the session reference */
+	put_unused_fd(done_fd);
+	return ret;
+file_error:
+	atomic_long_dec(&session_file->f_count);
+refcount_error:
+	put_unused_fd(done_fd);
+fd_error:
+	return ret;
+}
+
+static
+long lttng_abi_session_cpu_mask(struct lttng_session *session,
+		struct lttng_kernel_cpu_mask __user *ucpu_mask)
+{
+	struct cpumask *mask;
+	uint32_t len, nr_bits;
+	char *bytes;
+	int cpu, ret;
+
+	ret = get_user(len, &ucpu_mask->len);
+	if (ret)
+		return ret;
+	if (!len)
+		return lttng_session_set_cpu_mask(session, NULL);
+	/* CPUs which cannot exist are ignored. */
+	nr_bits = min_t(uint32_t, len, nr_cpu_ids);
+	bytes = kmalloc(ALIGN(nr_bits, 8) >> 3, GFP_KERNEL);
+	mask = kzalloc(cpumask_size(), GFP_KERNEL);
+	if (!bytes || !mask) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	if (copy_from_user(bytes, ucpu_mask->mask, ALIGN(nr_bits, 8) >> 3)) {
+		ret = -EFAULT;
+		goto end;
+	}
+	for (cpu = 0; cpu < nr_bits; cpu++) {
+		if (bytes[cpu >> 3] & (1U << (cpu & 7)))
+			cpumask_set_cpu(cpu, mask);
+	}
+	ret = lttng_session_set_cpu_mask(session, mask);
+	if (!ret)
+		mask = NULL;	/* Owned by the session */
+end:
+	kfree(mask);
+	kfree(bytes);
+	return ret;
+}
+
+struct lttng_abi_metadata_binary_output {
+	char __user *data;
+	uint64_t len;		/* Size of data */
+	uint64_t written;	/* Size of the encoding so far */
+};
+
+/*
+ * Copy each part of the encoding as it is produced. Once a part does not
+ * fit, the following ones are only counted.
+ */
+static
+int lttng_abi_metadata_binary_flush(struct lttng_metadata_fragment *frag,
+		void *priv)
+{
+	struct lttng_abi_metadata_binary_output *out = priv;
+
+	if (out->written + frag->len <= out->len
+			&& copy_to_user(out->data + out->written, frag->data,
+				frag->len))
+		return -EFAULT;
+	out->written += frag->len;
+	return 0;
+}
+
+static
+long lttng_abi_session_metadata_binary(struct lttng_session *session,
+		struct lttng_kernel_session_metadata_binary __user *umdb)
+{
+	struct lttng_abi_metadata_binary_output out = {
+		.data = umdb->data,
+	};
+	struct lttng_metadata_fragment frag = { 0 };
+	int ret;
+
+	if (copy_from_user(&out.len, &umdb->len, sizeof(out.len)))
+		return -EFAULT;
+	ret = lttng_session_metadata_binary(session, &frag,
+			lttng_abi_metadata_binary_flush, &out);
+	lttng_metadata_fragment_free(&frag);
+	if (ret)
+		return ret;
+	if (put_user(out.written, &umdb->len))
+		return -EFAULT;
+	if (out.written > out.len)
+		return -ENOSPC;
+	return 0;
+}
+
+static
+long lttng_abi_channel_memory_usage(struct lttng_channel *channel,
+		struct lttng_kernel_channel_memory_usage __user *uusage)
+{
+	struct lttng_kernel_channel_memory_usage usage;
+	uint64_t *cpu_bytes;
+	uint32_t len;
+	int ret;
+
+	ret = get_user(len, &uusage->nr_cpus);
+	if (ret)
+		return ret;
+	cpu_bytes = kcalloc(nr_cpu_ids, sizeof(*cpu_bytes), GFP_KERNEL);
+	if (!cpu_bytes)
+		return -ENOMEM;
+	lttng_channel_get_memory_usage(channel, &usage, cpu_bytes);
+	if (copy_to_user(uusage, &usage, sizeof(usage))
+			|| copy_to_user(uusage->cpu_bytes, cpu_bytes,
+				min(len, usage.nr_cpus) * sizeof(*cpu_bytes)))
+		ret = -EFAULT;
+	kfree(cpu_bytes);
+	return ret;
+}
+
 /**
  *	lttng_session_ioctl - lttng session fd ioctl
  *
@@ -483,6 +1034,40 @@ fd_error:
  *		Add PID to session tracker
  *	LTTNG_KERNEL_SESSION_UNTRACK_PID
  *		Remove PID from session tracker
+ *	LTTNG_KERNEL_SESSION_TRACK_PID_NS
+ *		Add PID namespace (by inode number) to session tracker
+ *	LTTNG_KERNEL_SESSION_UNTRACK_PID_NS
+ *		Remove PID namespace from session tracker
+ *	LTTNG_KERNEL_SESSION_STATEDUMP_DELTA
+ *		Statedump of selected categories, or of what changed
+ *		since a previous statedump
+ *	LTTNG_KERNEL_SESSION_CPU_BUDGET
+ *		Bounds the estimated CPU time spent tracing the session
+ *	LTTNG_KERNEL_SESSION_NOTIFICATION
+ *		Returns a LTTng notification file descriptor, for the
+ *		notifications of the events with the NOTIFY action
+ *	LTTNG_KERNEL_SESSION_ROTATE
+ *		Takes the rotation position of every stream of the
+ *		session without stopping it, returns the rotation id
+ *	LTTNG_KERNEL_SESSION_BATCH_BEGIN
+ *		Defers the enabler updates of the session setup commands
+ *		which follow, on any of its file descriptors
+ *	LTTNG_KERNEL_SESSION_BATCH_COMMIT
+ *		Applies the enabler updates deferred since
+ *		LTTNG_KERNEL_SESSION_BATCH_BEGIN at once
+ *	LTTNG_KERNEL_SESSION_CPU_MASK
+ *		Restricts recording to a set of CPUs, which alone get
+ *		buffers in the channels created afterwards
+ *	LTTNG_KERNEL_SESSION_MEMORY_CAP
+ *		Bounds the buffer memory of the channels created
+ *		afterwards, shared by all of them
+ *	LTTNG_KERNEL_SESSION_MEMORY_USAGE
+ *		Returns the kernel memory pinned by the session
+ *	LTTNG_KERNEL_SESSION_METADATA_BINARY
+ *		Returns the session metadata in a compact binary encoding
+ *	LTTNG_KERNEL_SESSION_START_ASYNC
+ *		Starts tracing for a session without waiting for its
+ *		statedump, returns a statedump completion file descriptor
  *
  * The returned channel will be deleted when its file descriptor is closed.
  */
@@ -507,6 +1092,7 @@ long lttng_session_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		chan_param.switch_timer_interval = old_chan_param.switch_timer_interval;
 		chan_param.read_timer_interval = old_chan_param.read_timer_interval;
 		chan_param.output = old_chan_param.output;
+		chan_param.flags = 0;
 
 		return lttng_abi_create_channel(file, &chan_param,
 				PER_CPU_CHANNEL);
@@ -520,13 +1106,16 @@ long lttng_session_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 				sizeof(struct lttng_kernel_channel)))
 			return -EFAULT;
 		return lttng_abi_create_channel(file, &chan_param,
-				PER_CPU_CHANNEL);
+				chan_param.output == LTTNG_KERNEL_MAP ?
+					MAP_CHANNEL : PER_CPU_CHANNEL);
 	}
 	case LTTNG_KERNEL_OLD_SESSION_START:
 	case LTTNG_KERNEL_OLD_ENABLE:
 	case LTTNG_KERNEL_SESSION_START:
 	case LTTNG_KERNEL_ENABLE:
 		return lttng_session_enable(session);
+	case LTTNG_KERNEL_SESSION_START_ASYNC:
+		return lttng_abi_session_start_async(file);
 	case LTTNG_KERNEL_OLD_SESSION_STOP:
 	case LTTNG_KERNEL_OLD_DISABLE:
 	case LTTNG_KERNEL_SESSION_STOP:
@@ -547,6 +1136,7 @@ long lttng_session_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		chan_param.switch_timer_interval = old_chan_param.switch_timer_interval;
 		chan_param.read_timer_interval = old_chan_param.read_timer_interval;
 		chan_param.output = old_chan_param.output;
+		chan_param.flags = 0;
 
 		return lttng_abi_create_channel(file, &chan_param,
 				METADATA_CHANNEL);
@@ -572,6 +1162,99 @@ long lttng_session_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		return lttng_session_metadata_regenerate(session);
 	case LTTNG_KERNEL_SESSION_STATEDUMP:
 		return lttng_session_statedump(session);
+	case LTTNG_KERNEL_SESSION_STATEDUMP_DELTA:
+	{
+		struct lttng_kernel_statedump_delta delta_param;
+		u64 generation;
+		int ret;
+
+		if (copy_from_user(&delta_param,
+				(struct lttng_kernel_statedump_delta __user *) arg,
+				sizeof(delta_param)))
+			return -EFAULT;
+		if (delta_param.categories & ~LTTNG_KERNEL_STATEDUMP_CATEGORIES)
+			return -EINVAL;
+		if (delta_param.flags & ~LTTNG_KERNEL_STATEDUMP_FLAGS)
+			return -EINVAL;
+		ret = lttng_session_statedump_delta(session,
+				delta_param.since,
+				delta_param.categories ? :
+					LTTNG_KERNEL_STATEDUMP_ALL,
+				delta_param.flags, &generation);
+		if (ret)
+			return ret;
+		return put_user(generation,
+			&((struct lttng_kernel_statedump_delta __user *) arg)->generation);
+	}
+	case LTTNG_KERNEL_SESSION_CPU_BUDGET:
+	{
+		struct lttng_kernel_session_cpu_budget budget_param;
+
+		if (copy_from_user(&budget_param,
+				(struct lttng_kernel_session_cpu_budget __user *) arg,
+				sizeof(budget_param)))
+			return -EFAULT;
+		return lttng_session_cpu_budget(session, &budget_param);
+	}
+	case LTTNG_KERNEL_SESSION_NOTIFICATION:
+	{
+		struct lttng_kernel_notification_channel notification_param;
+
+		if (copy_from_user(&notification_param,
+				(struct lttng_kernel_notification_channel __user *) arg,
+				sizeof(notification_param)))
+			return -EFAULT;
+		return lttng_abi_create_notification(file, &notification_param);
+	}
+	case LTTNG_KERNEL_SESSION_ROTATE:
+	{
+		uint64_t rotation_id;
+		int ret;
+
+		ret = lttng_session_rotate(session, &rotation_id);
+		if (ret)
+			return ret;
+		return put_user(rotation_id, (uint64_t __user *) arg);
+	}
+	case LTTNG_KERNEL_SESSION_BATCH_BEGIN:
+		return lttng_session_batch_begin(session);
+	case LTTNG_KERNEL_SESSION_BATCH_COMMIT:
+		return lttng_session_batch_commit(session);
+	case LTTNG_KERNEL_SESSION_CPU_MASK:
+		return lttng_abi_session_cpu_mask(session,
+			(struct lttng_kernel_cpu_mask __user *) arg);
+	case LTTNG_KERNEL_SESSION_MEMORY_CAP:
+	{
+		struct lttng_kernel_session_memory_cap cap_param;
+
+		if (copy_from_user(&cap_param,
+				(struct lttng_kernel_session_memory_cap __user *) arg,
+				sizeof(cap_param)))
+			return -EFAULT;
+		return lttng_session_set_memory_cap(session,
+				cap_param.max_bytes);
+	}
+	case LTTNG_KERNEL_SESSION_METADATA_BINARY:
+		return lttng_abi_session_metadata_binary(session,
+			(struct lttng_kernel_session_metadata_binary __user *) arg);
+	case LTTNG_KERNEL_SESSION_MEMORY_USAGE:
+	{
+		struct lttng_kernel_session_memory_usage usage;
+
+		lttng_session_get_memory_usage(session, &usage);
+		if (copy_to_user((struct lttng_kernel_session_memory_usage __user *) arg,
+				&usage, sizeof(usage)))
+			return -EFAULT;
+		return 0;
+	}
+	case LTTNG_KERNEL_SESSION_TRACK_PID_NS:
+		return lttng_session_track_pid_ns(session,
+				(unsigned int) arg);
+	case LTTNG_KERNEL_SESSION_UNTRACK_PID_NS:
+		return lttng_session_untrack_pid_ns(session,
+				(unsigned int) arg);
+	case LTTNG_KERNEL_SESSION_LIST_TRACKER_PID_NS:
+		return lttng_session_list_tracker_pid_ns(session);
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -684,6 +1367,15 @@ long lttng_metadata_ring_buffer_ioctl(struct file *filp,
 		 */
 		return -ENOSYS;
 	}
+	case RING_BUFFER_PUT_GET_NEXT_SUBBUF:
+	case RING_BUFFER_GET_NEXT_SUBBUFS:
+	{
+		/*
+		 * Metadata has to be output to the channel between put
+		 * and get: use PUT_NEXT_SUBBUF and GET_NEXT_SUBBUF.
+		 */
+		return -ENOSYS;
+	}
 	case RING_BUFFER_FLUSH:
 	{
 		struct lttng_metadata_stream *stream = filp->private_data;
@@ -772,6 +1464,15 @@ long lttng_metadata_ring_buffer_compat_ioctl(struct file *filp,
 		 */
 		return -ENOSYS;
 	}
+	case RING_BUFFER_PUT_GET_NEXT_SUBBUF:
+	case RING_BUFFER_GET_NEXT_SUBBUFS:
+	{
+		/*
+		 * Metadata has to be output to the channel between put
+		 * and get: use PUT_NEXT_SUBBUF and GET_NEXT_SUBBUF.
+		 */
+		return -ENOSYS;
+	}
 	case RING_BUFFER_FLUSH:
 	{
 		struct lttng_metadata_stream *stream = filp->private_data;
@@ -875,6 +1576,28 @@ ssize_t lttng_metadata_ring_buffer_splice_read(struct file *in, loff_t *ppos,
 			flags, buf);
 }
 
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+static
+ssize_t lttng_metadata_ring_buffer_read_iter(struct kiocb *iocb,
+		struct iov_iter *to)
+{
+	struct lttng_metadata_stream *stream = iocb->ki_filp->private_data;
+	struct lib_ring_buffer *buf = stream->priv;
+
+	return lib_ring_buffer_subbuf_read_iter(iocb, to, buf);
+}
+#else
+static
+ssize_t lttng_metadata_ring_buffer_read(struct file *filp,
+		char __user *user_buf, size_t count, loff_t *ppos)
+{
+	struct lttng_metadata_stream *stream = filp->private_data;
+	struct lib_ring_buffer *buf = stream->priv;
+
+	return lib_ring_buffer_subbuf_read(filp, user_buf, count, ppos, buf);
+}
+#endif
+
 static
 int lttng_metadata_ring_buffer_mmap(struct file *filp,
 		struct vm_area_struct *vma)
@@ -892,6 +1615,11 @@ const struct file_operations lttng_metadata_ring_buffer_file_operations = {
 	.release = lttng_metadata_ring_buffer_release,
 	.poll = lttng_metadata_ring_buffer_poll,
 	.splice_read = lttng_metadata_ring_buffer_splice_read,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+	.read_iter = lttng_metadata_ring_buffer_read_iter,
+#else
+	.read = lttng_metadata_ring_buffer_read,
+#endif
 	.mmap = lttng_metadata_ring_buffer_mmap,
 	.unlocked_ioctl = lttng_metadata_ring_buffer_ioctl,
 	.llseek = vfs_lib_ring_buffer_no_llseek,
@@ -946,7 +1674,10 @@ int lttng_abi_open_stream(struct file *channel_file)
 	int ret;
 	void *stream_priv;
 
+	/* Resizing the channel replaces channel->chan. */
+	lttng_lock_sessions();
 	buf = channel->ops->buffer_read_open(channel->chan);
+	lttng_unlock_sessions();
 	if (!buf)
 		return -ENOENT;
 
@@ -963,6 +1694,172 @@ fd_error:
 	return ret;
 }
 
+/*
+ * The additional reader holds a reference to the channel within the
+ * generic ring buffer library, like the stream it is opened from.
+ */
+static
+int lttng_abi_open_stream_reader(struct file *stream_file)
+{
+	struct lib_ring_buffer *buf = stream_file->private_data;
+	struct lib_ring_buffer_reader *reader;
+	int ret;
+
+	reader = lib_ring_buffer_reader_open(buf);
+	if (IS_ERR(reader))
+		return PTR_ERR(reader);
+	ret = lttng_abi_create_stream_fd(stream_file, reader,
+			&lib_ring_buffer_reader_file_operations);
+	if (ret < 0)
+		lib_ring_buffer_reader_release(reader);
+	return ret;
+}
+
+/*
+ * Open up to "count" streams under a single sessions mutex critical
+ * section. The file descriptors are installed only once they are all
+ * copied to user-space: on error, no stream is left opened.
+ */
+static
+int lttng_abi_open_streams(struct file *channel_file,
+		struct lttng_kernel_stream_bulk __user *ubulk)
+{
+	struct lttng_channel *channel = channel_file->private_data;
+	struct lttng_kernel_stream_bulk bulk;
+	struct lib_ring_buffer **bufs = NULL;
+	struct file **files = NULL;
+	int32_t *fds = NULL;
+	uint32_t nr, i, j;
+	int ret;
+
+	if (copy_from_user(&bulk, ubulk, sizeof(bulk)))
+		return -EFAULT;
+	bulk.count = min_t(uint32_t, bulk.count, num_possible_cpus());
+	if (!bulk.count)
+		return -EINVAL;
+	bufs = kcalloc(bulk.count, sizeof(*bufs), GFP_KERNEL);
+	files = kcalloc(bulk.count, sizeof(*files), GFP_KERNEL);
+	fds = kcalloc(bulk.count, sizeof(*fds), GFP_KERNEL);
+	if (!bufs || !files || !fds) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	/* Resizing the channel replaces channel->chan. */
+	lttng_lock_sessions();
+	for (nr = 0; nr < bulk.count; nr++) {
+		bufs[nr] = channel->ops->buffer_read_open(channel->chan);
+		if (!bufs[nr])
+			break;
+	}
+	lttng_unlock_sessions();
+	if (!nr) {
+		ret = -ENOENT;
+		goto end;
+	}
+	for (i = 0; i < nr; i++) {
+		fds[i] = lttng_get_unused_fd();
+		if (fds[i] < 0) {
+			ret = fds[i];
+			goto error;
+		}
+		files[i] = anon_inode_getfile("[lttng_stream]",
+				&lttng_stream_ring_buffer_file_operations,
+				bufs[i], O_RDWR);
+		if (IS_ERR(files[i])) {
+			ret = PTR_ERR(files[i]);
+			put_unused_fd(fds[i]);
+			goto error;
+		}
+		/* See lttng_abi_create_stream_fd. */
+		files[i]->f_mode |= FMODE_PREAD;
+	}
+	if (copy_to_user((int32_t __user *) (unsigned long) bulk.fds, fds,
+				nr * sizeof(*fds))
+			|| put_user(nr, &ubulk->count)) {
+		ret = -EFAULT;
+		goto error;
+	}
+	for (i = 0; i < nr; i++)
+		fd_install(fds[i], files[i]);
+	ret = 0;
+	goto end;
+
+error:
+	/* Releasing a stream file closes its buffer. */
+	for (j = 0; j < i; j++) {
+		fput(files[j]);
+		put_unused_fd(fds[j]);
+	}
+	for (; j < nr; j++)
+		channel->ops->buffer_read_close(bufs[j]);
+end:
+	kfree(fds);
+	kfree(files);
+	kfree(bufs);
+	return ret;
+}
+
+static
+ssize_t lttng_map_read(struct file *filp, char __user *user_buf,
+		size_t count, loff_t *ppos)
+{
+	struct lttng_channel *channel = filp->private_data;
+
+	return channel->ops->map_read(channel->chan, user_buf, count, ppos);
+}
+
+static
+int lttng_map_release(struct inode *inode, struct file *file)
+{
+	struct lttng_channel *channel = file->private_data;
+
+	fput(channel->file);
+	return 0;
+}
+
+static const struct file_operations lttng_map_fops = {
+	.owner = THIS_MODULE,
+	.read = lttng_map_read,
+	.release = lttng_map_release,
+	.llseek = default_llseek,
+};
+
+static
+int lttng_abi_open_map(struct file *channel_file)
+{
+	struct lttng_channel *channel = channel_file->private_data;
+	struct file *map_file;
+	int map_fd, ret;
+
+	map_fd = lttng_get_unused_fd();
+	if (map_fd < 0) {
+		ret = map_fd;
+		goto fd_error;
+	}
+	/* The map holds a reference on the channel */
+	if (atomic_long_add_unless(&channel_file->f_count,
+		1, INT_MAX) == INT_MAX) {
+		ret = -EOVERFLOW;
+		goto refcount_error;
+	}
+	map_file = anon_inode_getfile("[lttng_map]", &lttng_map_fops,
+			channel, O_RDONLY);
+	if (IS_ERR(map_file)) {
+		ret = PTR_ERR(map_file);
+		goto file_error;
+	}
+	map_file->f_mode |= FMODE_LSEEK | FMODE_PREAD;
+	fd_install(map_fd, map_file);
+	return map_fd;
+
+file_error:
+	atomic_long_dec(&channel_file->f_count);
+refcount_error:
+	put_unused_fd(map_fd);
+fd_error:
+	return ret;
+}
+
 static
 int lttng_abi_open_metadata_stream(struct file *channel_file)
 {
@@ -973,7 +1870,10 @@ int lttng_abi_open_metadata_stream(struct file *channel_file)
 	struct lttng_metadata_stream *metadata_stream;
 	void *stream_priv;
 
+	/* Resizing the channel replaces channel->chan. */
+	lttng_lock_sessions();
 	buf = channel->ops->buffer_read_open(channel->chan);
+	lttng_unlock_sessions();
 	if (!buf)
 		return -ENOENT;
 
@@ -1047,6 +1947,10 @@ int lttng_abi_create_event(struct file *channel_file,
 	default:
 		break;
 	}
+	if (event_param->sampling.rate && !event_param->sampling.burst) {
+		ret = -EINVAL;
+		goto fd_error;
+	}
 	event_fd = lttng_get_unused_fd();
 	if (event_fd < 0) {
 		ret = event_fd;
@@ -1123,6 +2027,7 @@ fd_error:
  *      LTTNG_KERNEL_STREAM
  *              Returns an event stream file descriptor or failure.
  *              (typically, one event stream records events from one CPU)
+ *              For map channels, returns the map file descriptor.
  *	LTTNG_KERNEL_EVENT
  *		Returns an event file descriptor or failure.
  *	LTTNG_KERNEL_CONTEXT
@@ -1131,6 +2036,40 @@ fd_error:
  *		Enable recording for events in this channel (weak enable)
  *	LTTNG_KERNEL_DISABLE
  *		Disable recording for events in this channel (strong disable)
+ *	LTTNG_KERNEL_SYSCALL_LATENCY
+ *		Pair system call entry and exit into a single record
+ *	LTTNG_KERNEL_CONTEXT_PACKET_SCOPED
+ *		Prepend a context field to each event in the channel, only
+ *		recorded in the first event of each packet and when its
+ *		value changes
+ *	LTTNG_KERNEL_TASK_MARKER
+ *		Record the identity of the incoming task at each
+ *		sched_switch in the channel (1: enable, 0: disable)
+ *	LTTNG_KERNEL_CHANNEL_STATS
+ *		Returns the channel event and buffer statistics
+ *	LTTNG_KERNEL_CHANNEL_RESIZE
+ *		Replace the channel buffers with buffers of a new sub-buffer
+ *		size and count, without stopping the session
+ *	LTTNG_KERNEL_STRING_DICT
+ *		Record the dictionary-encoded text fields of the events
+ *		created from then on as ids, defined once per packet
+ *	LTTNG_KERNEL_STREAM_BULK
+ *		Returns the file descriptors of several streams at once
+ *	LTTNG_KERNEL_HOT_EVENT
+ *		Give the events created from then on whose name matches a
+ *		reserved compact event id, with LTTNG_KERNEL_CHANNEL_FLAG_HOT_IDS
+ *	LTTNG_KERNEL_CHANNEL_MEMORY_USAGE
+ *		Returns the buffer memory of the channel, per CPU
+ *	LTTNG_KERNEL_CHANNEL_FRAGMENT
+ *		Record the records reserved from then on which do not fit
+ *		in a sub-buffer as a sequence of fragments
+ *	LTTNG_KERNEL_CHANNEL_DELTA
+ *		Record the delta-encoded integer fields of the events
+ *		created from then on as differences with the previous
+ *		record of the event on the CPU
+ *	LTTNG_KERNEL_CHANNEL_AUTOTUNE
+ *		Tune the sub-buffer size and count of the channel from the
+ *		observed reader lag and lost records
  *
  * Channel and event file descriptors also hold a reference on the session.
  */
@@ -1142,7 +2081,14 @@ long lttng_channel_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	switch (cmd) {
 	case LTTNG_KERNEL_OLD_STREAM:
 	case LTTNG_KERNEL_STREAM:
+		if (channel->channel_type == MAP_CHANNEL)
+			return lttng_abi_open_map(file);
 		return lttng_abi_open_stream(file);
+	case LTTNG_KERNEL_STREAM_BULK:
+		if (channel->channel_type == MAP_CHANNEL)
+			return -EINVAL;
+		return lttng_abi_open_streams(file,
+				(struct lttng_kernel_stream_bulk __user *) arg);
 	case LTTNG_KERNEL_OLD_EVENT:
 	{
 		struct lttng_kernel_event *uevent_param;
@@ -1173,6 +2119,8 @@ long lttng_channel_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 				sizeof(uevent_param->name));
 		uevent_param->instrumentation =
 			old_uevent_param->instrumentation;
+		memset(&uevent_param->sampling, 0,
+				sizeof(uevent_param->sampling));
 
 		switch (old_uevent_param->instrumentation) {
 		case LTTNG_KERNEL_KPROBE:
@@ -1183,6 +2131,7 @@ long lttng_channel_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			memcpy(uevent_param->u.kprobe.symbol_name,
 				old_uevent_param->u.kprobe.symbol_name,
 				sizeof(uevent_param->u.kprobe.symbol_name));
+			uevent_param->u.kprobe.args = 0;
 			break;
 		case LTTNG_KERNEL_KRETPROBE:
 			uevent_param->u.kretprobe.addr =
@@ -1192,6 +2141,8 @@ long lttng_channel_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			memcpy(uevent_param->u.kretprobe.symbol_name,
 				old_uevent_param->u.kretprobe.symbol_name,
 				sizeof(uevent_param->u.kretprobe.symbol_name));
+			uevent_param->u.kretprobe.flags = 0;
+			uevent_param->u.kretprobe.latency_threshold = 0;
 			break;
 		case LTTNG_KERNEL_FUNCTION:
 			memcpy(uevent_param->u.ftrace.symbol_name,
@@ -1291,6 +2242,96 @@ old_ctx_end:
 	case LTTNG_KERNEL_SYSCALL_MASK:
 		return lttng_channel_syscall_mask(channel,
 			(struct lttng_kernel_syscall_mask __user *) arg);
+	case LTTNG_KERNEL_SYSCALL_LATENCY:
+	{
+		struct lttng_kernel_syscall_latency latency_param;
+
+		if (copy_from_user(&latency_param,
+				(struct lttng_kernel_syscall_latency __user *) arg,
+				sizeof(latency_param)))
+			return -EFAULT;
+		return lttng_channel_syscall_latency(channel, &latency_param);
+	}
+	case LTTNG_KERNEL_CONTEXT_PACKET_SCOPED:
+	{
+		struct lttng_kernel_context ucontext_param;
+		struct lttng_ctx_field *field;
+		long ret;
+
+		if (channel->channel_type != PER_CPU_CHANNEL)
+			return -EINVAL;
+		if (copy_from_user(&ucontext_param,
+				(struct lttng_kernel_context __user *) arg,
+				sizeof(ucontext_param)))
+			return -EFAULT;
+		ret = lttng_abi_add_context(file,
+				&ucontext_param,
+				&channel->ctx, channel->session);
+		if (ret)
+			return ret;
+		ret = lttng_context_packet_scope(channel->ctx);
+		if (ret) {
+			field = &channel->ctx->fields[channel->ctx->nr_fields - 1];
+			if (field->destroy)
+				field->destroy(field);
+			lttng_remove_context_field(&channel->ctx, field);
+			lttng_context_update(channel->ctx);
+		}
+		return ret;
+	}
+	case LTTNG_KERNEL_TASK_MARKER:
+		return lttng_channel_task_marker(channel, !!(int) arg);
+	case LTTNG_KERNEL_CHANNEL_STATS:
+	{
+		struct lttng_kernel_channel_stats stats;
+
+		lttng_channel_get_stats(channel, &stats);
+		if (copy_to_user((struct lttng_kernel_channel_stats __user *) arg,
+				&stats, sizeof(stats)))
+			return -EFAULT;
+		return 0;
+	}
+	case LTTNG_KERNEL_CHANNEL_RESIZE:
+	{
+		struct lttng_kernel_channel_resize resize;
+
+		if (copy_from_user(&resize,
+				(struct lttng_kernel_channel_resize __user *) arg,
+				sizeof(resize)))
+			return -EFAULT;
+		return lttng_channel_resize(channel, resize.subbuf_size,
+				resize.num_subbuf);
+	}
+	case LTTNG_KERNEL_STRING_DICT:
+		return lttng_channel_string_dict(channel);
+	case LTTNG_KERNEL_CHANNEL_DELTA:
+		return lttng_channel_delta(channel);
+	case LTTNG_KERNEL_CHANNEL_AUTOTUNE:
+	{
+		struct lttng_kernel_channel_autotune autotune;
+
+		if (copy_from_user(&autotune,
+				(struct lttng_kernel_channel_autotune __user *) arg,
+				sizeof(autotune)))
+			return -EFAULT;
+		return lttng_channel_autotune(channel, &autotune);
+	}
+	case LTTNG_KERNEL_HOT_EVENT:
+	{
+		struct lttng_kernel_hot_event hot_param;
+
+		if (copy_from_user(&hot_param,
+				(struct lttng_kernel_hot_event __user *) arg,
+				sizeof(hot_param)))
+			return -EFAULT;
+		hot_param.name[LTTNG_KERNEL_SYM_NAME_LEN - 1] = '\0';
+		return lttng_channel_add_hot_event(channel, hot_param.name);
+	}
+	case LTTNG_KERNEL_CHANNEL_MEMORY_USAGE:
+		return lttng_abi_channel_memory_usage(channel,
+			(struct lttng_kernel_channel_memory_usage __user *) arg);
+	case LTTNG_KERNEL_CHANNEL_FRAGMENT:
+		return lttng_channel_fragment(channel);
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -1334,17 +2375,19 @@ unsigned int lttng_channel_poll(struct file *file, poll_table *wait)
 	unsigned int mask = 0;
 
 	if (file->f_mode & FMODE_READ) {
+		/* Resizing the channel replaces channel->chan. */
+		lttng_lock_sessions();
 		poll_wait_set_exclusive(wait);
 		poll_wait(file, channel->ops->get_hp_wait_queue(channel->chan),
 			  wait);
 
 		if (channel->ops->is_disabled(channel->chan))
-			return POLLERR;
-		if (channel->ops->is_finalized(channel->chan))
-			return POLLHUP;
-		if (channel->ops->buffer_has_read_closed_stream(channel->chan))
-			return POLLIN | POLLRDNORM;
-		return 0;
+			mask = POLLERR;
+		else if (channel->ops->is_finalized(channel->chan))
+			mask = POLLHUP;
+		else if (channel->ops->buffer_has_read_closed_stream(channel->chan))
+			mask = POLLIN | POLLRDNORM;
+		lttng_unlock_sessions();
 	}
 	return mask;
 
@@ -1406,6 +2449,13 @@ static const struct file_operations lttng_metadata_fops = {
  *		Enable recording for this event (weak enable)
  *	LTTNG_KERNEL_DISABLE
  *		Disable recording for this event (strong disable)
+ *	LTTNG_KERNEL_FILTER
+ *		Attach a filter to an enabler, or to a kprobe, kretprobe
+ *		or function event
+ *	LTTNG_KERNEL_EVENT_STATS
+ *		Returns the event statistics
+ *	LTTNG_KERNEL_EVENT_ACTION
+ *		Set the action run when a hit passes the event filters
  */
 static
 long lttng_event_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
@@ -1451,10 +2501,38 @@ long lttng_event_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 			WARN_ON_ONCE(1);
 			return -ENOSYS;
 		}
+	case LTTNG_KERNEL_EVENT_STATS:
+	{
+		struct lttng_kernel_event_stats stats;
+
+		if (*evtype != LTTNG_TYPE_EVENT)
+			return -EINVAL;
+		event = file->private_data;
+		lttng_event_get_stats(event, &stats);
+		if (copy_to_user((struct lttng_kernel_event_stats __user *) arg,
+				&stats, sizeof(stats)))
+			return -EFAULT;
+		return 0;
+	}
+	case LTTNG_KERNEL_EVENT_ACTION:
+	{
+		struct lttng_kernel_event_action action_param;
+
+		if (*evtype != LTTNG_TYPE_EVENT)
+			return -EINVAL;
+		if (copy_from_user(&action_param,
+				(struct lttng_kernel_event_action __user *) arg,
+				sizeof(action_param)))
+			return -EFAULT;
+		event = file->private_data;
+		return lttng_event_set_action(event, &action_param);
+	}
 	case LTTNG_KERNEL_FILTER:
 		switch (*evtype) {
 		case LTTNG_TYPE_EVENT:
-			return -EINVAL;
+			event = file->private_data;
+			return lttng_event_attach_bytecode(event,
+				(struct lttng_kernel_filter_bytecode __user *) arg);
 		case LTTNG_TYPE_ENABLER:
 		{
 			enabler = file->private_data;
@@ -1512,6 +2590,36 @@ static int put_u64(uint64_t val, unsigned long arg)
 	return put_user(val, (uint64_t __user *) arg);
 }
 
+static
+long lttng_stream_get_packet_index(struct lib_ring_buffer *buf,
+		struct lttng_kernel_packet_index_batch __user *ubatch)
+{
+	struct channel *chan = buf->backend.chan;
+	const struct lib_ring_buffer_config *config = &chan->backend.config;
+	const struct lttng_channel_ops *ops = chan->backend.priv_ops;
+	struct lttng_kernel_packet_index_batch batch;
+	struct lttng_kernel_packet_index __user *uentries;
+	uint32_t i;
+
+	if (!ops->packet_index)
+		return -ENOSYS;
+	if (copy_from_user(&batch, ubatch, sizeof(batch)))
+		return -EFAULT;
+	uentries = (struct lttng_kernel_packet_index __user *)
+			(unsigned long) batch.entries;
+	for (i = 0; i < batch.count; i++) {
+		struct lttng_kernel_packet_index index;
+
+		if (ops->packet_index(config, buf, batch.seq_num + i, &index))
+			break;
+		if (copy_to_user(&uentries[i], &index, sizeof(index)))
+			return -EFAULT;
+	}
+	if (put_user(i, &ubatch->count))
+		return -EFAULT;
+	return 0;
+}
+
 static long lttng_stream_ring_buffer_ioctl(struct file *filp,
 		unsigned int cmd, unsigned long arg)
 {
@@ -1606,6 +2714,21 @@ static long lttng_stream_ring_buffer_ioctl(struct file *filp,
 			goto error;
 		return put_u64(id, arg);
 	}
+	case LTTNG_RING_BUFFER_GET_ROTATE_POSITION:
+	{
+		struct lttng_kernel_rotate_position pos;
+
+		lttng_stream_get_rotate_position(buf, &pos);
+		if (copy_to_user((struct lttng_kernel_rotate_position __user *) arg,
+				&pos, sizeof(pos)))
+			return -EFAULT;
+		return 0;
+	}
+	case LTTNG_RING_BUFFER_GET_PACKET_INDEX:
+		return lttng_stream_get_packet_index(buf,
+			(struct lttng_kernel_packet_index_batch __user *) arg);
+	case LTTNG_RING_BUFFER_OPEN_READER:
+		return lttng_abi_open_stream_reader(filp);
 	default:
 		return lib_ring_buffer_file_operations.unlocked_ioctl(filp,
 				cmd, arg);
@@ -1710,6 +2833,21 @@ static long lttng_stream_ring_buffer_compat_ioctl(struct file *filp,
 			goto error;
 		return put_u64(id, arg);
 	}
+	case LTTNG_RING_BUFFER_COMPAT_GET_ROTATE_POSITION:
+	{
+		struct lttng_kernel_rotate_position pos;
+
+		lttng_stream_get_rotate_position(buf, &pos);
+		if (copy_to_user((struct lttng_kernel_rotate_position __user *) arg,
+				&pos, sizeof(pos)))
+			return -EFAULT;
+		return 0;
+	}
+	case LTTNG_RING_BUFFER_COMPAT_GET_PACKET_INDEX:
+		return lttng_stream_get_packet_index(buf,
+			(struct lttng_kernel_packet_index_batch __user *) arg);
+	case LTTNG_RING_BUFFER_COMPAT_OPEN_READER:
+		return lttng_abi_open_stream_reader(filp);
 	default:
 		return lib_ring_buffer_file_operations.compat_ioctl(filp,
 				cmd, arg);
@@ -1733,6 +2871,13 @@ static void lttng_stream_override_ring_buffer_fops(void)
 		lib_ring_buffer_file_operations.splice_read;
 	lttng_stream_ring_buffer_file_operations.mmap =
 		lib_ring_buffer_file_operations.mmap;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,16,0))
+	lttng_stream_ring_buffer_file_operations.read_iter =
+		lib_ring_buffer_file_operations.read_iter;
+#else
+	lttng_stream_ring_buffer_file_operations.read =
+		lib_ring_buffer_file_operations.read;
+#endif
 	lttng_stream_ring_buffer_file_operations.unlocked_ioctl =
 		lttng_stream_ring_buffer_ioctl;
 	lttng_stream_ring_buffer_file_operations.llseek =
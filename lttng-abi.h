@@ -30,7 +30,7 @@
  * should be increased when an incompatible ABI change is done.
  */
 #define LTTNG_MODULES_ABI_MAJOR_VERSION		2
-#define LTTNG_MODULES_ABI_MINOR_VERSION		3
+#define LTTNG_MODULES_ABI_MINOR_VERSION		9
 
 #define LTTNG_KERNEL_SYM_NAME_LEN	256
 
@@ -41,6 +41,8 @@ enum lttng_kernel_instrumentation {
 	LTTNG_KERNEL_KRETPROBE	= 3,
 	LTTNG_KERNEL_NOOP	= 4,	/* not hooked */
 	LTTNG_KERNEL_SYSCALL	= 5,
+	LTTNG_KERNEL_PERF_SAMPLE	= 6,
+	LTTNG_KERNEL_UPROBE	= 7,
 };
 
 /*
@@ -49,11 +51,163 @@ enum lttng_kernel_instrumentation {
 enum lttng_kernel_output {
 	LTTNG_KERNEL_SPLICE	= 0,
 	LTTNG_KERNEL_MMAP	= 1,
+	LTTNG_KERNEL_MAP	= 2,	/* aggregation map */
 };
 
+/*
+ * Aggregation map channels (output LTTNG_KERNEL_MAP) fold events into
+ * per-CPU tables keyed by event id and by a context field. The map is
+ * read through the fd returned by LTTNG_KERNEL_STREAM on the channel.
+ */
+enum lttng_kernel_map_key {
+	LTTNG_KERNEL_MAP_KEY_NONE	= 0,
+	LTTNG_KERNEL_MAP_KEY_TID	= 1,
+	LTTNG_KERNEL_MAP_KEY_CPU	= 2,
+	LTTNG_KERNEL_MAP_KEY_FLOW	= 3,	/* flow hash of net/skb events */
+	LTTNG_KERNEL_MAP_KEY_CALL_SITE	= 4,	/* call site of kmem events */
+	LTTNG_KERNEL_MAP_KEY_DURATION	= 5,	/* what a duration is measured for */
+	LTTNG_KERNEL_MAP_KEY_AGG	= 6,	/* ctf_agg_key() of the events */
+};
+
+enum lttng_kernel_map_value {
+	LTTNG_KERNEL_MAP_VALUE_COUNT		= 0,
+	/* log2 histogram of the time between hits of the same key */
+	LTTNG_KERNEL_MAP_VALUE_LOG2_HIST	= 1,
+	/* count, and total bytes of the flow key of the hits */
+	LTTNG_KERNEL_MAP_VALUE_COUNT_BYTES	= 2,
+	/* count, bytes requested and allocated, allocs and frees */
+	LTTNG_KERNEL_MAP_VALUE_ALLOC		= 3,
+	/* log2 histogram of the durations measured by the hits */
+	LTTNG_KERNEL_MAP_VALUE_LOG2_DURATION	= 4,
+	/* count, and sum of the ctf_agg_value() of the hits */
+	LTTNG_KERNEL_MAP_VALUE_SUM		= 5,
+	/* log2 histogram of the ctf_agg_value() of the hits */
+	LTTNG_KERNEL_MAP_VALUE_LOG2_AGG		= 6,
+};
+
+struct lttng_kernel_map_attr {
+	uint32_t key;		/* enum lttng_kernel_map_key */
+	uint32_t value;		/* enum lttng_kernel_map_value */
+} __attribute__((packed));
+
+/*
+ * Entry read from a map fd. For LOG2_HIST and LOG2_DURATION maps, each
+ * entry is followed by LTTNG_KERNEL_MAP_HIST_BUCKETS uint64_t: bucket i
+ * counts intervals of [2^(i-1), 2^i) ns, the last bucket also counting
+ * longer ones. LOG2_AGG maps bucket values the same way. For
+ * COUNT_BYTES maps, each entry is followed by a uint64_t byte count,
+ * for SUM maps by the uint64_t sum of the values.
+ * For ALLOC maps, each entry is followed by LTTNG_KERNEL_MAP_ALLOC_VALUES
+ * uint64_t: bytes requested, bytes allocated, allocations and frees.
+ * CALL_SITE keys are the low 32 bits of the call site address, which
+ * identify kernel and module text on 64-bit architectures.
+ */
+#define LTTNG_KERNEL_MAP_HIST_BUCKETS	32
+#define LTTNG_KERNEL_MAP_ALLOC_VALUES	4
+struct lttng_kernel_map_entry {
+	uint32_t cpu;
+	uint32_t event_id;
+	uint32_t key;
+	uint32_t padding;
+	uint64_t count;
+} __attribute__((packed));
+
 /*
  * LTTng DebugFS ABI structures.
  */
+/*
+ * LTTNG_KERNEL_CHANNEL_FLAG_UNTIMED: per-CPU channel records carry no
+ * timestamp, and the tracer does not read the clock when reserving
+ * them. Time is only sampled at packet begin and end, readers
+ * interpolating in between; the switch timer bounds the packet
+ * duration, hence the precision.
+ */
+#define LTTNG_KERNEL_CHANNEL_FLAG_UNTIMED	(1U << 0)
+/*
+ * LTTNG_KERNEL_CHANNEL_FLAG_GLOBAL: per-CPU channel backed by a single
+ * buffer shared by all CPUs, exposing a single stream, for low-rate
+ * channels on large systems. Reservation is lock-free across CPUs. Add
+ * the cpu_id context to tell the CPUs apart. Splice output only.
+ */
+#define LTTNG_KERNEL_CHANNEL_FLAG_GLOBAL	(1U << 1)
+/*
+ * LTTNG_KERNEL_CHANNEL_FLAG_LLC: per-CPU channel with one buffer, and
+ * stream, per group of CPUs sharing a last-level cache, identified by
+ * its first CPU. Reservation is lock-free within the group. Add the
+ * cpu_id context to tell the CPUs apart. Splice output only.
+ */
+#define LTTNG_KERNEL_CHANNEL_FLAG_LLC		(1U << 2)
+/*
+ * LTTNG_KERNEL_CHANNEL_FLAG_CRC32C: the packet_crc32c field of the
+ * packet context holds the CRC32C of the packet content following the
+ * packet header, up to content_size, computed when the packet is
+ * delivered. It is 0 in the packets of other channels. Needs a kernel
+ * with CONFIG_LIBCRC32C.
+ */
+#define LTTNG_KERNEL_CHANNEL_FLAG_CRC32C	(1U << 3)
+/*
+ * LTTNG_KERNEL_CHANNEL_FLAG_HOT_IDS: the event ids the compact and dense
+ * event headers encode in their first byte (0 to 30) are reserved for
+ * the events declared hot with LTTNG_KERNEL_HOT_EVENT before their
+ * creation. The other events get ids from 31 on.
+ */
+#define LTTNG_KERNEL_CHANNEL_FLAG_HOT_IDS	(1U << 4)
+/*
+ * LTTNG_KERNEL_CHANNEL_FLAG_WRITER_WAKEUP: readers are woken up by the
+ * writer delivering a sub-buffer, through irq_work, rather than by a
+ * per-CPU read timer. The read timer interval must be 0. Needs a kernel
+ * with CONFIG_IRQ_WORK.
+ */
+#define LTTNG_KERNEL_CHANNEL_FLAG_WRITER_WAKEUP	(1U << 5)
+/*
+ * LTTNG_KERNEL_CHANNEL_FLAG_SNAPSHOT_SWAP: overwrite channel with splice
+ * output whose buffers each have a snapshot pool as large as the buffer,
+ * doubling its memory. RING_BUFFER_SNAPSHOT_SWAP then swaps the
+ * sub-buffers out to the pool instead of having them copied.
+ */
+#define LTTNG_KERNEL_CHANNEL_FLAG_SNAPSHOT_SWAP	(1U << 6)
+/*
+ * LTTNG_KERNEL_CHANNEL_FLAG_LAZY: per-CPU channel with splice output
+ * whose sub-buffers are only populated with pages as the writer is about
+ * to reach them, so buffers of CPUs tracing little pin little memory.
+ * Records reaching a sub-buffer which could not be populated, for lack
+ * of memory or because of the session memory cap, are lost.
+ */
+#define LTTNG_KERNEL_CHANNEL_FLAG_LAZY		(1U << 7)
+/*
+ * LTTNG_KERNEL_CHANNEL_FLAG_TRACKED_SYSCALLS: while all the channels
+ * tracing system calls have this flag and belong to sessions tracking
+ * a subset of PIDs or PID namespaces, only the tasks tracked by one of
+ * these sessions take the system call tracepoints: the others run
+ * their system calls at full speed. The tasks left out are also left
+ * out by other kernel tracers of the sys_enter and sys_exit
+ * tracepoints meanwhile: use on hosts where LTTng is the only one.
+ */
+#define LTTNG_KERNEL_CHANNEL_FLAG_TRACKED_SYSCALLS	(1U << 8)
+/*
+ * LTTNG_KERNEL_CHANNEL_FLAG_NO_RECORD_COUNT: the ring buffers do not
+ * count the records of the channel as they are committed. Its statistics
+ * then report the records recorded by its events as records_count, and
+ * no records_overrun: readers derive the overwritten packets from the
+ * packet sequence numbers, and lost records from events_discarded.
+ */
+#define LTTNG_KERNEL_CHANNEL_FLAG_NO_RECORD_COUNT	(1U << 9)
+
+/*
+ * LTTNG_KERNEL_CHANNEL_FRAGMENT: records of a per-CPU channel whose
+ * payload does not fit in a sub-buffer, up to
+ * LTTNG_KERNEL_FRAGMENT_MAX_SIZE bytes with their event-specific
+ * contexts, are recorded as consecutive lttng_event_fragment records of
+ * the same stream, timestamped when written. Each holds the id of the
+ * fragmented event, the size of its event-specific contexts and
+ * payload, the offset of its slice of them, and the slice. Readers
+ * concatenate the slices of a complete sequence, from offset 0 to size,
+ * and decode them as the event-specific contexts and payload of the
+ * event, aligned as if they started at offset 0. Incomplete sequences
+ * are discarded.
+ */
+#define LTTNG_KERNEL_FRAGMENT_MAX_SIZE		(256U * 1024)
+
 #define LTTNG_KERNEL_CHANNEL_PADDING	LTTNG_KERNEL_SYM_NAME_LEN + 32
 struct lttng_kernel_channel {
 	uint64_t subbuf_size;			/* in bytes */
@@ -62,45 +216,136 @@ struct lttng_kernel_channel {
 	unsigned int read_timer_interval;	/* usecs */
 	enum lttng_kernel_output output;	/* splice, mmap */
 	int overwrite;				/* 1: overwrite, 0: discard */
-	char padding[LTTNG_KERNEL_CHANNEL_PADDING];
+	struct lttng_kernel_map_attr map;	/* LTTNG_KERNEL_MAP only */
+	uint32_t flags;				/* LTTNG_KERNEL_CHANNEL_FLAG_* */
+	char padding[LTTNG_KERNEL_CHANNEL_PADDING
+		- sizeof(struct lttng_kernel_map_attr) - sizeof(uint32_t)];
 } __attribute__((packed));
 
+/*
+ * With LTTNG_KERNEL_KRETPROBE_FLAG_LATENCY, the entry event records
+ * nothing: a single <name>_latency record with the call duration (ns)
+ * is emitted at return, and calls shorter than latency_threshold (ns)
+ * are not recorded.
+ */
+#define LTTNG_KERNEL_KRETPROBE_FLAG_LATENCY	(1U << 0)
+
 struct lttng_kernel_kretprobe {
 	uint64_t addr;
 
 	uint64_t offset;
 	char symbol_name[LTTNG_KERNEL_SYM_NAME_LEN];
+	uint32_t flags;
+	uint64_t latency_threshold;
+} __attribute__((packed));
+
+#define LTTNG_KERNEL_KPROBE_MAX_ARGS		8
+#define LTTNG_KERNEL_KPROBE_ARG_NAME_LEN	32
+#define LTTNG_KERNEL_KPROBE_REG_NAME_LEN	16
+
+enum lttng_kernel_kprobe_fetch {
+	LTTNG_KERNEL_KPROBE_FETCH_REG = 0,	/* Register value */
+	LTTNG_KERNEL_KPROBE_FETCH_STACK = 1,	/* offset-th kernel stack word */
+	LTTNG_KERNEL_KPROBE_FETCH_DEREF = 2,	/* Memory at register + offset */
+};
+
+/*
+ * Kprobe argument, recorded as an integer field named "name", of "size"
+ * bytes (1, 2, 4 or 8). Registers use the names of the architecture
+ * pt_regs accessors, e.g. "di" or "sp" on x86. Memory that cannot be
+ * read is recorded as 0.
+ */
+struct lttng_kernel_kprobe_arg {
+	char name[LTTNG_KERNEL_KPROBE_ARG_NAME_LEN];
+	char reg[LTTNG_KERNEL_KPROBE_REG_NAME_LEN];	/* REG and DEREF */
+	uint32_t fetch;		/* enum lttng_kernel_kprobe_fetch */
+	int64_t offset;		/* STACK: word index, DEREF: byte offset */
+	uint32_t size;
+	uint32_t signedness;	/* 0: unsigned, 1: signed */
+	uint32_t base;		/* 10 or 16 */
+} __attribute__((packed));
+
+struct lttng_kernel_kprobe_args {
+	uint32_t nr_args;
+	struct lttng_kernel_kprobe_arg args[LTTNG_KERNEL_KPROBE_MAX_ARGS];
 } __attribute__((packed));
 
 /*
  * Either addr is used, or symbol_name and offset.
+ * args is a user-space pointer to a struct lttng_kernel_kprobe_args
+ * recorded after the probe address, or 0 to only record the address.
  */
 struct lttng_kernel_kprobe {
 	uint64_t addr;
 
 	uint64_t offset;
 	char symbol_name[LTTNG_KERNEL_SYM_NAME_LEN];
+	uint64_t args;
 } __attribute__((packed));
 
 struct lttng_kernel_function_tracer {
 	char symbol_name[LTTNG_KERNEL_SYM_NAME_LEN];
 } __attribute__((packed));
 
+/*
+ * Sampling event: records the interrupted instruction pointer and task
+ * at each overflow of a per-CPU perf counter of "type" and "config",
+ * every "period" counts, or "period" times per second with
+ * LTTNG_KERNEL_PERF_SAMPLE_FLAG_FREQ. The contexts of the event and of
+ * its channel, such as callstack, are recorded with each sample.
+ */
+/*
+ * Instruction at "offset" in the regular file opened as "fd" by the
+ * caller, instrumented in all the processes mapping it.
+ */
+struct lttng_kernel_uprobe {
+	int32_t fd;
+	uint64_t offset;
+} __attribute__((packed));
+
+#define LTTNG_KERNEL_PERF_SAMPLE_FLAG_FREQ	(1U << 0)
+struct lttng_kernel_perf_sample {
+	uint32_t type;
+	uint64_t config;
+	uint64_t period;
+	uint32_t flags;
+} __attribute__((packed));
+
+/*
+ * Per-event sampling. The mechanisms are evaluated per CPU, before the
+ * event filter runs. A zero-filled structure disables sampling.
+ *
+ * period: record one event out of "period" hits (0 or 1: all).
+ * rate: token bucket refill rate, in events per second (0: no limit).
+ * burst: token bucket depth, in events. Must be non-zero if rate is set.
+ * flow_period: record the hits of one flow out of "flow_period" (0 or
+ *   1: all), chosen by flow hash, hence the same flows for all events
+ *   and CPUs. Only applies to events declaring a flow key, such as the
+ *   net and skb events.
+ */
+struct lttng_kernel_event_sampling {
+	uint32_t period;
+	uint32_t rate;
+	uint32_t burst;
+	uint32_t flow_period;
+} __attribute__((packed));
+
 /*
  * For syscall tracing, name = "*" means "enable all".
  */
-#define LTTNG_KERNEL_EVENT_PADDING1	16
 #define LTTNG_KERNEL_EVENT_PADDING2	LTTNG_KERNEL_SYM_NAME_LEN + 32
 struct lttng_kernel_event {
 	char name[LTTNG_KERNEL_SYM_NAME_LEN];	/* event name */
 	enum lttng_kernel_instrumentation instrumentation;
-	char padding[LTTNG_KERNEL_EVENT_PADDING1];
+	struct lttng_kernel_event_sampling sampling;
 
 	/* Per instrumentation type configuration */
 	union {
 		struct lttng_kernel_kretprobe kretprobe;
 		struct lttng_kernel_kprobe kprobe;
 		struct lttng_kernel_function_tracer ftrace;
+		struct lttng_kernel_perf_sample perf_sample;
+		struct lttng_kernel_uprobe uprobe;
 		char padding[LTTNG_KERNEL_EVENT_PADDING2];
 	} u;
 } __attribute__((packed));
@@ -124,11 +369,481 @@ struct lttng_kernel_calibrate {
 	enum lttng_kernel_calibrate_type type;	/* type (input) */
 } __attribute__((packed));
 
+/*
+ * Cost, in cycles, of calling "iterations" times the function called by
+ * LTTNG_KERNEL_CALIBRATE_KRETPROBE, with whatever instrumentation is
+ * attached to it (kprobe, kretprobe or function events, with their
+ * filters and contexts), on the current CPU. An identical function which
+ * is never instrumented is measured first as baseline. Bucket i of the
+ * histogram counts the calls costing [2^i, 2^(i+1)) cycles, the last
+ * bucket also counting the higher costs.
+ */
+#define LTTNG_KERNEL_CALIBRATE_HIST_BUCKETS	32
+#define LTTNG_KERNEL_CALIBRATE_MAX_ITERATIONS	(1U << 24)
+
+struct lttng_kernel_calibrate_measure {
+	uint32_t iterations;			/* input */
+	uint32_t cpu;				/* output */
+	uint64_t baseline_min;
+	uint64_t baseline_total;
+	uint64_t min;
+	uint64_t max;
+	uint64_t total;
+	uint64_t histogram[LTTNG_KERNEL_CALIBRATE_HIST_BUCKETS];
+} __attribute__((packed));
+
+/*
+ * Clock page, mapped read-only from the file descriptor returned by
+ * LTTNG_KERNEL_CLOCK, describing how user space can read the kernel
+ * trace clock without a system call:
+ *
+ * LTTNG_KERNEL_CLOCK_MONOTONIC: CLOCK_MONOTONIC in ns, from which the
+ *   default kernel clock only differs by the NTP adjustments of the
+ *   last tick.
+ * LTTNG_KERNEL_CLOCK_TSC: the TSC of the CPU plus cpu_offset[cpu],
+ *   read with rdtscp, which returns the CPU number in TSC_AUX. The
+ *   result is identical to the kernel timestamps.
+ * LTTNG_KERNEL_CLOCK_OPAQUE: a plugin clock user space cannot read.
+ *
+ * The page changes when a clock plugin is loaded or unloaded. Readers
+ * retry while "seq" is odd or changes across their reads.
+ */
+enum lttng_kernel_clock_kind {
+	LTTNG_KERNEL_CLOCK_MONOTONIC	= 0,
+	LTTNG_KERNEL_CLOCK_TSC		= 1,
+	LTTNG_KERNEL_CLOCK_OPAQUE	= 2,
+};
+
+struct lttng_kernel_clock_page {
+	uint32_t seq;
+	uint32_t kind;			/* enum lttng_kernel_clock_kind */
+	uint64_t freq;			/* Hz */
+	uint32_t nr_cpus;		/* Entries of cpu_offset */
+	uint32_t padding;
+	int64_t cpu_offset[];
+} __attribute__((packed));
+
 struct lttng_kernel_syscall_mask {
 	uint32_t len;	/* in bits */
 	char mask[];
 } __attribute__((packed));
 
+/*
+ * CPUs recorded by a session: cpu N is bit (N % 8) of byte N / 8. CPUs
+ * from len up are not recorded. A zero len records every CPU.
+ */
+struct lttng_kernel_cpu_mask {
+	uint32_t len;	/* in bits */
+	char mask[];
+} __attribute__((packed));
+
+/*
+ * Event statistics, summed over CPUs. Hits count the calls of an enabled
+ * event in an active session; recorded = hit - pid_rejected -
+ * sampled_out - filtered - reserve_failed. Triggered counts the hits
+ * which ran the action of the event. Of the reserve_failed records,
+ * lost_full were lost because the buffer was full, and lost_big because
+ * they did not fit in a sub-buffer. Missed counts the returns of a
+ * kretprobe return event seen by no hit, for lack of a free kretprobe
+ * instance at function entry.
+ */
+#define LTTNG_KERNEL_EVENT_STATS_PADDING	8
+struct lttng_kernel_event_stats {
+	uint64_t hit;
+	uint64_t recorded;
+	uint64_t pid_rejected;
+	uint64_t sampled_out;
+	uint64_t filtered;
+	uint64_t reserve_failed;
+	uint64_t triggered;
+	uint64_t lost_full;
+	uint64_t lost_big;
+	uint64_t missed;
+	char padding[LTTNG_KERNEL_EVENT_STATS_PADDING - sizeof(uint64_t)];
+} __attribute__((packed));
+
+/*
+ * Action run, in addition to recording, when a hit passes the filters
+ * of an event. SUMMARY replaces recording: hits are counted per CPU and
+ * per summary key of the event (e.g. location and protocol for
+ * skb_kfree, 0 for events without one), and summarized by one
+ * lttng_event_summary record per key at each switch timer period.
+ * It requires a per-CPU channel with a switch timer.
+ */
+enum lttng_kernel_event_action_type {
+	LTTNG_KERNEL_EVENT_ACTION_RECORD	= 0,	/* Record only */
+	LTTNG_KERNEL_EVENT_ACTION_COUNT		= 1,	/* Count in "triggered" */
+	LTTNG_KERNEL_EVENT_ACTION_STOP_SESSION	= 2,	/* Count, stop the session */
+	LTTNG_KERNEL_EVENT_ACTION_NOTIFY	= 3,	/* Count, notify */
+	LTTNG_KERNEL_EVENT_ACTION_SUMMARY	= 4,	/* Count, summarize */
+};
+
+/*
+ * The token is copied in the notifications of the NOTIFY action, to
+ * tell the events apart.
+ */
+#define LTTNG_KERNEL_EVENT_ACTION_PADDING	24
+struct lttng_kernel_event_action {
+	uint32_t action;	/* enum lttng_kernel_event_action_type */
+	uint64_t token;
+	char padding[LTTNG_KERNEL_EVENT_ACTION_PADDING];
+} __attribute__((packed));
+
+/*
+ * Record read from the session notification file descriptor, for each
+ * hit of an event with the NOTIFY action. The timestamp is read from
+ * the trace clock.
+ */
+struct lttng_kernel_notification {
+	uint64_t token;
+	uint64_t timestamp;
+	uint32_t cpu;
+	int32_t tid;
+} __attribute__((packed));
+
+/*
+ * Size of the session notification buffer. Notifications not fitting
+ * in the buffer are discarded, and counted in "lost".
+ */
+#define LTTNG_KERNEL_NOTIFICATION_CHANNEL_PADDING	32
+struct lttng_kernel_notification_channel {
+	uint64_t subbuf_size;
+	uint64_t num_subbuf;
+	char padding[LTTNG_KERNEL_NOTIFICATION_CHANNEL_PADDING];
+} __attribute__((packed));
+
+#define LTTNG_KERNEL_NOTIFICATION_STATS_PADDING	32
+struct lttng_kernel_notification_stats {
+	uint64_t produced;
+	uint64_t lost;
+	char padding[LTTNG_KERNEL_NOTIFICATION_STATS_PADDING];
+} __attribute__((packed));
+
+/*
+ * Channel statistics: sum of the statistics of its events, and record
+ * counters of its ring buffers.
+ */
+#define LTTNG_KERNEL_CHANNEL_STATS_PADDING	24
+struct lttng_kernel_channel_stats {
+	struct lttng_kernel_event_stats events;
+	uint64_t records_count;
+	uint64_t records_overrun;
+	uint64_t records_lost_full;
+	uint64_t records_lost_wrap;
+	uint64_t records_lost_big;
+	uint64_t records_lost_pending;	/* Buffer of the CPU being created */
+	uint64_t autotune_subbuf_size;	/* Tuned geometry, 0: not tuned */
+	uint64_t autotune_num_subbuf;
+	char padding[LTTNG_KERNEL_CHANNEL_STATS_PADDING - 2 * sizeof(uint64_t)];
+} __attribute__((packed));
+
+/*
+ * Kernel memory pinned by a session, all channels included. "buffer_bytes"
+ * counts the populated pages of the ring buffers, "filter_bytes" the
+ * filter bytecodes and their runtimes.
+ */
+#define LTTNG_KERNEL_SESSION_MEMORY_USAGE_PADDING	32
+struct lttng_kernel_session_memory_usage {
+	uint64_t buffer_bytes;
+	uint64_t metadata_cache_bytes;
+	uint64_t event_bytes;
+	uint64_t enabler_bytes;
+	uint64_t filter_bytes;
+	uint64_t pid_tracker_bytes;	/* PID and PID namespace trackers */
+	uint32_t nr_channels;
+	uint32_t nr_events;
+	uint32_t nr_enablers;
+	char padding[LTTNG_KERNEL_SESSION_MEMORY_USAGE_PADDING];
+} __attribute__((packed));
+
+/*
+ * Buffer memory of a channel, per CPU. "nr_cpus" is the length of the
+ * "cpu_bytes" array on input, set to the number of CPU ids on output,
+ * or 0 for a global channel. CPUs without buffer report 0 bytes.
+ */
+#define LTTNG_KERNEL_CHANNEL_MEMORY_USAGE_PADDING	16
+struct lttng_kernel_channel_memory_usage {
+	uint64_t buffer_bytes;
+	uint32_t nr_cpus;
+	char padding[LTTNG_KERNEL_CHANNEL_MEMORY_USAGE_PADDING];
+	uint64_t cpu_bytes[];
+} __attribute__((packed));
+
+/*
+ * Compact binary encoding of the session metadata, alternative to the
+ * TSDL text for viewers. "len" is the size of "data" on input, set to
+ * the size of the encoding on output. The encoding is only complete if
+ * it fits, else -ENOSPC is returned.
+ *
+ * Numbers are LEB128 varints, signed LEB128 for "s" ones. Strings are
+ * a varint length followed by the characters, without NUL. Layout:
+ *
+ *   "LTMB" major(u8) minor(u8) byte_order(u8) pad(u8) uuid(16 bytes)
+ *   clock_freq clock_offset(s)
+ *   nr_packet_ctx field*
+ *   nr_streams { id channel_type header_type(u8, LTTNG_KERNEL_MDB_HEADER_*)
+ *     header_align nr_header field* nr_ctx field* }*
+ *   nr_events { id stream_id name nr_ctx field* nr_fields field* }*
+ *
+ * The packet context and the event headers are those of the TSDL. Their
+ * integer fields named "timestamp", "timestamp_begin" and "timestamp_end"
+ * are clock values. Map channels have no stream: neither they nor their
+ * events are encoded.
+ *
+ *   field: name flags(u8, LTTNG_KERNEL_MDB_FIELD_*) type
+ *   type: atype(u8, enum lttng_kernel_mdb_type), then for
+ *     INTEGER: size align flags(u8, LTTNG_KERNEL_MDB_INT_*) base
+ *       encoding(u8)
+ *     ENUM: name INTEGER-type nr_entries
+ *       { flags(u8, LTTNG_KERNEL_MDB_ENUM_*) start end label }*
+ *       (start and end are signed when flagged so)
+ *     STRING: encoding(u8)
+ *     ARRAY: elem-type length elem_alignment
+ *     SEQUENCE: length-type elem-type elem_alignment
+ *     STRUCT: nr_fields field*
+ *     ARRAY_COMPOUND: elem-type length
+ *     SEQUENCE_COMPOUND: elem-type length_name
+ *     VARIANT: tag_name nr_choices field*
+ *
+ * Sizes and alignments are in bits, as in TSDL.
+ */
+#define LTTNG_KERNEL_MDB_MAGIC			"LTMB"
+#define LTTNG_KERNEL_MDB_MAJOR			2
+#define LTTNG_KERNEL_MDB_MINOR			1
+
+enum lttng_kernel_mdb_type {
+	LTTNG_KERNEL_MDB_TYPE_INTEGER		= 0,
+	LTTNG_KERNEL_MDB_TYPE_ENUM		= 1,
+	LTTNG_KERNEL_MDB_TYPE_STRING		= 2,
+	LTTNG_KERNEL_MDB_TYPE_ARRAY		= 3,
+	LTTNG_KERNEL_MDB_TYPE_SEQUENCE		= 4,
+	LTTNG_KERNEL_MDB_TYPE_STRUCT		= 5,
+	LTTNG_KERNEL_MDB_TYPE_ARRAY_COMPOUND	= 6,
+	LTTNG_KERNEL_MDB_TYPE_SEQUENCE_COMPOUND	= 7,
+	LTTNG_KERNEL_MDB_TYPE_VARIANT		= 8,
+};
+
+enum lttng_kernel_mdb_header {
+	LTTNG_KERNEL_MDB_HEADER_COMPACT		= 1,
+	LTTNG_KERNEL_MDB_HEADER_LARGE		= 2,
+	LTTNG_KERNEL_MDB_HEADER_DENSE		= 3,
+	LTTNG_KERNEL_MDB_HEADER_UNTIMED		= 4,
+};
+
+#define LTTNG_KERNEL_MDB_FIELD_DICT		(1U << 0)	/* 64-bit dictionary id */
+#define LTTNG_KERNEL_MDB_FIELD_PACKET_SCOPED	(1U << 1)
+#define LTTNG_KERNEL_MDB_FIELD_DELTA		(1U << 2)	/* Tag and delta, minor 1 */
+
+#define LTTNG_KERNEL_MDB_INT_SIGNED		(1U << 0)
+#define LTTNG_KERNEL_MDB_INT_REVERSE_BYTE_ORDER	(1U << 1)
+
+#define LTTNG_KERNEL_MDB_ENUM_START_SIGNED	(1U << 0)
+#define LTTNG_KERNEL_MDB_ENUM_END_SIGNED	(1U << 1)
+#define LTTNG_KERNEL_MDB_ENUM_AUTO		(1U << 2)
+
+#define LTTNG_KERNEL_SESSION_METADATA_BINARY_PADDING	16
+struct lttng_kernel_session_metadata_binary {
+	uint64_t len;
+	char padding[LTTNG_KERNEL_SESSION_METADATA_BINARY_PADDING];
+	char data[];
+} __attribute__((packed));
+
+#define LTTNG_KERNEL_CHANNEL_RESIZE_PADDING	32
+struct lttng_kernel_channel_resize {
+	uint64_t subbuf_size;		/* in bytes, power of 2 */
+	uint64_t num_subbuf;		/* power of 2 */
+	char padding[LTTNG_KERNEL_CHANNEL_RESIZE_PADDING];
+} __attribute__((packed));
+
+/*
+ * Sub-buffer geometry tuning of a per-cpu channel in discard mode, checked
+ * every period_ms from the highest reader lag seen by the buffer timers
+ * and the records lost because a buffer was full. The buffer size per
+ * CPU is doubled when records were lost or the lag went past 3/4 of it,
+ * and halved when the lag stayed under 1/4 of it for 8 periods, within
+ * min_bytes and max_bytes. The tuned geometry is reported in the channel
+ * stats; APPLY also resizes the channel to it.
+ */
+enum lttng_kernel_channel_autotune_mode {
+	LTTNG_KERNEL_CHANNEL_AUTOTUNE_OFF	= 0,
+	LTTNG_KERNEL_CHANNEL_AUTOTUNE_RECOMMEND	= 1,
+	LTTNG_KERNEL_CHANNEL_AUTOTUNE_APPLY	= 2,
+};
+
+#define LTTNG_KERNEL_CHANNEL_AUTOTUNE_PADDING	32
+struct lttng_kernel_channel_autotune {
+	uint32_t mode;		/* enum lttng_kernel_channel_autotune_mode */
+	uint32_t period_ms;
+	uint64_t min_bytes;	/* per CPU, power of 2 */
+	uint64_t max_bytes;	/* per CPU, power of 2 */
+	char padding[LTTNG_KERNEL_CHANNEL_AUTOTUNE_PADDING];
+} __attribute__((packed));
+
+/* Statedump categories, 0 selecting LTTNG_KERNEL_STATEDUMP_ALL. */
+#define LTTNG_KERNEL_STATEDUMP_PROCESS		(1U << 0)	/* process, ns */
+#define LTTNG_KERNEL_STATEDUMP_FD		(1U << 1)
+#define LTTNG_KERNEL_STATEDUMP_INTERRUPT	(1U << 2)
+#define LTTNG_KERNEL_STATEDUMP_NETWORK		(1U << 3)
+#define LTTNG_KERNEL_STATEDUMP_BLOCK_DEVICE	(1U << 4)
+#define LTTNG_KERNEL_STATEDUMP_ALL		((1U << 5) - 1)
+/*
+ * File-backed mappings of the processes whose mmap_sem is not contended,
+ * once per mm. Only dumped on request.
+ */
+#define LTTNG_KERNEL_STATEDUMP_VM_MAP		(1U << 5)
+/*
+ * Loaded modules and kernel symbol table, kept in sync by module load and
+ * unload events from then on, so raw addresses can be resolved offline.
+ * The symbols are only dumped by the first request of the session.
+ */
+#define LTTNG_KERNEL_STATEDUMP_SYMBOL		(1U << 6)
+/*
+ * Tables otherwise reconstructed from events recorded all along, only
+ * dumped on request: loaded modules without their symbols, softirq
+ * vectors, swap areas, and on x86 the interrupt descriptor table. They
+ * require a kernel with CONFIG_KALLSYMS_ALL, except the latter.
+ */
+#define LTTNG_KERNEL_STATEDUMP_MODULE		(1U << 7)
+#define LTTNG_KERNEL_STATEDUMP_SOFTIRQ		(1U << 8)
+#define LTTNG_KERNEL_STATEDUMP_SWAP		(1U << 9)
+#define LTTNG_KERNEL_STATEDUMP_IDT		(1U << 10)
+#define LTTNG_KERNEL_STATEDUMP_CATEGORIES	((1U << 11) - 1)
+
+/*
+ * Delta statedump: only processes and file descriptors which changed
+ * after generation "since" are dumped, 0 requesting a full statedump.
+ * The first request must be a full one. "generation" is returned.
+ */
+/*
+ * With LTTNG_KERNEL_STATEDUMP_FLAG_FD_INODE, file descriptors whose path
+ * was already dumped by the session, with its inode and device, are
+ * only dumped with their inode and device.
+ */
+#define LTTNG_KERNEL_STATEDUMP_FLAG_FD_INODE	(1U << 0)
+#define LTTNG_KERNEL_STATEDUMP_FLAGS		((1U << 1) - 1)
+
+#define LTTNG_KERNEL_STATEDUMP_DELTA_PADDING	24
+struct lttng_kernel_statedump_delta {
+	uint64_t since;		/* input */
+	uint64_t generation;	/* output */
+	uint32_t categories;	/* input, LTTNG_KERNEL_STATEDUMP_* mask */
+	uint32_t flags;		/* input, LTTNG_KERNEL_STATEDUMP_FLAG_* */
+	char padding[LTTNG_KERNEL_STATEDUMP_DELTA_PADDING];
+} __attribute__((packed));
+
+/*
+ * Tracer CPU budget of a session. Every "period_ms", the cost of the
+ * session events is estimated as the number of hits which went past
+ * the PID trackers and sampling, times "event_cost_ns", as measured by
+ * LTTNG_KERNEL_CALIBRATE_MEASURE. While it exceeds "cpu_permille" of
+ * the online CPUs time, the sampling period of the noisiest event is
+ * raised, and the event is disabled once it reaches
+ * LTTNG_KERNEL_CPU_BUDGET_MAX_PERIOD. Each action is recorded by a
+ * lttng_cpu_budget_throttle event in the channel of the throttled
+ * event. A zero "cpu_permille" turns the budget off; throttled events
+ * stay so for the rest of the session.
+ */
+#define LTTNG_KERNEL_CPU_BUDGET_MAX_PERIOD	4096
+#define LTTNG_KERNEL_SESSION_CPU_BUDGET_PADDING	32
+struct lttng_kernel_session_cpu_budget {
+	uint32_t cpu_permille;
+	uint32_t period_ms;
+	uint64_t event_cost_ns;
+	char padding[LTTNG_KERNEL_SESSION_CPU_BUDGET_PADDING];
+} __attribute__((packed));
+
+/*
+ * Bounds the pages of the buffers of the session channels created
+ * afterwards, shared by all of them. Channels allocate their whole
+ * buffers at creation, which fails beyond the cap, except those with
+ * LTTNG_KERNEL_CHANNEL_FLAG_LAZY, which draw their sub-buffers from the
+ * cap as they fill. A zero "max_bytes" removes the cap.
+ */
+#define LTTNG_KERNEL_SESSION_MEMORY_CAP_PADDING	32
+struct lttng_kernel_session_memory_cap {
+	uint64_t max_bytes;
+	char padding[LTTNG_KERNEL_SESSION_MEMORY_CAP_PADDING];
+} __attribute__((packed));
+
+/*
+ * Rotation position of a stream, taken by the last
+ * LTTNG_KERNEL_SESSION_ROTATE. Packets of sequence number below
+ * "seq_num" belong to the chunk closed by rotation "rotation_id", the
+ * following ones to the next chunk. "consumed" is the consumed position
+ * of the stream when the rotation was taken. A zero "rotation_id" means
+ * the stream has no rotation position yet.
+ */
+#define LTTNG_KERNEL_ROTATE_POSITION_PADDING	32
+struct lttng_kernel_rotate_position {
+	uint64_t rotation_id;
+	uint64_t seq_num;
+	uint64_t consumed;
+	char padding[LTTNG_KERNEL_ROTATE_POSITION_PADDING];
+} __attribute__((packed));
+
+/*
+ * Index entry of a packet of a stream, as found in its packet header.
+ * Sizes are in bits.
+ */
+#define LTTNG_KERNEL_PACKET_INDEX_PADDING	16
+struct lttng_kernel_packet_index {
+	uint64_t timestamp_begin;
+	uint64_t timestamp_end;
+	uint64_t content_size;
+	uint64_t packet_size;
+	uint64_t events_discarded;
+	uint64_t stream_id;
+	uint64_t stream_instance_id;
+	uint64_t seq_num;
+	char padding[LTTNG_KERNEL_PACKET_INDEX_PADDING];
+} __attribute__((packed));
+
+/*
+ * Reads the index entries of up to "count" consecutive packets of a
+ * stream, starting at sequence number "seq_num". Only delivered packets
+ * still held by the buffer have an entry, so reading stops at the first
+ * packet not delivered yet or overwritten: on return, "count" is the
+ * number of entries read.
+ */
+#define LTTNG_KERNEL_PACKET_INDEX_BATCH_PADDING	32
+struct lttng_kernel_packet_index_batch {
+	uint64_t seq_num;		/* first packet */
+	uint64_t entries;		/* user-space lttng_kernel_packet_index array */
+	uint32_t count;			/* input: array length, output: read */
+	char padding[LTTNG_KERNEL_PACKET_INDEX_BATCH_PADDING];
+} __attribute__((packed));
+
+/*
+ * Opens up to "count" streams of a channel not yet opened in a single
+ * call. "fds" points to an array of "count" int32_t which receives
+ * their file descriptors; on return, "count" is the number of streams
+ * opened.
+ */
+#define LTTNG_KERNEL_HOT_EVENT_PADDING	32
+struct lttng_kernel_hot_event {
+	char name[LTTNG_KERNEL_SYM_NAME_LEN];	/* event name or star glob */
+	char padding[LTTNG_KERNEL_HOT_EVENT_PADDING];
+} __attribute__((packed));
+
+#define LTTNG_KERNEL_STREAM_BULK_PADDING	32
+struct lttng_kernel_stream_bulk {
+	uint64_t fds;			/* user-space int32_t array */
+	uint32_t count;			/* input: array length, output: opened */
+	char padding[LTTNG_KERNEL_STREAM_BULK_PADDING];
+} __attribute__((packed));
+
+/*
+ * When enabled, system call entry and exit are paired in the kernel:
+ * a single syscall_latency (or compat_syscall_latency) record is emitted
+ * at exit, and calls shorter than threshold (ns) are not recorded.
+ */
+#define LTTNG_KERNEL_SYSCALL_LATENCY_PADDING	32
+struct lttng_kernel_syscall_latency {
+	uint32_t enabled;
+	uint64_t threshold;
+	char padding[LTTNG_KERNEL_SYSCALL_LATENCY_PADDING];
+} __attribute__((packed));
+
 enum lttng_kernel_context_type {
 	LTTNG_KERNEL_CONTEXT_PID		= 0,
 	LTTNG_KERNEL_CONTEXT_PERF_COUNTER	= 1,
@@ -146,6 +861,10 @@ enum lttng_kernel_context_type {
 	LTTNG_KERNEL_CONTEXT_PREEMPTIBLE	= 13,
 	LTTNG_KERNEL_CONTEXT_NEED_RESCHEDULE	= 14,
 	LTTNG_KERNEL_CONTEXT_MIGRATABLE		= 15,
+	LTTNG_KERNEL_CONTEXT_CGROUP_ID		= 16,
+	LTTNG_KERNEL_CONTEXT_NUMA_NODE		= 17,
+	LTTNG_KERNEL_CONTEXT_CPU_FREQUENCY	= 18,
+	LTTNG_KERNEL_CONTEXT_CALLSTACK		= 19,
 };
 
 struct lttng_kernel_perf_counter_ctx {
@@ -185,6 +904,9 @@ struct lttng_kernel_filter_bytecode {
 #define LTTNG_KERNEL_SYSCALL_LIST		_IO(0xF6, 0x4A)
 #define LTTNG_KERNEL_TRACER_ABI_VERSION		\
 	_IOR(0xF6, 0x4B, struct lttng_kernel_tracer_abi_version)
+#define LTTNG_KERNEL_CALIBRATE_MEASURE		\
+	_IOWR(0xF6, 0x4C, struct lttng_kernel_calibrate_measure)
+#define LTTNG_KERNEL_CLOCK			_IO(0xF6, 0x4D)
 
 /* Session FD ioctl */
 #define LTTNG_KERNEL_METADATA			\
@@ -206,6 +928,37 @@ struct lttng_kernel_filter_bytecode {
 #define LTTNG_KERNEL_SESSION_METADATA_REGEN	_IO(0xF6, 0x59)
 /* 0x5A and 0x5B are reserved for a future ABI-breaking cleanup. */
 #define LTTNG_KERNEL_SESSION_STATEDUMP		_IO(0xF6, 0x5C)
+/*
+ * PID namespaces are identified by their unsigned inode number.
+ * LTTNG_KERNEL_PID_NS_ALL, never allocated to a namespace, stands for
+ * "all namespaces".
+ */
+#define LTTNG_KERNEL_PID_NS_ALL			((uint32_t) -1)
+#define LTTNG_KERNEL_SESSION_TRACK_PID_NS	\
+	_IOR(0xF6, 0x5D, uint32_t)
+#define LTTNG_KERNEL_SESSION_UNTRACK_PID_NS	\
+	_IOR(0xF6, 0x5E, uint32_t)
+#define LTTNG_KERNEL_SESSION_LIST_TRACKER_PID_NS	_IO(0xF6, 0x5F)
+#define LTTNG_KERNEL_SESSION_STATEDUMP_DELTA	\
+	_IOWR(0xF6, 0x60, struct lttng_kernel_statedump_delta)
+/* 0x61 is used by LTTNG_KERNEL_OLD_EVENT. */
+#define LTTNG_KERNEL_SESSION_CPU_BUDGET		\
+	_IOW(0xF6, 0x69, struct lttng_kernel_session_cpu_budget)
+#define LTTNG_KERNEL_SESSION_NOTIFICATION	\
+	_IOW(0xF6, 0x6C, struct lttng_kernel_notification_channel)
+#define LTTNG_KERNEL_SESSION_ROTATE		_IOR(0xF6, 0x6D, uint64_t)
+#define LTTNG_KERNEL_SESSION_BATCH_BEGIN	_IO(0xF6, 0x6E)
+#define LTTNG_KERNEL_SESSION_BATCH_COMMIT	_IO(0xF6, 0x6F)
+#define LTTNG_KERNEL_SESSION_CPU_MASK		\
+	_IOW(0xF6, 0x73, struct lttng_kernel_cpu_mask)
+#define LTTNG_KERNEL_SESSION_MEMORY_CAP		\
+	_IOW(0xF6, 0x74, struct lttng_kernel_session_memory_cap)
+#define LTTNG_KERNEL_SESSION_MEMORY_USAGE	\
+	_IOR(0xF6, 0x75, struct lttng_kernel_session_memory_usage)
+#define LTTNG_KERNEL_SESSION_METADATA_BINARY	\
+	_IOWR(0xF6, 0x77, struct lttng_kernel_session_metadata_binary)
+/* Returns a file descriptor readable once the statedump is done. */
+#define LTTNG_KERNEL_SESSION_START_ASYNC	_IO(0xF6, 0x7B)
 
 /* Channel FD ioctl */
 #define LTTNG_KERNEL_STREAM			_IO(0xF6, 0x62)
@@ -213,6 +966,26 @@ struct lttng_kernel_filter_bytecode {
 	_IOW(0xF6, 0x63, struct lttng_kernel_event)
 #define LTTNG_KERNEL_SYSCALL_MASK		\
 	_IOWR(0xF6, 0x64, struct lttng_kernel_syscall_mask)
+#define LTTNG_KERNEL_SYSCALL_LATENCY		\
+	_IOW(0xF6, 0x65, struct lttng_kernel_syscall_latency)
+#define LTTNG_KERNEL_CONTEXT_PACKET_SCOPED	\
+	_IOW(0xF6, 0x66, struct lttng_kernel_context)
+#define LTTNG_KERNEL_TASK_MARKER		_IOR(0xF6, 0x67, int32_t)
+#define LTTNG_KERNEL_CHANNEL_STATS		\
+	_IOR(0xF6, 0x68, struct lttng_kernel_channel_stats)
+#define LTTNG_KERNEL_CHANNEL_RESIZE		\
+	_IOW(0xF6, 0x6A, struct lttng_kernel_channel_resize)
+#define LTTNG_KERNEL_STRING_DICT		_IO(0xF6, 0x6B)
+#define LTTNG_KERNEL_STREAM_BULK		\
+	_IOWR(0xF6, 0x70, struct lttng_kernel_stream_bulk)
+#define LTTNG_KERNEL_HOT_EVENT			\
+	_IOW(0xF6, 0x72, struct lttng_kernel_hot_event)
+#define LTTNG_KERNEL_CHANNEL_MEMORY_USAGE	\
+	_IOWR(0xF6, 0x76, struct lttng_kernel_channel_memory_usage)
+#define LTTNG_KERNEL_CHANNEL_FRAGMENT		_IO(0xF6, 0x78)
+#define LTTNG_KERNEL_CHANNEL_DELTA		_IO(0xF6, 0x79)
+#define LTTNG_KERNEL_CHANNEL_AUTOTUNE		\
+	_IOW(0xF6, 0x7A, struct lttng_kernel_channel_autotune)
 
 /* Event and Channel FD ioctl */
 #define LTTNG_KERNEL_CONTEXT			\
@@ -224,6 +997,14 @@ struct lttng_kernel_filter_bytecode {
 
 /* Event FD ioctl */
 #define LTTNG_KERNEL_FILTER			_IO(0xF6, 0x90)
+#define LTTNG_KERNEL_EVENT_STATS		\
+	_IOR(0xF6, 0x91, struct lttng_kernel_event_stats)
+#define LTTNG_KERNEL_EVENT_ACTION		\
+	_IOW(0xF6, 0x92, struct lttng_kernel_event_action)
+
+/* Notification FD ioctl */
+#define LTTNG_KERNEL_NOTIFICATION_STATS		\
+	_IOR(0xF6, 0xA0, struct lttng_kernel_notification_stats)
 
 /* LTTng-specific ioctls for the lib ringbuffer */
 /* returns the timestamp begin of the current sub-buffer */
@@ -244,6 +1025,17 @@ struct lttng_kernel_filter_bytecode {
 #define LTTNG_RING_BUFFER_GET_SEQ_NUM		_IOR(0xF6, 0x27, uint64_t)
 /* returns the stream instance id */
 #define LTTNG_RING_BUFFER_INSTANCE_ID		_IOR(0xF6, 0x28, uint64_t)
+/* returns the rotation position of the stream */
+#define LTTNG_RING_BUFFER_GET_ROTATE_POSITION	\
+	_IOR(0xF6, 0x29, struct lttng_kernel_rotate_position)
+/* returns the index entries of a range of packets of the stream */
+#define LTTNG_RING_BUFFER_GET_PACKET_INDEX	\
+	_IOWR(0xF6, 0x2A, struct lttng_kernel_packet_index_batch)
+/*
+ * opens an additional reader of the stream, with its own read position,
+ * and returns its file descriptor. Discard mode channels only.
+ */
+#define LTTNG_RING_BUFFER_OPEN_READER		_IO(0xF6, 0x2B)
 
 #ifdef CONFIG_COMPAT
 /* returns the timestamp begin of the current sub-buffer */
@@ -273,6 +1065,14 @@ struct lttng_kernel_filter_bytecode {
 /* returns the stream instance id */
 #define LTTNG_RING_BUFFER_COMPAT_INSTANCE_ID	\
 	LTTNG_RING_BUFFER_INSTANCE_ID
+/* returns the rotation position of the stream */
+#define LTTNG_RING_BUFFER_COMPAT_GET_ROTATE_POSITION	\
+	LTTNG_RING_BUFFER_GET_ROTATE_POSITION
+/* returns the index entries of a range of packets of the stream */
+#define LTTNG_RING_BUFFER_COMPAT_GET_PACKET_INDEX	\
+	LTTNG_RING_BUFFER_GET_PACKET_INDEX
+/* opens an additional reader of the stream */
+#define LTTNG_RING_BUFFER_COMPAT_OPEN_READER	LTTNG_RING_BUFFER_OPEN_READER
 #endif /* CONFIG_COMPAT */
 
 #endif /* _LTTNG_ABI_H */
@@ -20,15 +20,31 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/preempt.h>
+#include <linux/sched.h>
+#include <linux/smp.h>
+#include <linux/timex.h>
 #include <lttng-abi.h>
 #include <lttng-events.h>
 
+/* Number of calls between rescheduling points. */
+#define CALIBRATE_BATCH		1024
+
 noinline
 void lttng_calibrate_kretprobe(void)
 {
 	asm volatile ("");
 }
 
+/* Same as above, never instrumented. */
+noinline
+void lttng_calibrate_baseline(void)
+{
+	asm volatile ("");
+}
+
 int lttng_calibrate(struct lttng_kernel_calibrate *calibrate)
 {
 	switch (calibrate->type) {
@@ -40,3 +56,60 @@ int lttng_calibrate(struct lttng_kernel_calibrate *calibrate)
 	}
 	return 0;
 }
+
+static
+u64 calibrate_call(void (*func)(void))
+{
+	cycles_t start;
+
+	start = get_cycles();
+	func();
+	return get_cycles() - start;
+}
+
+/*
+ * Preemption is disabled by batches, so that all the calls of a batch run
+ * on the same CPU. Migrations between batches are reported as -EAGAIN,
+ * since the histogram would mix CPUs.
+ */
+int lttng_calibrate_measure(struct lttng_kernel_calibrate_measure *measure)
+{
+	unsigned int i, cpu = 0;
+	u64 cost;
+
+	if (!measure->iterations
+			|| measure->iterations > LTTNG_KERNEL_CALIBRATE_MAX_ITERATIONS)
+		return -EINVAL;
+	measure->baseline_min = measure->min = ~0ULL;
+	for (i = 0; i < measure->iterations; i++) {
+		unsigned int bucket;
+
+		if (!(i % CALIBRATE_BATCH)) {
+			if (i) {
+				preempt_enable();
+				cond_resched();
+			}
+			preempt_disable();
+			if (!i)
+				cpu = smp_processor_id();
+			if (cpu != smp_processor_id()) {
+				preempt_enable();
+				return -EAGAIN;
+			}
+		}
+		cost = calibrate_call(lttng_calibrate_baseline);
+		measure->baseline_min = min(measure->baseline_min, cost);
+		measure->baseline_total += cost;
+		cost = calibrate_call(lttng_calibrate_kretprobe);
+		measure->min = min(measure->min, cost);
+		measure->max = max(measure->max, cost);
+		measure->total += cost;
+		bucket = cost ? ilog2(cost) : 0;
+		if (bucket >= LTTNG_KERNEL_CALIBRATE_HIST_BUCKETS)
+			bucket = LTTNG_KERNEL_CALIBRATE_HIST_BUCKETS - 1;
+		measure->histogram[bucket]++;
+	}
+	preempt_enable();
+	measure->cpu = cpu;
+	return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * lttng-clock-tsc.c
+ *
+ * LTTng invariant TSC trace clock plugin.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Loading this module while no session holds the trace clock makes the
+ * TSC the trace clock. Timestamps are raw cycle counts, the frequency
+ * being described in the trace metadata, so a clock read is a single
+ * rdtsc and a per-CPU offset load. It is NMI-safe and monotonic per
+ * CPU. The module refuses to load unless the TSC is invariant (constant
+ * rate, running in deep C-states) and the kernel did not mark it
+ * unstable.
+ *
+ * The kernel synchronizes the TSC of the CPUs at boot when it can; a
+ * per-CPU offset corrects whatever skew remains, relative to the boot
+ * CPU, as measured against the kernel monotonic clock at load time.
+ * CPUs brought online later use a zero offset.
+ */
+
+#include <linux/module.h>
+#include <linux/version.h>
+#include <linux/ktime.h>
+#include <linux/smp.h>
+#include <linux/percpu.h>
+#include <linux/cpumask.h>
+#include <linux/irqflags.h>
+#include <linux/timex.h>
+#include <linux/math64.h>
+#include <asm/tsc.h>
+#include <asm/cpufeature.h>
+
+#include <lttng-clock.h>
+#include <lttng-tracer.h>
+
+#define TSC_CALIBRATE_LOOPS	64
+
+static DEFINE_PER_CPU(s64, lttng_tsc_offset);
+
+struct tsc_sample {
+	u64 mono_ns;		/* Kernel monotonic clock, in ns */
+	u64 tsc;		/* TSC read at mono_ns */
+	u64 window;		/* Uncertainty of the pair, in cycles */
+};
+
+static
+u64 tsc_mono_ns(void)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,17,0))
+	return ktime_get_mono_fast_ns();
+#else
+	return ktime_to_ns(ktime_get());
+#endif
+}
+
+/*
+ * Keep the pair with the narrowest TSC window around the monotonic
+ * clock read, which is the least disturbed by interrupts and cache
+ * misses.
+ */
+static
+void tsc_sample_cpu(void *info)
+{
+	struct tsc_sample *sample = info;
+	unsigned long flags;
+	int i;
+
+	sample->window = ~0ULL;
+	local_irq_save(flags);
+	for (i = 0; i < TSC_CALIBRATE_LOOPS; i++) {
+		u64 begin, end, mono_ns;
+
+		begin = get_cycles();
+		mono_ns = tsc_mono_ns();
+		end = get_cycles();
+		if (end - begin < sample->window) {
+			sample->window = end - begin;
+			sample->mono_ns = mono_ns;
+			sample->tsc = begin + ((end - begin) >> 1);
+		}
+	}
+	local_irq_restore(flags);
+}
+
+/*
+ * The TSC expected on each CPU is extrapolated from the boot CPU sample
+ * with the TSC frequency. Offsets smaller than the measurement window
+ * are noise, and left at zero.
+ */
+static
+void tsc_calibrate_offsets(void)
+{
+	struct tsc_sample ref, sample;
+	int ref_cpu, cpu;
+
+	get_online_cpus();
+	ref_cpu = cpumask_first(cpu_online_mask);
+	smp_call_function_single(ref_cpu, tsc_sample_cpu, &ref, 1);
+	for_each_online_cpu(cpu) {
+		u64 expected;
+		s64 offset;
+
+		if (cpu == ref_cpu)
+			continue;
+		smp_call_function_single(cpu, tsc_sample_cpu, &sample, 1);
+		expected = ref.tsc + div_u64((sample.mono_ns - ref.mono_ns)
+				* tsc_khz, USEC_PER_SEC);
+		offset = (s64) (expected - sample.tsc);
+		if (abs(offset) > sample.window + ref.window)
+			per_cpu(lttng_tsc_offset, cpu) = offset;
+	}
+	put_online_cpus();
+}
+
+/*
+ * May be called with preemption enabled: the TSC read and the offset
+ * load need to happen on the same CPU.
+ */
+static
+u64 trace_clock_read64_tsc(void)
+{
+	u64 now;
+
+	preempt_disable_notrace();
+	now = get_cycles() + __this_cpu_read(lttng_tsc_offset);
+	preempt_enable_notrace();
+	return now;
+}
+
+static
+void trace_clock_user_page_tsc(struct lttng_kernel_clock_page *page)
+{
+	int cpu;
+
+	page->kind = LTTNG_KERNEL_CLOCK_TSC;
+	for_each_possible_cpu(cpu) {
+		if (cpu < page->nr_cpus)
+			page->cpu_offset[cpu] = per_cpu(lttng_tsc_offset, cpu);
+	}
+}
+
+static
+u64 trace_clock_freq_tsc(void)
+{
+	return (u64) tsc_khz * 1000;
+}
+
+static
+const char *trace_clock_name_tsc(void)
+{
+	return "tsc";
+}
+
+static
+const char *trace_clock_description_tsc(void)
+{
+	return "Invariant TSC";
+}
+
+/*
+ * The TSC restarts at boot: the default boot id uuid applies. Reading it
+ * takes no lock, so NMIs can be traced.
+ */
+static
+struct lttng_trace_clock ltc = {
+	.read64 = trace_clock_read64_tsc,
+	.freq = trace_clock_freq_tsc,
+	.name = trace_clock_name_tsc,
+	.description = trace_clock_description_tsc,
+	.user_page = trace_clock_user_page_tsc,
+	.nmi_safe = 1,
+};
+
+static
+int __init lttng_clock_tsc_init(void)
+{
+	if (!boot_cpu_has(X86_FEATURE_TSC)
+			|| !boot_cpu_has(X86_FEATURE_CONSTANT_TSC)
+			|| !boot_cpu_has(X86_FEATURE_NONSTOP_TSC)
+			|| check_tsc_unstable() || !tsc_khz) {
+		printk(KERN_WARNING "LTTng: TSC is not invariant, not using it as trace clock.\n");
+		return -ENODEV;
+	}
+	tsc_calibrate_offsets();
+	return lttng_clock_register_plugin(&ltc, THIS_MODULE);
+}
+
+module_init(lttng_clock_tsc_init);
+
+static
+void __exit lttng_clock_tsc_exit(void)
+{
+	lttng_clock_unregister_plugin(&ltc, THIS_MODULE);
+}
+
+module_exit(lttng_clock_tsc_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng invariant TSC trace clock");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
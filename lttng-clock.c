@@ -21,6 +21,8 @@
 #include <linux/module.h>
 #include <linux/kmod.h>
 #include <linux/mutex.h>
+#include <linux/vmalloc.h>
+#include <linux/cpumask.h>
 
 #include <wrapper/trace-clock.h>
 #include <lttng-events.h>
@@ -29,9 +31,77 @@
 struct lttng_trace_clock *lttng_trace_clock;
 EXPORT_SYMBOL_GPL(lttng_trace_clock);
 
+#ifdef LTTNG_TRACE_CLOCK_STATIC_KEY
+DEFINE_STATIC_KEY_FALSE(lttng_trace_clock_plugin);
+EXPORT_SYMBOL_GPL(lttng_trace_clock_plugin);
+#endif
+
 static DEFINE_MUTEX(clock_mutex);
 static struct module *lttng_trace_clock_mod;	/* plugin */
 static int clock_used;				/* refcount */
+static struct lttng_kernel_clock_page *clock_page;
+static size_t clock_page_len;
+
+/*
+ * Describe the current clock in the clock page, as a write seqlock
+ * section for the user space readers.
+ * Called with clock_mutex held.
+ */
+static
+void lttng_clock_page_update(struct lttng_trace_clock *ltc)
+{
+	struct lttng_kernel_clock_page *page = clock_page;
+
+	/* Built-in plugins may register before lttng_clock_init(). */
+	if (!page)
+		return;
+	ACCESS_ONCE(page->seq) = page->seq + 1;
+	smp_wmb();
+	memset(page->cpu_offset, 0, page->nr_cpus * sizeof(int64_t));
+	if (!ltc) {
+		page->kind = LTTNG_KERNEL_CLOCK_MONOTONIC;
+		page->freq = NSEC_PER_SEC;
+	} else {
+		page->kind = LTTNG_KERNEL_CLOCK_OPAQUE;
+		page->freq = ltc->freq();
+		if (ltc->user_page)
+			ltc->user_page(page);
+	}
+	smp_wmb();
+	ACCESS_ONCE(page->seq) = page->seq + 1;
+}
+
+/*
+ * The plugin is published before the static key is enabled, and the key
+ * is disabled before the plugin is cleared.
+ * Called with clock_mutex held.
+ */
+static
+void lttng_clock_set_plugin(struct lttng_trace_clock *ltc)
+{
+	if (ltc) {
+		ACCESS_ONCE(lttng_trace_clock) = ltc;
+#ifdef LTTNG_TRACE_CLOCK_STATIC_KEY
+		static_branch_enable(&lttng_trace_clock_plugin);
+#endif
+	} else {
+#ifdef LTTNG_TRACE_CLOCK_STATIC_KEY
+		static_branch_disable(&lttng_trace_clock_plugin);
+#endif
+		ACCESS_ONCE(lttng_trace_clock) = NULL;
+	}
+	lttng_clock_page_update(ltc);
+}
+
+int lttng_clock_page_mmap(struct vm_area_struct *vma)
+{
+	if (vma->vm_pgoff || vma->vm_end - vma->vm_start > clock_page_len
+			|| (vma->vm_flags & VM_WRITE))
+		return -EINVAL;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return remap_vmalloc_range(vma, clock_page, 0);
+}
+EXPORT_SYMBOL_GPL(lttng_clock_page_mmap);
 
 int lttng_clock_register_plugin(struct lttng_trace_clock *ltc,
 		struct module *mod)
@@ -48,7 +118,7 @@ int lttng_clock_register_plugin(struct lttng_trace_clock *ltc,
 		goto end;
 	}
 	/* set clock */
-	ACCESS_ONCE(lttng_trace_clock) = ltc;
+	lttng_clock_set_plugin(ltc);
 	lttng_trace_clock_mod = mod;
 end:
 	mutex_unlock(&clock_mutex);
@@ -66,7 +136,7 @@ void lttng_clock_unregister_plugin(struct lttng_trace_clock *ltc,
 	}
 	WARN_ON_ONCE(lttng_trace_clock_mod != mod);
 
-	ACCESS_ONCE(lttng_trace_clock) = NULL;
+	lttng_clock_set_plugin(NULL);
 	lttng_trace_clock_mod = NULL;
 end:
 	mutex_unlock(&clock_mutex);
@@ -83,7 +153,7 @@ void lttng_clock_ref(void)
 		ret = try_module_get(lttng_trace_clock_mod);
 		if (!ret) {
 			printk(KERN_ERR "LTTng-clock cannot get clock plugin module\n");
-			ACCESS_ONCE(lttng_trace_clock) = NULL;
+			lttng_clock_set_plugin(NULL);
 			lttng_trace_clock_mod = NULL;
 		}
 	}
@@ -101,6 +171,32 @@ void lttng_clock_unref(void)
 }
 EXPORT_SYMBOL_GPL(lttng_clock_unref);
 
+static
+int __init lttng_clock_init(void)
+{
+	clock_page_len = PAGE_ALIGN(sizeof(*clock_page)
+			+ nr_cpu_ids * sizeof(int64_t));
+	/* Zeroed, as it is mapped to user space. */
+	clock_page = vmalloc_user(clock_page_len);
+	if (!clock_page)
+		return -ENOMEM;
+	clock_page->nr_cpus = nr_cpu_ids;
+	mutex_lock(&clock_mutex);
+	lttng_clock_page_update(lttng_trace_clock);
+	mutex_unlock(&clock_mutex);
+	return 0;
+}
+
+module_init(lttng_clock_init);
+
+static
+void __exit lttng_clock_exit(void)
+{
+	vfree(clock_page);
+}
+
+module_exit(lttng_clock_exit);
+
 MODULE_LICENSE("GPL and additional rights");
 MODULE_AUTHOR("Mathieu Desnoyers <mathieu.desnoyers@efficios.com>");
 MODULE_DESCRIPTION("LTTng Clock");
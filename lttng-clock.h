@@ -22,6 +22,8 @@
  */
 
 #include <linux/module.h>
+#include <linux/mm.h>
+#include <lttng-abi.h>
 
 #define LTTNG_MODULES_UUID_STR_LEN	37
 
@@ -31,11 +33,22 @@ struct lttng_trace_clock {
 	int (*uuid)(char *uuid);
 	const char *(*name)(void);
 	const char *(*description)(void);
+	/*
+	 * Optional: set the kind and CPU offsets of the clock page, for
+	 * clocks user space can read. NULL: LTTNG_KERNEL_CLOCK_OPAQUE.
+	 */
+	void (*user_page)(struct lttng_kernel_clock_page *page);
+	/*
+	 * Set if read64 can be called from NMI context. Otherwise, the
+	 * records of NMIs are dropped.
+	 */
+	int nmi_safe;
 };
 
 int lttng_clock_register_plugin(struct lttng_trace_clock *ltc,
 		struct module *mod);
 void lttng_clock_unregister_plugin(struct lttng_trace_clock *ltc,
 		struct module *mod);
+int lttng_clock_page_mmap(struct vm_area_struct *vma);
 
 #endif /* _LTTNG_TRACE_CLOCK_H */
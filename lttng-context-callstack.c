@@ -0,0 +1,288 @@
+/*
+ * lttng-context-callstack.c
+ *
+ * LTTng kernel callstack context. Each event records a 32-bit id of the
+ * kernel stack it was hit from. The first use of an id in a packet is
+ * followed by a lttng_callstack record holding the id and the stack
+ * frames, so each packet can be decoded on its own.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+#include <linux/jhash.h>
+#include <lttng-events.h>
+#include <wrapper/ringbuffer/frontend.h>
+#include <wrapper/vmalloc.h>
+#include <wrapper/stacktrace.h>
+#include <lttng-tracer.h>
+
+/* Frames kept on the stack of the probe: keep it small. */
+#define LTTNG_CALLSTACK_MAX_ENTRIES	32
+#define LTTNG_CALLSTACK_BITS		8
+#define LTTNG_CALLSTACK_SLOTS		(1U << LTTNG_CALLSTACK_BITS)
+/* Never a packet offset, which is a multiple of the sub-buffer size. */
+#define LTTNG_CALLSTACK_INVALID		1UL
+/* Id recorded by the lttng_callstack records themselves. */
+#define LTTNG_CALLSTACK_NONE		0
+
+/*
+ * Last definition of an id in a direct-mapped slot: the buffer and the
+ * packet it was recorded in.
+ */
+struct lttng_callstack_slot {
+	uint32_t id;
+	struct lib_ring_buffer *buf;
+	unsigned long packet;
+};
+
+struct lttng_callstack_cache {
+	struct lttng_callstack_slot slots[LTTNG_CALLSTACK_SLOTS];
+};
+
+struct lttng_callstack {
+	struct lttng_event *event;	/* Stack definitions */
+	struct lttng_callstack_cache __percpu *cache;
+};
+
+static const struct lttng_event_field lttng_callstack_fields[] = {
+	{
+		.name = "id",
+		.type = __type_integer(uint32_t, 0, 0, -1, __BYTE_ORDER, 16, none),
+	},
+	{
+		.name = "frames",
+		.type = {
+			.atype = atype_sequence,
+			.u.sequence = {
+				.length_type = __type_integer(uint32_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+				.elem_type = __type_integer(unsigned long, 0, 0, 0, __BYTE_ORDER, 16, none),
+			},
+		},
+	},
+};
+
+static const struct lttng_event_desc lttng_callstack_desc = {
+	.name = "lttng_callstack",
+	.fields = lttng_callstack_fields,
+	.nr_fields = ARRAY_SIZE(lttng_callstack_fields),
+	.owner = THIS_MODULE,
+};
+
+/*
+ * Record the definition of "id" unless it is already in the packet of
+ * the record using it. It is nested within that record, which is
+ * reserved but not yet committed. A definition crossing into the next
+ * packet leaves the record using it with the definitions of the
+ * previous packets only.
+ */
+static
+void callstack_define(struct lttng_callstack *callstack,
+		struct lib_ring_buffer_ctx *ctx, struct lttng_channel *chan,
+		uint32_t id, const unsigned long *entries, uint32_t nr)
+{
+	struct lttng_event *event = callstack->event;
+	struct lttng_probe_ctx lttng_probe_ctx = {
+		.event = event,
+	};
+	struct lttng_callstack_slot *slot;
+	struct lib_ring_buffer_ctx def_ctx;
+	unsigned long packet;
+	int ret;
+
+	slot = &this_cpu_ptr(callstack->cache)->slots[id & (LTTNG_CALLSTACK_SLOTS - 1)];
+	if (ACCESS_ONCE(slot->id) == id && ACCESS_ONCE(slot->buf) == ctx->buf
+			&& ACCESS_ONCE(slot->packet)
+				== subbuf_trunc(ctx->buf_offset, ctx->chan))
+		return;
+	if (unlikely(!ACCESS_ONCE(event->effective_enabled)))
+		return;
+	lttng_event_stats_inc(event, hit);
+	/* The frames are aligned after the id and length. */
+	lib_ring_buffer_ctx_init(&def_ctx, ctx->chan, &lttng_probe_ctx,
+			2 * sizeof(uint32_t) + nr * sizeof(unsigned long),
+			lttng_alignof(unsigned long), -1);
+	ret = chan->ops->event_reserve(&def_ctx, event->id);
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(event, ret);
+		return;
+	}
+	packet = subbuf_trunc(def_ctx.buf_offset, def_ctx.chan);
+	lib_ring_buffer_align_ctx(&def_ctx, lttng_alignof(id));
+	chan->ops->event_write(&def_ctx, &id, sizeof(id));
+	lib_ring_buffer_align_ctx(&def_ctx, lttng_alignof(nr));
+	chan->ops->event_write(&def_ctx, &nr, sizeof(nr));
+	lib_ring_buffer_align_ctx(&def_ctx, lttng_alignof(unsigned long));
+	chan->ops->event_write(&def_ctx, entries, nr * sizeof(unsigned long));
+	chan->ops->event_commit(&def_ctx);
+
+	ACCESS_ONCE(slot->packet) = LTTNG_CALLSTACK_INVALID;
+	barrier();
+	ACCESS_ONCE(slot->id) = id;
+	ACCESS_ONCE(slot->buf) = def_ctx.buf;
+	barrier();
+	ACCESS_ONCE(slot->packet) = packet;
+}
+
+static
+size_t callstack_get_size(size_t offset)
+{
+	size_t size = 0;
+
+	size += lib_ring_buffer_align(offset, lttng_alignof(uint32_t));
+	size += sizeof(uint32_t);
+	return size;
+}
+
+static
+void callstack_record(struct lttng_ctx_field *field,
+		struct lib_ring_buffer_ctx *ctx,
+		struct lttng_channel *chan)
+{
+	struct lttng_callstack *callstack = field->u.callstack;
+	struct lttng_probe_ctx *lttng_probe_ctx = ctx->priv;
+	unsigned long entries[LTTNG_CALLSTACK_MAX_ENTRIES];
+	uint32_t id = LTTNG_CALLSTACK_NONE, nr;
+
+	/* The definitions carry the context too: do not recurse. */
+	if (lttng_probe_ctx->event != callstack->event) {
+		nr = lttng_stack_trace_save(entries,
+				LTTNG_CALLSTACK_MAX_ENTRIES, 0);
+		id = jhash(entries, nr * sizeof(entries[0]), nr);
+		if (id == LTTNG_CALLSTACK_NONE)
+			id++;
+		callstack_define(callstack, ctx, chan, id, entries, nr);
+	}
+	lib_ring_buffer_align_ctx(ctx, lttng_alignof(id));
+	chan->ops->event_write(ctx, &id, sizeof(id));
+}
+
+static
+void callstack_destroy(struct lttng_ctx_field *field)
+{
+	struct lttng_callstack *callstack = field->u.callstack;
+
+	free_percpu(callstack->cache);
+	kfree(callstack);
+}
+
+/*
+ * Forget the definitions, e.g. when the channel buffers are replaced.
+ * Should be called with sessions mutex held, without writers.
+ */
+void lttng_callstack_reset(struct lttng_channel *chan)
+{
+	struct lttng_ctx *ctx = chan->ctx;
+	int i, cpu;
+
+	if (!ctx)
+		return;
+	for (i = 0; i < ctx->nr_fields; i++) {
+		struct lttng_ctx_field *field = &ctx->fields[i];
+
+		if (field->record != callstack_record)
+			continue;
+		for_each_possible_cpu(cpu)
+			memset(per_cpu_ptr(field->u.callstack->cache, cpu), 0,
+				sizeof(struct lttng_callstack_cache));
+	}
+}
+
+/*
+ * Per-CPU channels only: the definitions are looked up in the buffer of
+ * the CPU. The definition event is created on first use, and lives until
+ * the session is destroyed, like the other events of the channel.
+ */
+int lttng_add_callstack_to_ctx(struct lttng_ctx **ctx,
+		struct lttng_channel *chan)
+{
+	struct lttng_ctx_field *field;
+	struct lttng_callstack *callstack;
+	int ret = 0;
+
+	if (chan->channel_type != PER_CPU_CHANNEL)
+		return -EINVAL;
+	field = lttng_append_context(ctx);
+	if (!field)
+		return -ENOMEM;
+	if (lttng_find_context(*ctx, "callstack")) {
+		ret = -EEXIST;
+		goto error_find;
+	}
+	callstack = kzalloc(sizeof(*callstack), GFP_KERNEL);
+	if (!callstack) {
+		ret = -ENOMEM;
+		goto error_find;
+	}
+	callstack->cache = alloc_percpu(struct lttng_callstack_cache);
+	if (!callstack->cache) {
+		ret = -ENOMEM;
+		goto error_cache;
+	}
+	lttng_lock_sessions();
+	if (!chan->callstack_event) {
+		struct lttng_kernel_event ev;
+		struct lttng_event *event;
+
+		memset(&ev, 0, sizeof(ev));
+		strncpy(ev.name, lttng_callstack_desc.name,
+			LTTNG_KERNEL_SYM_NAME_LEN);
+		ev.name[LTTNG_KERNEL_SYM_NAME_LEN - 1] = '\0';
+		ev.instrumentation = LTTNG_KERNEL_NOOP;
+		event = _lttng_event_create(chan, &ev, NULL,
+				&lttng_callstack_desc, ev.instrumentation);
+		if (IS_ERR(event)) {
+			ret = PTR_ERR(event);
+			lttng_unlock_sessions();
+			goto error_event;
+		}
+		/* Noop events need to be explicitly enabled. */
+		ACCESS_ONCE(event->enabled) = 1;
+		lttng_event_update_effective_enabled(event);
+		chan->callstack_event = event;
+	}
+	callstack->event = chan->callstack_event;
+	lttng_unlock_sessions();
+
+	field->event_field.name = "callstack";
+	field->event_field.type.atype = atype_integer;
+	field->event_field.type.u.basic.integer.size = sizeof(uint32_t) * CHAR_BIT;
+	field->event_field.type.u.basic.integer.alignment = lttng_alignof(uint32_t) * CHAR_BIT;
+	field->event_field.type.u.basic.integer.signedness = lttng_is_signed_type(uint32_t);
+	field->event_field.type.u.basic.integer.reverse_byte_order = 0;
+	field->event_field.type.u.basic.integer.base = 16;
+	field->event_field.type.u.basic.integer.encoding = lttng_encode_none;
+	field->get_size = callstack_get_size;
+	field->record = callstack_record;
+	field->u.callstack = callstack;
+	field->destroy = callstack_destroy;
+	lttng_context_update(*ctx);
+	wrapper_vmalloc_sync_all();
+	return 0;
+
+error_event:
+	free_percpu(callstack->cache);
+error_cache:
+	kfree(callstack);
+error_find:
+	lttng_remove_context_field(ctx, field);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(lttng_add_callstack_to_ctx);
@@ -0,0 +1,115 @@
+/*
+ * lttng-context-cgroup-id.c
+ *
+ * LTTng cgroup id context.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/cgroup.h>
+#include <linux/kernfs.h>
+#include <linux/rcupdate.h>
+#include <lttng-events.h>
+#include <wrapper/ringbuffer/frontend_types.h>
+#include <wrapper/vmalloc.h>
+#include <lttng-tracer.h>
+
+/*
+ * Id of the current task cgroup in the unified (v2) hierarchy, which is
+ * the inode number of its cgroupfs directory. It is read through the
+ * task css_set, which follows migrations, so no cache is kept: this is
+ * a few loads of cache lines the scheduler keeps hot anyway.
+ */
+uint64_t lttng_cgroup_id(void)
+{
+	struct cgroup *cgrp;
+	uint64_t id;
+
+	rcu_read_lock();
+	cgrp = task_dfl_cgroup(current);
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,5,0))
+	id = cgroup_id(cgrp);
+#elif (LINUX_VERSION_CODE >= KERNEL_VERSION(4,13,0))
+	id = cgrp->kn->id.id;
+#else
+	id = cgrp->kn->ino;
+#endif
+	rcu_read_unlock();
+	return id;
+}
+EXPORT_SYMBOL_GPL(lttng_cgroup_id);
+
+static
+size_t cgroup_id_get_size(size_t offset)
+{
+	size_t size = 0;
+
+	size += lib_ring_buffer_align(offset, lttng_alignof(uint64_t));
+	size += sizeof(uint64_t);
+	return size;
+}
+
+static
+void cgroup_id_record(struct lttng_ctx_field *field,
+		struct lib_ring_buffer_ctx *ctx,
+		struct lttng_channel *chan)
+{
+	uint64_t id;
+
+	id = lttng_cgroup_id();
+	lib_ring_buffer_align_ctx(ctx, lttng_alignof(id));
+	chan->ops->event_write(ctx, &id, sizeof(id));
+}
+
+static
+void cgroup_id_get_value(struct lttng_ctx_field *field,
+		struct lttng_probe_ctx *lttng_probe_ctx,
+		union lttng_ctx_value *value)
+{
+	value->s64 = lttng_cgroup_id();
+}
+
+int lttng_add_cgroup_id_to_ctx(struct lttng_ctx **ctx)
+{
+	struct lttng_ctx_field *field;
+
+	field = lttng_append_context(ctx);
+	if (!field)
+		return -ENOMEM;
+	if (lttng_find_context(*ctx, "cgroup_id")) {
+		lttng_remove_context_field(ctx, field);
+		return -EEXIST;
+	}
+	field->event_field.name = "cgroup_id";
+	field->event_field.type.atype = atype_integer;
+	field->event_field.type.u.basic.integer.size = sizeof(uint64_t) * CHAR_BIT;
+	field->event_field.type.u.basic.integer.alignment = lttng_alignof(uint64_t) * CHAR_BIT;
+	field->event_field.type.u.basic.integer.signedness = lttng_is_signed_type(uint64_t);
+	field->event_field.type.u.basic.integer.reverse_byte_order = 0;
+	field->event_field.type.u.basic.integer.base = 10;
+	field->event_field.type.u.basic.integer.encoding = lttng_encode_none;
+	field->get_size = cgroup_id_get_size;
+	field->record = cgroup_id_record;
+	field->get_value = cgroup_id_get_value;
+	lttng_context_update(*ctx);
+	wrapper_vmalloc_sync_all();
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lttng_add_cgroup_id_to_ctx);
@@ -0,0 +1,156 @@
+/*
+ * lttng-context-cpu-frequency.c
+ *
+ * LTTng CPU frequency context.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/mutex.h>
+#include <linux/cpumask.h>
+#include <linux/cpufreq.h>
+#include <lttng-events.h>
+#include <wrapper/ringbuffer/frontend_types.h>
+#include <wrapper/vmalloc.h>
+#include <wrapper/tracepoint.h>
+#include <lttng-tracer.h>
+
+/*
+ * Frequency of each CPU in kHz, as last set by cpufreq, 0 if unknown.
+ * Updated from the cpu_frequency tracepoint, which cpufreq emits for
+ * both notified and fast-switched transitions, while at least one
+ * context field uses it.
+ */
+static DEFINE_PER_CPU(unsigned int, lttng_cpu_frequency);
+static DEFINE_MUTEX(cpu_frequency_mutex);
+static unsigned int cpu_frequency_refcount;
+
+static
+void cpu_frequency_probe(void *__data, unsigned int frequency,
+		unsigned int cpu_id)
+{
+	if (cpu_id >= nr_cpu_ids)
+		return;
+	per_cpu(lttng_cpu_frequency, cpu_id) = frequency;
+}
+
+static
+int cpu_frequency_get(void)
+{
+	int ret = 0, cpu;
+
+	mutex_lock(&cpu_frequency_mutex);
+	if (cpu_frequency_refcount++)
+		goto end;
+	for_each_possible_cpu(cpu)
+		per_cpu(lttng_cpu_frequency, cpu) = cpufreq_quick_get(cpu);
+	ret = lttng_wrapper_tracepoint_probe_register("cpu_frequency",
+			(void *) cpu_frequency_probe, NULL);
+	if (ret)
+		cpu_frequency_refcount--;
+end:
+	mutex_unlock(&cpu_frequency_mutex);
+	return ret;
+}
+
+static
+void cpu_frequency_put(void)
+{
+	int ret;
+
+	mutex_lock(&cpu_frequency_mutex);
+	if (!--cpu_frequency_refcount) {
+		ret = lttng_wrapper_tracepoint_probe_unregister("cpu_frequency",
+				(void *) cpu_frequency_probe, NULL);
+		WARN_ON_ONCE(ret);
+	}
+	mutex_unlock(&cpu_frequency_mutex);
+}
+
+static
+size_t cpu_frequency_get_size(size_t offset)
+{
+	size_t size = 0;
+
+	size += lib_ring_buffer_align(offset, lttng_alignof(uint32_t));
+	size += sizeof(uint32_t);
+	return size;
+}
+
+static
+void cpu_frequency_record(struct lttng_ctx_field *field,
+		struct lib_ring_buffer_ctx *ctx,
+		struct lttng_channel *chan)
+{
+	uint32_t frequency;
+
+	frequency = per_cpu(lttng_cpu_frequency, ctx->cpu);
+	lib_ring_buffer_align_ctx(ctx, lttng_alignof(frequency));
+	chan->ops->event_write(ctx, &frequency, sizeof(frequency));
+}
+
+static
+void cpu_frequency_get_value(struct lttng_ctx_field *field,
+		struct lttng_probe_ctx *lttng_probe_ctx,
+		union lttng_ctx_value *value)
+{
+	value->s64 = __this_cpu_read(lttng_cpu_frequency);
+}
+
+static
+void cpu_frequency_destroy(struct lttng_ctx_field *field)
+{
+	cpu_frequency_put();
+}
+
+int lttng_add_cpu_frequency_to_ctx(struct lttng_ctx **ctx)
+{
+	struct lttng_ctx_field *field;
+	int ret;
+
+	field = lttng_append_context(ctx);
+	if (!field)
+		return -ENOMEM;
+	if (lttng_find_context(*ctx, "cpu_frequency")) {
+		lttng_remove_context_field(ctx, field);
+		return -EEXIST;
+	}
+	ret = cpu_frequency_get();
+	if (ret) {
+		lttng_remove_context_field(ctx, field);
+		return ret;
+	}
+	field->event_field.name = "cpu_frequency";
+	field->event_field.type.atype = atype_integer;
+	field->event_field.type.u.basic.integer.size = sizeof(uint32_t) * CHAR_BIT;
+	field->event_field.type.u.basic.integer.alignment = lttng_alignof(uint32_t) * CHAR_BIT;
+	field->event_field.type.u.basic.integer.signedness = lttng_is_signed_type(uint32_t);
+	field->event_field.type.u.basic.integer.reverse_byte_order = 0;
+	field->event_field.type.u.basic.integer.base = 10;
+	field->event_field.type.u.basic.integer.encoding = lttng_encode_none;
+	field->get_size = cpu_frequency_get_size;
+	field->record = cpu_frequency_record;
+	field->get_value = cpu_frequency_get_value;
+	field->destroy = cpu_frequency_destroy;
+	lttng_context_update(*ctx);
+	wrapper_vmalloc_sync_all();
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lttng_add_cpu_frequency_to_ctx);
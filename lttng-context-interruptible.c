@@ -27,11 +27,28 @@
 #include <lttng-events.h>
 #include <wrapper/ringbuffer/frontend_types.h>
 #include <wrapper/vmalloc.h>
+#include <wrapper/irqflags.h>
 #include <lttng-tracer.h>
 
 /*
  * Interruptible at value -1 means "unknown".
+ *
+ * Computed when recorded or read by a filter rather than by each probe:
+ * from the registers saved at the probe site by kprobe-style handlers,
+ * else from the current irq state, which probes do not change.
  */
+static
+int8_t interruptible_get(struct lttng_probe_ctx *lttng_probe_ctx)
+{
+	int ret;
+
+	if (!lttng_probe_ctx->regs)
+		return !irqs_disabled();
+	ret = lttng_regs_irqs_disabled(lttng_probe_ctx->regs);
+	if (ret < 0)
+		return -1;
+	return !ret;
+}
 
 static
 size_t interruptible_get_size(size_t offset)
@@ -49,7 +66,7 @@ void interruptible_record(struct lttng_ctx_field *field,
 		struct lttng_channel *chan)
 {
 	struct lttng_probe_ctx *lttng_probe_ctx = ctx->priv;
-	int8_t interruptible = lttng_probe_ctx->interruptible;
+	int8_t interruptible = interruptible_get(lttng_probe_ctx);
 
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(interruptible));
 	chan->ops->event_write(ctx, &interruptible, sizeof(interruptible));
@@ -60,7 +77,7 @@ void interruptible_get_value(struct lttng_ctx_field *field,
 		struct lttng_probe_ctx *lttng_probe_ctx,
 		union lttng_ctx_value *value)
 {
-	int8_t interruptible = lttng_probe_ctx->interruptible;
+	int8_t interruptible = interruptible_get(lttng_probe_ctx);
 
 	value->s64 = interruptible;
 }
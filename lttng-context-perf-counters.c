@@ -32,6 +32,79 @@
 #include <wrapper/perf.h>
 #include <lttng-tracer.h>
 
+#if defined(CONFIG_X86) && (LINUX_VERSION_CODE >= KERNEL_VERSION(3,11,0))
+
+#include <asm/msr.h>
+#include <asm/processor.h>
+
+#define LTTNG_PERF_RDPMC
+
+/*
+ * The cycles and instructions counters are read with rdpmc when the
+ * event is active on the current CPU. The hardware delta since the last
+ * perf update is added to the event count as x86_perf_event_update()
+ * does, without touching the perf event state. Returns the shift which
+ * sign-extends a delta of the counter width, 0 if rdpmc cannot be used.
+ */
+static
+int perf_counter_rdpmc_shift(struct perf_event_attr *attr)
+{
+	if (attr->type != PERF_TYPE_HARDWARE)
+		return 0;
+	switch (attr->config) {
+	case PERF_COUNT_HW_CPU_CYCLES:
+	case PERF_COUNT_HW_INSTRUCTIONS:
+		break;
+	default:
+		return 0;
+	}
+	if (boot_cpu_has(X86_FEATURE_ARCH_PERFMON)) {
+		unsigned int eax, ebx, ecx, edx, width;
+
+		/* Same width as the perf core uses for all counters. */
+		cpuid(0xa, &eax, &ebx, &ecx, &edx);
+		width = (eax >> 16) & 0xff;
+		if (!width || width >= 64)
+			return 0;
+		return 64 - width;
+	}
+	if (boot_cpu_data.x86_vendor == X86_VENDOR_AMD)
+		return 64 - 48;
+	return 0;
+}
+
+/*
+ * The update of prev_count by an interrupt or NMI between the reads
+ * means they are not consistent, retry then. The counter is only
+ * reassigned after its event is stopped, which updates prev_count too.
+ */
+static
+int perf_counter_read_rdpmc(struct perf_event *event, int shift,
+		uint64_t *value)
+{
+	struct hw_perf_event *hwc = &event->hw;
+	u64 prev, count, raw;
+	s64 delta;
+
+	if (event->state != PERF_EVENT_STATE_ACTIVE
+			|| event->oncpu != smp_processor_id()
+			|| hwc->idx < 0)
+		return -EAGAIN;
+	do {
+		prev = local64_read(&hwc->prev_count);
+		barrier();
+		count = local64_read(&event->count);
+		rdpmcl(hwc->event_base_rdpmc, raw);
+		barrier();
+	} while (local64_read(&hwc->prev_count) != prev);
+	delta = (raw << shift) - (prev << shift);
+	delta >>= shift;
+	*value = count + delta;
+	return 0;
+}
+
+#endif /* #if defined(CONFIG_X86) && (LINUX_VERSION_CODE >= KERNEL_VERSION(3,11,0)) */
+
 static
 size_t perf_counter_get_size(size_t offset)
 {
@@ -43,21 +116,24 @@ size_t perf_counter_get_size(size_t offset)
 }
 
 static
-void perf_counter_record(struct lttng_ctx_field *field,
-			 struct lib_ring_buffer_ctx *ctx,
-			 struct lttng_channel *chan)
+uint64_t perf_counter_read_value(struct lttng_perf_counter_field *perf_field,
+		int cpu)
 {
 	struct perf_event *event;
 	uint64_t value;
 
-	event = field->u.perf_counter->e[ctx->cpu];
+	event = perf_field->e[cpu];
 	if (likely(event)) {
-		if (unlikely(event->state == PERF_EVENT_STATE_ERROR)) {
-			value = 0;
-		} else {
-			event->pmu->read(event);
-			value = local64_read(&event->count);
-		}
+		if (unlikely(event->state == PERF_EVENT_STATE_ERROR))
+			return 0;
+#ifdef LTTNG_PERF_RDPMC
+		if (perf_field->rdpmc_shift
+				&& !perf_counter_read_rdpmc(event,
+					perf_field->rdpmc_shift, &value))
+			return value;
+#endif
+		event->pmu->read(event);
+		value = local64_read(&event->count);
 	} else {
 		/*
 		 * Perf chooses not to be clever and not to support enabling a
@@ -68,10 +144,34 @@ void perf_counter_record(struct lttng_ctx_field *field,
 		 */
 		value = 0;
 	}
+	return value;
+}
+
+static
+void perf_counter_record(struct lttng_ctx_field *field,
+			 struct lib_ring_buffer_ctx *ctx,
+			 struct lttng_channel *chan)
+{
+	uint64_t value;
+
+	value = perf_counter_read_value(field->u.perf_counter, ctx->cpu);
 	lib_ring_buffer_align_ctx(ctx, lttng_alignof(value));
 	chan->ops->event_write(ctx, &value, sizeof(value));
 }
 
+/*
+ * Also lets perf counters be part of the fixed context layout, so
+ * adjacent counters are sampled back to back in a single pass.
+ */
+static
+void perf_counter_get_value(struct lttng_ctx_field *field,
+		struct lttng_probe_ctx *lttng_probe_ctx,
+		union lttng_ctx_value *value)
+{
+	value->s64 = perf_counter_read_value(field->u.perf_counter,
+			smp_processor_id());
+}
+
 #if defined(CONFIG_PERF_EVENTS) && (LINUX_VERSION_CODE >= KERNEL_VERSION(3,0,99))
 static
 void overflow_callback(struct perf_event *event,
@@ -260,6 +360,9 @@ int lttng_add_perf_counter_to_ctx(uint32_t type,
 	}
 	perf_field->e = events;
 	perf_field->attr = attr;
+#ifdef LTTNG_PERF_RDPMC
+	perf_field->rdpmc_shift = perf_counter_rdpmc_shift(attr);
+#endif
 
 	name_alloc = kstrdup(name, GFP_KERNEL);
 	if (!name_alloc) {
@@ -331,6 +434,7 @@ int lttng_add_perf_counter_to_ctx(uint32_t type,
 	field->event_field.type.u.basic.integer.encoding = lttng_encode_none;
 	field->get_size = perf_counter_get_size;
 	field->record = perf_counter_record;
+	field->get_value = perf_counter_get_value;
 	field->u.perf_counter = perf_field;
 	lttng_context_update(*ctx);
 
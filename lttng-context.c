@@ -24,6 +24,7 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/slab.h>
+#include <linux/percpu.h>
 #include <wrapper/vmalloc.h>	/* for wrapper_vmalloc_sync_all() */
 #include <lttng-events.h>
 #include <lttng-tracer.h>
@@ -37,6 +38,7 @@
  * Static array of contexts, for $ctx filters.
  */
 struct lttng_ctx *lttng_static_ctx;
+EXPORT_SYMBOL_GPL(lttng_static_ctx);
 
 int lttng_find_context(struct lttng_ctx *ctx, const char *name)
 {
@@ -109,6 +111,85 @@ struct lttng_ctx_field *lttng_append_context(struct lttng_ctx **ctx_p)
 }
 EXPORT_SYMBOL_GPL(lttng_append_context);
 
+/*
+ * Size of a field which can be part of the fixed layout, 0 otherwise.
+ * Only native byte order integers and enumerations, and character
+ * arrays, read with get_value(), have a fixed size and a value
+ * matching what their record() callback writes.
+ */
+static
+size_t lttng_context_fixed_len(struct lttng_ctx_field *field,
+		size_t *align, int *array)
+{
+	struct lttng_type *type = &field->event_field.type;
+	struct lttng_integer_type *itype;
+
+	if (!field->get_value || field->packet_scoped)
+		return 0;
+	*array = 0;
+	switch (type->atype) {
+	case atype_integer:
+		itype = &type->u.basic.integer;
+		break;
+	case atype_enum:
+		itype = &type->u.basic.enumeration.container_type;
+		break;
+	case atype_array:
+		if (type->u.array.elem_type.atype != atype_integer
+				|| type->u.array.elem_type.u.basic.integer.size != CHAR_BIT)
+			return 0;
+		*align = 1;
+		*array = 1;
+		return type->u.array.length;
+	default:
+		return 0;
+	}
+	if (itype->reverse_byte_order)
+		return 0;
+	switch (itype->size) {
+	case 8:
+	case 16:
+	case 32:
+	case 64:
+		break;
+	default:
+		return 0;
+	}
+	*align = itype->alignment >> 3;
+	return itype->size >> 3;
+}
+
+/*
+ * Lay out the leading fixed-size fields, up to the snapshot size. The
+ * context starts aligned on largest_align, so their offsets from the
+ * start are the same in every record.
+ */
+static
+void lttng_context_update_fixed(struct lttng_ctx *ctx)
+{
+	size_t offset = 0;
+	int i;
+
+	for (i = 0; i < ctx->nr_fields; i++) {
+		struct lttng_ctx_field *field = &ctx->fields[i];
+		size_t len, align = 1, field_offset;
+		int array;
+
+		len = lttng_context_fixed_len(field, &align, &array);
+		if (!len)
+			break;
+		field_offset = offset + lib_ring_buffer_align(offset, align);
+		if (field_offset + len > LTTNG_CTX_FIXED_MAX_LEN)
+			break;
+		field->fixed_offset = field_offset;
+		field->fixed_len = len;
+		field->fixed_array = array;
+		offset = field_offset + len;
+	}
+	ctx->nr_fixed_fields = i;
+	ctx->fixed_size = offset;
+}
+
 /*
  * lttng_context_update() should be called at least once between context
  * modification and trace start.
@@ -213,6 +294,7 @@ void lttng_context_update(struct lttng_ctx *ctx)
 		largest_align = max_t(size_t, largest_align, field_align);
 	}
 	ctx->largest_align = largest_align >> 3;	/* bits to bytes */
+	lttng_context_update_fixed(ctx);
 }
 
 /*
@@ -230,6 +312,47 @@ void lttng_remove_context_field(struct lttng_ctx **ctx_p,
 }
 EXPORT_SYMBOL_GPL(lttng_remove_context_field);
 
+/*
+ * Make the last context field packet-scoped. Only integers and short
+ * character arrays read with get_value() can be compared with the
+ * value recorded in the previous event.
+ */
+int lttng_context_packet_scope(struct lttng_ctx *ctx)
+{
+	struct lttng_ctx_field *field;
+	struct lttng_type *type;
+
+	if (!ctx || !ctx->nr_fields)
+		return -EINVAL;
+	if (ctx->nr_fields > LTTNG_CTX_PACKET_SCOPED_MAX)
+		return -EINVAL;
+	field = &ctx->fields[ctx->nr_fields - 1];
+	if (!field->get_value)
+		return -EINVAL;
+	type = &field->event_field.type;
+	switch (type->atype) {
+	case atype_integer:
+	case atype_enum:
+		break;
+	case atype_array:
+		if (type->u.array.elem_type.atype != atype_integer
+				|| type->u.array.elem_type.u.basic.integer.size != CHAR_BIT
+				|| type->u.array.length > LTTNG_CTX_PACKET_SCOPED_STR_LEN)
+			return -EINVAL;
+		break;
+	default:
+		return -EINVAL;
+	}
+	/* Zeroed: values are unknown until recorded. */
+	field->packet_scoped = alloc_percpu(struct lttng_ctx_packet_scoped);
+	if (!field->packet_scoped)
+		return -ENOMEM;
+	/* Packet-scoped fields leave the fixed layout. */
+	lttng_context_update(ctx);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lttng_context_packet_scope);
+
 void lttng_destroy_context(struct lttng_ctx *ctx)
 {
 	int i;
@@ -239,6 +362,7 @@ void lttng_destroy_context(struct lttng_ctx *ctx)
 	for (i = 0; i < ctx->nr_fields; i++) {
 		if (ctx->fields[i].destroy)
 			ctx->fields[i].destroy(&ctx->fields[i]);
+		free_percpu(ctx->fields[i].packet_scoped);
 	}
 	kfree(ctx->fields);
 	kfree(ctx);
@@ -308,6 +432,15 @@ int lttng_context_init(void)
 	if (ret && ret != -ENOSYS) {
 		printk(KERN_WARNING "Cannot add context lttng_add_migratable_to_ctx");
 	}
+	ret = lttng_add_numa_node_to_ctx(&lttng_static_ctx);
+	if (ret) {
+		printk(KERN_WARNING "Cannot add context lttng_add_numa_node_to_ctx");
+	}
+	ret = lttng_add_cgroup_id_to_ctx(&lttng_static_ctx);
+	if (ret && ret != -ENOSYS) {
+		printk(KERN_WARNING "Cannot add context lttng_add_cgroup_id_to_ctx");
+	}
+	/* cpu_frequency is left out, it hooks cpufreq while in use. */
 	/* TODO: perf counters for filtering */
 	return 0;
 }
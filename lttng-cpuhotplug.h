@@ -32,6 +32,7 @@ enum lttng_cpuhp_component {
 	LTTNG_RING_BUFFER_BACKEND,
 	LTTNG_RING_BUFFER_ITER,
 	LTTNG_CONTEXT_PERF_COUNTERS,
+	LTTNG_PERF_SAMPLE,
 };
 
 struct lttng_cpuhp_node {
@@ -0,0 +1,221 @@
+/*
+ * lttng-delta.c
+ *
+ * LTTng delta encoding. In a channel with delta encoding, the integer
+ * fields declared with ctf_integer_delta() are recorded as a tag followed
+ * by their difference with the value of the previous record of the event
+ * on the CPU, when it fits on 1, 2 or 4 bytes. The first record of each
+ * packet holds the value, so each packet can be decoded on its own.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <wrapper/ringbuffer/frontend.h>
+
+/* Delta fields of an event beyond this number are recorded as is. */
+#define LTTNG_DELTA_MAX_FIELDS		4
+/* Never a packet offset, which is a multiple of the sub-buffer size. */
+#define LTTNG_DELTA_INVALID		1UL
+
+/*
+ * Bases of the delta fields of an event on a CPU: the values of its last
+ * record, in "packet" of "buf". "owner" is the record being recorded,
+ * the only one to access the other fields meanwhile.
+ */
+struct lttng_delta_state {
+	void *owner;
+	struct lib_ring_buffer *buf;
+	unsigned long packet;
+	unsigned long pending_packet;	/* Packet of the owner's bases */
+	int based;			/* Owner records deltas */
+	unsigned int nr_pending;
+	uint64_t values[LTTNG_DELTA_MAX_FIELDS];
+	uint64_t pending[LTTNG_DELTA_MAX_FIELDS];
+};
+
+/*
+ * Called by probes while computing the size of the record, with preemption
+ * disabled, for each of its delta fields in order. "owner" identifies the
+ * record until lttng_delta_end() or lttng_delta_abort(). Returns the tag
+ * of the field, "delta" being set for the _DELTA_* tags.
+ *
+ * The bases are those of the packet the record would begin in when it is
+ * sized, see lttng_delta_based(). A record nested over another record of
+ * the event is recorded as is, without changing the bases.
+ */
+unsigned int lttng_delta_encode(struct lttng_event *event, unsigned int idx,
+		uint64_t value, void *owner, size_t *delta)
+{
+	struct lttng_delta_state *state = this_cpu_ptr(event->delta_state);
+	int64_t diff;
+
+	if (!idx) {
+		struct lttng_channel *chan = event->chan;
+		const struct lib_ring_buffer_config *config =
+			&chan->chan->backend.config;
+		struct lib_ring_buffer *buf;
+		unsigned long packet;
+
+		if (ACCESS_ONCE(state->owner))
+			return LTTNG_DELTA_FULL;
+		ACCESS_ONCE(state->owner) = owner;
+		barrier();
+		buf = channel_get_ring_buffer(config, chan->chan,
+				smp_processor_id());
+		packet = subbuf_trunc(v_read(config, &buf->offset), chan->chan);
+		state->based = state->buf == buf && state->packet == packet;
+		state->pending_packet = packet;
+		state->nr_pending = 0;
+	}
+	if (ACCESS_ONCE(state->owner) != owner
+			|| idx >= LTTNG_DELTA_MAX_FIELDS)
+		return LTTNG_DELTA_FULL;
+	state->pending[idx] = value;
+	state->nr_pending = idx + 1;
+	if (!state->based)
+		return LTTNG_DELTA_BASE;
+	diff = (int64_t) (value - state->values[idx]);
+	*delta = (size_t) diff;
+	if (diff == (int8_t) diff)
+		return LTTNG_DELTA_8;
+	if (diff == (int16_t) diff)
+		return LTTNG_DELTA_16;
+	if (diff == (int32_t) diff)
+		return LTTNG_DELTA_32;
+	return LTTNG_DELTA_BASE;
+}
+EXPORT_SYMBOL_GPL(lttng_delta_encode);
+
+/*
+ * Called by probes once the record is sized. Returns whether it has
+ * differences with the bases of "packet". Recorded in another packet,
+ * e.g. when crossing a packet boundary, it must be sized and written
+ * with full values instead.
+ */
+bool lttng_delta_based(struct lttng_event *event, void *owner,
+		unsigned long *packet)
+{
+	struct lttng_delta_state *state = this_cpu_ptr(event->delta_state);
+
+	if (ACCESS_ONCE(state->owner) != owner || !state->based)
+		return false;
+	*packet = state->pending_packet;
+	return true;
+}
+EXPORT_SYMBOL_GPL(lttng_delta_based);
+
+/*
+ * Called by probes once the record is written, before its commit. The
+ * next record is a base if this one was recorded with full values in
+ * another packet than its bases.
+ */
+void lttng_delta_end(struct lttng_event *event, void *owner,
+		struct lib_ring_buffer_ctx *ctx)
+{
+	struct lttng_delta_state *state = this_cpu_ptr(event->delta_state);
+	unsigned long packet;
+
+	if (ACCESS_ONCE(state->owner) != owner)
+		return;
+	packet = subbuf_trunc(ctx->pre_offset, ctx->chan);
+	if (state->based && packet != state->pending_packet)
+		packet = LTTNG_DELTA_INVALID;
+	memcpy(state->values, state->pending,
+		state->nr_pending * sizeof(state->values[0]));
+	state->buf = ctx->buf;
+	state->packet = packet;
+	barrier();
+	ACCESS_ONCE(state->owner) = NULL;
+}
+EXPORT_SYMBOL_GPL(lttng_delta_end);
+
+/* Called by probes when the record sized is not recorded. */
+void lttng_delta_abort(struct lttng_event *event, void *owner)
+{
+	struct lttng_delta_state *state = this_cpu_ptr(event->delta_state);
+
+	if (ACCESS_ONCE(state->owner) == owner)
+		ACCESS_ONCE(state->owner) = NULL;
+}
+EXPORT_SYMBOL_GPL(lttng_delta_abort);
+
+/*
+ * Allocate the bases of an event with delta fields created in a channel
+ * with delta encoding. Called before the event is published.
+ */
+int lttng_delta_event_init(struct lttng_event *event)
+{
+	const struct lttng_event_desc *desc = event->desc;
+	unsigned int i;
+
+	if (!event->chan->delta)
+		return 0;
+	for (i = 0; i < desc->nr_fields; i++) {
+		if (desc->fields[i].delta)
+			break;
+	}
+	if (i == desc->nr_fields)
+		return 0;
+	event->delta_state = alloc_percpu(struct lttng_delta_state);
+	if (!event->delta_state)
+		return -ENOMEM;
+	return 0;
+}
+
+/*
+ * Forget the bases, e.g. when the channel buffers are replaced. Should be
+ * called with sessions mutex held, without writers.
+ */
+void lttng_delta_reset(struct lttng_channel *chan)
+{
+	struct lttng_event *event;
+	int cpu;
+
+	if (!chan->delta)
+		return;
+	list_for_each_entry(event, &chan->session->events, list) {
+		if (event->chan != chan || !event->delta_state)
+			continue;
+		for_each_possible_cpu(cpu)
+			memset(per_cpu_ptr(event->delta_state, cpu), 0,
+				sizeof(struct lttng_delta_state));
+	}
+}
+
+/*
+ * Delta encoding applies to the events created in the channel from then
+ * on, and stays enabled until the channel is destroyed. The bases being
+ * per CPU, each CPU must have its own buffer.
+ */
+int lttng_channel_delta(struct lttng_channel *chan)
+{
+	const struct lib_ring_buffer_config *config = &chan->chan->backend.config;
+
+	if (chan->channel_type != PER_CPU_CHANNEL
+			|| config->alloc != RING_BUFFER_ALLOC_PER_CPU
+			|| config->cluster != RING_BUFFER_CLUSTER_CPU)
+		return -EINVAL;
+	lttng_lock_sessions();
+	chan->delta = 1;
+	lttng_unlock_sessions();
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * lttng-event-fragment.c
+ *
+ * LTTng event fragments. In a channel with fragments, a record whose
+ * payload does not fit in a sub-buffer is written to a per-CPU staging
+ * area, then recorded as consecutive lttng_event_fragment records, each
+ * fitting in a sub-buffer, holding the id of the event and a slice of
+ * its event-specific contexts and payload.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <wrapper/ringbuffer/frontend.h>
+#include <wrapper/vmalloc.h>
+
+/* Fields preceding the data of a fragment record. */
+#define LTTNG_FRAGMENT_HEADER_LEN	(4 * sizeof(uint32_t))
+
+static const struct lttng_event_field lttng_event_fragment_fields[] = {
+	{
+		.name = "event_id",
+		.type = __type_integer(uint32_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "size",
+		.type = __type_integer(uint32_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "offset",
+		.type = __type_integer(uint32_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "data",
+		.type = {
+			.atype = atype_sequence,
+			.u.sequence = {
+				.length_type = __type_integer(uint32_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+				.elem_type = __type_integer(uint8_t, 0, 0, 0, __BYTE_ORDER, 16, none),
+			},
+		},
+	},
+};
+
+static const struct lttng_event_desc lttng_event_fragment_desc = {
+	.name = "lttng_event_fragment",
+	.fields = lttng_event_fragment_fields,
+	.nr_fields = ARRAY_SIZE(lttng_event_fragment_fields),
+	.owner = THIS_MODULE,
+};
+
+static
+int fragment_record(struct lttng_channel *chan, struct lttng_event *event,
+		uint32_t fragmented_id, uint32_t size, uint32_t offset,
+		const char *data, uint32_t len)
+{
+	struct lttng_probe_ctx lttng_probe_ctx = {
+		.event = event,
+	};
+	struct lib_ring_buffer_ctx ctx;
+	int ret;
+
+	lttng_event_stats_inc(event, hit);
+	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx,
+			LTTNG_FRAGMENT_HEADER_LEN + len,
+			lttng_alignof(uint32_t), -1);
+	ret = chan->ops->event_reserve(&ctx, event->id);
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(event, ret);
+		return ret;
+	}
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(uint32_t));
+	chan->ops->event_write(&ctx, &fragmented_id, sizeof(fragmented_id));
+	chan->ops->event_write(&ctx, &size, sizeof(size));
+	chan->ops->event_write(&ctx, &offset, sizeof(offset));
+	chan->ops->event_write(&ctx, &len, sizeof(len));
+	chan->ops->event_write(&ctx, data, len);
+	chan->ops->event_commit(&ctx);
+	return 0;
+}
+
+/*
+ * Called by the client on commit of a staged record, on the CPU it was
+ * reserved on, with preemption disabled. The fragments following one
+ * which cannot be recorded are dropped: readers discard the incomplete
+ * sequence, and the record counts as lost by its event.
+ */
+void lttng_fragment_stage_flush(struct lib_ring_buffer_ctx *ctx)
+{
+	struct lttng_channel *chan = channel_get_private(ctx->chan);
+	struct lttng_probe_ctx *lttng_probe_ctx = ctx->priv;
+	struct lttng_event *event = lttng_probe_ctx->event;
+	struct lttng_fragment_stage *stage = this_cpu_ptr(chan->fragment_stage);
+	size_t size = ctx->buf_offset, offset, len, max;
+	int ret;
+
+	max = ctx->chan->backend.subbuf_size - LTTNG_FRAGMENT_RESERVED
+		- LTTNG_FRAGMENT_HEADER_LEN;
+	for (offset = 0; offset < size; offset += len) {
+		len = min_t(size_t, size - offset, max);
+		ret = fragment_record(chan, chan->fragment_event, event->id,
+				size, offset, stage->data + offset, len);
+		if (ret < 0) {
+			lttng_event_stats_reserve_failed(event, ret);
+			break;
+		}
+	}
+	barrier();	/* Data read before release. */
+	stage->busy = 0;
+}
+EXPORT_SYMBOL_GPL(lttng_fragment_stage_flush);
+
+static
+void lttng_fragment_stage_free(struct lttng_fragment_stage __percpu *stage)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		vfree(per_cpu_ptr(stage, cpu)->data);
+	free_percpu(stage);
+}
+
+/*
+ * Fragments apply to the records reserved from then on, and stay
+ * enabled until the channel is destroyed. The fragment event lives until
+ * the session is destroyed, like the other events of the channel.
+ */
+int lttng_channel_fragment(struct lttng_channel *chan)
+{
+	struct lttng_fragment_stage __percpu *stage;
+	struct lttng_kernel_event ev;
+	struct lttng_event *event;
+	int ret = 0, cpu;
+
+	if (chan->channel_type != PER_CPU_CHANNEL
+			|| chan->chan->backend.config.alloc != RING_BUFFER_ALLOC_PER_CPU)
+		return -EINVAL;
+	lttng_lock_sessions();
+	if (chan->fragment_stage)
+		goto unlock;
+	stage = alloc_percpu(struct lttng_fragment_stage);
+	if (!stage) {
+		ret = -ENOMEM;
+		goto unlock;
+	}
+	for_each_possible_cpu(cpu) {
+		struct lttng_fragment_stage *cpu_stage = per_cpu_ptr(stage, cpu);
+
+		cpu_stage->data = vmalloc_node(LTTNG_KERNEL_FRAGMENT_MAX_SIZE,
+				cpu_to_node(cpu));
+		if (!cpu_stage->data) {
+			ret = -ENOMEM;
+			goto error_data;
+		}
+	}
+	memset(&ev, 0, sizeof(ev));
+	strncpy(ev.name, lttng_event_fragment_desc.name,
+		LTTNG_KERNEL_SYM_NAME_LEN);
+	ev.name[LTTNG_KERNEL_SYM_NAME_LEN - 1] = '\0';
+	ev.instrumentation = LTTNG_KERNEL_NOOP;
+	event = _lttng_event_create(chan, &ev, NULL,
+			&lttng_event_fragment_desc, ev.instrumentation);
+	if (IS_ERR(event)) {
+		ret = PTR_ERR(event);
+		goto error_data;
+	}
+	/* Noop events need to be explicitly enabled. */
+	ACCESS_ONCE(event->enabled) = 1;
+	lttng_event_update_effective_enabled(event);
+	/* The probes must not trigger page faults on the staging areas. */
+	wrapper_vmalloc_sync_all();
+	chan->fragment_event = event;
+	/* Populate the stages before the client can observe them. */
+	smp_wmb();
+	ACCESS_ONCE(chan->fragment_stage) = stage;
+	goto unlock;
+
+error_data:
+	lttng_fragment_stage_free(stage);
+unlock:
+	lttng_unlock_sessions();
+	return ret;
+}
+
+/*
+ * Called on channel destroy, after the trace synchronization.
+ */
+void lttng_channel_fragment_destroy(struct lttng_channel *chan)
+{
+	if (!chan->fragment_stage)
+		return;
+	lttng_fragment_stage_free(chan->fragment_stage);
+}
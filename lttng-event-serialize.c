@@ -0,0 +1,268 @@
+/*
+ * lttng-event-serialize.c
+ *
+ * LTTng table-driven event serializer. Probes built with TP_TABLE_DRIVEN
+ * lay out the fields of their events as for the filters, and record them
+ * through this single loop over the field descriptions of the event,
+ * rather than with size, alignment and write code generated per event.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/swab.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <probes/lttng-probe-user.h>
+#include <probes/lttng-probe-write.h>
+
+static inline
+size_t integer_align(const struct lttng_integer_type *type)
+{
+	return type->alignment / CHAR_BIT;
+}
+
+/* Integer type of an integer or enumeration field. */
+static inline
+const struct lttng_integer_type *field_integer(const struct lttng_type *type)
+{
+	if (type->atype == atype_enum)
+		return &type->u.basic.enumeration.container_type;
+	return &type->u.basic.integer;
+}
+
+/* Element type of an array or sequence field. */
+static inline
+const struct lttng_integer_type *field_elem(const struct lttng_type *type)
+{
+	if (type->atype == atype_sequence)
+		return &type->u.sequence.elem_type.u.basic.integer;
+	return &type->u.array.elem_type.u.basic.integer;
+}
+
+static inline
+const struct lttng_integer_type *field_length(const struct lttng_type *type)
+{
+	return &type->u.sequence.length_type.u.basic.integer;
+}
+
+/* Integers, in the byte order of the trace, and sequence lengths. */
+static inline
+void serialize_integer(struct lttng_channel *chan,
+		struct lib_ring_buffer_ctx *ctx,
+		const struct lttng_integer_type *type, uint64_t value)
+{
+	union {
+		uint8_t v8;
+		uint16_t v16;
+		uint32_t v32;
+		uint64_t v64;
+	} tmp;
+	size_t len = type->size / CHAR_BIT;
+
+	switch (len) {
+	case 1:
+		tmp.v8 = value;
+		break;
+	case 2:
+		tmp.v16 = value;
+		if (type->reverse_byte_order)
+			__swab16s(&tmp.v16);
+		break;
+	case 4:
+		tmp.v32 = value;
+		if (type->reverse_byte_order)
+			__swab32s(&tmp.v32);
+		break;
+	case 8:
+		tmp.v64 = value;
+		if (type->reverse_byte_order)
+			__swab64s(&tmp.v64);
+		break;
+	default:
+		WARN_ON_ONCE(1);
+		return;
+	}
+	lib_ring_buffer_align_ctx(ctx, integer_align(type));
+	lttng_probe_event_write(chan, ctx, &tmp, len);
+}
+
+/*
+ * Computes the size and alignment of the payload laid out in
+ * "stack_data", saving the length of its strings in "dynamic_len".
+ */
+static
+size_t serialize_get_size(const struct lttng_event_desc *desc,
+		const char *stack_data, size_t *dynamic_len, size_t *align)
+{
+	const struct lttng_integer_type *int_type;
+	size_t len = 0, max_align = 1, field_align;
+	unsigned int i;
+
+	for (i = 0; i < desc->nr_fields; i++) {
+		const struct lttng_event_field *field = &desc->fields[i];
+		const struct lttng_type *type = &field->type;
+		unsigned long length;
+		const char *str;
+
+		switch (type->atype) {
+		case atype_integer:
+		case atype_enum:
+			stack_data += sizeof(int64_t);
+			if (field->nowrite)
+				break;
+			int_type = field_integer(type);
+			field_align = integer_align(int_type);
+			len += lib_ring_buffer_align(len, field_align);
+			len += int_type->size / CHAR_BIT;
+			max_align = max(max_align, field_align);
+			break;
+		case atype_array:
+		case atype_sequence:
+			memcpy(&length, stack_data, sizeof(length));
+			stack_data += sizeof(unsigned long) + sizeof(void *);
+			if (field->nowrite)
+				break;
+			if (type->atype == atype_sequence) {
+				int_type = field_length(type);
+				field_align = integer_align(int_type);
+				len += lib_ring_buffer_align(len, field_align);
+				len += int_type->size / CHAR_BIT;
+				max_align = max(max_align, field_align);
+			}
+			int_type = field_elem(type);
+			field_align = integer_align(int_type);
+			len += lib_ring_buffer_align(len, field_align);
+			len += int_type->size / CHAR_BIT * length;
+			max_align = max(max_align, field_align);
+			break;
+		case atype_string:
+			memcpy(&str, stack_data, sizeof(str));
+			stack_data += sizeof(void *);
+			if (field->nowrite)
+				break;
+			if (field->user)
+				*dynamic_len = max_t(size_t,
+					lttng_strlen_user_inatomic(str), 1);
+			else
+				*dynamic_len = strlen(str) + 1;
+			len += *dynamic_len++;
+			break;
+		default:
+			WARN_ON_ONCE(1);
+			break;
+		}
+	}
+	*align = max_align;
+	return len;
+}
+
+static
+void serialize_write(struct lttng_channel *chan,
+		struct lib_ring_buffer_ctx *ctx,
+		const struct lttng_event_desc *desc,
+		const char *stack_data, const size_t *dynamic_len)
+{
+	struct lttng_probe_uaccess uaccess = { .open = 0 };
+	const struct lttng_integer_type *elem_type;
+	unsigned int i;
+
+	for (i = 0; i < desc->nr_fields; i++) {
+		const struct lttng_event_field *field = &desc->fields[i];
+		const struct lttng_type *type = &field->type;
+		unsigned long length;
+		const void *ptr;
+		uint64_t value;
+
+		switch (type->atype) {
+		case atype_integer:
+		case atype_enum:
+			memcpy(&value, stack_data, sizeof(value));
+			stack_data += sizeof(int64_t);
+			if (field->nowrite)
+				break;
+			serialize_integer(chan, ctx, field_integer(type),
+				value);
+			break;
+		case atype_array:
+		case atype_sequence:
+			memcpy(&length, stack_data, sizeof(length));
+			memcpy(&ptr, stack_data + sizeof(unsigned long),
+				sizeof(ptr));
+			stack_data += sizeof(unsigned long) + sizeof(void *);
+			if (field->nowrite)
+				break;
+			if (type->atype == atype_sequence)
+				serialize_integer(chan, ctx, field_length(type),
+					length);
+			elem_type = field_elem(type);
+			lib_ring_buffer_align_ctx(ctx,
+				integer_align(elem_type));
+			length *= elem_type->size / CHAR_BIT;
+			if (field->user)
+				lttng_probe_event_write_from_user_uaccess(chan,
+					&uaccess, ctx, ptr, length);
+			else
+				lttng_probe_event_write(chan, ctx, ptr, length);
+			break;
+		case atype_string:
+			memcpy(&ptr, stack_data, sizeof(ptr));
+			stack_data += sizeof(void *);
+			if (field->nowrite)
+				break;
+			if (field->user)
+				lttng_probe_event_strcpy_from_user_uaccess(chan,
+					&uaccess, ctx, ptr, *dynamic_len++);
+			else
+				lttng_probe_event_strcpy(chan, ctx, ptr,
+					*dynamic_len++);
+			break;
+		default:
+			break;
+		}
+	}
+	lttng_probe_uaccess_end(&uaccess);
+}
+
+/*
+ * Called by probes built with TP_TABLE_DRIVEN, with preemption disabled,
+ * to record an event of which "stack_data" holds all the fields, as laid
+ * out for the filters. "dynamic_len" has room for the lengths of the
+ * strings of the event. Only events with integer, enumeration, string,
+ * array and sequence fields, except bitfields, are recorded this way.
+ */
+void lttng_event_serialize(struct lttng_event *event,
+		struct lttng_probe_ctx *probe_ctx, const char *stack_data,
+		size_t *dynamic_len)
+{
+	struct lttng_channel *chan = event->chan;
+	struct lib_ring_buffer_ctx ctx;
+	size_t len, align;
+	int ret;
+
+	len = serialize_get_size(event->desc, stack_data, dynamic_len, &align);
+	lib_ring_buffer_ctx_init(&ctx, chan->chan, probe_ctx, len, align, -1);
+	ret = chan->ops->event_reserve_preempt_off(&ctx, event->id);
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(event, ret);
+		return;
+	}
+	serialize_write(chan, &ctx, event->desc, stack_data, dynamic_len);
+	chan->ops->event_commit_preempt_off(&ctx);
+}
+EXPORT_SYMBOL_GPL(lttng_event_serialize);
@@ -0,0 +1,292 @@
+/*
+ * lttng-event-summary.c
+ *
+ * LTTng event summaries. The hits of an event with the SUMMARY action
+ * are counted per CPU and per summary key instead of being recorded.
+ * At each switch timer of the channel buffer of a CPU, one
+ * lttng_event_summary record is written for each key hit on that CPU
+ * since the previous period.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+#include <linux/hash.h>
+#include <asm/local64.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <wrapper/ringbuffer/frontend.h>
+
+#define LTTNG_EVENT_SUMMARY_BITS	6
+#define LTTNG_EVENT_SUMMARY_SLOTS	(1U << LTTNG_EVENT_SUMMARY_BITS)
+/* Maximum number of slots probed before counting a hit as overflow. */
+#define LTTNG_EVENT_SUMMARY_MAX_PROBE	8
+/* Key of the summary of the hits which found no free slot. */
+#define LTTNG_EVENT_SUMMARY_OVERFLOW	(~0ULL)
+
+enum lttng_event_summary_slot_state {
+	LTTNG_EVENT_SUMMARY_FREE	= 0,
+	LTTNG_EVENT_SUMMARY_CLAIMED,	/* Keys being written */
+	LTTNG_EVENT_SUMMARY_READY,
+};
+
+/*
+ * Slots keep their key once claimed: a key hit again in a later period
+ * finds its slot back. Counts are taken and reset at each flush.
+ */
+struct lttng_event_summary_slot {
+	local_t state;
+	uint32_t subkey;
+	uint64_t key;
+	local64_t count;
+	local64_t total;		/* Sum of the summary values */
+};
+
+struct lttng_event_summary_cpu {
+	local64_t overflow;
+	local64_t overflow_total;
+	struct lttng_event_summary_slot slots[LTTNG_EVENT_SUMMARY_SLOTS];
+};
+
+struct lttng_event_summary {
+	struct list_head node;		/* chan->summary_head, RCU */
+	struct lttng_event *event;
+	struct lttng_event_summary_cpu __percpu *cpu;
+};
+
+static const struct lttng_event_field lttng_event_summary_fields[] = {
+	{
+		.name = "event_id",
+		.type = __type_integer(uint32_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "subkey",
+		.type = __type_integer(uint32_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "key",
+		.type = __type_integer(uint64_t, 0, 0, 0, __BYTE_ORDER, 16, none),
+	},
+	{
+		.name = "count",
+		.type = __type_integer(uint64_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "total",
+		.type = __type_integer(uint64_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+	},
+};
+
+static const struct lttng_event_desc lttng_event_summary_desc = {
+	.name = "lttng_event_summary",
+	.fields = lttng_event_summary_fields,
+	.nr_fields = ARRAY_SIZE(lttng_event_summary_fields),
+	.owner = THIS_MODULE,
+};
+
+/*
+ * Called from the probe, with preemption disabled. Nested hits from
+ * interrupt context may claim slots concurrently, hence the local
+ * cmpxchg. A slot being claimed is skipped.
+ */
+void lttng_event_summary_hit(struct lttng_event *event,
+		struct lttng_probe_ctx *lttng_probe_ctx)
+{
+	struct lttng_event_summary_cpu *summary_cpu;
+	uint64_t key = lttng_probe_ctx->summary_key;
+	uint32_t subkey = lttng_probe_ctx->summary_subkey;
+	uint64_t value = lttng_probe_ctx->summary_value;
+	unsigned long idx;
+	unsigned int i;
+
+	summary_cpu = this_cpu_ptr(event->summary->cpu);
+	idx = hash_64(key ^ ((uint64_t) subkey << 32), LTTNG_EVENT_SUMMARY_BITS);
+	for (i = 0; i < LTTNG_EVENT_SUMMARY_MAX_PROBE;
+			i++, idx = (idx + 1) & (LTTNG_EVENT_SUMMARY_SLOTS - 1)) {
+		struct lttng_event_summary_slot *slot = &summary_cpu->slots[idx];
+
+		switch (local_read(&slot->state)) {
+		case LTTNG_EVENT_SUMMARY_READY:
+			if (slot->key != key || slot->subkey != subkey)
+				continue;
+			local64_inc(&slot->count);
+			local64_add(value, &slot->total);
+			return;
+		case LTTNG_EVENT_SUMMARY_FREE:
+			if (local_cmpxchg(&slot->state, LTTNG_EVENT_SUMMARY_FREE,
+					LTTNG_EVENT_SUMMARY_CLAIMED)
+					!= LTTNG_EVENT_SUMMARY_FREE)
+				continue;
+			slot->key = key;
+			slot->subkey = subkey;
+			local64_set(&slot->count, 1);
+			local64_set(&slot->total, value);
+			barrier();	/* Keys before the state. */
+			local_set(&slot->state, LTTNG_EVENT_SUMMARY_READY);
+			return;
+		default:
+			continue;
+		}
+	}
+	local64_inc(&summary_cpu->overflow);
+	local64_add(value, &summary_cpu->overflow_total);
+}
+EXPORT_SYMBOL_GPL(lttng_event_summary_hit);
+
+static
+void summary_record(struct lttng_channel *chan, struct lttng_event *event,
+		uint32_t summarized_id, uint32_t subkey, uint64_t key,
+		uint64_t count, uint64_t total)
+{
+	struct lttng_probe_ctx lttng_probe_ctx = {
+		.event = event,
+	};
+	struct lib_ring_buffer_ctx ctx;
+	int ret;
+
+	lttng_event_stats_inc(event, hit);
+	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx,
+			2 * sizeof(uint32_t) + 3 * sizeof(uint64_t),
+			lttng_alignof(uint64_t), -1);
+	ret = chan->ops->event_reserve(&ctx, event->id);
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(event, ret);
+		return;
+	}
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(summarized_id));
+	chan->ops->event_write(&ctx, &summarized_id, sizeof(summarized_id));
+	chan->ops->event_write(&ctx, &subkey, sizeof(subkey));
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(key));
+	chan->ops->event_write(&ctx, &key, sizeof(key));
+	chan->ops->event_write(&ctx, &count, sizeof(count));
+	chan->ops->event_write(&ctx, &total, sizeof(total));
+	chan->ops->event_commit(&ctx);
+}
+
+/*
+ * Called from the switch timer of the buffer of the current CPU, before
+ * the sub-buffer switch, so the summaries close the packet. Counts of
+ * summaries which cannot be recorded are lost.
+ */
+void lttng_channel_summary_flush(struct lttng_channel *chan)
+{
+	struct lttng_event *summary_event = ACCESS_ONCE(chan->summary_event);
+	struct lttng_event_summary *summary;
+
+	if (!summary_event
+			|| unlikely(!ACCESS_ONCE(summary_event->effective_enabled)))
+		return;
+	lttng_list_for_each_entry_rcu(summary, &chan->summary_head, node) {
+		struct lttng_event_summary_cpu *summary_cpu =
+			this_cpu_ptr(summary->cpu);
+		uint64_t count, total;
+		unsigned int i;
+
+		for (i = 0; i < LTTNG_EVENT_SUMMARY_SLOTS; i++) {
+			struct lttng_event_summary_slot *slot =
+				&summary_cpu->slots[i];
+
+			if (local_read(&slot->state) != LTTNG_EVENT_SUMMARY_READY
+					|| !local64_read(&slot->count))
+				continue;
+			count = local64_xchg(&slot->count, 0);
+			total = local64_xchg(&slot->total, 0);
+			summary_record(chan, summary_event, summary->event->id,
+				slot->subkey, slot->key, count, total);
+		}
+		if (local64_read(&summary_cpu->overflow)) {
+			count = local64_xchg(&summary_cpu->overflow, 0);
+			total = local64_xchg(&summary_cpu->overflow_total, 0);
+			summary_record(chan, summary_event, summary->event->id,
+				0, LTTNG_EVENT_SUMMARY_OVERFLOW, count, total);
+		}
+	}
+}
+EXPORT_SYMBOL_GPL(lttng_channel_summary_flush);
+
+/*
+ * Summaries are flushed by the switch timer of each per-CPU buffer, run
+ * on its CPU. The summary state and the definition event live until the
+ * session is destroyed, like the other events of the channel.
+ * Should be called with sessions mutex held.
+ */
+int lttng_event_summary_create(struct lttng_event *event)
+{
+	struct lttng_channel *chan = event->chan;
+	struct lttng_event_summary *summary;
+
+	if (event->summary)
+		return 0;
+	if (chan->channel_type != PER_CPU_CHANNEL
+			|| chan->chan->backend.config.alloc != RING_BUFFER_ALLOC_PER_CPU
+			|| !chan->chan->switch_timer_interval)
+		return -EINVAL;
+	summary = kzalloc(sizeof(*summary), GFP_KERNEL);
+	if (!summary)
+		return -ENOMEM;
+	summary->cpu = alloc_percpu(struct lttng_event_summary_cpu);
+	if (!summary->cpu) {
+		kfree(summary);
+		return -ENOMEM;
+	}
+	summary->event = event;
+	if (!chan->summary_event) {
+		struct lttng_kernel_event ev;
+		struct lttng_event *summary_event;
+
+		memset(&ev, 0, sizeof(ev));
+		strncpy(ev.name, lttng_event_summary_desc.name,
+			LTTNG_KERNEL_SYM_NAME_LEN);
+		ev.name[LTTNG_KERNEL_SYM_NAME_LEN - 1] = '\0';
+		ev.instrumentation = LTTNG_KERNEL_NOOP;
+		summary_event = _lttng_event_create(chan, &ev, NULL,
+				&lttng_event_summary_desc, ev.instrumentation);
+		if (IS_ERR(summary_event)) {
+			free_percpu(summary->cpu);
+			kfree(summary);
+			return PTR_ERR(summary_event);
+		}
+		/* Noop events need to be explicitly enabled. */
+		ACCESS_ONCE(summary_event->enabled) = 1;
+		lttng_event_update_effective_enabled(summary_event);
+		ACCESS_ONCE(chan->summary_event) = summary_event;
+	}
+	/* Populate summary state before the probe can observe it. */
+	smp_wmb();
+	ACCESS_ONCE(event->summary) = summary;
+	list_add_tail_rcu(&summary->node, &chan->summary_head);
+	return 0;
+}
+
+/*
+ * Called on event destroy. Probes no longer observe the summary, and
+ * neither do switch timers: the summary event is disabled with the
+ * session before the trace synchronization.
+ */
+void lttng_event_summary_destroy(struct lttng_event *event)
+{
+	struct lttng_event_summary *summary = event->summary;
+
+	if (!summary)
+		return;
+	list_del(&summary->node);
+	free_percpu(summary->cpu);
+	kfree(summary);
+}
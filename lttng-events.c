@@ -40,6 +40,8 @@
 #include <linux/jhash.h>
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
+#include <linux/math64.h>
+#include <linux/log2.h>
 
 #include <wrapper/uuid.h>
 #include <wrapper/vmalloc.h>	/* for wrapper_vmalloc_sync_all() */
@@ -47,33 +49,55 @@
 #include <wrapper/tracepoint.h>
 #include <wrapper/list.h>
 #include <wrapper/types.h>
+#include <wrapper/pid_namespace.h>
+#include <wrapper/rcu.h>
+#include <wrapper/atomic.h>
 #include <lttng-kernel-version.h>
+#include <wrapper/vzalloc.h>
 #include <lttng-events.h>
 #include <lttng-tracer.h>
 #include <lttng-abi-old.h>
 #include <lttng-endian.h>
 #include <lttng-string-utils.h>
-#include <wrapper/vzalloc.h>
 #include <wrapper/ringbuffer/backend.h>
+#include <wrapper/ringbuffer/crash.h>
 #include <wrapper/ringbuffer/frontend.h>
 
 #define METADATA_CACHE_DEFAULT_SIZE 4096
+#define METADATA_CACHE_DEFAULT_CHUNKS 16
+#define METADATA_CACHE_DEFAULT_SEGMENTS 64
 
 static LIST_HEAD(sessions);
 static LIST_HEAD(lttng_transport_list);
+static LIST_HEAD(event_fanouts);
 /*
  * Protect the sessions and metadata caches.
  */
 static DEFINE_MUTEX(sessions_mutex);
 static struct kmem_cache *event_cache;
+/* Frees the buffers and events of destroyed sessions, see destroy work. */
+static struct workqueue_struct *lttng_destroy_wq;
 
-static void lttng_session_lazy_sync_enablers(struct lttng_session *session);
 static void lttng_session_sync_enablers(struct lttng_session *session);
+static void lttng_session_sync_enablers_batched(struct lttng_session *session);
+static void lttng_enabler_lazy_sync(struct lttng_enabler *enabler);
+static void lttng_event_sync_state(struct lttng_event *event);
 static void lttng_enabler_destroy(struct lttng_enabler *enabler);
+static void lttng_session_budget_work(struct work_struct *work);
+static void lttng_channel_autotune_work(struct work_struct *work);
+static struct lttng_transport *lttng_transport_find(const char *name);
+#ifdef CONFIG_IRQ_WORK
+static void lttng_session_action_irq_work(struct irq_work *entry);
+static void lttng_session_action_work(struct work_struct *work);
+#endif
 
 static void _lttng_event_destroy(struct lttng_event *event);
 static void _lttng_channel_destroy(struct lttng_channel *chan);
+static void lttng_session_destroy_work(struct work_struct *work);
+static void lttng_session_statedump_work(struct work_struct *work);
+static void lttng_channel_destroy_work(struct work_struct *work);
 static int _lttng_event_unregister(struct lttng_event *event);
+static void lttng_event_fanout_gc(void);
 static
 int _lttng_event_metadata_statedump(struct lttng_session *session,
 				  struct lttng_channel *chan,
@@ -83,9 +107,68 @@ int _lttng_session_metadata_statedump(struct lttng_session *session);
 static
 void _lttng_metadata_channel_hangup(struct lttng_metadata_stream *stream);
 static
-int _lttng_field_statedump(struct lttng_session *session,
+int _lttng_field_statedump(struct lttng_metadata_fragment *frag,
 		const struct lttng_event_field *field,
 		size_t nesting);
+static
+void lttng_enum_decls_free(struct lttng_session *session);
+
+/*
+ * Insert or remove the kprobe and uprobe breakpoints, function tracing
+ * hooks or perf sampling counters of an event according to its
+ * effective enable state.
+ * Tracepoint and syscall events are registered and unregistered by the
+ * enablers instead.
+ */
+static
+int lttng_event_arm(struct lttng_event *event)
+{
+	switch (event->instrumentation) {
+	case LTTNG_KERNEL_KPROBE:
+		return lttng_kprobes_event_arm(event);
+	case LTTNG_KERNEL_KRETPROBE:
+		return lttng_kretprobes_event_arm(event);
+	case LTTNG_KERNEL_FUNCTION:
+		return lttng_ftrace_event_arm(event);
+	case LTTNG_KERNEL_PERF_SAMPLE:
+		return lttng_perf_sample_event_arm(event);
+	case LTTNG_KERNEL_UPROBE:
+		return lttng_uprobes_event_arm(event);
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Update the effective enable state of the session events, or only of
+ * those of "chan" if non-NULL, and arm or disarm their instrumentation
+ * accordingly. Returns the first arming error.
+ */
+static
+int lttng_session_update_effective_enabled(struct lttng_session *session,
+		struct lttng_channel *chan)
+{
+	struct lttng_channel *iter;
+	struct lttng_event *event;
+	int ret = 0, err;
+
+	list_for_each_entry(iter, &session->chan, list) {
+		if (chan && iter != chan)
+			continue;
+		err = lttng_syscalls_arm(iter);
+		if (err && !ret)
+			ret = err;
+	}
+	list_for_each_entry(event, &session->events, list) {
+		if (chan && event->chan != chan)
+			continue;
+		lttng_event_update_effective_enabled(event);
+		err = lttng_event_arm(event);
+		if (err && !ret)
+			ret = err;
+	}
+	return ret;
+}
 
 void synchronize_trace(void)
 {
@@ -125,11 +208,223 @@ int lttng_session_active(void)
 	return 0;
 }
 
+static
+void metadata_cache_put_segments(struct lttng_metadata_cache *cache)
+{
+	unsigned int i;
+
+	for (i = 0; i < cache->nr_segments; i++) {
+		if (cache->segments[i].shared)
+			lttng_metadata_shared_put(cache->segments[i].shared);
+	}
+	cache->nr_segments = 0;
+}
+
+static
+void metadata_cache_free_chunks(struct lttng_metadata_cache *cache)
+{
+	unsigned int i;
+
+	metadata_cache_put_segments(cache);
+	kfree(cache->segments);
+	for (i = 0; i < cache->nr_chunks; i++)
+		free_page((unsigned long) cache->chunks[i]);
+	kfree(cache->chunks);
+	kfree(cache->scratch);
+}
+
+/*
+ * Ensure the metadata cache can hold "size" bytes. Existing chunks are
+ * kept in place, only the array of chunk pointers is reallocated.
+ */
+static
+int metadata_cache_grow(struct lttng_metadata_cache *cache, size_t size)
+{
+	unsigned int nr_chunks = DIV_ROUND_UP(size, METADATA_CACHE_CHUNK_SIZE);
+
+	if (nr_chunks > cache->max_chunks) {
+		unsigned int max_chunks = max_t(unsigned int, nr_chunks,
+				max_t(unsigned int, cache->max_chunks << 1,
+					METADATA_CACHE_DEFAULT_CHUNKS));
+		char **chunks;
+
+		chunks = krealloc(cache->chunks, max_chunks * sizeof(*chunks),
+				GFP_KERNEL);
+		if (!chunks)
+			return -ENOMEM;
+		cache->chunks = chunks;
+		cache->max_chunks = max_chunks;
+	}
+	while (cache->nr_chunks < nr_chunks) {
+		char *chunk = (char *) get_zeroed_page(GFP_KERNEL);
+
+		if (!chunk)
+			return -ENOMEM;
+		cache->chunks[cache->nr_chunks++] = chunk;
+		cache->cache_alloc += METADATA_CACHE_CHUNK_SIZE;
+	}
+	return 0;
+}
+
+/*
+ * Copy "len" bytes from "src" at offset "pos" of the metadata cache,
+ * which must already be allocated.
+ */
+static
+void metadata_cache_write(struct lttng_metadata_cache *cache, size_t pos,
+		const char *src, size_t len)
+{
+	while (len) {
+		size_t offset = pos & (METADATA_CACHE_CHUNK_SIZE - 1);
+		size_t copy_len = min_t(size_t, len,
+				METADATA_CACHE_CHUNK_SIZE - offset);
+
+		memcpy(cache->chunks[pos >> METADATA_CACHE_CHUNK_SHIFT] + offset,
+			src, copy_len);
+		pos += copy_len;
+		src += copy_len;
+		len -= copy_len;
+	}
+}
+
+/*
+ * Append a run of "len" bytes at the end of the metadata cache, written
+ * in the chunks if "shared" is NULL, else referencing the shared text.
+ * Runs written in the chunks back to back are merged.
+ */
+static
+int metadata_cache_append_segment(struct lttng_metadata_cache *cache,
+		size_t len, struct lttng_metadata_shared *shared)
+{
+	struct lttng_metadata_segment *seg;
+
+	if (!shared && cache->nr_segments) {
+		seg = &cache->segments[cache->nr_segments - 1];
+		if (!seg->shared) {
+			seg->len += len;
+			return 0;
+		}
+	}
+	if (cache->nr_segments == cache->max_segments) {
+		unsigned int max_segments = max_t(unsigned int,
+				cache->max_segments << 1,
+				METADATA_CACHE_DEFAULT_SEGMENTS);
+
+		seg = krealloc(cache->segments, max_segments * sizeof(*seg),
+				GFP_KERNEL);
+		if (!seg)
+			return -ENOMEM;
+		cache->cache_alloc += (max_segments - cache->max_segments)
+				* sizeof(*seg);
+		cache->segments = seg;
+		cache->max_segments = max_segments;
+	}
+	seg = &cache->segments[cache->nr_segments++];
+	seg->pos = cache->metadata_written;
+	seg->len = len;
+	seg->shared = shared;
+	seg->chunk_pos = cache->chunk_written;
+	if (shared)
+		kref_get(&shared->ref);
+	return 0;
+}
+
+/*
+ * Returns the segment holding position "pos" of the metadata, which must
+ * have been written.
+ */
+static
+const struct lttng_metadata_segment *
+	metadata_cache_find_segment(const struct lttng_metadata_cache *cache,
+		size_t pos)
+{
+	unsigned int low = 0, high = cache->nr_segments - 1;
+
+	while (low < high) {
+		unsigned int mid = (low + high + 1) >> 1;
+
+		if (cache->segments[mid].pos <= pos)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+	return &cache->segments[low];
+}
+
+static
+struct hlist_head *lttng_event_ht_alloc(unsigned int bits)
+{
+	size_t size = sizeof(struct hlist_head) << bits;
+
+	/* Zeroed hlist heads are empty. */
+	if (size <= PAGE_SIZE)
+		return kzalloc(size, GFP_KERNEL);
+	return lttng_vzalloc(size);
+}
+
+static
+void lttng_event_ht_free(struct hlist_head *table)
+{
+	if (is_vmalloc_addr(table))
+		vfree(table);
+	else
+		kfree(table);
+}
+
+static
+struct hlist_head *lttng_event_ht_head(struct lttng_event_ht *ht,
+		uint32_t hash)
+{
+	return &ht->table[hash & ((1U << ht->bits) - 1)];
+}
+
+/*
+ * The table is only accessed with the sessions mutex held, so it is
+ * rehashed in place of the old one. If the larger table cannot be
+ * allocated, the current one is kept.
+ */
+static
+void lttng_event_ht_grow(struct lttng_event_ht *ht)
+{
+	unsigned int bits = ht->bits + 1, i;
+	struct hlist_head *table;
+
+	table = lttng_event_ht_alloc(bits);
+	if (!table)
+		return;
+	for (i = 0; i < (1U << ht->bits); i++) {
+		struct lttng_event *event;
+		struct hlist_node *tmp;
+
+		lttng_hlist_for_each_entry_safe(event, tmp, &ht->table[i],
+				hlist) {
+			uint32_t hash = jhash(event->desc->name,
+					strlen(event->desc->name), 0);
+
+			hlist_del(&event->hlist);
+			hlist_add_head(&event->hlist,
+				&table[hash & ((1U << bits) - 1)]);
+		}
+	}
+	lttng_event_ht_free(ht->table);
+	ht->table = table;
+	ht->bits = bits;
+}
+
+static
+void lttng_event_ht_add(struct lttng_event_ht *ht, struct hlist_head *head,
+		struct lttng_event *event)
+{
+	hlist_add_head(&event->hlist, head);
+	if (++ht->nr_events > (1U << ht->bits)
+			&& ht->bits < LTTNG_EVENT_HT_MAX_BITS)
+		lttng_event_ht_grow(ht);
+}
+
 struct lttng_session *lttng_session_create(void)
 {
 	struct lttng_session *session;
 	struct lttng_metadata_cache *metadata_cache;
-	int i;
 
 	mutex_lock(&sessions_mutex);
 	session = kzalloc(sizeof(struct lttng_session), GFP_KERNEL);
@@ -137,30 +432,41 @@ struct lttng_session *lttng_session_create(void)
 		goto err;
 	INIT_LIST_HEAD(&session->chan);
 	INIT_LIST_HEAD(&session->events);
+	mutex_init(&session->lock);
 	uuid_le_gen(&session->uuid);
 
 	metadata_cache = kzalloc(sizeof(struct lttng_metadata_cache),
 			GFP_KERNEL);
 	if (!metadata_cache)
 		goto err_free_session;
-	metadata_cache->data = lttng_vzalloc(METADATA_CACHE_DEFAULT_SIZE);
-	if (!metadata_cache->data)
+	if (metadata_cache_grow(metadata_cache, METADATA_CACHE_DEFAULT_SIZE))
 		goto err_free_cache;
-	metadata_cache->cache_alloc = METADATA_CACHE_DEFAULT_SIZE;
 	kref_init(&metadata_cache->refcount);
 	mutex_init(&metadata_cache->lock);
 	session->metadata_cache = metadata_cache;
 	INIT_LIST_HEAD(&metadata_cache->metadata_stream);
 	memcpy(&metadata_cache->uuid, &session->uuid,
 		sizeof(metadata_cache->uuid));
+	metadata_cache_crash_init(metadata_cache);
 	INIT_LIST_HEAD(&session->enablers_head);
-	for (i = 0; i < LTTNG_EVENT_HT_SIZE; i++)
-		INIT_HLIST_HEAD(&session->events_ht.table[i]);
+	session->events_ht.table = lttng_event_ht_alloc(LTTNG_EVENT_HT_MIN_BITS);
+	if (!session->events_ht.table)
+		goto err_free_cache;
+	session->events_ht.bits = LTTNG_EVENT_HT_MIN_BITS;
+	INIT_DELAYED_WORK(&session->budget_work, lttng_session_budget_work);
+	INIT_WORK(&session->destroy_work, lttng_session_destroy_work);
+	INIT_WORK(&session->statedump_work, lttng_session_statedump_work);
+	init_waitqueue_head(&session->statedump_wait);
+#ifdef CONFIG_IRQ_WORK
+	init_irq_work(&session->action_irq_work, lttng_session_action_irq_work);
+	INIT_WORK(&session->action_work, lttng_session_action_work);
+#endif
 	list_add(&session->list, &sessions);
 	mutex_unlock(&sessions_mutex);
 	return session;
 
 err_free_cache:
+	metadata_cache_free_chunks(metadata_cache);
 	kfree(metadata_cache);
 err_free_session:
 	kfree(session);
@@ -168,68 +474,229 @@ err:
 	mutex_unlock(&sessions_mutex);
 	return NULL;
 }
+EXPORT_SYMBOL_GPL(lttng_session_create);
+
+static
+void metadata_cache_crash_init(struct lttng_metadata_cache *cache)
+{
+	struct lttng_metadata_crash_desc *desc = &cache->crash;
+
+	desc->magic = LTTNG_METADATA_CRASH_MAGIC;
+	desc->version = LTTNG_METADATA_CRASH_VERSION;
+	desc->size = sizeof(*desc);
+	memcpy(desc->uuid, &cache->uuid, sizeof(desc->uuid));
+	desc->cache = (uint64_t) (unsigned long) cache;
+	desc->chunk_shift = METADATA_CACHE_CHUNK_SHIFT;
+	desc->chunk_size = METADATA_CACHE_CHUNK_SIZE;
+	desc->segment_size = sizeof(struct lttng_metadata_segment);
+	desc->chunks = offsetof(struct lttng_metadata_cache, chunks);
+	desc->segments = offsetof(struct lttng_metadata_cache, segments);
+	desc->nr_segments = offsetof(struct lttng_metadata_cache, nr_segments);
+	desc->chunk_written = offsetof(struct lttng_metadata_cache,
+			chunk_written);
+	desc->metadata_written = offsetof(struct lttng_metadata_cache,
+			metadata_written);
+	desc->seg_pos = offsetof(struct lttng_metadata_segment, pos);
+	desc->seg_len = offsetof(struct lttng_metadata_segment, len);
+	desc->seg_shared = offsetof(struct lttng_metadata_segment, shared);
+	desc->seg_chunk_pos = offsetof(struct lttng_metadata_segment,
+			chunk_pos);
+	desc->shared_data = offsetof(struct lttng_metadata_shared, data);
+}
 
 void metadata_cache_destroy(struct kref *kref)
 {
 	struct lttng_metadata_cache *cache =
 		container_of(kref, struct lttng_metadata_cache, refcount);
-	vfree(cache->data);
+	metadata_cache_free_chunks(cache);
 	kfree(cache);
 }
 
-void lttng_session_destroy(struct lttng_session *session)
+static
+void lttng_session_free(struct lttng_session *session)
+{
+	kref_put(&session->metadata_cache->refcount, metadata_cache_destroy);
+	lttng_event_ht_free(session->events_ht.table);
+	lttng_enum_decls_free(session);
+	lttng_statedump_session_destroy(session);
+	kfree(session->cpu_mask);
+	kfree(session->page_pool);
+	kfree(session);
+}
+
+/*
+ * The buffers of each channel are freed by a work of their own: the
+ * channels of a session are freed in parallel. The last one to complete
+ * frees the session.
+ */
+static
+void lttng_channel_destroy_work(struct work_struct *work)
+{
+	struct lttng_channel *chan =
+		container_of(work, struct lttng_channel, destroy_work);
+	struct lttng_session *session = chan->session;
+
+	_lttng_channel_destroy(chan);
+	if (atomic_dec_and_test(&session->destroy_refs))
+		lttng_session_free(session);
+}
+
+/*
+ * Second half of the session destruction, after its probes are
+ * unregistered and it is removed from the session list.
+ */
+static
+void lttng_session_destroy_work(struct work_struct *work)
 {
+	struct lttng_session *session =
+		container_of(work, struct lttng_session, destroy_work);
 	struct lttng_channel *chan, *tmpchan;
 	struct lttng_event *event, *tmpevent;
-	struct lttng_metadata_stream *metadata_stream;
 	struct lttng_enabler *enabler, *tmpenabler;
+
+	synchronize_trace();	/* Wait for in-flight events to complete */
+	mutex_lock(&sessions_mutex);
+	list_for_each_entry_safe(enabler, tmpenabler,
+			&session->enablers_head, node)
+		lttng_enabler_destroy(enabler);
+	list_for_each_entry_safe(event, tmpevent, &session->events, list)
+		_lttng_event_destroy(event);
+	lttng_event_fanout_gc();
+	mutex_unlock(&sessions_mutex);
+	if (session->pid_tracker)
+		lttng_pid_tracker_destroy(session->pid_tracker);
+	if (session->pid_ns_tracker)
+		lttng_pid_tracker_destroy(session->pid_ns_tracker);
+	atomic_set(&session->destroy_refs, 1);
+	list_for_each_entry_safe(chan, tmpchan, &session->chan, list) {
+		BUG_ON(chan->channel_type == METADATA_CHANNEL);
+		/* Channel works run concurrently: take it off the list. */
+		list_del_init(&chan->list);
+		atomic_inc(&session->destroy_refs);
+		INIT_WORK(&chan->destroy_work, lttng_channel_destroy_work);
+		queue_work(lttng_destroy_wq, &chan->destroy_work);
+	}
+	if (atomic_dec_and_test(&session->destroy_refs))
+		lttng_session_free(session);
+}
+
+/*
+ * Only stops the session and unregisters its probes with the sessions
+ * mutex held: its events and buffers are freed by lttng_destroy_wq,
+ * without blocking the control operations of the other sessions.
+ */
+void lttng_session_destroy(struct lttng_session *session)
+{
+	struct lttng_channel *chan;
+	struct lttng_event *event;
+	struct lttng_metadata_stream *metadata_stream;
 	int ret;
 
+	/* The statedump worker takes the session lock. */
+	flush_work(&session->statedump_work);
+	/* The budget, autotune and action workers take the sessions mutex. */
+	mutex_lock(&sessions_mutex);
+	session->budget_permille = 0;
+	list_for_each_entry(chan, &session->chan, list)
+		chan->autotune_mode = LTTNG_KERNEL_CHANNEL_AUTOTUNE_OFF;
+	mutex_unlock(&sessions_mutex);
+	cancel_delayed_work_sync(&session->budget_work);
+	list_for_each_entry(chan, &session->chan, list)
+		cancel_delayed_work_sync(&chan->autotune_work);
+#ifdef CONFIG_IRQ_WORK
+	ACCESS_ONCE(session->actions_disabled) = 1;
+	synchronize_trace();	/* Wait for probes queuing actions */
+	irq_work_sync(&session->action_irq_work);
+	cancel_work_sync(&session->action_work);
+#endif
+
 	mutex_lock(&sessions_mutex);
 	ACCESS_ONCE(session->active) = 0;
+	lttng_session_update_effective_enabled(session, NULL);
 	list_for_each_entry(chan, &session->chan, list) {
 		ret = lttng_syscalls_unregister(chan);
 		WARN_ON(ret);
+		ret = lttng_task_marker_unregister(chan);
+		WARN_ON(ret);
 	}
 	list_for_each_entry(event, &session->events, list) {
 		ret = _lttng_event_unregister(event);
 		WARN_ON(ret);
 	}
-	synchronize_trace();	/* Wait for in-flight events to complete */
-	list_for_each_entry_safe(enabler, tmpenabler,
-			&session->enablers_head, node)
-		lttng_enabler_destroy(enabler);
-	list_for_each_entry_safe(event, tmpevent, &session->events, list)
-		_lttng_event_destroy(event);
-	list_for_each_entry_safe(chan, tmpchan, &session->chan, list) {
-		BUG_ON(chan->channel_type == METADATA_CHANNEL);
-		_lttng_channel_destroy(chan);
-	}
 	list_for_each_entry(metadata_stream, &session->metadata_cache->metadata_stream, list)
 		_lttng_metadata_channel_hangup(metadata_stream);
-	if (session->pid_tracker)
-		lttng_pid_tracker_destroy(session->pid_tracker);
-	kref_put(&session->metadata_cache->refcount, metadata_cache_destroy);
 	list_del(&session->list);
 	mutex_unlock(&sessions_mutex);
-	kfree(session);
+	queue_work(lttng_destroy_wq, &session->destroy_work);
 }
+EXPORT_SYMBOL_GPL(lttng_session_destroy);
 
+/*
+ * A statedump only holds its own session: the statedumps of other
+ * sessions and their control operations can proceed meanwhile.
+ */
 int lttng_session_statedump(struct lttng_session *session)
 {
 	int ret;
 
-	mutex_lock(&sessions_mutex);
+	mutex_lock(&session->lock);
 	ret = lttng_statedump_start(session);
-	mutex_unlock(&sessions_mutex);
+	mutex_unlock(&session->lock);
 	return ret;
 }
 
-int lttng_session_enable(struct lttng_session *session)
+int lttng_session_statedump_delta(struct lttng_session *session,
+		u64 since, unsigned int categories, unsigned int flags,
+		u64 *generation)
+{
+	int ret;
+
+	mutex_lock(&session->lock);
+	ret = lttng_statedump_start_delta(session, since, categories,
+			flags, generation);
+	mutex_unlock(&session->lock);
+	return ret;
+}
+
+/*
+ * Statedump of a session started asynchronously, unless stopped
+ * meanwhile. The session is stopped if the statedump fails, as when
+ * started synchronously.
+ */
+static
+void lttng_session_statedump_work(struct work_struct *work)
+{
+	struct lttng_session *session = container_of(work,
+			struct lttng_session, statedump_work);
+	int ret;
+
+	mutex_lock(&session->lock);
+	if (!ACCESS_ONCE(session->active)) {
+		ret = -ECANCELED;
+		goto end;
+	}
+	ret = lttng_statedump_start(session);
+	if (ret) {
+		mutex_lock(&sessions_mutex);
+		ACCESS_ONCE(session->active) = 0;
+		lttng_session_update_effective_enabled(session, NULL);
+		mutex_unlock(&sessions_mutex);
+	}
+end:
+	session->statedump_ret = ret;
+	smp_wmb();	/* Result before completion */
+	ACCESS_ONCE(session->statedump_pending) = 0;
+	mutex_unlock(&session->lock);
+	wake_up_interruptible(&session->statedump_wait);
+}
+
+static
+int _lttng_session_enable(struct lttng_session *session, int async)
 {
 	int ret = 0;
 	struct lttng_channel *chan;
 
+	mutex_lock(&session->lock);
 	mutex_lock(&sessions_mutex);
 	if (session->active) {
 		ret = -EBUSY;
@@ -249,7 +716,7 @@ int lttng_session_enable(struct lttng_session *session)
 		if (chan->free_event_id < 31)
 			chan->header_type = 1;	/* compact */
 		else
-			chan->header_type = 2;	/* large */
+			chan->header_type = 3;	/* dense */
 	}
 
 	/* We need to sync enablers with session before activation. */
@@ -257,67 +724,423 @@ int lttng_session_enable(struct lttng_session *session)
 
 	/* Clear each stream's quiescent state. */
 	list_for_each_entry(chan, &session->chan, list) {
-		if (chan->channel_type != METADATA_CHANNEL)
+		if (chan->channel_type == PER_CPU_CHANNEL)
 			lib_ring_buffer_clear_quiescent_channel(chan->chan);
 	}
 
 	ACCESS_ONCE(session->active) = 1;
 	ACCESS_ONCE(session->been_active) = 1;
+	ret = lttng_session_update_effective_enabled(session, NULL);
+	if (ret) {
+		ACCESS_ONCE(session->active) = 0;
+		lttng_session_update_effective_enabled(session, NULL);
+		goto end;
+	}
 	ret = _lttng_session_metadata_statedump(session);
 	if (ret) {
 		ACCESS_ONCE(session->active) = 0;
+		lttng_session_update_effective_enabled(session, NULL);
 		goto end;
 	}
+	mutex_unlock(&sessions_mutex);
+	if (async) {
+		/* Picks up a pending statedump, if not started yet. */
+		ACCESS_ONCE(session->statedump_pending) = 1;
+		queue_work(system_unbound_wq, &session->statedump_work);
+		mutex_unlock(&session->lock);
+		return 0;
+	}
+	/* The session lock keeps it from being stopped meanwhile. */
 	ret = lttng_statedump_start(session);
-	if (ret)
+	if (ret) {
+		mutex_lock(&sessions_mutex);
 		ACCESS_ONCE(session->active) = 0;
+		lttng_session_update_effective_enabled(session, NULL);
+		mutex_unlock(&sessions_mutex);
+	}
+	mutex_unlock(&session->lock);
+	return ret;
+
 end:
 	mutex_unlock(&sessions_mutex);
+	mutex_unlock(&session->lock);
 	return ret;
 }
 
-int lttng_session_disable(struct lttng_session *session)
+int lttng_session_enable(struct lttng_session *session)
+{
+	return _lttng_session_enable(session, 0);
+}
+EXPORT_SYMBOL_GPL(lttng_session_enable);
+
+/*
+ * Returns once the session is active, its statedump recorded in the
+ * background: statedump_pending is cleared when it is done.
+ */
+int lttng_session_enable_async(struct lttng_session *session)
+{
+	return _lttng_session_enable(session, 1);
+}
+EXPORT_SYMBOL_GPL(lttng_session_enable_async);
+
+/*
+ * Session setup commands issued between batch begin and commit, on any
+ * file descriptor of the session, do not resynchronize the events with
+ * the enablers one by one: the commit does it once for all of them.
+ * Starting or stopping the session within a batch synchronizes all
+ * events as usual.
+ */
+int lttng_session_batch_begin(struct lttng_session *session)
 {
 	int ret = 0;
-	struct lttng_channel *chan;
 
 	mutex_lock(&sessions_mutex);
-	if (!session->active) {
+	if (session->batch) {
 		ret = -EBUSY;
 		goto end;
 	}
-	ACCESS_ONCE(session->active) = 0;
+	session->batch = 1;
+end:
+	mutex_unlock(&sessions_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(lttng_session_batch_begin);
 
-	/* Set transient enabler state to "disabled" */
-	session->tstate = 0;
-	lttng_session_sync_enablers(session);
+int lttng_session_batch_commit(struct lttng_session *session)
+{
+	int ret = 0;
 
-	/* Set each stream's quiescent state. */
-	list_for_each_entry(chan, &session->chan, list) {
-		if (chan->channel_type != METADATA_CHANNEL)
-			lib_ring_buffer_set_quiescent_channel(chan->chan);
+	mutex_lock(&sessions_mutex);
+	if (!session->batch) {
+		ret = -EINVAL;
+		goto end;
 	}
+	session->batch = 0;
+	if (session->batch_sync_pending)
+		lttng_session_sync_enablers(session);
 end:
 	mutex_unlock(&sessions_mutex);
 	return ret;
 }
+EXPORT_SYMBOL_GPL(lttng_session_batch_commit);
 
-int lttng_session_metadata_regenerate(struct lttng_session *session)
+/*
+ * The mask applies to the buffers of the channels created afterwards:
+ * it can only be set before the first one. On success, the session
+ * owns the mask.
+ */
+int lttng_session_set_cpu_mask(struct lttng_session *session,
+		struct cpumask *mask)
 {
-	int ret = 0;
 	struct lttng_channel *chan;
-	struct lttng_event *event;
-	struct lttng_metadata_cache *cache = session->metadata_cache;
-	struct lttng_metadata_stream *stream;
+	int ret = 0;
 
+	if (mask && !cpumask_intersects(mask, cpu_possible_mask))
+		return -EINVAL;
 	mutex_lock(&sessions_mutex);
-	if (!session->active) {
+	if (session->been_active) {
+		ret = -EBUSY;
+		goto end;
+	}
+	list_for_each_entry(chan, &session->chan, list) {
+		if (chan->channel_type != METADATA_CHANNEL) {
+			ret = -EBUSY;
+			goto end;
+		}
+	}
+	kfree(session->cpu_mask);
+	session->cpu_mask = mask;
+end:
+	mutex_unlock(&sessions_mutex);
+	return ret;
+}
+
+/*
+ * The channels draw their buffer pages from the session pool: the cap
+ * can only be set before the first one.
+ */
+int lttng_session_set_memory_cap(struct lttng_session *session,
+		uint64_t max_bytes)
+{
+	struct lib_ring_buffer_page_pool *pool = NULL;
+	struct lttng_channel *chan;
+	int ret = 0;
+
+	if (max_bytes) {
+		if (max_bytes >> PAGE_SHIFT > ULONG_MAX)
+			return -EINVAL;
+		pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+		if (!pool)
+			return -ENOMEM;
+		pool->max_pages = max_t(unsigned long,
+				max_bytes >> PAGE_SHIFT, 1);
+	}
+	mutex_lock(&sessions_mutex);
+	if (session->been_active) {
+		ret = -EBUSY;
+		goto end;
+	}
+	list_for_each_entry(chan, &session->chan, list) {
+		if (chan->channel_type != METADATA_CHANNEL) {
+			ret = -EBUSY;
+			goto end;
+		}
+	}
+	swap(session->page_pool, pool);
+end:
+	mutex_unlock(&sessions_mutex);
+	kfree(pool);
+	return ret;
+}
+
+int lttng_session_disable(struct lttng_session *session)
+{
+	int ret = 0;
+	struct lttng_channel *chan;
+
+	mutex_lock(&session->lock);
+	mutex_lock(&sessions_mutex);
+	if (!session->active) {
+		ret = -EBUSY;
+		goto end;
+	}
+	ACCESS_ONCE(session->active) = 0;
+	lttng_session_update_effective_enabled(session, NULL);
+
+	/* Set transient enabler state to "disabled" */
+	session->tstate = 0;
+	lttng_session_sync_enablers(session);
+
+	/* Set each stream's quiescent state. */
+	list_for_each_entry(chan, &session->chan, list) {
+		if (chan->channel_type == PER_CPU_CHANNEL)
+			lib_ring_buffer_set_quiescent_channel(chan->chan);
+	}
+end:
+	mutex_unlock(&sessions_mutex);
+	mutex_unlock(&session->lock);
+	return ret;
+}
+
+#ifdef CONFIG_IRQ_WORK
+static
+void lttng_session_action_work(struct work_struct *work)
+{
+	struct lttng_session *session = container_of(work,
+			struct lttng_session, action_work);
+
+	(void) lttng_session_disable(session);
+	/* Later stops find the session inactive. */
+	lttng_smp_mb__before_atomic();
+	clear_bit(0, &session->action_pending);
+}
+
+/* Hard interrupt context: defer to a worker, which may sleep. */
+static
+void lttng_session_action_irq_work(struct irq_work *entry)
+{
+	struct lttng_session *session = container_of(entry,
+			struct lttng_session, action_irq_work);
+
+	schedule_work(&session->action_work);
+}
+
+/*
+ * Called from probes, which may run in NMI context or with scheduler
+ * locks held: only irq_work can be queued from there.
+ */
+void lttng_session_action_stop(struct lttng_session *session)
+{
+	if (unlikely(ACCESS_ONCE(session->actions_disabled)))
+		return;
+	if (test_and_set_bit(0, &session->action_pending))
+		return;
+	irq_work_queue(&session->action_irq_work);
+}
+#else
+void lttng_session_action_stop(struct lttng_session *session)
+{
+}
+#endif
+EXPORT_SYMBOL_GPL(lttng_session_action_stop);
+
+/*
+ * The action applies to the following hits which pass the filters of
+ * the event, in addition to recording them, or instead of it for
+ * SUMMARY.
+ */
+int lttng_event_set_action(struct lttng_event *event,
+		const struct lttng_kernel_event_action *action)
+{
+	int ret;
+
+	switch (action->action) {
+	case LTTNG_KERNEL_EVENT_ACTION_RECORD:
+	case LTTNG_KERNEL_EVENT_ACTION_COUNT:
+		break;
+	case LTTNG_KERNEL_EVENT_ACTION_STOP_SESSION:
+	case LTTNG_KERNEL_EVENT_ACTION_NOTIFY:
+#ifdef CONFIG_IRQ_WORK
+		break;
+#else
+		return -ENOSYS;
+#endif
+	case LTTNG_KERNEL_EVENT_ACTION_SUMMARY:
+		mutex_lock(&sessions_mutex);
+		ret = lttng_event_summary_create(event);
+		mutex_unlock(&sessions_mutex);
+		if (ret)
+			return ret;
+		break;
+	default:
+		return -EINVAL;
+	}
+	/* Probes may see the new action with the previous token. */
+	ACCESS_ONCE(event->action_token) = action->token;
+	ACCESS_ONCE(event->action) = action->action;
+	return 0;
+}
+
+#ifdef CONFIG_IRQ_WORK
+static
+void lttng_notification_wakeup(struct irq_work *entry)
+{
+	struct lttng_notification *notification = container_of(entry,
+			struct lttng_notification, wakeup);
+
+	wake_up_interruptible(&notification->buf->read_wait);
+}
+
+/*
+ * Called from probes, in any context. Without notification buffer, the
+ * hit is only counted in "triggered".
+ */
+void lttng_event_notify(struct lttng_event *event)
+{
+	struct lttng_notification *notification;
+	struct lttng_kernel_notification record;
+	struct lib_ring_buffer_ctx ctx;
+	int ret;
+
+	notification = lttng_rcu_dereference(event->chan->session->notification);
+	if (!notification)
+		return;
+	record.token = ACCESS_ONCE(event->action_token);
+	record.timestamp = trace_clock_read64();
+	record.cpu = smp_processor_id();
+	record.tid = current->pid;
+	lib_ring_buffer_ctx_init(&ctx, notification->chan, NULL,
+			sizeof(record), lttng_alignof(uint64_t), -1);
+	ret = notification->transport->ops.event_reserve(&ctx, 0);
+	if (ret < 0) {
+		atomic_long_inc(&notification->lost);
+		return;
+	}
+	notification->transport->ops.event_write(&ctx, &record, sizeof(record));
+	notification->transport->ops.event_commit(&ctx);
+	atomic_long_inc(&notification->produced);
+	irq_work_queue(&notification->wakeup);
+}
+
+/*
+ * A session has at most one notification buffer, destroyed when its
+ * file descriptor is released.
+ */
+struct lttng_notification *lttng_notification_create(
+		struct lttng_session *session,
+		size_t subbuf_size, size_t num_subbuf)
+{
+	struct lttng_notification *notification;
+	struct lttng_transport *transport;
+	int ret;
+
+	notification = kzalloc(sizeof(*notification), GFP_KERNEL);
+	if (!notification)
+		return ERR_PTR(-ENOMEM);
+	mutex_init(&notification->read_lock);
+	init_irq_work(&notification->wakeup, lttng_notification_wakeup);
+	notification->session = session;
+	mutex_lock(&sessions_mutex);
+	if (session->notification) {
+		ret = -EBUSY;
+		goto error;
+	}
+	transport = lttng_transport_find("relay-notification");
+	if (!transport) {
+		printk(KERN_WARNING "LTTng transport relay-notification not found\n");
+		ret = -ENOENT;
+		goto error;
+	}
+	if (!try_module_get(transport->owner)) {
+		printk(KERN_WARNING "LTT : Can't lock transport module.\n");
+		ret = -ENOENT;
+		goto error;
+	}
+	notification->transport = transport;
+	notification->chan = transport->ops.channel_create("relay-notification",
+			NULL, NULL, subbuf_size, num_subbuf, 0, 0);
+	if (!notification->chan) {
+		ret = -EINVAL;
+		goto create_error;
+	}
+	notification->buf = transport->ops.buffer_read_open(notification->chan);
+	if (!notification->buf) {
+		ret = -EBUSY;
+		goto open_error;
+	}
+	rcu_assign_pointer(session->notification, notification);
+	mutex_unlock(&sessions_mutex);
+	return notification;
+
+open_error:
+	transport->ops.channel_destroy(notification->chan);
+create_error:
+	module_put(transport->owner);
+error:
+	mutex_unlock(&sessions_mutex);
+	kfree(notification);
+	return ERR_PTR(ret);
+}
+
+void lttng_notification_destroy(struct lttng_notification *notification)
+{
+	struct lttng_transport *transport = notification->transport;
+
+	mutex_lock(&sessions_mutex);
+	rcu_assign_pointer(notification->session->notification, NULL);
+	mutex_unlock(&sessions_mutex);
+	synchronize_trace();	/* Wait for probes writing notifications */
+	irq_work_sync(&notification->wakeup);
+	transport->ops.buffer_read_close(notification->buf);
+	transport->ops.channel_destroy(notification->chan);
+	module_put(transport->owner);
+	kfree(notification);
+}
+#else
+void lttng_event_notify(struct lttng_event *event)
+{
+}
+#endif
+EXPORT_SYMBOL_GPL(lttng_event_notify);
+
+int lttng_session_metadata_regenerate(struct lttng_session *session)
+{
+	int ret = 0;
+	struct lttng_channel *chan;
+	struct lttng_event *event;
+	struct lttng_metadata_cache *cache = session->metadata_cache;
+	struct lttng_metadata_stream *stream;
+
+	mutex_lock(&sessions_mutex);
+	if (!session->active) {
 		ret = -EBUSY;
 		goto end;
 	}
 
 	mutex_lock(&cache->lock);
-	memset(cache->data, 0, cache->cache_alloc);
+	/* Chunks are kept around for the regenerated metadata. */
+	metadata_cache_put_segments(cache);
+	cache->chunk_written = 0;
 	cache->metadata_written = 0;
 	cache->version++;
 	list_for_each_entry(stream, &session->metadata_cache->metadata_stream, list) {
@@ -327,6 +1150,7 @@ int lttng_session_metadata_regenerate(struct lttng_session *session)
 	mutex_unlock(&cache->lock);
 
 	session->metadata_dumped = 0;
+	lttng_enum_decls_free(session);
 	list_for_each_entry(chan, &session->chan, list) {
 		chan->metadata_dumped = 0;
 	}
@@ -341,6 +1165,7 @@ end:
 	mutex_unlock(&sessions_mutex);
 	return ret;
 }
+EXPORT_SYMBOL_GPL(lttng_session_metadata_regenerate);
 
 
 
@@ -359,9 +1184,17 @@ int lttng_channel_enable(struct lttng_channel *channel)
 	}
 	/* Set transient enabler state to "enabled" */
 	channel->tstate = 1;
-	lttng_session_sync_enablers(channel->session);
+	lttng_session_sync_enablers_batched(channel->session);
 	/* Set atomically the state to "enabled" */
 	ACCESS_ONCE(channel->enabled) = 1;
+	ret = lttng_session_update_effective_enabled(channel->session, channel);
+	if (ret) {
+		ACCESS_ONCE(channel->enabled) = 0;
+		lttng_session_update_effective_enabled(channel->session,
+				channel);
+		channel->tstate = 0;
+		lttng_session_sync_enablers_batched(channel->session);
+	}
 end:
 	mutex_unlock(&sessions_mutex);
 	return ret;
@@ -382,9 +1215,10 @@ int lttng_channel_disable(struct lttng_channel *channel)
 	}
 	/* Set atomically the state to "disabled" */
 	ACCESS_ONCE(channel->enabled) = 0;
+	lttng_session_update_effective_enabled(channel->session, channel);
 	/* Set transient enabler state to "enabled" */
 	channel->tstate = 0;
-	lttng_session_sync_enablers(channel->session);
+	lttng_session_sync_enablers_batched(channel->session);
 end:
 	mutex_unlock(&sessions_mutex);
 	return ret;
@@ -410,8 +1244,19 @@ int lttng_event_enable(struct lttng_event *event)
 		break;
 	case LTTNG_KERNEL_KPROBE:
 	case LTTNG_KERNEL_FUNCTION:
+	case LTTNG_KERNEL_PERF_SAMPLE:
+	case LTTNG_KERNEL_UPROBE:
+		ACCESS_ONCE(event->enabled) = 1;
+		lttng_event_update_effective_enabled(event);
+		ret = lttng_event_arm(event);
+		if (ret) {
+			ACCESS_ONCE(event->enabled) = 0;
+			lttng_event_update_effective_enabled(event);
+		}
+		break;
 	case LTTNG_KERNEL_NOOP:
 		ACCESS_ONCE(event->enabled) = 1;
+		lttng_event_update_effective_enabled(event);
 		break;
 	case LTTNG_KERNEL_KRETPROBE:
 		ret = lttng_kretprobes_event_enable_state(event, 1);
@@ -445,8 +1290,15 @@ int lttng_event_disable(struct lttng_event *event)
 		break;
 	case LTTNG_KERNEL_KPROBE:
 	case LTTNG_KERNEL_FUNCTION:
+	case LTTNG_KERNEL_PERF_SAMPLE:
+	case LTTNG_KERNEL_UPROBE:
+		ACCESS_ONCE(event->enabled) = 0;
+		lttng_event_update_effective_enabled(event);
+		ret = lttng_event_arm(event);
+		break;
 	case LTTNG_KERNEL_NOOP:
 		ACCESS_ONCE(event->enabled) = 0;
+		lttng_event_update_effective_enabled(event);
 		break;
 	case LTTNG_KERNEL_KRETPROBE:
 		ret = lttng_kretprobes_event_enable_state(event, 0);
@@ -500,6 +1352,10 @@ struct lttng_channel *lttng_channel_create(struct lttng_session *session,
 		goto nomem;
 	chan->session = session;
 	chan->id = session->free_chan_id++;
+	/* Walked by the switch timers of the buffers created below. */
+	INIT_LIST_HEAD(&chan->summary_head);
+	INIT_LIST_HEAD(&chan->hot_events_head);
+	INIT_DELAYED_WORK(&chan->autotune_work, lttng_channel_autotune_work);
 	chan->ops = &transport->ops;
 	/*
 	 * Note: the channel creation op already writes into the packet
@@ -511,6 +1367,8 @@ struct lttng_channel *lttng_channel_create(struct lttng_session *session,
 			switch_timer_interval, read_timer_interval);
 	if (!chan->chan)
 		goto create_error;
+	lib_ring_buffer_crash_set_priv(chan->chan,
+			&session->metadata_cache->crash);
 	chan->tstate = 1;
 	chan->enabled = 1;
 	chan->transport = transport;
@@ -529,6 +1387,7 @@ active:
 	mutex_unlock(&sessions_mutex);
 	return NULL;
 }
+EXPORT_SYMBOL_GPL(lttng_channel_create);
 
 /*
  * Only used internally at session destruction for per-cpu channels, and
@@ -538,13 +1397,72 @@ active:
 static
 void _lttng_channel_destroy(struct lttng_channel *chan)
 {
+	struct lttng_hot_event *hot, *tmphot;
+
+	/* The buffers may outlive the metadata cache. */
+	lib_ring_buffer_crash_set_priv(chan->chan, NULL);
 	chan->ops->channel_destroy(chan->chan);
 	module_put(chan->transport->owner);
 	list_del(&chan->list);
 	lttng_destroy_context(chan->ctx);
+	lttng_syscall_latency_destroy(chan);
+	free_percpu(chan->string_dict);
+	lttng_channel_fragment_destroy(chan);
+	list_for_each_entry_safe(hot, tmphot, &chan->hot_events_head, node)
+		kfree(hot);
 	kfree(chan);
 }
 
+/*
+ * Called at channel creation, before any event is created.
+ */
+void lttng_channel_reserve_hot_ids(struct lttng_channel *chan)
+{
+	WARN_ON_ONCE(chan->free_event_id);
+	chan->hot_ids = 1;
+	chan->free_event_id = LTTNG_HOT_EVENT_IDS;
+}
+
+/*
+ * Events created before their declaration keep their id: ids are part
+ * of the metadata of the packets already written.
+ */
+int lttng_channel_add_hot_event(struct lttng_channel *chan, const char *name)
+{
+	struct lttng_hot_event *hot;
+
+	if (!chan->hot_ids)
+		return -EINVAL;
+	hot = kzalloc(sizeof(*hot), GFP_KERNEL);
+	if (!hot)
+		return -ENOMEM;
+	strlcpy(hot->name, name, LTTNG_KERNEL_SYM_NAME_LEN);
+	mutex_lock(&sessions_mutex);
+	list_add_tail(&hot->node, &chan->hot_events_head);
+	mutex_unlock(&sessions_mutex);
+	return 0;
+}
+
+/*
+ * Hot events get the reserved ids while some are left. Called with
+ * sessions mutex held.
+ */
+static
+unsigned int lttng_channel_alloc_event_id(struct lttng_channel *chan,
+		const char *event_name)
+{
+	struct lttng_hot_event *hot;
+
+	if (!chan->hot_ids || chan->free_hot_event_id >= LTTNG_HOT_EVENT_IDS)
+		return chan->free_event_id++;
+	list_for_each_entry(hot, &chan->hot_events_head, node) {
+		if (strutils_star_glob_match(hot->name, LTTNG_SIZE_MAX,
+				event_name, LTTNG_SIZE_MAX))
+			return chan->free_hot_event_id++;
+	}
+	return chan->free_event_id++;
+}
+
 void lttng_metadata_channel_destroy(struct lttng_channel *chan)
 {
 	BUG_ON(chan->channel_type != METADATA_CHANNEL);
@@ -563,6 +1481,52 @@ void _lttng_metadata_channel_hangup(struct lttng_metadata_stream *stream)
 	wake_up_interruptible(&stream->read_wait);
 }
 
+/*
+ * Attach sampling state to an event. The first sampling configuration
+ * applied to an event is kept for its whole lifetime, only its period
+ * being raised by the CPU budget.
+ * Needs to be called with sessions mutex held.
+ */
+static
+int lttng_event_sampling_create(struct lttng_event *event,
+		const struct lttng_kernel_event_sampling *param)
+{
+	struct lttng_event_sampling *sampling;
+
+	if (event->sampling || (param->period <= 1 && !param->rate
+			&& param->flow_period <= 1))
+		return 0;
+	sampling = kzalloc(sizeof(*sampling), GFP_KERNEL);
+	if (!sampling)
+		return -ENOMEM;
+	sampling->state = alloc_percpu(struct lttng_event_sampling_state);
+	if (!sampling->state) {
+		kfree(sampling);
+		return -ENOMEM;
+	}
+	sampling->period = param->period;
+	sampling->flow_period = param->flow_period;
+	if (param->rate) {
+		sampling->rate = param->rate;
+		sampling->max_tokens = (u64) param->burst * NSEC_PER_SEC;
+		sampling->fill_ns = div64_u64(sampling->max_tokens,
+				sampling->rate);
+	}
+	/* Populate sampling state before the probe can observe it. */
+	smp_wmb();
+	ACCESS_ONCE(event->sampling) = sampling;
+	return 0;
+}
+
+static
+void lttng_event_sampling_destroy(struct lttng_event_sampling *sampling)
+{
+	if (!sampling)
+		return;
+	free_percpu(sampling->state);
+	kfree(sampling);
+}
+
 /*
  * Supports event creation while tracing session is active.
  * Needs to be called with sessions mutex held.
@@ -593,6 +1557,8 @@ struct lttng_event *_lttng_event_create(struct lttng_channel *chan,
 	case LTTNG_KERNEL_KPROBE:
 	case LTTNG_KERNEL_KRETPROBE:
 	case LTTNG_KERNEL_FUNCTION:
+	case LTTNG_KERNEL_PERF_SAMPLE:
+	case LTTNG_KERNEL_UPROBE:
 	case LTTNG_KERNEL_NOOP:
 	case LTTNG_KERNEL_SYSCALL:
 		event_name = event_param->name;
@@ -604,7 +1570,7 @@ struct lttng_event *_lttng_event_create(struct lttng_channel *chan,
 	}
 	name_len = strlen(event_name);
 	hash = jhash(event_name, name_len, 0);
-	head = &session->events_ht.table[hash & (LTTNG_EVENT_HT_SIZE - 1)];
+	head = lttng_event_ht_head(&session->events_ht, hash);
 	lttng_hlist_for_each_entry(event, head, hlist) {
 		WARN_ON_ONCE(!event->desc);
 		if (!strncmp(event->desc->name, event_name,
@@ -622,11 +1588,23 @@ struct lttng_event *_lttng_event_create(struct lttng_channel *chan,
 	}
 	event->chan = chan;
 	event->filter = filter;
-	event->id = chan->free_event_id++;
+	event->id = lttng_channel_alloc_event_id(chan, event_name);
 	event->instrumentation = itype;
 	event->evtype = LTTNG_TYPE_EVENT;
+	event->string_dict = !!chan->string_dict;
 	INIT_LIST_HEAD(&event->bytecode_runtime_head);
+	INIT_LIST_HEAD(&event->filter_bytecode_head);
 	INIT_LIST_HEAD(&event->enablers_ref_head);
+	event->stats = alloc_percpu(struct lttng_event_stats);
+	if (!event->stats) {
+		ret = -ENOMEM;
+		goto register_error;
+	}
+	if (event_param) {
+		ret = lttng_event_sampling_create(event, &event_param->sampling);
+		if (ret)
+			goto register_error;
+	}
 
 	switch (itype) {
 	case LTTNG_KERNEL_TRACEPOINT:
@@ -657,6 +1635,7 @@ struct lttng_event *_lttng_event_create(struct lttng_channel *chan,
 				event_param->u.kprobe.symbol_name,
 				event_param->u.kprobe.offset,
 				event_param->u.kprobe.addr,
+				event_param->u.kprobe.args,
 				event);
 		if (ret) {
 			ret = -EINVAL;
@@ -684,10 +1663,20 @@ struct lttng_event *_lttng_event_create(struct lttng_channel *chan,
 		}
 		event_return->chan = chan;
 		event_return->filter = filter;
-		event_return->id = chan->free_event_id++;
+		event_return->id = lttng_channel_alloc_event_id(chan,
+				event_name);
 		event_return->enabled = 0;
 		event_return->registered = 1;
 		event_return->instrumentation = itype;
+		INIT_LIST_HEAD(&event_return->bytecode_runtime_head);
+		INIT_LIST_HEAD(&event_return->filter_bytecode_head);
+		INIT_LIST_HEAD(&event_return->enablers_ref_head);
+		event_return->stats = alloc_percpu(struct lttng_event_stats);
+		if (!event_return->stats) {
+			kmem_cache_free(event_cache, event_return);
+			ret = -ENOMEM;
+			goto register_error;
+		}
 		/*
 		 * Populate lttng_event structure before kretprobe registration.
 		 */
@@ -696,8 +1685,11 @@ struct lttng_event *_lttng_event_create(struct lttng_channel *chan,
 				event_param->u.kretprobe.symbol_name,
 				event_param->u.kretprobe.offset,
 				event_param->u.kretprobe.addr,
+				event_param->u.kretprobe.flags,
+				event_param->u.kretprobe.latency_threshold,
 				event, event_return);
 		if (ret) {
+			free_percpu(event_return->stats);
 			kmem_cache_free(event_cache, event_return);
 			ret = -EINVAL;
 			goto register_error;
@@ -711,6 +1703,7 @@ struct lttng_event *_lttng_event_create(struct lttng_channel *chan,
 						    event_return);
 		WARN_ON_ONCE(ret > 0);
 		if (ret) {
+			free_percpu(event_return->stats);
 			kmem_cache_free(event_cache, event_return);
 			module_put(event->desc->owner);
 			module_put(event->desc->owner);
@@ -740,6 +1733,44 @@ struct lttng_event *_lttng_event_create(struct lttng_channel *chan,
 		ret = try_module_get(event->desc->owner);
 		WARN_ON_ONCE(!ret);
 		break;
+	case LTTNG_KERNEL_PERF_SAMPLE:
+		/*
+		 * Needs to be explicitly enabled after creation, since
+		 * we may want to apply filters.
+		 */
+		event->enabled = 0;
+		event->registered = 1;
+		/*
+		 * Populate lttng_event structure before event
+		 * registration.
+		 */
+		smp_wmb();
+		ret = lttng_perf_sample_register(event_name,
+				&event_param->u.perf_sample, event);
+		if (ret)
+			goto register_error;
+		break;
+	case LTTNG_KERNEL_UPROBE:
+		/*
+		 * Needs to be explicitly enabled after creation, since
+		 * we may want to apply filters.
+		 */
+		event->enabled = 0;
+		event->registered = 1;
+		/*
+		 * Populate lttng_event structure before event
+		 * registration.
+		 */
+		smp_wmb();
+		ret = lttng_uprobes_register(event_name,
+				event_param->u.uprobe.fd,
+				event_param->u.uprobe.offset,
+				event);
+		if (ret)
+			goto register_error;
+		ret = try_module_get(event->desc->owner);
+		WARN_ON_ONCE(!ret);
+		break;
 	case LTTNG_KERNEL_NOOP:
 	case LTTNG_KERNEL_SYSCALL:
 		/*
@@ -759,18 +1790,24 @@ struct lttng_event *_lttng_event_create(struct lttng_channel *chan,
 		ret = -EINVAL;
 		goto register_error;
 	}
+	ret = lttng_delta_event_init(event);
+	if (ret)
+		goto register_error;
 	ret = _lttng_event_metadata_statedump(chan->session, chan, event);
 	WARN_ON_ONCE(ret > 0);
 	if (ret) {
 		goto statedump_error;
 	}
-	hlist_add_head(&event->hlist, head);
+	lttng_event_ht_add(&chan->session->events_ht, head, event);
 	list_add(&event->list, &chan->session->events);
 	return event;
 
 statedump_error:
 	/* If a statedump error occurs, events will not be readable. */
 register_error:
+	lttng_event_sampling_destroy(event->sampling);
+	free_percpu(event->delta_state);
+	free_percpu(event->stats);
 	kmem_cache_free(event_cache, event);
 cache_error:
 exist:
@@ -794,6 +1831,83 @@ struct lttng_event *lttng_event_create(struct lttng_channel *chan,
 	return event;
 }
 
+/*
+ * The tracepoint is registered with the first event of the fanout of its
+ * description, and the probes of later events are called by the fanout
+ * callback. Should be called with sessions mutex held.
+ */
+static
+int lttng_event_fanout_add(struct lttng_event *event)
+{
+	const struct lttng_event_desc *desc = event->desc;
+	struct lttng_event_fanout *fanout;
+	int ret;
+
+	list_for_each_entry(fanout, &event_fanouts, node) {
+		if (fanout->desc == desc)
+			goto found;
+	}
+	fanout = kzalloc(sizeof(*fanout), GFP_KERNEL);
+	if (!fanout)
+		return -ENOMEM;
+	fanout->desc = desc;
+	INIT_LIST_HEAD(&fanout->events_head);
+	list_add(&fanout->node, &event_fanouts);
+found:
+	if (list_empty(&fanout->events_head)) {
+		/* Left empty on error, freed by the next collection. */
+		ret = lttng_wrapper_tracepoint_probe_register(desc->kname,
+				desc->fanout_callback, fanout);
+		if (ret)
+			return ret;
+	}
+	event->fanout = fanout;
+	list_add_tail_rcu(&event->fanout_node, &fanout->events_head);
+	return 0;
+}
+
+/*
+ * The last event of the fanout unregisters the tracepoint. The fanout is
+ * kept until no probe can iterate on it anymore: an event re-enabled in
+ * the meantime is added back to the same list. Should be called with
+ * sessions mutex held.
+ */
+static
+int lttng_event_fanout_remove(struct lttng_event *event)
+{
+	struct lttng_event_fanout *fanout = event->fanout;
+	int ret;
+
+	if (list_is_singular(&fanout->events_head)) {
+		ret = lttng_wrapper_tracepoint_probe_unregister(
+				fanout->desc->kname,
+				fanout->desc->fanout_callback, fanout);
+		if (ret)
+			return ret;
+	}
+	list_del_rcu(&event->fanout_node);
+	event->fanout = NULL;
+	return 0;
+}
+
+/*
+ * Free the fanouts left without events. Their tracepoint is unregistered,
+ * so it is enough to be called after a trace synchronization following
+ * the removal of their last event, with sessions mutex held throughout.
+ */
+static
+void lttng_event_fanout_gc(void)
+{
+	struct lttng_event_fanout *fanout, *tmp;
+
+	list_for_each_entry_safe(fanout, tmp, &event_fanouts, node) {
+		if (!list_empty(&fanout->events_head))
+			continue;
+		list_del(&fanout->node);
+		kfree(fanout);
+	}
+}
+
 /* Only used for tracepoints for now. */
 static
 void register_event(struct lttng_event *event)
@@ -807,6 +1921,10 @@ void register_event(struct lttng_event *event)
 	desc = event->desc;
 	switch (event->instrumentation) {
 	case LTTNG_KERNEL_TRACEPOINT:
+		if (desc->fanout_callback) {
+			ret = lttng_event_fanout_add(event);
+			break;
+		}
 		ret = lttng_wrapper_tracepoint_probe_register(desc->kname,
 						  desc->probe_callback,
 						  event);
@@ -818,6 +1936,8 @@ void register_event(struct lttng_event *event)
 	case LTTNG_KERNEL_KPROBE:
 	case LTTNG_KERNEL_KRETPROBE:
 	case LTTNG_KERNEL_FUNCTION:
+	case LTTNG_KERNEL_PERF_SAMPLE:
+	case LTTNG_KERNEL_UPROBE:
 	case LTTNG_KERNEL_NOOP:
 		ret = 0;
 		break;
@@ -842,6 +1962,10 @@ int _lttng_event_unregister(struct lttng_event *event)
 	desc = event->desc;
 	switch (event->instrumentation) {
 	case LTTNG_KERNEL_TRACEPOINT:
+		if (event->fanout) {
+			ret = lttng_event_fanout_remove(event);
+			break;
+		}
 		ret = lttng_wrapper_tracepoint_probe_unregister(event->desc->kname,
 						  event->desc->probe_callback,
 						  event);
@@ -858,6 +1982,14 @@ int _lttng_event_unregister(struct lttng_event *event)
 		lttng_ftrace_unregister(event);
 		ret = 0;
 		break;
+	case LTTNG_KERNEL_PERF_SAMPLE:
+		lttng_perf_sample_unregister(event);
+		ret = 0;
+		break;
+	case LTTNG_KERNEL_UPROBE:
+		lttng_uprobes_unregister(event);
+		ret = 0;
+		break;
 	case LTTNG_KERNEL_SYSCALL:
 		ret = lttng_syscall_filter_disable(event->chan,
 			desc->name);
@@ -879,6 +2011,8 @@ int _lttng_event_unregister(struct lttng_event *event)
 static
 void _lttng_event_destroy(struct lttng_event *event)
 {
+	struct lttng_filter_bytecode_node *filter_node, *tmp_filter_node;
+
 	switch (event->instrumentation) {
 	case LTTNG_KERNEL_TRACEPOINT:
 		lttng_event_put(event->desc);
@@ -895,6 +2029,13 @@ void _lttng_event_destroy(struct lttng_event *event)
 		module_put(event->desc->owner);
 		lttng_ftrace_destroy_private(event);
 		break;
+	case LTTNG_KERNEL_PERF_SAMPLE:
+		lttng_perf_sample_destroy_private(event);
+		break;
+	case LTTNG_KERNEL_UPROBE:
+		module_put(event->desc->owner);
+		lttng_uprobes_destroy_private(event);
+		break;
 	case LTTNG_KERNEL_NOOP:
 	case LTTNG_KERNEL_SYSCALL:
 		break;
@@ -902,1708 +2043,4161 @@ void _lttng_event_destroy(struct lttng_event *event)
 		WARN_ON_ONCE(1);
 	}
 	list_del(&event->list);
+	lttng_free_event_filter_runtime(event);
+	list_for_each_entry_safe(filter_node, tmp_filter_node,
+			&event->filter_bytecode_head, node)
+		kfree(filter_node);
 	lttng_destroy_context(event->ctx);
+	lttng_event_summary_destroy(event);
+	lttng_event_sampling_destroy(event->sampling);
+	free_percpu(event->delta_state);
+	free_percpu(event->stats);
 	kmem_cache_free(event_cache, event);
 }
 
-int lttng_session_track_pid(struct lttng_session *session, int pid)
+static
+void lttng_channel_buffer_stats_add(const struct lib_ring_buffer_config *config,
+		struct lib_ring_buffer *buf,
+		struct lttng_kernel_channel_stats *stats)
 {
-	int ret;
-
-	if (pid < -1)
-		return -EINVAL;
-	mutex_lock(&sessions_mutex);
-	if (pid == -1) {
-		/* track all pids: destroy tracker. */
-		if (session->pid_tracker) {
-			struct lttng_pid_tracker *lpf;
-
-			lpf = session->pid_tracker;
-			rcu_assign_pointer(session->pid_tracker, NULL);
-			synchronize_trace();
-			lttng_pid_tracker_destroy(lpf);
-		}
-		ret = 0;
-	} else {
-		if (!session->pid_tracker) {
-			struct lttng_pid_tracker *lpf;
+	stats->records_count +=
+		lib_ring_buffer_get_records_count(config, buf);
+	stats->records_overrun +=
+		lib_ring_buffer_get_records_overrun(config, buf);
+	stats->records_lost_full +=
+		lib_ring_buffer_get_records_lost_full(config, buf);
+	stats->records_lost_wrap +=
+		lib_ring_buffer_get_records_lost_wrap(config, buf);
+	stats->records_lost_big +=
+		lib_ring_buffer_get_records_lost_big(config, buf);
+}
 
-			lpf = lttng_pid_tracker_create();
-			if (!lpf) {
-				ret = -ENOMEM;
-				goto unlock;
-			}
-			ret = lttng_pid_tracker_add(lpf, pid);
-			rcu_assign_pointer(session->pid_tracker, lpf);
-		} else {
-			ret = lttng_pid_tracker_add(session->pid_tracker, pid);
-		}
+/*
+ * The counters are read without synchronization with the probes, so the
+ * sum may be slightly behind, and "recorded", derived from the other
+ * counters, may lag accordingly.
+ */
+static
+void lttng_event_stats_add(struct lttng_event *event,
+		struct lttng_kernel_event_stats *stats)
+{
+	struct lttng_kernel_event_stats sum;
+	u64 rejected;
+	int cpu;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		struct lttng_event_stats *cpu_stats =
+			per_cpu_ptr(event->stats, cpu);
+
+		sum.hit += cpu_stats->hit;
+		sum.pid_rejected += cpu_stats->pid_rejected;
+		sum.sampled_out += cpu_stats->sampled_out;
+		sum.filtered += cpu_stats->filtered;
+		sum.lost_full += cpu_stats->lost_full;
+		sum.lost_big += cpu_stats->lost_big;
+		sum.reserve_failed += cpu_stats->reserve_failed
+			+ cpu_stats->lost_full + cpu_stats->lost_big;
+		sum.triggered += cpu_stats->triggered;
 	}
-unlock:
-	mutex_unlock(&sessions_mutex);
-	return ret;
+	rejected = sum.pid_rejected + sum.sampled_out + sum.filtered
+		+ sum.reserve_failed;
+	stats->hit += sum.hit;
+	stats->recorded += sum.hit > rejected ? sum.hit - rejected : 0;
+	stats->pid_rejected += sum.pid_rejected;
+	stats->sampled_out += sum.sampled_out;
+	stats->filtered += sum.filtered;
+	stats->reserve_failed += sum.reserve_failed;
+	stats->triggered += sum.triggered;
+	stats->lost_full += sum.lost_full;
+	stats->lost_big += sum.lost_big;
+	if (event->instrumentation == LTTNG_KERNEL_KRETPROBE)
+		stats->missed += lttng_kretprobes_missed(event);
 }
 
-int lttng_session_untrack_pid(struct lttng_session *session, int pid)
+void lttng_event_get_stats(struct lttng_event *event,
+		struct lttng_kernel_event_stats *stats)
 {
-	int ret;
+	memset(stats, 0, sizeof(*stats));
+	lttng_event_stats_add(event, stats);
+}
 
-	if (pid < -1)
-		return -EINVAL;
-	mutex_lock(&sessions_mutex);
-	if (pid == -1) {
-		/* untrack all pids: replace by empty tracker. */
-		struct lttng_pid_tracker *old_lpf = session->pid_tracker;
-		struct lttng_pid_tracker *lpf;
+/*
+ * Sum of the statistics of the channel events, and of the record
+ * counters of its buffers.
+ */
+void lttng_channel_get_stats(struct lttng_channel *chan,
+		struct lttng_kernel_channel_stats *stats)
+{
+	const struct lib_ring_buffer_config *config;
+	struct lttng_event *event;
+	struct lib_ring_buffer *buf;
+	int cpu;
 
-		lpf = lttng_pid_tracker_create();
-		if (!lpf) {
-			ret = -ENOMEM;
-			goto unlock;
+	memset(stats, 0, sizeof(*stats));
+	/* The sessions mutex keeps the buffers across a channel resize. */
+	mutex_lock(&sessions_mutex);
+	list_for_each_entry(event, &chan->session->events, list) {
+		if (event->chan == chan)
+			lttng_event_stats_add(event, &stats->events);
+	}
+	config = &chan->chan->backend.config;
+	if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
+		for_each_channel_cpu(cpu, chan->chan) {
+			buf = channel_get_ring_buffer(config, chan->chan, cpu);
+			lttng_channel_buffer_stats_add(config, buf, stats);
 		}
-		rcu_assign_pointer(session->pid_tracker, lpf);
-		synchronize_trace();
-		if (old_lpf)
-			lttng_pid_tracker_destroy(old_lpf);
-		ret = 0;
+		stats->records_lost_pending =
+			lib_ring_buffer_channel_get_records_lost_pending(
+				chan->chan);
 	} else {
-		if (!session->pid_tracker) {
-			ret = -ENOENT;
-			goto unlock;
-		}
-		ret = lttng_pid_tracker_del(session->pid_tracker, pid);
+		buf = channel_get_ring_buffer(config, chan->chan, 0);
+		lttng_channel_buffer_stats_add(config, buf, stats);
+	}
+	/* Not counted by the buffers: derived from the event counters. */
+	if (chan->chan->no_record_count)
+		stats->records_count = stats->events.recorded;
+	if (chan->autotune_mode) {
+		stats->autotune_subbuf_size = chan->autotune_subbuf_size;
+		stats->autotune_num_subbuf = chan->autotune_num_subbuf;
 	}
-unlock:
 	mutex_unlock(&sessions_mutex);
-	return ret;
 }
 
 static
-void *pid_list_start(struct seq_file *m, loff_t *pos)
+uint64_t lttng_buffer_memory_size(struct lib_ring_buffer *buf)
 {
-	struct lttng_session *session = m->private;
-	struct lttng_pid_tracker *lpf;
-	struct lttng_pid_hash_node *e;
-	int iter = 0, i;
-
-	mutex_lock(&sessions_mutex);
-	lpf = session->pid_tracker;
-	if (lpf) {
-		for (i = 0; i < LTTNG_PID_TABLE_SIZE; i++) {
-			struct hlist_head *head = &lpf->pid_hash[i];
-
-			lttng_hlist_for_each_entry(e, head, hlist) {
-				if (iter++ >= *pos)
-					return e;
-			}
-		}
-	} else {
-		/* PID tracker disabled. */
-		if (iter >= *pos && iter == 0) {
-			return session;	/* empty tracker */
-		}
-		iter++;
-	}
-	/* End of list */
-	return NULL;
+	return (uint64_t) lib_ring_buffer_backend_get_pages(&buf->backend)
+		<< PAGE_SHIFT;
 }
 
-/* Called with sessions_mutex held. */
+/*
+ * Called with the sessions mutex held, which keeps the buffers across a
+ * channel resize. cpu_bytes, of nr_cpu_ids entries, can be NULL. Map
+ * channels have no ring buffer: 0 is returned for them.
+ */
 static
-void *pid_list_next(struct seq_file *m, void *p, loff_t *ppos)
+uint64_t _lttng_channel_memory_size(struct lttng_channel *chan,
+		uint64_t *cpu_bytes)
 {
-	struct lttng_session *session = m->private;
-	struct lttng_pid_tracker *lpf;
-	struct lttng_pid_hash_node *e;
-	int iter = 0, i;
+	const struct lib_ring_buffer_config *config;
+	struct lib_ring_buffer *buf;
+	uint64_t size = 0, buf_size;
+	int cpu;
 
-	(*ppos)++;
-	lpf = session->pid_tracker;
-	if (lpf) {
-		for (i = 0; i < LTTNG_PID_TABLE_SIZE; i++) {
-			struct hlist_head *head = &lpf->pid_hash[i];
-
-			lttng_hlist_for_each_entry(e, head, hlist) {
-				if (iter++ >= *ppos)
-					return e;
-			}
-		}
-	} else {
-		/* PID tracker disabled. */
-		if (iter >= *ppos && iter == 0)
-			return session;	/* empty tracker */
-		iter++;
+	if (chan->channel_type == MAP_CHANNEL)
+		return 0;
+	config = &chan->chan->backend.config;
+	if (config->alloc != RING_BUFFER_ALLOC_PER_CPU) {
+		buf = channel_get_ring_buffer(config, chan->chan, 0);
+		return lttng_buffer_memory_size(buf);
 	}
+	for_each_channel_cpu(cpu, chan->chan) {
+		buf = channel_get_ring_buffer(config, chan->chan, cpu);
+		buf_size = lttng_buffer_memory_size(buf);
+		if (cpu_bytes)
+			cpu_bytes[cpu] = buf_size;
+		size += buf_size;
+	}
+	return size;
+}
 
-	/* End of list */
-	return NULL;
+void lttng_channel_get_memory_usage(struct lttng_channel *chan,
+		struct lttng_kernel_channel_memory_usage *usage,
+		uint64_t *cpu_bytes)
+{
+	memset(usage, 0, sizeof(*usage));
+	memset(cpu_bytes, 0, nr_cpu_ids * sizeof(*cpu_bytes));
+	mutex_lock(&sessions_mutex);
+	if (chan->channel_type != MAP_CHANNEL
+			&& chan->chan->backend.config.alloc
+				== RING_BUFFER_ALLOC_PER_CPU)
+		usage->nr_cpus = nr_cpu_ids;
+	usage->buffer_bytes = _lttng_channel_memory_size(chan, cpu_bytes);
+	mutex_unlock(&sessions_mutex);
 }
 
 static
-void pid_list_stop(struct seq_file *m, void *p)
+size_t lttng_filter_bytecode_list_size(struct list_head *bytecode_head)
+{
+	struct lttng_filter_bytecode_node *bytecode;
+	size_t size = 0;
+
+	list_for_each_entry(bytecode, bytecode_head, node)
+		size += sizeof(*bytecode) + bytecode->bc.len;
+	return size;
+}
+
+/*
+ * Sizes of what the session allocated itself: allocator rounding and
+ * the slab of the events are not accounted.
+ */
+void lttng_session_get_memory_usage(struct lttng_session *session,
+		struct lttng_kernel_session_memory_usage *usage)
 {
+	struct lttng_channel *chan;
+	struct lttng_event *event;
+	struct lttng_enabler *enabler;
+
+	memset(usage, 0, sizeof(*usage));
+	/* The session lock keeps the PID trackers. */
+	mutex_lock(&session->lock);
+	mutex_lock(&sessions_mutex);
+	list_for_each_entry(chan, &session->chan, list) {
+		usage->buffer_bytes += _lttng_channel_memory_size(chan, NULL);
+		usage->nr_channels++;
+	}
+	if (session->metadata_cache)
+		usage->metadata_cache_bytes =
+			session->metadata_cache->cache_alloc;
+	list_for_each_entry(event, &session->events, list) {
+		usage->event_bytes += sizeof(*event)
+			+ num_possible_cpus() * sizeof(*event->stats);
+		usage->filter_bytes += lttng_event_filter_runtime_size(event)
+			+ lttng_filter_bytecode_list_size(
+				&event->filter_bytecode_head);
+		usage->nr_events++;
+	}
+	list_for_each_entry(enabler, &session->enablers_head, node) {
+		usage->enabler_bytes += sizeof(*enabler);
+		usage->filter_bytes += lttng_filter_bytecode_list_size(
+				&enabler->filter_bytecode_head);
+		usage->nr_enablers++;
+	}
 	mutex_unlock(&sessions_mutex);
+	if (session->pid_tracker)
+		usage->pid_tracker_bytes +=
+			lttng_pid_tracker_memory_size(session->pid_tracker);
+	if (session->pid_ns_tracker)
+		usage->pid_tracker_bytes +=
+			lttng_pid_tracker_memory_size(session->pid_ns_tracker);
+	mutex_unlock(&session->lock);
 }
 
 static
-int pid_list_show(struct seq_file *m, void *p)
+void lttng_buffer_rotate(struct lib_ring_buffer *buf, uint64_t rotation_id)
 {
-	int pid;
+	lib_ring_buffer_rotate_position(buf, &buf->rotate_seq_num,
+			&buf->rotate_consumed);
+	buf->rotate_id = rotation_id;
+}
 
-	if (p == m->private) {
-		/* Tracker disabled. */
-		pid = -1;
-	} else {
-		const struct lttng_pid_hash_node *e = p;
+/*
+ * Take the rotation position of every data stream of the session, in
+ * one pass under the sessions mutex. Tracing goes on: nothing is
+ * flushed, and each stream splits at the end of the packet it is
+ * writing. Metadata and map channels are not split. Buffers created
+ * afterwards, e.g. for a CPU brought online or by a resize, start in
+ * the current chunk and have no rotation position.
+ */
+int lttng_session_rotate(struct lttng_session *session,
+		uint64_t *rotation_id)
+{
+	const struct lib_ring_buffer_config *config;
+	struct lttng_channel *chan;
+	int cpu;
 
-		pid = lttng_pid_tracker_get_node_pid(e);
+	mutex_lock(&sessions_mutex);
+	*rotation_id = ++session->rotation_id;
+	list_for_each_entry(chan, &session->chan, list) {
+		if (chan->channel_type == METADATA_CHANNEL
+				|| chan->channel_type == MAP_CHANNEL)
+			continue;
+		config = &chan->chan->backend.config;
+		if (config->alloc == RING_BUFFER_ALLOC_PER_CPU) {
+			for_each_channel_cpu(cpu, chan->chan)
+				lttng_buffer_rotate(channel_get_ring_buffer(config,
+						chan->chan, cpu), *rotation_id);
+		} else {
+			lttng_buffer_rotate(channel_get_ring_buffer(config,
+					chan->chan, 0), *rotation_id);
+		}
 	}
-	seq_printf(m,	"process { pid = %d; };\n", pid);
+	mutex_unlock(&sessions_mutex);
 	return 0;
 }
 
-static
-const struct seq_operations lttng_tracker_pids_list_seq_ops = {
-	.start = pid_list_start,
-	.next = pid_list_next,
-	.stop = pid_list_stop,
-	.show = pid_list_show,
-};
+void lttng_stream_get_rotate_position(struct lib_ring_buffer *buf,
+		struct lttng_kernel_rotate_position *pos)
+{
+	memset(pos, 0, sizeof(*pos));
+	mutex_lock(&sessions_mutex);
+	pos->rotation_id = buf->rotate_id;
+	pos->seq_num = buf->rotate_seq_num;
+	pos->consumed = buf->rotate_consumed;
+	mutex_unlock(&sessions_mutex);
+}
 
+/*
+ * Replace the buffers of a per-cpu channel with buffers of the new
+ * geometry, keeping its events, contexts and timers. Writers move to the
+ * new buffers at their next reservation. The old buffers are flushed and
+ * finalized, and stay readable from their stream file descriptors until
+ * the consumer closes them, so the history they hold is not lost. The
+ * new streams are opened like the streams of a cpu brought online.
+ * Buffer record counters start over.
+ */
 static
-int lttng_tracker_pids_list_open(struct inode *inode, struct file *file)
+int _lttng_channel_resize(struct lttng_channel *chan,
+		size_t subbuf_size, size_t num_subbuf)
 {
-	return seq_open(file, &lttng_tracker_pids_list_seq_ops);
+	struct channel *old_chan, *new_chan;
+
+	old_chan = chan->chan;
+	new_chan = chan->transport->ops.channel_create(chan->transport->name,
+			chan, NULL, subbuf_size, num_subbuf,
+			old_chan->switch_timer_interval,
+			old_chan->read_timer_interval);
+	if (!new_chan)
+		return -EINVAL;
+	lib_ring_buffer_crash_set_priv(new_chan,
+			&chan->session->metadata_cache->crash);
+	/* Match the state session stop leaves the buffers in. */
+	if (chan->session->been_active && !chan->session->active)
+		lib_ring_buffer_set_quiescent_channel(new_chan);
+	/* Publish the new channel after its initialization. */
+	smp_wmb();
+	ACCESS_ONCE(chan->chan) = new_chan;
+	synchronize_trace();	/* Wait for writers of the old channel */
+	lttng_string_dict_reset(chan);
+	lttng_delta_reset(chan);
+	lttng_callstack_reset(chan);
+	lib_ring_buffer_crash_set_priv(old_chan, NULL);
+	chan->ops->channel_destroy(old_chan);
+	/* Record counters of the new buffers start over. */
+	chan->autotune_lost = 0;
+	return 0;
 }
 
-static
-int lttng_tracker_pids_list_release(struct inode *inode, struct file *file)
+int lttng_channel_resize(struct lttng_channel *chan,
+		size_t subbuf_size, size_t num_subbuf)
 {
-	struct seq_file *m = file->private_data;
-	struct lttng_session *session = m->private;
 	int ret;
 
-	WARN_ON_ONCE(!session);
-	ret = seq_release(inode, file);
-	if (!ret && session)
-		fput(session->file);
+	if (chan->channel_type != PER_CPU_CHANNEL)
+		return -EINVAL;
+	mutex_lock(&sessions_mutex);
+	ret = _lttng_channel_resize(chan, subbuf_size, num_subbuf);
+	mutex_unlock(&sessions_mutex);
 	return ret;
 }
 
-const struct file_operations lttng_tracker_pids_list_fops = {
-	.owner = THIS_MODULE,
-	.open = lttng_tracker_pids_list_open,
-	.read = seq_read,
-	.llseek = seq_lseek,
-	.release = lttng_tracker_pids_list_release,
-};
+/* Checks with a low reader lag in a row before the buffers are halved. */
+#define LTTNG_AUTOTUNE_IDLE_CHECKS	8
 
-int lttng_session_list_tracker_pids(struct lttng_session *session)
+/*
+ * Highest reader lag of the buffers of the channel since the previous
+ * check, and total of their records lost because they were full.
+ * Called with sessions mutex held.
+ */
+static
+void lttng_autotune_sample(struct lttng_channel *chan,
+		unsigned long *peak_lag, unsigned long *lost_full)
 {
-	struct file *tracker_pids_list_file;
-	struct seq_file *m;
-	int file_fd, ret;
-
-	file_fd = lttng_get_unused_fd();
-	if (file_fd < 0) {
-		ret = file_fd;
-		goto fd_error;
-	}
-
-	tracker_pids_list_file = anon_inode_getfile("[lttng_tracker_pids_list]",
-					  &lttng_tracker_pids_list_fops,
-					  NULL, O_RDWR);
-	if (IS_ERR(tracker_pids_list_file)) {
-		ret = PTR_ERR(tracker_pids_list_file);
-		goto file_error;
-	}
-	if (atomic_long_add_unless(&session->file->f_count,
-		1, INT_MAX) == INT_MAX) {
-		goto refcount_error;
+	const struct lib_ring_buffer_config *config =
+		&chan->chan->backend.config;
+	struct lib_ring_buffer *buf;
+	int cpu;
+
+	*peak_lag = 0;
+	*lost_full = 0;
+	for_each_channel_cpu(cpu, chan->chan) {
+		buf = channel_get_ring_buffer(config, chan->chan, cpu);
+		*peak_lag = max(*peak_lag,
+				lib_ring_buffer_reset_peak_lag(config, buf));
+		*lost_full += lib_ring_buffer_get_records_lost_full(config,
+				buf);
 	}
-	ret = lttng_tracker_pids_list_fops.open(NULL, tracker_pids_list_file);
-	if (ret < 0)
-		goto open_error;
-	m = tracker_pids_list_file->private_data;
-	m->private = session;
-	fd_install(file_fd, tracker_pids_list_file);
-
-	return file_fd;
-
-open_error:
-	atomic_long_dec(&session->file->f_count);
-refcount_error:
-	fput(tracker_pids_list_file);
-file_error:
-	put_unused_fd(file_fd);
-fd_error:
-	return ret;
 }
 
 /*
- * Enabler management.
+ * Keep the sub-buffer count of the channel unless the sub-buffers would
+ * be smaller than a page.
  */
 static
-int lttng_match_enabler_star_glob(const char *desc_name,
-		const char *pattern)
+void lttng_autotune_geometry(struct lttng_channel *chan, uint64_t bytes)
 {
-	if (!strutils_star_glob_match(pattern, LTTNG_SIZE_MAX,
-			desc_name, LTTNG_SIZE_MAX))
-		return 0;
-	return 1;
+	size_t num_subbuf = chan->chan->backend.num_subbuf;
+
+	while (num_subbuf > 2 && bytes / num_subbuf < PAGE_SIZE)
+		num_subbuf >>= 1;
+	chan->autotune_bytes = bytes;
+	chan->autotune_num_subbuf = num_subbuf;
+	chan->autotune_subbuf_size = max_t(uint64_t, bytes / num_subbuf,
+			PAGE_SIZE);
 }
 
+/*
+ * The tuned size grows on records lost by buffers at most that large, or
+ * on a reader lag close to it, and shrinks after a low lag for
+ * LTTNG_AUTOTUNE_IDLE_CHECKS checks. A resize is only applied when the
+ * tuned size changes.
+ */
 static
-int lttng_match_enabler_name(const char *desc_name,
-		const char *name)
+void lttng_channel_autotune_work(struct work_struct *work)
 {
-	if (strcmp(desc_name, name))
-		return 0;
-	return 1;
+	struct lttng_channel *chan = container_of(to_delayed_work(work),
+			struct lttng_channel, autotune_work);
+	struct channel_backend *chanb;
+	unsigned long peak_lag, lost_full;
+	uint64_t bytes, size;
+
+	mutex_lock(&sessions_mutex);
+	if (!chan->autotune_mode)
+		goto unlock;
+	chanb = &chan->chan->backend;
+	size = (uint64_t) chanb->subbuf_size * chanb->num_subbuf;
+	bytes = chan->autotune_bytes;
+	lttng_autotune_sample(chan, &peak_lag, &lost_full);
+	if ((lost_full != chan->autotune_lost && bytes <= size)
+			|| peak_lag > bytes / 4 * 3) {
+		bytes <<= 1;
+		chan->autotune_idle = 0;
+	} else if (peak_lag < bytes / 4) {
+		if (++chan->autotune_idle >= LTTNG_AUTOTUNE_IDLE_CHECKS) {
+			bytes >>= 1;
+			chan->autotune_idle = 0;
+		}
+	} else {
+		chan->autotune_idle = 0;
+	}
+	chan->autotune_lost = lost_full;
+	bytes = clamp(bytes, chan->autotune_min_bytes,
+			chan->autotune_max_bytes);
+	if (bytes != chan->autotune_bytes) {
+		lttng_autotune_geometry(chan, bytes);
+		if (chan->autotune_mode == LTTNG_KERNEL_CHANNEL_AUTOTUNE_APPLY
+				&& _lttng_channel_resize(chan,
+					chan->autotune_subbuf_size,
+					chan->autotune_num_subbuf))
+			printk(KERN_WARNING "LTTng: channel %u resize to %zu x %zu bytes failed\n",
+				chan->id, chan->autotune_num_subbuf,
+				chan->autotune_subbuf_size);
+	}
+	schedule_delayed_work(&chan->autotune_work,
+		msecs_to_jiffies(chan->autotune_period_ms));
+unlock:
+	mutex_unlock(&sessions_mutex);
 }
 
-static
-int lttng_desc_match_enabler(const struct lttng_event_desc *desc,
-		struct lttng_enabler *enabler)
+int lttng_channel_autotune(struct lttng_channel *chan,
+		const struct lttng_kernel_channel_autotune *param)
 {
-	const char *desc_name, *enabler_name;
+	struct channel_backend *chanb;
+	unsigned long peak_lag;
+	int ret = 0;
 
-	enabler_name = enabler->event_param.name;
-	switch (enabler->event_param.instrumentation) {
-	case LTTNG_KERNEL_TRACEPOINT:
-		desc_name = desc->name;
+	switch (param->mode) {
+	case LTTNG_KERNEL_CHANNEL_AUTOTUNE_OFF:
 		break;
-	case LTTNG_KERNEL_SYSCALL:
-		desc_name = desc->name;
-		if (!strncmp(desc_name, "compat_", strlen("compat_")))
-			desc_name += strlen("compat_");
-		if (!strncmp(desc_name, "syscall_exit_",
-				strlen("syscall_exit_"))) {
-			desc_name += strlen("syscall_exit_");
-		} else if (!strncmp(desc_name, "syscall_entry_",
-				strlen("syscall_entry_"))) {
-			desc_name += strlen("syscall_entry_");
-		} else {
-			WARN_ON_ONCE(1);
+	case LTTNG_KERNEL_CHANNEL_AUTOTUNE_RECOMMEND:
+	case LTTNG_KERNEL_CHANNEL_AUTOTUNE_APPLY:
+		if (chan->channel_type != PER_CPU_CHANNEL
+				|| param->period_ms < 10
+				|| param->period_ms > 60 * MSEC_PER_SEC
+				|| !is_power_of_2(param->min_bytes)
+				|| !is_power_of_2(param->max_bytes)
+				|| param->min_bytes < 2 * PAGE_SIZE
+				|| param->min_bytes > param->max_bytes)
 			return -EINVAL;
-		}
 		break;
 	default:
-		WARN_ON_ONCE(1);
 		return -EINVAL;
 	}
-	switch (enabler->type) {
-	case LTTNG_ENABLER_STAR_GLOB:
-		return lttng_match_enabler_star_glob(desc_name, enabler_name);
-	case LTTNG_ENABLER_NAME:
-		return lttng_match_enabler_name(desc_name, enabler_name);
-	default:
-		return -EINVAL;
+	mutex_lock(&sessions_mutex);
+	chanb = &chan->chan->backend;
+	if (param->mode && chanb->config.mode != RING_BUFFER_DISCARD) {
+		ret = -EINVAL;
+		goto end;
+	}
+	chan->autotune_mode = param->mode;
+	if (chan->autotune_mode) {
+		chan->autotune_period_ms = param->period_ms;
+		chan->autotune_min_bytes = param->min_bytes;
+		chan->autotune_max_bytes = param->max_bytes;
+		chan->autotune_idle = 0;
+		/* Start from the current geometry, and measure from now. */
+		lttng_autotune_geometry(chan,
+			(uint64_t) chanb->subbuf_size * chanb->num_subbuf);
+		lttng_autotune_sample(chan, &peak_lag, &chan->autotune_lost);
+		schedule_delayed_work(&chan->autotune_work,
+			msecs_to_jiffies(chan->autotune_period_ms));
 	}
+end:
+	mutex_unlock(&sessions_mutex);
+	/* A pending check sees the tuning off and does not rearm. */
+	if (!param->mode)
+		cancel_delayed_work_sync(&chan->autotune_work);
+	return ret;
 }
 
-static
-int lttng_event_match_enabler(struct lttng_event *event,
-		struct lttng_enabler *enabler)
-{
-	if (enabler->event_param.instrumentation != event->instrumentation)
-		return 0;
-	if (lttng_desc_match_enabler(event->desc, enabler)
-			&& event->chan == enabler->chan)
-		return 1;
-	else
-		return 0;
-}
+static const struct lttng_event_field lttng_cpu_budget_fields[] = {
+	{
+		.name = "event_id",
+		.type = __type_integer(uint32_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "sampling_period",	/* 0: event disabled */
+		.type = __type_integer(uint32_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "hits",
+		.type = __type_integer(uint64_t, 0, 0, 0, __BYTE_ORDER, 10, none),
+	},
+};
+
+static const struct lttng_event_desc lttng_cpu_budget_desc = {
+	.name = "lttng_cpu_budget_throttle",
+	.fields = lttng_cpu_budget_fields,
+	.nr_fields = ARRAY_SIZE(lttng_cpu_budget_fields),
+	.owner = THIS_MODULE,
+};
 
+/*
+ * Record a throttling action in the channel of the throttled event,
+ * creating the channel marker event on first use. "hits" is the number
+ * of hits of the event over the last period.
+ * Called with sessions mutex held.
+ */
 static
-struct lttng_enabler_ref *lttng_event_enabler_ref(struct lttng_event *event,
-		struct lttng_enabler *enabler)
+void lttng_cpu_budget_record(struct lttng_event *event, uint32_t period,
+		uint64_t hits)
 {
-	struct lttng_enabler_ref *enabler_ref;
+	struct lttng_channel *chan = event->chan;
+	struct lttng_event *marker = chan->budget_marker;
+	struct lttng_probe_ctx lttng_probe_ctx = {
+		.event = NULL,
+	};
+	struct lib_ring_buffer_ctx ctx;
+	uint32_t id = event->id;
+	int ret;
 
-	list_for_each_entry(enabler_ref,
-			&event->enablers_ref_head, node) {
-		if (enabler_ref->ref == enabler)
-			return enabler_ref;
+	if (!marker) {
+		struct lttng_kernel_event ev;
+
+		memset(&ev, 0, sizeof(ev));
+		strncpy(ev.name, lttng_cpu_budget_desc.name,
+			LTTNG_KERNEL_SYM_NAME_LEN);
+		ev.name[LTTNG_KERNEL_SYM_NAME_LEN - 1] = '\0';
+		ev.instrumentation = LTTNG_KERNEL_NOOP;
+		marker = _lttng_event_create(chan, &ev, NULL,
+				&lttng_cpu_budget_desc, ev.instrumentation);
+		if (IS_ERR(marker))
+			return;
+		/* Noop events need to be explicitly enabled. */
+		ACCESS_ONCE(marker->enabled) = 1;
+		lttng_event_update_effective_enabled(marker);
+		chan->budget_marker = marker;
 	}
-	return NULL;
+	if (!ACCESS_ONCE(marker->effective_enabled))
+		return;
+	lttng_probe_ctx.event = marker;
+	/* Context fields expect to be recorded with preemption off. */
+	preempt_disable();
+	lttng_event_stats_inc(marker, hit);
+	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx,
+			sizeof(id) + sizeof(period) + sizeof(hits),
+			lttng_alignof(hits), -1);
+	ret = chan->ops->event_reserve(&ctx, marker->id);
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(marker, ret);
+		goto end;
+	}
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(id));
+	chan->ops->event_write(&ctx, &id, sizeof(id));
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(period));
+	chan->ops->event_write(&ctx, &period, sizeof(period));
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(hits));
+	chan->ops->event_write(&ctx, &hits, sizeof(hits));
+	chan->ops->event_commit(&ctx);
+end:
+	preempt_enable();
 }
 
+/*
+ * Raise the sampling period of an event by LTTNG_CPU_BUDGET_FACTOR, or
+ * disable it once the period would exceed
+ * LTTNG_KERNEL_CPU_BUDGET_MAX_PERIOD. The probe reads the period twice,
+ * which is fine as long as it only grows. Returns the expected number
+ * of hits of the event over the next period.
+ * Called with sessions mutex held.
+ */
+#define LTTNG_CPU_BUDGET_FACTOR		8
+
 static
-void lttng_create_tracepoint_if_missing(struct lttng_enabler *enabler)
+unsigned long lttng_event_throttle(struct lttng_event *event)
 {
-	struct lttng_session *session = enabler->chan->session;
-	struct lttng_probe_desc *probe_desc;
-	const struct lttng_event_desc *desc;
-	int i;
-	struct list_head *probe_list;
-
-	probe_list = lttng_get_probe_list_head();
-	/*
-	 * For each probe event, if we find that a probe event matches
-	 * our enabler, create an associated lttng_event if not
-	 * already present.
-	 */
-	list_for_each_entry(probe_desc, probe_list, head) {
-		for (i = 0; i < probe_desc->nr_events; i++) {
-			int found = 0;
-			struct hlist_head *head;
-			const char *event_name;
-			size_t name_len;
-			uint32_t hash;
-			struct lttng_event *event;
-
-			desc = probe_desc->event_desc[i];
-			if (!lttng_desc_match_enabler(desc, enabler))
-				continue;
-			event_name = desc->name;
-			name_len = strlen(event_name);
-
-			/*
-			 * Check if already created.
-			 */
-			hash = jhash(event_name, name_len, 0);
-			head = &session->events_ht.table[hash & (LTTNG_EVENT_HT_SIZE - 1)];
-			lttng_hlist_for_each_entry(event, head, hlist) {
-				if (event->desc == desc
-						&& event->chan == enabler->chan)
-					found = 1;
-			}
-			if (found)
-				continue;
+	unsigned long hits = event->budget_delta;
+	unsigned int period;
+
+	period = event->sampling ? max(event->sampling->period, 1U) : 1;
+	period *= LTTNG_CPU_BUDGET_FACTOR;
+	if (period <= LTTNG_KERNEL_CPU_BUDGET_MAX_PERIOD) {
+		if (event->sampling) {
+			ACCESS_ONCE(event->sampling->period) = period;
+		} else {
+			struct lttng_kernel_event_sampling param = {
+				.period = period,
+			};
 
-			/*
-			 * We need to create an event for this
-			 * event probe.
-			 */
-			event = _lttng_event_create(enabler->chan,
-					NULL, NULL, desc,
-					LTTNG_KERNEL_TRACEPOINT);
-			if (!event) {
-				printk(KERN_INFO "Unable to create event %s\n",
-					probe_desc->event_desc[i]->name);
-			}
+			if (lttng_event_sampling_create(event, &param))
+				goto disable;
 		}
+		lttng_cpu_budget_record(event, period, hits);
+		return hits / LTTNG_CPU_BUDGET_FACTOR;
 	}
+disable:
+	event->throttled = 1;
+	lttng_event_update_effective_enabled(event);
+	WARN_ON_ONCE(lttng_event_arm(event));
+	lttng_cpu_budget_record(event, 0, hits);
+	return 0;
 }
 
+/* Hits which went past the PID trackers and sampling. */
 static
-void lttng_create_syscall_if_missing(struct lttng_enabler *enabler)
+unsigned long lttng_event_budget_hits(struct lttng_event *event)
 {
-	int ret;
+	unsigned long hits = 0;
+	int cpu;
 
-	ret = lttng_syscalls_register(enabler->chan, NULL);
-	WARN_ON_ONCE(ret);
-}
+	for_each_possible_cpu(cpu) {
+		struct lttng_event_stats *cpu_stats =
+			per_cpu_ptr(event->stats, cpu);
 
-/*
- * Create struct lttng_event if it is missing and present in the list of
- * tracepoint probes.
- * Should be called with sessions mutex held.
- */
-static
-void lttng_create_event_if_missing(struct lttng_enabler *enabler)
-{
-	switch (enabler->event_param.instrumentation) {
-	case LTTNG_KERNEL_TRACEPOINT:
-		lttng_create_tracepoint_if_missing(enabler);
-		break;
-	case LTTNG_KERNEL_SYSCALL:
-		lttng_create_syscall_if_missing(enabler);
-		break;
-	default:
-		WARN_ON_ONCE(1);
-		break;
+		hits += cpu_stats->hit - cpu_stats->pid_rejected
+			- cpu_stats->sampled_out;
 	}
+	return hits;
 }
 
 /*
- * Create events associated with an enabler (if not already present),
- * and add backward reference from the event to the enabler.
- * Should be called with sessions mutex held.
+ * Estimate the tracer CPU time of the session over the last period, and
+ * throttle the noisiest events, one step at a time, until the estimate
+ * fits the budget. Hits discarded by the PID trackers or sampling are
+ * not accounted: they only cost a few loads. Internal (noop) events,
+ * such as the task and budget markers, are never throttled.
  */
 static
-int lttng_enabler_ref_events(struct lttng_enabler *enabler)
+void lttng_session_budget_work(struct work_struct *work)
 {
-	struct lttng_session *session = enabler->chan->session;
-	struct lttng_event *event;
-
-	/* First ensure that probe events are created for this enabler. */
-	lttng_create_event_if_missing(enabler);
+	struct lttng_session *session = container_of(to_delayed_work(work),
+			struct lttng_session, budget_work);
+	struct lttng_event *event, *noisiest;
+	u64 budget_ns, cost_ns = 0;
 
-	/* For each event matching enabler in session event list. */
+	mutex_lock(&sessions_mutex);
+	if (!session->budget_permille)
+		goto unlock;
+	budget_ns = (u64) session->budget_period_ms * NSEC_PER_USEC
+		* session->budget_permille * num_online_cpus();
 	list_for_each_entry(event, &session->events, list) {
-		struct lttng_enabler_ref *enabler_ref;
+		unsigned long hits;
 
-		if (!lttng_event_match_enabler(event, enabler))
+		if (event->instrumentation == LTTNG_KERNEL_NOOP)
 			continue;
-		enabler_ref = lttng_event_enabler_ref(event, enabler);
-		if (!enabler_ref) {
-			/*
-			 * If no backward ref, create it.
-			 * Add backward ref from event to enabler.
-			 */
-			enabler_ref = kzalloc(sizeof(*enabler_ref), GFP_KERNEL);
-			if (!enabler_ref)
-				return -ENOMEM;
-			enabler_ref->ref = enabler;
-			list_add(&enabler_ref->node,
-				&event->enablers_ref_head);
+		hits = lttng_event_budget_hits(event);
+		event->budget_delta = hits - event->budget_hits;
+		event->budget_hits = hits;
+		cost_ns += (u64) event->budget_delta * session->budget_cost_ns;
+	}
+	while (cost_ns > budget_ns) {
+		unsigned long hits;
+
+		noisiest = NULL;
+		list_for_each_entry(event, &session->events, list) {
+			if (event->instrumentation == LTTNG_KERNEL_NOOP
+					|| event->throttled)
+				continue;
+			if (event->budget_delta && (!noisiest
+					|| event->budget_delta > noisiest->budget_delta))
+				noisiest = event;
 		}
+		if (!noisiest)
+			break;
+		hits = lttng_event_throttle(noisiest);
+		cost_ns -= (u64) (noisiest->budget_delta - hits)
+			* session->budget_cost_ns;
+		noisiest->budget_delta = hits;
+	}
+	schedule_delayed_work(&session->budget_work,
+		msecs_to_jiffies(session->budget_period_ms));
+unlock:
+	mutex_unlock(&sessions_mutex);
+}
 
-		/*
-		 * Link filter bytecodes if not linked yet.
-		 */
-		lttng_enabler_event_link_bytecode(event, enabler);
+int lttng_session_cpu_budget(struct lttng_session *session,
+		const struct lttng_kernel_session_cpu_budget *param)
+{
+	struct lttng_event *event;
 
-		/* TODO: merge event context. */
+	if (param->cpu_permille > 1000)
+		return -EINVAL;
+	if (param->cpu_permille && (param->period_ms < 10
+			|| param->period_ms > 60 * MSEC_PER_SEC
+			|| !param->event_cost_ns
+			|| param->event_cost_ns > NSEC_PER_MSEC))
+		return -EINVAL;
+	mutex_lock(&sessions_mutex);
+	session->budget_permille = param->cpu_permille;
+	session->budget_period_ms = param->period_ms;
+	session->budget_cost_ns = param->event_cost_ns;
+	if (session->budget_permille) {
+		/* Start accounting from now. */
+		list_for_each_entry(event, &session->events, list)
+			event->budget_hits = lttng_event_budget_hits(event);
+		schedule_delayed_work(&session->budget_work,
+			msecs_to_jiffies(session->budget_period_ms));
 	}
+	mutex_unlock(&sessions_mutex);
+	/* A pending check sees the budget off and does not rearm. */
+	if (!param->cpu_permille)
+		cancel_delayed_work_sync(&session->budget_work);
 	return 0;
 }
 
 /*
- * Called at module load: connect the probe on all enablers matching
- * this event.
- * Called with sessions lock held.
+ * Add id to the tracker pointed to by trackerp, or track all ids if
+ * all is set. Called with session lock held.
  */
-int lttng_fix_pending_events(void)
+static
+int lttng_session_track_id(struct lttng_pid_tracker **trackerp, u32 id,
+		bool all)
 {
-	struct lttng_session *session;
+	int ret;
 
-	list_for_each_entry(session, &sessions, list)
-		lttng_session_lazy_sync_enablers(session);
-	return 0;
+	if (all) {
+		/* track all ids: destroy tracker. */
+		if (*trackerp) {
+			struct lttng_pid_tracker *lpf;
+
+			lpf = *trackerp;
+			rcu_assign_pointer(*trackerp, NULL);
+			synchronize_trace();
+			lttng_pid_tracker_destroy(lpf);
+		}
+		ret = 0;
+	} else {
+		if (!*trackerp) {
+			struct lttng_pid_tracker *lpf;
+
+			lpf = lttng_pid_tracker_create();
+			if (!lpf)
+				return -ENOMEM;
+			ret = lttng_pid_tracker_add(lpf, id);
+			rcu_assign_pointer(*trackerp, lpf);
+		} else {
+			ret = lttng_pid_tracker_add(*trackerp, id);
+		}
+	}
+	return ret;
 }
 
-struct lttng_enabler *lttng_enabler_create(enum lttng_enabler_type type,
-		struct lttng_kernel_event *event_param,
-		struct lttng_channel *chan)
+/*
+ * Remove id from the tracker pointed to by trackerp, or untrack all ids
+ * if all is set. Called with session lock held.
+ */
+static
+int lttng_session_untrack_id(struct lttng_pid_tracker **trackerp, u32 id,
+		bool all)
 {
-	struct lttng_enabler *enabler;
+	int ret;
 
-	enabler = kzalloc(sizeof(*enabler), GFP_KERNEL);
-	if (!enabler)
-		return NULL;
-	enabler->type = type;
-	INIT_LIST_HEAD(&enabler->filter_bytecode_head);
-	memcpy(&enabler->event_param, event_param,
-		sizeof(enabler->event_param));
-	enabler->chan = chan;
-	/* ctx left NULL */
-	enabler->enabled = 0;
-	enabler->evtype = LTTNG_TYPE_ENABLER;
-	mutex_lock(&sessions_mutex);
-	list_add(&enabler->node, &enabler->chan->session->enablers_head);
-	lttng_session_lazy_sync_enablers(enabler->chan->session);
-	mutex_unlock(&sessions_mutex);
-	return enabler;
+	if (all) {
+		/* untrack all ids: replace by empty tracker. */
+		struct lttng_pid_tracker *old_lpf = *trackerp;
+		struct lttng_pid_tracker *lpf;
+
+		lpf = lttng_pid_tracker_create();
+		if (!lpf)
+			return -ENOMEM;
+		rcu_assign_pointer(*trackerp, lpf);
+		synchronize_trace();
+		if (old_lpf)
+			lttng_pid_tracker_destroy(old_lpf);
+		ret = 0;
+	} else {
+		if (!*trackerp)
+			return -ENOENT;
+		ret = lttng_pid_tracker_del(*trackerp, id);
+	}
+	return ret;
 }
 
-int lttng_enabler_enable(struct lttng_enabler *enabler)
+/*
+ * Tasks of channels tracing the system calls of tracked tasks only
+ * follow the trackers. Called with session lock held.
+ */
+static
+void lttng_session_tracker_sync(int pid)
 {
 	mutex_lock(&sessions_mutex);
-	enabler->enabled = 1;
-	lttng_session_lazy_sync_enablers(enabler->chan->session);
+	lttng_syscalls_task_sync(pid);
 	mutex_unlock(&sessions_mutex);
-	return 0;
 }
 
-int lttng_enabler_disable(struct lttng_enabler *enabler)
+int lttng_session_track_pid(struct lttng_session *session, int pid)
 {
-	mutex_lock(&sessions_mutex);
-	enabler->enabled = 0;
-	lttng_session_lazy_sync_enablers(enabler->chan->session);
-	mutex_unlock(&sessions_mutex);
-	return 0;
+	int ret;
+
+	if (pid < -1)
+		return -EINVAL;
+	mutex_lock(&session->lock);
+	ret = lttng_session_track_id(&session->pid_tracker, pid, pid == -1);
+	lttng_session_tracker_sync(pid);
+	mutex_unlock(&session->lock);
+	return ret;
 }
 
-int lttng_enabler_attach_bytecode(struct lttng_enabler *enabler,
-		struct lttng_kernel_filter_bytecode __user *bytecode)
+int lttng_session_untrack_pid(struct lttng_session *session, int pid)
 {
-	struct lttng_filter_bytecode_node *bytecode_node;
-	uint32_t bytecode_len;
 	int ret;
 
-	ret = get_user(bytecode_len, &bytecode->len);
-	if (ret)
-		return ret;
-	bytecode_node = kzalloc(sizeof(*bytecode_node) + bytecode_len,
-			GFP_KERNEL);
-	if (!bytecode_node)
-		return -ENOMEM;
-	ret = copy_from_user(&bytecode_node->bc, bytecode,
-		sizeof(*bytecode) + bytecode_len);
-	if (ret)
-		goto error_free;
-	bytecode_node->enabler = enabler;
-	/* Enforce length based on allocated size */
-	bytecode_node->bc.len = bytecode_len;
-	list_add_tail(&bytecode_node->node, &enabler->filter_bytecode_head);
-	lttng_session_lazy_sync_enablers(enabler->chan->session);
-	return 0;
+	if (pid < -1)
+		return -EINVAL;
+	mutex_lock(&session->lock);
+	ret = lttng_session_untrack_id(&session->pid_tracker, pid, pid == -1);
+	lttng_session_tracker_sync(pid);
+	mutex_unlock(&session->lock);
+	return ret;
+}
 
-error_free:
-	kfree(bytecode_node);
+/*
+ * PID namespaces are tracked by their unsigned inode number, in a PID
+ * tracker. LTTNG_KERNEL_PID_NS_ALL means "all namespaces".
+ */
+int lttng_session_track_pid_ns(struct lttng_session *session,
+		unsigned int inum)
+{
+#ifdef LTTNG_HAVE_PID_NS_INUM
+	int ret;
+
+	mutex_lock(&session->lock);
+	ret = lttng_session_track_id(&session->pid_ns_tracker, inum,
+			inum == LTTNG_KERNEL_PID_NS_ALL);
+	lttng_session_tracker_sync(-1);
+	mutex_unlock(&session->lock);
 	return ret;
+#else
+	return -ENOSYS;
+#endif
 }
 
-int lttng_enabler_attach_context(struct lttng_enabler *enabler,
-		struct lttng_kernel_context *context_param)
+int lttng_session_untrack_pid_ns(struct lttng_session *session,
+		unsigned int inum)
 {
+#ifdef LTTNG_HAVE_PID_NS_INUM
+	int ret;
+
+	mutex_lock(&session->lock);
+	ret = lttng_session_untrack_id(&session->pid_ns_tracker, inum,
+			inum == LTTNG_KERNEL_PID_NS_ALL);
+	lttng_session_tracker_sync(-1);
+	mutex_unlock(&session->lock);
+	return ret;
+#else
 	return -ENOSYS;
+#endif
 }
 
+/*
+ * Return the element at position pos of a tracker list: a tracked id,
+ * or the session itself standing for "all ids" when there is no
+ * tracker. Called with session lock held.
+ */
 static
-void lttng_enabler_destroy(struct lttng_enabler *enabler)
+void *tracker_list_get(struct lttng_session *session,
+		struct lttng_pid_tracker *lpf, loff_t pos)
 {
-	struct lttng_filter_bytecode_node *filter_node, *tmp_filter_node;
-
-	/* Destroy filter bytecode */
-	list_for_each_entry_safe(filter_node, tmp_filter_node,
-			&enabler->filter_bytecode_head, node) {
-		kfree(filter_node);
-	}
-
-	/* Destroy contexts */
-	lttng_destroy_context(enabler->ctx);
-
-	list_del(&enabler->node);
-	kfree(enabler);
+	if (lpf)
+		return (void *) lttng_pid_tracker_get_pos(lpf, pos);
+	/* Tracker disabled. */
+	if (pos == 0)
+		return session;	/* empty tracker */
+	/* End of list */
+	return NULL;
 }
 
-/*
- * lttng_session_sync_enablers should be called just before starting a
- * session.
- * Should be called with sessions mutex held.
- */
 static
-void lttng_session_sync_enablers(struct lttng_session *session)
+void *pid_list_start(struct seq_file *m, loff_t *pos)
 {
-	struct lttng_enabler *enabler;
-	struct lttng_event *event;
-
-	list_for_each_entry(enabler, &session->enablers_head, node)
-		lttng_enabler_ref_events(enabler);
-	/*
-	 * For each event, if at least one of its enablers is enabled,
-	 * and its channel and session transient states are enabled, we
-	 * enable the event, else we disable it.
-	 */
-	list_for_each_entry(event, &session->events, list) {
-		struct lttng_enabler_ref *enabler_ref;
-		struct lttng_bytecode_runtime *runtime;
-		int enabled = 0, has_enablers_without_bytecode = 0;
-
-		switch (event->instrumentation) {
-		case LTTNG_KERNEL_TRACEPOINT:
-		case LTTNG_KERNEL_SYSCALL:
-			/* Enable events */
-			list_for_each_entry(enabler_ref,
-					&event->enablers_ref_head, node) {
-				if (enabler_ref->ref->enabled) {
-					enabled = 1;
-					break;
-				}
-			}
-			break;
-		default:
-			/* Not handled with lazy sync. */
-			continue;
-		}
-		/*
-		 * Enabled state is based on union of enablers, with
-		 * intesection of session and channel transient enable
-		 * states.
-		 */
-		enabled = enabled && session->tstate && event->chan->tstate;
-
-		ACCESS_ONCE(event->enabled) = enabled;
-		/*
-		 * Sync tracepoint registration with event enabled
-		 * state.
-		 */
-		if (enabled) {
-			register_event(event);
-		} else {
-			_lttng_event_unregister(event);
-		}
-
-		/* Check if has enablers without bytecode enabled */
-		list_for_each_entry(enabler_ref,
-				&event->enablers_ref_head, node) {
-			if (enabler_ref->ref->enabled
-					&& list_empty(&enabler_ref->ref->filter_bytecode_head)) {
-				has_enablers_without_bytecode = 1;
-				break;
-			}
-		}
-		event->has_enablers_without_bytecode =
-			has_enablers_without_bytecode;
+	struct lttng_session *session = m->private;
 
-		/* Enable filters */
-		list_for_each_entry(runtime,
-				&event->bytecode_runtime_head, node)
-			lttng_filter_sync_state(runtime);
-	}
+	mutex_lock(&session->lock);
+	return tracker_list_get(session, session->pid_tracker, *pos);
 }
 
-/*
- * Apply enablers to session events, adding events to session if need
- * be. It is required after each modification applied to an active
- * session, and right before session "start".
- * "lazy" sync means we only sync if required.
- * Should be called with sessions mutex held.
- */
+/* Called with session lock held. */
 static
-void lttng_session_lazy_sync_enablers(struct lttng_session *session)
+void *pid_list_next(struct seq_file *m, void *p, loff_t *ppos)
 {
-	/* We can skip if session is not active */
-	if (!session->active)
-		return;
-	lttng_session_sync_enablers(session);
+	struct lttng_session *session = m->private;
+
+	(*ppos)++;
+	return tracker_list_get(session, session->pid_tracker, *ppos);
 }
 
-/*
- * Serialize at most one packet worth of metadata into a metadata
- * channel.
- * We grab the metadata cache mutex to get exclusive access to our metadata
- * buffer and to the metadata cache. Exclusive access to the metadata buffer
- * allows us to do racy operations such as looking for remaining space left in
- * packet and write, since mutual exclusion protects us from concurrent writes.
- * Mutual exclusion on the metadata cache allow us to read the cache content
- * without racing against reallocation of the cache by updates.
- * Returns the number of bytes written in the channel, 0 if no data
- * was written and a negative value on error.
- */
-int lttng_metadata_output_channel(struct lttng_metadata_stream *stream,
-		struct channel *chan)
+static
+void pid_list_stop(struct seq_file *m, void *p)
 {
-	struct lib_ring_buffer_ctx ctx;
-	int ret = 0;
-	size_t len, reserve_len;
+	struct lttng_session *session = m->private;
 
-	/*
-	 * Ensure we support mutiple get_next / put sequences followed by
-	 * put_next. The metadata cache lock protects reading the metadata
-	 * cache. It can indeed be read concurrently by "get_next_subbuf" and
-	 * "flush" operations on the buffer invoked by different processes.
-	 * Moreover, since the metadata cache memory can be reallocated, we
-	 * need to have exclusive access against updates even though we only
-	 * read it.
-	 */
-	mutex_lock(&stream->metadata_cache->lock);
-	WARN_ON(stream->metadata_in < stream->metadata_out);
-	if (stream->metadata_in != stream->metadata_out)
-		goto end;
+	mutex_unlock(&session->lock);
+}
 
-	/* Metadata regenerated, change the version. */
-	if (stream->metadata_cache->version != stream->version)
-		stream->version = stream->metadata_cache->version;
+static
+int pid_list_show(struct seq_file *m, void *p)
+{
+	int pid;
 
-	len = stream->metadata_cache->metadata_written -
-		stream->metadata_in;
-	if (!len)
-		goto end;
-	reserve_len = min_t(size_t,
-			stream->transport->ops.packet_avail_size(chan),
-			len);
-	lib_ring_buffer_ctx_init(&ctx, chan, NULL, reserve_len,
-			sizeof(char), -1);
-	/*
-	 * If reservation failed, return an error to the caller.
-	 */
-	ret = stream->transport->ops.event_reserve(&ctx, 0);
-	if (ret != 0) {
-		printk(KERN_WARNING "LTTng: Metadata event reservation failed\n");
-		goto end;
+	if (p == m->private) {
+		/* Tracker disabled. */
+		pid = -1;
+	} else {
+		pid = (int) *(const u32 *) p;
 	}
-	stream->transport->ops.event_write(&ctx,
-			stream->metadata_cache->data + stream->metadata_in,
-			reserve_len);
-	stream->transport->ops.event_commit(&ctx);
-	stream->metadata_in += reserve_len;
-	ret = reserve_len;
-
-end:
-	mutex_unlock(&stream->metadata_cache->lock);
-	return ret;
+	seq_printf(m,	"process { pid = %d; };\n", pid);
+	return 0;
 }
 
-/*
- * Write the metadata to the metadata cache.
- * Must be called with sessions_mutex held.
- * The metadata cache lock protects us from concurrent read access from
- * thread outputting metadata content to ring buffer.
- */
-int lttng_metadata_printf(struct lttng_session *session,
-			  const char *fmt, ...)
+static
+void *pid_ns_list_start(struct seq_file *m, loff_t *pos)
 {
-	char *str;
-	size_t len;
-	va_list ap;
-	struct lttng_metadata_stream *stream;
-
-	WARN_ON_ONCE(!ACCESS_ONCE(session->active));
-
-	va_start(ap, fmt);
-	str = kvasprintf(GFP_KERNEL, fmt, ap);
-	va_end(ap);
-	if (!str)
-		return -ENOMEM;
-
-	len = strlen(str);
-	mutex_lock(&session->metadata_cache->lock);
-	if (session->metadata_cache->metadata_written + len >
-			session->metadata_cache->cache_alloc) {
-		char *tmp_cache_realloc;
-		unsigned int tmp_cache_alloc_size;
-
-		tmp_cache_alloc_size = max_t(unsigned int,
-				session->metadata_cache->cache_alloc + len,
-				session->metadata_cache->cache_alloc << 1);
-		tmp_cache_realloc = lttng_vzalloc(tmp_cache_alloc_size);
-		if (!tmp_cache_realloc)
-			goto err;
-		if (session->metadata_cache->data) {
-			memcpy(tmp_cache_realloc,
-				session->metadata_cache->data,
-				session->metadata_cache->cache_alloc);
-			vfree(session->metadata_cache->data);
-		}
-
-		session->metadata_cache->cache_alloc = tmp_cache_alloc_size;
-		session->metadata_cache->data = tmp_cache_realloc;
-	}
-	memcpy(session->metadata_cache->data +
-			session->metadata_cache->metadata_written,
-			str, len);
-	session->metadata_cache->metadata_written += len;
-	mutex_unlock(&session->metadata_cache->lock);
-	kfree(str);
+	struct lttng_session *session = m->private;
 
-	list_for_each_entry(stream, &session->metadata_cache->metadata_stream, list)
-		wake_up_interruptible(&stream->read_wait);
+	mutex_lock(&session->lock);
+	return tracker_list_get(session, session->pid_ns_tracker, *pos);
+}
 
-	return 0;
+/* Called with session lock held. */
+static
+void *pid_ns_list_next(struct seq_file *m, void *p, loff_t *ppos)
+{
+	struct lttng_session *session = m->private;
 
-err:
-	mutex_unlock(&session->metadata_cache->lock);
-	kfree(str);
-	return -ENOMEM;
+	(*ppos)++;
+	return tracker_list_get(session, session->pid_ns_tracker, *ppos);
 }
 
 static
-int print_tabs(struct lttng_session *session, size_t nesting)
+int pid_ns_list_show(struct seq_file *m, void *p)
 {
-	size_t i;
-
-	for (i = 0; i < nesting; i++) {
-		int ret;
+	unsigned int inum;
 
-		ret = lttng_metadata_printf(session, "	");
-		if (ret) {
-			return ret;
-		}
+	if (p == m->private) {
+		/* Tracker disabled. */
+		inum = LTTNG_KERNEL_PID_NS_ALL;
+	} else {
+		inum = *(const u32 *) p;
 	}
+	seq_printf(m,	"pid_ns { inum = %u; };\n", inum);
 	return 0;
 }
 
-/*
- * Must be called with sessions_mutex held.
- */
 static
-int _lttng_struct_type_statedump(struct lttng_session *session,
-		const struct lttng_type *type,
-		size_t nesting)
+const struct seq_operations lttng_tracker_pids_list_seq_ops = {
+	.start = pid_list_start,
+	.next = pid_list_next,
+	.stop = pid_list_stop,
+	.show = pid_list_show,
+};
+
+static
+int lttng_tracker_pids_list_open(struct inode *inode, struct file *file)
 {
-	int ret;
-	uint32_t i, nr_fields;
+	return seq_open(file, &lttng_tracker_pids_list_seq_ops);
+}
 
-	ret = print_tabs(session, nesting);
-	if (ret)
-		return ret;
-	ret = lttng_metadata_printf(session,
-		"struct {\n");
-	if (ret)
-		return ret;
-	nr_fields = type->u._struct.nr_fields;
-	for (i = 0; i < nr_fields; i++) {
-		const struct lttng_event_field *iter_field;
+static
+const struct seq_operations lttng_tracker_pid_ns_list_seq_ops = {
+	.start = pid_ns_list_start,
+	.next = pid_ns_list_next,
+	.stop = pid_list_stop,
+	.show = pid_ns_list_show,
+};
 
-		iter_field = &type->u._struct.fields[i];
-		ret = _lttng_field_statedump(session, iter_field, nesting + 1);
-		if (ret)
-			return ret;
-	}
-	ret = print_tabs(session, nesting);
-	if (ret)
-		return ret;
-	ret = lttng_metadata_printf(session,
-		"}");
-	return ret;
+static
+int lttng_tracker_pid_ns_list_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &lttng_tracker_pid_ns_list_seq_ops);
 }
 
-/*
- * Must be called with sessions_mutex held.
- */
 static
-int _lttng_struct_statedump(struct lttng_session *session,
-		const struct lttng_event_field *field,
-		size_t nesting)
+int lttng_tracker_pids_list_release(struct inode *inode, struct file *file)
 {
+	struct seq_file *m = file->private_data;
+	struct lttng_session *session = m->private;
 	int ret;
 
-	ret = _lttng_struct_type_statedump(session,
-			&field->type, nesting);
-	if (ret)
-		return ret;
-	ret = lttng_metadata_printf(session,
-		"_%s;\n",
-		field->name);
+	WARN_ON_ONCE(!session);
+	ret = seq_release(inode, file);
+	if (!ret && session)
+		fput(session->file);
 	return ret;
 }
 
-/*
- * Must be called with sessions_mutex held.
- */
+const struct file_operations lttng_tracker_pids_list_fops = {
+	.owner = THIS_MODULE,
+	.open = lttng_tracker_pids_list_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = lttng_tracker_pids_list_release,
+};
+
 static
-int _lttng_variant_type_statedump(struct lttng_session *session,
-		const struct lttng_type *type,
-		size_t nesting)
+const struct file_operations lttng_tracker_pid_ns_list_fops = {
+	.owner = THIS_MODULE,
+	.open = lttng_tracker_pid_ns_list_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = lttng_tracker_pids_list_release,
+};
+
+static
+int lttng_session_list_tracker(struct lttng_session *session,
+		const char *name, const struct file_operations *fops)
 {
-	int ret;
-	uint32_t i, nr_choices;
+	struct file *tracker_pids_list_file;
+	struct seq_file *m;
+	int file_fd, ret;
 
-	ret = print_tabs(session, nesting);
-	if (ret)
-		return ret;
-	ret = lttng_metadata_printf(session,
-		"variant <_%s> {\n",
-		type->u.variant.tag_name);
-	if (ret)
-		return ret;
-	nr_choices = type->u.variant.nr_choices;
-	for (i = 0; i < nr_choices; i++) {
-		const struct lttng_event_field *iter_field;
+	file_fd = lttng_get_unused_fd();
+	if (file_fd < 0) {
+		ret = file_fd;
+		goto fd_error;
+	}
 
-		iter_field = &type->u.variant.choices[i];
-		ret = _lttng_field_statedump(session, iter_field, nesting + 1);
-		if (ret)
-			return ret;
+	tracker_pids_list_file = anon_inode_getfile(name, fops,
+					  NULL, O_RDWR);
+	if (IS_ERR(tracker_pids_list_file)) {
+		ret = PTR_ERR(tracker_pids_list_file);
+		goto file_error;
 	}
-	ret = print_tabs(session, nesting);
-	if (ret)
-		return ret;
-	ret = lttng_metadata_printf(session,
-		"}");
+	if (atomic_long_add_unless(&session->file->f_count,
+		1, INT_MAX) == INT_MAX) {
+		goto refcount_error;
+	}
+	ret = fops->open(NULL, tracker_pids_list_file);
+	if (ret < 0)
+		goto open_error;
+	m = tracker_pids_list_file->private_data;
+	m->private = session;
+	fd_install(file_fd, tracker_pids_list_file);
+
+	return file_fd;
+
+open_error:
+	atomic_long_dec(&session->file->f_count);
+refcount_error:
+	fput(tracker_pids_list_file);
+file_error:
+	put_unused_fd(file_fd);
+fd_error:
 	return ret;
 }
 
+int lttng_session_list_tracker_pids(struct lttng_session *session)
+{
+	return lttng_session_list_tracker(session, "[lttng_tracker_pids_list]",
+			&lttng_tracker_pids_list_fops);
+}
+
+int lttng_session_list_tracker_pid_ns(struct lttng_session *session)
+{
+	return lttng_session_list_tracker(session, "[lttng_tracker_pid_ns_list]",
+			&lttng_tracker_pid_ns_list_fops);
+}
+
 /*
- * Must be called with sessions_mutex held.
+ * Enabler management.
  */
 static
-int _lttng_variant_statedump(struct lttng_session *session,
-		const struct lttng_event_field *field,
-		size_t nesting)
+int lttng_match_enabler_star_glob(const char *desc_name,
+		const char *pattern)
 {
-	int ret;
+	if (!strutils_star_glob_match(pattern, LTTNG_SIZE_MAX,
+			desc_name, LTTNG_SIZE_MAX))
+		return 0;
+	return 1;
+}
 
-	ret = _lttng_variant_type_statedump(session,
-			&field->type, nesting);
-	if (ret)
-		return ret;
-	ret = lttng_metadata_printf(session,
-		"_%s;\n",
-		field->name);
-	return ret;
+static
+int lttng_match_enabler_name(const char *desc_name,
+		const char *name)
+{
+	if (strcmp(desc_name, name))
+		return 0;
+	return 1;
 }
 
-/*
- * Must be called with sessions_mutex held.
- */
 static
-int _lttng_array_compound_statedump(struct lttng_session *session,
-		const struct lttng_event_field *field,
-		size_t nesting)
+int lttng_desc_match_enabler(const struct lttng_event_desc *desc,
+		struct lttng_enabler *enabler)
 {
-	int ret;
-	const struct lttng_type *elem_type;
+	const char *desc_name, *enabler_name;
 
-	/* Only array of structures and variants are currently supported. */
-	elem_type = field->type.u.array_compound.elem_type;
-	switch (elem_type->atype) {
-	case atype_struct:
-		ret = _lttng_struct_type_statedump(session, elem_type, nesting);
-		if (ret)
-			return ret;
+	enabler_name = enabler->event_param.name;
+	switch (enabler->event_param.instrumentation) {
+	case LTTNG_KERNEL_TRACEPOINT:
+		desc_name = desc->name;
 		break;
-	case atype_variant:
-		ret = _lttng_variant_type_statedump(session, elem_type, nesting);
-		if (ret)
-			return ret;
+	case LTTNG_KERNEL_SYSCALL:
+		desc_name = desc->name;
+		if (!strncmp(desc_name, "compat_", strlen("compat_")))
+			desc_name += strlen("compat_");
+		if (!strncmp(desc_name, "syscall_exit_",
+				strlen("syscall_exit_"))) {
+			desc_name += strlen("syscall_exit_");
+		} else if (!strncmp(desc_name, "syscall_entry_",
+				strlen("syscall_entry_"))) {
+			desc_name += strlen("syscall_entry_");
+		} else if (!strcmp(desc_name, "syscall_latency")) {
+			/* Paired entry/exit record, matched by full name. */
+		} else {
+			WARN_ON_ONCE(1);
+			return -EINVAL;
+		}
 		break;
 	default:
+		WARN_ON_ONCE(1);
 		return -EINVAL;
 	}
-	ret = lttng_metadata_printf(session,
-		" _%s[%u];\n",
-		field->name,
-		field->type.u.array_compound.length);
-	return ret;
+	switch (enabler->type) {
+	case LTTNG_ENABLER_STAR_GLOB:
+		return lttng_match_enabler_star_glob(desc_name, enabler_name);
+	case LTTNG_ENABLER_NAME:
+		return lttng_match_enabler_name(desc_name, enabler_name);
+	default:
+		return -EINVAL;
+	}
+}
+
+static
+int lttng_event_match_enabler(struct lttng_event *event,
+		struct lttng_enabler *enabler)
+{
+	if (enabler->event_param.instrumentation != event->instrumentation)
+		return 0;
+	if (lttng_desc_match_enabler(event->desc, enabler)
+			&& event->chan == enabler->chan)
+		return 1;
+	else
+		return 0;
+}
+
+static
+struct lttng_enabler_ref *lttng_event_enabler_ref(struct lttng_event *event,
+		struct lttng_enabler *enabler)
+{
+	struct lttng_enabler_ref *enabler_ref;
+
+	list_for_each_entry(enabler_ref,
+			&event->enablers_ref_head, node) {
+		if (enabler_ref->ref == enabler)
+			return enabler_ref;
+	}
+	return NULL;
 }
 
 /*
- * Must be called with sessions_mutex held.
+ * Return the event of the enabler channel for an event description,
+ * creating it if missing.
  */
 static
-int _lttng_sequence_compound_statedump(struct lttng_session *session,
-		const struct lttng_event_field *field,
-		size_t nesting)
+struct lttng_event *lttng_tracepoint_get_or_create(struct lttng_enabler *enabler,
+		const struct lttng_event_desc *desc)
 {
-	int ret;
-	const char *length_name;
-	const struct lttng_type *elem_type;
+	struct lttng_session *session = enabler->chan->session;
+	struct hlist_head *head;
+	const char *event_name;
+	size_t name_len;
+	uint32_t hash;
+	struct lttng_event *event;
 
-	length_name = field->type.u.sequence_compound.length_name;
+	event_name = desc->name;
+	name_len = strlen(event_name);
 
-	/* Only array of structures and variants are currently supported. */
-	elem_type = field->type.u.sequence_compound.elem_type;
-	switch (elem_type->atype) {
-	case atype_struct:
-		ret = _lttng_struct_type_statedump(session, elem_type, nesting);
-		if (ret)
-			return ret;
-		break;
-	case atype_variant:
-		ret = _lttng_variant_type_statedump(session, elem_type, nesting);
+	/*
+	 * Check if already created.
+	 */
+	hash = jhash(event_name, name_len, 0);
+	head = lttng_event_ht_head(&session->events_ht, hash);
+	lttng_hlist_for_each_entry(event, head, hlist) {
+		if (event->desc == desc
+				&& event->chan == enabler->chan)
+			return event;
+	}
+
+	/*
+	 * We need to create an event for this
+	 * event probe.
+	 */
+	event = _lttng_event_create(enabler->chan,
+			NULL, NULL, desc,
+			LTTNG_KERNEL_TRACEPOINT);
+	if (!event) {
+		printk(KERN_INFO "Unable to create event %s\n",
+			desc->name);
+		return NULL;
+	}
+	return event;
+}
+
+/*
+ * Add backward reference from the event to the enabler, and apply the
+ * enabler configuration to the event.
+ */
+static
+int lttng_event_ref_enabler(struct lttng_event *event,
+		struct lttng_enabler *enabler)
+{
+	struct lttng_enabler_ref *enabler_ref;
+
+	enabler_ref = lttng_event_enabler_ref(event, enabler);
+	if (!enabler_ref) {
+		/*
+		 * If no backward ref, create it.
+		 * Add backward ref from event to enabler.
+		 */
+		enabler_ref = kzalloc(sizeof(*enabler_ref), GFP_KERNEL);
+		if (!enabler_ref)
+			return -ENOMEM;
+		enabler_ref->ref = enabler;
+		list_add(&enabler_ref->node,
+			&event->enablers_ref_head);
+	}
+
+	/*
+	 * Apply the sampling configuration of the first
+	 * enabler requesting it.
+	 */
+	if (lttng_event_sampling_create(event,
+			&enabler->event_param.sampling))
+		return -ENOMEM;
+
+	/*
+	 * Link filter bytecodes if not linked yet.
+	 */
+	lttng_enabler_event_link_bytecode(event, enabler);
+
+	/* TODO: merge event context. */
+	return 0;
+}
+
+/*
+ * Create the events of a tracepoint enabler (if not already present),
+ * add backward references to the enabler, and sync their state if
+ * "sync" is set. Only the registered events sharing the literal prefix
+ * of the enabler name are visited: a star glob cannot match before its
+ * first wildcard or escape.
+ */
+static
+int lttng_tracepoint_enabler_ref_events(struct lttng_enabler *enabler,
+		bool sync)
+{
+	const struct lttng_event_desc **range;
+	const char *pattern = enabler->event_param.name;
+	unsigned int i, nr;
+	size_t prefix_len;
+
+	(void) lttng_get_probe_list_head();	/* Register lazy probes. */
+	if (enabler->type == LTTNG_ENABLER_STAR_GLOB)
+		prefix_len = strcspn(pattern, "*\\");
+	else
+		prefix_len = strlen(pattern);
+	range = lttng_event_desc_range(pattern, prefix_len, &nr);
+	for (i = 0; i < nr; i++) {
+		struct lttng_event *event;
+		int ret;
+
+		if (!lttng_desc_match_enabler(range[i], enabler))
+			continue;
+		event = lttng_tracepoint_get_or_create(enabler, range[i]);
+		if (!event)
+			continue;
+		ret = lttng_event_ref_enabler(event, enabler);
 		if (ret)
 			return ret;
-		break;
-	default:
-		return -EINVAL;
+		if (sync)
+			lttng_event_sync_state(event);
 	}
-	ret = lttng_metadata_printf(session,
-		" _%s[ _%s ];\n",
-		field->name,
-		length_name);
-	return ret;
+	return 0;
 }
 
 /*
- * Must be called with sessions_mutex held.
+ * Syscall events are created for all syscalls of the channel at once.
  */
 static
-int _lttng_enum_statedump(struct lttng_session *session,
-		const struct lttng_event_field *field,
-		size_t nesting)
+int lttng_syscall_enabler_ref_events(struct lttng_enabler *enabler,
+		bool sync)
 {
-	const struct lttng_enum_desc *enum_desc;
-	const struct lttng_integer_type *container_type;
+	struct lttng_session *session = enabler->chan->session;
+	struct lttng_event *event;
 	int ret;
-	unsigned int i, nr_entries;
 
-	enum_desc = field->type.u.basic.enumeration.desc;
-	container_type = &field->type.u.basic.enumeration.container_type;
-	nr_entries = enum_desc->nr_entries;
+	ret = lttng_syscalls_register(enabler->chan, NULL);
+	WARN_ON_ONCE(ret);
 
-	ret = print_tabs(session, nesting);
-	if (ret)
-		goto end;
-	ret = lttng_metadata_printf(session,
-		"enum : integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } {\n",
-		container_type->size,
-		container_type->alignment,
-		container_type->signedness,
-		(container_type->encoding == lttng_encode_none)
-			? "none"
-			: (container_type->encoding == lttng_encode_UTF8)
-				? "UTF8"
-				: "ASCII",
-		container_type->base,
-#if __BYTE_ORDER == __BIG_ENDIAN
-		container_type->reverse_byte_order ? " byte_order = le;" : ""
-#else
-		container_type->reverse_byte_order ? " byte_order = be;" : ""
-#endif
-		);
-	if (ret)
+	/* For each event matching enabler in session event list. */
+	list_for_each_entry(event, &session->events, list) {
+		if (!lttng_event_match_enabler(event, enabler))
+			continue;
+		ret = lttng_event_ref_enabler(event, enabler);
+		if (ret)
+			return ret;
+		if (sync)
+			lttng_event_sync_state(event);
+	}
+	return 0;
+}
+
+/*
+ * Create events associated with an enabler (if not already present),
+ * and add backward reference from the event to the enabler. If "sync"
+ * is set, also sync the state of those events, which is all an enabler
+ * change requires.
+ * Should be called with sessions mutex held.
+ */
+static
+int lttng_enabler_ref_events(struct lttng_enabler *enabler, bool sync)
+{
+	switch (enabler->event_param.instrumentation) {
+	case LTTNG_KERNEL_TRACEPOINT:
+		return lttng_tracepoint_enabler_ref_events(enabler, sync);
+	case LTTNG_KERNEL_SYSCALL:
+		return lttng_syscall_enabler_ref_events(enabler, sync);
+	default:
+		WARN_ON_ONCE(1);
+		return -EINVAL;
+	}
+}
+
+/*
+ * Called at module load: connect the probe on all enablers matching
+ * this event. Only the events of the probe are evaluated.
+ * Called with sessions lock held.
+ */
+int lttng_fix_pending_events(struct lttng_probe_desc *probe_desc)
+{
+	struct lttng_session *session;
+	int ret = 0;
+
+	list_for_each_entry(session, &sessions, list) {
+		struct lttng_enabler *enabler;
+
+		/* We can skip if session is not active */
+		if (!session->active)
+			continue;
+		list_for_each_entry(enabler, &session->enablers_head, node) {
+			unsigned int i;
+
+			if (enabler->event_param.instrumentation
+					!= LTTNG_KERNEL_TRACEPOINT)
+				continue;
+			for (i = 0; i < probe_desc->nr_events; i++) {
+				const struct lttng_event_desc *desc =
+					probe_desc->event_desc[i];
+				struct lttng_event *event;
+
+				if (!lttng_desc_match_enabler(desc, enabler))
+					continue;
+				event = lttng_tracepoint_get_or_create(enabler,
+						desc);
+				if (!event)
+					continue;
+				ret = lttng_event_ref_enabler(event, enabler);
+				if (ret)
+					return ret;
+				lttng_event_sync_state(event);
+			}
+		}
+	}
+	return ret;
+}
+
+struct lttng_enabler *lttng_enabler_create(enum lttng_enabler_type type,
+		struct lttng_kernel_event *event_param,
+		struct lttng_channel *chan)
+{
+	struct lttng_enabler *enabler;
+
+	enabler = kzalloc(sizeof(*enabler), GFP_KERNEL);
+	if (!enabler)
+		return NULL;
+	enabler->type = type;
+	INIT_LIST_HEAD(&enabler->filter_bytecode_head);
+	memcpy(&enabler->event_param, event_param,
+		sizeof(enabler->event_param));
+	enabler->chan = chan;
+	/* ctx left NULL */
+	enabler->enabled = 0;
+	enabler->evtype = LTTNG_TYPE_ENABLER;
+	mutex_lock(&sessions_mutex);
+	list_add(&enabler->node, &enabler->chan->session->enablers_head);
+	lttng_enabler_lazy_sync(enabler);
+	mutex_unlock(&sessions_mutex);
+	return enabler;
+}
+EXPORT_SYMBOL_GPL(lttng_enabler_create);
+
+int lttng_enabler_enable(struct lttng_enabler *enabler)
+{
+	mutex_lock(&sessions_mutex);
+	enabler->enabled = 1;
+	lttng_enabler_lazy_sync(enabler);
+	mutex_unlock(&sessions_mutex);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lttng_enabler_enable);
+
+int lttng_enabler_disable(struct lttng_enabler *enabler)
+{
+	mutex_lock(&sessions_mutex);
+	enabler->enabled = 0;
+	lttng_enabler_lazy_sync(enabler);
+	mutex_unlock(&sessions_mutex);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(lttng_enabler_disable);
+
+int lttng_enabler_attach_bytecode(struct lttng_enabler *enabler,
+		struct lttng_kernel_filter_bytecode __user *bytecode)
+{
+	struct lttng_filter_bytecode_node *bytecode_node;
+	uint32_t bytecode_len;
+	int ret;
+
+	ret = get_user(bytecode_len, &bytecode->len);
+	if (ret)
+		return ret;
+	bytecode_node = kzalloc(sizeof(*bytecode_node) + bytecode_len,
+			GFP_KERNEL);
+	if (!bytecode_node)
+		return -ENOMEM;
+	ret = copy_from_user(&bytecode_node->bc, bytecode,
+		sizeof(*bytecode) + bytecode_len);
+	if (ret)
+		goto error_free;
+	bytecode_node->enabler = enabler;
+	/* Enforce length based on allocated size */
+	bytecode_node->bc.len = bytecode_len;
+	list_add_tail(&bytecode_node->node, &enabler->filter_bytecode_head);
+	lttng_enabler_lazy_sync(enabler);
+	return 0;
+
+error_free:
+	kfree(bytecode_node);
+	return ret;
+}
+
+/*
+ * Filters of kprobe, kretprobe and function events are attached to the
+ * event itself, since those events are not created from enablers. The
+ * bytecode of a kretprobe also filters its return event.
+ */
+int lttng_event_attach_bytecode(struct lttng_event *event,
+		struct lttng_kernel_filter_bytecode __user *bytecode)
+{
+	struct lttng_filter_bytecode_node *bytecode_node;
+	struct lttng_bytecode_runtime *runtime;
+	struct lttng_event *event_return = NULL;
+	uint32_t bytecode_len;
+	int ret;
+
+	switch (event->instrumentation) {
+	case LTTNG_KERNEL_KPROBE:
+	case LTTNG_KERNEL_FUNCTION:
+	case LTTNG_KERNEL_PERF_SAMPLE:
+	case LTTNG_KERNEL_UPROBE:
+		break;
+	case LTTNG_KERNEL_KRETPROBE:
+		event_return = lttng_kretprobes_return_event(event);
+		break;
+	default:
+		return -EINVAL;
+	}
+	ret = get_user(bytecode_len, &bytecode->len);
+	if (ret)
+		return ret;
+	bytecode_node = kzalloc(sizeof(*bytecode_node) + bytecode_len,
+			GFP_KERNEL);
+	if (!bytecode_node)
+		return -ENOMEM;
+	ret = copy_from_user(&bytecode_node->bc, bytecode,
+		sizeof(*bytecode) + bytecode_len);
+	if (ret) {
+		kfree(bytecode_node);
+		return -EFAULT;
+	}
+	/* Enforce length based on allocated size */
+	bytecode_node->bc.len = bytecode_len;
+	mutex_lock(&sessions_mutex);
+	list_add_tail(&bytecode_node->node, &event->filter_bytecode_head);
+	lttng_event_link_bytecode(event, &event->filter_bytecode_head);
+	list_for_each_entry(runtime, &event->bytecode_runtime_head, node)
+		lttng_filter_sync_state(runtime);
+	lttng_filter_event_fuse(event);
+	if (event_return) {
+		lttng_event_link_bytecode(event_return,
+				&event->filter_bytecode_head);
+		list_for_each_entry(runtime,
+				&event_return->bytecode_runtime_head, node)
+			lttng_filter_sync_state(runtime);
+		lttng_filter_event_fuse(event_return);
+	}
+	mutex_unlock(&sessions_mutex);
+	return 0;
+}
+
+/*
+ * Prologue of the probes which are not generated from tracepoint
+ * definitions (kprobes, kretprobes and function tracing), after their
+ * effective enable check: PID trackers, sampling and filters, as done by
+ * the tracepoint probes. "filter_stack_data" holds the event payload in
+ * the filter interpreter layout. Returns whether the hit is recorded.
+ */
+bool lttng_event_probe_check(struct lttng_event *event,
+		struct lttng_probe_ctx *lttng_probe_ctx,
+		const char *filter_stack_data)
+{
+	struct lttng_session *session = event->chan->session;
+	struct lttng_bytecode_runtime *bc_runtime;
+	struct lttng_event_sampling *sampling;
+	struct lttng_pid_tracker *lpf;
+	bool record;
+
+	if (unlikely(session->cpu_mask) &&
+			!cpumask_test_cpu(smp_processor_id(), session->cpu_mask))
+		return false;
+	lttng_event_stats_inc(event, hit);
+	lpf = lttng_rcu_dereference(session->pid_tracker);
+	if (lpf && likely(!lttng_pid_tracker_lookup_current(lpf)))
+		goto pid_rejected;
+	lpf = lttng_rcu_dereference(session->pid_ns_tracker);
+	if (lpf && likely(!lttng_pid_tracker_lookup(lpf,
+			lttng_current_pid_ns_inum())))
+		goto pid_rejected;
+	sampling = ACCESS_ONCE(event->sampling);
+	if (unlikely(sampling) && !lttng_event_sample(sampling)) {
+		lttng_event_stats_inc(event, sampled_out);
+		return false;
+	}
+	if (likely(list_empty(&event->bytecode_runtime_head))) {
+		record = true;
+		goto end;
+	}
+	record = event->has_enablers_without_bytecode;
+	bc_runtime = lttng_rcu_dereference(event->filter_fused);
+	if (bc_runtime) {
+		if (bc_runtime->filter(bc_runtime, lttng_probe_ctx,
+				filter_stack_data) & LTTNG_FILTER_RECORD_FLAG)
+			record = true;
+		goto end;
+	}
+	lttng_list_for_each_entry_rcu(bc_runtime,
+			&event->bytecode_runtime_head, node) {
+		const struct lttng_filter_prefilter *prefilter =
+			ACCESS_ONCE(bc_runtime->prefilter);
+
+		if (prefilter) {
+			int ret;
+
+			ret = lttng_filter_prefilter_match(prefilter,
+					filter_stack_data);
+			if (likely(ret == LTTNG_FILTER_PREFILTER_REJECT))
+				continue;
+			if (ret == LTTNG_FILTER_PREFILTER_ACCEPT) {
+				record = true;
+				continue;
+			}
+		}
+		if (unlikely(bc_runtime->filter(bc_runtime, lttng_probe_ctx,
+				filter_stack_data) & LTTNG_FILTER_RECORD_FLAG))
+			record = true;
+	}
+end:
+	if (!record)
+		lttng_event_stats_inc(event, filtered);
+	else if (unlikely(ACCESS_ONCE(event->action)))
+		record = lttng_event_action(event, lttng_probe_ctx);
+	return record;
+
+pid_rejected:
+	lttng_event_stats_inc(event, pid_rejected);
+	return false;
+}
+EXPORT_SYMBOL_GPL(lttng_event_probe_check);
+
+int lttng_enabler_attach_context(struct lttng_enabler *enabler,
+		struct lttng_kernel_context *context_param)
+{
+	return -ENOSYS;
+}
+
+static
+void lttng_enabler_destroy(struct lttng_enabler *enabler)
+{
+	struct lttng_filter_bytecode_node *filter_node, *tmp_filter_node;
+
+	/* Destroy filter bytecode */
+	list_for_each_entry_safe(filter_node, tmp_filter_node,
+			&enabler->filter_bytecode_head, node) {
+		kfree(filter_node);
+	}
+
+	/* Destroy contexts */
+	lttng_destroy_context(enabler->ctx);
+
+	list_del(&enabler->node);
+	kfree(enabler);
+}
+
+/*
+ * lttng_session_sync_enablers should be called just before starting a
+ * session. The tracepoint registrations of the pass are batched, so
+ * each tracepoint is updated at most once.
+ * Should be called with sessions mutex held.
+ */
+static
+void lttng_session_sync_enablers(struct lttng_session *session)
+{
+	struct lttng_enabler *enabler;
+	struct lttng_event *event;
+
+	session->batch_sync_pending = 0;
+	lttng_wrapper_tracepoint_batch_begin();
+	list_for_each_entry(enabler, &session->enablers_head, node)
+		lttng_enabler_ref_events(enabler, false);
+	list_for_each_entry(event, &session->events, list)
+		lttng_event_sync_state(event);
+	lttng_wrapper_tracepoint_batch_end();
+}
+
+/*
+ * Within a batch, enabler changes are applied all at once by
+ * lttng_session_batch_commit.
+ * Should be called with sessions mutex held.
+ */
+static
+void lttng_session_sync_enablers_batched(struct lttng_session *session)
+{
+	if (session->batch) {
+		session->batch_sync_pending = 1;
+		return;
+	}
+	lttng_session_sync_enablers(session);
+}
+
+/*
+ * For an event, if at least one of its enablers is enabled, and its
+ * channel and session transient states are enabled, we enable the
+ * event, else we disable it.
+ * Should be called with sessions mutex held.
+ */
+static
+void lttng_event_sync_state(struct lttng_event *event)
+{
+	struct lttng_session *session = event->chan->session;
+	struct lttng_enabler_ref *enabler_ref;
+	struct lttng_bytecode_runtime *runtime;
+	int enabled = 0, has_enablers_without_bytecode = 0;
+
+	switch (event->instrumentation) {
+	case LTTNG_KERNEL_TRACEPOINT:
+	case LTTNG_KERNEL_SYSCALL:
+		/* Enable events */
+		list_for_each_entry(enabler_ref,
+				&event->enablers_ref_head, node) {
+			if (enabler_ref->ref->enabled) {
+				enabled = 1;
+				break;
+			}
+		}
+		break;
+	default:
+		/* Not handled with lazy sync. */
+		return;
+	}
+	/*
+	 * Enabled state is based on union of enablers, with
+	 * intesection of session and channel transient enable
+	 * states.
+	 */
+	enabled = enabled && session->tstate && event->chan->tstate;
+
+	ACCESS_ONCE(event->enabled) = enabled;
+	lttng_event_update_effective_enabled(event);
+	/*
+	 * Sync tracepoint registration with event enabled
+	 * state.
+	 */
+	if (enabled) {
+		register_event(event);
+	} else {
+		_lttng_event_unregister(event);
+	}
+
+	/* Check if has enablers without bytecode enabled */
+	list_for_each_entry(enabler_ref,
+			&event->enablers_ref_head, node) {
+		if (enabler_ref->ref->enabled
+				&& list_empty(&enabler_ref->ref->filter_bytecode_head)) {
+			has_enablers_without_bytecode = 1;
+			break;
+		}
+	}
+	event->has_enablers_without_bytecode =
+		has_enablers_without_bytecode;
+
+	/* Enable filters */
+	list_for_each_entry(runtime,
+			&event->bytecode_runtime_head, node)
+		lttng_filter_sync_state(runtime);
+	lttng_filter_event_fuse(event);
+}
+
+/*
+ * Apply a change of one enabler: only its matching events are evaluated.
+ * Should be called with sessions mutex held.
+ */
+static
+void lttng_enabler_lazy_sync(struct lttng_enabler *enabler)
+{
+	/* We can skip if session is not active */
+	if (!enabler->chan->session->active)
+		return;
+	if (enabler->chan->session->batch) {
+		enabler->chan->session->batch_sync_pending = 1;
+		return;
+	}
+	WARN_ON_ONCE(lttng_enabler_ref_events(enabler, true));
+}
+
+/*
+ * Serialize at most one packet worth of metadata into a metadata
+ * channel.
+ * We grab the metadata cache mutex to get exclusive access to our metadata
+ * buffer and to the metadata cache. Exclusive access to the metadata buffer
+ * allows us to do racy operations such as looking for remaining space left in
+ * packet and write, since mutual exclusion protects us from concurrent writes.
+ * Mutual exclusion on the metadata cache allow us to read the cache content
+ * without racing against reallocation of the cache by updates.
+ * Returns the number of bytes written in the channel, 0 if no data
+ * was written and a negative value on error.
+ */
+int lttng_metadata_output_channel(struct lttng_metadata_stream *stream,
+		struct channel *chan)
+{
+	struct lttng_metadata_cache *cache = stream->metadata_cache;
+	const struct lttng_metadata_segment *seg;
+	struct lib_ring_buffer_ctx ctx;
+	int ret = 0;
+	size_t len, reserve_len, pos, end, write_len;
+
+	/*
+	 * Ensure we support mutiple get_next / put sequences followed by
+	 * put_next. The metadata cache lock protects reading the metadata
+	 * cache. It can indeed be read concurrently by "get_next_subbuf" and
+	 * "flush" operations on the buffer invoked by different processes.
+	 * Moreover, since the metadata cache chunk array can be reallocated,
+	 * we need to have exclusive access against updates even though we
+	 * only read it.
+	 */
+	mutex_lock(&stream->metadata_cache->lock);
+	WARN_ON(stream->metadata_in < stream->metadata_out);
+	if (stream->metadata_in != stream->metadata_out)
+		goto end;
+
+	/* Metadata regenerated, change the version. */
+	if (stream->metadata_cache->version != stream->version)
+		stream->version = stream->metadata_cache->version;
+
+	len = stream->metadata_cache->metadata_written -
+		stream->metadata_in;
+	if (!len)
+		goto end;
+	reserve_len = min_t(size_t,
+			stream->transport->ops.packet_avail_size(chan),
+			len);
+	lib_ring_buffer_ctx_init(&ctx, chan, NULL, reserve_len,
+			sizeof(char), -1);
+	/*
+	 * If reservation failed, return an error to the caller.
+	 */
+	ret = stream->transport->ops.event_reserve(&ctx, 0);
+	if (ret != 0) {
+		printk(KERN_WARNING "LTTng: Metadata event reservation failed\n");
+		goto end;
+	}
+	/* Write the reserved range segment by segment, chunk by chunk. */
+	end = stream->metadata_in + reserve_len;
+	seg = metadata_cache_find_segment(cache, stream->metadata_in);
+	for (pos = stream->metadata_in; pos < end; pos += write_len) {
+		const char *src;
+
+		if (pos >= seg->pos + seg->len)
+			seg++;
+		write_len = min_t(size_t, end - pos,
+				seg->pos + seg->len - pos);
+		if (seg->shared) {
+			src = seg->shared->data + (pos - seg->pos);
+		} else {
+			size_t chunk_pos = seg->chunk_pos + (pos - seg->pos);
+			size_t offset = chunk_pos
+					& (METADATA_CACHE_CHUNK_SIZE - 1);
+
+			write_len = min_t(size_t, write_len,
+					METADATA_CACHE_CHUNK_SIZE - offset);
+			src = cache->chunks[chunk_pos
+					>> METADATA_CACHE_CHUNK_SHIFT] + offset;
+		}
+		stream->transport->ops.event_write(&ctx, src, write_len);
+	}
+	stream->transport->ops.event_commit(&ctx);
+	stream->metadata_in += reserve_len;
+	ret = reserve_len;
+
+end:
+	mutex_unlock(&stream->metadata_cache->lock);
+	return ret;
+}
+
+/*
+ * Append metadata to the metadata cache, copying it in the cache chunks
+ * if "shared" is NULL, else referencing the shared text.
+ * Must be called with sessions_mutex held.
+ * The metadata cache lock protects us from concurrent read access from
+ * thread outputting metadata content to ring buffer.
+ */
+static
+int lttng_metadata_append(struct lttng_session *session,
+			 const char *data, size_t len,
+			 struct lttng_metadata_shared *shared)
+{
+	struct lttng_metadata_cache *cache = session->metadata_cache;
+	struct lttng_metadata_stream *stream;
+
+	WARN_ON_ONCE(!ACCESS_ONCE(session->active));
+
+	if (!len)
+		return 0;
+	mutex_lock(&cache->lock);
+	if ((!shared && metadata_cache_grow(cache, cache->chunk_written + len))
+			|| metadata_cache_append_segment(cache, len, shared)) {
+		mutex_unlock(&cache->lock);
+		return -ENOMEM;
+	}
+	if (!shared) {
+		metadata_cache_write(cache, cache->chunk_written, data, len);
+		cache->chunk_written += len;
+	}
+	cache->metadata_written += len;
+	mutex_unlock(&cache->lock);
+
+	list_for_each_entry(stream, &cache->metadata_stream, list)
+		wake_up_interruptible(&stream->read_wait);
+
+	return 0;
+}
+
+static
+int lttng_metadata_write(struct lttng_session *session,
+			 const char *data, size_t len)
+{
+	return lttng_metadata_append(session, data, len, NULL);
+}
+
+/*
+ * The scratch buffer only grows, and is kept until the cache is freed:
+ * once it fits the longest text crossing a chunk boundary, metadata is
+ * printed without allocation but for new chunks and segments.
+ */
+static
+int metadata_cache_scratch_reserve(struct lttng_metadata_cache *cache,
+		size_t size)
+{
+	char *scratch;
+
+	if (size <= cache->scratch_alloc)
+		return 0;
+	size = max_t(size_t, roundup_pow_of_two(size), 256);
+	scratch = krealloc(cache->scratch, size, GFP_KERNEL);
+	if (!scratch)
+		return -ENOMEM;
+	cache->cache_alloc += size - cache->scratch_alloc;
+	cache->scratch = scratch;
+	cache->scratch_alloc = size;
+	return 0;
+}
+
+/*
+ * Text is formatted in place at the end of the last chunk of the cache.
+ * Text which does not fit in what is left of the chunk is formatted
+ * again in the scratch buffer and copied across the chunk boundary.
+ */
+int lttng_metadata_printf(struct lttng_session *session,
+			  const char *fmt, ...)
+{
+	struct lttng_metadata_cache *cache = session->metadata_cache;
+	struct lttng_metadata_stream *stream;
+	size_t offset, avail;
+	va_list ap;
+	int len, ret;
+
+	WARN_ON_ONCE(!ACCESS_ONCE(session->active));
+
+	mutex_lock(&cache->lock);
+	/* Room past the end for the null byte, overwritten by the next text. */
+	ret = metadata_cache_grow(cache, cache->chunk_written + 1);
+	if (ret)
+		goto end;
+	offset = cache->chunk_written & (METADATA_CACHE_CHUNK_SIZE - 1);
+	avail = METADATA_CACHE_CHUNK_SIZE - offset;
+	va_start(ap, fmt);
+	len = vsnprintf(cache->chunks[cache->chunk_written
+				>> METADATA_CACHE_CHUNK_SHIFT] + offset,
+			avail, fmt, ap);
+	va_end(ap);
+	if (!len)
+		goto end;
+	if (len >= avail) {
+		ret = metadata_cache_scratch_reserve(cache, len + 1);
+		if (ret)
+			goto end;
+		ret = metadata_cache_grow(cache, cache->chunk_written + len);
+		if (ret)
+			goto end;
+		va_start(ap, fmt);
+		vsnprintf(cache->scratch, len + 1, fmt, ap);
+		va_end(ap);
+		metadata_cache_write(cache, cache->chunk_written,
+				cache->scratch, len);
+	}
+	ret = metadata_cache_append_segment(cache, len, NULL);
+	if (ret)
+		goto end;
+	cache->chunk_written += len;
+	cache->metadata_written += len;
+	mutex_unlock(&cache->lock);
+
+	list_for_each_entry(stream, &cache->metadata_stream, list)
+		wake_up_interruptible(&stream->read_wait);
+	return 0;
+
+end:
+	mutex_unlock(&cache->lock);
+	return ret;
+}
+
+/*
+ * Append to a metadata fragment, which grows by doubling. Fragments are
+ * private to their user, no locking is needed.
+ */
+static
+int lttng_metadata_fragment_reserve(struct lttng_metadata_fragment *frag,
+		size_t len)
+{
+	if (frag->len + len + 1 > frag->alloc) {
+		size_t alloc = max_t(size_t, frag->len + len + 1,
+				max_t(size_t, frag->alloc << 1, 256));
+		char *data;
+
+		data = krealloc(frag->data, alloc, GFP_KERNEL);
+		if (!data)
+			return -ENOMEM;
+		frag->data = data;
+		frag->alloc = alloc;
+	}
+	return 0;
+}
+
+static
+int lttng_metadata_fragment_printf(struct lttng_metadata_fragment *frag,
+			  const char *fmt, ...)
+{
+	va_list ap;
+	int len, ret;
+
+	va_start(ap, fmt);
+	len = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	ret = lttng_metadata_fragment_reserve(frag, len);
+	if (ret)
+		return ret;
+	va_start(ap, fmt);
+	vsnprintf(frag->data + frag->len, len + 1, fmt, ap);
+	va_end(ap);
+	frag->len += len;
+	return 0;
+}
+
+void lttng_metadata_fragment_free(struct lttng_metadata_fragment *frag)
+{
+	kfree(frag->data);
+	frag->data = NULL;
+	frag->len = frag->alloc = 0;
+}
+
+/*
+ * Copy the text of a fragment to share it, by reference, between the
+ * metadata caches of sessions.
+ */
+struct lttng_metadata_shared *
+	lttng_metadata_shared_create(const struct lttng_metadata_fragment *frag)
+{
+	struct lttng_metadata_shared *shared;
+
+	shared = kmalloc(sizeof(*shared) + frag->len, GFP_KERNEL);
+	if (!shared)
+		return NULL;
+	kref_init(&shared->ref);
+	shared->len = frag->len;
+	memcpy(shared->data, frag->data, frag->len);
+	return shared;
+}
+
+static
+void lttng_metadata_shared_release(struct kref *kref)
+{
+	kfree(container_of(kref, struct lttng_metadata_shared, ref));
+}
+
+void lttng_metadata_shared_put(struct lttng_metadata_shared *shared)
+{
+	kref_put(&shared->ref, lttng_metadata_shared_release);
+}
+
+static
+int print_tabs(struct lttng_metadata_fragment *frag, size_t nesting)
+{
+	size_t i;
+
+	for (i = 0; i < nesting; i++) {
+		int ret;
+
+		ret = lttng_metadata_fragment_printf(frag, "	");
+		if (ret) {
+			return ret;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_struct_type_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_type *type,
+		size_t nesting)
+{
+	int ret;
+	uint32_t i, nr_fields;
+
+	ret = print_tabs(frag, nesting);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_fragment_printf(frag,
+		"struct {\n");
+	if (ret)
+		return ret;
+	nr_fields = type->u._struct.nr_fields;
+	for (i = 0; i < nr_fields; i++) {
+		const struct lttng_event_field *iter_field;
+
+		iter_field = &type->u._struct.fields[i];
+		ret = _lttng_field_statedump(frag, iter_field, nesting + 1);
+		if (ret)
+			return ret;
+	}
+	ret = print_tabs(frag, nesting);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_fragment_printf(frag,
+		"}");
+	return ret;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_struct_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *field,
+		size_t nesting)
+{
+	int ret;
+
+	ret = _lttng_struct_type_statedump(frag,
+			&field->type, nesting);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_fragment_printf(frag,
+		"_%s;\n",
+		field->name);
+	return ret;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_variant_type_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_type *type,
+		size_t nesting)
+{
+	int ret;
+	uint32_t i, nr_choices;
+
+	ret = print_tabs(frag, nesting);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_fragment_printf(frag,
+		"variant <_%s> {\n",
+		type->u.variant.tag_name);
+	if (ret)
+		return ret;
+	nr_choices = type->u.variant.nr_choices;
+	for (i = 0; i < nr_choices; i++) {
+		const struct lttng_event_field *iter_field;
+
+		iter_field = &type->u.variant.choices[i];
+		ret = _lttng_field_statedump(frag, iter_field, nesting + 1);
+		if (ret)
+			return ret;
+	}
+	ret = print_tabs(frag, nesting);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_fragment_printf(frag,
+		"}");
+	return ret;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_variant_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *field,
+		size_t nesting)
+{
+	int ret;
+
+	ret = _lttng_variant_type_statedump(frag,
+			&field->type, nesting);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_fragment_printf(frag,
+		"_%s;\n",
+		field->name);
+	return ret;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_array_compound_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *field,
+		size_t nesting)
+{
+	int ret;
+	const struct lttng_type *elem_type;
+
+	/* Only array of structures and variants are currently supported. */
+	elem_type = field->type.u.array_compound.elem_type;
+	switch (elem_type->atype) {
+	case atype_struct:
+		ret = _lttng_struct_type_statedump(frag, elem_type, nesting);
+		if (ret)
+			return ret;
+		break;
+	case atype_variant:
+		ret = _lttng_variant_type_statedump(frag, elem_type, nesting);
+		if (ret)
+			return ret;
+		break;
+	default:
+		return -EINVAL;
+	}
+	ret = lttng_metadata_fragment_printf(frag,
+		" _%s[%u];\n",
+		field->name,
+		field->type.u.array_compound.length);
+	return ret;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_sequence_compound_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *field,
+		size_t nesting)
+{
+	int ret;
+	const char *length_name;
+	const struct lttng_type *elem_type;
+
+	length_name = field->type.u.sequence_compound.length_name;
+
+	/* Only array of structures and variants are currently supported. */
+	elem_type = field->type.u.sequence_compound.elem_type;
+	switch (elem_type->atype) {
+	case atype_struct:
+		ret = _lttng_struct_type_statedump(frag, elem_type, nesting);
+		if (ret)
+			return ret;
+		break;
+	case atype_variant:
+		ret = _lttng_variant_type_statedump(frag, elem_type, nesting);
+		if (ret)
+			return ret;
+		break;
+	default:
+		return -EINVAL;
+	}
+	ret = lttng_metadata_fragment_printf(frag,
+		" _%s[ _%s ];\n",
+		field->name,
+		length_name);
+	return ret;
+}
+
+/*
+ * Render an enumeration type, named "name" or anonymous if NULL,
+ * without trailing declarator.
+ */
+static
+int _lttng_enum_type_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_enum_desc *enum_desc,
+		const struct lttng_integer_type *container_type,
+		const char *name, size_t nesting)
+{
+	int ret;
+	unsigned int i, nr_entries;
+
+	nr_entries = enum_desc->nr_entries;
+
+	ret = print_tabs(frag, nesting);
+	if (ret)
+		goto end;
+	ret = lttng_metadata_fragment_printf(frag,
+		"enum %s%s: integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } {\n",
+		name ? : "",
+		name ? " " : "",
+		container_type->size,
+		container_type->alignment,
+		container_type->signedness,
+		(container_type->encoding == lttng_encode_none)
+			? "none"
+			: (container_type->encoding == lttng_encode_UTF8)
+				? "UTF8"
+				: "ASCII",
+		container_type->base,
+#if __BYTE_ORDER == __BIG_ENDIAN
+		container_type->reverse_byte_order ? " byte_order = le;" : ""
+#else
+		container_type->reverse_byte_order ? " byte_order = be;" : ""
+#endif
+		);
+	if (ret)
 	        goto end;
 	/* Dump all entries */
 	for (i = 0; i < nr_entries; i++) {
 		const struct lttng_enum_entry *entry = &enum_desc->entries[i];
 		int j, len;
 
-		ret = print_tabs(session, nesting + 1);
-		if (ret)
-			goto end;
-		ret = lttng_metadata_printf(session,
-				"\"");
+		ret = print_tabs(frag, nesting + 1);
+		if (ret)
+			goto end;
+		ret = lttng_metadata_fragment_printf(frag,
+				"\"");
+		if (ret)
+			goto end;
+		len = strlen(entry->string);
+		/* Escape the character '"' */
+		for (j = 0; j < len; j++) {
+			char c = entry->string[j];
+
+			switch (c) {
+			case '"':
+				ret = lttng_metadata_fragment_printf(frag,
+						"\\\"");
+				break;
+			case '\\':
+				ret = lttng_metadata_fragment_printf(frag,
+						"\\\\");
+				break;
+			default:
+				ret = lttng_metadata_fragment_printf(frag,
+						"%c", c);
+				break;
+			}
+			if (ret)
+				goto end;
+		}
+		ret = lttng_metadata_fragment_printf(frag, "\"");
+		if (ret)
+			goto end;
+
+		if (entry->options.is_auto) {
+			ret = lttng_metadata_fragment_printf(frag, ",\n");
+			if (ret)
+				goto end;
+		} else {
+			ret = lttng_metadata_fragment_printf(frag,
+					" = ");
+			if (ret)
+				goto end;
+			if (entry->start.signedness)
+				ret = lttng_metadata_fragment_printf(frag,
+					"%lld", (long long) entry->start.value);
+			else
+				ret = lttng_metadata_fragment_printf(frag,
+					"%llu", entry->start.value);
+			if (ret)
+				goto end;
+			if (entry->start.signedness == entry->end.signedness &&
+					entry->start.value
+						== entry->end.value) {
+				ret = lttng_metadata_fragment_printf(frag,
+					",\n");
+			} else {
+				if (entry->end.signedness) {
+					ret = lttng_metadata_fragment_printf(frag,
+						" ... %lld,\n",
+						(long long) entry->end.value);
+				} else {
+					ret = lttng_metadata_fragment_printf(frag,
+						" ... %llu,\n",
+						entry->end.value);
+				}
+			}
+			if (ret)
+				goto end;
+		}
+	}
+	ret = print_tabs(frag, nesting);
+	if (ret)
+		goto end;
+	ret = lttng_metadata_fragment_printf(frag, "}");
+end:
+	return ret;
+}
+
+/*
+ * Name of the top level declaration of an enumeration with its
+ * container type. Returns NULL on allocation failure.
+ */
+static
+char *lttng_enum_decl_name(const struct lttng_enum_desc *enum_desc,
+		const struct lttng_integer_type *container_type)
+{
+	return kasprintf(GFP_KERNEL, "%s_%c%u_a%u_b%u%s%s",
+		enum_desc->name,
+		container_type->signedness ? 's' : 'u',
+		container_type->size,
+		container_type->alignment,
+		container_type->base,
+		container_type->reverse_byte_order ? "_r" : "",
+		(container_type->encoding == lttng_encode_none)
+			? ""
+			: (container_type->encoding == lttng_encode_UTF8)
+				? "_utf8"
+				: "_ascii");
+}
+
+/*
+ * Enumerations declared once at the top level of the session metadata,
+ * then referenced by name from the events and contexts using them.
+ */
+struct lttng_enum_decl {
+	struct hlist_node hlist;
+	const struct lttng_enum_desc *desc;
+	char name[];
+};
+
+static
+struct hlist_head *lttng_enum_decl_bucket(struct lttng_session *session,
+		const char *name)
+{
+	return &session->enum_decl_ht[jhash(name, strlen(name), 0)
+			& ((1U << LTTNG_ENUM_DECL_HT_BITS) - 1)];
+}
+
+static
+struct lttng_enum_decl *lttng_enum_decl_find(struct lttng_session *session,
+		const char *name)
+{
+	struct lttng_enum_decl *decl;
+
+	lttng_hlist_for_each_entry(decl, lttng_enum_decl_bucket(session, name),
+			hlist) {
+		if (!strcmp(decl->name, name))
+			return decl;
+	}
+	return NULL;
+}
+
+static
+void lttng_enum_decls_free(struct lttng_session *session)
+{
+	struct lttng_enum_decl *decl;
+	struct hlist_node *tmp;
+	unsigned int i;
+
+	for (i = 0; i < (1U << LTTNG_ENUM_DECL_HT_BITS); i++) {
+		lttng_hlist_for_each_entry_safe(decl, tmp,
+				&session->enum_decl_ht[i], hlist) {
+			hlist_del(&decl->hlist);
+			kfree(decl);
+		}
+	}
+}
+
+/*
+ * Declare an enumeration in the session metadata, unless already done.
+ * Returns 1 if another enumeration is declared with the same name, in
+ * which case this one is rendered inline.
+ * Must be called with sessions_mutex held, outside of any metadata
+ * block.
+ */
+static
+int _lttng_enum_decl_statedump(struct lttng_session *session,
+		const struct lttng_enum_desc *enum_desc,
+		const struct lttng_integer_type *container_type)
+{
+	struct lttng_metadata_fragment frag = { 0 };
+	struct lttng_enum_decl *decl;
+	char *name;
+	int ret;
+
+	name = lttng_enum_decl_name(enum_desc, container_type);
+	if (!name)
+		return -ENOMEM;
+	decl = lttng_enum_decl_find(session, name);
+	if (decl) {
+		ret = decl->desc != enum_desc;
+		goto end;
+	}
+	decl = kmalloc(sizeof(*decl) + strlen(name) + 1, GFP_KERNEL);
+	if (!decl) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	decl->desc = enum_desc;
+	strcpy(decl->name, name);
+	ret = _lttng_enum_type_statedump(&frag, enum_desc, container_type,
+			name, 0);
+	if (!ret)
+		ret = lttng_metadata_fragment_printf(&frag, ";\n\n");
+	if (!ret)
+		ret = lttng_metadata_write(session, frag.data, frag.len);
+	lttng_metadata_fragment_free(&frag);
+	if (ret) {
+		kfree(decl);
+		goto end;
+	}
+	hlist_add_head(&decl->hlist, lttng_enum_decl_bucket(session, name));
+end:
+	kfree(name);
+	return ret;
+}
+
+/*
+ * Declare the enumerations used by "fields" and their compound types.
+ * Returns the number of enumerations rendered inline because of a name
+ * clash, or a negative error.
+ */
+static
+int _lttng_fields_enum_decls_statedump(struct lttng_session *session,
+		const struct lttng_event_field *fields, unsigned int nr_fields)
+{
+	unsigned int i;
+	int clashes = 0;
+
+	for (i = 0; i < nr_fields; i++) {
+		const struct lttng_type *type = &fields[i].type;
+		int ret = 0;
+
+		switch (type->atype) {
+		case atype_enum:
+			ret = _lttng_enum_decl_statedump(session,
+				type->u.basic.enumeration.desc,
+				&type->u.basic.enumeration.container_type);
+			break;
+		case atype_struct:
+			ret = _lttng_fields_enum_decls_statedump(session,
+				type->u._struct.fields,
+				type->u._struct.nr_fields);
+			break;
+		case atype_variant:
+			ret = _lttng_fields_enum_decls_statedump(session,
+				type->u.variant.choices,
+				type->u.variant.nr_choices);
+			break;
+		case atype_array_compound:
+		case atype_sequence_compound:
+		{
+			const struct lttng_type *elem_type =
+				type->atype == atype_array_compound ?
+					type->u.array_compound.elem_type :
+					type->u.sequence_compound.elem_type;
+
+			if (elem_type->atype == atype_struct)
+				ret = _lttng_fields_enum_decls_statedump(session,
+					elem_type->u._struct.fields,
+					elem_type->u._struct.nr_fields);
+			else if (elem_type->atype == atype_variant)
+				ret = _lttng_fields_enum_decls_statedump(session,
+					elem_type->u.variant.choices,
+					elem_type->u.variant.nr_choices);
+			break;
+		}
+		default:
+			break;
+		}
+		if (ret < 0)
+			return ret;
+		clashes += ret;
+	}
+	return clashes;
+}
+
+static
+int _lttng_ctx_enum_decls_statedump(struct lttng_session *session,
+		const struct lttng_ctx *ctx)
+{
+	int clashes = 0;
+	unsigned int i;
+
+	if (!ctx)
+		return 0;
+	for (i = 0; i < ctx->nr_fields; i++) {
+		int ret;
+
+		ret = _lttng_fields_enum_decls_statedump(session,
+				&ctx->fields[i].event_field, 1);
+		if (ret < 0)
+			return ret;
+		clashes += ret;
+	}
+	return clashes;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_enum_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *field,
+		size_t nesting)
+{
+	const struct lttng_enum_desc *enum_desc;
+	const struct lttng_integer_type *container_type;
+	int ret;
+
+	enum_desc = field->type.u.basic.enumeration.desc;
+	container_type = &field->type.u.basic.enumeration.container_type;
+
+	if (frag->enum_ref || frag->session) {
+		struct lttng_enum_decl *decl = NULL;
+		char *name;
+
+		name = lttng_enum_decl_name(enum_desc, container_type);
+		if (!name)
+			return -ENOMEM;
+		if (frag->session)
+			decl = lttng_enum_decl_find(frag->session, name);
+		if (!frag->session || (decl && decl->desc == enum_desc)) {
+			ret = print_tabs(frag, nesting);
+			if (!ret)
+				ret = lttng_metadata_fragment_printf(frag,
+					"enum %s _%s;\n", name, field->name);
+			kfree(name);
+			return ret;
+		}
+		kfree(name);
+	}
+	ret = _lttng_enum_type_statedump(frag, enum_desc, container_type,
+			NULL, nesting);
+	if (ret)
+		return ret;
+	return lttng_metadata_fragment_printf(frag, " _%s;\n", field->name);
+}
+
+static
+int _lttng_delta_field_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *field,
+		size_t nesting);
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_field_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *field,
+		size_t nesting)
+{
+	int ret = 0;
+
+	if (field->delta && frag->delta)
+		return _lttng_delta_field_statedump(frag, field, nesting);
+	if (field->dict && frag->string_dict) {
+		ret = print_tabs(frag, nesting);
+		if (ret)
+			return ret;
+		return lttng_metadata_fragment_printf(frag,
+			"integer { size = 64; align = %u; signed = 0; encoding = none; base = 16; } _%s;\n",
+			(unsigned int) lttng_alignof(uint64_t) * CHAR_BIT,
+			field->name);
+	}
+	switch (field->type.atype) {
+	case atype_integer:
+		ret = print_tabs(frag, nesting);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_fragment_printf(frag,
+			"integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } _%s;\n",
+			field->type.u.basic.integer.size,
+			field->type.u.basic.integer.alignment,
+			field->type.u.basic.integer.signedness,
+			(field->type.u.basic.integer.encoding == lttng_encode_none)
+				? "none"
+				: (field->type.u.basic.integer.encoding == lttng_encode_UTF8)
+					? "UTF8"
+					: "ASCII",
+			field->type.u.basic.integer.base,
+#if __BYTE_ORDER == __BIG_ENDIAN
+			field->type.u.basic.integer.reverse_byte_order ? " byte_order = le;" : "",
+#else
+			field->type.u.basic.integer.reverse_byte_order ? " byte_order = be;" : "",
+#endif
+			field->name);
+		break;
+	case atype_enum:
+		ret = _lttng_enum_statedump(frag, field, nesting);
+		break;
+	case atype_array:
+	{
+		const struct lttng_basic_type *elem_type;
+
+		elem_type = &field->type.u.array.elem_type;
+		if (field->type.u.array.elem_alignment) {
+			ret = print_tabs(frag, nesting);
+			if (ret)
+				return ret;
+			ret = lttng_metadata_fragment_printf(frag,
+			"struct { } align(%u) _%s_padding;\n",
+					field->type.u.array.elem_alignment * CHAR_BIT,
+					field->name);
+			if (ret)
+				return ret;
+		}
+		ret = print_tabs(frag, nesting);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_fragment_printf(frag,
+			"integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } _%s[%u];\n",
+			elem_type->u.basic.integer.size,
+			elem_type->u.basic.integer.alignment,
+			elem_type->u.basic.integer.signedness,
+			(elem_type->u.basic.integer.encoding == lttng_encode_none)
+				? "none"
+				: (elem_type->u.basic.integer.encoding == lttng_encode_UTF8)
+					? "UTF8"
+					: "ASCII",
+			elem_type->u.basic.integer.base,
+#if __BYTE_ORDER == __BIG_ENDIAN
+			elem_type->u.basic.integer.reverse_byte_order ? " byte_order = le;" : "",
+#else
+			elem_type->u.basic.integer.reverse_byte_order ? " byte_order = be;" : "",
+#endif
+			field->name, field->type.u.array.length);
+		break;
+	}
+	case atype_sequence:
+	{
+		const struct lttng_basic_type *elem_type;
+		const struct lttng_basic_type *length_type;
+
+		elem_type = &field->type.u.sequence.elem_type;
+		length_type = &field->type.u.sequence.length_type;
+		ret = print_tabs(frag, nesting);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_fragment_printf(frag,
+			"integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } __%s_length;\n",
+			length_type->u.basic.integer.size,
+			(unsigned int) length_type->u.basic.integer.alignment,
+			length_type->u.basic.integer.signedness,
+			(length_type->u.basic.integer.encoding == lttng_encode_none)
+				? "none"
+				: ((length_type->u.basic.integer.encoding == lttng_encode_UTF8)
+					? "UTF8"
+					: "ASCII"),
+			length_type->u.basic.integer.base,
+#if __BYTE_ORDER == __BIG_ENDIAN
+			length_type->u.basic.integer.reverse_byte_order ? " byte_order = le;" : "",
+#else
+			length_type->u.basic.integer.reverse_byte_order ? " byte_order = be;" : "",
+#endif
+			field->name);
+		if (ret)
+			return ret;
+
+		if (field->type.u.sequence.elem_alignment) {
+			ret = print_tabs(frag, nesting);
+			if (ret)
+				return ret;
+			ret = lttng_metadata_fragment_printf(frag,
+			"struct { } align(%u) _%s_padding;\n",
+					field->type.u.sequence.elem_alignment * CHAR_BIT,
+					field->name);
+			if (ret)
+				return ret;
+		}
+		ret = print_tabs(frag, nesting);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_fragment_printf(frag,
+			"integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } _%s[ __%s_length ];\n",
+			elem_type->u.basic.integer.size,
+			(unsigned int) elem_type->u.basic.integer.alignment,
+			elem_type->u.basic.integer.signedness,
+			(elem_type->u.basic.integer.encoding == lttng_encode_none)
+				? "none"
+				: ((elem_type->u.basic.integer.encoding == lttng_encode_UTF8)
+					? "UTF8"
+					: "ASCII"),
+			elem_type->u.basic.integer.base,
+#if __BYTE_ORDER == __BIG_ENDIAN
+			elem_type->u.basic.integer.reverse_byte_order ? " byte_order = le;" : "",
+#else
+			elem_type->u.basic.integer.reverse_byte_order ? " byte_order = be;" : "",
+#endif
+			field->name,
+			field->name);
+		break;
+	}
+
+	case atype_string:
+		/* Default encoding is UTF8 */
+		ret = print_tabs(frag, nesting);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_fragment_printf(frag,
+			"string%s _%s;\n",
+			field->type.u.basic.string.encoding == lttng_encode_ASCII ?
+				" { encoding = ASCII; }" : "",
+			field->name);
+		break;
+	case atype_struct:
+		ret = _lttng_struct_statedump(frag, field, nesting);
+		break;
+	case atype_array_compound:
+		ret = _lttng_array_compound_statedump(frag, field, nesting);
+		break;
+	case atype_sequence_compound:
+		ret = _lttng_sequence_compound_statedump(frag, field, nesting);
+		break;
+	case atype_variant:
+		ret = _lttng_variant_statedump(frag, field, nesting);
+		break;
+
+	default:
+		WARN_ON_ONCE(1);
+		return -EINVAL;
+	}
+	return ret;
+}
+
+/*
+ * Packet-scoped contexts are a tag followed by a variant holding the
+ * value only when it changed since the previous event of the stream.
+ *
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_packet_scoped_context_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *field)
+{
+	struct lttng_event_field value_field = *field;
+	int ret;
+
+	ret = print_tabs(frag, 2);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_fragment_printf(frag,
+		"enum : uint8_t { _unchanged = 0, _changed = 1 } _%s_tag;\n",
+		field->name);
+	if (ret)
+		return ret;
+	ret = print_tabs(frag, 2);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_fragment_printf(frag,
+		"variant <_%s_tag> {\n", field->name);
+	if (ret)
+		return ret;
+	ret = print_tabs(frag, 3);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_fragment_printf(frag, "struct { } _unchanged;\n");
+	if (ret)
+		return ret;
+	value_field.name = "changed";
+	ret = _lttng_field_statedump(frag, &value_field, 3);
+	if (ret)
+		return ret;
+	ret = print_tabs(frag, 2);
+	if (ret)
+		return ret;
+	return lttng_metadata_fragment_printf(frag, "} _%s;\n", field->name);
+}
+
+/*
+ * Delta-encoded integers are a tag followed by a variant holding either
+ * the value or its difference with the base, see enum lttng_delta_tag.
+ * The differences are signed and byte-aligned.
+ */
+static
+int _lttng_delta_field_statedump(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *field,
+		size_t nesting)
+{
+	struct lttng_event_field value_field = *field;
+	unsigned int size;
+	int ret;
+
+	ret = print_tabs(frag, nesting);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_fragment_printf(frag,
+		"enum : uint8_t { _base = %u, _full = %u, _delta8 = %u, _delta16 = %u, _delta32 = %u } _%s_tag;\n",
+		LTTNG_DELTA_BASE, LTTNG_DELTA_FULL, LTTNG_DELTA_8,
+		LTTNG_DELTA_16, LTTNG_DELTA_32, field->name);
+	if (ret)
+		return ret;
+	ret = print_tabs(frag, nesting);
+	if (ret)
+		return ret;
+	ret = lttng_metadata_fragment_printf(frag,
+		"variant <_%s_tag> {\n", field->name);
+	if (ret)
+		return ret;
+	value_field.delta = 0;
+	value_field.name = "base";
+	ret = _lttng_field_statedump(frag, &value_field, nesting + 1);
+	if (ret)
+		return ret;
+	value_field.name = "full";
+	ret = _lttng_field_statedump(frag, &value_field, nesting + 1);
+	if (ret)
+		return ret;
+	for (size = 8; size <= 32; size <<= 1) {
+		ret = print_tabs(frag, nesting + 1);
+		if (ret)
+			return ret;
+		ret = lttng_metadata_fragment_printf(frag,
+			"integer { size = %u; align = 8; signed = 1; encoding = none; base = 10; } _delta%u;\n",
+			size, size);
+		if (ret)
+			return ret;
+	}
+	ret = print_tabs(frag, nesting);
+	if (ret)
+		return ret;
+	return lttng_metadata_fragment_printf(frag, "} _%s;\n", field->name);
+}
+
+static
+int _lttng_context_metadata_statedump(struct lttng_session *session,
+				    struct lttng_ctx *ctx)
+{
+	struct lttng_metadata_fragment frag = { 0 };
+	int ret = 0;
+	int i;
+
+	if (!ctx)
+		return 0;
+	frag.session = session;
+	for (i = 0; i < ctx->nr_fields; i++) {
+		const struct lttng_ctx_field *field = &ctx->fields[i];
+
+		if (field->packet_scoped) {
+			ret = _lttng_packet_scoped_context_statedump(&frag,
+					&field->event_field);
+			if (ret)
+				goto end;
+			continue;
+		}
+		ret = _lttng_field_statedump(&frag, &field->event_field, 2);
+		if (ret)
+			goto end;
+	}
+	ret = lttng_metadata_write(session, frag.data, frag.len);
+end:
+	lttng_metadata_fragment_free(&frag);
+	return ret;
+}
+
+/*
+ * Render the TSDL of the payload fields of an event description. It does
+ * not depend on the session, so probes cache it at registration.
+ */
+int lttng_event_desc_metadata_render(const struct lttng_event_desc *desc,
+		struct lttng_metadata_fragment *frag)
+{
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < desc->nr_fields; i++) {
+		const struct lttng_event_field *field = &desc->fields[i];
+
+		ret = _lttng_field_statedump(frag, field, 2);
+		if (ret)
+			return ret;
+	}
+	return ret;
+}
+
+/*
+ * The cached text references all its enumerations by name: it can only
+ * be used if none of them clashes with another declared enumeration.
+ */
+static
+int _lttng_fields_metadata_statedump(struct lttng_session *session,
+				   struct lttng_event *event,
+				   int enum_clashes)
+{
+	struct lttng_metadata_shared *cached;
+	struct lttng_metadata_fragment frag = { 0 };
+	int ret;
+
+	/* The cache holds the text of channels without a dictionary. */
+	frag.string_dict = event->string_dict;
+	frag.delta = !!event->delta_state;
+	frag.session = session;
+	if (!event->string_dict && !event->delta_state && !enum_clashes) {
+		cached = lttng_event_desc_metadata_get(event->desc);
+		if (cached)
+			return lttng_metadata_append(session, cached->data,
+					cached->len, cached);
+	}
+	/* Descriptions created at runtime, e.g. kprobes, are not cached. */
+	ret = lttng_event_desc_metadata_render(event->desc, &frag);
+	if (!ret)
+		ret = lttng_metadata_write(session, frag.data, frag.len);
+	lttng_metadata_fragment_free(&frag);
+	return ret;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_event_metadata_statedump(struct lttng_session *session,
+				  struct lttng_channel *chan,
+				  struct lttng_event *event)
+{
+	int ret = 0, enum_clashes;
+
+	if (event->metadata_dumped || !ACCESS_ONCE(session->active))
+		return 0;
+	if (chan->channel_type == METADATA_CHANNEL)
+		return 0;
+
+	ret = _lttng_ctx_enum_decls_statedump(session, event->ctx);
+	if (ret < 0)
+		goto end;
+	enum_clashes = _lttng_fields_enum_decls_statedump(session,
+			event->desc->fields, event->desc->nr_fields);
+	if (enum_clashes < 0) {
+		ret = enum_clashes;
+		goto end;
+	}
+
+	ret = lttng_metadata_printf(session,
+		"event {\n"
+		"	name = \"%s\";\n"
+		"	id = %u;\n"
+		"	stream_id = %u;\n",
+		event->desc->name,
+		event->id,
+		event->chan->id);
+	if (ret)
+		goto end;
+
+	if (event->ctx) {
+		ret = lttng_metadata_printf(session,
+			"	context := struct {\n");
+		if (ret)
+			goto end;
+	}
+	ret = _lttng_context_metadata_statedump(session, event->ctx);
+	if (ret)
+		goto end;
+	if (event->ctx) {
+		ret = lttng_metadata_printf(session,
+			"	};\n");
+		if (ret)
+			goto end;
+	}
+
+	ret = lttng_metadata_printf(session,
+		"	fields := struct {\n"
+		);
+	if (ret)
+		goto end;
+
+	ret = _lttng_fields_metadata_statedump(session, event, enum_clashes);
+	if (ret)
+		goto end;
+
+	/*
+	 * LTTng space reservation can only reserve multiples of the
+	 * byte size.
+	 */
+	ret = lttng_metadata_printf(session,
+		"	};\n"
+		"};\n\n");
+	if (ret)
+		goto end;
+
+	event->metadata_dumped = 1;
+end:
+	return ret;
+
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_channel_metadata_statedump(struct lttng_session *session,
+				    struct lttng_channel *chan)
+{
+	int ret = 0;
+
+	if (chan->metadata_dumped || !ACCESS_ONCE(session->active))
+		return 0;
+
+	if (chan->channel_type == METADATA_CHANNEL)
+		return 0;
+
+	ret = _lttng_ctx_enum_decls_statedump(session, chan->ctx);
+	if (ret < 0)
+		goto end;
+
+	WARN_ON_ONCE(!chan->header_type);
+	ret = lttng_metadata_printf(session,
+		"stream {\n"
+		"	id = %u;\n"
+		"	event.header := %s;\n"
+		"	packet.context := struct packet_context;\n",
+		chan->id,
+		chan->header_type == 1 ? "struct event_header_compact" :
+		chan->header_type == 2 ? "struct event_header_large" :
+		chan->header_type == 3 ? "struct event_header_dense" :
+			"struct event_header_untimed");
+	if (ret)
+		goto end;
+
+	if (chan->ctx) {
+		ret = lttng_metadata_printf(session,
+			"	event.context := struct {\n");
+		if (ret)
+			goto end;
+	}
+	ret = _lttng_context_metadata_statedump(session, chan->ctx);
+	if (ret)
+		goto end;
+	if (chan->ctx) {
+		ret = lttng_metadata_printf(session,
+			"	};\n");
+		if (ret)
+			goto end;
+	}
+
+	ret = lttng_metadata_printf(session,
+		"};\n\n");
+
+	chan->metadata_dumped = 1;
+end:
+	return ret;
+}
+
+/*
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_stream_packet_context_declare(struct lttng_session *session)
+{
+	return lttng_metadata_printf(session,
+		"struct packet_context {\n"
+		"	uint64_clock_monotonic_t timestamp_begin;\n"
+		"	uint64_clock_monotonic_t timestamp_end;\n"
+		"	uint64_t content_size;\n"
+		"	uint64_t packet_size;\n"
+		"	uint64_t packet_seq_num;\n"
+		"	unsigned long events_discarded;\n"
+		"	uint32_t cpu_id;\n"
+		"	uint32_t packet_crc32c;\n"
+		"	uint64_t pvclock_tsc_timestamp;\n"
+		"	uint64_t pvclock_system_time;\n"
+		"	uint32_t pvclock_tsc_to_system_mul;\n"
+		"	integer { size = 8; align = 8; signed = true; } pvclock_tsc_shift;\n"
+		"	uint8_t pvclock_flags;\n"
+		"};\n\n"
+		);
+}
+
+/*
+ * Compact header:
+ * id: range: 0 - 30.
+ * id 31 is reserved to indicate an extended header.
+ *
+ * Large header:
+ * id: range: 0 - 65534.
+ * id 65535 is reserved to indicate an extended header.
+ *
+ * Dense header:
+ * tag: selects the width of the event id (5, 8, 16 or 32 bits) and of
+ * the timestamp (16, 32 or 64 bits). The 5-bit id is used unless the
+ * variant holds a wider one. Truncated timestamps are deltas from the
+ * previous record of the stream, reconstructed by readers from wrap-around.
+ *
+ * Untimed header:
+ * id: range: 0 - 254.
+ * id 255 is reserved to indicate an extended header. No timestamp: the
+ * time of the records is interpolated within their packet.
+ *
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_event_header_declare(struct lttng_session *session)
+{
+	return lttng_metadata_printf(session,
+	"struct event_header_compact {\n"
+	"	enum : uint5_t { compact = 0 ... 30, extended = 31 } id;\n"
+	"	variant <id> {\n"
+	"		struct {\n"
+	"			uint27_clock_monotonic_t timestamp;\n"
+	"		} compact;\n"
+	"		struct {\n"
+	"			uint32_t id;\n"
+	"			uint64_clock_monotonic_t timestamp;\n"
+	"		} extended;\n"
+	"	} v;\n"
+	"} align(%u);\n"
+	"\n"
+	"struct event_header_large {\n"
+	"	enum : uint16_t { compact = 0 ... 65534, extended = 65535 } id;\n"
+	"	variant <id> {\n"
+	"		struct {\n"
+	"			uint32_clock_monotonic_t timestamp;\n"
+	"		} compact;\n"
+	"		struct {\n"
+	"			uint32_t id;\n"
+	"			uint64_clock_monotonic_t timestamp;\n"
+	"		} extended;\n"
+	"	} v;\n"
+	"} align(%u);\n"
+	"\n"
+	"struct event_header_dense {\n"
+	"	enum : uint3_t { id5_ts16 = 0, id5_ts32 = 1, id8_ts16 = 2, id8_ts32 = 3,\n"
+	"		id16_ts16 = 4, id16_ts32 = 5, id5_ts64 = 6, extended = 7 } tag;\n"
+	"	uint5_t id;\n"
+	"	variant <tag> {\n"
+	"		struct {\n"
+	"			uint16_clock_monotonic_t timestamp;\n"
+	"		} id5_ts16;\n"
+	"		struct {\n"
+	"			uint32_clock_monotonic_t timestamp;\n"
+	"		} id5_ts32;\n"
+	"		struct {\n"
+	"			uint8_t id;\n"
+	"			uint16_clock_monotonic_t timestamp;\n"
+	"		} id8_ts16;\n"
+	"		struct {\n"
+	"			uint8_t id;\n"
+	"			uint32_clock_monotonic_t timestamp;\n"
+	"		} id8_ts32;\n"
+	"		struct {\n"
+	"			uint16_t id;\n"
+	"			uint16_clock_monotonic_t timestamp;\n"
+	"		} id16_ts16;\n"
+	"		struct {\n"
+	"			uint16_t id;\n"
+	"			uint32_clock_monotonic_t timestamp;\n"
+	"		} id16_ts32;\n"
+	"		struct {\n"
+	"			uint64_clock_monotonic_t timestamp;\n"
+	"		} id5_ts64;\n"
+	"		struct {\n"
+	"			uint32_t id;\n"
+	"			uint64_clock_monotonic_t timestamp;\n"
+	"		} extended;\n"
+	"	} v;\n"
+	"} align(%u);\n"
+	"\n"
+	"struct event_header_untimed {\n"
+	"	enum : uint8_t { compact = 0 ... 254, extended = 255 } id;\n"
+	"	variant <id> {\n"
+	"		struct {\n"
+	"		} compact;\n"
+	"		struct {\n"
+	"			uint32_t id;\n"
+	"		} extended;\n"
+	"	} v;\n"
+	"} align(%u);\n\n",
+	lttng_alignof(uint32_t) * CHAR_BIT,
+	lttng_alignof(uint16_t) * CHAR_BIT,
+	lttng_alignof(uint8_t) * CHAR_BIT,
+	lttng_alignof(uint8_t) * CHAR_BIT
+	);
+}
+
+ /*
+ * Approximation of NTP time of day to clock monotonic correlation,
+ * taken at start of trace.
+ * Yes, this is only an approximation. Yes, we can (and will) do better
+ * in future versions.
+ * This function may return a negative offset. It may happen if the
+ * system sets the REALTIME clock to 0 after boot.
+ */
+static
+int64_t measure_clock_offset(void)
+{
+	uint64_t monotonic_avg, monotonic[2], realtime;
+	uint64_t tcf = trace_clock_freq();
+	int64_t offset;
+	struct timespec rts = { 0, 0 };
+	unsigned long flags;
+
+	/* Disable interrupts to increase correlation precision. */
+	local_irq_save(flags);
+	monotonic[0] = trace_clock_read64();
+	getnstimeofday(&rts);
+	monotonic[1] = trace_clock_read64();
+	local_irq_restore(flags);
+
+	monotonic_avg = (monotonic[0] + monotonic[1]) >> 1;
+	realtime = (uint64_t) rts.tv_sec * tcf;
+	if (tcf == NSEC_PER_SEC) {
+		realtime += rts.tv_nsec;
+	} else {
+		uint64_t n = rts.tv_nsec * tcf;
+
+		do_div(n, NSEC_PER_SEC);
+		realtime += n;
+	}
+	offset = (int64_t) realtime - monotonic_avg;
+	return offset;
+}
+
+/*
+ * Output metadata into this session's metadata buffers.
+ * Must be called with sessions_mutex held.
+ */
+static
+int _lttng_session_metadata_statedump(struct lttng_session *session)
+{
+	unsigned char *uuid_c = session->uuid.b;
+	unsigned char uuid_s[37], clock_uuid_s[BOOT_ID_LEN];
+	struct lttng_channel *chan;
+	struct lttng_event *event;
+	int ret = 0;
+
+	if (!ACCESS_ONCE(session->active))
+		return 0;
+	if (session->metadata_dumped)
+		goto skip_session;
+
+	snprintf(uuid_s, sizeof(uuid_s),
+		"%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+		uuid_c[0], uuid_c[1], uuid_c[2], uuid_c[3],
+		uuid_c[4], uuid_c[5], uuid_c[6], uuid_c[7],
+		uuid_c[8], uuid_c[9], uuid_c[10], uuid_c[11],
+		uuid_c[12], uuid_c[13], uuid_c[14], uuid_c[15]);
+
+	ret = lttng_metadata_printf(session,
+		"typealias integer { size = 8; align = %u; signed = false; } := uint8_t;\n"
+		"typealias integer { size = 16; align = %u; signed = false; } := uint16_t;\n"
+		"typealias integer { size = 32; align = %u; signed = false; } := uint32_t;\n"
+		"typealias integer { size = 64; align = %u; signed = false; } := uint64_t;\n"
+		"typealias integer { size = %u; align = %u; signed = false; } := unsigned long;\n"
+		"typealias integer { size = 3; align = 1; signed = false; } := uint3_t;\n"
+		"typealias integer { size = 5; align = 1; signed = false; } := uint5_t;\n"
+		"typealias integer { size = 27; align = 1; signed = false; } := uint27_t;\n"
+		"\n"
+		"trace {\n"
+		"	major = %u;\n"
+		"	minor = %u;\n"
+		"	uuid = \"%s\";\n"
+		"	byte_order = %s;\n"
+		"	packet.header := struct {\n"
+		"		uint32_t magic;\n"
+		"		uint8_t  uuid[16];\n"
+		"		uint32_t stream_id;\n"
+		"		uint64_t stream_instance_id;\n"
+		"	};\n"
+		"};\n\n",
+		lttng_alignof(uint8_t) * CHAR_BIT,
+		lttng_alignof(uint16_t) * CHAR_BIT,
+		lttng_alignof(uint32_t) * CHAR_BIT,
+		lttng_alignof(uint64_t) * CHAR_BIT,
+		sizeof(unsigned long) * CHAR_BIT,
+		lttng_alignof(unsigned long) * CHAR_BIT,
+		CTF_SPEC_MAJOR,
+		CTF_SPEC_MINOR,
+		uuid_s,
+#if __BYTE_ORDER == __BIG_ENDIAN
+		"be"
+#else
+		"le"
+#endif
+		);
+	if (ret)
+		goto end;
+
+	ret = lttng_metadata_printf(session,
+		"env {\n"
+		"	hostname = \"%s\";\n"
+		"	domain = \"kernel\";\n"
+		"	sysname = \"%s\";\n"
+		"	kernel_release = \"%s\";\n"
+		"	kernel_version = \"%s\";\n"
+		"	tracer_name = \"lttng-modules\";\n"
+		"	tracer_major = %d;\n"
+		"	tracer_minor = %d;\n"
+		"	tracer_patchlevel = %d;\n"
+		"};\n\n",
+		current->nsproxy->uts_ns->name.nodename,
+		utsname()->sysname,
+		utsname()->release,
+		utsname()->version,
+		LTTNG_MODULES_MAJOR_VERSION,
+		LTTNG_MODULES_MINOR_VERSION,
+		LTTNG_MODULES_PATCHLEVEL_VERSION
+		);
+	if (ret)
+		goto end;
+
+	ret = lttng_metadata_printf(session,
+		"clock {\n"
+		"	name = \"%s\";\n",
+		trace_clock_name()
+		);
+	if (ret)
+		goto end;
+
+	if (!trace_clock_uuid(clock_uuid_s)) {
+		ret = lttng_metadata_printf(session,
+			"	uuid = \"%s\";\n",
+			clock_uuid_s
+			);
+		if (ret)
+			goto end;
+	}
+
+	ret = lttng_metadata_printf(session,
+		"	description = \"%s\";\n"
+		"	freq = %llu; /* Frequency, in Hz */\n"
+		"	/* clock value offset from Epoch is: offset * (1/freq) */\n"
+		"	offset = %lld;\n"
+		"};\n\n",
+		trace_clock_description(),
+		(unsigned long long) trace_clock_freq(),
+		(long long) measure_clock_offset()
+		);
+	if (ret)
+		goto end;
+
+	ret = lttng_metadata_printf(session,
+		"typealias integer {\n"
+		"	size = 27; align = 1; signed = false;\n"
+		"	map = clock.%s.value;\n"
+		"} := uint27_clock_monotonic_t;\n"
+		"\n"
+		"typealias integer {\n"
+		"	size = 16; align = %u; signed = false;\n"
+		"	map = clock.%s.value;\n"
+		"} := uint16_clock_monotonic_t;\n"
+		"\n"
+		"typealias integer {\n"
+		"	size = 32; align = %u; signed = false;\n"
+		"	map = clock.%s.value;\n"
+		"} := uint32_clock_monotonic_t;\n"
+		"\n"
+		"typealias integer {\n"
+		"	size = 64; align = %u; signed = false;\n"
+		"	map = clock.%s.value;\n"
+		"} := uint64_clock_monotonic_t;\n\n",
+		trace_clock_name(),
+		lttng_alignof(uint16_t) * CHAR_BIT,
+		trace_clock_name(),
+		lttng_alignof(uint32_t) * CHAR_BIT,
+		trace_clock_name(),
+		lttng_alignof(uint64_t) * CHAR_BIT,
+		trace_clock_name()
+		);
+	if (ret)
+		goto end;
+
+	ret = _lttng_stream_packet_context_declare(session);
+	if (ret)
+		goto end;
+
+	ret = _lttng_event_header_declare(session);
+	if (ret)
+		goto end;
+
+skip_session:
+	list_for_each_entry(chan, &session->chan, list) {
+		ret = _lttng_channel_metadata_statedump(session, chan);
 		if (ret)
 			goto end;
-		len = strlen(entry->string);
-		/* Escape the character '"' */
-		for (j = 0; j < len; j++) {
-			char c = entry->string[j];
+	}
 
-			switch (c) {
-			case '"':
-				ret = lttng_metadata_printf(session,
-						"\\\"");
-				break;
-			case '\\':
-				ret = lttng_metadata_printf(session,
-						"\\\\");
-				break;
-			default:
-				ret = lttng_metadata_printf(session,
-						"%c", c);
-				break;
-			}
-			if (ret)
-				goto end;
-		}
-		ret = lttng_metadata_printf(session, "\"");
+	list_for_each_entry(event, &session->events, list) {
+		ret = _lttng_event_metadata_statedump(session, event->chan, event);
 		if (ret)
 			goto end;
-
-		if (entry->options.is_auto) {
-			ret = lttng_metadata_printf(session, ",\n");
-			if (ret)
-				goto end;
-		} else {
-			ret = lttng_metadata_printf(session,
-					" = ");
-			if (ret)
-				goto end;
-			if (entry->start.signedness)
-				ret = lttng_metadata_printf(session,
-					"%lld", (long long) entry->start.value);
-			else
-				ret = lttng_metadata_printf(session,
-					"%llu", entry->start.value);
-			if (ret)
-				goto end;
-			if (entry->start.signedness == entry->end.signedness &&
-					entry->start.value
-						== entry->end.value) {
-				ret = lttng_metadata_printf(session,
-					",\n");
-			} else {
-				if (entry->end.signedness) {
-					ret = lttng_metadata_printf(session,
-						" ... %lld,\n",
-						(long long) entry->end.value);
-				} else {
-					ret = lttng_metadata_printf(session,
-						" ... %llu,\n",
-						entry->end.value);
-				}
-			}
-			if (ret)
-				goto end;
-		}
 	}
-	ret = print_tabs(session, nesting);
-	if (ret)
-		goto end;
-	ret = lttng_metadata_printf(session, "} _%s;\n",
-			field->name);
+	session->metadata_dumped = 1;
 end:
 	return ret;
 }
 
 /*
- * Must be called with sessions_mutex held.
+ * Compact binary metadata encoding, described with
+ * struct lttng_kernel_session_metadata_binary.
  */
 static
-int _lttng_field_statedump(struct lttng_session *session,
-		const struct lttng_event_field *field,
-		size_t nesting)
+int mdb_write(struct lttng_metadata_fragment *frag, const void *data,
+		size_t len)
 {
-	int ret = 0;
+	int ret;
 
-	switch (field->type.atype) {
-	case atype_integer:
-		ret = print_tabs(session, nesting);
-		if (ret)
-			return ret;
-		ret = lttng_metadata_printf(session,
-			"integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } _%s;\n",
-			field->type.u.basic.integer.size,
-			field->type.u.basic.integer.alignment,
-			field->type.u.basic.integer.signedness,
-			(field->type.u.basic.integer.encoding == lttng_encode_none)
-				? "none"
-				: (field->type.u.basic.integer.encoding == lttng_encode_UTF8)
-					? "UTF8"
-					: "ASCII",
-			field->type.u.basic.integer.base,
-#if __BYTE_ORDER == __BIG_ENDIAN
-			field->type.u.basic.integer.reverse_byte_order ? " byte_order = le;" : "",
-#else
-			field->type.u.basic.integer.reverse_byte_order ? " byte_order = be;" : "",
-#endif
-			field->name);
-		break;
-	case atype_enum:
-		ret = _lttng_enum_statedump(session, field, nesting);
-		break;
-	case atype_array:
-	{
-		const struct lttng_basic_type *elem_type;
+	ret = lttng_metadata_fragment_reserve(frag, len);
+	if (ret)
+		return ret;
+	memcpy(frag->data + frag->len, data, len);
+	frag->len += len;
+	return 0;
+}
 
-		elem_type = &field->type.u.array.elem_type;
-		if (field->type.u.array.elem_alignment) {
-			ret = print_tabs(session, nesting);
-			if (ret)
-				return ret;
-			ret = lttng_metadata_printf(session,
-			"struct { } align(%u) _%s_padding;\n",
-					field->type.u.array.elem_alignment * CHAR_BIT,
-					field->name);
-			if (ret)
-				return ret;
+static
+int mdb_u8(struct lttng_metadata_fragment *frag, uint8_t v)
+{
+	return mdb_write(frag, &v, sizeof(v));
+}
+
+static
+int mdb_uleb(struct lttng_metadata_fragment *frag, uint64_t v)
+{
+	uint8_t buf[10];
+	size_t len = 0;
+
+	do {
+		buf[len] = v & 0x7f;
+		v >>= 7;
+		if (v)
+			buf[len] |= 0x80;
+		len++;
+	} while (v);
+	return mdb_write(frag, buf, len);
+}
+
+static
+int mdb_sleb(struct lttng_metadata_fragment *frag, int64_t v)
+{
+	uint8_t buf[10];
+	size_t len = 0;
+
+	for (;;) {
+		uint8_t byte = v & 0x7f;
+
+		v >>= 7;	/* Arithmetic shift */
+		if ((v == 0 && !(byte & 0x40)) || (v == -1 && (byte & 0x40))) {
+			buf[len++] = byte;
+			break;
 		}
-		ret = print_tabs(session, nesting);
-		if (ret)
-			return ret;
-		ret = lttng_metadata_printf(session,
-			"integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } _%s[%u];\n",
-			elem_type->u.basic.integer.size,
-			elem_type->u.basic.integer.alignment,
-			elem_type->u.basic.integer.signedness,
-			(elem_type->u.basic.integer.encoding == lttng_encode_none)
-				? "none"
-				: (elem_type->u.basic.integer.encoding == lttng_encode_UTF8)
-					? "UTF8"
-					: "ASCII",
-			elem_type->u.basic.integer.base,
-#if __BYTE_ORDER == __BIG_ENDIAN
-			elem_type->u.basic.integer.reverse_byte_order ? " byte_order = le;" : "",
-#else
-			elem_type->u.basic.integer.reverse_byte_order ? " byte_order = be;" : "",
-#endif
-			field->name, field->type.u.array.length);
-		break;
+		buf[len++] = byte | 0x80;
 	}
-	case atype_sequence:
-	{
-		const struct lttng_basic_type *elem_type;
-		const struct lttng_basic_type *length_type;
+	return mdb_write(frag, buf, len);
+}
 
-		elem_type = &field->type.u.sequence.elem_type;
-		length_type = &field->type.u.sequence.length_type;
-		ret = print_tabs(session, nesting);
-		if (ret)
-			return ret;
-		ret = lttng_metadata_printf(session,
-			"integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } __%s_length;\n",
-			length_type->u.basic.integer.size,
-			(unsigned int) length_type->u.basic.integer.alignment,
-			length_type->u.basic.integer.signedness,
-			(length_type->u.basic.integer.encoding == lttng_encode_none)
-				? "none"
-				: ((length_type->u.basic.integer.encoding == lttng_encode_UTF8)
-					? "UTF8"
-					: "ASCII"),
-			length_type->u.basic.integer.base,
-#if __BYTE_ORDER == __BIG_ENDIAN
-			length_type->u.basic.integer.reverse_byte_order ? " byte_order = le;" : "",
-#else
-			length_type->u.basic.integer.reverse_byte_order ? " byte_order = be;" : "",
-#endif
-			field->name);
-		if (ret)
-			return ret;
+static
+int mdb_string(struct lttng_metadata_fragment *frag, const char *str)
+{
+	size_t len = strlen(str);
+	int ret;
 
-		if (field->type.u.sequence.elem_alignment) {
-			ret = print_tabs(session, nesting);
-			if (ret)
-				return ret;
-			ret = lttng_metadata_printf(session,
-			"struct { } align(%u) _%s_padding;\n",
-					field->type.u.sequence.elem_alignment * CHAR_BIT,
-					field->name);
-			if (ret)
-				return ret;
-		}
-		ret = print_tabs(session, nesting);
-		if (ret)
-			return ret;
-		ret = lttng_metadata_printf(session,
-			"integer { size = %u; align = %u; signed = %u; encoding = %s; base = %u;%s } _%s[ __%s_length ];\n",
-			elem_type->u.basic.integer.size,
-			(unsigned int) elem_type->u.basic.integer.alignment,
-			elem_type->u.basic.integer.signedness,
-			(elem_type->u.basic.integer.encoding == lttng_encode_none)
-				? "none"
-				: ((elem_type->u.basic.integer.encoding == lttng_encode_UTF8)
-					? "UTF8"
-					: "ASCII"),
-			elem_type->u.basic.integer.base,
-#if __BYTE_ORDER == __BIG_ENDIAN
-			elem_type->u.basic.integer.reverse_byte_order ? " byte_order = le;" : "",
-#else
-			elem_type->u.basic.integer.reverse_byte_order ? " byte_order = be;" : "",
-#endif
-			field->name,
-			field->name);
-		break;
+	ret = mdb_uleb(frag, len);
+	if (ret)
+		return ret;
+	return mdb_write(frag, str, len);
+}
+
+static
+int mdb_integer(struct lttng_metadata_fragment *frag,
+		const struct lttng_integer_type *integer)
+{
+	uint8_t flags = 0;
+	int ret;
+
+	if (integer->signedness)
+		flags |= LTTNG_KERNEL_MDB_INT_SIGNED;
+	if (integer->reverse_byte_order)
+		flags |= LTTNG_KERNEL_MDB_INT_REVERSE_BYTE_ORDER;
+	ret = mdb_u8(frag, LTTNG_KERNEL_MDB_TYPE_INTEGER);
+	if (!ret)
+		ret = mdb_uleb(frag, integer->size);
+	if (!ret)
+		ret = mdb_uleb(frag, integer->alignment);
+	if (!ret)
+		ret = mdb_u8(frag, flags);
+	if (!ret)
+		ret = mdb_uleb(frag, integer->base);
+	if (!ret)
+		ret = mdb_u8(frag, integer->encoding);
+	return ret;
+}
+
+static
+int mdb_enum_value(struct lttng_metadata_fragment *frag,
+		const struct lttng_enum_value *value)
+{
+	if (value->signedness)
+		return mdb_sleb(frag, (int64_t) value->value);
+	return mdb_uleb(frag, value->value);
+}
+
+static
+int mdb_enum(struct lttng_metadata_fragment *frag,
+		const struct lttng_enum_desc *desc,
+		const struct lttng_integer_type *container_type)
+{
+	unsigned int i;
+	int ret;
+
+	ret = mdb_u8(frag, LTTNG_KERNEL_MDB_TYPE_ENUM);
+	if (!ret)
+		ret = mdb_string(frag, desc->name);
+	if (!ret)
+		ret = mdb_integer(frag, container_type);
+	if (!ret)
+		ret = mdb_uleb(frag, desc->nr_entries);
+	for (i = 0; !ret && i < desc->nr_entries; i++) {
+		const struct lttng_enum_entry *entry = &desc->entries[i];
+		uint8_t flags = 0;
+
+		if (entry->start.signedness)
+			flags |= LTTNG_KERNEL_MDB_ENUM_START_SIGNED;
+		if (entry->end.signedness)
+			flags |= LTTNG_KERNEL_MDB_ENUM_END_SIGNED;
+		if (entry->options.is_auto)
+			flags |= LTTNG_KERNEL_MDB_ENUM_AUTO;
+		ret = mdb_u8(frag, flags);
+		if (!ret)
+			ret = mdb_enum_value(frag, &entry->start);
+		if (!ret)
+			ret = mdb_enum_value(frag, &entry->end);
+		if (!ret)
+			ret = mdb_string(frag, entry->string);
 	}
+	return ret;
+}
+
+static
+int mdb_basic_type(struct lttng_metadata_fragment *frag,
+		enum abstract_types atype, const union _lttng_basic_type *basic)
+{
+	int ret;
 
+	switch (atype) {
+	case atype_integer:
+		return mdb_integer(frag, &basic->integer);
+	case atype_enum:
+		return mdb_enum(frag, basic->enumeration.desc,
+				&basic->enumeration.container_type);
 	case atype_string:
-		/* Default encoding is UTF8 */
-		ret = print_tabs(session, nesting);
+		ret = mdb_u8(frag, LTTNG_KERNEL_MDB_TYPE_STRING);
 		if (ret)
 			return ret;
-		ret = lttng_metadata_printf(session,
-			"string%s _%s;\n",
-			field->type.u.basic.string.encoding == lttng_encode_ASCII ?
-				" { encoding = ASCII; }" : "",
-			field->name);
-		break;
+		return mdb_u8(frag, basic->string.encoding);
+	default:
+		WARN_ON_ONCE(1);
+		return -EINVAL;
+	}
+}
+
+static
+int mdb_fields(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *fields, unsigned int nr_fields,
+		int string_dict);
+
+static
+int mdb_type(struct lttng_metadata_fragment *frag,
+		const struct lttng_type *type, int string_dict)
+{
+	int ret;
+
+	switch (type->atype) {
+	case atype_integer:
+	case atype_enum:
+	case atype_string:
+		return mdb_basic_type(frag, type->atype, &type->u.basic);
+	case atype_array:
+		ret = mdb_u8(frag, LTTNG_KERNEL_MDB_TYPE_ARRAY);
+		if (!ret)
+			ret = mdb_basic_type(frag, type->u.array.elem_type.atype,
+					&type->u.array.elem_type.u.basic);
+		if (!ret)
+			ret = mdb_uleb(frag, type->u.array.length);
+		if (!ret)
+			ret = mdb_uleb(frag, type->u.array.elem_alignment);
+		return ret;
+	case atype_sequence:
+		ret = mdb_u8(frag, LTTNG_KERNEL_MDB_TYPE_SEQUENCE);
+		if (!ret)
+			ret = mdb_basic_type(frag,
+					type->u.sequence.length_type.atype,
+					&type->u.sequence.length_type.u.basic);
+		if (!ret)
+			ret = mdb_basic_type(frag,
+					type->u.sequence.elem_type.atype,
+					&type->u.sequence.elem_type.u.basic);
+		if (!ret)
+			ret = mdb_uleb(frag, type->u.sequence.elem_alignment);
+		return ret;
 	case atype_struct:
-		ret = _lttng_struct_statedump(session, field, nesting);
-		break;
+		ret = mdb_u8(frag, LTTNG_KERNEL_MDB_TYPE_STRUCT);
+		if (!ret)
+			ret = mdb_fields(frag, type->u._struct.fields,
+					type->u._struct.nr_fields, string_dict);
+		return ret;
 	case atype_array_compound:
-		ret = _lttng_array_compound_statedump(session, field, nesting);
-		break;
+		ret = mdb_u8(frag, LTTNG_KERNEL_MDB_TYPE_ARRAY_COMPOUND);
+		if (!ret)
+			ret = mdb_type(frag, type->u.array_compound.elem_type,
+					string_dict);
+		if (!ret)
+			ret = mdb_uleb(frag, type->u.array_compound.length);
+		return ret;
 	case atype_sequence_compound:
-		ret = _lttng_sequence_compound_statedump(session, field, nesting);
-		break;
+		ret = mdb_u8(frag, LTTNG_KERNEL_MDB_TYPE_SEQUENCE_COMPOUND);
+		if (!ret)
+			ret = mdb_type(frag, type->u.sequence_compound.elem_type,
+					string_dict);
+		if (!ret)
+			ret = mdb_string(frag,
+					type->u.sequence_compound.length_name);
+		return ret;
 	case atype_variant:
-		ret = _lttng_variant_statedump(session, field, nesting);
-		break;
-
+		ret = mdb_u8(frag, LTTNG_KERNEL_MDB_TYPE_VARIANT);
+		if (!ret)
+			ret = mdb_string(frag, type->u.variant.tag_name);
+		if (!ret)
+			ret = mdb_fields(frag, type->u.variant.choices,
+					type->u.variant.nr_choices, string_dict);
+		return ret;
 	default:
 		WARN_ON_ONCE(1);
 		return -EINVAL;
 	}
-	return ret;
 }
 
 static
-int _lttng_context_metadata_statedump(struct lttng_session *session,
-				    struct lttng_ctx *ctx)
+int mdb_field(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *field, uint8_t flags,
+		int string_dict)
 {
-	int ret = 0;
-	int i;
+	int ret;
 
-	if (!ctx)
-		return 0;
-	for (i = 0; i < ctx->nr_fields; i++) {
-		const struct lttng_ctx_field *field = &ctx->fields[i];
+	if (field->dict && string_dict)
+		flags |= LTTNG_KERNEL_MDB_FIELD_DICT;
+	ret = mdb_string(frag, field->name);
+	if (!ret)
+		ret = mdb_u8(frag, flags);
+	if (!ret)
+		ret = mdb_type(frag, &field->type, string_dict);
+	return ret;
+}
 
-		ret = _lttng_field_statedump(session, &field->event_field, 2);
-		if (ret)
-			return ret;
-	}
+static
+int mdb_fields(struct lttng_metadata_fragment *frag,
+		const struct lttng_event_field *fields, unsigned int nr_fields,
+		int string_dict)
+{
+	unsigned int i;
+	int ret;
+
+	ret = mdb_uleb(frag, nr_fields);
+	for (i = 0; !ret && i < nr_fields; i++)
+		ret = mdb_field(frag, &fields[i], 0, string_dict);
 	return ret;
 }
 
+/* Payload of an event, whose top-level fields may be delta-encoded. */
 static
-int _lttng_fields_metadata_statedump(struct lttng_session *session,
-				   struct lttng_event *event)
+int mdb_event_fields(struct lttng_metadata_fragment *frag,
+		const struct lttng_event *event)
 {
 	const struct lttng_event_desc *desc = event->desc;
-	int ret = 0;
-	int i;
-
-	for (i = 0; i < desc->nr_fields; i++) {
-		const struct lttng_event_field *field = &desc->fields[i];
+	unsigned int i;
+	int ret;
 
-		ret = _lttng_field_statedump(session, field, 2);
-		if (ret)
-			return ret;
-	}
+	ret = mdb_uleb(frag, desc->nr_fields);
+	for (i = 0; !ret && i < desc->nr_fields; i++)
+		ret = mdb_field(frag, &desc->fields[i],
+			desc->fields[i].delta && event->delta_state ?
+				LTTNG_KERNEL_MDB_FIELD_DELTA : 0,
+			event->string_dict);
 	return ret;
 }
 
-/*
- * Must be called with sessions_mutex held.
- */
 static
-int _lttng_event_metadata_statedump(struct lttng_session *session,
-				  struct lttng_channel *chan,
-				  struct lttng_event *event)
+int mdb_ctx(struct lttng_metadata_fragment *frag, const struct lttng_ctx *ctx)
 {
-	int ret = 0;
-
-	if (event->metadata_dumped || !ACCESS_ONCE(session->active))
-		return 0;
-	if (chan->channel_type == METADATA_CHANNEL)
-		return 0;
+	unsigned int i;
+	int ret;
 
-	ret = lttng_metadata_printf(session,
-		"event {\n"
-		"	name = \"%s\";\n"
-		"	id = %u;\n"
-		"	stream_id = %u;\n",
-		event->desc->name,
-		event->id,
-		event->chan->id);
-	if (ret)
-		goto end;
+	ret = mdb_uleb(frag, ctx ? ctx->nr_fields : 0);
+	for (i = 0; !ret && ctx && i < ctx->nr_fields; i++) {
+		const struct lttng_ctx_field *field = &ctx->fields[i];
 
-	if (event->ctx) {
-		ret = lttng_metadata_printf(session,
-			"	context := struct {\n");
-		if (ret)
-			goto end;
+		ret = mdb_field(frag, &field->event_field,
+				field->packet_scoped ?
+					LTTNG_KERNEL_MDB_FIELD_PACKET_SCOPED : 0,
+				0);
 	}
-	ret = _lttng_context_metadata_statedump(session, event->ctx);
-	if (ret)
-		goto end;
-	if (event->ctx) {
-		ret = lttng_metadata_printf(session,
-			"	};\n");
-		if (ret)
-			goto end;
+	return ret;
+}
+
+/* Unsigned integer of _size bits, bit-aligned, or of the size of _type. */
+#define mdb_uint_integer(_type, _size)					\
+	{								\
+		.size = (_size) ? : sizeof(_type) * CHAR_BIT,		\
+		.alignment = (_size) ? 1 : lttng_alignof(_type) * CHAR_BIT, \
+		.base = 10,						\
+		.encoding = lttng_encode_none,				\
 	}
 
-	ret = lttng_metadata_printf(session,
-		"	fields := struct {\n"
-		);
-	if (ret)
-		goto end;
+#define mdb_uint(_type, _size)						\
+	{								\
+		.atype = atype_integer,					\
+		.u.basic.integer = mdb_uint_integer(_type, _size),	\
+	}
 
-	ret = _lttng_fields_metadata_statedump(session, event);
-	if (ret)
-		goto end;
+#define mdb_enum_type(_desc, _type, _size)				\
+	{								\
+		.atype = atype_enum,					\
+		.u.basic.enumeration.desc = &(_desc),			\
+		.u.basic.enumeration.container_type =			\
+			mdb_uint_integer(_type, _size),			\
+	}
 
-	/*
-	 * LTTng space reservation can only reserve multiples of the
-	 * byte size.
-	 */
-	ret = lttng_metadata_printf(session,
-		"	};\n"
-		"};\n\n");
-	if (ret)
-		goto end;
+#define mdb_struct_type(_fields)					\
+	{								\
+		.atype = atype_struct,					\
+		.u._struct.nr_fields = ARRAY_SIZE(_fields),		\
+		.u._struct.fields = _fields,				\
+	}
 
-	event->metadata_dumped = 1;
-end:
-	return ret;
+#define mdb_variant_type(_tag, _choices)				\
+	{								\
+		.atype = atype_variant,					\
+		.u.variant.tag_name = _tag,				\
+		.u.variant.choices = _choices,				\
+		.u.variant.nr_choices = ARRAY_SIZE(_choices),		\
+	}
 
-}
+#define mdb_enum_entry(_start, _end, _string)				\
+	{								\
+		.start = { .value = (_start) },				\
+		.end = { .value = (_end) },				\
+		.string = _string,					\
+	}
 
 /*
- * Must be called with sessions_mutex held.
+ * Layouts of the packet context and event headers declared in the TSDL
+ * by _lttng_stream_packet_context_declare() and
+ * _lttng_event_header_declare(), for the binary encoding.
  */
-static
-int _lttng_channel_metadata_statedump(struct lttng_session *session,
-				    struct lttng_channel *chan)
-{
-	int ret = 0;
+static const struct lttng_event_field mdb_packet_context_fields[] = {
+	{ .name = "timestamp_begin", .type = mdb_uint(uint64_t, 0) },
+	{ .name = "timestamp_end", .type = mdb_uint(uint64_t, 0) },
+	{ .name = "content_size", .type = mdb_uint(uint64_t, 0) },
+	{ .name = "packet_size", .type = mdb_uint(uint64_t, 0) },
+	{ .name = "packet_seq_num", .type = mdb_uint(uint64_t, 0) },
+	{ .name = "events_discarded", .type = mdb_uint(unsigned long, 0) },
+	{ .name = "cpu_id", .type = mdb_uint(uint32_t, 0) },
+	{ .name = "packet_crc32c", .type = mdb_uint(uint32_t, 0) },
+	{ .name = "pvclock_tsc_timestamp", .type = mdb_uint(uint64_t, 0) },
+	{ .name = "pvclock_system_time", .type = mdb_uint(uint64_t, 0) },
+	{ .name = "pvclock_tsc_to_system_mul", .type = mdb_uint(uint32_t, 0) },
+	{
+		.name = "pvclock_tsc_shift",
+		.type = __type_integer(int8_t, 0, 0, 1, __BYTE_ORDER, 10, none),
+	},
+	{ .name = "pvclock_flags", .type = mdb_uint(uint8_t, 0) },
+};
 
-	if (chan->metadata_dumped || !ACCESS_ONCE(session->active))
-		return 0;
+static struct lttng_event_field mdb_header_extended_fields[] = {
+	{ .name = "id", .type = mdb_uint(uint32_t, 0) },
+	{ .name = "timestamp", .type = mdb_uint(uint64_t, 0) },
+};
 
-	if (chan->channel_type == METADATA_CHANNEL)
-		return 0;
+static struct lttng_event_field mdb_header_ts27_fields[] = {
+	{ .name = "timestamp", .type = mdb_uint(uint32_t, 27) },
+};
 
-	WARN_ON_ONCE(!chan->header_type);
-	ret = lttng_metadata_printf(session,
-		"stream {\n"
-		"	id = %u;\n"
-		"	event.header := %s;\n"
-		"	packet.context := struct packet_context;\n",
-		chan->id,
-		chan->header_type == 1 ? "struct event_header_compact" :
-			"struct event_header_large");
-	if (ret)
-		goto end;
+static struct lttng_event_field mdb_header_ts16_fields[] = {
+	{ .name = "timestamp", .type = mdb_uint(uint16_t, 0) },
+};
 
-	if (chan->ctx) {
-		ret = lttng_metadata_printf(session,
-			"	event.context := struct {\n");
-		if (ret)
-			goto end;
-	}
-	ret = _lttng_context_metadata_statedump(session, chan->ctx);
-	if (ret)
-		goto end;
-	if (chan->ctx) {
-		ret = lttng_metadata_printf(session,
-			"	};\n");
-		if (ret)
-			goto end;
-	}
+static struct lttng_event_field mdb_header_ts32_fields[] = {
+	{ .name = "timestamp", .type = mdb_uint(uint32_t, 0) },
+};
 
-	ret = lttng_metadata_printf(session,
-		"};\n\n");
+static struct lttng_event_field mdb_header_ts64_fields[] = {
+	{ .name = "timestamp", .type = mdb_uint(uint64_t, 0) },
+};
 
-	chan->metadata_dumped = 1;
-end:
-	return ret;
-}
+static struct lttng_event_field mdb_header_id8_ts16_fields[] = {
+	{ .name = "id", .type = mdb_uint(uint8_t, 0) },
+	{ .name = "timestamp", .type = mdb_uint(uint16_t, 0) },
+};
 
-/*
- * Must be called with sessions_mutex held.
- */
-static
-int _lttng_stream_packet_context_declare(struct lttng_session *session)
-{
-	return lttng_metadata_printf(session,
-		"struct packet_context {\n"
-		"	uint64_clock_monotonic_t timestamp_begin;\n"
-		"	uint64_clock_monotonic_t timestamp_end;\n"
-		"	uint64_t content_size;\n"
-		"	uint64_t packet_size;\n"
-		"	uint64_t packet_seq_num;\n"
-		"	unsigned long events_discarded;\n"
-		"	uint32_t cpu_id;\n"
-		"};\n\n"
-		);
-}
+static struct lttng_event_field mdb_header_id8_ts32_fields[] = {
+	{ .name = "id", .type = mdb_uint(uint8_t, 0) },
+	{ .name = "timestamp", .type = mdb_uint(uint32_t, 0) },
+};
+
+static struct lttng_event_field mdb_header_id16_ts16_fields[] = {
+	{ .name = "id", .type = mdb_uint(uint16_t, 0) },
+	{ .name = "timestamp", .type = mdb_uint(uint16_t, 0) },
+};
+
+static struct lttng_event_field mdb_header_id16_ts32_fields[] = {
+	{ .name = "id", .type = mdb_uint(uint16_t, 0) },
+	{ .name = "timestamp", .type = mdb_uint(uint32_t, 0) },
+};
+
+static struct lttng_event_field mdb_header_id32_fields[] = {
+	{ .name = "id", .type = mdb_uint(uint32_t, 0) },
+};
+
+/* A struct without fields: the untimed compact header has no more. */
+static struct lttng_event_field mdb_header_empty_fields[] = {
+};
+
+static const struct lttng_enum_entry mdb_header_compact_id_entries[] = {
+	mdb_enum_entry(0, 30, "compact"),
+	mdb_enum_entry(31, 31, "extended"),
+};
+
+static const struct lttng_enum_desc mdb_header_compact_id_desc = {
+	.name = "event_header_compact_id",
+	.entries = mdb_header_compact_id_entries,
+	.nr_entries = ARRAY_SIZE(mdb_header_compact_id_entries),
+};
+
+static struct lttng_event_field mdb_header_compact_choices[] = {
+	{ .name = "compact", .type = mdb_struct_type(mdb_header_ts27_fields) },
+	{
+		.name = "extended",
+		.type = mdb_struct_type(mdb_header_extended_fields),
+	},
+};
+
+static const struct lttng_event_field mdb_header_compact_fields[] = {
+	{
+		.name = "id",
+		.type = mdb_enum_type(mdb_header_compact_id_desc, uint32_t, 5),
+	},
+	{
+		.name = "v",
+		.type = mdb_variant_type("id", mdb_header_compact_choices),
+	},
+};
+
+static const struct lttng_enum_entry mdb_header_large_id_entries[] = {
+	mdb_enum_entry(0, 65534, "compact"),
+	mdb_enum_entry(65535, 65535, "extended"),
+};
+
+static const struct lttng_enum_desc mdb_header_large_id_desc = {
+	.name = "event_header_large_id",
+	.entries = mdb_header_large_id_entries,
+	.nr_entries = ARRAY_SIZE(mdb_header_large_id_entries),
+};
+
+static struct lttng_event_field mdb_header_large_choices[] = {
+	{ .name = "compact", .type = mdb_struct_type(mdb_header_ts32_fields) },
+	{
+		.name = "extended",
+		.type = mdb_struct_type(mdb_header_extended_fields),
+	},
+};
+
+static const struct lttng_event_field mdb_header_large_fields[] = {
+	{
+		.name = "id",
+		.type = mdb_enum_type(mdb_header_large_id_desc, uint16_t, 0),
+	},
+	{
+		.name = "v",
+		.type = mdb_variant_type("id", mdb_header_large_choices),
+	},
+};
+
+static const struct lttng_enum_entry mdb_header_dense_tag_entries[] = {
+	mdb_enum_entry(0, 0, "id5_ts16"),
+	mdb_enum_entry(1, 1, "id5_ts32"),
+	mdb_enum_entry(2, 2, "id8_ts16"),
+	mdb_enum_entry(3, 3, "id8_ts32"),
+	mdb_enum_entry(4, 4, "id16_ts16"),
+	mdb_enum_entry(5, 5, "id16_ts32"),
+	mdb_enum_entry(6, 6, "id5_ts64"),
+	mdb_enum_entry(7, 7, "extended"),
+};
+
+static const struct lttng_enum_desc mdb_header_dense_tag_desc = {
+	.name = "event_header_dense_tag",
+	.entries = mdb_header_dense_tag_entries,
+	.nr_entries = ARRAY_SIZE(mdb_header_dense_tag_entries),
+};
+
+static struct lttng_event_field mdb_header_dense_choices[] = {
+	{ .name = "id5_ts16", .type = mdb_struct_type(mdb_header_ts16_fields) },
+	{ .name = "id5_ts32", .type = mdb_struct_type(mdb_header_ts32_fields) },
+	{
+		.name = "id8_ts16",
+		.type = mdb_struct_type(mdb_header_id8_ts16_fields),
+	},
+	{
+		.name = "id8_ts32",
+		.type = mdb_struct_type(mdb_header_id8_ts32_fields),
+	},
+	{
+		.name = "id16_ts16",
+		.type = mdb_struct_type(mdb_header_id16_ts16_fields),
+	},
+	{
+		.name = "id16_ts32",
+		.type = mdb_struct_type(mdb_header_id16_ts32_fields),
+	},
+	{ .name = "id5_ts64", .type = mdb_struct_type(mdb_header_ts64_fields) },
+	{
+		.name = "extended",
+		.type = mdb_struct_type(mdb_header_extended_fields),
+	},
+};
+
+static const struct lttng_event_field mdb_header_dense_fields[] = {
+	{
+		.name = "tag",
+		.type = mdb_enum_type(mdb_header_dense_tag_desc, uint8_t, 3),
+	},
+	{ .name = "id", .type = mdb_uint(uint8_t, 5) },
+	{
+		.name = "v",
+		.type = mdb_variant_type("tag", mdb_header_dense_choices),
+	},
+};
+
+static const struct lttng_enum_entry mdb_header_untimed_id_entries[] = {
+	mdb_enum_entry(0, 254, "compact"),
+	mdb_enum_entry(255, 255, "extended"),
+};
+
+static const struct lttng_enum_desc mdb_header_untimed_id_desc = {
+	.name = "event_header_untimed_id",
+	.entries = mdb_header_untimed_id_entries,
+	.nr_entries = ARRAY_SIZE(mdb_header_untimed_id_entries),
+};
+
+static struct lttng_event_field mdb_header_untimed_choices[] = {
+	{ .name = "compact", .type = mdb_struct_type(mdb_header_empty_fields) },
+	{ .name = "extended", .type = mdb_struct_type(mdb_header_id32_fields) },
+};
+
+static const struct lttng_event_field mdb_header_untimed_fields[] = {
+	{
+		.name = "id",
+		.type = mdb_enum_type(mdb_header_untimed_id_desc, uint8_t, 0),
+	},
+	{
+		.name = "v",
+		.type = mdb_variant_type("id", mdb_header_untimed_choices),
+	},
+};
 
 /*
- * Compact header:
- * id: range: 0 - 30.
- * id 31 is reserved to indicate an extended header.
- *
- * Large header:
- * id: range: 0 - 65534.
- * id 65535 is reserved to indicate an extended header.
- *
- * Must be called with sessions_mutex held.
+ * Event header of a stream, aligned as in _lttng_event_header_declare().
+ * Header types of channels match enum lttng_kernel_mdb_header.
  */
 static
-int _lttng_event_header_declare(struct lttng_session *session)
+int mdb_event_header(struct lttng_metadata_fragment *frag, int header_type)
 {
-	return lttng_metadata_printf(session,
-	"struct event_header_compact {\n"
-	"	enum : uint5_t { compact = 0 ... 30, extended = 31 } id;\n"
-	"	variant <id> {\n"
-	"		struct {\n"
-	"			uint27_clock_monotonic_t timestamp;\n"
-	"		} compact;\n"
-	"		struct {\n"
-	"			uint32_t id;\n"
-	"			uint64_clock_monotonic_t timestamp;\n"
-	"		} extended;\n"
-	"	} v;\n"
-	"} align(%u);\n"
-	"\n"
-	"struct event_header_large {\n"
-	"	enum : uint16_t { compact = 0 ... 65534, extended = 65535 } id;\n"
-	"	variant <id> {\n"
-	"		struct {\n"
-	"			uint32_clock_monotonic_t timestamp;\n"
-	"		} compact;\n"
-	"		struct {\n"
-	"			uint32_t id;\n"
-	"			uint64_clock_monotonic_t timestamp;\n"
-	"		} extended;\n"
-	"	} v;\n"
-	"} align(%u);\n\n",
-	lttng_alignof(uint32_t) * CHAR_BIT,
-	lttng_alignof(uint16_t) * CHAR_BIT
-	);
+	const struct lttng_event_field *fields;
+	unsigned int nr_fields, align;
+	int ret;
+
+	switch (header_type) {
+	case LTTNG_KERNEL_MDB_HEADER_COMPACT:
+		fields = mdb_header_compact_fields;
+		nr_fields = ARRAY_SIZE(mdb_header_compact_fields);
+		align = lttng_alignof(uint32_t) * CHAR_BIT;
+		break;
+	case LTTNG_KERNEL_MDB_HEADER_LARGE:
+		fields = mdb_header_large_fields;
+		nr_fields = ARRAY_SIZE(mdb_header_large_fields);
+		align = lttng_alignof(uint16_t) * CHAR_BIT;
+		break;
+	case LTTNG_KERNEL_MDB_HEADER_DENSE:
+		fields = mdb_header_dense_fields;
+		nr_fields = ARRAY_SIZE(mdb_header_dense_fields);
+		align = lttng_alignof(uint8_t) * CHAR_BIT;
+		break;
+	case LTTNG_KERNEL_MDB_HEADER_UNTIMED:
+		fields = mdb_header_untimed_fields;
+		nr_fields = ARRAY_SIZE(mdb_header_untimed_fields);
+		align = lttng_alignof(uint8_t) * CHAR_BIT;
+		break;
+	default:
+		WARN_ON_ONCE(1);
+		return -EINVAL;
+	}
+	ret = mdb_u8(frag, header_type);
+	if (!ret)
+		ret = mdb_uleb(frag, align);
+	if (!ret)
+		ret = mdb_fields(frag, fields, nr_fields, 0);
+	return ret;
 }
 
- /*
- * Approximation of NTP time of day to clock monotonic correlation,
- * taken at start of trace.
- * Yes, this is only an approximation. Yes, we can (and will) do better
- * in future versions.
- * This function may return a negative offset. It may happen if the
- * system sets the REALTIME clock to 0 after boot.
- */
+/* Hand the encoding over to the caller, keeping the buffer for the next. */
 static
-int64_t measure_clock_offset(void)
+int mdb_flush(struct lttng_metadata_fragment *frag,
+		int (*flush)(struct lttng_metadata_fragment *frag, void *priv),
+		void *priv)
 {
-	uint64_t monotonic_avg, monotonic[2], realtime;
-	uint64_t tcf = trace_clock_freq();
-	int64_t offset;
-	struct timespec rts = { 0, 0 };
-	unsigned long flags;
-
-	/* Disable interrupts to increase correlation precision. */
-	local_irq_save(flags);
-	monotonic[0] = trace_clock_read64();
-	getnstimeofday(&rts);
-	monotonic[1] = trace_clock_read64();
-	local_irq_restore(flags);
+	int ret;
 
-	monotonic_avg = (monotonic[0] + monotonic[1]) >> 1;
-	realtime = (uint64_t) rts.tv_sec * tcf;
-	if (tcf == NSEC_PER_SEC) {
-		realtime += rts.tv_nsec;
-	} else {
-		uint64_t n = rts.tv_nsec * tcf;
+	ret = flush(frag, priv);
+	frag->len = 0;
+	return ret;
+}
 
-		do_div(n, NSEC_PER_SEC);
-		realtime += n;
-	}
-	offset = (int64_t) realtime - monotonic_avg;
-	return offset;
+/* Channels with a stream in the TSDL metadata. */
+static
+bool mdb_channel_has_stream(const struct lttng_channel *chan)
+{
+	return chan->channel_type != METADATA_CHANNEL
+		&& chan->channel_type != MAP_CHANNEL;
 }
 
 /*
- * Output metadata into this session's metadata buffers.
- * Must be called with sessions_mutex held.
+ * Encode the metadata of the session, generated anew on each call rather
+ * than kept in the metadata cache. "frag" holds one part of the encoding
+ * at a time, a stream or an event, handed over to "flush" under the
+ * sessions mutex.
  */
-static
-int _lttng_session_metadata_statedump(struct lttng_session *session)
+int lttng_session_metadata_binary(struct lttng_session *session,
+		struct lttng_metadata_fragment *frag,
+		int (*flush)(struct lttng_metadata_fragment *frag, void *priv),
+		void *priv)
 {
-	unsigned char *uuid_c = session->uuid.b;
-	unsigned char uuid_s[37], clock_uuid_s[BOOT_ID_LEN];
 	struct lttng_channel *chan;
 	struct lttng_event *event;
-	int ret = 0;
-
-	if (!ACCESS_ONCE(session->active))
-		return 0;
-	if (session->metadata_dumped)
-		goto skip_session;
-
-	snprintf(uuid_s, sizeof(uuid_s),
-		"%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
-		uuid_c[0], uuid_c[1], uuid_c[2], uuid_c[3],
-		uuid_c[4], uuid_c[5], uuid_c[6], uuid_c[7],
-		uuid_c[8], uuid_c[9], uuid_c[10], uuid_c[11],
-		uuid_c[12], uuid_c[13], uuid_c[14], uuid_c[15]);
-
-	ret = lttng_metadata_printf(session,
-		"typealias integer { size = 8; align = %u; signed = false; } := uint8_t;\n"
-		"typealias integer { size = 16; align = %u; signed = false; } := uint16_t;\n"
-		"typealias integer { size = 32; align = %u; signed = false; } := uint32_t;\n"
-		"typealias integer { size = 64; align = %u; signed = false; } := uint64_t;\n"
-		"typealias integer { size = %u; align = %u; signed = false; } := unsigned long;\n"
-		"typealias integer { size = 5; align = 1; signed = false; } := uint5_t;\n"
-		"typealias integer { size = 27; align = 1; signed = false; } := uint27_t;\n"
-		"\n"
-		"trace {\n"
-		"	major = %u;\n"
-		"	minor = %u;\n"
-		"	uuid = \"%s\";\n"
-		"	byte_order = %s;\n"
-		"	packet.header := struct {\n"
-		"		uint32_t magic;\n"
-		"		uint8_t  uuid[16];\n"
-		"		uint32_t stream_id;\n"
-		"		uint64_t stream_instance_id;\n"
-		"	};\n"
-		"};\n\n",
-		lttng_alignof(uint8_t) * CHAR_BIT,
-		lttng_alignof(uint16_t) * CHAR_BIT,
-		lttng_alignof(uint32_t) * CHAR_BIT,
-		lttng_alignof(uint64_t) * CHAR_BIT,
-		sizeof(unsigned long) * CHAR_BIT,
-		lttng_alignof(unsigned long) * CHAR_BIT,
-		CTF_SPEC_MAJOR,
-		CTF_SPEC_MINOR,
-		uuid_s,
-#if __BYTE_ORDER == __BIG_ENDIAN
-		"be"
-#else
-		"le"
-#endif
-		);
-	if (ret)
-		goto end;
-
-	ret = lttng_metadata_printf(session,
-		"env {\n"
-		"	hostname = \"%s\";\n"
-		"	domain = \"kernel\";\n"
-		"	sysname = \"%s\";\n"
-		"	kernel_release = \"%s\";\n"
-		"	kernel_version = \"%s\";\n"
-		"	tracer_name = \"lttng-modules\";\n"
-		"	tracer_major = %d;\n"
-		"	tracer_minor = %d;\n"
-		"	tracer_patchlevel = %d;\n"
-		"};\n\n",
-		current->nsproxy->uts_ns->name.nodename,
-		utsname()->sysname,
-		utsname()->release,
-		utsname()->version,
-		LTTNG_MODULES_MAJOR_VERSION,
-		LTTNG_MODULES_MINOR_VERSION,
-		LTTNG_MODULES_PATCHLEVEL_VERSION
-		);
-	if (ret)
-		goto end;
+	unsigned int nr_streams = 0, nr_events = 0;
+	int ret;
 
-	ret = lttng_metadata_printf(session,
-		"clock {\n"
-		"	name = \"%s\";\n",
-		trace_clock_name()
-		);
+	mutex_lock(&sessions_mutex);
+	ret = mdb_write(frag, LTTNG_KERNEL_MDB_MAGIC,
+			strlen(LTTNG_KERNEL_MDB_MAGIC));
+	if (!ret)
+		ret = mdb_u8(frag, LTTNG_KERNEL_MDB_MAJOR);
+	if (!ret)
+		ret = mdb_u8(frag, LTTNG_KERNEL_MDB_MINOR);
+	if (!ret)
+		ret = mdb_u8(frag, __BYTE_ORDER == __BIG_ENDIAN);
+	if (!ret)
+		ret = mdb_u8(frag, 0);
+	if (!ret)
+		ret = mdb_write(frag, session->uuid.b, sizeof(session->uuid.b));
+	if (!ret)
+		ret = mdb_uleb(frag, trace_clock_freq());
+	if (!ret)
+		ret = mdb_sleb(frag, measure_clock_offset());
+	if (!ret)
+		ret = mdb_fields(frag, mdb_packet_context_fields,
+				ARRAY_SIZE(mdb_packet_context_fields), 0);
 	if (ret)
 		goto end;
 
-	if (!trace_clock_uuid(clock_uuid_s)) {
-		ret = lttng_metadata_printf(session,
-			"	uuid = \"%s\";\n",
-			clock_uuid_s
-			);
-		if (ret)
-			goto end;
+	list_for_each_entry(chan, &session->chan, list) {
+		if (mdb_channel_has_stream(chan))
+			nr_streams++;
 	}
-
-	ret = lttng_metadata_printf(session,
-		"	description = \"%s\";\n"
-		"	freq = %llu; /* Frequency, in Hz */\n"
-		"	/* clock value offset from Epoch is: offset * (1/freq) */\n"
-		"	offset = %lld;\n"
-		"};\n\n",
-		trace_clock_description(),
-		(unsigned long long) trace_clock_freq(),
-		(long long) measure_clock_offset()
-		);
-	if (ret)
-		goto end;
-
-	ret = lttng_metadata_printf(session,
-		"typealias integer {\n"
-		"	size = 27; align = 1; signed = false;\n"
-		"	map = clock.%s.value;\n"
-		"} := uint27_clock_monotonic_t;\n"
-		"\n"
-		"typealias integer {\n"
-		"	size = 32; align = %u; signed = false;\n"
-		"	map = clock.%s.value;\n"
-		"} := uint32_clock_monotonic_t;\n"
-		"\n"
-		"typealias integer {\n"
-		"	size = 64; align = %u; signed = false;\n"
-		"	map = clock.%s.value;\n"
-		"} := uint64_clock_monotonic_t;\n\n",
-		trace_clock_name(),
-		lttng_alignof(uint32_t) * CHAR_BIT,
-		trace_clock_name(),
-		lttng_alignof(uint64_t) * CHAR_BIT,
-		trace_clock_name()
-		);
-	if (ret)
-		goto end;
-
-	ret = _lttng_stream_packet_context_declare(session);
-	if (ret)
-		goto end;
-
-	ret = _lttng_event_header_declare(session);
+	ret = mdb_uleb(frag, nr_streams);
+	if (!ret)
+		ret = mdb_flush(frag, flush, priv);
 	if (ret)
 		goto end;
-
-skip_session:
 	list_for_each_entry(chan, &session->chan, list) {
-		ret = _lttng_channel_metadata_statedump(session, chan);
+		if (!mdb_channel_has_stream(chan))
+			continue;
+		WARN_ON_ONCE(!chan->header_type);
+		ret = mdb_uleb(frag, chan->id);
+		if (!ret)
+			ret = mdb_u8(frag, chan->channel_type);
+		if (!ret)
+			ret = mdb_event_header(frag, chan->header_type);
+		if (!ret)
+			ret = mdb_ctx(frag, chan->ctx);
+		if (!ret)
+			ret = mdb_flush(frag, flush, priv);
 		if (ret)
 			goto end;
 	}
 
 	list_for_each_entry(event, &session->events, list) {
-		ret = _lttng_event_metadata_statedump(session, event->chan, event);
+		if (mdb_channel_has_stream(event->chan))
+			nr_events++;
+	}
+	ret = mdb_uleb(frag, nr_events);
+	if (ret)
+		goto end;
+	list_for_each_entry(event, &session->events, list) {
+		if (!mdb_channel_has_stream(event->chan))
+			continue;
+		ret = mdb_uleb(frag, event->id);
+		if (!ret)
+			ret = mdb_uleb(frag, event->chan->id);
+		if (!ret)
+			ret = mdb_string(frag, event->desc->name);
+		if (!ret)
+			ret = mdb_ctx(frag, event->ctx);
+		if (!ret)
+			ret = mdb_event_fields(frag, event);
+		if (!ret)
+			ret = mdb_flush(frag, flush, priv);
 		if (ret)
 			goto end;
 	}
-	session->metadata_dumped = 1;
+	/* Without events, the count is still pending. */
+	ret = mdb_flush(frag, flush, priv);
 end:
+	mutex_unlock(&sessions_mutex);
 	return ret;
 }
 
@@ -2628,6 +6222,12 @@ void lttng_transport_register(struct lttng_transport *transport)
 	 */
 	wrapper_vmalloc_sync_all();
 
+	if (!transport->ops.event_reserve_preempt_off) {
+		transport->ops.event_reserve_preempt_off =
+			transport->ops.event_reserve;
+		transport->ops.event_commit_preempt_off =
+			transport->ops.event_commit;
+	}
 	mutex_lock(&sessions_mutex);
 	list_add_tail(&transport->node, &lttng_transport_list);
 	mutex_unlock(&sessions_mutex);
@@ -2664,6 +6264,7 @@ static int lttng_hotplug_prepare(unsigned int cpu, struct hlist_node *node)
 	case LTTNG_RING_BUFFER_ITER:
 		return 0;
 	case LTTNG_CONTEXT_PERF_COUNTERS:
+	case LTTNG_PERF_SAMPLE:
 		return 0;
 	default:
 		return -EINVAL;
@@ -2684,6 +6285,8 @@ static int lttng_hotplug_dead(unsigned int cpu, struct hlist_node *node)
 		return 0;
 	case LTTNG_CONTEXT_PERF_COUNTERS:
 		return lttng_cpuhp_perf_counter_dead(cpu, lttng_node);
+	case LTTNG_PERF_SAMPLE:
+		return lttng_cpuhp_perf_sample_dead(cpu, lttng_node);
 	default:
 		return -EINVAL;
 	}
@@ -2703,6 +6306,8 @@ static int lttng_hotplug_online(unsigned int cpu, struct hlist_node *node)
 		return lttng_cpuhp_rb_iter_online(cpu, lttng_node);
 	case LTTNG_CONTEXT_PERF_COUNTERS:
 		return lttng_cpuhp_perf_counter_online(cpu, lttng_node);
+	case LTTNG_PERF_SAMPLE:
+		return lttng_cpuhp_perf_sample_online(cpu, lttng_node);
 	default:
 		return -EINVAL;
 	}
@@ -2721,6 +6326,7 @@ static int lttng_hotplug_offline(unsigned int cpu, struct hlist_node *node)
 	case LTTNG_RING_BUFFER_ITER:
 		return 0;
 	case LTTNG_CONTEXT_PERF_COUNTERS:
+	case LTTNG_PERF_SAMPLE:
 		return 0;
 	default:
 		return -EINVAL;
@@ -2777,6 +6383,9 @@ static int __init lttng_events_init(void)
 {
 	int ret;
 
+	/* Fields read by probes on every hit share a cache line. */
+	BUILD_BUG_ON(offsetof(struct lttng_event, bytecode_runtime_head)
+			+ sizeof(struct list_head *) > 64);
 	ret = wrapper_lttng_fixup_sig(THIS_MODULE);
 	if (ret)
 		return ret;
@@ -2792,14 +6401,20 @@ static int __init lttng_events_init(void)
 	ret = lttng_context_init();
 	if (ret)
 		return ret;
+	lttng_syscalls_init();
 	ret = lttng_tracepoint_init();
 	if (ret)
 		goto error_tp;
-	event_cache = KMEM_CACHE(lttng_event, 0);
+	event_cache = KMEM_CACHE(lttng_event, SLAB_HWCACHE_ALIGN);
 	if (!event_cache) {
 		ret = -ENOMEM;
 		goto error_kmem;
 	}
+	lttng_destroy_wq = alloc_workqueue("lttng_destroy", WQ_UNBOUND, 0);
+	if (!lttng_destroy_wq) {
+		ret = -ENOMEM;
+		goto error_wq;
+	}
 	ret = lttng_abi_init();
 	if (ret)
 		goto error_abi;
@@ -2822,6 +6437,8 @@ error_hotplug:
 error_logger:
 	lttng_abi_exit();
 error_abi:
+	destroy_workqueue(lttng_destroy_wq);
+error_wq:
 	kmem_cache_destroy(event_cache);
 error_kmem:
 	lttng_tracepoint_exit();
@@ -2847,6 +6464,7 @@ static void __exit lttng_events_exit(void)
 	lttng_abi_exit();
 	list_for_each_entry_safe(session, tmpsession, &sessions, list)
 		lttng_session_destroy(session);
+	destroy_workqueue(lttng_destroy_wq);	/* Drains the destroy works */
 	kmem_cache_destroy(event_cache);
 	lttng_tracepoint_exit();
 	lttng_context_exit();
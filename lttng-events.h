@@ -27,6 +27,18 @@
 #include <linux/list.h>
 #include <linux/kprobes.h>
 #include <linux/kref.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/jhash.h>
+#include <linux/hash.h>
+#ifdef CONFIG_IRQ_WORK
+#include <linux/irq_work.h>
+#endif
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0))
+#include <linux/sched/clock.h>
+#endif
 #include <lttng-cpuhotplug.h>
 #include <wrapper/uuid.h>
 #include <lttng-tracer.h>
@@ -37,7 +49,13 @@
 
 struct lttng_channel;
 struct lttng_session;
+struct lttng_string_dict;
+struct lttng_delta_state;
+struct lttng_callstack;
+struct lttng_event_summary;
+struct lttng_event_fanout;
 struct lttng_metadata_cache;
+struct lttng_statedump_path_cache;
 struct lib_ring_buffer_ctx;
 struct perf_event;
 struct perf_event_attr;
@@ -68,6 +86,7 @@ enum lttng_string_encodings {
 enum channel_type {
 	PER_CPU_CHANNEL,
 	METADATA_CHANNEL,
+	MAP_CHANNEL,
 };
 
 struct lttng_enum_value {
@@ -171,7 +190,9 @@ struct lttng_event_field {
 	const char *name;
 	struct lttng_type type;
 	unsigned int nowrite:1,		/* do not write into trace */
-			user:1;		/* fetch from user-space */
+			user:1,		/* fetch from user-space */
+			dict:1,		/* text dictionary-encoded if enabled */
+			delta:1;	/* integer delta-encoded if enabled */
 };
 
 union lttng_ctx_value {
@@ -194,11 +215,79 @@ struct lttng_perf_counter_field {
 #endif
 	struct perf_event_attr *attr;
 	struct perf_event **e;	/* per-cpu array */
+	int rdpmc_shift;	/* 64 - counter width, 0: no rdpmc read */
+};
+
+/* Memory operation of the hits of events with an allocation site. */
+enum lttng_alloc_op {
+	LTTNG_ALLOC_OP_NONE = 0,
+	LTTNG_ALLOC_OP_ALLOC,
+	LTTNG_ALLOC_OP_FREE,
+};
+
+struct lttng_ctx_field;
+struct lttng_probe_ctx;
+
+/*
+ * Context value fetched with get_value() during a probe hit, keyed by
+ * the callback and its private data, so the filter and each context
+ * recording the same field share one evaluation.
+ */
+#define LTTNG_CTX_VALUE_CACHE_LEN	4
+
+struct lttng_ctx_cached_value {
+	void (*get_value)(struct lttng_ctx_field *field,
+			 struct lttng_probe_ctx *lttng_probe_ctx,
+			 union lttng_ctx_value *value);
+	const void *priv;
+	union lttng_ctx_value value;
 };
 
 struct lttng_probe_ctx {
 	struct lttng_event *event;
-	uint8_t interruptible;
+	struct pt_regs *regs;		/* Probe site registers, or NULL */
+	uint32_t ctx_changed;		/* Packet-scoped contexts to record */
+	uint32_t flow_hash;		/* Set by events with a flow key */
+	uint32_t flow_bytes;
+	uint32_t summary_subkey;	/* Set by events with a summary key */
+	uint64_t summary_key;
+	uint64_t summary_value;
+	unsigned long alloc_site;	/* Set by events with an alloc site */
+	uint32_t alloc_bytes_req;
+	uint32_t alloc_bytes;
+	int alloc_op;			/* enum lttng_alloc_op */
+	uint32_t duration_key;		/* Set by events with a duration */
+	uint64_t duration;		/* ns */
+	uint32_t agg_key;		/* Set by events with an aggregation */
+	uint64_t agg_value;
+	/*
+	 * Set by records with delta fields, sized delta_len in
+	 * delta_packet and delta_full_len elsewhere, or 0.
+	 */
+	size_t delta_full_len;
+	size_t delta_len;
+	unsigned long delta_packet;
+	unsigned int nr_cached_values;
+	struct lttng_ctx_cached_value cached_values[LTTNG_CTX_VALUE_CACHE_LEN];
+};
+
+/* Largest string value of a packet-scoped context (hostname). */
+#define LTTNG_CTX_PACKET_SCOPED_STR_LEN	65
+#define LTTNG_CTX_PACKET_SCOPED_MAX	32
+
+/* Size of the per-event stack snapshot of fixed-layout context fields. */
+#define LTTNG_CTX_FIXED_MAX_LEN		128
+
+/*
+ * Per-CPU value of a packet-scoped context field, saved by the record
+ * ending at buffer offset "end". 0 when unknown.
+ */
+struct lttng_ctx_packet_scoped {
+	unsigned long end;
+	union {
+		int64_t s64;
+		char str[LTTNG_CTX_PACKET_SCOPED_STR_LEN];
+	} u;
 };
 
 struct lttng_ctx_field {
@@ -212,27 +301,88 @@ struct lttng_ctx_field {
 			 union lttng_ctx_value *value);
 	union {
 		struct lttng_perf_counter_field *perf_counter;
+		struct lttng_callstack *callstack;
 	} u;
 	void (*destroy)(struct lttng_ctx_field *field);
+	/*
+	 * Packet-scoped contexts are only recorded in the first event of
+	 * each packet and when they change. NULL for other contexts.
+	 */
+	struct lttng_ctx_packet_scoped __percpu *packet_scoped;
+	/*
+	 * Location within the fixed layout of the context, for fields
+	 * below lttng_ctx nr_fixed_fields. Set by lttng_context_update().
+	 */
+	size_t fixed_offset;
+	size_t fixed_len;
+	unsigned int fixed_array:1;	/* value.str of fixed_len bytes */
 };
 
+/*
+ * Values of get_value() are constant for the duration of the probe hit:
+ * each one is fetched once, the first ones are kept in the probe context.
+ */
+static inline
+void lttng_ctx_get_value(struct lttng_ctx_field *field,
+		struct lttng_probe_ctx *lttng_probe_ctx,
+		union lttng_ctx_value *value)
+{
+	struct lttng_ctx_cached_value *cached;
+	unsigned int i;
+
+	for (i = 0; i < lttng_probe_ctx->nr_cached_values; i++) {
+		cached = &lttng_probe_ctx->cached_values[i];
+		if (cached->get_value == field->get_value
+				&& cached->priv == field->u.perf_counter) {
+			*value = cached->value;
+			return;
+		}
+	}
+	field->get_value(field, lttng_probe_ctx, value);
+	if (i == LTTNG_CTX_VALUE_CACHE_LEN)
+		return;
+	cached = &lttng_probe_ctx->cached_values[i];
+	cached->get_value = field->get_value;
+	cached->priv = field->u.perf_counter;
+	cached->value = *value;
+	lttng_probe_ctx->nr_cached_values = i + 1;
+}
+
 struct lttng_ctx {
 	struct lttng_ctx_field *fields;
 	unsigned int nr_fields;
 	unsigned int allocated_fields;
 	size_t largest_align;	/* in bytes */
+	/*
+	 * The leading fixed-size fields have precomputed offsets from the
+	 * aligned start of the context. They are fetched with get_value()
+	 * into a snapshot written to the buffer at once.
+	 */
+	unsigned int nr_fixed_fields;
+	size_t fixed_size;	/* in bytes */
 };
 
 struct lttng_event_desc {
 	const char *name;		/* lttng-modules name */
 	const char *kname;		/* Linux kernel name (tracepoints) */
 	void *probe_callback;
+	void *fanout_callback;		/* Tracepoints, NULL if none */
 	const struct lttng_event_ctx *ctx;	/* context */
 	const struct lttng_event_field *fields;	/* event payload */
+	/*
+	 * Source expressions of the fields, NULL if none can read the local
+	 * variables computed by the probe before recording.
+	 */
+	const char * const *field_srcs;
 	unsigned int nr_fields;
 	struct module *owner;
 };
 
+struct lttng_event_name_node {
+	struct hlist_node hlist;		/* event name hash table */
+	const struct lttng_event_desc *desc;
+};
+
 struct lttng_probe_desc {
 	const char *provider;
 	const struct lttng_event_desc **event_desc;
@@ -240,9 +390,15 @@ struct lttng_probe_desc {
 	struct list_head head;			/* chain registered probes */
 	struct list_head lazy_init_head;
 	int lazy;				/* lazy registration */
+	struct hlist_node provider_hlist;	/* provider hash table */
+	struct lttng_event_name_node *event_nodes;	/* nr_events nodes */
 };
 
 struct lttng_krp;				/* Kretprobe handling */
+struct lttng_kprobe_args;			/* Kprobe argument fetch */
+struct lttng_perf_sample;			/* Perf sampling counters */
+struct lttng_uprobe;				/* Uprobe consumer */
+struct ftrace_ops;
 
 enum lttng_event_type {
 	LTTNG_TYPE_EVENT = 0,
@@ -268,11 +424,53 @@ enum lttng_filter_ret {
 	/* Other bits are kept for future use. */
 };
 
+#define LTTNG_FILTER_PREFILTER_MAX_TERMS	4
+
+enum lttng_filter_prefilter_op {
+	LTTNG_FILTER_PREFILTER_EQ,
+	LTTNG_FILTER_PREFILTER_NE,
+	LTTNG_FILTER_PREFILTER_GT,
+	LTTNG_FILTER_PREFILTER_LT,
+	LTTNG_FILTER_PREFILTER_GE,
+	LTTNG_FILTER_PREFILTER_LE,
+};
+
+enum lttng_filter_prefilter_ret {
+	LTTNG_FILTER_PREFILTER_REJECT = 0,
+	LTTNG_FILTER_PREFILTER_ACCEPT,		/* Record without running the filter. */
+	LTTNG_FILTER_PREFILTER_CONTINUE,	/* Run the filter. */
+};
+
+struct lttng_filter_prefilter_term {
+	uint16_t offset;	/* Field offset in filter stack data. */
+	uint16_t op;		/* enum lttng_filter_prefilter_op */
+	int64_t v;
+};
+
+/*
+ * Integer field comparisons which must all be true for a filter to
+ * record the event. The probe evaluates them on the fields in
+ * field_mask before preparing the whole filter stack, so rejected
+ * events never pay for it. When the filter is exactly this
+ * conjunction, a match records the event without running the filter.
+ */
+struct lttng_filter_prefilter {
+	unsigned int nr_terms;
+	int exact;
+	unsigned long field_mask;	/* Field indexes used by the terms. */
+	struct lttng_filter_prefilter_term terms[LTTNG_FILTER_PREFILTER_MAX_TERMS];
+};
+
 struct lttng_bytecode_runtime {
 	/* Associated bytecode */
 	struct lttng_filter_bytecode_node *bc;
 	uint64_t (*filter)(void *filter_data, struct lttng_probe_ctx *lttng_probe_ctx,
 			const char *filter_stack_data);
+	/* NULL if the filter has no prefilter or is disabled. */
+	const struct lttng_filter_prefilter *prefilter;
+	/* Fields read by the bytecode, NULL if all fields are needed. */
+	unsigned long *field_mask;
+	int early;			/* Fields prepared before _code_pre */
 	int link_failed;
 	struct list_head node;	/* list of bytecode runtime in event */
 };
@@ -285,23 +483,90 @@ struct lttng_enabler_ref {
 	struct lttng_enabler *ref;		/* backward ref */
 };
 
+/*
+ * Per-CPU event statistics. Hits count the calls of an effectively
+ * enabled event, and the other counters the reasons for not recording
+ * it, so that recording a hit costs a single increment.
+ */
+struct lttng_event_stats {
+	unsigned long hit;
+	unsigned long pid_rejected;	/* PID or PID namespace tracker */
+	unsigned long sampled_out;
+	unsigned long filtered;
+	unsigned long reserve_failed;	/* Other reservation failures */
+	unsigned long lost_full;	/* Buffer full */
+	unsigned long lost_big;		/* Event too big */
+	unsigned long triggered;	/* Action run */
+};
+
+#define lttng_event_stats_inc(event, counter)	\
+	this_cpu_inc((event)->stats->counter)
+
+struct lttng_event_sampling_state {
+	unsigned long count;		/* 1-in-N hit counter */
+	u64 last_ns;			/* Last token bucket refill */
+	u64 tokens;			/* Available tokens, in event-ns */
+};
+
+/*
+ * Per-event sampling, configured from struct lttng_kernel_event_sampling.
+ * Tokens are scaled by NSEC_PER_SEC so the bucket can be refilled with
+ * a single multiplication by the elapsed time.
+ */
+struct lttng_event_sampling {
+	unsigned int period;
+	unsigned int flow_period;
+	u64 rate;			/* events/s */
+	u64 max_tokens;			/* burst * NSEC_PER_SEC */
+	u64 fill_ns;			/* time to refill an empty bucket */
+	struct lttng_event_sampling_state __percpu *state;
+};
+
 /*
  * lttng_event structure is referred to by the tracing fast path. It must be
- * kept small.
+ * kept small. Events are allocated cache-aligned, and the fields read by
+ * probes on every hit come first so they fit a 64-byte cache line, up to
+ * the next pointer of bytecode_runtime_head (checked by lttng_events_init).
+ * The filter and action state read only when filters or actions are
+ * attached follows, then control-plane state.
  */
 struct lttng_event {
 	enum lttng_event_type evtype;	/* First field. */
 	unsigned int id;
+	/*
+	 * enabled && !throttled && chan->enabled && chan->session->active,
+	 * so disabled events cost a single load. Updated by the control path.
+	 */
+	int effective_enabled;
+	u8 filter_early;		/* All filters run before _code_pre */
+	u8 action;			/* enum lttng_kernel_event_action_type */
+	u8 string_dict;			/* Dictionary ids for dict text fields */
 	struct lttng_channel *chan;
+	struct lttng_event_stats __percpu *stats;
+	struct lttng_event_sampling *sampling;	/* NULL: record all hits */
+	/* Per-cpu bases of the delta fields, NULL: integers as is */
+	struct lttng_delta_state __percpu *delta_state;
+	struct lttng_ctx *ctx;
+	/* list of struct lttng_bytecode_runtime, sorted by seqnum */
+	struct list_head bytecode_runtime_head;
+
+	int has_enablers_without_bytecode;
+	/* Enabled runtimes fused in a single program, NULL if not fused. */
+	struct lttng_bytecode_runtime *filter_fused;
+	uint64_t action_token;		/* Copied in notifications */
+	struct lttng_event_summary *summary;	/* SUMMARY action state */
+	struct list_head fanout_node;	/* Events of the fanout, RCU */
+
+	/* Not read by probes. */
 	int enabled;
 	const struct lttng_event_desc *desc;
 	void *filter;
-	struct lttng_ctx *ctx;
 	enum lttng_kernel_instrumentation instrumentation;
 	union {
 		struct {
 			struct kprobe kp;
 			char *symbol_name;
+			struct lttng_kprobe_args *args;
 		} kprobe;
 		struct {
 			struct lttng_krp *lttng_krp;
@@ -309,20 +574,84 @@ struct lttng_event {
 		} kretprobe;
 		struct {
 			char *symbol_name;
+			struct ftrace_ops *ops;
+			unsigned int armed:1;
 		} ftrace;
+		struct {
+			struct lttng_perf_sample *sample;
+		} perf_sample;
+		struct {
+			struct lttng_uprobe *uprobe;
+		} uprobe;
 	} u;
 	struct list_head list;		/* Event list in session */
-	unsigned int metadata_dumped:1;
+	/* Bytecode attached to the event rather than to its enablers. */
+	struct list_head filter_bytecode_head;
+	unsigned int metadata_dumped:1,
+		throttled:1;		/* Disabled by the CPU budget */
+	unsigned long budget_hits;	/* Hits at the last budget check */
+	unsigned long budget_delta;	/* Hits within the last period */
 
 	/* Backward references: list of lttng_enabler_ref (ref to enablers) */
 	struct list_head enablers_ref_head;
 	struct hlist_node hlist;	/* session ht of events */
 	int registered;			/* has reg'd tracepoint probe */
-	/* list of struct lttng_bytecode_runtime, sorted by seqnum */
-	struct list_head bytecode_runtime_head;
-	int has_enablers_without_bytecode;
+	struct lttng_event_fanout *fanout;	/* Tracepoint registration */
+};
+
+/*
+ * A tracepoint is registered once per event description with its fanout
+ * callback, which calls the probe of each event of the fanout. Events of
+ * all sessions and channels enabling the tracepoint share the fanout.
+ * Fanouts left without events are freed after a trace synchronization.
+ */
+struct lttng_event_fanout {
+	struct list_head node;		/* Fanout list, sessions mutex */
+	const struct lttng_event_desc *desc;
+	struct list_head events_head;	/* Registered events, RCU */
 };
 
+/*
+ * Called from the probe, with preemption disabled. Returns true if the
+ * hit should be recorded. Nested hits from interrupt context on the same
+ * CPU may race on the state; this only skews the sampling slightly.
+ */
+static inline
+bool lttng_event_sample(struct lttng_event_sampling *sampling)
+{
+	struct lttng_event_sampling_state *state = this_cpu_ptr(sampling->state);
+
+	if (sampling->period > 1 && ++state->count % sampling->period)
+		return false;
+	if (sampling->rate) {
+		u64 now = local_clock(), elapsed = now - state->last_ns;
+
+		state->last_ns = now;
+		if (elapsed >= sampling->fill_ns)
+			state->tokens = sampling->max_tokens;
+		else
+			state->tokens = min(state->tokens + elapsed * sampling->rate,
+					sampling->max_tokens);
+		if (state->tokens < NSEC_PER_SEC)
+			return false;
+		state->tokens -= NSEC_PER_SEC;
+	}
+	return true;
+}
+
+/*
+ * Flow sampling is stateless: the decision only depends on the flow
+ * hash, so all the events of a sampled flow are recorded, on any CPU.
+ */
+static inline
+bool lttng_event_flow_sample(struct lttng_event_sampling *sampling,
+		uint32_t flow_hash)
+{
+	if (sampling->flow_period <= 1)
+		return true;
+	return !(hash_32(flow_hash, 32) % sampling->flow_period);
+}
+
 enum lttng_enabler_type {
 	LTTNG_ENABLER_STAR_GLOB,
 	LTTNG_ENABLER_NAME,
@@ -356,11 +685,41 @@ struct lttng_channel_ops {
 				unsigned int read_timer_interval);
 	void (*channel_destroy)(struct channel *chan);
 	struct lib_ring_buffer *(*buffer_read_open)(struct channel *chan);
+	/*
+	 * map_read copies aggregated entries to user-space. Only
+	 * implemented by the map transport, for which buf_addr passed
+	 * to channel_create points to a struct lttng_kernel_map_attr.
+	 */
+	ssize_t (*map_read)(struct channel *chan, char __user *buf,
+			size_t count, loff_t *ppos);
 	int (*buffer_has_read_closed_stream)(struct channel *chan);
 	void (*buffer_read_close)(struct lib_ring_buffer *buf);
 	int (*event_reserve)(struct lib_ring_buffer_ctx *ctx,
 			     uint32_t event_id);
 	void (*event_commit)(struct lib_ring_buffer_ctx *ctx);
+	/*
+	 * event_reserve_preempt_off and event_commit_preempt_off are the
+	 * same as event_reserve and event_commit, for callers already
+	 * running with preemption disabled within a RCU-sched read-side
+	 * critical section. Optional: default to event_reserve and
+	 * event_commit at transport registration.
+	 */
+	int (*event_reserve_preempt_off)(struct lib_ring_buffer_ctx *ctx,
+					 uint32_t event_id);
+	void (*event_commit_preempt_off)(struct lib_ring_buffer_ctx *ctx);
+	/*
+	 * event_reserve_batch reserves space for several records with a
+	 * single space reservation. It returns the number of records
+	 * reserved, which must be passed to event_commit_batch. Optional:
+	 * NULL for transports not supporting batches. Each context needs
+	 * its own probe context, which holds the packet-scoped contexts
+	 * to record.
+	 */
+	int (*event_reserve_batch)(struct lib_ring_buffer_ctx *ctxs,
+				   const uint32_t *event_ids,
+				   unsigned int nr);
+	void (*event_commit_batch)(struct lib_ring_buffer_ctx *ctxs,
+				   unsigned int nr);
 	void (*event_write)(struct lib_ring_buffer_ctx *ctx, const void *src,
 			    size_t len);
 	void (*event_write_from_user)(struct lib_ring_buffer_ctx *ctx,
@@ -371,6 +730,13 @@ struct lttng_channel_ops {
 			     size_t len);
 	void (*event_strcpy_from_user)(struct lib_ring_buffer_ctx *ctx,
 				       const char __user *src, size_t len);
+	/*
+	 * direct_write is set by clients whose event_write, event_strcpy
+	 * and their from_user variants are the page backend writes of the
+	 * ring buffer library, with '#' padding. Probes then inline those
+	 * writes instead of calling the operations for each field.
+	 */
+	int direct_write;
 	/*
 	 * packet_avail_size returns the available size in the current
 	 * packet. Note that the size returned is only a hint, since it
@@ -408,6 +774,15 @@ struct lttng_channel_ops {
 	int (*instance_id) (const struct lib_ring_buffer_config *config,
 			struct lib_ring_buffer *bufb,
 			uint64_t *id);
+	/*
+	 * packet_index returns the index entry of the delivered packet
+	 * of sequence number seq_num, or -ENOENT if the buffer does not
+	 * hold it. NULL for streams without packet index.
+	 */
+	int (*packet_index) (const struct lib_ring_buffer_config *config,
+			struct lib_ring_buffer *bufb,
+			uint64_t seq_num,
+			struct lttng_kernel_packet_index *index);
 };
 
 struct lttng_transport {
@@ -418,12 +793,41 @@ struct lttng_transport {
 };
 
 struct lttng_syscall_filter;
+struct lttng_syscall_dispatch;
+struct lttng_syscall_latency_tracker;
 
-#define LTTNG_EVENT_HT_BITS		12
-#define LTTNG_EVENT_HT_SIZE		(1U << LTTNG_EVENT_HT_BITS)
+/*
+ * The session event hash table starts small and doubles whenever it
+ * holds more events than buckets, up to LTTNG_EVENT_HT_MAX_BITS.
+ */
+#define LTTNG_EVENT_HT_MIN_BITS		6
+#define LTTNG_EVENT_HT_MAX_BITS		15
 
 struct lttng_event_ht {
-	struct hlist_head table[LTTNG_EVENT_HT_SIZE];
+	struct hlist_head *table;
+	unsigned int bits;
+	unsigned int nr_events;
+};
+
+/*
+ * Event ids the compact and dense event headers encode in their first
+ * byte.
+ */
+#define LTTNG_HOT_EVENT_IDS		31
+
+/* Name or star glob of events declared hot on a channel. */
+struct lttng_hot_event {
+	struct list_head node;		/* chan->hot_events_head */
+	char name[LTTNG_KERNEL_SYM_NAME_LEN];
+};
+
+/*
+ * Per-CPU staging area of the record being fragmented, written by the
+ * client through the LTTNG_RFLAG_FRAGMENT path of its write callbacks.
+ */
+struct lttng_fragment_stage {
+	char *data;			/* LTTNG_KERNEL_FRAGMENT_MAX_SIZE */
+	int busy;			/* Nested records are lost */
 };
 
 struct lttng_channel {
@@ -435,6 +839,8 @@ struct lttng_channel {
 	struct lttng_session *session;
 	struct file *file;		/* File associated to channel */
 	unsigned int free_event_id;	/* Next event ID to allocate */
+	unsigned int free_hot_event_id;	/* Next reserved hot event ID */
+	struct list_head hot_events_head;	/* Declared hot events */
 	struct list_head list;		/* Channel list */
 	struct lttng_channel_ops *ops;
 	struct lttng_transport *transport;
@@ -447,12 +853,43 @@ struct lttng_channel {
 	struct lttng_event *sc_exit_unknown;
 	struct lttng_event *compat_sc_exit_unknown;
 	struct lttng_syscall_filter *sc_filter;
-	int header_type;		/* 0: unset, 1: compact, 2: large */
+	struct lttng_syscall_dispatch *sc_dispatch;	/* probe fast path */
+	struct lttng_syscall_dispatch *compat_sc_dispatch;
+	struct lttng_event *sc_latency;	/* paired entry/exit record */
+	struct lttng_event *compat_sc_latency;
+	struct lttng_syscall_latency_tracker *sc_latency_tracker;
+	struct lttng_event *task_marker;	/* sched_switch task markers */
+	struct lttng_event *budget_marker;	/* CPU budget actions */
+	struct lttng_string_dict __percpu *string_dict;	/* NULL: text as is */
+	struct lttng_event *string_dict_event;	/* Dictionary definitions */
+	int delta;			/* Delta fields of new events encoded */
+	struct lttng_event *callstack_event;	/* Callstack definitions */
+	struct lttng_event *summary_event;	/* Event summaries */
+	struct list_head summary_head;	/* Summarized events, RCU */
+	struct lttng_fragment_stage __percpu *fragment_stage;	/* NULL: no fragments */
+	struct lttng_event *fragment_event;	/* Fragments of large records */
+	int header_type;		/* 0: unset, 1: compact, 2: large, 3: dense, 4: untimed */
 	enum channel_type channel_type;
+	struct work_struct destroy_work;	/* Frees the buffers */
+	/* Geometry tuning, see struct lttng_kernel_channel_autotune */
+	struct delayed_work autotune_work;
+	unsigned int autotune_mode;	/* 0: off */
+	unsigned int autotune_period_ms;
+	unsigned int autotune_idle;	/* Checks with a low lag in a row */
+	unsigned long autotune_lost;	/* Records lost full at last check */
+	uint64_t autotune_min_bytes, autotune_max_bytes;
+	uint64_t autotune_bytes;	/* Tuned buffer size per CPU */
+	size_t autotune_subbuf_size, autotune_num_subbuf;
+	struct list_head sc_armed_node;	/* Channels with syscall probes */
 	unsigned int metadata_dumped:1,
 		sys_enter_registered:1,
 		sys_exit_registered:1,
+		sc_armed:1,		/* On the syscall armed list */
+		sc_tracked_tasks:1,	/* Syscalls of tracked tasks only */
 		syscall_all:1,
+		task_marker_registered:1,
+		packet_crc32c:1,	/* Packets carry their CRC32C */
+		hot_ids:1,		/* Compact ids reserved to hot events */
 		tstate:1;		/* Transient enable state */
 };
 
@@ -468,31 +905,59 @@ struct lttng_metadata_stream {
 	uint64_t version;		/* Current version of the metadata cache */
 };
 
-#define LTTNG_DYNAMIC_LEN_STACK_SIZE	128
-
-struct lttng_dynamic_len_stack {
-	size_t stack[LTTNG_DYNAMIC_LEN_STACK_SIZE];
-	size_t offset;
+#ifdef CONFIG_IRQ_WORK
+/*
+ * Session notification buffer, read through its own file descriptor.
+ * Probes write to it from any context: readers are woken up by
+ * irq_work.
+ */
+struct lttng_notification {
+	struct lttng_session *session;
+	struct lttng_transport *transport;
+	struct channel *chan;
+	struct lib_ring_buffer *buf;	/* Opened for reading */
+	struct mutex read_lock;		/* Serializes readers */
+	atomic_long_t produced;		/* Records committed */
+	atomic_long_t consumed;		/* Records read */
+	atomic_long_t lost;		/* Records discarded */
+	struct irq_work wakeup;
 };
-
-DECLARE_PER_CPU(struct lttng_dynamic_len_stack, lttng_dynamic_len_stack);
+#endif
 
 /*
  * struct lttng_pid_tracker declared in header due to deferencing of *v
  * in RCU_INITIALIZER(v).
  */
-#define LTTNG_PID_HASH_BITS	6
-#define LTTNG_PID_TABLE_SIZE	(1 << LTTNG_PID_HASH_BITS)
+#define LTTNG_PID_HASH_BITS	6	/* Initial table size */
 
-struct lttng_pid_tracker {
-	struct hlist_head pid_hash[LTTNG_PID_TABLE_SIZE];
+/* Sorted array of PIDs, replaced on update. */
+struct lttng_pid_hash_bucket {
+	unsigned int nr;
+	struct lttng_pid_hash_bucket *retired_next;
+	u32 pids[];
 };
 
-struct lttng_pid_hash_node {
-	struct hlist_node hlist;
-	int pid;
+struct lttng_pid_hash_table {
+	unsigned int order;	/* log2 of the number of buckets */
+	struct lttng_pid_hash_bucket *buckets[];
 };
 
+struct lttng_pid_tracker {
+	struct lttng_pid_hash_table *table;
+	unsigned int nr_pids;
+	unsigned int generation;	/* Incremented on each update. */
+	/*
+	 * Per-cpu cache of the last verdict: pid in the upper 32 bits,
+	 * generation in bits 1 to 31, verdict in bit 0.
+	 */
+	u64 __percpu *cache;
+	/* Replaced buckets awaiting a grace period. */
+	struct lttng_pid_hash_bucket *retired;
+	unsigned int nr_retired;
+};
+
+#define LTTNG_ENUM_DECL_HT_BITS		6
+
 struct lttng_session {
 	int active;			/* Is trace session active ? */
 	int been_active;		/* Has trace session been active ? */
@@ -500,20 +965,140 @@ struct lttng_session {
 	struct list_head chan;		/* Channel list head */
 	struct list_head events;	/* Event list head */
 	struct list_head list;		/* Session list */
+	/*
+	 * Serializes the control operations local to the session: PID
+	 * trackers, statedumps, start and stop. Taken before the
+	 * sessions mutex.
+	 */
+	struct mutex lock;
 	unsigned int free_chan_id;	/* Next chan ID to allocate */
 	uuid_le uuid;			/* Trace session unique ID */
 	struct lttng_metadata_cache *metadata_cache;
 	struct lttng_pid_tracker *pid_tracker;
+	struct lttng_pid_tracker *pid_ns_tracker;	/* PID namespace inodes */
+	/* Paths of the file descriptors dumped, owned by the statedump */
+	struct lttng_statedump_path_cache *statedump_paths;
+	/* Module load and unload events, set by the symbol statedump */
+	int statedump_symbols;
+	struct list_head statedump_symbols_node;
 	unsigned int metadata_dumped:1,
-		tstate:1;		/* Transient enable state */
+		tstate:1,		/* Transient enable state */
+		batch:1,		/* Enabler sync deferred to commit */
+		batch_sync_pending:1;
 	/* List of enablers */
 	struct list_head enablers_head;
 	/* Hash table of events */
 	struct lttng_event_ht events_ht;
+	/* Enumerations declared in the metadata, by declared name */
+	struct hlist_head enum_decl_ht[1 << LTTNG_ENUM_DECL_HT_BITS];
+	struct work_struct destroy_work;	/* Frees events and buffers */
+	/* Statedump of LTTNG_KERNEL_SESSION_START_ASYNC */
+	struct work_struct statedump_work;
+	wait_queue_head_t statedump_wait;	/* Statedump done */
+	int statedump_pending;
+	int statedump_ret;		/* Result of the last one */
+	atomic_t destroy_refs;		/* Channel destroy works pending */
+	/* CPU budget, see struct lttng_kernel_session_cpu_budget */
+	struct delayed_work budget_work;
+	unsigned int budget_permille;	/* 0: no budget */
+	unsigned int budget_period_ms;
+	u64 budget_cost_ns;
+	uint64_t rotation_id;		/* Last rotation, 0: none */
+	struct cpumask *cpu_mask;	/* Recorded CPUs, NULL: all */
+	/* Memory cap of the channel buffers, NULL: none */
+	struct lib_ring_buffer_page_pool *page_pool;
+#ifdef CONFIG_IRQ_WORK
+	/* Session stop requested by event actions */
+	struct irq_work action_irq_work;
+	struct work_struct action_work;
+	unsigned long action_pending;
+	int actions_disabled;		/* Set on destroy */
+	struct lttng_notification *notification;	/* NOTIFY action */
+#endif
+};
+
+/*
+ * Must be called after any change of the event, channel or session
+ * enable state, with sessions mutex held.
+ */
+static inline
+void lttng_event_update_effective_enabled(struct lttng_event *event)
+{
+	ACCESS_ONCE(event->effective_enabled) = event->enabled
+		&& !event->throttled
+		&& ACCESS_ONCE(event->chan->enabled)
+		&& ACCESS_ONCE(event->chan->session->active);
+}
+
+/*
+ * The metadata cache is a list of page-sized chunks, so growing it never
+ * moves the content already written.
+ */
+#define METADATA_CACHE_CHUNK_SHIFT	PAGE_SHIFT
+#define METADATA_CACHE_CHUNK_SIZE	(1UL << METADATA_CACHE_CHUNK_SHIFT)
+
+/* Piece of metadata text shared by the caches of all sessions. */
+struct lttng_metadata_shared {
+	struct kref ref;
+	size_t len;
+	char data[];
+};
+
+/*
+ * Run of metadata cache text, either written by the session in the
+ * cache chunks or referencing shared text.
+ */
+struct lttng_metadata_segment {
+	unsigned int pos;		/* Position in the metadata */
+	unsigned int len;
+	struct lttng_metadata_shared *shared;	/* NULL if in chunks */
+	unsigned int chunk_pos;		/* Position in the chunks */
 };
 
+#define LTTNG_METADATA_CRASH_MAGIC	0x4c54544e474d4454ULL	/* "LTTNGMDT" */
+#define LTTNG_METADATA_CRASH_VERSION	1
+
+/*
+ * Post-mortem descriptor of a metadata cache, set as the client
+ * descriptor of the session's ring buffer channels. The text at position
+ * "pos" of the metadata is found in the segment holding it: at
+ * chunks[chunk_pos >> chunk_shift] + (chunk_pos & (chunk_size - 1)), with
+ * chunk_pos = segment chunk_pos + pos - segment pos, if the segment
+ * "shared" pointer is NULL, else at shared + shared_data + pos - segment pos.
+ * Fields are located through the offsets, from the cache address.
+ */
+struct lttng_metadata_crash_desc {
+	uint64_t magic;			/* LTTNG_METADATA_CRASH_MAGIC */
+	uint32_t version;		/* LTTNG_METADATA_CRASH_VERSION */
+	uint32_t size;			/* Size of this descriptor */
+	uint8_t uuid[16];		/* Trace session unique ID */
+	uint64_t cache;			/* Address of the metadata cache */
+	uint32_t chunk_shift;
+	uint32_t chunk_size;
+	uint32_t segment_size;		/* Size of a segment */
+	uint32_t chunks;		/* Offsets in the cache */
+	uint32_t segments;
+	uint32_t nr_segments;
+	uint32_t chunk_written;
+	uint32_t metadata_written;
+	uint32_t seg_pos;		/* Offsets in a segment */
+	uint32_t seg_len;
+	uint32_t seg_shared;
+	uint32_t seg_chunk_pos;
+	uint32_t shared_data;		/* Offset of the shared text */
+	uint32_t padding;
+} __attribute__((packed));
+
 struct lttng_metadata_cache {
-	char *data;			/* Metadata cache */
+	char **chunks;			/* Metadata cache chunks */
+	unsigned int nr_chunks;		/* Number of allocated chunks */
+	unsigned int max_chunks;	/* Size of the chunks array */
+	unsigned int chunk_written;	/* Number of bytes written in chunks */
+	struct lttng_metadata_segment *segments;
+	unsigned int nr_segments;
+	unsigned int max_segments;	/* Size of the segments array */
+	char *scratch;			/* Text crossing a chunk boundary */
+	size_t scratch_alloc;
 	unsigned int cache_alloc;	/* Metadata allocated size (bytes) */
 	unsigned int metadata_written;	/* Number of bytes written in metadata cache */
 	struct kref refcount;		/* Metadata cache usage */
@@ -521,6 +1106,22 @@ struct lttng_metadata_cache {
 	uuid_le uuid;			/* Trace session unique ID (copy) */
 	struct mutex lock;		/* Produce/consume lock */
 	uint64_t version;		/* Current version of the metadata */
+	struct lttng_metadata_crash_desc crash;	/* Post-mortem descriptor */
+};
+
+/* Session independent piece of metadata text. */
+struct lttng_metadata_fragment {
+	char *data;
+	size_t len;
+	size_t alloc;
+	int string_dict;		/* Render dict text fields as ids */
+	int delta;			/* Render delta fields as variants */
+	/*
+	 * Enumerations are referenced by their declared name if enum_ref
+	 * is set, or if declared in "session", else rendered inline.
+	 */
+	int enum_ref;
+	struct lttng_session *session;
 };
 
 void lttng_lock_sessions(void);
@@ -534,15 +1135,78 @@ struct lttng_enabler *lttng_enabler_create(enum lttng_enabler_type type,
 
 int lttng_enabler_enable(struct lttng_enabler *enabler);
 int lttng_enabler_disable(struct lttng_enabler *enabler);
-int lttng_fix_pending_events(void);
+int lttng_fix_pending_events(struct lttng_probe_desc *probe_desc);
 int lttng_session_active(void);
 
 struct lttng_session *lttng_session_create(void);
 int lttng_session_enable(struct lttng_session *session);
+int lttng_session_enable_async(struct lttng_session *session);
 int lttng_session_disable(struct lttng_session *session);
 void lttng_session_destroy(struct lttng_session *session);
+int lttng_event_set_action(struct lttng_event *event,
+		const struct lttng_kernel_event_action *action);
+void lttng_session_action_stop(struct lttng_session *session);
+void lttng_event_notify(struct lttng_event *event);
+void lttng_event_summary_hit(struct lttng_event *event,
+		struct lttng_probe_ctx *lttng_probe_ctx);
+#ifdef CONFIG_IRQ_WORK
+struct lttng_notification *lttng_notification_create(
+		struct lttng_session *session,
+		size_t subbuf_size, size_t num_subbuf);
+void lttng_notification_destroy(struct lttng_notification *notification);
+#endif
+
+/*
+ * Attributes a record lost by the event to the cause reported by the
+ * event_reserve callback of its channel. Failures other than a full
+ * buffer or a record too big, e.g. nested tracing, are not lost for
+ * lack of space.
+ */
+static inline
+void lttng_event_stats_reserve_failed(struct lttng_event *event, int ret)
+{
+	switch (ret) {
+	case -ENOBUFS:
+		lttng_event_stats_inc(event, lost_full);
+		break;
+	case -ENOSPC:
+		lttng_event_stats_inc(event, lost_big);
+		break;
+	default:
+		lttng_event_stats_inc(event, reserve_failed);
+		break;
+	}
+}
+
+/*
+ * Called from the probe when a hit passes the filters of an event with
+ * an action. Returns false if the hit must not be recorded.
+ */
+static inline
+bool lttng_event_action(struct lttng_event *event,
+		struct lttng_probe_ctx *lttng_probe_ctx)
+{
+	lttng_event_stats_inc(event, triggered);
+	switch (ACCESS_ONCE(event->action)) {
+	case LTTNG_KERNEL_EVENT_ACTION_STOP_SESSION:
+		lttng_session_action_stop(event->chan->session);
+		break;
+	case LTTNG_KERNEL_EVENT_ACTION_NOTIFY:
+		lttng_event_notify(event);
+		break;
+	case LTTNG_KERNEL_EVENT_ACTION_SUMMARY:
+		lttng_event_summary_hit(event, lttng_probe_ctx);
+		return false;
+	}
+	return true;
+}
 int lttng_session_metadata_regenerate(struct lttng_session *session);
 int lttng_session_statedump(struct lttng_session *session);
+int lttng_session_statedump_delta(struct lttng_session *session,
+		u64 since, unsigned int categories, unsigned int flags,
+		u64 *generation);
+int lttng_session_cpu_budget(struct lttng_session *session,
+		const struct lttng_kernel_session_cpu_budget *param);
 void metadata_cache_destroy(struct kref *kref);
 
 struct lttng_channel *lttng_channel_create(struct lttng_session *session,
@@ -592,37 +1256,173 @@ int lttng_probe_register(struct lttng_probe_desc *desc);
 void lttng_probe_unregister(struct lttng_probe_desc *desc);
 const struct lttng_event_desc *lttng_event_get(const char *name);
 void lttng_event_put(const struct lttng_event_desc *desc);
+const struct lttng_event_desc **lttng_event_desc_range(const char *prefix,
+		size_t prefix_len, unsigned int *nr);
+struct lttng_metadata_shared *
+	lttng_event_desc_metadata_get(const struct lttng_event_desc *desc);
+int lttng_event_desc_metadata_render(const struct lttng_event_desc *desc,
+		struct lttng_metadata_fragment *frag);
+void lttng_metadata_fragment_free(struct lttng_metadata_fragment *frag);
+struct lttng_metadata_shared *
+	lttng_metadata_shared_create(const struct lttng_metadata_fragment *frag);
+void lttng_metadata_shared_put(struct lttng_metadata_shared *shared);
 int lttng_probes_init(void);
 void lttng_probes_exit(void);
 
 int lttng_metadata_output_channel(struct lttng_metadata_stream *stream,
 		struct channel *chan);
 
-int lttng_pid_tracker_get_node_pid(const struct lttng_pid_hash_node *node);
 struct lttng_pid_tracker *lttng_pid_tracker_create(void);
 void lttng_pid_tracker_destroy(struct lttng_pid_tracker *lpf);
-bool lttng_pid_tracker_lookup(struct lttng_pid_tracker *lpf, int pid);
-int lttng_pid_tracker_add(struct lttng_pid_tracker *lpf, int pid);
-int lttng_pid_tracker_del(struct lttng_pid_tracker *lpf, int pid);
+size_t lttng_pid_tracker_memory_size(struct lttng_pid_tracker *lpf);
+bool lttng_pid_tracker_lookup(struct lttng_pid_tracker *lpf, u32 id);
+int lttng_pid_tracker_add(struct lttng_pid_tracker *lpf, u32 id);
+int lttng_pid_tracker_del(struct lttng_pid_tracker *lpf, u32 id);
+const u32 *lttng_pid_tracker_get_pos(struct lttng_pid_tracker *lpf,
+		loff_t pos);
+
+/*
+ * Lookup of the current task, performed from the same context as
+ * lttng_pid_tracker_lookup(). Consecutive events of a task running on
+ * a CPU reuse the cached verdict until the tracker is updated.
+ */
+static inline
+bool lttng_pid_tracker_lookup_current(struct lttng_pid_tracker *lpf)
+{
+	int pid = current->pid;
+	u64 key, entry;
+	bool found;
+
+	key = ((u64) (u32) pid << 32)
+		| ((u64) (ACCESS_ONCE(lpf->generation) & 0x7FFFFFFFU) << 1);
+	/* Read generation before the table. Matches smp_wmb() in updates. */
+	smp_rmb();
+	entry = this_cpu_read(*lpf->cache);
+	if (likely((entry & ~1ULL) == key))
+		return entry & 1ULL;
+	found = lttng_pid_tracker_lookup(lpf, pid);
+	this_cpu_write(*lpf->cache, key | found);
+	return found;
+}
 
 int lttng_session_track_pid(struct lttng_session *session, int pid);
 int lttng_session_untrack_pid(struct lttng_session *session, int pid);
 
 int lttng_session_list_tracker_pids(struct lttng_session *session);
+int lttng_session_track_pid_ns(struct lttng_session *session,
+		unsigned int inum);
+int lttng_session_untrack_pid_ns(struct lttng_session *session,
+		unsigned int inum);
+int lttng_session_list_tracker_pid_ns(struct lttng_session *session);
 
 void lttng_clock_ref(void);
 void lttng_clock_unref(void);
 
+int lttng_channel_task_marker(struct lttng_channel *chan, int enable);
+int lttng_task_marker_unregister(struct lttng_channel *chan);
+
+/*
+ * Dictionary id of a text of "len" bytes. Ids are derived from the text
+ * only, so a given id always stands for the same text.
+ */
+static inline
+uint64_t lttng_string_dict_id(const char *str, size_t len)
+{
+	return ((uint64_t) jhash(str, len, 0) << 32) | jhash(str, len, 1);
+}
+
+/*
+ * Tag of a delta-encoded integer, followed by the value for the _BASE and
+ * _FULL tags, else by its difference with the base on 1, 2 or 4 bytes.
+ * The base is the value of the last record of the event tagged _BASE or
+ * _DELTA_* in the packet. _FULL records are nested over the recording of
+ * another record of the event, and do not change the base.
+ */
+enum lttng_delta_tag {
+	LTTNG_DELTA_BASE = 0,
+	LTTNG_DELTA_FULL = 1,
+	LTTNG_DELTA_8 = 2,
+	LTTNG_DELTA_16 = 3,
+	LTTNG_DELTA_32 = 4,
+};
+
+/* Size of the difference following a _DELTA_* tag, not aligned. */
+static inline
+size_t lttng_delta_len(unsigned int tag)
+{
+	return 1U << (tag - LTTNG_DELTA_8);
+}
+
+/*
+ * Room left in a sub-buffer for the packet header and the header and
+ * contexts of a record. Records of a channel with fragments whose
+ * payload is larger than the rest of the sub-buffer are fragmented.
+ */
+#define LTTNG_FRAGMENT_RESERVED		512
+
+/*
+ * Called by the client with preemption disabled. A record nested over
+ * the staging of another one on the same CPU gets no staging area.
+ */
+static inline
+char *lttng_fragment_stage_get(struct lttng_channel *chan)
+{
+	struct lttng_fragment_stage *stage = this_cpu_ptr(chan->fragment_stage);
+
+	if (stage->busy)
+		return NULL;
+	stage->busy = 1;
+	barrier();	/* Release after the data written. */
+	return stage->data;
+}
+
+int lttng_event_summary_create(struct lttng_event *event);
+void lttng_event_summary_destroy(struct lttng_event *event);
+void lttng_channel_summary_flush(struct lttng_channel *chan);
+
+int lttng_channel_string_dict(struct lttng_channel *chan);
+int lttng_channel_fragment(struct lttng_channel *chan);
+void lttng_channel_fragment_destroy(struct lttng_channel *chan);
+void lttng_fragment_stage_flush(struct lib_ring_buffer_ctx *ctx);
+void lttng_channel_reserve_hot_ids(struct lttng_channel *chan);
+int lttng_channel_add_hot_event(struct lttng_channel *chan, const char *name);
+void lttng_string_dict_reset(struct lttng_channel *chan);
+void lttng_string_dict_define(struct lttng_event *event, const char *str,
+		size_t len);
+int lttng_channel_delta(struct lttng_channel *chan);
+int lttng_delta_event_init(struct lttng_event *event);
+void lttng_delta_reset(struct lttng_channel *chan);
+unsigned int lttng_delta_encode(struct lttng_event *event, unsigned int idx,
+		uint64_t value, void *owner, size_t *delta);
+bool lttng_delta_based(struct lttng_event *event, void *owner,
+		unsigned long *packet);
+void lttng_delta_end(struct lttng_event *event, void *owner,
+		struct lib_ring_buffer_ctx *ctx);
+void lttng_delta_abort(struct lttng_event *event, void *owner);
+void lttng_event_serialize(struct lttng_event *event,
+		struct lttng_probe_ctx *probe_ctx, const char *stack_data,
+		size_t *dynamic_len);
+
 #if defined(CONFIG_HAVE_SYSCALL_TRACEPOINTS)
+void lttng_syscalls_init(void);
 int lttng_syscalls_register(struct lttng_channel *chan, void *filter);
 int lttng_syscalls_unregister(struct lttng_channel *chan);
+int lttng_syscalls_arm(struct lttng_channel *chan);
+void lttng_syscalls_task_sync(int pid);
 int lttng_syscall_filter_enable(struct lttng_channel *chan,
 		const char *name);
 int lttng_syscall_filter_disable(struct lttng_channel *chan,
 		const char *name);
 long lttng_channel_syscall_mask(struct lttng_channel *channel,
 		struct lttng_kernel_syscall_mask __user *usyscall_mask);
+int lttng_channel_syscall_latency(struct lttng_channel *channel,
+		const struct lttng_kernel_syscall_latency *param);
+void lttng_syscall_latency_destroy(struct lttng_channel *channel);
 #else
+static inline void lttng_syscalls_init(void)
+{
+}
+
 static inline int lttng_syscalls_register(struct lttng_channel *chan, void *filter)
 {
 	return -ENOSYS;
@@ -633,6 +1433,15 @@ static inline int lttng_syscalls_unregister(struct lttng_channel *chan)
 	return 0;
 }
 
+static inline int lttng_syscalls_arm(struct lttng_channel *chan)
+{
+	return 0;
+}
+
+static inline void lttng_syscalls_task_sync(int pid)
+{
+}
+
 static inline int lttng_syscall_filter_enable(struct lttng_channel *chan,
 		const char *name)
 {
@@ -650,13 +1459,114 @@ static inline long lttng_channel_syscall_mask(struct lttng_channel *channel,
 {
 	return -ENOSYS;
 }
+
+static inline int lttng_channel_syscall_latency(struct lttng_channel *channel,
+		const struct lttng_kernel_syscall_latency *param)
+{
+	return -ENOSYS;
+}
+
+static inline void lttng_syscall_latency_destroy(struct lttng_channel *channel)
+{
+}
 #endif
 
 void lttng_filter_sync_state(struct lttng_bytecode_runtime *runtime);
+void lttng_filter_event_fuse(struct lttng_event *event);
 int lttng_enabler_attach_bytecode(struct lttng_enabler *enabler,
 		struct lttng_kernel_filter_bytecode __user *bytecode);
 void lttng_enabler_event_link_bytecode(struct lttng_event *event,
 		struct lttng_enabler *enabler);
+void lttng_event_link_bytecode(struct lttng_event *event,
+		struct list_head *bytecode_head);
+int lttng_event_attach_bytecode(struct lttng_event *event,
+		struct lttng_kernel_filter_bytecode __user *bytecode);
+void lttng_free_event_filter_runtime(struct lttng_event *event);
+size_t lttng_event_filter_runtime_size(struct lttng_event *event);
+void lttng_event_get_stats(struct lttng_event *event,
+		struct lttng_kernel_event_stats *stats);
+void lttng_channel_get_stats(struct lttng_channel *chan,
+		struct lttng_kernel_channel_stats *stats);
+int lttng_channel_resize(struct lttng_channel *chan,
+		size_t subbuf_size, size_t num_subbuf);
+int lttng_channel_autotune(struct lttng_channel *chan,
+		const struct lttng_kernel_channel_autotune *param);
+void lttng_channel_get_memory_usage(struct lttng_channel *chan,
+		struct lttng_kernel_channel_memory_usage *usage,
+		uint64_t *cpu_bytes);
+void lttng_session_get_memory_usage(struct lttng_session *session,
+		struct lttng_kernel_session_memory_usage *usage);
+int lttng_session_metadata_binary(struct lttng_session *session,
+		struct lttng_metadata_fragment *frag,
+		int (*flush)(struct lttng_metadata_fragment *frag, void *priv),
+		void *priv);
+int lttng_session_batch_begin(struct lttng_session *session);
+int lttng_session_batch_commit(struct lttng_session *session);
+int lttng_session_set_cpu_mask(struct lttng_session *session,
+		struct cpumask *mask);
+int lttng_session_set_memory_cap(struct lttng_session *session,
+		uint64_t max_bytes);
+int lttng_session_rotate(struct lttng_session *session,
+		uint64_t *rotation_id);
+void lttng_stream_get_rotate_position(struct lib_ring_buffer *buf,
+		struct lttng_kernel_rotate_position *pos);
+bool lttng_event_probe_check(struct lttng_event *event,
+		struct lttng_probe_ctx *lttng_probe_ctx,
+		const char *filter_stack_data);
+
+static inline
+int lttng_filter_prefilter_match(const struct lttng_filter_prefilter *prefilter,
+		const char *filter_stack_data)
+{
+	unsigned int i;
+
+	for (i = 0; i < prefilter->nr_terms; i++) {
+		const struct lttng_filter_prefilter_term *term =
+			&prefilter->terms[i];
+		int64_t v;
+		int match;
+
+		memcpy(&v, &filter_stack_data[term->offset], sizeof(v));
+		switch (term->op) {
+		case LTTNG_FILTER_PREFILTER_EQ:
+			match = (v == term->v);
+			break;
+		case LTTNG_FILTER_PREFILTER_NE:
+			match = (v != term->v);
+			break;
+		case LTTNG_FILTER_PREFILTER_GT:
+			match = (v > term->v);
+			break;
+		case LTTNG_FILTER_PREFILTER_LT:
+			match = (v < term->v);
+			break;
+		case LTTNG_FILTER_PREFILTER_GE:
+			match = (v >= term->v);
+			break;
+		case LTTNG_FILTER_PREFILTER_LE:
+			match = (v <= term->v);
+			break;
+		default:
+			match = 1;
+			break;
+		}
+		if (!match)
+			return LTTNG_FILTER_PREFILTER_REJECT;
+	}
+	return prefilter->exact ? LTTNG_FILTER_PREFILTER_ACCEPT :
+		LTTNG_FILTER_PREFILTER_CONTINUE;
+}
+
+/*
+ * Whether the filter stack preparation must serialize field number
+ * field_idx. A NULL field_mask requests all fields.
+ */
+static inline
+int lttng_filter_field_wanted(const unsigned long *field_mask,
+		unsigned int field_idx)
+{
+	return !field_mask || test_bit(field_idx, field_mask);
+}
 
 int lttng_probes_init(void);
 
@@ -670,6 +1580,7 @@ int lttng_find_context(struct lttng_ctx *ctx, const char *name);
 int lttng_get_context_index(struct lttng_ctx *ctx, const char *name);
 void lttng_remove_context_field(struct lttng_ctx **ctx,
 				struct lttng_ctx_field *field);
+int lttng_context_packet_scope(struct lttng_ctx *ctx);
 void lttng_destroy_context(struct lttng_ctx *ctx);
 int lttng_add_pid_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_cpu_id_to_ctx(struct lttng_ctx **ctx);
@@ -684,6 +1595,47 @@ int lttng_add_vppid_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_hostname_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_interruptible_to_ctx(struct lttng_ctx **ctx);
 int lttng_add_need_reschedule_to_ctx(struct lttng_ctx **ctx);
+int lttng_add_numa_node_to_ctx(struct lttng_ctx **ctx);
+#if defined(CONFIG_CGROUPS) && (LINUX_VERSION_CODE >= KERNEL_VERSION(4,5,0))
+int lttng_add_cgroup_id_to_ctx(struct lttng_ctx **ctx);
+uint64_t lttng_cgroup_id(void);
+#else
+static inline
+int lttng_add_cgroup_id_to_ctx(struct lttng_ctx **ctx)
+{
+	return -ENOSYS;
+}
+static inline
+uint64_t lttng_cgroup_id(void)
+{
+	return 0;
+}
+#endif
+#if defined(CONFIG_CPU_FREQ) && (LINUX_VERSION_CODE >= KERNEL_VERSION(3,4,0))
+int lttng_add_cpu_frequency_to_ctx(struct lttng_ctx **ctx);
+#else
+static inline
+int lttng_add_cpu_frequency_to_ctx(struct lttng_ctx **ctx)
+{
+	return -ENOSYS;
+}
+#endif
+#ifdef CONFIG_STACKTRACE
+int lttng_add_callstack_to_ctx(struct lttng_ctx **ctx,
+		struct lttng_channel *chan);
+void lttng_callstack_reset(struct lttng_channel *chan);
+#else
+static inline
+int lttng_add_callstack_to_ctx(struct lttng_ctx **ctx,
+		struct lttng_channel *chan)
+{
+	return -ENOSYS;
+}
+static inline
+void lttng_callstack_reset(struct lttng_channel *chan)
+{
+}
+#endif
 #if defined(CONFIG_PREEMPT_RT_FULL) || defined(CONFIG_PREEMPT)
 int lttng_add_preemptible_to_ctx(struct lttng_ctx **ctx);
 #else
@@ -734,25 +1686,78 @@ int lttng_cpuhp_perf_counter_dead(unsigned int cpu,
 }
 #endif
 
+#if defined(CONFIG_PERF_EVENTS) && (LINUX_VERSION_CODE >= KERNEL_VERSION(3,1,0))
+int lttng_perf_sample_register(const char *name,
+		const struct lttng_kernel_perf_sample *param,
+		struct lttng_event *event);
+void lttng_perf_sample_unregister(struct lttng_event *event);
+void lttng_perf_sample_destroy_private(struct lttng_event *event);
+int lttng_perf_sample_event_arm(struct lttng_event *event);
+int lttng_cpuhp_perf_sample_online(unsigned int cpu,
+		struct lttng_cpuhp_node *node);
+int lttng_cpuhp_perf_sample_dead(unsigned int cpu,
+		struct lttng_cpuhp_node *node);
+#else
+static inline
+int lttng_perf_sample_register(const char *name,
+		const struct lttng_kernel_perf_sample *param,
+		struct lttng_event *event)
+{
+	return -ENOSYS;
+}
+static inline
+void lttng_perf_sample_unregister(struct lttng_event *event)
+{
+}
+static inline
+void lttng_perf_sample_destroy_private(struct lttng_event *event)
+{
+}
+static inline
+int lttng_perf_sample_event_arm(struct lttng_event *event)
+{
+	return 0;
+}
+static inline
+int lttng_cpuhp_perf_sample_online(unsigned int cpu,
+		struct lttng_cpuhp_node *node)
+{
+	return 0;
+}
+static inline
+int lttng_cpuhp_perf_sample_dead(unsigned int cpu,
+		struct lttng_cpuhp_node *node)
+{
+	return 0;
+}
+#endif
+
 int lttng_logger_init(void);
 void lttng_logger_exit(void);
 
 extern int lttng_statedump_start(struct lttng_session *session);
+extern int lttng_statedump_start_delta(struct lttng_session *session,
+		u64 since, unsigned int categories, unsigned int flags,
+		u64 *generation);
+extern void lttng_statedump_session_destroy(struct lttng_session *session);
 
 #ifdef CONFIG_KPROBES
 int lttng_kprobes_register(const char *name,
 		const char *symbol_name,
 		uint64_t offset,
 		uint64_t addr,
+		uint64_t args,
 		struct lttng_event *event);
 void lttng_kprobes_unregister(struct lttng_event *event);
 void lttng_kprobes_destroy_private(struct lttng_event *event);
+int lttng_kprobes_event_arm(struct lttng_event *event);
 #else
 static inline
 int lttng_kprobes_register(const char *name,
 		const char *symbol_name,
 		uint64_t offset,
 		uint64_t addr,
+		uint64_t args,
 		struct lttng_event *event)
 {
 	return -ENOSYS;
@@ -767,6 +1772,12 @@ static inline
 void lttng_kprobes_destroy_private(struct lttng_event *event)
 {
 }
+
+static inline
+int lttng_kprobes_event_arm(struct lttng_event *event)
+{
+	return 0;
+}
 #endif
 
 #ifdef CONFIG_KRETPROBES
@@ -774,18 +1785,25 @@ int lttng_kretprobes_register(const char *name,
 		const char *symbol_name,
 		uint64_t offset,
 		uint64_t addr,
+		uint32_t flags,
+		uint64_t latency_threshold,
 		struct lttng_event *event_entry,
 		struct lttng_event *event_exit);
 void lttng_kretprobes_unregister(struct lttng_event *event);
 void lttng_kretprobes_destroy_private(struct lttng_event *event);
 int lttng_kretprobes_event_enable_state(struct lttng_event *event,
 	int enable);
+int lttng_kretprobes_event_arm(struct lttng_event *event);
+struct lttng_event *lttng_kretprobes_return_event(struct lttng_event *event);
+uint64_t lttng_kretprobes_missed(struct lttng_event *event);
 #else
 static inline
 int lttng_kretprobes_register(const char *name,
 		const char *symbol_name,
 		uint64_t offset,
 		uint64_t addr,
+		uint32_t flags,
+		uint64_t latency_threshold,
 		struct lttng_event *event_entry,
 		struct lttng_event *event_exit)
 {
@@ -808,6 +1826,24 @@ int lttng_kretprobes_event_enable_state(struct lttng_event *event,
 {
 	return -ENOSYS;
 }
+
+static inline
+int lttng_kretprobes_event_arm(struct lttng_event *event)
+{
+	return 0;
+}
+
+static inline
+struct lttng_event *lttng_kretprobes_return_event(struct lttng_event *event)
+{
+	return NULL;
+}
+
+static inline
+uint64_t lttng_kretprobes_missed(struct lttng_event *event)
+{
+	return 0;
+}
 #endif
 
 #ifdef CONFIG_DYNAMIC_FTRACE
@@ -816,6 +1852,7 @@ int lttng_ftrace_register(const char *name,
 			  struct lttng_event *event);
 void lttng_ftrace_unregister(struct lttng_event *event);
 void lttng_ftrace_destroy_private(struct lttng_event *event);
+int lttng_ftrace_event_arm(struct lttng_event *event);
 #else
 static inline
 int lttng_ftrace_register(const char *name,
@@ -834,9 +1871,47 @@ static inline
 void lttng_ftrace_destroy_private(struct lttng_event *event)
 {
 }
+
+static inline
+int lttng_ftrace_event_arm(struct lttng_event *event)
+{
+	return 0;
+}
+#endif
+
+#if defined(CONFIG_UPROBES) && (LINUX_VERSION_CODE >= KERNEL_VERSION(3,9,0))
+int lttng_uprobes_register(const char *name, int fd, uint64_t offset,
+		struct lttng_event *event);
+void lttng_uprobes_unregister(struct lttng_event *event);
+void lttng_uprobes_destroy_private(struct lttng_event *event);
+int lttng_uprobes_event_arm(struct lttng_event *event);
+#else
+static inline
+int lttng_uprobes_register(const char *name, int fd, uint64_t offset,
+		struct lttng_event *event)
+{
+	return -ENOSYS;
+}
+
+static inline
+void lttng_uprobes_unregister(struct lttng_event *event)
+{
+}
+
+static inline
+void lttng_uprobes_destroy_private(struct lttng_event *event)
+{
+}
+
+static inline
+int lttng_uprobes_event_arm(struct lttng_event *event)
+{
+	return 0;
+}
 #endif
 
 int lttng_calibrate(struct lttng_kernel_calibrate *calibrate);
+int lttng_calibrate_measure(struct lttng_kernel_calibrate_measure *measure);
 
 extern const struct file_operations lttng_tracepoint_list_fops;
 extern const struct file_operations lttng_syscall_list_fops;
@@ -24,7 +24,10 @@
  * SOFTWARE.
  */
 
+#include <linux/module.h>
 #include <linux/uaccess.h>
+#include <linux/percpu.h>
+#include <linux/swab.h>
 #include <wrapper/frame.h>
 #include <wrapper/types.h>
 
@@ -93,6 +96,24 @@ char get_char_at_cb(size_t at, void *data)
 	return get_char(data, at);
 }
 
+/*
+ * Kernel strings of at most seq_len bytes: "prefix*" patterns match the
+ * candidates starting with the prefix.
+ */
+static
+int prefix_star_glob_match(struct estack_entry *pattern_reg,
+		struct estack_entry *candidate_reg)
+{
+	size_t prefix_len = strlen(pattern_reg->u.s.str) - 1;
+
+	if (candidate_reg->u.s.seq_len < prefix_len)
+		return 1;
+	if (strnlen(candidate_reg->u.s.str, prefix_len) != prefix_len)
+		return 1;
+	return memcmp(candidate_reg->u.s.str, pattern_reg->u.s.str,
+			prefix_len) != 0;
+}
+
 static
 int stack_star_glob_match(struct estack *stack, int top, const char *cmp_type)
 {
@@ -102,16 +123,10 @@ int stack_star_glob_match(struct estack *stack, int top, const char *cmp_type)
 	struct estack_entry *pattern_reg;
 	struct estack_entry *candidate_reg;
 
-	if (estack_bx(stack, top)->u.s.user
-			|| estack_ax(stack, top)->u.s.user) {
-		has_user = true;
-		old_fs = get_fs();
-		set_fs(KERNEL_DS);
-		pagefault_disable();
-	}
-
 	/* Find out which side is the pattern vs. the candidate. */
-	if (estack_ax(stack, top)->u.s.literal_type == ESTACK_STRING_LITERAL_TYPE_STAR_GLOB) {
+	if (estack_ax(stack, top)->u.s.literal_type == ESTACK_STRING_LITERAL_TYPE_STAR_GLOB
+			|| estack_ax(stack, top)->u.s.literal_type
+				== ESTACK_STRING_LITERAL_TYPE_PREFIX_STAR_GLOB) {
 		pattern_reg = estack_ax(stack, top);
 		candidate_reg = estack_bx(stack, top);
 	} else {
@@ -119,6 +134,18 @@ int stack_star_glob_match(struct estack *stack, int top, const char *cmp_type)
 		candidate_reg = estack_ax(stack, top);
 	}
 
+	if (pattern_reg->u.s.literal_type == ESTACK_STRING_LITERAL_TYPE_PREFIX_STAR_GLOB
+			&& !candidate_reg->u.s.user)
+		return prefix_star_glob_match(pattern_reg, candidate_reg);
+
+	if (estack_bx(stack, top)->u.s.user
+			|| estack_ax(stack, top)->u.s.user) {
+		has_user = true;
+		old_fs = get_fs();
+		set_fs(KERNEL_DS);
+		pagefault_disable();
+	}
+
 	/* Perform the match operation. */
 	result = !strutils_star_glob_match_char_cb(get_char_at_cb,
 		pattern_reg, get_char_at_cb, candidate_reg);
@@ -233,6 +260,308 @@ int stack_strcmp(struct estack *stack, int top, const char *cmp_type)
 	return diff;
 }
 
+/*
+ * Binary search of the validated s64 set following the instruction.
+ */
+static
+int in_s64_set(const struct set_op *insn, int64_t v)
+{
+	const struct literal_numeric *set =
+		(const struct literal_numeric *) insn->data;
+	unsigned int lo = 0, hi = insn->nr_elem;
+
+	while (lo < hi) {
+		unsigned int mid = lo + ((hi - lo) >> 1);
+		int64_t elem = set[mid].v;
+
+		if (elem == v)
+			return 1;
+		if (elem < v)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return 0;
+}
+
+/*
+ * Compare the register against a set string, as strcmp() does on
+ * unsigned chars. Literals are matched as is: set strings have no
+ * wildcards.
+ */
+static
+int reg_set_strcmp(struct estack_entry *reg, const char *str)
+{
+	size_t offset;
+
+	for (offset = 0; ; offset++) {
+		unsigned char c = get_char(reg, offset);
+		int diff = c - (unsigned char) str[offset];
+
+		if (diff || c == '\0')
+			return diff;
+	}
+}
+
+/*
+ * Binary search of the validated string set following the instruction.
+ */
+static
+int in_string_set(const struct set_op *insn, struct estack_entry *reg)
+{
+	const struct set_string_ref *refs =
+		(const struct set_string_ref *) insn->data;
+	unsigned int lo = 0, hi = insn->nr_elem;
+	mm_segment_t old_fs;
+	int found = 0;
+
+	if (reg->u.s.user) {
+		old_fs = get_fs();
+		set_fs(KERNEL_DS);
+		pagefault_disable();
+	}
+	while (lo < hi) {
+		unsigned int mid = lo + ((hi - lo) >> 1);
+		int diff;
+
+		diff = reg_set_strcmp(reg, insn->data + refs[mid].offset);
+		if (!diff) {
+			found = 1;
+			break;
+		}
+		if (diff > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (reg->u.s.user) {
+		pagefault_enable();
+		set_fs(old_fs);
+	}
+	return found;
+}
+
+/*
+ * Load the element of an array or sequence field. Out of bounds
+ * elements and faulting user-space reads are evaluation errors.
+ */
+static
+int load_field_elem(const char *filter_stack_data,
+		const struct field_index_ref *ref, int64_t *v)
+{
+	unsigned long len =
+		*(unsigned long *) &filter_stack_data[ref->offset];
+	const char *base = *(const char **) &filter_stack_data[ref->offset
+						+ sizeof(unsigned long)];
+	const char *ptr;
+	union {
+		uint8_t u8;
+		uint16_t u16;
+		uint32_t u32;
+		uint64_t u64;
+	} elem;
+
+	if (unlikely(!base || ref->index >= len))
+		return -EINVAL;
+	ptr = base + (size_t) ref->index * ref->elem_size;
+	if (ref->user) {
+		mm_segment_t old_fs;
+		unsigned long uncopied = 1;
+
+		old_fs = get_fs();
+		set_fs(KERNEL_DS);
+		pagefault_disable();
+		if (likely(access_ok(VERIFY_READ, (const char __user *) ptr,
+				ref->elem_size)))
+			uncopied = __copy_from_user_inatomic(&elem,
+				(const char __user *) ptr, ref->elem_size);
+		pagefault_enable();
+		set_fs(old_fs);
+		if (unlikely(uncopied))
+			return -EFAULT;
+	} else {
+		memcpy(&elem, ptr, ref->elem_size);
+	}
+	switch (ref->elem_size) {
+	case 1:
+		*v = ref->elem_signed ? (int64_t) (int8_t) elem.u8 : elem.u8;
+		break;
+	case 2:
+		if (ref->elem_reverse)
+			elem.u16 = swab16(elem.u16);
+		*v = ref->elem_signed ? (int64_t) (int16_t) elem.u16 : elem.u16;
+		break;
+	case 4:
+		if (ref->elem_reverse)
+			elem.u32 = swab32(elem.u32);
+		*v = ref->elem_signed ? (int64_t) (int32_t) elem.u32 : elem.u32;
+		break;
+	case 8:
+		if (ref->elem_reverse)
+			elem.u64 = swab64(elem.u64);
+		*v = (int64_t) elem.u64;
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/*
+ * User-space strings and sequences are copied to a per-CPU bounce
+ * buffer when loaded, so the comparisons which follow read kernel
+ * memory. Each nesting level of probes on a CPU has its own buffer.
+ */
+#define FILTER_BOUNCE_LEN	512
+#define FILTER_BOUNCE_NESTING	4
+
+struct filter_bounce_cpu {
+	char buf[FILTER_BOUNCE_NESTING][FILTER_BOUNCE_LEN];
+	int nesting;
+};
+
+static DEFINE_PER_CPU(struct filter_bounce_cpu, filter_bounce_cpu);
+
+/* Bounce buffer of an interpreter run. */
+struct filter_bounce {
+	char *buf;		/* NULL until the first user-space load */
+	size_t used;
+	int unavailable;	/* Nested too deeply */
+};
+
+/*
+ * Called with preemption disabled.
+ */
+static
+char *filter_bounce_get(struct filter_bounce *bounce)
+{
+	struct filter_bounce_cpu *cpu_bounce;
+	int level;
+
+	if (bounce->buf || bounce->unavailable)
+		return bounce->buf;
+	cpu_bounce = this_cpu_ptr(&filter_bounce_cpu);
+	level = cpu_bounce->nesting++;
+	barrier();
+	if (unlikely(level >= FILTER_BOUNCE_NESTING)) {
+		barrier();
+		cpu_bounce->nesting--;
+		bounce->unavailable = 1;
+		return NULL;
+	}
+	bounce->buf = cpu_bounce->buf[level];
+	return bounce->buf;
+}
+
+static
+void filter_bounce_put(struct filter_bounce *bounce)
+{
+	if (!bounce->buf)
+		return;
+	barrier();
+	this_cpu_ptr(&filter_bounce_cpu)->nesting--;
+}
+
+/*
+ * Copy the user-space string or sequence of "reg" to the bounce buffer,
+ * in chunks which do not cross page boundaries. A fault ends the
+ * string, as it does for get_char(). Strings which do not fit are left
+ * in user space, and read one character at a time.
+ */
+static
+void filter_bounce_user_string(struct filter_bounce *bounce,
+		struct estack_entry *reg)
+{
+	const char __user *src = reg->u.s.user_str;
+	int is_seq = reg->u.s.seq_len != LTTNG_SIZE_MAX;
+	size_t max, len = 0;
+	mm_segment_t old_fs;
+	int end = 0;
+	char *dst;
+
+	if (!filter_bounce_get(bounce))
+		return;
+	/* Room for the final '\0' of strings. */
+	max = FILTER_BOUNCE_LEN - bounce->used;
+	if (is_seq) {
+		if (reg->u.s.seq_len > max)
+			return;
+		max = reg->u.s.seq_len;
+	} else {
+		if (!max)
+			return;
+		max--;
+	}
+	dst = bounce->buf + bounce->used;
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	pagefault_disable();
+	while (len < max) {
+		size_t chunk = min_t(size_t, max - len,
+				PAGE_SIZE - offset_in_page(src + len));
+		unsigned long uncopied;
+		const char *nul;
+
+		if (unlikely(!access_ok(VERIFY_READ, src + len, chunk))) {
+			end = 1;
+			break;
+		}
+		uncopied = __copy_from_user_inatomic(dst + len, src + len,
+				chunk);
+		if (!is_seq) {
+			nul = memchr(dst + len, '\0', chunk - uncopied);
+			if (nul) {
+				len = nul - dst;
+				end = 1;
+				break;
+			}
+		}
+		len += chunk - uncopied;
+		if (unlikely(uncopied)) {
+			end = 1;
+			break;
+		}
+	}
+	pagefault_enable();
+	set_fs(old_fs);
+	if (is_seq) {
+		reg->u.s.seq_len = len;
+	} else {
+		if (!end)
+			return;
+		dst[len++] = '\0';
+	}
+	bounce->used += len;
+	reg->u.s.str = dst;
+	reg->u.s.user = 0;
+}
+
+/*
+ * Equality of the strings on top of the stack. Kernel strings without
+ * wildcards are compared with the string library, one byte at a time
+ * otherwise.
+ */
+static
+int stack_streq(struct estack *stack, int top, const char *cmp_type)
+{
+	struct estack_entry *reg_bx = estack_bx(stack, top);
+	struct estack_entry *reg_ax = estack_ax(stack, top);
+	size_t len_bx, len_ax;
+
+	if (reg_bx->u.s.user || reg_ax->u.s.user
+			|| reg_bx->u.s.literal_type != ESTACK_STRING_LITERAL_TYPE_NONE
+			|| reg_ax->u.s.literal_type != ESTACK_STRING_LITERAL_TYPE_NONE)
+		return stack_strcmp(stack, top, cmp_type) == 0;
+	if (reg_bx->u.s.seq_len == LTTNG_SIZE_MAX
+			&& reg_ax->u.s.seq_len == LTTNG_SIZE_MAX)
+		return !strcmp(reg_bx->u.s.str, reg_ax->u.s.str);
+	/* Sequences end at their length or at the first '\0'. */
+	len_bx = strnlen(reg_bx->u.s.str, reg_bx->u.s.seq_len);
+	len_ax = strnlen(reg_ax->u.s.str, reg_ax->u.s.seq_len);
+	return len_bx == len_ax && !memcmp(reg_bx->u.s.str, reg_ax->u.s.str,
+			len_bx);
+}
+
 uint64_t lttng_filter_false(void *filter_data,
 		struct lttng_probe_ctx *lttng_probe_ctx,
 		const char *filter_stack_data)
@@ -303,6 +632,7 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 	struct estack *stack = &_stack;
 	register int64_t ax = 0, bx = 0;
 	register int top = FILTER_STACK_EMPTY;
+	struct filter_bounce bounce = { .buf = NULL };
 #ifndef INTERPRETER_USE_SWITCH
 	static void *dispatch[NR_FILTER_OPS] = {
 		[ FILTER_OP_UNKNOWN ] = &&LABEL_FILTER_OP_UNKNOWN,
@@ -414,6 +744,26 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 		/* load userspace field ref */
 		[ FILTER_OP_LOAD_FIELD_REF_USER_STRING ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_USER_STRING,
 		[ FILTER_OP_LOAD_FIELD_REF_USER_SEQUENCE ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_USER_SEQUENCE,
+
+		/* set membership */
+		[ FILTER_OP_IN_S64_SET ] = &&LABEL_FILTER_OP_IN_S64_SET,
+		[ FILTER_OP_IN_STRING_SET ] = &&LABEL_FILTER_OP_IN_STRING_SET,
+
+		/* specialized literal strings */
+		[ FILTER_OP_LOAD_EXACT_STRING ] = &&LABEL_FILTER_OP_LOAD_EXACT_STRING,
+		[ FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING ] = &&LABEL_FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING,
+
+		/* s64 field ref compared to immediate */
+		[ FILTER_OP_FIELD_EQ_IMM_S64 ] = &&LABEL_FILTER_OP_FIELD_EQ_IMM_S64,
+		[ FILTER_OP_FIELD_NE_IMM_S64 ] = &&LABEL_FILTER_OP_FIELD_NE_IMM_S64,
+		[ FILTER_OP_FIELD_GT_IMM_S64 ] = &&LABEL_FILTER_OP_FIELD_GT_IMM_S64,
+		[ FILTER_OP_FIELD_LT_IMM_S64 ] = &&LABEL_FILTER_OP_FIELD_LT_IMM_S64,
+		[ FILTER_OP_FIELD_GE_IMM_S64 ] = &&LABEL_FILTER_OP_FIELD_GE_IMM_S64,
+		[ FILTER_OP_FIELD_LE_IMM_S64 ] = &&LABEL_FILTER_OP_FIELD_LE_IMM_S64,
+
+		/* integer element of an array or sequence field */
+		[ FILTER_OP_LOAD_FIELD_REF_INDEX ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_INDEX,
+		[ FILTER_OP_LOAD_FIELD_REF_INDEX_S64 ] = &&LABEL_FILTER_OP_LOAD_FIELD_REF_INDEX_S64,
 	};
 #endif /* #ifndef INTERPRETER_USE_SWITCH */
 
@@ -422,6 +772,7 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 		OP(FILTER_OP_UNKNOWN):
 		OP(FILTER_OP_LOAD_FIELD_REF):
 		OP(FILTER_OP_GET_CONTEXT_REF):
+		OP(FILTER_OP_LOAD_FIELD_REF_INDEX):
 #ifdef INTERPRETER_USE_SWITCH
 		default:
 #endif /* INTERPRETER_USE_SWITCH */
@@ -467,7 +818,7 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 		{
 			int res;
 
-			res = (stack_strcmp(stack, top, "==") == 0);
+			res = stack_streq(stack, top, "==");
 			estack_pop(stack, top, ax, bx);
 			estack_ax_v = res;
 			next_pc += sizeof(struct binary_op);
@@ -477,7 +828,7 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 		{
 			int res;
 
-			res = (stack_strcmp(stack, top, "!=") != 0);
+			res = !stack_streq(stack, top, "!=");
 			estack_pop(stack, top, ax, bx);
 			estack_ax_v = res;
 			next_pc += sizeof(struct binary_op);
@@ -674,6 +1025,24 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			PO;
 		}
 
+		/* set membership */
+		OP(FILTER_OP_IN_S64_SET):
+		{
+			struct set_op *insn = (struct set_op *) pc;
+
+			estack_ax_v = in_s64_set(insn, estack_ax_v);
+			next_pc += sizeof(struct set_op) + insn->len;
+			PO;
+		}
+		OP(FILTER_OP_IN_STRING_SET):
+		{
+			struct set_op *insn = (struct set_op *) pc;
+
+			estack_ax_v = in_string_set(insn, estack_ax(stack, top));
+			next_pc += sizeof(struct set_op) + insn->len;
+			PO;
+		}
+
 		/* logical */
 		OP(FILTER_OP_AND):
 		{
@@ -777,6 +1146,94 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			PO;
 		}
 
+		/* s64 field ref compared to immediate */
+		OP(FILTER_OP_FIELD_EQ_IMM_S64):
+		{
+			struct field_cmp_imm_op *insn = (struct field_cmp_imm_op *) pc;
+			int64_t v = ((struct literal_numeric *)
+				&filter_stack_data[insn->ref.offset])->v;
+
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = (v == insn->imm.v);
+			next_pc += sizeof(struct field_cmp_imm_op);
+			PO;
+		}
+		OP(FILTER_OP_FIELD_NE_IMM_S64):
+		{
+			struct field_cmp_imm_op *insn = (struct field_cmp_imm_op *) pc;
+			int64_t v = ((struct literal_numeric *)
+				&filter_stack_data[insn->ref.offset])->v;
+
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = (v != insn->imm.v);
+			next_pc += sizeof(struct field_cmp_imm_op);
+			PO;
+		}
+		OP(FILTER_OP_FIELD_GT_IMM_S64):
+		{
+			struct field_cmp_imm_op *insn = (struct field_cmp_imm_op *) pc;
+			int64_t v = ((struct literal_numeric *)
+				&filter_stack_data[insn->ref.offset])->v;
+
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = (v > insn->imm.v);
+			next_pc += sizeof(struct field_cmp_imm_op);
+			PO;
+		}
+		OP(FILTER_OP_FIELD_LT_IMM_S64):
+		{
+			struct field_cmp_imm_op *insn = (struct field_cmp_imm_op *) pc;
+			int64_t v = ((struct literal_numeric *)
+				&filter_stack_data[insn->ref.offset])->v;
+
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = (v < insn->imm.v);
+			next_pc += sizeof(struct field_cmp_imm_op);
+			PO;
+		}
+		OP(FILTER_OP_FIELD_GE_IMM_S64):
+		{
+			struct field_cmp_imm_op *insn = (struct field_cmp_imm_op *) pc;
+			int64_t v = ((struct literal_numeric *)
+				&filter_stack_data[insn->ref.offset])->v;
+
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = (v >= insn->imm.v);
+			next_pc += sizeof(struct field_cmp_imm_op);
+			PO;
+		}
+		OP(FILTER_OP_FIELD_LE_IMM_S64):
+		{
+			struct field_cmp_imm_op *insn = (struct field_cmp_imm_op *) pc;
+			int64_t v = ((struct literal_numeric *)
+				&filter_stack_data[insn->ref.offset])->v;
+
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = (v <= insn->imm.v);
+			next_pc += sizeof(struct field_cmp_imm_op);
+			PO;
+		}
+
+		OP(FILTER_OP_LOAD_FIELD_REF_INDEX_S64):
+		{
+			struct load_op *insn = (struct load_op *) pc;
+			struct field_index_ref *ref = (struct field_index_ref *) insn->data;
+			int64_t v;
+
+			dbg_printk("load field ref offset %u index %u\n",
+				ref->offset, ref->index);
+			ret = load_field_elem(filter_stack_data, ref, &v);
+			if (unlikely(ret)) {
+				dbg_printk("Filter warning: cannot load element %u.\n",
+					ref->index);
+				goto end;
+			}
+			estack_push(stack, top, ax, bx);
+			estack_ax_v = v;
+			next_pc += sizeof(struct load_op) + sizeof(struct field_index_ref);
+			PO;
+		}
+
 		OP(FILTER_OP_LOAD_FIELD_REF_DOUBLE):
 		{
 			BUG_ON(1);
@@ -814,6 +1271,36 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			PO;
 		}
 
+		OP(FILTER_OP_LOAD_EXACT_STRING):
+		{
+			struct load_op *insn = (struct load_op *) pc;
+
+			dbg_printk("load exact string %s\n", insn->data);
+			estack_push(stack, top, ax, bx);
+			estack_ax(stack, top)->u.s.str = insn->data;
+			estack_ax(stack, top)->u.s.seq_len = LTTNG_SIZE_MAX;
+			estack_ax(stack, top)->u.s.literal_type =
+				ESTACK_STRING_LITERAL_TYPE_NONE;
+			estack_ax(stack, top)->u.s.user = 0;
+			next_pc += sizeof(struct load_op) + strlen(insn->data) + 1;
+			PO;
+		}
+
+		OP(FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING):
+		{
+			struct load_op *insn = (struct load_op *) pc;
+
+			dbg_printk("load prefix globbing pattern %s\n", insn->data);
+			estack_push(stack, top, ax, bx);
+			estack_ax(stack, top)->u.s.str = insn->data;
+			estack_ax(stack, top)->u.s.seq_len = LTTNG_SIZE_MAX;
+			estack_ax(stack, top)->u.s.literal_type =
+				ESTACK_STRING_LITERAL_TYPE_PREFIX_STAR_GLOB;
+			estack_ax(stack, top)->u.s.user = 0;
+			next_pc += sizeof(struct load_op) + strlen(insn->data) + 1;
+			PO;
+		}
+
 		OP(FILTER_OP_LOAD_S64):
 		{
 			struct load_op *insn = (struct load_op *) pc;
@@ -863,7 +1350,7 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			dbg_printk("get context ref offset %u type string\n",
 				ref->offset);
 			ctx_field = &lttng_static_ctx->fields[ref->offset];
-			ctx_field->get_value(ctx_field, lttng_probe_ctx, &v);
+			lttng_ctx_get_value(ctx_field, lttng_probe_ctx, &v);
 			estack_push(stack, top, ax, bx);
 			estack_ax(stack, top)->u.s.str = v.str;
 			if (unlikely(!estack_ax(stack, top)->u.s.str)) {
@@ -890,7 +1377,7 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			dbg_printk("get context ref offset %u type s64\n",
 				ref->offset);
 			ctx_field = &lttng_static_ctx->fields[ref->offset];
-			ctx_field->get_value(ctx_field, lttng_probe_ctx, &v);
+			lttng_ctx_get_value(ctx_field, lttng_probe_ctx, &v);
 			estack_push(stack, top, ax, bx);
 			estack_ax_v = v.s64;
 			dbg_printk("ref get context s64 %lld\n",
@@ -925,7 +1412,7 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			estack_ax(stack, top)->u.s.literal_type =
 				ESTACK_STRING_LITERAL_TYPE_NONE;
 			estack_ax(stack, top)->u.s.user = 1;
-			dbg_printk("ref load string %s\n", estack_ax(stack, top)->u.s.str);
+			filter_bounce_user_string(&bounce, estack_ax(stack, top));
 			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
 			PO;
 		}
@@ -951,17 +1438,20 @@ uint64_t lttng_filter_interpret_bytecode(void *filter_data,
 			estack_ax(stack, top)->u.s.literal_type =
 				ESTACK_STRING_LITERAL_TYPE_NONE;
 			estack_ax(stack, top)->u.s.user = 1;
+			filter_bounce_user_string(&bounce, estack_ax(stack, top));
 			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
 			PO;
 		}
 
 	END_OP
 end:
+	filter_bounce_put(&bounce);
 	/* return 0 (discard) on error */
 	if (ret)
 		return 0;
 	return retval;
 }
+EXPORT_SYMBOL_GPL(lttng_filter_interpret_bytecode);
 
 #undef START_OP
 #undef OP
@@ -0,0 +1,381 @@
+/*
+ * lttng-filter-jit.c
+ *
+ * LTTng modules filter bytecode x86-64 JIT compiler.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <linux/module.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/version.h>
+#include <asm/cacheflush.h>
+
+#include <lttng-filter.h>
+
+/*
+ * The JIT only handles the integer subset of the specialized bytecode:
+ * s64 field loads, s64 immediates, s64 comparisons, s64 unary
+ * operators, logical AND/OR and return. Any other instruction makes
+ * the compilation fail, and the caller keeps using the interpreter.
+ *
+ * The generated function follows the System V calling convention of
+ * the filter callback:
+ *
+ *   uint64_t filter(void *filter_data,                    (rdi)
+ *                   struct lttng_probe_ctx *probe_ctx,     (rsi)
+ *                   const char *filter_stack_data);        (rdx)
+ *
+ * The interpreter stack is mapped as follows: ax is kept in rax, bx is
+ * kept in rcx, and deeper entries are spilled to the machine stack.
+ * rbp holds the frame pointer so the return path can restore rsp
+ * whatever the depth of the stack at that point.
+ */
+
+struct jit_state {
+	unsigned char *image;	/* NULL when sizing */
+	size_t len;		/* current native offset */
+	uint32_t *addrs;	/* native offset of each bytecode offset */
+};
+
+static
+void emit(struct jit_state *s, const unsigned char *insn, size_t len)
+{
+	if (s->image)
+		memcpy(&s->image[s->len], insn, len);
+	s->len += len;
+}
+
+static
+void emit_u32(struct jit_state *s, uint32_t v)
+{
+	emit(s, (const unsigned char *) &v, sizeof(v));
+}
+
+static
+void emit_u64(struct jit_state *s, uint64_t v)
+{
+	emit(s, (const unsigned char *) &v, sizeof(v));
+}
+
+/* push rcx ; mov %rax,%rcx */
+static
+void emit_estack_push(struct jit_state *s)
+{
+	static const unsigned char insn[] = { 0x51, 0x48, 0x89, 0xc1 };
+
+	emit(s, insn, sizeof(insn));
+}
+
+/* mov %rcx,%rax ; pop rcx */
+static
+void emit_estack_pop(struct jit_state *s)
+{
+	static const unsigned char insn[] = { 0x48, 0x89, 0xc8, 0x59 };
+
+	emit(s, insn, sizeof(insn));
+}
+
+/* test %rax,%rax */
+static
+void emit_test_ax(struct jit_state *s)
+{
+	static const unsigned char insn[] = { 0x48, 0x85, 0xc0 };
+
+	emit(s, insn, sizeof(insn));
+}
+
+/* set<cc> %al ; movzbl %al,%eax */
+static
+void emit_setcc_ax(struct jit_state *s, unsigned char cc)
+{
+	const unsigned char insn[] = { 0x0f, cc, 0xc0, 0x0f, 0xb6, 0xc0 };
+
+	emit(s, insn, sizeof(insn));
+}
+
+/* Jump to a forward bytecode offset. */
+static
+int emit_jump(struct jit_state *s, const unsigned char *op,
+		struct bytecode_runtime *bytecode, uint16_t target)
+{
+	int32_t rel;
+
+	if (target >= bytecode->len)
+		return -EINVAL;
+	emit(s, op, op[0] == 0x0f ? 2 : 1);
+	rel = (int32_t) s->addrs[target] - (int32_t) (s->len + sizeof(uint32_t));
+	emit_u32(s, (uint32_t) rel);
+	return 0;
+}
+
+static
+void emit_prologue(struct jit_state *s)
+{
+	static const unsigned char insn[] = {
+		0x55,			/* push %rbp */
+		0x48, 0x89, 0xe5,	/* mov %rsp,%rbp */
+		0x31, 0xc0,		/* xor %eax,%eax */
+		0x31, 0xc9,		/* xor %ecx,%ecx */
+	};
+
+	emit(s, insn, sizeof(insn));
+}
+
+static
+void emit_epilogue(struct jit_state *s)
+{
+	static const unsigned char insn[] = {
+		0x48, 0x89, 0xec,	/* mov %rbp,%rsp */
+		0x5d,			/* pop %rbp */
+		0xc3,			/* ret */
+	};
+
+	emit(s, insn, sizeof(insn));
+}
+
+static
+unsigned char cmp_setcc(filter_opcode_t op)
+{
+	switch (op) {
+	case FILTER_OP_EQ_S64:
+		return 0x94;	/* sete */
+	case FILTER_OP_NE_S64:
+		return 0x95;	/* setne */
+	case FILTER_OP_GT_S64:
+		return 0x9f;	/* setg */
+	case FILTER_OP_LT_S64:
+		return 0x9c;	/* setl */
+	case FILTER_OP_GE_S64:
+		return 0x9d;	/* setge */
+	case FILTER_OP_LE_S64:
+		return 0x9e;	/* setle */
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Emit the whole program. Called once with s->image == NULL to compute
+ * the native offset of each instruction, and a second time to generate
+ * the code with resolved jump targets. Instruction encodings have a
+ * fixed length, so both passes produce identical layouts.
+ */
+static
+int jit_emit_program(struct jit_state *s, struct bytecode_runtime *bytecode)
+{
+	char *start_pc = bytecode->data, *pc, *next_pc;
+	int ret;
+
+	s->len = 0;
+	emit_prologue(s);
+
+	for (pc = next_pc = start_pc; pc - start_pc < bytecode->len;
+			pc = next_pc) {
+		filter_opcode_t op = *(filter_opcode_t *) pc;
+
+		s->addrs[pc - start_pc] = s->len;
+
+		switch (op) {
+		case FILTER_OP_RETURN:
+			/* LTTNG_FILTER_DISCARD or LTTNG_FILTER_RECORD_FLAG */
+			emit_test_ax(s);
+			emit_setcc_ax(s, 0x95);	/* setne */
+			emit_epilogue(s);
+			next_pc += sizeof(struct return_op);
+			break;
+
+		case FILTER_OP_EQ_S64:
+		case FILTER_OP_NE_S64:
+		case FILTER_OP_GT_S64:
+		case FILTER_OP_LT_S64:
+		case FILTER_OP_GE_S64:
+		case FILTER_OP_LE_S64:
+		{
+			/* cmp %rax,%rcx : compare bx with ax */
+			static const unsigned char cmp[] = { 0x48, 0x39, 0xc1 };
+			/* pop rcx : ax is overwritten by the result */
+			static const unsigned char pop_bx[] = { 0x59 };
+
+			emit(s, cmp, sizeof(cmp));
+			emit_setcc_ax(s, cmp_setcc(op));
+			emit(s, pop_bx, sizeof(pop_bx));
+			next_pc += sizeof(struct binary_op);
+			break;
+		}
+
+		case FILTER_OP_UNARY_PLUS_S64:
+			next_pc += sizeof(struct unary_op);
+			break;
+		case FILTER_OP_UNARY_MINUS_S64:
+		{
+			/* neg %rax */
+			static const unsigned char neg[] = { 0x48, 0xf7, 0xd8 };
+
+			emit(s, neg, sizeof(neg));
+			next_pc += sizeof(struct unary_op);
+			break;
+		}
+		case FILTER_OP_UNARY_NOT_S64:
+			emit_test_ax(s);
+			emit_setcc_ax(s, 0x94);	/* sete */
+			next_pc += sizeof(struct unary_op);
+			break;
+
+		case FILTER_OP_AND:
+		{
+			struct logical_op *insn = (struct logical_op *) pc;
+			static const unsigned char jz[] = { 0x0f, 0x84 };
+
+			/* If AX is 0, skip and evaluate to 0 */
+			emit_test_ax(s);
+			ret = emit_jump(s, jz, bytecode, insn->skip_offset);
+			if (ret)
+				return ret;
+			/* Pop 1 when jump not taken */
+			emit_estack_pop(s);
+			next_pc += sizeof(struct logical_op);
+			break;
+		}
+		case FILTER_OP_OR:
+		{
+			struct logical_op *insn = (struct logical_op *) pc;
+			/* jz over the "mov $1,%eax ; jmp" sequence */
+			static const unsigned char jz_over[] = { 0x74, 0x0a };
+			static const unsigned char mov_one[] = {
+				0xb8, 0x01, 0x00, 0x00, 0x00,
+			};
+			static const unsigned char jmp[] = { 0xe9 };
+
+			/* If AX is nonzero, skip and evaluate to 1 */
+			emit_test_ax(s);
+			emit(s, jz_over, sizeof(jz_over));
+			emit(s, mov_one, sizeof(mov_one));
+			ret = emit_jump(s, jmp, bytecode, insn->skip_offset);
+			if (ret)
+				return ret;
+			/* Pop 1 when jump not taken */
+			emit_estack_pop(s);
+			next_pc += sizeof(struct logical_op);
+			break;
+		}
+
+		case FILTER_OP_LOAD_FIELD_REF_S64:
+		{
+			struct load_op *insn = (struct load_op *) pc;
+			struct field_ref *ref = (struct field_ref *) insn->data;
+			/* mov disp32(%rdx),%rax */
+			static const unsigned char load[] = { 0x48, 0x8b, 0x82 };
+
+			emit_estack_push(s);
+			emit(s, load, sizeof(load));
+			emit_u32(s, ref->offset);
+			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
+			break;
+		}
+
+		case FILTER_OP_LOAD_S64:
+		{
+			struct load_op *insn = (struct load_op *) pc;
+			/* movabs $imm64,%rax */
+			static const unsigned char movabs[] = { 0x48, 0xb8 };
+
+			emit_estack_push(s);
+			emit(s, movabs, sizeof(movabs));
+			emit_u64(s, ((struct literal_numeric *) insn->data)->v);
+			next_pc += sizeof(struct load_op)
+					+ sizeof(struct literal_numeric);
+			break;
+		}
+
+		case FILTER_OP_CAST_NOP:
+			next_pc += sizeof(struct cast_op);
+			break;
+
+		default:
+			dbg_printk("JIT: unsupported bytecode op %u (%s)\n",
+				(unsigned int) op, lttng_filter_print_op(op));
+			return -ENOTSUPP;
+		}
+	}
+	/* Validated bytecode always returns; discard if it does not. */
+	{
+		static const unsigned char xor_ax[] = { 0x31, 0xc0 };
+
+		emit(s, xor_ax, sizeof(xor_ax));
+		emit_epilogue(s);
+	}
+	return 0;
+}
+
+static
+void *jit_alloc_exec(size_t len)
+{
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(5,8,0))
+	return __vmalloc(len, GFP_KERNEL, PAGE_KERNEL_EXEC);
+#else
+	/* Executable vmalloc is not available to modules anymore. */
+	return NULL;
+#endif
+}
+
+int lttng_filter_jit_compile(struct bytecode_runtime *bytecode)
+{
+	struct jit_state s;
+	int ret;
+
+	memset(&s, 0, sizeof(s));
+	s.addrs = kcalloc(bytecode->len, sizeof(*s.addrs), GFP_KERNEL);
+	if (!s.addrs)
+		return -ENOMEM;
+	/* First pass: layout */
+	ret = jit_emit_program(&s, bytecode);
+	if (ret)
+		goto end;
+	s.image = jit_alloc_exec(s.len);
+	if (!s.image) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	/* Second pass: code generation */
+	ret = jit_emit_program(&s, bytecode);
+	if (ret) {
+		vfree(s.image);
+		goto end;
+	}
+	flush_icache_range((unsigned long) s.image,
+		(unsigned long) s.image + s.len);
+	bytecode->jit_code = s.image;
+	dbg_printk("JIT: compiled %u bytes of bytecode into %zu bytes\n",
+		(unsigned int) bytecode->len, s.len);
+end:
+	kfree(s.addrs);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(lttng_filter_jit_compile);
+
+void lttng_filter_jit_free(struct bytecode_runtime *bytecode)
+{
+	vfree(bytecode->jit_code);
+	bytecode->jit_code = NULL;
+}
+EXPORT_SYMBOL_GPL(lttng_filter_jit_free);
@@ -0,0 +1,322 @@
+/*
+ * lttng-filter-optimize.c
+ *
+ * LTTng modules filter code optimizer.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Peephole passes over the specialized bytecode left to the interpreter,
+ * repeated until nothing changes:
+ * - comparisons and unary operators on s64 literals are folded into a
+ *   literal,
+ * - s64 field comparisons to a literal become a single instruction,
+ * - CAST_NOP instructions are dropped.
+ * Instructions are only merged with the following ones when those are
+ * not jump targets.
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/bitmap.h>
+#include <lttng-filter.h>
+
+struct optimize_state {
+	const char *in;
+	uint16_t in_len;
+	char *out;
+	uint16_t out_len;
+	uint16_t *map;		/* Output offset of the input instructions. */
+	unsigned long *targets;	/* Input offsets of jump targets. */
+};
+
+static
+int is_s64_cmp(filter_opcode_t op)
+{
+	switch (op) {
+	case FILTER_OP_EQ_S64:
+	case FILTER_OP_NE_S64:
+	case FILTER_OP_GT_S64:
+	case FILTER_OP_LT_S64:
+	case FILTER_OP_GE_S64:
+	case FILTER_OP_LE_S64:
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+static
+int64_t fold_s64_cmp(filter_opcode_t op, int64_t a, int64_t b)
+{
+	switch (op) {
+	case FILTER_OP_EQ_S64:
+		return a == b;
+	case FILTER_OP_NE_S64:
+		return a != b;
+	case FILTER_OP_GT_S64:
+		return a > b;
+	case FILTER_OP_LT_S64:
+		return a < b;
+	case FILTER_OP_GE_S64:
+		return a >= b;
+	case FILTER_OP_LE_S64:
+	default:
+		return a <= b;
+	}
+}
+
+/*
+ * "field <op> imm" form of an s64 comparison, with the operands swapped
+ * when the literal comes first.
+ */
+static
+filter_opcode_t field_imm_op(filter_opcode_t op, int literal_first)
+{
+	switch (op) {
+	case FILTER_OP_EQ_S64:
+		return FILTER_OP_FIELD_EQ_IMM_S64;
+	case FILTER_OP_NE_S64:
+		return FILTER_OP_FIELD_NE_IMM_S64;
+	case FILTER_OP_GT_S64:
+		return literal_first ? FILTER_OP_FIELD_LT_IMM_S64
+				: FILTER_OP_FIELD_GT_IMM_S64;
+	case FILTER_OP_LT_S64:
+		return literal_first ? FILTER_OP_FIELD_GT_IMM_S64
+				: FILTER_OP_FIELD_LT_IMM_S64;
+	case FILTER_OP_GE_S64:
+		return literal_first ? FILTER_OP_FIELD_LE_IMM_S64
+				: FILTER_OP_FIELD_GE_IMM_S64;
+	case FILTER_OP_LE_S64:
+	default:
+		return literal_first ? FILTER_OP_FIELD_GE_IMM_S64
+				: FILTER_OP_FIELD_LE_IMM_S64;
+	}
+}
+
+static
+int64_t insn_s64(const char *pc)
+{
+	return ((struct literal_numeric *) ((struct load_op *) pc)->data)->v;
+}
+
+static
+uint16_t insn_field_offset(const char *pc)
+{
+	return ((struct field_ref *) ((struct load_op *) pc)->data)->offset;
+}
+
+static
+size_t emit_load_s64(char *out, int64_t v)
+{
+	struct load_op *insn = (struct load_op *) out;
+
+	insn->op = FILTER_OP_LOAD_S64;
+	((struct literal_numeric *) insn->data)->v = v;
+	return sizeof(struct load_op) + sizeof(struct literal_numeric);
+}
+
+static
+size_t emit_field_cmp_imm(char *out, filter_opcode_t op, uint16_t offset,
+		int64_t v)
+{
+	struct field_cmp_imm_op *insn = (struct field_cmp_imm_op *) out;
+
+	insn->op = op;
+	insn->ref.offset = offset;
+	insn->imm.v = v;
+	return sizeof(struct field_cmp_imm_op);
+}
+
+/*
+ * Instruction following "pc" when it can be merged with it, NULL
+ * otherwise.
+ */
+static
+const char *mergeable_next(struct optimize_state *s, const char *pc)
+{
+	const char *next;
+
+	if (!pc)
+		return NULL;
+	next = pc + lttng_filter_insn_len(pc);
+	if (next - s->in >= s->in_len || test_bit(next - s->in, s->targets))
+		return NULL;
+	return next;
+}
+
+/*
+ * Return the number of rewrites, or a negative error.
+ */
+static
+int optimize_pass(struct optimize_state *s)
+{
+	const char *pc, *end = s->in + s->in_len;
+	char *out = s->out;
+	int nr_rewrites = 0;
+
+	bitmap_zero(s->targets, s->in_len);
+	for (pc = s->in; pc < end; ) {
+		size_t insn_len = lttng_filter_insn_len(pc);
+
+		if (!insn_len || pc + insn_len > end)
+			return -EINVAL;
+		if (*(filter_opcode_t *) pc == FILTER_OP_AND
+				|| *(filter_opcode_t *) pc == FILTER_OP_OR) {
+			uint16_t target = ((struct logical_op *) pc)->skip_offset;
+
+			if (target >= s->in_len)
+				return -EINVAL;
+			__set_bit(target, s->targets);
+		}
+		pc += insn_len;
+	}
+
+	for (pc = s->in; pc < end; ) {
+		const char *next1 = mergeable_next(s, pc);
+		const char *next2 = mergeable_next(s, next1);
+		filter_opcode_t op0, op1, op2;
+
+		op0 = *(filter_opcode_t *) pc;
+		op1 = next1 ? *(filter_opcode_t *) next1 : FILTER_OP_UNKNOWN;
+		op2 = next2 ? *(filter_opcode_t *) next2 : FILTER_OP_UNKNOWN;
+		/* Jumps to a dropped instruction land on the next one. */
+		s->map[pc - s->in] = out - s->out;
+
+		if (op0 == FILTER_OP_CAST_NOP) {
+			pc += sizeof(struct cast_op);
+			nr_rewrites++;
+			continue;
+		}
+		if (op0 == FILTER_OP_LOAD_S64 && op1 == FILTER_OP_LOAD_S64
+				&& is_s64_cmp(op2)) {
+			out += emit_load_s64(out, fold_s64_cmp(op2,
+					insn_s64(pc), insn_s64(next1)));
+			pc = next2 + sizeof(struct binary_op);
+			nr_rewrites++;
+			continue;
+		}
+		if (op0 == FILTER_OP_LOAD_S64
+				&& (op1 == FILTER_OP_UNARY_PLUS_S64
+					|| op1 == FILTER_OP_UNARY_MINUS_S64
+					|| op1 == FILTER_OP_UNARY_NOT_S64)) {
+			int64_t v = insn_s64(pc);
+
+			if (op1 == FILTER_OP_UNARY_MINUS_S64)
+				v = -v;
+			else if (op1 == FILTER_OP_UNARY_NOT_S64)
+				v = !v;
+			out += emit_load_s64(out, v);
+			pc = next1 + sizeof(struct unary_op);
+			nr_rewrites++;
+			continue;
+		}
+		if (op0 == FILTER_OP_LOAD_FIELD_REF_S64
+				&& op1 == FILTER_OP_LOAD_S64 && is_s64_cmp(op2)) {
+			out += emit_field_cmp_imm(out, field_imm_op(op2, 0),
+					insn_field_offset(pc), insn_s64(next1));
+			pc = next2 + sizeof(struct binary_op);
+			nr_rewrites++;
+			continue;
+		}
+		if (op0 == FILTER_OP_LOAD_S64
+				&& op1 == FILTER_OP_LOAD_FIELD_REF_S64
+				&& is_s64_cmp(op2)) {
+			out += emit_field_cmp_imm(out, field_imm_op(op2, 1),
+					insn_field_offset(next1), insn_s64(pc));
+			pc = next2 + sizeof(struct binary_op);
+			nr_rewrites++;
+			continue;
+		}
+		memcpy(out, pc, lttng_filter_insn_len(pc));
+		out += lttng_filter_insn_len(pc);
+		pc += lttng_filter_insn_len(pc);
+	}
+	s->out_len = out - s->out;
+
+	/* Jump targets are never merged into a preceding instruction. */
+	for (out = s->out; out - s->out < s->out_len;
+			out += lttng_filter_insn_len(out)) {
+		if (*(filter_opcode_t *) out == FILTER_OP_AND
+				|| *(filter_opcode_t *) out == FILTER_OP_OR) {
+			struct logical_op *insn = (struct logical_op *) out;
+
+			insn->skip_offset = s->map[insn->skip_offset];
+		}
+	}
+	return nr_rewrites;
+}
+
+/*
+ * Called on bytecode which has been validated and specialized, before
+ * it is used. The code following the RETURN ending execution is
+ * dropped. The bytecode is left unchanged when the optimized one does
+ * not validate.
+ */
+void lttng_filter_optimize_bytecode(struct bytecode_runtime *bytecode)
+{
+	struct bytecode_runtime *tmp;
+	struct optimize_state s;
+	uint16_t len = bytecode->return_pc + sizeof(struct return_op);
+	int ret, nr_rewrites = 0;
+
+	if (len > bytecode->len)
+		return;
+	tmp = kmalloc(sizeof(*tmp) + len, GFP_KERNEL);
+	s.out = kmalloc(len, GFP_KERNEL);
+	s.map = kcalloc(len, sizeof(*s.map), GFP_KERNEL);
+	s.targets = kcalloc(BITS_TO_LONGS(len), sizeof(unsigned long),
+			GFP_KERNEL);
+	if (!tmp || !s.out || !s.map || !s.targets)
+		goto end;
+	/* Validated as the bytecode, with the same event and field mask. */
+	memcpy(tmp, bytecode, sizeof(*tmp));
+	memcpy(tmp->data, bytecode->data, len);
+	tmp->len = len;
+	do {
+		s.in = tmp->data;
+		s.in_len = tmp->len;
+		ret = optimize_pass(&s);
+		if (ret < 0)
+			goto end;
+		memcpy(tmp->data, s.out, s.out_len);
+		tmp->len = s.out_len;
+		nr_rewrites += ret;
+	} while (ret);
+	if (!nr_rewrites && tmp->len == bytecode->len)
+		goto end;
+	if (lttng_filter_validate_bytecode(tmp)) {
+		printk(KERN_WARNING "Discarding invalid optimized filter bytecode\n");
+		goto end;
+	}
+	dbg_printk("Filter bytecode optimized from %u to %u bytes\n",
+		(unsigned int) bytecode->len, (unsigned int) tmp->len);
+	memcpy(bytecode->data, tmp->data, tmp->len);
+	bytecode->len = tmp->len;
+	bytecode->return_pc = tmp->return_pc;
+end:
+	kfree(s.targets);
+	kfree(s.map);
+	kfree(s.out);
+	kfree(tmp);
+}
+EXPORT_SYMBOL_GPL(lttng_filter_optimize_bytecode);
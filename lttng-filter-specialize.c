@@ -24,6 +24,7 @@
  * SOFTWARE.
  */
 
+#include <linux/module.h>
 #include <lttng-filter.h>
 
 int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
@@ -426,6 +427,18 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 			break;
 		}
 
+		/* set membership */
+		case FILTER_OP_IN_S64_SET:
+		case FILTER_OP_IN_STRING_SET:
+		{
+			struct set_op *insn = (struct set_op *) pc;
+
+			/* Pop 1, push 1 */
+			vstack_ax(stack)->type = REG_S64;
+			next_pc += sizeof(struct set_op) + insn->len;
+			break;
+		}
+
 		/* logical */
 		case FILTER_OP_AND:
 		case FILTER_OP_OR:
@@ -479,6 +492,39 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 			next_pc += sizeof(struct load_op) + sizeof(struct field_ref);
 			break;
 		}
+		/* s64 field ref compared to immediate */
+		case FILTER_OP_FIELD_EQ_IMM_S64:
+		case FILTER_OP_FIELD_NE_IMM_S64:
+		case FILTER_OP_FIELD_GT_IMM_S64:
+		case FILTER_OP_FIELD_LT_IMM_S64:
+		case FILTER_OP_FIELD_GE_IMM_S64:
+		case FILTER_OP_FIELD_LE_IMM_S64:
+		{
+			if (vstack_push(stack)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			vstack_ax(stack)->type = REG_S64;
+			next_pc += sizeof(struct field_cmp_imm_op);
+			break;
+		}
+		/* integer element of an array or sequence field */
+		case FILTER_OP_LOAD_FIELD_REF_INDEX:
+		{
+			printk(KERN_WARNING "Unknown field ref type\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		case FILTER_OP_LOAD_FIELD_REF_INDEX_S64:
+		{
+			if (vstack_push(stack)) {
+				ret = -EINVAL;
+				goto end;
+			}
+			vstack_ax(stack)->type = REG_S64;
+			next_pc += sizeof(struct load_op) + sizeof(struct field_index_ref);
+			break;
+		}
 		case FILTER_OP_LOAD_FIELD_REF_DOUBLE:
 		case FILTER_OP_GET_CONTEXT_REF_DOUBLE:
 		{
@@ -493,6 +539,7 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 
 		/* load from immediate operand */
 		case FILTER_OP_LOAD_STRING:
+		case FILTER_OP_LOAD_EXACT_STRING:
 		{
 			struct load_op *insn = (struct load_op *) pc;
 
@@ -500,21 +547,30 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 				ret = -EINVAL;
 				goto end;
 			}
+			/* Compared as is, without wildcard handling. */
+			if (!strpbrk(insn->data, "*\\"))
+				insn->op = FILTER_OP_LOAD_EXACT_STRING;
 			vstack_ax(stack)->type = REG_STRING;
 			next_pc += sizeof(struct load_op) + strlen(insn->data) + 1;
 			break;
 		}
 
 		case FILTER_OP_LOAD_STAR_GLOB_STRING:
+		case FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING:
 		{
 			struct load_op *insn = (struct load_op *) pc;
+			size_t len = strlen(insn->data);
 
 			if (vstack_push(stack)) {
 				ret = -EINVAL;
 				goto end;
 			}
+			/* Matched with a prefix compare. */
+			if (strcspn(insn->data, "*\\") == len - 1
+					&& insn->data[len - 1] == '*')
+				insn->op = FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING;
 			vstack_ax(stack)->type = REG_STAR_GLOB_STRING;
-			next_pc += sizeof(struct load_op) + strlen(insn->data) + 1;
+			next_pc += sizeof(struct load_op) + len + 1;
 			break;
 		}
 
@@ -588,3 +644,4 @@ int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode)
 end:
 	return ret;
 }
+EXPORT_SYMBOL_GPL(lttng_filter_specialize_bytecode);
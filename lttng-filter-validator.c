@@ -24,6 +24,7 @@
  * SOFTWARE.
  */
 
+#include <linux/module.h>
 #include <linux/types.h>
 #include <linux/jhash.h>
 #include <linux/slab.h>
@@ -187,6 +188,64 @@ error_mismatch:
 	return -EINVAL;
 }
 
+/*
+ * Validate the layout and ordering of an immediate set, which is within
+ * the bytecode range. Lookups are binary searches: they rely on the
+ * ascending order.
+ */
+static
+int bytecode_validate_set(struct set_op *insn)
+{
+	unsigned int i;
+
+	switch (insn->op) {
+	case FILTER_OP_IN_S64_SET:
+	{
+		struct literal_numeric *set = (struct literal_numeric *) insn->data;
+
+		if (insn->len != insn->nr_elem * sizeof(*set))
+			return -ERANGE;
+		for (i = 1; i < insn->nr_elem; i++) {
+			if (set[i - 1].v >= set[i].v)
+				goto error_order;
+		}
+		break;
+	}
+	case FILTER_OP_IN_STRING_SET:
+	{
+		struct set_string_ref *refs = (struct set_string_ref *) insn->data;
+		size_t refs_len = insn->nr_elem * sizeof(*refs);
+		const char *prev = NULL;
+
+		if (insn->len < refs_len)
+			return -ERANGE;
+		for (i = 0; i < insn->nr_elem; i++) {
+			const char *str = insn->data + refs[i].offset;
+
+			if (refs[i].offset < refs_len
+					|| refs[i].offset >= insn->len)
+				return -ERANGE;
+			if (strnlen(str, insn->len - refs[i].offset)
+					>= insn->len - refs[i].offset) {
+				/* Final '\0' not found within range */
+				return -ERANGE;
+			}
+			if (prev && strcmp(prev, str) >= 0)
+				goto error_order;
+			prev = str;
+		}
+		break;
+	}
+	default:
+		return -EINVAL;
+	}
+	return 0;
+
+error_order:
+	printk(KERN_WARNING "filter set is not sorted in ascending order\n");
+	return -EINVAL;
+}
+
 /*
  * Validate bytecode range overflow within the validation pass.
  * Called for each instruction encountered.
@@ -346,6 +405,8 @@ int bytecode_validate_overflow(struct bytecode_runtime *bytecode,
 	/* load from immediate operand */
 	case FILTER_OP_LOAD_STRING:
 	case FILTER_OP_LOAD_STAR_GLOB_STRING:
+	case FILTER_OP_LOAD_EXACT_STRING:
+	case FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING:
 	{
 		struct load_op *insn = (struct load_op *) pc;
 		uint32_t str_len, maxlen;
@@ -361,6 +422,12 @@ int bytecode_validate_overflow(struct bytecode_runtime *bytecode,
 		if (unlikely(str_len >= maxlen)) {
 			/* Final '\0' not found within range */
 			ret = -ERANGE;
+			break;
+		}
+		if (insn->op == FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING
+				&& (!str_len || insn->data[str_len - 1] != '*')) {
+			printk(KERN_WARNING "Invalid prefix globbing pattern\n");
+			ret = -EINVAL;
 		}
 		break;
 	}
@@ -384,6 +451,57 @@ int bytecode_validate_overflow(struct bytecode_runtime *bytecode,
 		break;
 	}
 
+	/* s64 field ref compared to immediate */
+	case FILTER_OP_FIELD_EQ_IMM_S64:
+	case FILTER_OP_FIELD_NE_IMM_S64:
+	case FILTER_OP_FIELD_GT_IMM_S64:
+	case FILTER_OP_FIELD_LT_IMM_S64:
+	case FILTER_OP_FIELD_GE_IMM_S64:
+	case FILTER_OP_FIELD_LE_IMM_S64:
+	{
+		if (unlikely(pc + sizeof(struct field_cmp_imm_op)
+				> start_pc + bytecode->len)) {
+			ret = -ERANGE;
+		}
+		break;
+	}
+
+	/* integer element of an array or sequence field */
+	case FILTER_OP_LOAD_FIELD_REF_INDEX:
+	{
+		printk(KERN_WARNING "Unknown field ref type\n");
+		ret = -EINVAL;
+		break;
+	}
+	case FILTER_OP_LOAD_FIELD_REF_INDEX_S64:
+	{
+		if (unlikely(pc + sizeof(struct load_op) + sizeof(struct field_index_ref)
+				> start_pc + bytecode->len)) {
+			ret = -ERANGE;
+		}
+		break;
+	}
+
+	/* set membership */
+	case FILTER_OP_IN_S64_SET:
+	case FILTER_OP_IN_STRING_SET:
+	{
+		struct set_op *insn = (struct set_op *) pc;
+
+		if (unlikely(pc + sizeof(struct set_op)
+				> start_pc + bytecode->len)) {
+			ret = -ERANGE;
+			break;
+		}
+		if (unlikely(pc + sizeof(struct set_op) + insn->len
+				> start_pc + bytecode->len)) {
+			ret = -ERANGE;
+			break;
+		}
+		ret = bytecode_validate_set(insn);
+		break;
+	}
+
 	}
 
 	return ret;
@@ -630,6 +748,36 @@ int validate_instruction_context(struct bytecode_runtime *bytecode,
 		break;
 	}
 
+	/* set membership */
+	case FILTER_OP_IN_S64_SET:
+	{
+		if (!vstack_ax(stack)) {
+			printk(KERN_WARNING "Empty stack\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		if (vstack_ax(stack)->type != REG_S64) {
+			printk(KERN_WARNING "Unexpected register type for s64 set\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		break;
+	}
+	case FILTER_OP_IN_STRING_SET:
+	{
+		if (!vstack_ax(stack)) {
+			printk(KERN_WARNING "Empty stack\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		if (vstack_ax(stack)->type != REG_STRING) {
+			printk(KERN_WARNING "Unexpected register type for string set\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		break;
+	}
+
 	/* logical */
 	case FILTER_OP_AND:
 	case FILTER_OP_OR:
@@ -686,9 +834,43 @@ int validate_instruction_context(struct bytecode_runtime *bytecode,
 		break;
 	}
 
+	/* s64 field ref compared to immediate */
+	case FILTER_OP_FIELD_EQ_IMM_S64:
+	case FILTER_OP_FIELD_NE_IMM_S64:
+	case FILTER_OP_FIELD_GT_IMM_S64:
+	case FILTER_OP_FIELD_LT_IMM_S64:
+	case FILTER_OP_FIELD_GE_IMM_S64:
+	case FILTER_OP_FIELD_LE_IMM_S64:
+	{
+		struct field_cmp_imm_op *insn = (struct field_cmp_imm_op *) pc;
+
+		dbg_printk("Validate field ref offset %u compared to immediate\n",
+			insn->ref.offset);
+		break;
+	}
+
+	/* integer element of an array or sequence field */
+	case FILTER_OP_LOAD_FIELD_REF_INDEX:
+	{
+		printk(KERN_WARNING "Unknown field ref type\n");
+		ret = -EINVAL;
+		goto end;
+	}
+	case FILTER_OP_LOAD_FIELD_REF_INDEX_S64:
+	{
+		struct load_op *insn = (struct load_op *) pc;
+		struct field_index_ref *ref = (struct field_index_ref *) insn->data;
+
+		dbg_printk("Validate load field ref offset %u index %u\n",
+			ref->offset, ref->index);
+		break;
+	}
+
 	/* load from immediate operand */
 	case FILTER_OP_LOAD_STRING:
 	case FILTER_OP_LOAD_STAR_GLOB_STRING:
+	case FILTER_OP_LOAD_EXACT_STRING:
+	case FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING:
 	{
 		break;
 	}
@@ -815,6 +997,29 @@ int validate_instruction_all_contexts(struct bytecode_runtime *bytecode,
 	return 0;
 }
 
+/*
+ * Record the field loaded by a field ref instruction in the field mask,
+ * so the probe only prepares the fields the filter reads.
+ */
+static
+int mark_field_ref(struct bytecode_runtime *bytecode, char *pc)
+{
+	struct load_op *insn = (struct load_op *) pc;
+	struct field_ref *ref = (struct field_ref *) insn->data;
+	int field_idx;
+
+	if (!bytecode->p.field_mask)
+		return 0;
+	field_idx = lttng_filter_field_index(bytecode->desc, ref->offset);
+	if (field_idx < 0) {
+		printk(KERN_WARNING "Invalid field ref offset %u\n",
+			(unsigned int) ref->offset);
+		return -EINVAL;
+	}
+	__set_bit(field_idx, bytecode->p.field_mask);
+	return 0;
+}
+
 /*
  * Return value:
  * >0: going to next insn.
@@ -951,6 +1156,23 @@ int exec_insn(struct bytecode_runtime *bytecode,
 		break;
 	}
 
+	/* set membership */
+	case FILTER_OP_IN_S64_SET:
+	case FILTER_OP_IN_STRING_SET:
+	{
+		struct set_op *insn = (struct set_op *) pc;
+
+		/* Pop 1, push 1 */
+		if (!vstack_ax(stack)) {
+			printk(KERN_WARNING "Empty stack\n");
+			ret = -EINVAL;
+			goto end;
+		}
+		vstack_ax(stack)->type = REG_S64;
+		next_pc += sizeof(struct set_op) + insn->len;
+		break;
+	}
+
 	/* logical */
 	case FILTER_OP_AND:
 	case FILTER_OP_OR:
@@ -991,9 +1213,14 @@ int exec_insn(struct bytecode_runtime *bytecode,
 	}
 	case FILTER_OP_LOAD_FIELD_REF_STRING:
 	case FILTER_OP_LOAD_FIELD_REF_SEQUENCE:
-	case FILTER_OP_GET_CONTEXT_REF_STRING:
 	case FILTER_OP_LOAD_FIELD_REF_USER_STRING:
 	case FILTER_OP_LOAD_FIELD_REF_USER_SEQUENCE:
+		if (mark_field_ref(bytecode, pc)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		/* Fall-through */
+	case FILTER_OP_GET_CONTEXT_REF_STRING:
 	{
 		if (vstack_push(stack)) {
 			ret = -EINVAL;
@@ -1004,6 +1231,11 @@ int exec_insn(struct bytecode_runtime *bytecode,
 		break;
 	}
 	case FILTER_OP_LOAD_FIELD_REF_S64:
+		if (mark_field_ref(bytecode, pc)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		/* Fall-through */
 	case FILTER_OP_GET_CONTEXT_REF_S64:
 	{
 		if (vstack_push(stack)) {
@@ -1015,8 +1247,53 @@ int exec_insn(struct bytecode_runtime *bytecode,
 		break;
 	}
 
+	/* s64 field ref compared to immediate */
+	case FILTER_OP_FIELD_EQ_IMM_S64:
+	case FILTER_OP_FIELD_NE_IMM_S64:
+	case FILTER_OP_FIELD_GT_IMM_S64:
+	case FILTER_OP_FIELD_LT_IMM_S64:
+	case FILTER_OP_FIELD_GE_IMM_S64:
+	case FILTER_OP_FIELD_LE_IMM_S64:
+	{
+		/* Laid out as a field ref load. */
+		if (mark_field_ref(bytecode, pc)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		if (vstack_push(stack)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		vstack_ax(stack)->type = REG_S64;
+		next_pc += sizeof(struct field_cmp_imm_op);
+		break;
+	}
+
+	/* integer element of an array or sequence field */
+	case FILTER_OP_LOAD_FIELD_REF_INDEX:
+	{
+		printk(KERN_WARNING "Unknown field ref type\n");
+		ret = -EINVAL;
+		goto end;
+	}
+	case FILTER_OP_LOAD_FIELD_REF_INDEX_S64:
+	{
+		if (mark_field_ref(bytecode, pc)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		if (vstack_push(stack)) {
+			ret = -EINVAL;
+			goto end;
+		}
+		vstack_ax(stack)->type = REG_S64;
+		next_pc += sizeof(struct load_op) + sizeof(struct field_index_ref);
+		break;
+	}
+
 	/* load from immediate operand */
 	case FILTER_OP_LOAD_STRING:
+	case FILTER_OP_LOAD_EXACT_STRING:
 	{
 		struct load_op *insn = (struct load_op *) pc;
 
@@ -1030,6 +1307,7 @@ int exec_insn(struct bytecode_runtime *bytecode,
 	}
 
 	case FILTER_OP_LOAD_STAR_GLOB_STRING:
+	case FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING:
 	{
 		struct load_op *insn = (struct load_op *) pc;
 
@@ -1118,8 +1396,11 @@ int lttng_filter_validate_bytecode(struct bytecode_runtime *bytecode)
 		if (ret)
 			goto end;
 		ret = exec_insn(bytecode, mp_table, &stack, &next_pc, pc);
-		if (ret <= 0)
+		if (ret <= 0) {
+			if (!ret)
+				bytecode->return_pc = pc - start_pc;
 			goto end;
+		}
 	}
 end:
 	if (delete_all_nodes(mp_table)) {
@@ -1131,3 +1412,4 @@ end:
 	kfree(mp_table);
 	return ret;
 }
+EXPORT_SYMBOL_GPL(lttng_filter_validate_bytecode);
@@ -26,6 +26,7 @@
 
 #include <linux/list.h>
 #include <linux/slab.h>
+#include <linux/string.h>
 
 #include <lttng-filter.h>
 
@@ -144,6 +145,26 @@ static const char *opnames[] = {
 	/* globbing pattern binary operator: apply to */
 	[ FILTER_OP_EQ_STAR_GLOB_STRING ] = "EQ_STAR_GLOB_STRING",
 	[ FILTER_OP_NE_STAR_GLOB_STRING ] = "NE_STAR_GLOB_STRING",
+
+	/* set membership: apply to ax, against immediate set */
+	[ FILTER_OP_IN_S64_SET ] = "IN_S64_SET",
+	[ FILTER_OP_IN_STRING_SET ] = "IN_STRING_SET",
+
+	/* specialized literal strings */
+	[ FILTER_OP_LOAD_EXACT_STRING ] = "LOAD_EXACT_STRING",
+	[ FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING ] = "LOAD_PREFIX_STAR_GLOB_STRING",
+
+	/* s64 field ref compared to immediate */
+	[ FILTER_OP_FIELD_EQ_IMM_S64 ] = "FIELD_EQ_IMM_S64",
+	[ FILTER_OP_FIELD_NE_IMM_S64 ] = "FIELD_NE_IMM_S64",
+	[ FILTER_OP_FIELD_GT_IMM_S64 ] = "FIELD_GT_IMM_S64",
+	[ FILTER_OP_FIELD_LT_IMM_S64 ] = "FIELD_LT_IMM_S64",
+	[ FILTER_OP_FIELD_GE_IMM_S64 ] = "FIELD_GE_IMM_S64",
+	[ FILTER_OP_FIELD_LE_IMM_S64 ] = "FIELD_LE_IMM_S64",
+
+	/* integer element of an array or sequence field */
+	[ FILTER_OP_LOAD_FIELD_REF_INDEX ] = "LOAD_FIELD_REF_INDEX",
+	[ FILTER_OP_LOAD_FIELD_REF_INDEX_S64 ] = "LOAD_FIELD_REF_INDEX_S64",
 };
 
 const char *lttng_filter_print_op(enum filter_op op)
@@ -154,6 +175,57 @@ const char *lttng_filter_print_op(enum filter_op op)
 		return opnames[op];
 }
 
+/*
+ * Element accesses are resolved to the element type of integer arrays
+ * and sequences, which is known at link time.
+ */
+static
+int apply_field_index_reloc(const struct lttng_event_field *field,
+		struct load_op *op, uint32_t field_offset)
+{
+	struct field_index_ref *ref = (struct field_index_ref *) op->data;
+	const struct lttng_basic_type *elem_type;
+	const struct lttng_integer_type *integer;
+
+	switch (field->type.atype) {
+	case atype_array:
+		elem_type = &field->type.u.array.elem_type;
+		break;
+	case atype_sequence:
+		elem_type = &field->type.u.sequence.elem_type;
+		break;
+	default:
+		return -EINVAL;
+	}
+	switch (elem_type->atype) {
+	case atype_integer:
+		integer = &elem_type->u.basic.integer;
+		break;
+	case atype_enum:
+		integer = &elem_type->u.basic.enumeration.container_type;
+		break;
+	default:
+		return -EINVAL;
+	}
+	/* Bitfield arrays are not indexed by element. */
+	switch (integer->size) {
+	case 8:
+	case 16:
+	case 32:
+	case 64:
+		break;
+	default:
+		return -EINVAL;
+	}
+	op->op = FILTER_OP_LOAD_FIELD_REF_INDEX_S64;
+	ref->offset = (uint16_t) field_offset;
+	ref->elem_size = integer->size / CHAR_BIT;
+	ref->elem_signed = integer->signedness;
+	ref->elem_reverse = integer->reverse_byte_order;
+	ref->user = field->user;
+	return 0;
+}
+
 static
 int apply_field_reloc(struct lttng_event *event,
 		struct bytecode_runtime *runtime,
@@ -214,6 +286,12 @@ int apply_field_reloc(struct lttng_event *event,
 
 	/* set type */
 	op = (struct load_op *) &runtime->data[reloc_offset];
+	if (op->op == FILTER_OP_LOAD_FIELD_REF_INDEX) {
+		if (runtime_len - reloc_offset
+				< sizeof(struct load_op) + sizeof(struct field_index_ref))
+			return -EINVAL;
+		return apply_field_index_reloc(field, op, field_offset);
+	}
 	field_ref = (struct field_ref *) op->data;
 	switch (field->type.atype) {
 	case atype_integer:
@@ -314,6 +392,7 @@ int apply_reloc(struct lttng_event *event,
 	op = (struct load_op *) &runtime->data[reloc_offset];
 	switch (op->op) {
 	case FILTER_OP_LOAD_FIELD_REF:
+	case FILTER_OP_LOAD_FIELD_REF_INDEX:
 		return apply_field_reloc(event, runtime, runtime_len,
 			reloc_offset, name);
 	case FILTER_OP_GET_CONTEXT_REF:
@@ -340,6 +419,233 @@ int bytecode_is_linked(struct lttng_filter_bytecode_node *filter_bytecode,
 	return 0;
 }
 
+/*
+ * Return the index of the field found at filter stack offset
+ * field_offset, or -EINVAL.
+ */
+int lttng_filter_field_index(const struct lttng_event_desc *desc,
+		uint16_t field_offset)
+{
+	uint32_t offset = 0;
+	unsigned int i;
+
+	for (i = 0; i < desc->nr_fields; i++) {
+		if (offset == field_offset)
+			return i;
+		switch (desc->fields[i].type.atype) {
+		case atype_integer:
+		case atype_enum:
+			offset += sizeof(int64_t);
+			break;
+		case atype_array:
+		case atype_sequence:
+			offset += sizeof(unsigned long);
+			offset += sizeof(void *);
+			break;
+		case atype_string:
+			offset += sizeof(void *);
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+	return -EINVAL;
+}
+
+/*
+ * Whether the fields in field_mask, all fields if NULL, can be prepared
+ * from the raw probe arguments, before the local variables used by their
+ * source expressions are computed.
+ */
+int lttng_filter_fields_early(const struct lttng_event_desc *desc,
+		const unsigned long *field_mask)
+{
+	unsigned int i;
+
+	if (!desc->field_srcs)
+		return 1;
+	for (i = 0; i < desc->nr_fields; i++) {
+		if (!lttng_filter_field_wanted(field_mask, i))
+			continue;
+		if (strstr(desc->field_srcs[i], "tp_locvar"))
+			return 0;
+	}
+	return 1;
+}
+
+/* Skip no-op casts left by the specializer. */
+static
+uint16_t prefilter_skip_cast_nop(struct bytecode_runtime *runtime,
+		uint16_t pc)
+{
+	while (pc < runtime->len
+			&& runtime->data[pc] == FILTER_OP_CAST_NOP)
+		pc += sizeof(struct cast_op);
+	return pc;
+}
+
+/*
+ * Decode "field <op> literal" or "literal <op> field" on s64 operands
+ * starting at *pc, and advance *pc past the comparison.
+ */
+static
+int prefilter_parse_term(struct bytecode_runtime *runtime, uint16_t *pc,
+		struct lttng_filter_prefilter_term *term)
+{
+	struct load_op *insn[2];
+	uint16_t pos = *pc;
+	int i, field_first;
+
+	for (i = 0; i < 2; i++) {
+		pos = prefilter_skip_cast_nop(runtime, pos);
+		if (pos >= runtime->len)
+			return -EINVAL;
+		insn[i] = (struct load_op *) &runtime->data[pos];
+		switch (insn[i]->op) {
+		case FILTER_OP_LOAD_FIELD_REF_S64:
+			pos += sizeof(struct load_op) + sizeof(struct field_ref);
+			break;
+		case FILTER_OP_LOAD_S64:
+			pos += sizeof(struct load_op)
+				+ sizeof(struct literal_numeric);
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+	if (insn[0]->op == insn[1]->op)
+		return -EINVAL;
+	field_first = (insn[0]->op == FILTER_OP_LOAD_FIELD_REF_S64);
+	pos = prefilter_skip_cast_nop(runtime, pos);
+	if (pos >= runtime->len)
+		return -EINVAL;
+
+	/* Comparisons are "bx <op> ax": flip them when the field is in ax. */
+	switch ((filter_opcode_t) runtime->data[pos]) {
+	case FILTER_OP_EQ_S64:
+		term->op = LTTNG_FILTER_PREFILTER_EQ;
+		break;
+	case FILTER_OP_NE_S64:
+		term->op = LTTNG_FILTER_PREFILTER_NE;
+		break;
+	case FILTER_OP_GT_S64:
+		term->op = field_first ? LTTNG_FILTER_PREFILTER_GT :
+			LTTNG_FILTER_PREFILTER_LT;
+		break;
+	case FILTER_OP_LT_S64:
+		term->op = field_first ? LTTNG_FILTER_PREFILTER_LT :
+			LTTNG_FILTER_PREFILTER_GT;
+		break;
+	case FILTER_OP_GE_S64:
+		term->op = field_first ? LTTNG_FILTER_PREFILTER_GE :
+			LTTNG_FILTER_PREFILTER_LE;
+		break;
+	case FILTER_OP_LE_S64:
+		term->op = field_first ? LTTNG_FILTER_PREFILTER_LE :
+			LTTNG_FILTER_PREFILTER_GE;
+		break;
+	default:
+		return -EINVAL;
+	}
+	term->offset = ((struct field_ref *) insn[!field_first]->data)->offset;
+	term->v = ((struct literal_numeric *) insn[field_first]->data)->v;
+	*pc = pos + sizeof(struct binary_op);
+	return 0;
+}
+
+/*
+ * An AND whose short-circuit lands, possibly through other ANDs, on
+ * RETURN makes its left operand a necessary condition of the filter.
+ */
+static
+int prefilter_and_discards(struct bytecode_runtime *runtime,
+		struct logical_op *insn)
+{
+	uint16_t target = insn->skip_offset;
+
+	for (;;) {
+		if (target >= runtime->len)
+			return 0;
+		switch ((filter_opcode_t) runtime->data[target]) {
+		case FILTER_OP_RETURN:
+			return 1;
+		case FILTER_OP_AND:
+		{
+			struct logical_op *next =
+				(struct logical_op *) &runtime->data[target];
+
+			/* Skips only go forward. */
+			if (next->skip_offset <= target)
+				return 0;
+			target = next->skip_offset;
+			break;
+		}
+		default:
+			return 0;
+		}
+	}
+}
+
+/*
+ * Extract the leading conjunction of integer field comparisons of a
+ * specialized bytecode into its prefilter descriptor.
+ */
+static
+void lttng_filter_build_prefilter(struct lttng_event *event,
+		struct bytecode_runtime *runtime)
+{
+	struct lttng_filter_prefilter *prefilter = &runtime->prefilter_desc;
+	uint16_t pc = 0;
+
+	memset(prefilter, 0, sizeof(*prefilter));
+	while (prefilter->nr_terms < LTTNG_FILTER_PREFILTER_MAX_TERMS) {
+		struct lttng_filter_prefilter_term term;
+		struct logical_op *insn;
+		int field_idx;
+
+		if (prefilter_parse_term(runtime, &pc, &term))
+			break;
+		field_idx = lttng_filter_field_index(event->desc, term.offset);
+		if (field_idx < 0 || field_idx >= BITS_PER_LONG)
+			break;
+		pc = prefilter_skip_cast_nop(runtime, pc);
+		if (pc >= runtime->len)
+			break;
+		insn = (struct logical_op *) &runtime->data[pc];
+		if (insn->op == FILTER_OP_RETURN) {
+			prefilter->terms[prefilter->nr_terms++] = term;
+			prefilter->field_mask |= 1UL << field_idx;
+			prefilter->exact = 1;
+			break;
+		}
+		if (insn->op != FILTER_OP_AND
+				|| !prefilter_and_discards(runtime, insn))
+			break;
+		prefilter->terms[prefilter->nr_terms++] = term;
+		prefilter->field_mask |= 1UL << field_idx;
+		pc += sizeof(struct logical_op);
+	}
+	dbg_printk("Prefilter: %u terms, exact: %d\n",
+		prefilter->nr_terms, prefilter->exact);
+}
+
+/*
+ * Use native code when the bytecode has been JIT-compiled, interpreter
+ * otherwise.
+ */
+static
+void lttng_filter_set_runtime_func(struct bytecode_runtime *runtime)
+{
+	if (runtime->jit_code)
+		runtime->p.filter = runtime->jit_code;
+	else
+		runtime->p.filter = lttng_filter_interpret_bytecode;
+	if (runtime->prefilter_desc.nr_terms)
+		runtime->p.prefilter = &runtime->prefilter_desc;
+	else
+		runtime->p.prefilter = NULL;
+}
+
 /*
  * Take a bytecode with reloc table and link it to an event to create a
  * bytecode runtime.
@@ -369,7 +675,18 @@ int _lttng_filter_event_link_bytecode(struct lttng_event *event,
 		goto alloc_error;
 	}
 	runtime->p.bc = filter_bytecode;
+	runtime->desc = event->desc;
 	runtime->len = filter_bytecode->bc.reloc_offset;
+	if (!event->desc) {
+		ret = -EINVAL;
+		goto link_error;
+	}
+	/*
+	 * Filled by the validator with the fields used by the bytecode. If
+	 * it cannot be allocated, the probe prepares all fields.
+	 */
+	runtime->p.field_mask = kcalloc(BITS_TO_LONGS(event->desc->nr_fields),
+			sizeof(unsigned long), GFP_KERNEL);
 	/* copy original bytecode */
 	memcpy(runtime->data, filter_bytecode->bc.data, runtime->len);
 	/*
@@ -400,7 +717,19 @@ int _lttng_filter_event_link_bytecode(struct lttng_event *event,
 	if (ret) {
 		goto link_error;
 	}
-	runtime->p.filter = lttng_filter_interpret_bytecode;
+	/*
+	 * Try to compile to native code. Bytecode using instructions not
+	 * handled by the JIT stays on the interpreter.
+	 */
+	if (!lttng_filter_jit_compile(runtime))
+		dbg_printk("Bytecode JIT-compiled.\n");
+	lttng_filter_build_prefilter(event, runtime);
+	/* Streamline the bytecode left to the interpreter. */
+	if (!runtime->jit_code)
+		lttng_filter_optimize_bytecode(runtime);
+	lttng_filter_set_runtime_func(runtime);
+	runtime->p.early = lttng_filter_fields_early(event->desc,
+			runtime->p.field_mask);
 	runtime->p.link_failed = 0;
 	list_add_rcu(&runtime->p.node, insert_loc);
 	dbg_printk("Linking successful.\n");
@@ -419,17 +748,230 @@ void lttng_filter_sync_state(struct lttng_bytecode_runtime *runtime)
 {
 	struct lttng_filter_bytecode_node *bc = runtime->bc;
 
-	if (!bc->enabler->enabled || runtime->link_failed)
+	/* Bytecode attached to the event itself has no enabler. */
+	if ((bc->enabler && !bc->enabler->enabled) || runtime->link_failed) {
 		runtime->filter = lttng_filter_false;
+		runtime->prefilter = NULL;
+	} else {
+		lttng_filter_set_runtime_func(
+			container_of(runtime, struct bytecode_runtime, p));
+	}
+}
+
+/*
+ * Length of a specialized instruction, 0 if unknown.
+ */
+size_t lttng_filter_insn_len(const char *pc)
+{
+	switch (*(filter_opcode_t *) pc) {
+	case FILTER_OP_RETURN:
+		return sizeof(struct return_op);
+	case FILTER_OP_EQ_STRING:
+	case FILTER_OP_NE_STRING:
+	case FILTER_OP_GT_STRING:
+	case FILTER_OP_LT_STRING:
+	case FILTER_OP_GE_STRING:
+	case FILTER_OP_LE_STRING:
+	case FILTER_OP_EQ_STAR_GLOB_STRING:
+	case FILTER_OP_NE_STAR_GLOB_STRING:
+	case FILTER_OP_EQ_S64:
+	case FILTER_OP_NE_S64:
+	case FILTER_OP_GT_S64:
+	case FILTER_OP_LT_S64:
+	case FILTER_OP_GE_S64:
+	case FILTER_OP_LE_S64:
+		return sizeof(struct binary_op);
+	case FILTER_OP_UNARY_PLUS_S64:
+	case FILTER_OP_UNARY_MINUS_S64:
+	case FILTER_OP_UNARY_NOT_S64:
+		return sizeof(struct unary_op);
+	case FILTER_OP_AND:
+	case FILTER_OP_OR:
+		return sizeof(struct logical_op);
+	case FILTER_OP_LOAD_FIELD_REF_STRING:
+	case FILTER_OP_LOAD_FIELD_REF_SEQUENCE:
+	case FILTER_OP_LOAD_FIELD_REF_USER_STRING:
+	case FILTER_OP_LOAD_FIELD_REF_USER_SEQUENCE:
+	case FILTER_OP_LOAD_FIELD_REF_S64:
+	case FILTER_OP_GET_CONTEXT_REF_STRING:
+	case FILTER_OP_GET_CONTEXT_REF_S64:
+		return sizeof(struct load_op) + sizeof(struct field_ref);
+	case FILTER_OP_LOAD_STRING:
+	case FILTER_OP_LOAD_STAR_GLOB_STRING:
+	case FILTER_OP_LOAD_EXACT_STRING:
+	case FILTER_OP_LOAD_PREFIX_STAR_GLOB_STRING:
+		return sizeof(struct load_op)
+			+ strlen(((struct load_op *) pc)->data) + 1;
+	case FILTER_OP_LOAD_S64:
+		return sizeof(struct load_op) + sizeof(struct literal_numeric);
+	case FILTER_OP_CAST_NOP:
+		return sizeof(struct cast_op);
+	case FILTER_OP_IN_S64_SET:
+	case FILTER_OP_IN_STRING_SET:
+		return sizeof(struct set_op) + ((struct set_op *) pc)->len;
+	case FILTER_OP_FIELD_EQ_IMM_S64:
+	case FILTER_OP_FIELD_NE_IMM_S64:
+	case FILTER_OP_FIELD_GT_IMM_S64:
+	case FILTER_OP_FIELD_LT_IMM_S64:
+	case FILTER_OP_FIELD_GE_IMM_S64:
+	case FILTER_OP_FIELD_LE_IMM_S64:
+		return sizeof(struct field_cmp_imm_op);
+	case FILTER_OP_LOAD_FIELD_REF_INDEX_S64:
+		return sizeof(struct load_op) + sizeof(struct field_index_ref);
+	default:
+		return 0;
+	}
+}
+
+static
+void lttng_filter_free_fused(struct bytecode_runtime *fused)
+{
+	if (!fused)
+		return;
+	lttng_filter_jit_free(fused);
+	kfree(fused->p.field_mask);
+	kfree(fused->parts);
+	kfree(fused);
+}
+
+/*
+ * Concatenate the code of the parts, up to their RETURN, each followed
+ * by an OR jumping to the final RETURN when it accepts the event: the
+ * fused program records the event as soon as one part does, and reads
+ * each field once into the filter stack data.
+ */
+static
+struct bytecode_runtime *lttng_filter_fuse_parts(struct lttng_event *event,
+		struct bytecode_runtime **parts, unsigned int nr_parts)
+{
+	struct bytecode_runtime *fused;
+	size_t len = sizeof(struct return_op);
+	uint16_t base = 0;
+	unsigned int i;
+
+	for (i = 0; i < nr_parts; i++) {
+		len += parts[i]->return_pc;
+		if (i != nr_parts - 1)
+			len += sizeof(struct logical_op);
+	}
+	/* Skip offsets are 16-bit. */
+	if (len > USHRT_MAX)
+		return NULL;
+	fused = kzalloc(sizeof(*fused) + len, GFP_KERNEL);
+	if (!fused)
+		return NULL;
+	fused->desc = event->desc;
+	fused->len = len;
+	fused->parts = parts;
+	fused->nr_parts = nr_parts;
+	/* Filled by the validator. */
+	fused->p.field_mask = kcalloc(BITS_TO_LONGS(event->desc->nr_fields),
+			sizeof(unsigned long), GFP_KERNEL);
+	if (!fused->p.field_mask)
+		goto error;
+	for (i = 0; i < nr_parts; i++) {
+		struct bytecode_runtime *part = parts[i];
+		char *start_pc = &fused->data[base], *pc;
+
+		memcpy(start_pc, part->data, part->return_pc);
+		for (pc = start_pc; pc - start_pc < part->return_pc; ) {
+			size_t insn_len = lttng_filter_insn_len(pc);
+
+			if (!insn_len)
+				goto error;
+			if (*(filter_opcode_t *) pc == FILTER_OP_AND
+					|| *(filter_opcode_t *) pc == FILTER_OP_OR)
+				((struct logical_op *) pc)->skip_offset += base;
+			pc += insn_len;
+		}
+		base += part->return_pc;
+		if (i != nr_parts - 1) {
+			struct logical_op *or_insn =
+				(struct logical_op *) &fused->data[base];
+
+			or_insn->op = FILTER_OP_OR;
+			or_insn->skip_offset = len - sizeof(struct return_op);
+			base += sizeof(struct logical_op);
+		}
+	}
+	fused->data[base] = FILTER_OP_RETURN;
+	/* Parts leaving different stacks at their RETURN are not fused. */
+	if (lttng_filter_validate_bytecode(fused))
+		goto error;
+	fused->p.early = lttng_filter_fields_early(event->desc,
+			fused->p.field_mask);
+	if (!lttng_filter_jit_compile(fused))
+		dbg_printk("Fused bytecode JIT-compiled.\n");
 	else
-		runtime->filter = lttng_filter_interpret_bytecode;
+		lttng_filter_optimize_bytecode(fused);
+	lttng_filter_set_runtime_func(fused);
+	return fused;
+
+error:
+	fused->parts = NULL;
+	lttng_filter_free_fused(fused);
+	return NULL;
 }
 
 /*
- * Link bytecode for all enablers referenced by an event.
+ * Fuse the enabled runtimes of an event once their state is synced, so
+ * probes run a single program for all of them. Prefilters are not
+ * applied to fused runtimes. Should be called with sessions mutex held.
  */
-void lttng_enabler_event_link_bytecode(struct lttng_event *event,
-		struct lttng_enabler *enabler)
+void lttng_filter_event_fuse(struct lttng_event *event)
+{
+	struct bytecode_runtime *old = NULL, *fused = NULL;
+	struct bytecode_runtime **parts = NULL;
+	struct lttng_bytecode_runtime *runtime;
+	unsigned int nr_parts = 0, i;
+	int early = 1;
+
+	/* Probes check each runtime, this only spares them the early pass. */
+	list_for_each_entry(runtime, &event->bytecode_runtime_head, node)
+		early = early && runtime->early;
+	ACCESS_ONCE(event->filter_early) = early;
+	if (event->filter_fused)
+		old = container_of(event->filter_fused,
+				struct bytecode_runtime, p);
+	list_for_each_entry(runtime, &event->bytecode_runtime_head, node) {
+		if (runtime->filter != lttng_filter_false)
+			nr_parts++;
+	}
+	if (nr_parts < 2)
+		goto publish;
+	parts = kcalloc(nr_parts, sizeof(*parts), GFP_KERNEL);
+	if (!parts)
+		goto publish;
+	i = 0;
+	list_for_each_entry(runtime, &event->bytecode_runtime_head, node) {
+		if (runtime->filter != lttng_filter_false)
+			parts[i++] = container_of(runtime,
+					struct bytecode_runtime, p);
+	}
+	if (old && old->nr_parts == nr_parts
+			&& !memcmp(old->parts, parts, nr_parts * sizeof(*parts))) {
+		kfree(parts);
+		return;
+	}
+	fused = lttng_filter_fuse_parts(event, parts, nr_parts);
+	if (!fused)
+		kfree(parts);
+publish:
+	if (!old && !fused)
+		return;
+	rcu_assign_pointer(event->filter_fused, fused ? &fused->p : NULL);
+	if (old) {
+		synchronize_trace();	/* Wait for probes using it */
+		lttng_filter_free_fused(old);
+	}
+}
+
+/*
+ * Link each bytecode of a list of struct lttng_filter_bytecode_node to an
+ * event.
+ */
+void lttng_event_link_bytecode(struct lttng_event *event,
+		struct list_head *bytecode_head)
 {
 	struct lttng_filter_bytecode_node *bc;
 	struct lttng_bytecode_runtime *runtime;
@@ -438,7 +980,7 @@ void lttng_enabler_event_link_bytecode(struct lttng_event *event,
 	WARN_ON_ONCE(!event->desc);
 
 	/* Link each bytecode. */
-	list_for_each_entry(bc, &enabler->filter_bytecode_head, node) {
+	list_for_each_entry(bc, bytecode_head, node) {
 		int found = 0, ret;
 		struct list_head *insert_loc;
 
@@ -477,6 +1019,15 @@ void lttng_enabler_event_link_bytecode(struct lttng_event *event,
 	}
 }
 
+/*
+ * Link bytecode for all enablers referenced by an event.
+ */
+void lttng_enabler_event_link_bytecode(struct lttng_event *event,
+		struct lttng_enabler *enabler)
+{
+	lttng_event_link_bytecode(event, &enabler->filter_bytecode_head);
+}
+
 /*
  * We own the filter_bytecode if we return success.
  */
@@ -501,8 +1052,47 @@ void lttng_free_event_filter_runtime(struct lttng_event *event)
 {
 	struct bytecode_runtime *runtime, *tmp;
 
+	if (event->filter_fused) {
+		lttng_filter_free_fused(container_of(event->filter_fused,
+				struct bytecode_runtime, p));
+		event->filter_fused = NULL;
+	}
 	list_for_each_entry_safe(runtime, tmp,
 			&event->bytecode_runtime_head, p.node) {
+		lttng_filter_jit_free(runtime);
+		kfree(runtime->p.field_mask);
 		kfree(runtime);
 	}
 }
+
+static
+size_t lttng_filter_runtime_size(struct lttng_event *event,
+		struct bytecode_runtime *runtime)
+{
+	size_t size;
+
+	size = sizeof(*runtime) + runtime->len
+		+ runtime->nr_parts * sizeof(runtime->parts[0]);
+	if (runtime->p.field_mask)
+		size += BITS_TO_LONGS(event->desc->nr_fields)
+			* sizeof(unsigned long);
+	return size;
+}
+
+/*
+ * Bytes allocated for the filter runtimes of an event, native code of
+ * JIT-compiled bytecode excluded. Called with the sessions mutex held.
+ */
+size_t lttng_event_filter_runtime_size(struct lttng_event *event)
+{
+	struct bytecode_runtime *runtime;
+	size_t size = 0;
+
+	if (event->filter_fused)
+		size += lttng_filter_runtime_size(event,
+				container_of(event->filter_fused,
+					struct bytecode_runtime, p));
+	list_for_each_entry(runtime, &event->bytecode_runtime_head, p.node)
+		size += lttng_filter_runtime_size(event, runtime);
+	return size;
+}
@@ -33,7 +33,7 @@
 #include <filter-bytecode.h>
 
 /* Filter stack length, in number of entries */
-#define FILTER_STACK_LEN	10	/* includes 2 dummy */
+#define FILTER_STACK_LEN	18	/* includes 2 dummy */
 #define FILTER_STACK_EMPTY	1
 
 #ifdef DEBUG
@@ -53,6 +53,13 @@ do {								\
 /* Linked bytecode. Child of struct lttng_bytecode_runtime. */
 struct bytecode_runtime {
 	struct lttng_bytecode_runtime p;
+	void *jit_code;		/* native code, NULL if not JIT-compiled */
+	struct lttng_filter_prefilter prefilter_desc;
+	const struct lttng_event_desc *desc;	/* Event the bytecode is linked to. */
+	/* Runtimes fused into this one, NULL for linked bytecode. */
+	struct bytecode_runtime **parts;
+	unsigned int nr_parts;
+	uint16_t return_pc;	/* RETURN ending execution, set by the validator. */
 	uint16_t len;
 	char data[0];
 };
@@ -124,15 +131,19 @@ enum estack_string_literal_type {
 	ESTACK_STRING_LITERAL_TYPE_NONE,
 	ESTACK_STRING_LITERAL_TYPE_PLAIN,
 	ESTACK_STRING_LITERAL_TYPE_STAR_GLOB,
+	ESTACK_STRING_LITERAL_TYPE_PREFIX_STAR_GLOB,	/* "prefix*" */
 };
 
 struct estack_entry {
 	union {
 		int64_t v;
 
+		/* Kept small: the stack lives on the probe kernel stack. */
 		struct {
-			const char *str;
-			const char __user *user_str;
+			union {
+				const char *str;
+				const char __user *user_str;	/* if user */
+			};
 			size_t seq_len;
 			enum estack_string_literal_type literal_type;
 			int user;		/* is string from userspace ? */
@@ -178,8 +189,30 @@ struct estack {
 
 const char *lttng_filter_print_op(enum filter_op op);
 
+int lttng_filter_field_index(const struct lttng_event_desc *desc,
+		uint16_t field_offset);
+int lttng_filter_fields_early(const struct lttng_event_desc *desc,
+		const unsigned long *field_mask);
 int lttng_filter_validate_bytecode(struct bytecode_runtime *bytecode);
 int lttng_filter_specialize_bytecode(struct bytecode_runtime *bytecode);
+void lttng_filter_optimize_bytecode(struct bytecode_runtime *bytecode);
+size_t lttng_filter_insn_len(const char *pc);
+
+#ifdef CONFIG_X86_64
+int lttng_filter_jit_compile(struct bytecode_runtime *bytecode);
+void lttng_filter_jit_free(struct bytecode_runtime *bytecode);
+#else
+static inline
+int lttng_filter_jit_compile(struct bytecode_runtime *bytecode)
+{
+	return -ENOSYS;
+}
+
+static inline
+void lttng_filter_jit_free(struct bytecode_runtime *bytecode)
+{
+}
+#endif
 
 uint64_t lttng_filter_false(void *filter_data,
 		struct lttng_probe_ctx *lttng_probe_ctx,
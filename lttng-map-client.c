@@ -0,0 +1,408 @@
+/*
+ * lttng-map-client.c
+ *
+ * LTTng aggregation map client. Instead of serializing records into a
+ * ring buffer, events hitting a map channel are folded into per-CPU
+ * tables of counters or log2 histograms, keyed by event id and by a
+ * context field chosen at channel creation. Events declare their own
+ * aggregation key and value with ctf_agg_key() and ctf_agg_value().
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
+#include <linux/bitops.h>
+#include <linux/sched.h>
+#include <linux/uaccess.h>
+#include <asm/local64.h>
+#include <wrapper/vmalloc.h>	/* for wrapper_vmalloc_sync_all() */
+#include <wrapper/vzalloc.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <wrapper/ringbuffer/frontend_types.h>
+
+/* Maximum number of slots probed before giving up on an insertion. */
+#define LTTNG_MAP_MAX_PROBE	16
+
+struct lttng_map_slot {
+	u64 ident;			/* (event id + 1) << 32 | key, 0: free */
+	u64 last_ns;			/* Previous hit, for histograms */
+	local64_t count;
+	local64_t hist[];		/* LOG2_* buckets, COUNT_BYTES bytes, SUM or ALLOC values */
+};
+
+struct lttng_map_channel {
+	struct channel parent;		/* Must be first: ctx->chan */
+	struct lttng_kernel_map_attr attr;
+	unsigned int order;		/* log2 of the number of slots per CPU */
+	size_t slot_size;
+	size_t entry_size;		/* Size of an entry copied to user-space */
+	void **tables;			/* Per-CPU slot tables, nr_cpu_ids */
+};
+
+static
+struct lttng_map_slot *lttng_map_get_slot(struct lttng_map_channel *map,
+		int cpu, unsigned long idx)
+{
+	return (struct lttng_map_slot *)
+		((char *) map->tables[cpu] + idx * map->slot_size);
+}
+
+/*
+ * Find or claim the slot for an identifier in the current CPU table.
+ * Nested hits from interrupt context may claim slots concurrently, hence
+ * the local cmpxchg. Returns NULL if the table is too crowded.
+ */
+static
+struct lttng_map_slot *lttng_map_lookup(struct lttng_map_channel *map,
+		int cpu, u64 ident)
+{
+	unsigned long mask = (1UL << map->order) - 1;
+	unsigned long idx = hash_64(ident, map->order);
+	unsigned int i;
+
+	for (i = 0; i < min_t(unsigned long, LTTNG_MAP_MAX_PROBE, mask + 1);
+			i++, idx = (idx + 1) & mask) {
+		struct lttng_map_slot *slot = lttng_map_get_slot(map, cpu, idx);
+		u64 old = ACCESS_ONCE(slot->ident);
+
+		if (old == ident)
+			return slot;
+		if (old)
+			continue;
+		old = cmpxchg64_local(&slot->ident, 0, ident);
+		if (!old || old == ident)
+			return slot;
+	}
+	return NULL;
+}
+
+static
+struct channel *_channel_create(const char *name,
+				struct lttng_channel *lttng_chan, void *buf_addr,
+				size_t subbuf_size, size_t num_subbuf,
+				unsigned int switch_timer_interval,
+				unsigned int read_timer_interval)
+{
+	struct lttng_kernel_map_attr *attr = buf_addr;
+	struct lttng_map_channel *map;
+	unsigned long nr_slots;
+	size_t nr_hist = 0;
+	int cpu;
+
+	if (!attr)
+		return NULL;
+	switch (attr->key) {
+	case LTTNG_KERNEL_MAP_KEY_NONE:
+	case LTTNG_KERNEL_MAP_KEY_TID:
+	case LTTNG_KERNEL_MAP_KEY_CPU:
+	case LTTNG_KERNEL_MAP_KEY_FLOW:
+	case LTTNG_KERNEL_MAP_KEY_CALL_SITE:
+	case LTTNG_KERNEL_MAP_KEY_DURATION:
+	case LTTNG_KERNEL_MAP_KEY_AGG:
+		break;
+	default:
+		return NULL;
+	}
+	switch (attr->value) {
+	case LTTNG_KERNEL_MAP_VALUE_COUNT:
+		break;
+	case LTTNG_KERNEL_MAP_VALUE_LOG2_HIST:
+	case LTTNG_KERNEL_MAP_VALUE_LOG2_DURATION:
+	case LTTNG_KERNEL_MAP_VALUE_LOG2_AGG:
+		nr_hist = LTTNG_KERNEL_MAP_HIST_BUCKETS;
+		break;
+	case LTTNG_KERNEL_MAP_VALUE_COUNT_BYTES:
+	case LTTNG_KERNEL_MAP_VALUE_SUM:
+		nr_hist = 1;
+		break;
+	case LTTNG_KERNEL_MAP_VALUE_ALLOC:
+		nr_hist = LTTNG_KERNEL_MAP_ALLOC_VALUES;
+		break;
+	default:
+		return NULL;
+	}
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map)
+		return NULL;
+	map->attr = *attr;
+	map->slot_size = sizeof(struct lttng_map_slot)
+			+ nr_hist * sizeof(local64_t);
+	map->entry_size = sizeof(struct lttng_kernel_map_entry)
+			+ nr_hist * sizeof(uint64_t);
+	/* The sub-buffer geometry is the per-CPU memory budget. */
+	nr_slots = (subbuf_size * num_subbuf) / map->slot_size;
+	if (nr_slots < 2)
+		goto error;
+	map->order = ilog2(nr_slots);
+	map->tables = kcalloc(nr_cpu_ids, sizeof(*map->tables), GFP_KERNEL);
+	if (!map->tables)
+		goto error;
+	for_each_possible_cpu(cpu) {
+		map->tables[cpu] = lttng_vzalloc(map->slot_size << map->order);
+		if (!map->tables[cpu])
+			goto error_free_tables;
+	}
+	/* Tables are touched from probes, which cannot take vmalloc faults. */
+	wrapper_vmalloc_sync_all();
+	map->parent.backend.priv = lttng_chan;
+	init_waitqueue_head(&map->parent.hp_wait);
+	return &map->parent;
+
+error_free_tables:
+	for_each_possible_cpu(cpu)
+		vfree(map->tables[cpu]);
+	kfree(map->tables);
+error:
+	kfree(map);
+	return NULL;
+}
+
+static
+void lttng_channel_destroy(struct channel *chan)
+{
+	struct lttng_map_channel *map =
+		container_of(chan, struct lttng_map_channel, parent);
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		vfree(map->tables[cpu]);
+	kfree(map->tables);
+	kfree(map);
+}
+
+/*
+ * Records are folded into the map at reservation time. A negative return
+ * value tells the probe it has nothing to serialize.
+ */
+static
+int lttng_event_reserve(struct lib_ring_buffer_ctx *ctx,
+		      uint32_t event_id)
+{
+	struct lttng_map_channel *map =
+		container_of(ctx->chan, struct lttng_map_channel, parent);
+	struct lttng_probe_ctx *lttng_probe_ctx = ctx->priv;
+	struct lttng_map_slot *slot;
+	uint32_t key;
+	u64 ident;
+	int cpu;
+
+	cpu = get_cpu();
+	switch (map->attr.key) {
+	case LTTNG_KERNEL_MAP_KEY_TID:
+		key = task_pid_nr(current);
+		break;
+	case LTTNG_KERNEL_MAP_KEY_CPU:
+		key = cpu;
+		break;
+	case LTTNG_KERNEL_MAP_KEY_FLOW:
+		/* 0 for events without a flow key. */
+		key = lttng_probe_ctx->flow_hash;
+		break;
+	case LTTNG_KERNEL_MAP_KEY_CALL_SITE:
+		/* 0 for events without an allocation site. */
+		key = (uint32_t) lttng_probe_ctx->alloc_site;
+		break;
+	case LTTNG_KERNEL_MAP_KEY_DURATION:
+		/* 0 for events without a duration. */
+		key = lttng_probe_ctx->duration_key;
+		break;
+	case LTTNG_KERNEL_MAP_KEY_AGG:
+		/* 0 for events without an aggregation key. */
+		key = lttng_probe_ctx->agg_key;
+		break;
+	case LTTNG_KERNEL_MAP_KEY_NONE:
+	default:
+		key = 0;
+		break;
+	}
+	ident = ((u64) (event_id + 1) << 32) | key;
+	slot = lttng_map_lookup(map, cpu, ident);
+	if (unlikely(!slot))
+		goto end;
+	local64_inc(&slot->count);
+	if (map->attr.value == LTTNG_KERNEL_MAP_VALUE_COUNT_BYTES) {
+		local64_add(lttng_probe_ctx->flow_bytes, &slot->hist[0]);
+	} else if (map->attr.value == LTTNG_KERNEL_MAP_VALUE_SUM) {
+		local64_add(lttng_probe_ctx->agg_value, &slot->hist[0]);
+	} else if (map->attr.value == LTTNG_KERNEL_MAP_VALUE_ALLOC) {
+		switch (lttng_probe_ctx->alloc_op) {
+		case LTTNG_ALLOC_OP_ALLOC:
+			local64_add(lttng_probe_ctx->alloc_bytes_req,
+				&slot->hist[0]);
+			local64_add(lttng_probe_ctx->alloc_bytes,
+				&slot->hist[1]);
+			local64_inc(&slot->hist[2]);
+			break;
+		case LTTNG_ALLOC_OP_FREE:
+			local64_inc(&slot->hist[3]);
+			break;
+		}
+	} else if (map->attr.value == LTTNG_KERNEL_MAP_VALUE_LOG2_HIST) {
+		u64 now = local_clock(), last = slot->last_ns;
+
+		slot->last_ns = now;
+		if (last)
+			local64_inc(&slot->hist[min_t(unsigned int,
+				fls64(now - last),
+				LTTNG_KERNEL_MAP_HIST_BUCKETS - 1)]);
+	} else if (map->attr.value == LTTNG_KERNEL_MAP_VALUE_LOG2_DURATION) {
+		local64_inc(&slot->hist[min_t(unsigned int,
+			fls64(lttng_probe_ctx->duration),
+			LTTNG_KERNEL_MAP_HIST_BUCKETS - 1)]);
+	} else if (map->attr.value == LTTNG_KERNEL_MAP_VALUE_LOG2_AGG) {
+		local64_inc(&slot->hist[min_t(unsigned int,
+			fls64(lttng_probe_ctx->agg_value),
+			LTTNG_KERNEL_MAP_HIST_BUCKETS - 1)]);
+	}
+end:
+	put_cpu();
+	return -ENOSPC;
+}
+
+static
+void lttng_event_commit(struct lib_ring_buffer_ctx *ctx)
+{
+	WARN_ON_ONCE(1);
+}
+
+/*
+ * The file position is a slot cursor across all per-CPU tables. Only
+ * complete entries are copied. Readers rewind to offset 0 to take a new
+ * snapshot of the map.
+ */
+static
+ssize_t lttng_map_read(struct channel *chan, char __user *user_buf,
+		size_t count, loff_t *ppos)
+{
+	struct lttng_map_channel *map =
+		container_of(chan, struct lttng_map_channel, parent);
+	loff_t pos = *ppos, end = (loff_t) nr_cpu_ids << map->order;
+	ssize_t copied = 0;
+
+	for (; pos < end; pos++) {
+		int cpu = pos >> map->order;
+		struct lttng_map_slot *slot;
+		struct lttng_kernel_map_entry entry;
+		char __user *hist_buf;
+		u64 ident;
+		int i;
+
+		if (!cpu_possible(cpu)) {
+			pos = ((loff_t) (cpu + 1) << map->order) - 1;
+			continue;
+		}
+		slot = lttng_map_get_slot(map, cpu,
+				pos & ((1UL << map->order) - 1));
+		ident = ACCESS_ONCE(slot->ident);
+		if (!ident)
+			continue;
+		if (count - copied < map->entry_size)
+			break;
+		memset(&entry, 0, sizeof(entry));
+		entry.cpu = cpu;
+		entry.event_id = (ident >> 32) - 1;
+		entry.key = (uint32_t) ident;
+		entry.count = local64_read(&slot->count);
+		if (copy_to_user(user_buf + copied, &entry, sizeof(entry)))
+			return -EFAULT;
+		hist_buf = user_buf + copied + sizeof(entry);
+		for (i = 0; i < (map->entry_size - sizeof(entry))
+				/ sizeof(uint64_t); i++) {
+			uint64_t v = local64_read(&slot->hist[i]);
+
+			if (copy_to_user(hist_buf + i * sizeof(v), &v,
+					sizeof(v)))
+				return -EFAULT;
+		}
+		copied += map->entry_size;
+	}
+	if (!copied && pos < end)
+		return -EINVAL;	/* Buffer too small for a single entry */
+	*ppos = pos;
+	return copied;
+}
+
+static
+wait_queue_head_t *lttng_get_hp_wait_queue(struct channel *chan)
+{
+	return &chan->hp_wait;
+}
+
+static
+int lttng_buffer_has_read_closed_stream(struct channel *chan)
+{
+	return 0;
+}
+
+static
+int lttng_is_finalized(struct channel *chan)
+{
+	return 0;
+}
+
+static
+int lttng_is_disabled(struct channel *chan)
+{
+	return 0;
+}
+
+static struct lttng_transport lttng_map_transport = {
+	.name = "map",
+	.owner = THIS_MODULE,
+	.ops = {
+		.channel_create = _channel_create,
+		.channel_destroy = lttng_channel_destroy,
+		.buffer_has_read_closed_stream =
+			lttng_buffer_has_read_closed_stream,
+		.event_reserve = lttng_event_reserve,
+		.event_commit = lttng_event_commit,
+		.map_read = lttng_map_read,
+		.get_hp_wait_queue = lttng_get_hp_wait_queue,
+		.is_finalized = lttng_is_finalized,
+		.is_disabled = lttng_is_disabled,
+	},
+};
+
+static int __init lttng_map_client_init(void)
+{
+	wrapper_vmalloc_sync_all();
+	lttng_transport_register(&lttng_map_transport);
+	return 0;
+}
+
+module_init(lttng_map_client_init);
+
+static void __exit lttng_map_client_exit(void)
+{
+	lttng_transport_unregister(&lttng_map_transport);
+}
+
+module_exit(lttng_map_client_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng aggregation map client");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,428 @@
+/*
+ * lttng-perf-sample.c
+ *
+ * LTTng perf sampling events. Each event owns a per-CPU kernel perf
+ * counter whose overflow handler records the interrupted instruction
+ * pointer and task, along with the contexts of the event and of its
+ * channel, e.g. callstack.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/perf_event.h>
+#include <linux/ptrace.h>
+#include <linux/sched.h>
+#include <linux/cpu.h>
+#include <lttng-events.h>
+#include <wrapper/ringbuffer/frontend_types.h>
+#include <wrapper/vmalloc.h>
+#include <wrapper/perf.h>
+#include <lttng-tracer.h>
+
+/*
+ * Kept apart from struct lttng_event because cpu hotplug needs
+ * fixed-location addresses.
+ */
+struct lttng_perf_sample {
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0))
+	struct lttng_cpuhp_node cpuhp_prepare;
+	struct lttng_cpuhp_node cpuhp_online;
+#else
+	struct notifier_block nb;
+	int hp_enable;
+#endif
+	struct lttng_event *event;
+	struct perf_event_attr attr;
+	struct perf_event **e;	/* per-cpu array */
+	int armed;		/* Counters enabled, protected by cpu hotplug */
+};
+
+/* Record payload, laid out as the fields of the event description. */
+struct lttng_perf_sample_payload {
+	unsigned long ip;
+	int32_t pid;
+	int32_t tid;
+};
+
+/* Runs from NMI context for hardware counters. */
+static
+void lttng_perf_sample_handler(struct perf_event *pevent,
+		struct perf_sample_data *data,
+		struct pt_regs *regs)
+{
+	struct lttng_event *event = pevent->overflow_handler_context;
+	struct lttng_probe_ctx lttng_probe_ctx = {
+		.event = event,
+	};
+	struct lttng_channel *chan = event->chan;
+	struct lttng_perf_sample_payload payload;
+	struct lib_ring_buffer_ctx ctx;
+	/* ip, pid, tid. */
+	uint64_t filter_stack_data[3];
+	int ret;
+
+	if (unlikely(!ACCESS_ONCE(event->effective_enabled)))
+		return;
+	memset(&payload, 0, sizeof(payload));
+	payload.ip = regs ? instruction_pointer(regs) : 0;
+	payload.pid = task_tgid_nr(current);
+	payload.tid = task_pid_nr(current);
+	filter_stack_data[0] = payload.ip;
+	filter_stack_data[1] = (int64_t) payload.pid;
+	filter_stack_data[2] = (int64_t) payload.tid;
+	if (!lttng_event_probe_check(event, &lttng_probe_ctx,
+			(const char *) filter_stack_data))
+		return;
+
+	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx,
+			sizeof(payload), lttng_alignof(payload), -1);
+	ret = chan->ops->event_reserve(&ctx, event->id);
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(event, ret);
+		return;
+	}
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(payload));
+	chan->ops->event_write(&ctx, &payload, sizeof(payload));
+	chan->ops->event_commit(&ctx);
+}
+
+/* Counters of CPUs coming online follow the arming of the event. */
+static
+int lttng_perf_sample_create_counter(struct lttng_perf_sample *sample,
+		int cpu)
+{
+	struct perf_event *pevent;
+
+	sample->attr.disabled = !sample->armed;
+	pevent = wrapper_perf_event_create_sampler(&sample->attr, cpu,
+			lttng_perf_sample_handler, sample->event);
+	if (!pevent || IS_ERR(pevent))
+		return -EINVAL;
+	if (pevent->state == PERF_EVENT_STATE_ERROR) {
+		perf_event_release_kernel(pevent);
+		return -EBUSY;
+	}
+	barrier();	/* Create perf counter before setting event */
+	sample->e[cpu] = pevent;
+	return 0;
+}
+
+static
+void lttng_perf_sample_release_counter(struct lttng_perf_sample *sample,
+		int cpu)
+{
+	struct perf_event *pevent;
+
+	pevent = sample->e[cpu];
+	if (!pevent)
+		return;
+	sample->e[cpu] = NULL;
+	barrier();	/* NULLify event before perf counter teardown */
+	perf_event_release_kernel(pevent);
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0))
+
+int lttng_cpuhp_perf_sample_online(unsigned int cpu,
+		struct lttng_cpuhp_node *node)
+{
+	struct lttng_perf_sample *sample =
+		container_of(node, struct lttng_perf_sample, cpuhp_online);
+
+	return lttng_perf_sample_create_counter(sample, cpu);
+}
+
+int lttng_cpuhp_perf_sample_dead(unsigned int cpu,
+		struct lttng_cpuhp_node *node)
+{
+	struct lttng_perf_sample *sample =
+		container_of(node, struct lttng_perf_sample, cpuhp_prepare);
+
+	lttng_perf_sample_release_counter(sample, cpu);
+	return 0;
+}
+
+static
+int lttng_perf_sample_start(struct lttng_perf_sample *sample)
+{
+	int ret;
+
+	sample->cpuhp_prepare.component = LTTNG_PERF_SAMPLE;
+	ret = cpuhp_state_add_instance(lttng_hp_prepare,
+		&sample->cpuhp_prepare.node);
+	if (ret)
+		return ret;
+	sample->cpuhp_online.component = LTTNG_PERF_SAMPLE;
+	ret = cpuhp_state_add_instance(lttng_hp_online,
+		&sample->cpuhp_online.node);
+	if (ret) {
+		int remove_ret;
+
+		remove_ret = cpuhp_state_remove_instance(lttng_hp_prepare,
+				&sample->cpuhp_prepare.node);
+		WARN_ON(remove_ret);
+	}
+	return ret;
+}
+
+static
+void lttng_perf_sample_stop(struct lttng_perf_sample *sample)
+{
+	int ret;
+
+	ret = cpuhp_state_remove_instance(lttng_hp_online,
+		&sample->cpuhp_online.node);
+	WARN_ON(ret);
+	ret = cpuhp_state_remove_instance(lttng_hp_prepare,
+		&sample->cpuhp_prepare.node);
+	WARN_ON(ret);
+}
+
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)) */
+
+#ifdef CONFIG_HOTPLUG_CPU
+
+static
+int lttng_perf_sample_cpu_hp_callback(struct notifier_block *nb,
+		unsigned long action, void *hcpu)
+{
+	unsigned int cpu = (unsigned long) hcpu;
+	struct lttng_perf_sample *sample =
+		container_of(nb, struct lttng_perf_sample, nb);
+
+	if (!sample->hp_enable)
+		return NOTIFY_OK;
+
+	switch (action) {
+	case CPU_ONLINE:
+	case CPU_ONLINE_FROZEN:
+		if (lttng_perf_sample_create_counter(sample, cpu))
+			return NOTIFY_BAD;
+		break;
+	case CPU_UP_CANCELED:
+	case CPU_UP_CANCELED_FROZEN:
+	case CPU_DEAD:
+	case CPU_DEAD_FROZEN:
+		lttng_perf_sample_release_counter(sample, cpu);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+#endif
+
+static
+void lttng_perf_sample_stop(struct lttng_perf_sample *sample)
+{
+	int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		lttng_perf_sample_release_counter(sample, cpu);
+	sample->hp_enable = 0;
+	put_online_cpus();
+#ifdef CONFIG_HOTPLUG_CPU
+	unregister_cpu_notifier(&sample->nb);
+#endif
+}
+
+static
+int lttng_perf_sample_start(struct lttng_perf_sample *sample)
+{
+	int cpu, ret = 0;
+
+#ifdef CONFIG_HOTPLUG_CPU
+	sample->nb.notifier_call = lttng_perf_sample_cpu_hp_callback;
+	sample->nb.priority = 0;
+	register_cpu_notifier(&sample->nb);
+#endif
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		ret = lttng_perf_sample_create_counter(sample, cpu);
+		if (ret)
+			break;
+	}
+	sample->hp_enable = 1;
+	put_online_cpus();
+	if (ret)
+		lttng_perf_sample_stop(sample);
+	return ret;
+}
+
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)) */
+
+static
+void lttng_perf_sample_field_integer(struct lttng_event_field *field,
+		const char *name, size_t size, size_t align, int signedness,
+		int base)
+{
+	field->name = name;
+	field->type.atype = atype_integer;
+	field->type.u.basic.integer.size = size * CHAR_BIT;
+	field->type.u.basic.integer.alignment = align * CHAR_BIT;
+	field->type.u.basic.integer.signedness = signedness;
+	field->type.u.basic.integer.reverse_byte_order = 0;
+	field->type.u.basic.integer.base = base;
+	field->type.u.basic.integer.encoding = lttng_encode_none;
+}
+
+/*
+ * Create event description
+ */
+static
+int lttng_create_perf_sample_event(const char *name,
+		struct lttng_event *event)
+{
+	struct lttng_event_field *fields;
+	struct lttng_event_desc *desc;
+	int ret;
+
+	desc = kzalloc(sizeof(*event->desc), GFP_KERNEL);
+	if (!desc)
+		return -ENOMEM;
+	desc->name = kstrdup(name, GFP_KERNEL);
+	if (!desc->name) {
+		ret = -ENOMEM;
+		goto error_str;
+	}
+	desc->nr_fields = 3;
+	desc->fields = fields =
+		kzalloc(desc->nr_fields * sizeof(struct lttng_event_field),
+			GFP_KERNEL);
+	if (!fields) {
+		ret = -ENOMEM;
+		goto error_field;
+	}
+	lttng_perf_sample_field_integer(&fields[0], "ip",
+		sizeof(unsigned long), lttng_alignof(unsigned long),
+		lttng_is_signed_type(unsigned long), 16);
+	lttng_perf_sample_field_integer(&fields[1], "pid",
+		sizeof(int32_t), lttng_alignof(int32_t), 1, 10);
+	lttng_perf_sample_field_integer(&fields[2], "tid",
+		sizeof(int32_t), lttng_alignof(int32_t), 1, 10);
+	desc->owner = THIS_MODULE;
+	event->desc = desc;
+
+	return 0;
+
+error_field:
+	kfree(desc->name);
+error_str:
+	kfree(desc);
+	return ret;
+}
+
+int lttng_perf_sample_register(const char *name,
+		const struct lttng_kernel_perf_sample *param,
+		struct lttng_event *event)
+{
+	struct lttng_perf_sample *sample;
+	int ret;
+
+	if (!param->period
+			|| (param->flags & ~LTTNG_KERNEL_PERF_SAMPLE_FLAG_FREQ))
+		return -EINVAL;
+	sample = kzalloc(sizeof(*sample), GFP_KERNEL);
+	if (!sample)
+		return -ENOMEM;
+	sample->e = kzalloc(num_possible_cpus() * sizeof(*sample->e),
+			GFP_KERNEL);
+	if (!sample->e) {
+		ret = -ENOMEM;
+		goto error_events;
+	}
+	sample->event = event;
+	sample->attr.type = param->type;
+	sample->attr.config = param->config;
+	sample->attr.size = sizeof(struct perf_event_attr);
+	if (param->flags & LTTNG_KERNEL_PERF_SAMPLE_FLAG_FREQ) {
+		sample->attr.freq = 1;
+		sample->attr.sample_freq = param->period;
+	} else {
+		sample->attr.sample_period = param->period;
+	}
+	sample->attr.pinned = 1;
+	ret = lttng_create_perf_sample_event(name, event);
+	if (ret)
+		goto error_desc;
+	event->u.perf_sample.sample = sample;
+
+	/* The overflow handler must not trigger page faults. */
+	wrapper_vmalloc_sync_all();
+
+	/* Enabled by lttng_perf_sample_event_arm() once the event is. */
+	ret = lttng_perf_sample_start(sample);
+	if (ret)
+		goto error_start;
+	return 0;
+
+error_start:
+	event->u.perf_sample.sample = NULL;
+	kfree(event->desc->fields);
+	kfree(event->desc->name);
+	kfree(event->desc);
+error_desc:
+	kfree(sample->e);
+error_events:
+	kfree(sample);
+	return ret;
+}
+
+void lttng_perf_sample_unregister(struct lttng_event *event)
+{
+	lttng_perf_sample_stop(event->u.perf_sample.sample);
+}
+
+/*
+ * Only keep the counters running while the event can record, so that
+ * disabled events and stopped sessions do not take overflow interrupts.
+ * Should be called with sessions lock held, after any change of the
+ * event effective enable state.
+ */
+int lttng_perf_sample_event_arm(struct lttng_event *event)
+{
+	struct lttng_perf_sample *sample = event->u.perf_sample.sample;
+	int cpu;
+
+	get_online_cpus();
+	if (sample->armed != event->effective_enabled) {
+		sample->armed = event->effective_enabled;
+		for_each_online_cpu(cpu) {
+			if (!sample->e[cpu])
+				continue;
+			if (sample->armed)
+				perf_event_enable(sample->e[cpu]);
+			else
+				perf_event_disable(sample->e[cpu]);
+		}
+	}
+	put_online_cpus();
+	return 0;
+}
+
+void lttng_perf_sample_destroy_private(struct lttng_event *event)
+{
+	struct lttng_perf_sample *sample = event->u.perf_sample.sample;
+
+	kfree(event->desc->fields);
+	kfree(event->desc->name);
+	kfree(event->desc);
+	kfree(sample->e);
+	kfree(sample);
+}
@@ -24,7 +24,12 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/sort.h>
 
+#include <wrapper/list.h>
 #include <lttng-events.h>
 
 /*
@@ -44,9 +49,38 @@ static LIST_HEAD(lazy_probe_init);
  */
 static int lazy_nesting;
 
-DEFINE_PER_CPU(struct lttng_dynamic_len_stack, lttng_dynamic_len_stack);
+/*
+ * Payload metadata of the events of registered probes, keyed by event
+ * description. Rendered the first time the event is dumped in a session
+ * metadata, so registering a probe only indexes its event names.
+ * Protected by the sessions lock.
+ */
+#define LTTNG_EVENT_METADATA_HT_BITS	8
+
+struct lttng_event_metadata {
+	struct hlist_node hlist;
+	const struct lttng_event_desc *desc;
+	struct lttng_metadata_shared *shared;
+};
+
+static struct hlist_head event_metadata_ht[1 << LTTNG_EVENT_METADATA_HT_BITS];
+
+/*
+ * Registered providers and events hashed by name, and event descriptions
+ * of registered providers sorted by name, so enablers can look up the
+ * range of events matching a name prefix. Protected by the sessions lock.
+ */
+#define LTTNG_PROVIDER_HT_BITS		6
+#define LTTNG_EVENT_NAME_HT_BITS	10
+
+static struct hlist_head provider_ht[1 << LTTNG_PROVIDER_HT_BITS];
+static struct hlist_head event_name_ht[1 << LTTNG_EVENT_NAME_HT_BITS];
 
-EXPORT_PER_CPU_SYMBOL_GPL(lttng_dynamic_len_stack);
+static const struct lttng_event_desc **sorted_event_desc;
+static unsigned int nr_sorted_event_desc, sorted_event_desc_alloc;
+
+static
+const struct lttng_event_desc *find_event(const char *name);
 
 /*
  * Called under sessions lock.
@@ -76,14 +110,215 @@ int check_event_provider(struct lttng_probe_desc *desc)
 	return 1;
 }
 
+static
+struct hlist_head *event_metadata_bucket(const struct lttng_event_desc *desc)
+{
+	return &event_metadata_ht[hash_ptr(desc, LTTNG_EVENT_METADATA_HT_BITS)];
+}
+
+/*
+ * Failure to render only means the metadata is rendered at each event
+ * statedump instead.
+ * Called under sessions lock.
+ */
+static
+struct lttng_event_metadata *event_metadata_cache(
+		const struct lttng_event_desc *desc)
+{
+	struct lttng_metadata_fragment frag = { 0 };
+	struct lttng_event_metadata *em;
+
+	em = kzalloc(sizeof(*em), GFP_KERNEL);
+	if (!em)
+		return NULL;
+	/* Sessions declare the enumerations before using the text. */
+	frag.enum_ref = 1;
+	if (!lttng_event_desc_metadata_render(desc, &frag))
+		em->shared = lttng_metadata_shared_create(&frag);
+	lttng_metadata_fragment_free(&frag);
+	if (!em->shared) {
+		kfree(em);
+		return NULL;
+	}
+	em->desc = desc;
+	hlist_add_head(&em->hlist, event_metadata_bucket(desc));
+	return em;
+}
+
+/*
+ * Called under sessions lock.
+ */
+static
+void event_metadata_uncache(const struct lttng_event_desc *desc)
+{
+	struct lttng_event_metadata *em;
+	struct hlist_node *tmp;
+
+	lttng_hlist_for_each_entry_safe(em, tmp,
+			event_metadata_bucket(desc), hlist) {
+		if (em->desc != desc)
+			continue;
+		hlist_del(&em->hlist);
+		/* Session metadata caches may still reference the text. */
+		lttng_metadata_shared_put(em->shared);
+		kfree(em);
+		return;
+	}
+}
+
+/*
+ * Only the descriptions of registered probes are cached: the others,
+ * e.g. kprobes, may be freed without notice. The text is shared by the
+ * metadata caches of all sessions, which take their own reference.
+ * Called under sessions lock.
+ */
+struct lttng_metadata_shared *
+	lttng_event_desc_metadata_get(const struct lttng_event_desc *desc)
+{
+	struct lttng_event_metadata *em;
+
+	lttng_hlist_for_each_entry(em, event_metadata_bucket(desc), hlist) {
+		if (em->desc == desc)
+			return em->shared;
+	}
+	if (find_event(desc->name) != desc)
+		return NULL;
+	em = event_metadata_cache(desc);
+	return em ? em->shared : NULL;
+}
+
+static
+struct hlist_head *name_bucket(struct hlist_head *ht, unsigned int bits,
+		const char *name)
+{
+	return &ht[jhash(name, strlen(name), 0) & ((1U << bits) - 1)];
+}
+
+static
+int event_desc_name_cmp(const void *a, const void *b)
+{
+	const struct lttng_event_desc *desc_a =
+		*(const struct lttng_event_desc **) a;
+	const struct lttng_event_desc *desc_b =
+		*(const struct lttng_event_desc **) b;
+
+	return strcmp(desc_a->name, desc_b->name);
+}
+
+/*
+ * The sorted array is sorted by the caller, once for all the probes
+ * being registered.
+ * Called under sessions lock.
+ */
+static
+int event_index_add(struct lttng_probe_desc *desc)
+{
+	unsigned int i, nr = nr_sorted_event_desc + desc->nr_events;
+
+	if (nr > sorted_event_desc_alloc) {
+		unsigned int alloc = max_t(unsigned int, nr,
+				sorted_event_desc_alloc << 1);
+		const struct lttng_event_desc **array;
+
+		array = krealloc(sorted_event_desc, alloc * sizeof(*array),
+				GFP_KERNEL);
+		if (!array)
+			return -ENOMEM;
+		sorted_event_desc = array;
+		sorted_event_desc_alloc = alloc;
+	}
+	desc->event_nodes = kcalloc(desc->nr_events,
+			sizeof(*desc->event_nodes), GFP_KERNEL);
+	if (!desc->event_nodes && desc->nr_events)
+		return -ENOMEM;
+	for (i = 0; i < desc->nr_events; i++) {
+		const struct lttng_event_desc *event_desc = desc->event_desc[i];
+
+		desc->event_nodes[i].desc = event_desc;
+		hlist_add_head(&desc->event_nodes[i].hlist,
+			name_bucket(event_name_ht, LTTNG_EVENT_NAME_HT_BITS,
+				event_desc->name));
+		sorted_event_desc[nr_sorted_event_desc++] = event_desc;
+	}
+	hlist_add_head(&desc->provider_hlist,
+		name_bucket(provider_ht, LTTNG_PROVIDER_HT_BITS,
+			desc->provider));
+	return 0;
+}
+
+/*
+ * Called under sessions lock.
+ */
+static
+void event_index_remove(struct lttng_probe_desc *desc)
+{
+	unsigned int i, j;
+
+	hlist_del(&desc->provider_hlist);
+	for (i = 0; i < desc->nr_events; i++)
+		hlist_del(&desc->event_nodes[i].hlist);
+	kfree(desc->event_nodes);
+	desc->event_nodes = NULL;
+	/* Compact the sorted array, which keeps it sorted. */
+	for (i = 0, j = 0; i < nr_sorted_event_desc; i++) {
+		const struct lttng_event_desc *event_desc = sorted_event_desc[i];
+		unsigned int k;
+
+		for (k = 0; k < desc->nr_events; k++) {
+			if (desc->event_desc[k] == event_desc)
+				break;
+		}
+		if (k == desc->nr_events)
+			sorted_event_desc[j++] = event_desc;
+	}
+	nr_sorted_event_desc = j;
+}
+
+/*
+ * Return the registered event descriptions whose name starts with
+ * "prefix", sorted by name, and set "nr" to their number.
+ * Called under sessions lock, after lttng_get_probe_list_head().
+ */
+const struct lttng_event_desc **lttng_event_desc_range(const char *prefix,
+		size_t prefix_len, unsigned int *nr)
+{
+	unsigned int low = 0, high = nr_sorted_event_desc, first;
+
+	/* First name not smaller than the prefix. */
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+
+		if (strncmp(sorted_event_desc[mid]->name, prefix,
+				prefix_len) < 0)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	first = low;
+	high = nr_sorted_event_desc;
+	/* First name past the prefix. */
+	while (low < high) {
+		unsigned int mid = low + (high - low) / 2;
+
+		if (!strncmp(sorted_event_desc[mid]->name, prefix,
+				prefix_len))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	*nr = low - first;
+	return sorted_event_desc + first;
+}
+
 /*
  * Called under sessions lock.
  */
 static
-void lttng_lazy_probe_register(struct lttng_probe_desc *desc)
+int lttng_lazy_probe_register(struct lttng_probe_desc *desc)
 {
 	struct lttng_probe_desc *iter;
 	struct list_head *probe_list;
+	int ret;
 
 	/*
 	 * Each provider enforce that every event name begins with the
@@ -99,6 +334,10 @@ void lttng_lazy_probe_register(struct lttng_probe_desc *desc)
 	 * compile-time error due to duplicated symbol names.
 	 */
 
+	ret = event_index_add(desc);
+	if (ret)
+		return ret;
+
 	/*
 	 * We sort the providers by struct lttng_probe_desc pointer
 	 * address.
@@ -117,6 +356,7 @@ void lttng_lazy_probe_register(struct lttng_probe_desc *desc)
 desc_added:
 	pr_debug("LTTng: just registered probe %s containing %u events\n",
 		desc->provider, desc->nr_events);
+	return 0;
 }
 
 /*
@@ -126,17 +366,29 @@ static
 void fixup_lazy_probes(void)
 {
 	struct lttng_probe_desc *iter, *tmp;
+	LIST_HEAD(registered);
 	int ret;
 
 	lazy_nesting++;
 	list_for_each_entry_safe(iter, tmp,
 			&lazy_probe_init, lazy_init_head) {
-		lttng_lazy_probe_register(iter);
+		/* On failure, the probe stays lazy and is retried later. */
+		if (lttng_lazy_probe_register(iter)) {
+			printk(KERN_WARNING "LTTng: unable to register probe %s\n",
+				iter->provider);
+			continue;
+		}
 		iter->lazy = 0;
+		list_move(&iter->lazy_init_head, &registered);
+	}
+	sort(sorted_event_desc, nr_sorted_event_desc,
+		sizeof(*sorted_event_desc), event_desc_name_cmp, NULL);
+	/* Pending events look up the names of the new probes. */
+	list_for_each_entry_safe(iter, tmp, &registered, lazy_init_head) {
 		list_del(&iter->lazy_init_head);
+		ret = lttng_fix_pending_events(iter);
+		WARN_ON_ONCE(ret);
 	}
-	ret = lttng_fix_pending_events();
-	WARN_ON_ONCE(ret);
 	lazy_nesting--;
 }
 
@@ -154,10 +406,11 @@ static
 const struct lttng_probe_desc *find_provider(const char *provider)
 {
 	struct lttng_probe_desc *iter;
-	struct list_head *probe_list;
 
-	probe_list = lttng_get_probe_list_head();
-	list_for_each_entry(iter, probe_list, head) {
+	/* Register lazy probes first. */
+	(void) lttng_get_probe_list_head();
+	lttng_hlist_for_each_entry(iter, name_bucket(provider_ht,
+			LTTNG_PROVIDER_HT_BITS, provider), provider_hlist) {
 		if (!strcmp(iter->provider, provider))
 			return iter;
 	}
@@ -196,31 +449,34 @@ EXPORT_SYMBOL_GPL(lttng_probe_register);
 
 void lttng_probe_unregister(struct lttng_probe_desc *desc)
 {
+	int i;
+
 	lttng_lock_sessions();
-	if (!desc->lazy)
+	if (!desc->lazy) {
 		list_del(&desc->head);
-	else
+		event_index_remove(desc);
+		for (i = 0; i < desc->nr_events; i++)
+			event_metadata_uncache(desc->event_desc[i]);
+	} else {
 		list_del(&desc->lazy_init_head);
+	}
 	pr_debug("LTTng: just unregistered probe %s\n", desc->provider);
 	lttng_unlock_sessions();
 }
 EXPORT_SYMBOL_GPL(lttng_probe_unregister);
 
 /*
- * TODO: this is O(nr_probes * nb_events), could be faster.
  * Called with sessions lock held.
  */
 static
 const struct lttng_event_desc *find_event(const char *name)
 {
-	struct lttng_probe_desc *probe_desc;
-	int i;
+	struct lttng_event_name_node *node;
 
-	list_for_each_entry(probe_desc, &_probe_list, head) {
-		for (i = 0; i < probe_desc->nr_events; i++) {
-			if (!strcmp(probe_desc->event_desc[i]->name, name))
-				return probe_desc->event_desc[i];
-			}
+	lttng_hlist_for_each_entry(node, name_bucket(event_name_ht,
+			LTTNG_EVENT_NAME_HT_BITS, name), hlist) {
+		if (!strcmp(node->desc->name, name))
+			return node->desc;
 	}
 	return NULL;
 }
@@ -329,9 +585,5 @@ const struct file_operations lttng_tracepoint_list_fops = {
 
 int lttng_probes_init(void)
 {
-	int cpu;
-
-	for_each_possible_cpu(cpu)
-		per_cpu_ptr(&lttng_dynamic_len_stack, cpu)->offset = 0;
 	return 0;
 }
@@ -22,16 +22,122 @@
 
 #include <linux/module.h>
 #include <linux/types.h>
+#if defined(CONFIG_LIBCRC32C) || defined(CONFIG_LIBCRC32C_MODULE)
+#include <linux/crc32c.h>
+#endif
 #include <lib/bitfield.h>
 #include <wrapper/vmalloc.h>	/* for wrapper_vmalloc_sync_all() */
 #include <wrapper/trace-clock.h>
+#include <wrapper/pvclock.h>
 #include <lttng-events.h>
 #include <lttng-tracer.h>
 #include <wrapper/ringbuffer/frontend_types.h>
+#include <wrapper/ringbuffer/frontend_internal.h>	/* for last_tsc_delta() */
+
+/*
+ * Clients can select contiguous sub-buffers, either physically
+ * (RING_BUFFER_PAGE_CONTIG) or virtually (RING_BUFFER_VMAP), if needed.
+ */
+#ifndef RING_BUFFER_BACKEND_TEMPLATE
+#define RING_BUFFER_BACKEND_TEMPLATE		RING_BUFFER_PAGE
+#endif
+
+/*
+ * Clients tracing nohz_full cpus can select RING_BUFFER_SYNC_GLOBAL, along
+ * with the default RING_BUFFER_NO_IPI_BARRIER: flushes, switch timers and
+ * snapshots are then handled from housekeeping cpus without interrupting
+ * the traced cpus, at the cost of atomic operations on the tracing fast
+ * path.
+ */
+/*
+ * Clients selecting RING_BUFFER_ALLOC_GLOBAL share a single buffer between
+ * all cpus, which requires RING_BUFFER_SYNC_GLOBAL.
+ */
+#ifndef RING_BUFFER_ALLOC_TEMPLATE
+#define RING_BUFFER_ALLOC_TEMPLATE		RING_BUFFER_ALLOC_PER_CPU
+#endif
+
+/*
+ * Clients selecting a RING_BUFFER_CLUSTER_TEMPLATE other than
+ * RING_BUFFER_CLUSTER_CPU share each per-cpu buffer between the cpus of a
+ * cluster, which also requires RING_BUFFER_SYNC_GLOBAL.
+ */
+#ifndef RING_BUFFER_CLUSTER_TEMPLATE
+#define RING_BUFFER_CLUSTER_TEMPLATE		RING_BUFFER_CLUSTER_CPU
+#endif
+
+#ifndef RING_BUFFER_SYNC_TEMPLATE
+#define RING_BUFFER_SYNC_TEMPLATE		RING_BUFFER_SYNC_PER_CPU
+#endif
+
+/*
+ * Consumer reads must not interrupt the traced cpus, so commits are
+ * ordered by write barriers rather than by IPIs sent from get_subbuf().
+ */
+/*
+ * Spliced pages are referenced rather than replaced, so streaming does not
+ * allocate pages, except for those still in flight when the consumer puts
+ * the sub-buffer.
+ */
+#ifndef RING_BUFFER_SPLICE_TEMPLATE
+#define RING_BUFFER_SPLICE_TEMPLATE		RING_BUFFER_SPLICE_PAGE_REF
+#endif
+
+#ifndef RING_BUFFER_IPI_TEMPLATE
+#define RING_BUFFER_IPI_TEMPLATE		RING_BUFFER_NO_IPI_BARRIER
+#endif
+
+/*
+ * Clients selecting RING_BUFFER_SNAPSHOT_SWAP allocate a snapshot pool as
+ * large as each buffer, so snapshots swap sub-buffers out rather than
+ * copying them. Overwrite mode only.
+ */
+#ifndef RING_BUFFER_SNAPSHOT_TEMPLATE
+#define RING_BUFFER_SNAPSHOT_TEMPLATE		RING_BUFFER_SNAPSHOT_COPY
+#endif
 
 #define LTTNG_COMPACT_EVENT_BITS	5
 #define LTTNG_COMPACT_TSC_BITS		27
 
+#define LTTNG_DENSE_TAG_BITS		3
+#define LTTNG_DENSE_EVENT_BITS		5
+
+/*
+ * Dense header tags. The first byte holds the tag and a 5-bit event id. The
+ * tagged variant then holds a wider event id, if any, followed by the
+ * timestamp. Timestamps are truncated to 16 or 32 bits when the delta from the
+ * previous record of the stream fits.
+ */
+enum lttng_dense_header_tag {
+	LTTNG_DENSE_ID5_TS16 = 0,
+	LTTNG_DENSE_ID5_TS32 = 1,
+	LTTNG_DENSE_ID8_TS16 = 2,
+	LTTNG_DENSE_ID8_TS32 = 3,
+	LTTNG_DENSE_ID16_TS16 = 4,
+	LTTNG_DENSE_ID16_TS32 = 5,
+	LTTNG_DENSE_ID5_TS64 = 6,
+	LTTNG_DENSE_EXTENDED = 7,
+};
+
+/*
+ * Variant payload of each tag, aligned on its largest member, which is
+ * always the timestamp.
+ */
+static const struct lttng_dense_header_layout {
+	unsigned char id_size;
+	unsigned char ts_size;
+	unsigned char align;
+} lttng_dense_layout[] = {
+	[LTTNG_DENSE_ID5_TS16] = { 0, sizeof(uint16_t), lttng_alignof(uint16_t) },
+	[LTTNG_DENSE_ID5_TS32] = { 0, sizeof(uint32_t), lttng_alignof(uint32_t) },
+	[LTTNG_DENSE_ID8_TS16] = { sizeof(uint8_t), sizeof(uint16_t), lttng_alignof(uint16_t) },
+	[LTTNG_DENSE_ID8_TS32] = { sizeof(uint8_t), sizeof(uint32_t), lttng_alignof(uint32_t) },
+	[LTTNG_DENSE_ID16_TS16] = { sizeof(uint16_t), sizeof(uint16_t), lttng_alignof(uint16_t) },
+	[LTTNG_DENSE_ID16_TS32] = { sizeof(uint16_t), sizeof(uint32_t), lttng_alignof(uint32_t) },
+	[LTTNG_DENSE_ID5_TS64] = { 0, sizeof(uint64_t), lttng_alignof(uint64_t) },
+	[LTTNG_DENSE_EXTENDED] = { sizeof(uint32_t), sizeof(uint64_t), lttng_alignof(uint64_t) },
+};
+
 static struct lttng_transport lttng_relay_transport;
 
 /*
@@ -72,16 +178,51 @@ struct packet_header {
 						 * (may overflow)
 						 */
 		uint32_t cpu_id;		/* CPU id associated with stream */
+		uint32_t packet_crc32c;		/* CRC32C of the content, or 0 */
+		/* Guest clock parameters at packet begin, or 0 */
+		uint64_t pvclock_tsc_timestamp;
+		uint64_t pvclock_system_time;
+		uint32_t pvclock_tsc_to_system_mul;
+		int8_t pvclock_tsc_shift;
+		uint8_t pvclock_flags;
 		uint8_t header_end;		/* End of header */
 	} ctx;
 };
 
 
+/*
+ * Untimed channels do not read the clock on the reservation path: their
+ * packets begin and end read it instead.
+ */
 static inline notrace u64 lib_ring_buffer_clock_read(struct channel *chan)
 {
+	struct lttng_channel *lttng_chan = channel_get_private(chan);
+
+	if (unlikely(lttng_chan->header_type == 4))
+		return 0;
 	return trace_clock_read64();
 }
 
+static inline
+enum lttng_dense_header_tag lttng_dense_header_tag(unsigned int rflags)
+{
+	unsigned int tag;
+
+	if (rflags & LTTNG_RFLAG_EXTENDED)
+		return LTTNG_DENSE_EXTENDED;
+	if (rflags & RING_BUFFER_RFLAG_FULL_TSC) {
+		if (rflags & (LTTNG_RFLAG_ID8 | LTTNG_RFLAG_ID16))
+			return LTTNG_DENSE_EXTENDED;
+		return LTTNG_DENSE_ID5_TS64;
+	}
+	tag = (rflags & LTTNG_RFLAG_TS16) ? 0 : 1;
+	if (rflags & LTTNG_RFLAG_ID16)
+		tag += LTTNG_DENSE_ID16_TS16;
+	else if (rflags & LTTNG_RFLAG_ID8)
+		tag += LTTNG_DENSE_ID8_TS16;
+	return tag;
+}
+
 static inline
 size_t ctx_get_size(size_t offset, struct lttng_ctx *ctx)
 {
@@ -91,23 +232,164 @@ size_t ctx_get_size(size_t offset, struct lttng_ctx *ctx)
 	if (likely(!ctx))
 		return 0;
 	offset += lib_ring_buffer_align(offset, ctx->largest_align);
-	for (i = 0; i < ctx->nr_fields; i++)
+	offset += ctx->fixed_size;
+	for (i = ctx->nr_fixed_fields; i < ctx->nr_fields; i++)
 		offset += ctx->fields[i].get_size(offset);
 	return offset - orig_offset;
 }
 
+/*
+ * A packet-scoped context field is unchanged if the record physically
+ * preceding the one beginning at "begin" saved the same value. Nested
+ * records saving values between the space reservation and the record
+ * make it begin elsewhere, and nested records interrupting the save
+ * see an unknown value: they can only cause values to be recorded again.
+ */
+static inline
+int ctx_packet_scoped_unchanged(struct lttng_ctx_field *field,
+		struct lttng_probe_ctx *lttng_probe_ctx,
+		int cpu, unsigned long begin)
+{
+	struct lttng_ctx_packet_scoped *ps = per_cpu_ptr(field->packet_scoped, cpu);
+	union lttng_ctx_value value;
+
+	if (ACCESS_ONCE(ps->end) != begin)
+		return 0;
+	barrier();
+	lttng_ctx_get_value(field, lttng_probe_ctx, &value);
+	if (field->event_field.type.atype == atype_array)
+		return !strncmp(value.str, ps->u.str,
+				field->event_field.type.u.array.length);
+	return value.s64 == ps->u.s64;
+}
+
+static inline
+void ctx_packet_scoped_save(struct lttng_ctx_field *field,
+		struct lttng_probe_ctx *lttng_probe_ctx,
+		int cpu, unsigned long end, int changed)
+{
+	struct lttng_ctx_packet_scoped *ps = per_cpu_ptr(field->packet_scoped, cpu);
+	union lttng_ctx_value value;
+
+	if (changed) {
+		ACCESS_ONCE(ps->end) = 0;
+		barrier();
+		lttng_ctx_get_value(field, lttng_probe_ctx, &value);
+		if (field->event_field.type.atype == atype_array)
+			strncpy(ps->u.str, value.str,
+				field->event_field.type.u.array.length);
+		else
+			ps->u.s64 = value.s64;
+		barrier();
+	}
+	ACCESS_ONCE(ps->end) = end;
+}
+
+/*
+ * Size of the channel contexts. Packet-scoped fields take a one byte tag,
+ * followed by their value when it changed. The fields to record are saved
+ * in the probe context.
+ */
+static inline
+size_t chan_ctx_get_size(size_t offset, struct lttng_ctx *ctx,
+		struct lib_ring_buffer_ctx *bufctx, unsigned long begin)
+{
+	struct lttng_probe_ctx *lttng_probe_ctx = bufctx->priv;
+	int i;
+	size_t orig_offset = offset;
+
+	if (likely(!ctx))
+		return 0;
+	lttng_probe_ctx->ctx_changed = 0;
+	offset += lib_ring_buffer_align(offset, ctx->largest_align);
+	offset += ctx->fixed_size;
+	for (i = ctx->nr_fixed_fields; i < ctx->nr_fields; i++) {
+		struct lttng_ctx_field *field = &ctx->fields[i];
+
+		if (field->packet_scoped) {
+			offset += sizeof(uint8_t);	/* tag */
+			if (ctx_packet_scoped_unchanged(field, lttng_probe_ctx,
+					bufctx->cpu, begin))
+				continue;
+			lttng_probe_ctx->ctx_changed |= 1U << i;
+		}
+		offset += field->get_size(offset);
+	}
+	return offset - orig_offset;
+}
+
+/*
+ * Write the fixed layout fields in a single pass: their values are
+ * gathered in a snapshot laid out as in the buffer, padding zeroed, and
+ * copied at once. Character arrays are copied up to their terminating
+ * null character, as get_value() may return a shorter string. This saves a get_size() and a record() indirect call
+ * per field, and the per-field alignment and buffer write.
+ */
+static inline
+void ctx_record_fixed(struct lib_ring_buffer_ctx *bufctx,
+		struct lttng_channel *chan,
+		struct lttng_ctx *ctx)
+{
+	char snapshot[LTTNG_CTX_FIXED_MAX_LEN] __aligned(sizeof(uint64_t));
+	int i;
+
+	memset(snapshot, 0, ctx->fixed_size);
+	for (i = 0; i < ctx->nr_fixed_fields; i++) {
+		struct lttng_ctx_field *field = &ctx->fields[i];
+		char *p = snapshot + field->fixed_offset;
+		union lttng_ctx_value value;
+
+		lttng_ctx_get_value(field, bufctx->priv, &value);
+		if (field->fixed_array) {
+			strncpy(p, value.str, field->fixed_len);
+			continue;
+		}
+		switch (field->fixed_len) {
+		case 1:
+			*(uint8_t *) p = value.s64;
+			break;
+		case 2:
+			*(uint16_t *) p = value.s64;
+			break;
+		case 4:
+			*(uint32_t *) p = value.s64;
+			break;
+		case 8:
+			*(uint64_t *) p = value.s64;
+			break;
+		}
+	}
+	chan->ops->event_write(bufctx, snapshot, ctx->fixed_size);
+}
+
 static inline
 void ctx_record(struct lib_ring_buffer_ctx *bufctx,
 		struct lttng_channel *chan,
 		struct lttng_ctx *ctx)
 {
+	struct lttng_probe_ctx *lttng_probe_ctx = bufctx->priv;
 	int i;
 
 	if (likely(!ctx))
 		return;
 	lib_ring_buffer_align_ctx(bufctx, ctx->largest_align);
-	for (i = 0; i < ctx->nr_fields; i++)
-		ctx->fields[i].record(&ctx->fields[i], bufctx, chan);
+	if (ctx->nr_fixed_fields)
+		ctx_record_fixed(bufctx, chan, ctx);
+	for (i = ctx->nr_fixed_fields; i < ctx->nr_fields; i++) {
+		struct lttng_ctx_field *field = &ctx->fields[i];
+
+		if (field->packet_scoped) {
+			uint8_t changed = !!(lttng_probe_ctx->ctx_changed & (1U << i));
+
+			chan->ops->event_write(bufctx, &changed, sizeof(changed));
+			if (changed)
+				field->record(field, bufctx, chan);
+			ctx_packet_scoped_save(field, lttng_probe_ctx, bufctx->cpu,
+				bufctx->pre_offset + bufctx->slot_size, changed);
+			continue;
+		}
+		field->record(field, bufctx, chan);
+	}
 }
 
 /*
@@ -122,6 +404,12 @@ void ctx_record(struct lib_ring_buffer_ctx *bufctx,
  *
  * The payload must itself determine its own alignment from the biggest type it
  * contains.
+ *
+ * For dense headers, this also selects the timestamp size, which is only known
+ * at reservation time, and saves it in the context reservation flags.
+ *
+ * Records with delta fields get the payload size of the packet they begin in:
+ * with full values outside of the packet of their bases.
  */
 static __inline__
 size_t record_header_size(const struct lib_ring_buffer_config *config,
@@ -135,6 +423,12 @@ size_t record_header_size(const struct lib_ring_buffer_config *config,
 	size_t orig_offset = offset;
 	size_t padding;
 
+	if (unlikely(lttng_probe_ctx->delta_full_len)) {
+		if (subbuf_trunc(offset, chan) == lttng_probe_ctx->delta_packet)
+			ctx->data_size = lttng_probe_ctx->delta_len;
+		else
+			ctx->data_size = lttng_probe_ctx->delta_full_len;
+	}
 	switch (lttng_chan->header_type) {
 	case 1:	/* compact */
 		padding = lib_ring_buffer_align(offset, lttng_alignof(uint32_t));
@@ -166,11 +460,37 @@ size_t record_header_size(const struct lib_ring_buffer_config *config,
 			offset += sizeof(uint64_t);	/* timestamp */
 		}
 		break;
+	case 3:	/* dense */
+	{
+		const struct lttng_dense_header_layout *layout;
+
+		padding = 0;
+		ctx->rflags &= ~LTTNG_RFLAG_TS16;
+		if (!(ctx->rflags & RING_BUFFER_RFLAG_FULL_TSC)
+				&& last_tsc_delta(config, ctx->buf, ctx->tsc)
+					< (1ULL << 16))
+			ctx->rflags |= LTTNG_RFLAG_TS16;
+		layout = &lttng_dense_layout[lttng_dense_header_tag(ctx->rflags)];
+		offset += sizeof(uint8_t);	/* tag and id */
+		offset += lib_ring_buffer_align(offset, layout->align);
+		offset += layout->id_size;
+		offset += lib_ring_buffer_align(offset, layout->align);
+		offset += layout->ts_size;
+		break;
+	}
+	case 4:	/* untimed */
+		padding = 0;
+		offset += sizeof(uint8_t);
+		if (ctx->rflags & LTTNG_RFLAG_EXTENDED) {
+			offset += lib_ring_buffer_align(offset, lttng_alignof(uint32_t));
+			offset += sizeof(uint32_t);	/* id */
+		}
+		break;
 	default:
 		padding = 0;
 		WARN_ON_ONCE(1);
 	}
-	offset += ctx_get_size(offset, lttng_chan->ctx);
+	offset += chan_ctx_get_size(offset, lttng_chan->ctx, ctx, orig_offset);
 	offset += ctx_get_size(offset, event->ctx);
 
 	*pre_header_padding = padding;
@@ -184,6 +504,92 @@ void lttng_write_event_header_slow(const struct lib_ring_buffer_config *config,
 				 struct lib_ring_buffer_ctx *ctx,
 				 uint32_t event_id);
 
+/*
+ * Writes the dense event header, as laid out by record_header_size().
+ */
+static __inline__
+void lttng_write_dense_event_header(const struct lib_ring_buffer_config *config,
+			    struct lib_ring_buffer_ctx *ctx,
+			    uint32_t event_id)
+{
+	enum lttng_dense_header_tag tag = lttng_dense_header_tag(ctx->rflags);
+	const struct lttng_dense_header_layout *layout = &lttng_dense_layout[tag];
+	uint8_t tag_id = 0;
+
+	bt_bitfield_write(&tag_id, uint8_t,
+			0,
+			LTTNG_DENSE_TAG_BITS,
+			tag);
+	bt_bitfield_write(&tag_id, uint8_t,
+			LTTNG_DENSE_TAG_BITS,
+			LTTNG_DENSE_EVENT_BITS,
+			layout->id_size ? 0 : event_id);
+	lib_ring_buffer_write(config, ctx, &tag_id, sizeof(tag_id));
+	lib_ring_buffer_align_ctx(ctx, layout->align);
+	switch (layout->id_size) {
+	case 0:
+		break;
+	case sizeof(uint8_t):
+	{
+		uint8_t id = event_id;
+
+		lib_ring_buffer_write(config, ctx, &id, sizeof(id));
+		break;
+	}
+	case sizeof(uint16_t):
+	{
+		uint16_t id = event_id;
+
+		lib_ring_buffer_write(config, ctx, &id, sizeof(id));
+		break;
+	}
+	default:
+		lib_ring_buffer_write(config, ctx, &event_id, sizeof(event_id));
+		break;
+	}
+	lib_ring_buffer_align_ctx(ctx, layout->align);
+	switch (layout->ts_size) {
+	case sizeof(uint16_t):
+	{
+		uint16_t timestamp = (uint16_t) ctx->tsc;
+
+		lib_ring_buffer_write(config, ctx, &timestamp, sizeof(timestamp));
+		break;
+	}
+	case sizeof(uint32_t):
+	{
+		uint32_t timestamp = (uint32_t) ctx->tsc;
+
+		lib_ring_buffer_write(config, ctx, &timestamp, sizeof(timestamp));
+		break;
+	}
+	default:
+	{
+		uint64_t timestamp = ctx->tsc;
+
+		lib_ring_buffer_write(config, ctx, &timestamp, sizeof(timestamp));
+		break;
+	}
+	}
+}
+
+/*
+ * Writes the untimed event header, as laid out by record_header_size().
+ */
+static __inline__
+void lttng_write_untimed_event_header(const struct lib_ring_buffer_config *config,
+			    struct lib_ring_buffer_ctx *ctx,
+			    uint32_t event_id)
+{
+	uint8_t id = (ctx->rflags & LTTNG_RFLAG_EXTENDED) ? 255 : event_id;
+
+	lib_ring_buffer_write(config, ctx, &id, sizeof(id));
+	if (ctx->rflags & LTTNG_RFLAG_EXTENDED) {
+		lib_ring_buffer_align_ctx(ctx, lttng_alignof(uint32_t));
+		lib_ring_buffer_write(config, ctx, &event_id, sizeof(event_id));
+	}
+}
+
 /*
  * lttng_write_event_header
  *
@@ -202,7 +608,7 @@ void lttng_write_event_header(const struct lib_ring_buffer_config *config,
 	struct lttng_probe_ctx *lttng_probe_ctx = ctx->priv;
 	struct lttng_event *event = lttng_probe_ctx->event;
 
-	if (unlikely(ctx->rflags))
+	if (unlikely(ctx->rflags & (RING_BUFFER_RFLAG_FULL_TSC | LTTNG_RFLAG_EXTENDED)))
 		goto slow_path;
 
 	switch (lttng_chan->header_type) {
@@ -231,6 +637,12 @@ void lttng_write_event_header(const struct lib_ring_buffer_config *config,
 		lib_ring_buffer_write(config, ctx, &timestamp, sizeof(timestamp));
 		break;
 	}
+	case 3:	/* dense */
+		lttng_write_dense_event_header(config, ctx, event_id);
+		break;
+	case 4:	/* untimed */
+		lttng_write_untimed_event_header(config, ctx, event_id);
+		break;
 	default:
 		WARN_ON_ONCE(1);
 	}
@@ -305,6 +717,12 @@ void lttng_write_event_header_slow(const struct lib_ring_buffer_config *config,
 		}
 		break;
 	}
+	case 3:	/* dense */
+		lttng_write_dense_event_header(config, ctx, event_id);
+		break;
+	case 4:	/* untimed */
+		lttng_write_untimed_event_header(config, ctx, event_id);
+		break;
 	default:
 		WARN_ON_ONCE(1);
 	}
@@ -352,11 +770,38 @@ static void client_buffer_begin(struct lib_ring_buffer *buf, u64 tsc,
 				subbuf_idx * chan->backend.subbuf_size);
 	struct lttng_channel *lttng_chan = channel_get_private(chan);
 	struct lttng_session *session = lttng_chan->session;
+	struct lttng_ctx *ctx = lttng_chan->ctx;
+	struct lttng_pvclock_params pvclock;
+	int i;
+
+	if (lttng_chan->header_type == 4)
+		tsc = trace_clock_read64();
+	/* The first event of each packet records packet-scoped contexts. */
+	for (i = 0; ctx && i < ctx->nr_fields; i++) {
+		struct lttng_ctx_field *field = &ctx->fields[i];
+		int cpu;
+
+		if (!field->packet_scoped)
+			continue;
+		if (client_config.alloc == RING_BUFFER_ALLOC_PER_CPU
+				&& client_config.cluster == RING_BUFFER_CLUSTER_CPU) {
+			ACCESS_ONCE(per_cpu_ptr(field->packet_scoped,
+				buf->backend.cpu)->end) = 0;
+		} else {
+			for_each_possible_cpu(cpu)
+				ACCESS_ONCE(per_cpu_ptr(field->packet_scoped,
+					cpu)->end) = 0;
+		}
+	}
 
 	header->magic = CTF_MAGIC_NUMBER;
 	memcpy(header->uuid, session->uuid.b, sizeof(session->uuid));
 	header->stream_id = lttng_chan->id;
-	header->stream_instance_id = buf->backend.cpu;
+	/*
+	 * A global buffer has no cpu: it is stream instance 0. A cluster
+	 * buffer is identified by the cpu owning it.
+	 */
+	header->stream_instance_id = max(buf->backend.cpu, 0);
 	header->ctx.timestamp_begin = tsc;
 	header->ctx.timestamp_end = 0;
 	header->ctx.content_size = ~0ULL; /* for debugging */
@@ -365,8 +810,55 @@ static void client_buffer_begin(struct lib_ring_buffer *buf, u64 tsc,
 				     buf->backend.buf_cnt[subbuf_idx].seq_cnt + \
 				     subbuf_idx;
 	header->ctx.events_discarded = 0;
-	header->ctx.cpu_id = buf->backend.cpu;
+	header->ctx.cpu_id = max(buf->backend.cpu, 0);
+	header->ctx.packet_crc32c = 0;
+	/*
+	 * In KVM guests, relates the guest TSC to the host time, aligning
+	 * host and guest traces together with the host TSC offsets.
+	 */
+	if (lttng_pvclock_read(&pvclock))
+		memset(&pvclock, 0, sizeof(pvclock));
+	header->ctx.pvclock_tsc_timestamp = pvclock.tsc_timestamp;
+	header->ctx.pvclock_system_time = pvclock.system_time;
+	header->ctx.pvclock_tsc_to_system_mul = pvclock.tsc_to_system_mul;
+	header->ctx.pvclock_tsc_shift = pvclock.tsc_shift;
+	header->ctx.pvclock_flags = pvclock.flags;
+}
+
+#if defined(CONFIG_LIBCRC32C) || defined(CONFIG_LIBCRC32C_MODULE)
+/*
+ * CRC32C of the packet content following the packet header. All the
+ * records of the packet are committed. The sub-buffer pages are not
+ * contiguous: checksum each page chunk in turn. crc32c() uses the
+ * crc32 instructions of the CPU when available.
+ */
+static
+uint32_t client_packet_crc32c(struct lib_ring_buffer *buf,
+		unsigned int subbuf_idx, unsigned long data_size)
+{
+	struct channel *chan = buf->backend.chan;
+	size_t offset = subbuf_idx * chan->backend.subbuf_size;
+	size_t pos = client_packet_header_size();
+	u32 crc = ~0U;
+
+	while (pos < data_size) {
+		size_t len = min_t(size_t, data_size - pos,
+				PAGE_SIZE - ((offset + pos) & ~PAGE_MASK));
+
+		crc = crc32c(crc, lib_ring_buffer_offset_address(&buf->backend,
+					offset + pos), len);
+		pos += len;
+	}
+	return ~crc;
 }
+#else
+static
+uint32_t client_packet_crc32c(struct lib_ring_buffer *buf,
+		unsigned int subbuf_idx, unsigned long data_size)
+{
+	return 0;
+}
+#endif
 
 /*
  * offset is assumed to never be 0 here : never deliver a completely empty
@@ -380,8 +872,12 @@ static void client_buffer_end(struct lib_ring_buffer *buf, u64 tsc,
 		(struct packet_header *)
 			lib_ring_buffer_offset_address(&buf->backend,
 				subbuf_idx * chan->backend.subbuf_size);
+	struct lttng_channel *lttng_chan = channel_get_private(chan);
+	struct lib_ring_buffer_packet_index index;
 	unsigned long records_lost = 0;
 
+	if (lttng_chan->header_type == 4)
+		tsc = trace_clock_read64();
 	header->ctx.timestamp_end = tsc;
 	header->ctx.content_size =
 		(uint64_t) data_size * CHAR_BIT;		/* in bits */
@@ -391,6 +887,19 @@ static void client_buffer_end(struct lib_ring_buffer *buf, u64 tsc,
 	records_lost += lib_ring_buffer_get_records_lost_wrap(&client_config, buf);
 	records_lost += lib_ring_buffer_get_records_lost_big(&client_config, buf);
 	header->ctx.events_discarded = records_lost;
+	if (lttng_chan->packet_crc32c)
+		header->ctx.packet_crc32c =
+			client_packet_crc32c(buf, subbuf_idx, data_size);
+
+	index.timestamp_begin = header->ctx.timestamp_begin;
+	index.timestamp_end = header->ctx.timestamp_end;
+	index.content_size = header->ctx.content_size;
+	index.packet_size = header->ctx.packet_size;
+	index.events_discarded = header->ctx.events_discarded;
+	index.stream_id = header->stream_id;
+	index.stream_instance_id = header->stream_instance_id;
+	index.seq_num = header->ctx.packet_seq_num;
+	lib_ring_buffer_packet_index_write(buf, &index);
 }
 
 static int client_buffer_create(struct lib_ring_buffer *buf, void *priv,
@@ -403,6 +912,19 @@ static void client_buffer_finalize(struct lib_ring_buffer *buf, void *priv, int
 {
 }
 
+/*
+ * Event summaries are per CPU: only flush them from the timer of the
+ * buffer of the current CPU.
+ */
+static void client_buffer_switch_timer(struct lib_ring_buffer *buf)
+{
+	struct channel *chan = buf->backend.chan;
+
+	if (buf->backend.cpu != smp_processor_id())
+		return;
+	lttng_channel_summary_flush(channel_get_private(chan));
+}
+
 static struct packet_header *client_packet_header(
 		const struct lib_ring_buffer_config *config,
 		struct lib_ring_buffer *buf)
@@ -474,7 +996,7 @@ static int client_current_timestamp(const struct lib_ring_buffer_config *config,
 		struct lib_ring_buffer *bufb,
 		uint64_t *ts)
 {
-	*ts = config->cb.ring_buffer_clock_read(bufb->backend.chan);
+	*ts = trace_clock_read64();
 
 	return 0;
 }
@@ -501,6 +1023,30 @@ int client_instance_id(const struct lib_ring_buffer_config *config,
 	return 0;
 }
 
+static
+int client_packet_index(const struct lib_ring_buffer_config *config,
+		struct lib_ring_buffer *buf, uint64_t seq_num,
+		struct lttng_kernel_packet_index *index)
+{
+	struct lib_ring_buffer_packet_index entry;
+	int ret;
+
+	ret = lib_ring_buffer_packet_index_read(buf, seq_num, &entry);
+	if (ret)
+		return ret;
+	memset(index, 0, sizeof(*index));
+	index->timestamp_begin = entry.timestamp_begin;
+	index->timestamp_end = entry.timestamp_end;
+	index->content_size = entry.content_size;
+	index->packet_size = entry.packet_size;
+	index->events_discarded = entry.events_discarded;
+	index->stream_id = entry.stream_id;
+	index->stream_instance_id = entry.stream_instance_id;
+	index->seq_num = entry.seq_num;
+
+	return 0;
+}
+
 static const struct lib_ring_buffer_config client_config = {
 	.cb.ring_buffer_clock_read = client_ring_buffer_clock_read,
 	.cb.record_header_size = client_record_header_size,
@@ -509,16 +1055,21 @@ static const struct lib_ring_buffer_config client_config = {
 	.cb.buffer_end = client_buffer_end,
 	.cb.buffer_create = client_buffer_create,
 	.cb.buffer_finalize = client_buffer_finalize,
+	.cb.buffer_switch_timer = client_buffer_switch_timer,
 
 	.tsc_bits = LTTNG_COMPACT_TSC_BITS,
-	.alloc = RING_BUFFER_ALLOC_PER_CPU,
-	.sync = RING_BUFFER_SYNC_PER_CPU,
+	.alloc = RING_BUFFER_ALLOC_TEMPLATE,
+	.cluster = RING_BUFFER_CLUSTER_TEMPLATE,
+	.sync = RING_BUFFER_SYNC_TEMPLATE,
 	.mode = RING_BUFFER_MODE_TEMPLATE,
-	.backend = RING_BUFFER_PAGE,
+	.backend = RING_BUFFER_BACKEND_TEMPLATE,
 	.output = RING_BUFFER_OUTPUT_TEMPLATE,
+	.splice = RING_BUFFER_SPLICE_TEMPLATE,
 	.oops = RING_BUFFER_OOPS_CONSISTENCY,
-	.ipi = RING_BUFFER_IPI_BARRIER,
+	.ipi = RING_BUFFER_IPI_TEMPLATE,
 	.wakeup = RING_BUFFER_WAKEUP_BY_TIMER,
+	.commit_layout = RING_BUFFER_COMMIT_CACHELINE,
+	.snapshot = RING_BUFFER_SNAPSHOT_TEMPLATE,
 };
 
 static
@@ -542,9 +1093,16 @@ struct channel *_channel_create(const char *name,
 {
 	struct channel *chan;
 
-	chan = channel_create(&client_config, name, lttng_chan, buf_addr,
-			      subbuf_size, num_subbuf, switch_timer_interval,
-			      read_timer_interval);
+	/*
+	 * Masked-out cpus of the session record nothing: no buffer. The
+	 * pages are drawn from the session memory cap, if any.
+	 */
+	chan = channel_create_limited(&client_config, name, lttng_chan,
+			buf_addr, subbuf_size, num_subbuf,
+			switch_timer_interval, read_timer_interval,
+			client_config.alloc == RING_BUFFER_ALLOC_PER_CPU ?
+				lttng_chan->session->cpu_mask : NULL,
+			lttng_chan->session->page_pool);
 	if (chan) {
 		/*
 		 * Ensure this module is not unloaded before we finish
@@ -570,6 +1128,12 @@ struct lib_ring_buffer *lttng_buffer_read_open(struct channel *chan)
 	struct lib_ring_buffer *buf;
 	int cpu;
 
+	if (client_config.alloc == RING_BUFFER_ALLOC_GLOBAL) {
+		buf = channel_get_ring_buffer(&client_config, chan, 0);
+		if (!lib_ring_buffer_open_read(buf))
+			return buf;
+		return NULL;
+	}
 	for_each_channel_cpu(cpu, chan) {
 		buf = channel_get_ring_buffer(&client_config, chan, cpu);
 		if (!lib_ring_buffer_open_read(buf))
@@ -584,6 +1148,10 @@ int lttng_buffer_has_read_closed_stream(struct channel *chan)
 	struct lib_ring_buffer *buf;
 	int cpu;
 
+	if (client_config.alloc == RING_BUFFER_ALLOC_GLOBAL) {
+		buf = channel_get_ring_buffer(&client_config, chan, 0);
+		return !atomic_long_read(&buf->active_readers);
+	}
 	for_each_channel_cpu(cpu, chan) {
 		buf = channel_get_ring_buffer(&client_config, chan, cpu);
 		if (!atomic_long_read(&buf->active_readers))
@@ -598,16 +1166,38 @@ void lttng_buffer_read_close(struct lib_ring_buffer *buf)
 	lib_ring_buffer_release_read(buf);
 }
 
+/*
+ * Stage a record too large for a sub-buffer, with its event-specific
+ * contexts, to be recorded as fragments on commit.
+ */
 static
-int lttng_event_reserve(struct lib_ring_buffer_ctx *ctx,
-		      uint32_t event_id)
+int lttng_event_reserve_fragment(struct lib_ring_buffer_ctx *ctx, int cpu)
 {
 	struct lttng_channel *lttng_chan = channel_get_private(ctx->chan);
-	int ret, cpu;
+	struct lttng_probe_ctx *lttng_probe_ctx = ctx->priv;
+	struct lttng_event *event = lttng_probe_ctx->event;
+
+	if (ctx_get_size(0, event->ctx) + ctx->largest_align + ctx->data_size
+				> LTTNG_KERNEL_FRAGMENT_MAX_SIZE
+			|| !lttng_fragment_stage_get(lttng_chan)) {
+		lib_ring_buffer_lost_event_too_big(ctx->chan);
+		return -ENOSPC;
+	}
+	ctx->rflags |= LTTNG_RFLAG_FRAGMENT;
+	ctx->buf = channel_get_ring_buffer(&client_config, ctx->chan, cpu);
+	ctx->buf_offset = 0;
+	ctx_record(ctx, lttng_chan, event->ctx);
+	lib_ring_buffer_align_ctx(ctx, ctx->largest_align);
+	return 0;
+}
+
+static inline
+int __lttng_event_reserve(struct lib_ring_buffer_ctx *ctx,
+		      uint32_t event_id, int cpu)
+{
+	struct lttng_channel *lttng_chan = channel_get_private(ctx->chan);
+	int ret;
 
-	cpu = lib_ring_buffer_get_cpu(&client_config);
-	if (unlikely(cpu < 0))
-		return -EPERM;
 	ctx->cpu = cpu;
 
 	switch (lttng_chan->header_type) {
@@ -619,33 +1209,206 @@ int lttng_event_reserve(struct lib_ring_buffer_ctx *ctx,
 		if (event_id > 65534)
 			ctx->rflags |= LTTNG_RFLAG_EXTENDED;
 		break;
+	case 3:	/* dense */
+		if (event_id > 65535)
+			ctx->rflags |= LTTNG_RFLAG_EXTENDED;
+		else if (event_id > 255)
+			ctx->rflags |= LTTNG_RFLAG_ID16;
+		else if (event_id > 31)
+			ctx->rflags |= LTTNG_RFLAG_ID8;
+		break;
+	case 4:	/* untimed */
+		if (event_id > 254)
+			ctx->rflags |= LTTNG_RFLAG_EXTENDED;
+		break;
 	default:
 		WARN_ON_ONCE(1);
 	}
 
+	if (unlikely(lttng_chan->fragment_stage)
+			&& ctx->data_size > ctx->chan->backend.subbuf_size
+				- LTTNG_FRAGMENT_RESERVED)
+		return lttng_event_reserve_fragment(ctx, cpu);
 	ret = lib_ring_buffer_reserve(&client_config, ctx);
 	if (unlikely(ret))
-		goto put;
+		return ret;
 	lib_ring_buffer_backend_get_pages(&client_config, ctx,
 			&ctx->backend_pages);
 	lttng_write_event_header(&client_config, ctx, event_id);
 	return 0;
+}
+
+static
+int lttng_event_reserve(struct lib_ring_buffer_ctx *ctx,
+		      uint32_t event_id)
+{
+	int ret, cpu;
+
+	cpu = lib_ring_buffer_get_cpu(&client_config);
+	if (unlikely(cpu < 0))
+		return -EPERM;
+	ret = __lttng_event_reserve(ctx, event_id, cpu);
+	if (unlikely(ret))
+		lib_ring_buffer_put_cpu(&client_config);
+	return ret;
+}
+
+static
+void lttng_event_commit(struct lib_ring_buffer_ctx *ctx)
+{
+	if (unlikely(ctx->rflags & LTTNG_RFLAG_FRAGMENT))
+		lttng_fragment_stage_flush(ctx);
+	else
+		lib_ring_buffer_commit(&client_config, ctx);
+	lib_ring_buffer_put_cpu(&client_config);
+}
+
+/*
+ * Called with preemption disabled within a RCU-sched read-side critical
+ * section, e.g. from tracepoint probes.
+ */
+static
+int lttng_event_reserve_preempt_off(struct lib_ring_buffer_ctx *ctx,
+		      uint32_t event_id)
+{
+	int ret, cpu;
+
+	cpu = lib_ring_buffer_get_cpu_preempt_off(&client_config);
+	if (unlikely(cpu < 0))
+		return -EPERM;
+	ret = __lttng_event_reserve(ctx, event_id, cpu);
+	if (unlikely(ret))
+		lib_ring_buffer_put_cpu_preempt_off(&client_config);
+	return ret;
+}
+
+static
+void lttng_event_commit_preempt_off(struct lib_ring_buffer_ctx *ctx)
+{
+	if (unlikely(ctx->rflags & LTTNG_RFLAG_FRAGMENT))
+		lttng_fragment_stage_flush(ctx);
+	else
+		lib_ring_buffer_commit(&client_config, ctx);
+	lib_ring_buffer_put_cpu_preempt_off(&client_config);
+}
+
+/*
+ * Reserve @nr records with a single space reservation. Returns the number
+ * of records reserved, or a negative error value.
+ */
+static
+int lttng_event_reserve_batch(struct lib_ring_buffer_ctx *ctxs,
+		const uint32_t *event_ids, unsigned int nr)
+{
+	struct lttng_channel *lttng_chan = channel_get_private(ctxs[0].chan);
+	unsigned int i;
+	int ret, cpu;
+
+	cpu = lib_ring_buffer_get_cpu(&client_config);
+	if (unlikely(cpu < 0))
+		return -EPERM;
+
+	for (i = 0; i < nr; i++) {
+		ctxs[i].cpu = cpu;
+		switch (lttng_chan->header_type) {
+		case 1:	/* compact */
+			if (event_ids[i] > 30)
+				ctxs[i].rflags |= LTTNG_RFLAG_EXTENDED;
+			break;
+		case 2:	/* large */
+			if (event_ids[i] > 65534)
+				ctxs[i].rflags |= LTTNG_RFLAG_EXTENDED;
+			break;
+		case 3:	/* dense */
+			if (event_ids[i] > 65535)
+				ctxs[i].rflags |= LTTNG_RFLAG_EXTENDED;
+			else if (event_ids[i] > 255)
+				ctxs[i].rflags |= LTTNG_RFLAG_ID16;
+			else if (event_ids[i] > 31)
+				ctxs[i].rflags |= LTTNG_RFLAG_ID8;
+			break;
+		case 4:	/* untimed */
+			if (event_ids[i] > 254)
+				ctxs[i].rflags |= LTTNG_RFLAG_EXTENDED;
+			break;
+		default:
+			WARN_ON_ONCE(1);
+		}
+	}
+
+	ret = lib_ring_buffer_reserve_batch(&client_config, ctxs, nr);
+	if (unlikely(ret < 0))
+		goto put;
+	for (i = 0; i < ret; i++) {
+		lib_ring_buffer_backend_get_pages(&client_config, &ctxs[i],
+				&ctxs[i].backend_pages);
+		lttng_write_event_header(&client_config, &ctxs[i], event_ids[i]);
+	}
+	return ret;
 put:
 	lib_ring_buffer_put_cpu(&client_config);
 	return ret;
 }
 
 static
-void lttng_event_commit(struct lib_ring_buffer_ctx *ctx)
+void lttng_event_commit_batch(struct lib_ring_buffer_ctx *ctxs,
+		unsigned int nr)
 {
-	lib_ring_buffer_commit(&client_config, ctx);
+	lib_ring_buffer_commit_batch(&client_config, ctxs, nr);
 	lib_ring_buffer_put_cpu(&client_config);
 }
 
+/*
+ * Position of the context offset in the staging area of a record being
+ * fragmented, before the write of "len" bytes.
+ */
+static inline
+char *lttng_event_stage_pos(struct lib_ring_buffer_ctx *ctx, size_t len)
+{
+	struct lttng_channel *lttng_chan = channel_get_private(ctx->chan);
+	char *pos;
+
+	pos = this_cpu_ptr(lttng_chan->fragment_stage)->data + ctx->buf_offset;
+	ctx->buf_offset += len;
+	return pos;
+}
+
+/*
+ * Copies "len" - 1 characters at most, padded with '#', followed by a
+ * terminating '\0'.
+ */
+static
+void lttng_event_stage_strcpy(struct lib_ring_buffer_ctx *ctx,
+		const char *src, const char __user *user_src, size_t len)
+{
+	char *dest;
+	size_t count = 0;
+
+	if (unlikely(!len))
+		return;
+	dest = lttng_event_stage_pos(ctx, len);
+	if (src) {
+		count = lib_ring_buffer_do_strcpy(&client_config, dest, src,
+				len - 1);
+	} else {
+		pagefault_disable();
+		if (access_ok(VERIFY_READ, user_src, len))
+			count = lib_ring_buffer_do_strcpy_from_user_inatomic(
+				&client_config, dest, user_src, len - 1);
+		pagefault_enable();
+	}
+	lib_ring_buffer_do_memset(dest + count, '#', len - 1 - count);
+	dest[len - 1] = '\0';
+}
+
 static
 void lttng_event_write(struct lib_ring_buffer_ctx *ctx, const void *src,
 		     size_t len)
 {
+	if (unlikely(ctx->rflags & LTTNG_RFLAG_FRAGMENT)) {
+		memcpy(lttng_event_stage_pos(ctx, len), src, len);
+		return;
+	}
 	lib_ring_buffer_write(&client_config, ctx, src, len);
 }
 
@@ -653,6 +1416,13 @@ static
 void lttng_event_write_from_user(struct lib_ring_buffer_ctx *ctx,
 			       const void __user *src, size_t len)
 {
+	if (unlikely(ctx->rflags & LTTNG_RFLAG_FRAGMENT)) {
+		char *dest = lttng_event_stage_pos(ctx, len);
+
+		if (lib_ring_buffer_copy_from_user_check_nofault(dest, src, len))
+			memset(dest, 0, len);
+		return;
+	}
 	lib_ring_buffer_copy_from_user_inatomic(&client_config, ctx, src, len);
 }
 
@@ -660,6 +1430,10 @@ static
 void lttng_event_memset(struct lib_ring_buffer_ctx *ctx,
 		int c, size_t len)
 {
+	if (unlikely(ctx->rflags & LTTNG_RFLAG_FRAGMENT)) {
+		memset(lttng_event_stage_pos(ctx, len), c, len);
+		return;
+	}
 	lib_ring_buffer_memset(&client_config, ctx, c, len);
 }
 
@@ -667,6 +1441,10 @@ static
 void lttng_event_strcpy(struct lib_ring_buffer_ctx *ctx, const char *src,
 		size_t len)
 {
+	if (unlikely(ctx->rflags & LTTNG_RFLAG_FRAGMENT)) {
+		lttng_event_stage_strcpy(ctx, src, NULL, len);
+		return;
+	}
 	lib_ring_buffer_strcpy(&client_config, ctx, src, len, '#');
 }
 
@@ -674,6 +1452,10 @@ static
 void lttng_event_strcpy_from_user(struct lib_ring_buffer_ctx *ctx,
 		const char __user *src, size_t len)
 {
+	if (unlikely(ctx->rflags & LTTNG_RFLAG_FRAGMENT)) {
+		lttng_event_stage_strcpy(ctx, NULL, src, len);
+		return;
+	}
 	lib_ring_buffer_strcpy_from_user_inatomic(&client_config, ctx, src,
 			len, '#');
 }
@@ -716,11 +1498,17 @@ static struct lttng_transport lttng_relay_transport = {
 		.buffer_read_close = lttng_buffer_read_close,
 		.event_reserve = lttng_event_reserve,
 		.event_commit = lttng_event_commit,
+		.event_reserve_preempt_off = lttng_event_reserve_preempt_off,
+		.event_commit_preempt_off = lttng_event_commit_preempt_off,
+		.event_reserve_batch = lttng_event_reserve_batch,
+		.event_commit_batch = lttng_event_commit_batch,
 		.event_write = lttng_event_write,
 		.event_write_from_user = lttng_event_write_from_user,
 		.event_memset = lttng_event_memset,
 		.event_strcpy = lttng_event_strcpy,
 		.event_strcpy_from_user = lttng_event_strcpy_from_user,
+		.direct_write =
+			(RING_BUFFER_BACKEND_TEMPLATE == RING_BUFFER_PAGE),
 		.packet_avail_size = NULL,	/* Would be racy anyway */
 		.get_writer_buf_wait_queue = lttng_get_writer_buf_wait_queue,
 		.get_hp_wait_queue = lttng_get_hp_wait_queue,
@@ -735,6 +1523,7 @@ static struct lttng_transport lttng_relay_transport = {
 		.current_timestamp = client_current_timestamp,
 		.sequence_number = client_sequence_number,
 		.instance_id = client_instance_id,
+		.packet_index = client_packet_index,
 	},
 };
 
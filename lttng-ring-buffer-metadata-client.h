@@ -230,7 +230,7 @@ static const struct lib_ring_buffer_config client_config = {
 	.backend = RING_BUFFER_PAGE,
 	.output = RING_BUFFER_OUTPUT_TEMPLATE,
 	.oops = RING_BUFFER_OOPS_CONSISTENCY,
-	.ipi = RING_BUFFER_IPI_BARRIER,
+	.ipi = RING_BUFFER_NO_IPI_BARRIER,
 	.wakeup = RING_BUFFER_WAKEUP_BY_TIMER,
 };
 
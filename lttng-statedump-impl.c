@@ -46,6 +46,13 @@
 #include <linux/wait.h>
 #include <linux/mutex.h>
 #include <linux/device.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/spinlock.h>
+#include <linux/atomic.h>
+#include <linux/binfmts.h>
+#include <linux/slab.h>
+#include <linux/string.h>
 
 #include <lttng-events.h>
 #include <lttng-tracer.h>
@@ -55,14 +62,27 @@
 #include <wrapper/nsproxy.h>
 #include <wrapper/irq.h>
 #include <wrapper/tracepoint.h>
+#include <wrapper/trace-clock.h>
 #include <wrapper/genhd.h>
 #include <wrapper/file.h>
 #include <wrapper/time.h>
+#include <wrapper/vzalloc.h>
+#include <wrapper/module.h>
+#include <wrapper/softirq.h>
+#include <wrapper/swap.h>
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0))
+#include <linux/sched/mm.h>	/* for mmdrop() */
+#endif
 
 #ifdef CONFIG_LTTNG_HAS_LIST_IRQ
 #include <linux/irq.h>
 #endif
 
+#ifdef CONFIG_X86
+#include <asm/desc.h>
+#endif
+
 /* Define the tracepoints, but do not build the probes */
 #define CREATE_TRACE_POINTS
 #define TRACE_INCLUDE_PATH instrumentation/events/lttng-module
@@ -74,24 +94,527 @@ DEFINE_TRACE(lttng_statedump_block_device);
 DEFINE_TRACE(lttng_statedump_end);
 DEFINE_TRACE(lttng_statedump_interrupt);
 DEFINE_TRACE(lttng_statedump_file_descriptor);
+DEFINE_TRACE(lttng_statedump_file_descriptor_inode);
+DEFINE_TRACE(lttng_statedump_vm_map);
 DEFINE_TRACE(lttng_statedump_start);
+DEFINE_TRACE(lttng_statedump_phase);
 DEFINE_TRACE(lttng_statedump_process_state);
 DEFINE_TRACE(lttng_statedump_network_interface);
+DEFINE_TRACE(lttng_statedump_module);
+DEFINE_TRACE(lttng_statedump_module_unload);
+DEFINE_TRACE(lttng_statedump_symbol);
+DEFINE_TRACE(lttng_statedump_softirq);
+DEFINE_TRACE(lttng_statedump_swap_file);
+#ifdef CONFIG_X86
+DEFINE_TRACE(lttng_statedump_idt_vector);
+#endif
 
 struct lttng_fd_ctx {
 	char *page;
 	struct lttng_session *session;
 	struct task_struct *p;
 	struct files_struct *files;
+	unsigned int flags;		/* LTTNG_KERNEL_STATEDUMP_FLAG_* */
+};
+
+/*
+ * Per-CPU statedump worker. The process and file descriptor dumps are
+ * split in chunks, worker "index" of "nr" handling the processes whose
+ * tgid modulo nr is index, so each CPU writes its chunk into its own
+ * buffer.
+ */
+struct lttng_statedump_work {
+	struct delayed_work work;
+	struct lttng_session *session;
+	unsigned int index, nr;
+	unsigned int categories;
+	unsigned int flags;
+	u64 since, generation;
+	int ret;
+};
+
+/*
+ * Delta statedump cache. Each statedump is a new generation. Slots are
+ * indexed by a hash of the tgid and record the last generation in which
+ * the process was forked, exec'd or lost a thread, and a fingerprint of
+ * its fd table with the generation in which a statedump last saw it
+ * change. A process whose slot belongs to another tgid is considered
+ * changed, so collisions only cost extra records.
+ *
+ * Enabled by the first delta statedump request, and kept up to date by
+ * sched_process_fork/exec/exit probes until module unload.
+ */
+#define LTTNG_STATEDUMP_CACHE_ORDER	14
+#define LTTNG_STATEDUMP_CACHE_LOCKS	64
+
+struct lttng_statedump_cache_slot {
+	pid_t tgid;
+	u32 fd_hash;
+	u64 generation;
+	u64 fd_generation;
+};
+
+static struct lttng_statedump_cache_slot *statedump_cache;
+static spinlock_t statedump_cache_locks[LTTNG_STATEDUMP_CACHE_LOCKS];
+static atomic64_t statedump_generation;
+/*
+ * Serializes the statedumps of all sessions: they share the per-cpu
+ * works and the cache.
+ */
+static DEFINE_MUTEX(statedump_mutex);
+
+/*
+ * Direct dispatch of the statedump records. Each statedump collects the
+ * events of its session attached to the statedump tracepoints, and
+ * calls their probes directly rather than through the tracepoints,
+ * which call the probes of the events of every session. Events created
+ * during the statedump are not recorded by it. Protected by the
+ * statedump mutex.
+ *
+ * The tracepoint definitions above leave room for other ones: re-read
+ * the statedump tracepoints without defining them again.
+ */
+#undef CREATE_TRACE_POINTS
+#include <probes/lttng-tracepoint-event.h>
+#define TRACE_HEADER_MULTI_READ
+
+#undef LTTNG_TRACEPOINT_EVENT
+#define LTTNG_TRACEPOINT_EVENT(_name, _proto, _args, _fields)	\
+	LTTNG_DIRECT_##_name,
+
+enum lttng_statedump_direct_id {
+#include <instrumentation/events/lttng-module/lttng-statedump.h>
+	NR_LTTNG_DIRECT,
+};
+
+#undef LTTNG_TRACEPOINT_EVENT
+#define LTTNG_TRACEPOINT_EVENT(_name, _proto, _args, _fields)	\
+	[LTTNG_DIRECT_##_name] = #_name,
+
+static const char *statedump_direct_names[NR_LTTNG_DIRECT] = {
+#include <instrumentation/events/lttng-module/lttng-statedump.h>
+};
+
+static struct {
+	struct lttng_session *session;
+	struct lttng_event **events;	/* Ordered by direct id */
+	unsigned int offset[NR_LTTNG_DIRECT + 1];
+} statedump_direct;
+
+/*
+ * direct_trace_<event>() records the event as trace_<event>() would, in
+ * the session of the statedump in progress only. Probes expect to be
+ * called with preemption disabled, as by the tracepoints.
+ */
+#undef LTTNG_TRACEPOINT_EVENT
+#define LTTNG_TRACEPOINT_EVENT(_name, _proto, _args, _fields)	\
+static inline								\
+void direct_trace_##_name(_proto)					\
+{									\
+	struct lttng_event *__event;					\
+	unsigned int __i, __end;					\
+									\
+	if (unlikely(statedump_direct.session != session)) {		\
+		trace_##_name(_args);					\
+		return;							\
+	}								\
+	rcu_read_lock_sched_notrace();					\
+	__i = statedump_direct.offset[LTTNG_DIRECT_##_name];		\
+	__end = statedump_direct.offset[LTTNG_DIRECT_##_name + 1];	\
+	for (; __i < __end; __i++) {					\
+		__event = statedump_direct.events[__i];			\
+		((void (*)(void *, _proto)) __event->desc->probe_callback) \
+			(__event, _args);				\
+	}								\
+	rcu_read_unlock_sched_notrace();				\
+}
+
+#include <instrumentation/events/lttng-module/lttng-statedump.h>
+
+#undef LTTNG_TRACEPOINT_EVENT
+#undef TRACE_HEADER_MULTI_READ
+
+static
+int lttng_statedump_direct_id(const struct lttng_event *event)
+{
+	unsigned int i;
+
+	if (event->instrumentation != LTTNG_KERNEL_TRACEPOINT)
+		return -1;
+	for (i = 0; i < NR_LTTNG_DIRECT; i++) {
+		if (!strcmp(event->desc->kname, statedump_direct_names[i]))
+			return i;
+	}
+	return -1;
+}
+
+/*
+ * Without memory for the events, the statedump falls back to the
+ * tracepoints.
+ */
+static
+void lttng_statedump_direct_init(struct lttng_session *session)
+{
+	unsigned int count[NR_LTTNG_DIRECT] = { 0 };
+	struct lttng_event *event;
+	unsigned int i, nr = 0;
+	int id;
+
+	lttng_lock_sessions();
+	list_for_each_entry(event, &session->events, list) {
+		id = lttng_statedump_direct_id(event);
+		if (id >= 0) {
+			count[id]++;
+			nr++;
+		}
+	}
+	statedump_direct.events = kmalloc_array(nr ? : 1,
+			sizeof(*statedump_direct.events), GFP_KERNEL);
+	if (!statedump_direct.events)
+		goto end;
+	statedump_direct.offset[0] = 0;
+	for (i = 0; i < NR_LTTNG_DIRECT; i++) {
+		statedump_direct.offset[i + 1] =
+			statedump_direct.offset[i] + count[i];
+		count[i] = statedump_direct.offset[i];
+	}
+	list_for_each_entry(event, &session->events, list) {
+		id = lttng_statedump_direct_id(event);
+		if (id >= 0)
+			statedump_direct.events[count[id]++] = event;
+	}
+	statedump_direct.session = session;
+end:
+	lttng_unlock_sessions();
+}
+
+static
+void lttng_statedump_direct_fini(void)
+{
+	statedump_direct.session = NULL;
+	kfree(statedump_direct.events);
+	statedump_direct.events = NULL;
+}
+
+static
+struct lttng_statedump_cache_slot *lttng_statedump_cache_lock(pid_t tgid,
+		spinlock_t **lock)
+{
+	unsigned int idx = hash_32(tgid, LTTNG_STATEDUMP_CACHE_ORDER);
+
+	*lock = &statedump_cache_locks[idx % LTTNG_STATEDUMP_CACHE_LOCKS];
+	spin_lock(*lock);
+	return &statedump_cache[idx];
+}
+
+static
+void lttng_statedump_cache_claim(struct lttng_statedump_cache_slot *slot,
+		pid_t tgid, u64 generation)
+{
+	slot->tgid = tgid;
+	slot->fd_hash = 0;
+	slot->generation = generation;
+	slot->fd_generation = generation;
+}
+
+static
+void lttng_statedump_cache_touch(struct task_struct *p)
+{
+	struct lttng_statedump_cache_slot *slot;
+	pid_t tgid = task_tgid_nr(p);
+	spinlock_t *lock;
+
+	/* Changes are visible to the next generation. */
+	slot = lttng_statedump_cache_lock(tgid, &lock);
+	lttng_statedump_cache_claim(slot, tgid,
+		atomic64_read(&statedump_generation) + 1);
+	spin_unlock(lock);
+}
+
+static
+void lttng_statedump_cache_fork(void *data, struct task_struct *parent,
+		struct task_struct *child)
+{
+	lttng_statedump_cache_touch(child);
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,4,0))
+static
+void lttng_statedump_cache_exec(void *data, struct task_struct *p,
+		pid_t old_pid, struct linux_binprm *bprm)
+{
+	lttng_statedump_cache_touch(p);
+}
+#endif
+
+static
+void lttng_statedump_cache_exit(void *data, struct task_struct *p)
+{
+	lttng_statedump_cache_touch(p);
+}
+
+static
+void lttng_statedump_cache_unregister(void)
+{
+	WARN_ON_ONCE(lttng_wrapper_tracepoint_probe_unregister(
+		"sched_process_fork", lttng_statedump_cache_fork, NULL));
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,4,0))
+	WARN_ON_ONCE(lttng_wrapper_tracepoint_probe_unregister(
+		"sched_process_exec", lttng_statedump_cache_exec, NULL));
+#endif
+	WARN_ON_ONCE(lttng_wrapper_tracepoint_probe_unregister(
+		"sched_process_exit", lttng_statedump_cache_exit, NULL));
+}
+
+/*
+ * Called with statedump mutex held.
+ */
+static
+int lttng_statedump_cache_enable(void)
+{
+	int ret, i;
+
+	if (statedump_cache)
+		return 0;
+	for (i = 0; i < LTTNG_STATEDUMP_CACHE_LOCKS; i++)
+		spin_lock_init(&statedump_cache_locks[i]);
+	statedump_cache = lttng_vzalloc(sizeof(*statedump_cache)
+			<< LTTNG_STATEDUMP_CACHE_ORDER);
+	if (!statedump_cache)
+		return -ENOMEM;
+	ret = lttng_wrapper_tracepoint_probe_register("sched_process_fork",
+			lttng_statedump_cache_fork, NULL);
+	if (ret)
+		goto fork_error;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,4,0))
+	ret = lttng_wrapper_tracepoint_probe_register("sched_process_exec",
+			lttng_statedump_cache_exec, NULL);
+	if (ret)
+		goto exec_error;
+#endif
+	ret = lttng_wrapper_tracepoint_probe_register("sched_process_exit",
+			lttng_statedump_cache_exit, NULL);
+	if (ret)
+		goto exit_error;
+	return 0;
+
+exit_error:
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,4,0))
+	WARN_ON_ONCE(lttng_wrapper_tracepoint_probe_unregister(
+		"sched_process_exec", lttng_statedump_cache_exec, NULL));
+exec_error:
+#endif
+	WARN_ON_ONCE(lttng_wrapper_tracepoint_probe_unregister(
+		"sched_process_fork", lttng_statedump_cache_fork, NULL));
+fork_error:
+	vfree(statedump_cache);
+	statedump_cache = NULL;
+	return ret;
+}
+
+/*
+ * Returns whether the process state must be dumped for a statedump of
+ * generation "generation" relative to generation "since".
+ */
+static
+bool lttng_statedump_process_changed(struct task_struct *g,
+		u64 since, u64 generation)
+{
+	struct lttng_statedump_cache_slot *slot;
+	pid_t tgid = task_tgid_nr(g);
+	spinlock_t *lock;
+	bool changed;
+
+	if (!statedump_cache)
+		return true;
+	slot = lttng_statedump_cache_lock(tgid, &lock);
+	if (slot->tgid != tgid)
+		lttng_statedump_cache_claim(slot, tgid, generation);
+	changed = slot->generation > since;
+	spin_unlock(lock);
+	return changed;
+}
+
+static
+int lttng_hash_one_fd(const void *p, struct file *file, unsigned int fd)
+{
+	u32 *hash = (u32 *) p;
+
+	*hash = jhash(&file, sizeof(file), *hash ^ fd);
+	return 0;
+}
+
+/*
+ * Called with task lock held.
+ */
+static
+bool lttng_statedump_fds_changed(struct task_struct *p,
+		struct files_struct *files, u64 since, u64 generation)
+{
+	struct lttng_statedump_cache_slot *slot;
+	pid_t tgid = task_tgid_nr(p);
+	spinlock_t *lock;
+	u32 hash = 0;
+	bool changed;
+
+	if (!statedump_cache)
+		return true;
+	lttng_iterate_fd(files, 0, lttng_hash_one_fd, &hash);
+	slot = lttng_statedump_cache_lock(tgid, &lock);
+	if (slot->tgid != tgid)
+		lttng_statedump_cache_claim(slot, tgid, generation);
+	if (slot->fd_hash != hash) {
+		slot->fd_hash = hash;
+		slot->fd_generation = generation;
+	}
+	changed = slot->generation > since || slot->fd_generation > since;
+	spin_unlock(lock);
+	return changed;
+}
+
+/*
+ * Per-session cache of the paths of the files whose descriptors were
+ * dumped, so the files opened by many processes are resolved once per
+ * statedump. Slots are indexed by a hash of the struct path, and are
+ * valid for the inode, device and inode generation they were filled
+ * with. A path is only reused by the statedump which resolved it, each
+ * statedump of the session being a new cache generation: files renamed
+ * in between are resolved again. Paths too long for a slot are not
+ * cached.
+ */
+#define LTTNG_STATEDUMP_PATH_CACHE_ORDER	12
+#define LTTNG_STATEDUMP_PATH_LEN		232
+
+struct lttng_statedump_path_slot {
+	const struct vfsmount *mnt;
+	const struct dentry *dentry;
+	unsigned long ino;
+	dev_t dev;
+	u32 i_generation;
+	u64 generation;			/* Statedump which resolved path */
+	char path[LTTNG_STATEDUMP_PATH_LEN];
+};
+
+struct lttng_statedump_path_cache {
+	u64 generation;
+	spinlock_t locks[LTTNG_STATEDUMP_CACHE_LOCKS];
+	struct lttng_statedump_path_slot slots[1U << LTTNG_STATEDUMP_PATH_CACHE_ORDER];
+};
+
+enum lttng_statedump_path_state {
+	LTTNG_STATEDUMP_PATH_MISS,
+	LTTNG_STATEDUMP_PATH_CACHED,	/* Copied into the context page */
+	LTTNG_STATEDUMP_PATH_DUMPED,	/* Dumped by the session before */
 };
 
+/*
+ * Called with statedump mutex held, before the statedump of file
+ * descriptors.
+ */
+static
+int lttng_statedump_path_cache_enable(struct lttng_session *session)
+{
+	struct lttng_statedump_path_cache *cache = session->statedump_paths;
+	int i;
+
+	if (!cache) {
+		cache = lttng_vzalloc(sizeof(*cache));
+		if (!cache)
+			return -ENOMEM;
+		for (i = 0; i < LTTNG_STATEDUMP_CACHE_LOCKS; i++)
+			spin_lock_init(&cache->locks[i]);
+		session->statedump_paths = cache;
+	}
+	cache->generation++;
+	return 0;
+}
+
+static
+struct lttng_statedump_path_slot *lttng_statedump_path_lock(
+		struct lttng_statedump_path_cache *cache,
+		const struct path *path, spinlock_t **lock)
+{
+	unsigned int idx = hash_long((unsigned long) path->dentry
+			^ (unsigned long) path->mnt,
+			LTTNG_STATEDUMP_PATH_CACHE_ORDER);
+
+	*lock = &cache->locks[idx % LTTNG_STATEDUMP_CACHE_LOCKS];
+	spin_lock(*lock);
+	return &cache->slots[idx];
+}
+
+static
+bool lttng_statedump_path_match(const struct lttng_statedump_path_slot *slot,
+		const struct path *path, const struct inode *inode)
+{
+	return slot->dentry == path->dentry && slot->mnt == path->mnt
+		&& slot->ino == inode->i_ino
+		&& slot->dev == inode->i_sb->s_dev
+		&& slot->i_generation == inode->i_generation;
+}
+
+static
+enum lttng_statedump_path_state lttng_statedump_path_lookup(
+		const struct lttng_fd_ctx *ctx, struct file *file,
+		const struct inode *inode)
+{
+	struct lttng_statedump_path_cache *cache = ctx->session->statedump_paths;
+	enum lttng_statedump_path_state state = LTTNG_STATEDUMP_PATH_MISS;
+	struct lttng_statedump_path_slot *slot;
+	spinlock_t *lock;
+
+	if (!cache || !inode)
+		return LTTNG_STATEDUMP_PATH_MISS;
+	slot = lttng_statedump_path_lock(cache, &file->f_path, &lock);
+	if (!lttng_statedump_path_match(slot, &file->f_path, inode))
+		goto end;
+	if (ctx->flags & LTTNG_KERNEL_STATEDUMP_FLAG_FD_INODE) {
+		state = LTTNG_STATEDUMP_PATH_DUMPED;
+	} else if (slot->generation == cache->generation) {
+		strcpy(ctx->page, slot->path);
+		state = LTTNG_STATEDUMP_PATH_CACHED;
+	}
+end:
+	spin_unlock(lock);
+	return state;
+}
+
+static
+void lttng_statedump_path_insert(const struct lttng_fd_ctx *ctx,
+		struct file *file, const struct inode *inode, const char *s)
+{
+	struct lttng_statedump_path_cache *cache = ctx->session->statedump_paths;
+	struct lttng_statedump_path_slot *slot;
+	size_t len = strlen(s);
+	spinlock_t *lock;
+
+	if (!cache || !inode || len >= LTTNG_STATEDUMP_PATH_LEN)
+		return;
+	slot = lttng_statedump_path_lock(cache, &file->f_path, &lock);
+	slot->mnt = file->f_path.mnt;
+	slot->dentry = file->f_path.dentry;
+	slot->ino = inode->i_ino;
+	slot->dev = inode->i_sb->s_dev;
+	slot->i_generation = inode->i_generation;
+	slot->generation = cache->generation;
+	memcpy(slot->path, s, len + 1);
+	spin_unlock(lock);
+}
+
 /*
  * Protected by the trace lock.
  */
-static struct delayed_work cpu_work[NR_CPUS];
+static struct lttng_statedump_work cpu_work[NR_CPUS];
 static DECLARE_WAIT_QUEUE_HEAD(statedump_wq);
 static atomic_t kernel_threads_to_run;
 
+static inline
+bool lttng_statedump_chunk_owns(struct task_struct *g,
+		unsigned int index, unsigned int nr)
+{
+	return task_tgid_nr(g) % nr == index;
+}
+
 enum lttng_thread_type {
 	LTTNG_USER_THREAD = 0,
 	LTTNG_KERNEL_THREAD = 1,
@@ -162,7 +685,7 @@ int lttng_enumerate_block_devices(struct lttng_session *session)
 				class_dev_iter_exit(&iter);
 				return -ENOSYS;
 			}
-			trace_lttng_statedump_block_device(session,
+			direct_trace_lttng_statedump_block_device(session,
 					part_devt(part), name_buf);
 		}
 		disk_part_iter_exit(&piter);
@@ -185,13 +708,13 @@ void lttng_enumerate_device(struct lttng_session *session,
 		if (in_dev) {
 			for (ifa = in_dev->ifa_list; ifa != NULL;
 			     ifa = ifa->ifa_next) {
-				trace_lttng_statedump_network_interface(
+				direct_trace_lttng_statedump_network_interface(
 					session, dev, ifa);
 			}
 			in_dev_put(in_dev);
 		}
 	} else {
-		trace_lttng_statedump_network_interface(
+		direct_trace_lttng_statedump_network_interface(
 			session, dev, NULL);
 	}
 }
@@ -220,9 +743,12 @@ static
 int lttng_dump_one_fd(const void *p, struct file *file, unsigned int fd)
 {
 	const struct lttng_fd_ctx *ctx = p;
-	const char *s = d_path(&file->f_path, ctx->page, PAGE_SIZE);
+	const struct inode *inode = file->f_path.dentry->d_inode;
 	unsigned int flags = file->f_flags;
+	unsigned long ino = 0;
 	struct fdtable *fdt;
+	const char *s;
+	dev_t dev = 0;
 
 	/*
 	 * We don't expose kernel internal flags, only userspace-visible
@@ -241,33 +767,57 @@ int lttng_dump_one_fd(const void *p, struct file *file, unsigned int fd)
 	 */
 	if (fd < fdt->max_fds && lttng_close_on_exec(fd, fdt))
 		flags |= O_CLOEXEC;
+	if (inode) {
+		ino = inode->i_ino;
+		dev = inode->i_sb->s_dev;
+	}
+	switch (lttng_statedump_path_lookup(ctx, file, inode)) {
+	case LTTNG_STATEDUMP_PATH_DUMPED:
+		direct_trace_lttng_statedump_file_descriptor_inode(ctx->session,
+			ctx->p, fd, flags, file->f_mode, ino, dev);
+		return 0;
+	case LTTNG_STATEDUMP_PATH_CACHED:
+		s = ctx->page;
+		break;
+	default:
+		s = d_path(&file->f_path, ctx->page, PAGE_SIZE);
+		if (!IS_ERR(s))
+			lttng_statedump_path_insert(ctx, file, inode, s);
+		break;
+	}
 	if (IS_ERR(s)) {
 		struct dentry *dentry = file->f_path.dentry;
 
 		/* Make sure we give at least some info */
 		spin_lock(&dentry->d_lock);
-		trace_lttng_statedump_file_descriptor(ctx->session, ctx->p, fd,
-			dentry->d_name.name, flags, file->f_mode);
+		direct_trace_lttng_statedump_file_descriptor(ctx->session,
+			ctx->p, fd, dentry->d_name.name, flags, file->f_mode,
+			ino, dev);
 		spin_unlock(&dentry->d_lock);
 		goto end;
 	}
-	trace_lttng_statedump_file_descriptor(ctx->session, ctx->p, fd, s,
-		flags, file->f_mode);
+	direct_trace_lttng_statedump_file_descriptor(ctx->session, ctx->p, fd, s,
+		flags, file->f_mode, ino, dev);
 end:
 	return 0;
 }
 
 static
 void lttng_enumerate_task_fd(struct lttng_session *session,
-		struct task_struct *p, char *tmp)
+		struct task_struct *p, char *tmp, u64 since, u64 generation,
+		unsigned int flags)
 {
-	struct lttng_fd_ctx ctx = { .page = tmp, .session = session, .p = p };
+	struct lttng_fd_ctx ctx = {
+		.page = tmp, .session = session, .p = p, .flags = flags,
+	};
 	struct files_struct *files;
 
 	task_lock(p);
 	files = p->files;
 	if (!files)
 		goto end;
+	if (!lttng_statedump_fds_changed(p, files, since, generation))
+		goto end;
 	ctx.files = files;
 	lttng_iterate_fd(files, 0, lttng_dump_one_fd, &ctx);
 end:
@@ -275,7 +825,9 @@ end:
 }
 
 static
-int lttng_enumerate_file_descriptors(struct lttng_session *session)
+int lttng_enumerate_file_descriptors(struct lttng_session *session,
+		unsigned int index, unsigned int nr,
+		u64 since, u64 generation, unsigned int flags)
 {
 	struct task_struct *p;
 	char *tmp;
@@ -286,60 +838,98 @@ int lttng_enumerate_file_descriptors(struct lttng_session *session)
 
 	/* Enumerate active file descriptors */
 	rcu_read_lock();
-	for_each_process(p)
-		lttng_enumerate_task_fd(session, p, tmp);
+	for_each_process(p) {
+		if (!lttng_statedump_chunk_owns(p, index, nr))
+			continue;
+		lttng_enumerate_task_fd(session, p, tmp, since, generation,
+				flags);
+	}
 	rcu_read_unlock();
 	free_page((unsigned long) tmp);
 	return 0;
 }
 
-#if 0
 /*
- * FIXME: we cannot take a mmap_sem while in a RCU read-side critical section
- * (scheduling in atomic). Normally, the tasklist lock protects this kind of
- * iteration, but it is not exported to modules.
+ * The vm map statedump stays out of the way of the page faults of the
+ * traced processes: an mm whose mmap_sem is contended is skipped rather
+ * than waited for, and only file-backed mappings are dumped. An mm
+ * shared by several processes, e.g. after clone(CLONE_VM) without
+ * CLONE_THREAD, is dumped once, for the first of them. The mms dumped
+ * are referenced until the end of the walk so their address cannot be
+ * reused meanwhile.
+ */
+#define LTTNG_STATEDUMP_MM_SEEN_ORDER	12
+
+static
+bool lttng_statedump_mm_seen(struct mm_struct **seen, struct mm_struct *mm)
+{
+	unsigned int mask = (1U << LTTNG_STATEDUMP_MM_SEEN_ORDER) - 1;
+	unsigned int idx = hash_ptr(mm, LTTNG_STATEDUMP_MM_SEEN_ORDER), i;
+
+	for (i = 0; i <= mask; i++, idx = (idx + 1) & mask) {
+		if (seen[idx] == mm)
+			return true;
+		if (!seen[idx]) {
+			atomic_inc(&mm->mm_count);
+			seen[idx] = mm;
+			return false;
+		}
+	}
+	/* Full: dump the mm again rather than miss it. */
+	return false;
+}
+
+/*
+ * Called with RCU read-side lock held. Must not sleep: the task lock
+ * keeps the mm of the task until exit_mm(), without reference to drop.
  */
 static
 void lttng_enumerate_task_vm_maps(struct lttng_session *session,
-		struct task_struct *p)
+		struct task_struct *p, struct mm_struct **seen)
 {
-	struct mm_struct *mm;
 	struct vm_area_struct *map;
-	unsigned long ino;
-
-	/* get_task_mm does a task_lock... */
-	mm = get_task_mm(p);
-	if (!mm)
-		return;
+	struct mm_struct *mm;
 
-	map = mm->mmap;
-	if (map) {
-		down_read(&mm->mmap_sem);
-		while (map) {
-			if (map->vm_file)
-				ino = map->vm_file->lttng_f_dentry->d_inode->i_ino;
-			else
-				ino = 0;
-			trace_lttng_statedump_vm_map(session, p, map, ino);
-			map = map->vm_next;
-		}
-		up_read(&mm->mmap_sem);
+	task_lock(p);
+	mm = p->mm;
+	if (!mm || !down_read_trylock(&mm->mmap_sem))
+		goto end;
+	if (lttng_statedump_mm_seen(seen, mm))
+		goto unlock;
+	for (map = mm->mmap; map; map = map->vm_next) {
+		if (!map->vm_file)
+			continue;
+		direct_trace_lttng_statedump_vm_map(session, p, map,
+			map->vm_file->lttng_f_dentry->d_inode->i_ino);
 	}
-	mmput(mm);
+unlock:
+	up_read(&mm->mmap_sem);
+end:
+	task_unlock(p);
 }
 
 static
 int lttng_enumerate_vm_maps(struct lttng_session *session)
 {
+	struct mm_struct **seen;
 	struct task_struct *p;
+	unsigned int i;
 
+	seen = kcalloc(1U << LTTNG_STATEDUMP_MM_SEEN_ORDER, sizeof(*seen),
+			GFP_KERNEL);
+	if (!seen)
+		return -ENOMEM;
 	rcu_read_lock();
 	for_each_process(p)
-		lttng_enumerate_task_vm_maps(session, p);
+		lttng_enumerate_task_vm_maps(session, p, seen);
 	rcu_read_unlock();
+	for (i = 0; i < (1U << LTTNG_STATEDUMP_MM_SEEN_ORDER); i++) {
+		if (seen[i])
+			mmdrop(seen[i]);
+	}
+	kfree(seen);
 	return 0;
 }
-#endif
 
 #ifdef CONFIG_LTTNG_HAS_LIST_IRQ
 
@@ -364,7 +954,7 @@ int lttng_list_interrupts(struct lttng_session *session)
 		local_irq_save(flags);
 		wrapper_desc_spin_lock(&desc->lock);
 		for (action = desc->action; action; action = action->next) {
-			trace_lttng_statedump_interrupt(session,
+			direct_trace_lttng_statedump_interrupt(session,
 				irq, irq_chip_name, action);
 		}
 		wrapper_desc_spin_unlock(&desc->lock);
@@ -381,6 +971,123 @@ int lttng_list_interrupts(struct lttng_session *session)
 }
 #endif
 
+/*
+ * The following tables are small: they are dumped by the statedump
+ * thread, rather than split in chunks among the per-cpu workers.
+ */
+static
+int lttng_enumerate_modules(struct lttng_session *session)
+{
+	struct list_head *modules = wrapper_get_modules_list();
+	struct module *mod;
+
+	if (!modules)
+		return -ENOSYS;
+	rcu_read_lock_sched();
+	list_for_each_entry_rcu(mod, modules, list) {
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,8,0))
+		if (mod->state == MODULE_STATE_UNFORMED)
+			continue;
+#endif
+		direct_trace_lttng_statedump_module(session, mod->name,
+			lttng_module_core_base(mod),
+			lttng_module_core_size(mod));
+	}
+	rcu_read_unlock_sched();
+	return 0;
+}
+
+static
+int lttng_enumerate_softirqs(struct lttng_session *session)
+{
+	const char * const *names = wrapper_get_softirq_to_name();
+	struct softirq_action *vec = wrapper_get_softirq_vec();
+	unsigned int i;
+
+	if (!names || !vec)
+		return -ENOSYS;
+	for (i = 0; i < NR_SOFTIRQS; i++)
+		direct_trace_lttng_statedump_softirq(session, i, names[i],
+			(unsigned long) vec[i].action);
+	return 0;
+}
+
+static
+int lttng_enumerate_swap_files(struct lttng_session *session)
+{
+	struct swap_info_struct **swap_info;
+	spinlock_t *swap_lock;
+	unsigned int type;
+	char *page;
+
+	swap_info = wrapper_get_swap_info(&swap_lock);
+	if (!swap_info)
+		return -ENOSYS;
+	page = (char *) __get_free_page(GFP_KERNEL);
+	if (!page)
+		return -ENOMEM;
+	spin_lock(swap_lock);
+	for (type = 0; type < MAX_SWAPFILES; type++) {
+		struct swap_info_struct *si = swap_info[type];
+		char *path;
+
+		if (!si || (si->flags & (SWP_USED | SWP_WRITEOK))
+				!= (SWP_USED | SWP_WRITEOK))
+			continue;
+		path = d_path(&si->swap_file->f_path, page, PAGE_SIZE);
+		if (IS_ERR(path))
+			path = "";
+		direct_trace_lttng_statedump_swap_file(session, type, path,
+			si->pages, si->inuse_pages, si->prio);
+	}
+	spin_unlock(swap_lock);
+	free_page((unsigned long) page);
+	return 0;
+}
+
+#ifdef CONFIG_X86
+/* The interrupt descriptor table is shared by all CPUs. */
+static
+int lttng_dump_idt_table(struct lttng_session *session)
+{
+	const gate_desc *idt;
+	struct desc_ptr dt;
+	unsigned int vector;
+	unsigned long handler;
+
+	store_idt(&dt);
+	idt = (const gate_desc *) dt.address;
+	for (vector = 0; vector < (dt.size + 1) / sizeof(gate_desc); vector++) {
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,14,0))
+		handler = gate_offset(&idt[vector]);
+#else
+		handler = gate_offset(idt[vector]);
+#endif
+		if (handler)
+			direct_trace_lttng_statedump_idt_vector(session,
+				vector, handler);
+	}
+	return 0;
+}
+#else
+static inline
+int lttng_dump_idt_table(struct lttng_session *session)
+{
+	return -ENOSYS;
+}
+#endif
+
+/* Categories the kernel cannot provide are skipped with a warning. */
+static
+int lttng_statedump_supported(int ret, const char *what)
+{
+	if (ret != -ENOSYS)
+		return ret;
+	printk(KERN_WARNING "LTTng: %s enumeration is not supported by kernel\n",
+		what);
+	return 0;
+}
+
 /*
  * Called with task lock held.
  */
@@ -413,12 +1120,12 @@ void lttng_statedump_process_ns(struct lttng_session *session,
 	if (proxy) {
 		pid_ns = lttng_get_proxy_pid_ns(proxy);
 		do {
-			trace_lttng_statedump_process_state(session,
+			direct_trace_lttng_statedump_process_state(session,
 				p, type, mode, submode, status, pid_ns);
 			pid_ns = pid_ns->parent;
 		} while (pid_ns);
 	} else {
-		trace_lttng_statedump_process_state(session,
+		direct_trace_lttng_statedump_process_state(session,
 			p, type, mode, submode, status, NULL);
 	}
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,17,0) || \
@@ -432,12 +1139,18 @@ void lttng_statedump_process_ns(struct lttng_session *session,
 }
 
 static
-int lttng_enumerate_process_states(struct lttng_session *session)
+int lttng_enumerate_process_states(struct lttng_session *session,
+		unsigned int index, unsigned int nr,
+		u64 since, u64 generation)
 {
 	struct task_struct *g, *p;
 
 	rcu_read_lock();
 	for_each_process(g) {
+		if (!lttng_statedump_chunk_owns(g, index, nr))
+			continue;
+		if (!lttng_statedump_process_changed(g, since, generation))
+			continue;
 		p = g;
 		do {
 			enum lttng_execution_mode mode =
@@ -499,44 +1212,279 @@ void lttng_statedump_work_func(struct work_struct *work)
 }
 
 static
-int do_lttng_statedump(struct lttng_session *session)
+void lttng_statedump_chunk_work_func(struct work_struct *work)
 {
-	int cpu, ret;
+	struct lttng_statedump_work *sw = container_of(work,
+			struct lttng_statedump_work, work.work);
 
-	trace_lttng_statedump_start(session);
-	ret = lttng_enumerate_process_states(session);
-	if (ret)
-		return ret;
-	ret = lttng_enumerate_file_descriptors(session);
-	if (ret)
-		return ret;
-	/*
-	 * FIXME
-	 * ret = lttng_enumerate_vm_maps(session);
-	 * if (ret)
-	 * 	return ret;
-	 */
-	ret = lttng_list_interrupts(session);
-	if (ret)
-		return ret;
-	ret = lttng_enumerate_network_ip_interface(session);
-	if (ret)
-		return ret;
-	ret = lttng_enumerate_block_devices(session);
-	switch (ret) {
-	case 0:
-		break;
-	case -ENOSYS:
-		printk(KERN_WARNING "LTTng: block device enumeration is not supported by kernel\n");
-		break;
-	default:
-		return ret;
+	sw->ret = 0;
+	if (sw->categories & LTTNG_KERNEL_STATEDUMP_PROCESS)
+		sw->ret = lttng_enumerate_process_states(sw->session,
+				sw->index, sw->nr, sw->since, sw->generation);
+	if (!sw->ret && (sw->categories & LTTNG_KERNEL_STATEDUMP_FD))
+		sw->ret = lttng_enumerate_file_descriptors(sw->session,
+				sw->index, sw->nr, sw->since, sw->generation,
+				sw->flags);
+	lttng_statedump_work_func(work);
+}
+
+/*
+ * Dump processes and file descriptors in parallel, one chunk per online
+ * CPU. Called with CPU hotplug disabled.
+ */
+static
+int lttng_enumerate_process_chunks(struct lttng_session *session,
+		unsigned int categories, unsigned int flags,
+		u64 since, u64 generation)
+{
+	unsigned int index = 0, nr = num_online_cpus();
+	int cpu, ret = 0;
+
+	atomic_set(&kernel_threads_to_run, nr);
+	for_each_online_cpu(cpu) {
+		struct lttng_statedump_work *sw = &cpu_work[cpu];
+
+		sw->session = session;
+		sw->index = index++;
+		sw->nr = nr;
+		sw->categories = categories;
+		sw->flags = flags;
+		sw->since = since;
+		sw->generation = generation;
+		sw->ret = 0;
+		INIT_DELAYED_WORK(&sw->work, lttng_statedump_chunk_work_func);
+		schedule_delayed_work_on(cpu, &sw->work, 0);
+	}
+	__wait_event(statedump_wq, (atomic_read(&kernel_threads_to_run) == 0));
+	for_each_online_cpu(cpu) {
+		if (cpu_work[cpu].ret && !ret)
+			ret = cpu_work[cpu].ret;
+	}
+	return ret;
+}
+
+#ifdef LTTNG_HAVE_KALLSYMS_ON_EACH_SYMBOL
+/* Sessions which dumped the symbols, traced at module load and unload. */
+static LIST_HEAD(symbol_sessions);
+static DEFINE_MUTEX(symbol_sessions_mutex);
+
+struct lttng_symbol_ctx {
+	struct lttng_session *session;
+	struct module *mod;		/* Module of the previous symbol */
+	int dump_symbols;
+};
+
+static
+int lttng_dump_one_symbol(void *data, const char *name, struct module *mod,
+		unsigned long addr)
+{
+	struct lttng_symbol_ctx *ctx = data;
+
+	/* The symbols of a module are iterated consecutively. */
+	if (mod && mod != ctx->mod) {
+		direct_trace_lttng_statedump_module(ctx->session, mod->name,
+			lttng_module_core_base(mod),
+			lttng_module_core_size(mod));
+		ctx->mod = mod;
 	}
+	if (ctx->dump_symbols)
+		direct_trace_lttng_statedump_symbol(ctx->session, addr, name);
+	return 0;
+}
+
+/*
+ * The session is listed before the walk so no module loaded meanwhile is
+ * missed, at worst it is reported twice.
+ */
+static
+int lttng_enumerate_symbols(struct lttng_session *session)
+{
+	struct lttng_symbol_ctx ctx = {
+		.session = session,
+		.dump_symbols = !session->statedump_symbols,
+	};
+
+	mutex_lock(&symbol_sessions_mutex);
+	if (!session->statedump_symbols) {
+		list_add(&session->statedump_symbols_node, &symbol_sessions);
+		session->statedump_symbols = 1;
+	}
+	mutex_unlock(&symbol_sessions_mutex);
+	return wrapper_kallsyms_on_each_symbol(lttng_dump_one_symbol, &ctx);
+}
+
+static
+int lttng_statedump_module_notify(struct notifier_block *nb,
+		unsigned long val, void *data)
+{
+	struct module *mod = data;
+	struct lttng_session *session;
+
+	if (val != MODULE_STATE_COMING && val != MODULE_STATE_GOING)
+		return NOTIFY_OK;
+	mutex_lock(&symbol_sessions_mutex);
+	list_for_each_entry(session, &symbol_sessions, statedump_symbols_node) {
+		if (val == MODULE_STATE_COMING)
+			trace_lttng_statedump_module(session, mod->name,
+				lttng_module_core_base(mod),
+				lttng_module_core_size(mod));
+		else
+			trace_lttng_statedump_module_unload(session, mod->name,
+				lttng_module_core_base(mod));
+	}
+	mutex_unlock(&symbol_sessions_mutex);
+	return NOTIFY_OK;
+}
+
+static
+struct notifier_block lttng_statedump_module_notifier = {
+	.notifier_call = lttng_statedump_module_notify,
+};
+
+static
+void lttng_statedump_symbols_destroy(struct lttng_session *session)
+{
+	if (!session->statedump_symbols)
+		return;
+	mutex_lock(&symbol_sessions_mutex);
+	list_del(&session->statedump_symbols_node);
+	session->statedump_symbols = 0;
+	mutex_unlock(&symbol_sessions_mutex);
+}
+#else
+static
+int lttng_enumerate_symbols(struct lttng_session *session)
+{
+	return -ENOSYS;
+}
+
+static
+void lttng_statedump_symbols_destroy(struct lttng_session *session)
+{
+}
+#endif
+
+static
+void lttng_statedump_phase_end(struct lttng_session *session,
+		const char *phase, u64 *start)
+{
+	u64 now = trace_clock_read64();
+
+	direct_trace_lttng_statedump_phase(session, phase, now - *start);
+	*start = now;
+}
 
-	/* TODO lttng_dump_idt_table(session); */
-	/* TODO lttng_dump_softirq_vec(session); */
-	/* TODO lttng_list_modules(session); */
-	/* TODO lttng_dump_swap_files(session); */
+static
+int _do_lttng_statedump(struct lttng_session *session,
+		unsigned int categories, unsigned int flags,
+		u64 since, u64 *generation)
+{
+	u64 current_generation = 0, phase_start;
+	int cpu, ret;
+
+	if (generation) {
+		/* A delta requires the cache to cover "since". */
+		if (!statedump_cache && since)
+			return -EINVAL;
+		if (since > atomic64_read(&statedump_generation))
+			return -EINVAL;
+		ret = lttng_statedump_cache_enable();
+		if (ret)
+			return ret;
+	}
+	if (categories & LTTNG_KERNEL_STATEDUMP_FD) {
+		ret = lttng_statedump_path_cache_enable(session);
+		if (ret)
+			return ret;
+	}
+	if (statedump_cache)
+		current_generation = atomic64_inc_return(&statedump_generation);
+	direct_trace_lttng_statedump_start(session);
+	phase_start = trace_clock_read64();
+	if (categories & (LTTNG_KERNEL_STATEDUMP_PROCESS
+			| LTTNG_KERNEL_STATEDUMP_FD)) {
+		get_online_cpus();
+		ret = lttng_enumerate_process_chunks(session, categories,
+				flags, since, current_generation);
+		put_online_cpus();
+		if (ret)
+			return ret;
+		lttng_statedump_phase_end(session, "process", &phase_start);
+	}
+	if (categories & LTTNG_KERNEL_STATEDUMP_VM_MAP) {
+		ret = lttng_enumerate_vm_maps(session);
+		if (ret)
+			return ret;
+		lttng_statedump_phase_end(session, "vm_map", &phase_start);
+	}
+	if (categories & LTTNG_KERNEL_STATEDUMP_INTERRUPT) {
+		ret = lttng_list_interrupts(session);
+		if (ret)
+			return ret;
+		lttng_statedump_phase_end(session, "interrupt", &phase_start);
+	}
+	if (categories & LTTNG_KERNEL_STATEDUMP_NETWORK) {
+		ret = lttng_enumerate_network_ip_interface(session);
+		if (ret)
+			return ret;
+		lttng_statedump_phase_end(session, "network", &phase_start);
+	}
+	if (categories & LTTNG_KERNEL_STATEDUMP_BLOCK_DEVICE) {
+		ret = lttng_enumerate_block_devices(session);
+		switch (ret) {
+		case 0:
+			break;
+		case -ENOSYS:
+			printk(KERN_WARNING "LTTng: block device enumeration is not supported by kernel\n");
+			break;
+		default:
+			return ret;
+		}
+		lttng_statedump_phase_end(session, "block_device",
+				&phase_start);
+	}
+	if (categories & LTTNG_KERNEL_STATEDUMP_SYMBOL) {
+		ret = lttng_enumerate_symbols(session);
+		switch (ret) {
+		case 0:
+			break;
+		case -ENOSYS:
+			printk(KERN_WARNING "LTTng: symbol enumeration is not supported by kernel\n");
+			break;
+		default:
+			return ret;
+		}
+		lttng_statedump_phase_end(session, "symbol", &phase_start);
+	}
+	if (categories & LTTNG_KERNEL_STATEDUMP_MODULE) {
+		ret = lttng_statedump_supported(lttng_enumerate_modules(session),
+				"module");
+		if (ret)
+			return ret;
+		lttng_statedump_phase_end(session, "module", &phase_start);
+	}
+	if (categories & LTTNG_KERNEL_STATEDUMP_SOFTIRQ) {
+		ret = lttng_statedump_supported(
+				lttng_enumerate_softirqs(session), "softirq");
+		if (ret)
+			return ret;
+		lttng_statedump_phase_end(session, "softirq", &phase_start);
+	}
+	if (categories & LTTNG_KERNEL_STATEDUMP_SWAP) {
+		ret = lttng_statedump_supported(
+				lttng_enumerate_swap_files(session),
+				"swap file");
+		if (ret)
+			return ret;
+		lttng_statedump_phase_end(session, "swap", &phase_start);
+	}
+	if (categories & LTTNG_KERNEL_STATEDUMP_IDT) {
+		ret = lttng_statedump_supported(lttng_dump_idt_table(session),
+				"interrupt descriptor table");
+		if (ret)
+			return ret;
+		lttng_statedump_phase_end(session, "idt", &phase_start);
+	}
 
 	/*
 	 * Fire off a work queue on each CPU. Their sole purpose in life
@@ -546,26 +1494,81 @@ int do_lttng_statedump(struct lttng_session *session)
 	get_online_cpus();
 	atomic_set(&kernel_threads_to_run, num_online_cpus());
 	for_each_online_cpu(cpu) {
-		INIT_DELAYED_WORK(&cpu_work[cpu], lttng_statedump_work_func);
-		schedule_delayed_work_on(cpu, &cpu_work[cpu], 0);
+		INIT_DELAYED_WORK(&cpu_work[cpu].work,
+				lttng_statedump_work_func);
+		schedule_delayed_work_on(cpu, &cpu_work[cpu].work, 0);
 	}
 	/* Wait for all threads to run */
 	__wait_event(statedump_wq, (atomic_read(&kernel_threads_to_run) == 0));
 	put_online_cpus();
+	lttng_statedump_phase_end(session, "cpu_sync", &phase_start);
 	/* Our work is done */
-	trace_lttng_statedump_end(session);
+	direct_trace_lttng_statedump_end(session);
+	if (generation)
+		*generation = current_generation;
 	return 0;
 }
 
+int do_lttng_statedump(struct lttng_session *session,
+		unsigned int categories, unsigned int flags,
+		u64 since, u64 *generation)
+{
+	int ret;
+
+	lttng_statedump_direct_init(session);
+	ret = _do_lttng_statedump(session, categories, flags, since,
+			generation);
+	lttng_statedump_direct_fini();
+	return ret;
+}
+
 /*
- * Called with session mutex held.
+ * Called with the session lock held.
  */
 int lttng_statedump_start(struct lttng_session *session)
 {
-	return do_lttng_statedump(session);
+	int ret;
+
+	mutex_lock(&statedump_mutex);
+	ret = do_lttng_statedump(session, LTTNG_KERNEL_STATEDUMP_ALL, 0,
+			0, NULL);
+	mutex_unlock(&statedump_mutex);
+	return ret;
 }
 EXPORT_SYMBOL_GPL(lttng_statedump_start);
 
+/*
+ * Only dump the selected categories, and only the processes and file
+ * descriptors which changed after generation "since", 0 meaning a full
+ * statedump. Processes which exited since then are not reported. On
+ * success, "generation" is set to the generation of this statedump.
+ * Called with the session lock held.
+ */
+int lttng_statedump_start_delta(struct lttng_session *session,
+		u64 since, unsigned int categories, unsigned int flags,
+		u64 *generation)
+{
+	int ret;
+
+	mutex_lock(&statedump_mutex);
+	ret = do_lttng_statedump(session, categories, flags, since,
+			generation);
+	mutex_unlock(&statedump_mutex);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(lttng_statedump_start_delta);
+
+/*
+ * Called on session destroy, when no statedump of the session can run.
+ */
+void lttng_statedump_session_destroy(struct lttng_session *session)
+{
+	vfree(session->statedump_paths);
+	session->statedump_paths = NULL;
+	lttng_statedump_symbols_destroy(session);
+}
+EXPORT_SYMBOL_GPL(lttng_statedump_session_destroy);
+
 static
 int __init lttng_statedump_init(void)
 {
@@ -576,7 +1579,11 @@ int __init lttng_statedump_init(void)
 	 * "tracepoint_module_notify" is turned into a static function.
 	 */
 	(void) wrapper_lttng_fixup_sig(THIS_MODULE);
+#ifdef LTTNG_HAVE_KALLSYMS_ON_EACH_SYMBOL
+	return register_module_notifier(&lttng_statedump_module_notifier);
+#else
 	return 0;
+#endif
 }
 
 module_init(lttng_statedump_init);
@@ -584,6 +1591,15 @@ module_init(lttng_statedump_init);
 static
 void __exit lttng_statedump_exit(void)
 {
+#ifdef LTTNG_HAVE_KALLSYMS_ON_EACH_SYMBOL
+	unregister_module_notifier(&lttng_statedump_module_notifier);
+#endif
+	if (statedump_cache) {
+		lttng_statedump_cache_unregister();
+		/* Wait for in-flight cache probes. */
+		synchronize_sched();
+		vfree(statedump_cache);
+	}
 }
 
 module_exit(lttng_statedump_exit);
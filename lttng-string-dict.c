@@ -0,0 +1,185 @@
+/*
+ * lttng-string-dict.c
+ *
+ * LTTng string dictionary. In a channel with a string dictionary, the
+ * text fields declared with ctf_array_text_dict() and ctf_string_dict()
+ * are recorded as a 64-bit id. The first use of an id in a packet is
+ * preceded by a lttng_string_dict record holding the id and its text,
+ * so each packet can be decoded on its own.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <wrapper/ringbuffer/frontend.h>
+
+#define LTTNG_STRING_DICT_BITS		8
+#define LTTNG_STRING_DICT_SLOTS		(1U << LTTNG_STRING_DICT_BITS)
+/* Never a packet offset, which is a multiple of the sub-buffer size. */
+#define LTTNG_STRING_DICT_INVALID	1UL
+
+/*
+ * Last definition of an id in a direct-mapped slot: the buffer and the
+ * packet it was recorded in.
+ */
+struct lttng_string_dict_slot {
+	uint64_t id;
+	struct lib_ring_buffer *buf;
+	unsigned long packet;
+};
+
+struct lttng_string_dict {
+	struct lttng_string_dict_slot slots[LTTNG_STRING_DICT_SLOTS];
+};
+
+static const struct lttng_event_field lttng_string_dict_fields[] = {
+	{
+		.name = "id",
+		.type = __type_integer(uint64_t, 0, 0, -1, __BYTE_ORDER, 16, none),
+	},
+	{
+		.name = "value",
+		.type = {
+			.atype = atype_string,
+			.u.basic.string.encoding = lttng_encode_UTF8,
+		},
+	},
+};
+
+static const struct lttng_event_desc lttng_string_dict_desc = {
+	.name = "lttng_string_dict",
+	.fields = lttng_string_dict_fields,
+	.nr_fields = ARRAY_SIZE(lttng_string_dict_fields),
+	.owner = THIS_MODULE,
+};
+
+/*
+ * Called by probes before reserving the record using the text, with
+ * preemption disabled. A nested record may find the slot being updated:
+ * it then records its own definition. A record ending up in the packet
+ * following its definition, when it crosses a packet boundary, is only
+ * decoded with the definitions of the previous packets.
+ */
+void lttng_string_dict_define(struct lttng_event *event, const char *str,
+		size_t len)
+{
+	struct lttng_channel *chan = event->chan;
+	struct lttng_event *dict_event = chan->string_dict_event;
+	const struct lib_ring_buffer_config *config = &chan->chan->backend.config;
+	struct lttng_probe_ctx lttng_probe_ctx = {
+		.event = dict_event,
+	};
+	struct lttng_string_dict_slot *slot;
+	struct lib_ring_buffer_ctx ctx;
+	struct lib_ring_buffer *buf;
+	unsigned long packet;
+	uint64_t id;
+	int ret;
+
+	id = lttng_string_dict_id(str, len);
+	slot = &this_cpu_ptr(chan->string_dict)->slots[id & (LTTNG_STRING_DICT_SLOTS - 1)];
+	buf = channel_get_ring_buffer(config, chan->chan, smp_processor_id());
+	if (ACCESS_ONCE(slot->id) == id && ACCESS_ONCE(slot->buf) == buf
+			&& ACCESS_ONCE(slot->packet)
+				== subbuf_trunc(v_read(config, &buf->offset), chan->chan))
+		return;
+	lttng_event_stats_inc(dict_event, hit);
+	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx,
+			sizeof(id) + len + 1, lttng_alignof(id), -1);
+	ret = chan->ops->event_reserve(&ctx, dict_event->id);
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(dict_event, ret);
+		return;
+	}
+	packet = subbuf_trunc(ctx.buf_offset, chan->chan);
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(id));
+	chan->ops->event_write(&ctx, &id, sizeof(id));
+	chan->ops->event_strcpy(&ctx, str, len + 1);
+	chan->ops->event_commit(&ctx);
+
+	ACCESS_ONCE(slot->packet) = LTTNG_STRING_DICT_INVALID;
+	barrier();
+	ACCESS_ONCE(slot->id) = id;
+	ACCESS_ONCE(slot->buf) = ctx.buf;
+	barrier();
+	ACCESS_ONCE(slot->packet) = packet;
+}
+EXPORT_SYMBOL_GPL(lttng_string_dict_define);
+
+/*
+ * Forget the definitions, e.g. when the channel buffers are replaced.
+ * Should be called with sessions mutex held, without writers.
+ */
+void lttng_string_dict_reset(struct lttng_channel *chan)
+{
+	int cpu;
+
+	if (!chan->string_dict)
+		return;
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(chan->string_dict, cpu), 0,
+			sizeof(struct lttng_string_dict));
+}
+
+/*
+ * The dictionary applies to the events created in the channel from then
+ * on, and stays enabled until the channel is destroyed. The definition
+ * event lives until the session is destroyed, like the other events of
+ * the channel.
+ */
+int lttng_channel_string_dict(struct lttng_channel *chan)
+{
+	struct lttng_string_dict __percpu *dict;
+	struct lttng_kernel_event ev;
+	struct lttng_event *event;
+	int ret = 0;
+
+	if (chan->channel_type != PER_CPU_CHANNEL)
+		return -EINVAL;
+	lttng_lock_sessions();
+	if (chan->string_dict)
+		goto unlock;
+	dict = alloc_percpu(struct lttng_string_dict);
+	if (!dict) {
+		ret = -ENOMEM;
+		goto unlock;
+	}
+	memset(&ev, 0, sizeof(ev));
+	strncpy(ev.name, lttng_string_dict_desc.name,
+		LTTNG_KERNEL_SYM_NAME_LEN);
+	ev.name[LTTNG_KERNEL_SYM_NAME_LEN - 1] = '\0';
+	ev.instrumentation = LTTNG_KERNEL_NOOP;
+	event = _lttng_event_create(chan, &ev, NULL,
+			&lttng_string_dict_desc, ev.instrumentation);
+	if (IS_ERR(event)) {
+		ret = PTR_ERR(event);
+		free_percpu(dict);
+		goto unlock;
+	}
+	/* Noop events need to be explicitly enabled. */
+	ACCESS_ONCE(event->enabled) = 1;
+	lttng_event_update_effective_enabled(event);
+	chan->string_dict_event = event;
+	chan->string_dict = dict;
+unlock:
+	lttng_unlock_sessions();
+	return ret;
+}
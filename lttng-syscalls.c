@@ -31,6 +31,11 @@
 #include <linux/stringify.h>
 #include <linux/file.h>
 #include <linux/anon_inodes.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/pid.h>
+#include <linux/pid_namespace.h>
+#include <linux/binfmts.h>
 #include <asm/ptrace.h>
 #include <asm/syscall.h>
 
@@ -38,6 +43,11 @@
 #include <wrapper/tracepoint.h>
 #include <wrapper/file.h>
 #include <wrapper/rcu.h>
+#include <wrapper/vmalloc.h>
+#include <wrapper/vzalloc.h>
+#include <wrapper/trace-clock.h>
+#include <wrapper/pid_namespace.h>
+#include <wrapper/syscall_tracepoint.h>
 #include <lttng-events.h>
 
 #ifndef CONFIG_COMPAT
@@ -371,6 +381,142 @@ struct lttng_syscall_filter {
 	DECLARE_BITMAP(sc_compat, NR_compat_syscalls);
 };
 
+/*
+ * Per-channel dispatch, indexed by system call number. Entry and exit
+ * events of a system call share a cache line, and a NULL event means
+ * the system call is filtered out, so the probes only touch this line
+ * on the fast path. System calls without an event map to the unknown
+ * events. Mirrors the event tables and sc_filter, which stay the
+ * reference for listing and updates.
+ */
+struct lttng_syscall_dispatch {
+	struct lttng_event *entry;
+	struct lttng_event *exit;
+};
+
+static
+bool syscall_dispatch_enabled(const unsigned long *filter_bitmap,
+		unsigned int nr, unsigned int i)
+{
+	return !filter_bitmap || (i < nr && test_bit(i, filter_bitmap));
+}
+
+/*
+ * Entries are updated in place: pointer stores are single-copy atomic,
+ * and events outlive the dispatch tables, so concurrent probes either
+ * see the old or the new state. Should be called with sessions lock
+ * held, after any update of the event tables or of sc_filter.
+ */
+static
+void syscall_dispatch_sync(struct lttng_channel *chan)
+{
+	struct lttng_syscall_filter *filter = chan->sc_filter;
+	unsigned int i;
+
+	if (!chan->sc_dispatch)
+		return;
+	for (i = 0; i < ARRAY_SIZE(sc_table); i++) {
+		struct lttng_syscall_dispatch *d = &chan->sc_dispatch[i];
+
+		if (!syscall_dispatch_enabled(filter ? filter->sc : NULL,
+				NR_syscalls, i)) {
+			ACCESS_ONCE(d->entry) = NULL;
+			ACCESS_ONCE(d->exit) = NULL;
+			continue;
+		}
+		ACCESS_ONCE(d->entry) = chan->sc_table[i] ? : chan->sc_unknown;
+		ACCESS_ONCE(d->exit) = chan->sc_exit_table[i] ? :
+			chan->sc_exit_unknown;
+	}
+#ifdef CONFIG_COMPAT
+	if (!chan->compat_sc_dispatch)
+		return;
+	for (i = 0; i < ARRAY_SIZE(compat_sc_table); i++) {
+		struct lttng_syscall_dispatch *d = &chan->compat_sc_dispatch[i];
+
+		if (!syscall_dispatch_enabled(filter ? filter->sc_compat : NULL,
+				NR_compat_syscalls, i)) {
+			ACCESS_ONCE(d->entry) = NULL;
+			ACCESS_ONCE(d->exit) = NULL;
+			continue;
+		}
+		ACCESS_ONCE(d->entry) = chan->compat_sc_table[i] ? :
+			chan->sc_compat_unknown;
+		ACCESS_ONCE(d->exit) = chan->compat_sc_exit_table[i] ? :
+			chan->compat_sc_exit_unknown;
+	}
+#endif
+}
+
+#define LTTNG_SYSCALL_LATENCY_ORDER	13
+
+/*
+ * Entry timestamps, indexed by a hash of the thread id. A thread is in
+ * at most one system call at a time, so a slot is only shared between
+ * threads colliding on the same hash. When pairing fails, the exit
+ * record is emitted as usual.
+ */
+struct lttng_syscall_latency_slot {
+	u64 ident;		/* tid << 32 | syscall id, 0: free */
+	u64 timestamp;
+};
+
+struct lttng_syscall_latency_tracker {
+	u64 threshold;		/* ns */
+	struct lttng_syscall_latency_slot slots[1U << LTTNG_SYSCALL_LATENCY_ORDER];
+};
+
+static
+struct lttng_syscall_latency_slot *syscall_latency_slot(
+		struct lttng_syscall_latency_tracker *tracker,
+		long id, u64 *ident)
+{
+	pid_t tid = task_pid_nr(current);
+
+	*ident = ((u64) tid << 32) | (u32) id;
+	return &tracker->slots[hash_32(tid, LTTNG_SYSCALL_LATENCY_ORDER)];
+}
+
+static
+void syscall_latency_entry(struct lttng_syscall_latency_tracker *tracker,
+		long id)
+{
+	struct lttng_syscall_latency_slot *slot;
+	u64 ident;
+
+	slot = syscall_latency_slot(tracker, id, &ident);
+	slot->timestamp = trace_clock_read64();
+	ACCESS_ONCE(slot->ident) = ident;
+}
+
+/*
+ * Returns true if the exit has been paired with its entry, in which case
+ * the regular exit record must not be emitted.
+ */
+static
+bool syscall_latency_exit(struct lttng_channel *chan,
+		struct lttng_syscall_latency_tracker *tracker,
+		long id, long ret)
+{
+	struct lttng_syscall_latency_slot *slot;
+	u64 ident, duration;
+
+	slot = syscall_latency_slot(tracker, id, &ident);
+	if (ACCESS_ONCE(slot->ident) != ident)
+		return false;
+	duration = trace_clock_read64() - slot->timestamp;
+	ACCESS_ONCE(slot->ident) = 0;
+	if (duration < tracker->threshold)
+		return true;
+	if (unlikely(in_compat_syscall()))
+		__event_probe__compat_syscall_latency(chan->compat_sc_latency,
+			id, ret, duration);
+	else
+		__event_probe__syscall_latency(chan->sc_latency,
+			id, ret, duration);
+	return true;
+}
+
 static void syscall_entry_unknown(struct lttng_event *event,
 	struct pt_regs *regs, unsigned int id)
 {
@@ -388,49 +534,42 @@ void syscall_entry_probe(void *__data, struct pt_regs *regs, long id)
 	struct lttng_channel *chan = __data;
 	struct lttng_event *event, *unknown_event;
 	const struct trace_syscall_entry *table, *entry;
+	const struct lttng_syscall_dispatch *dispatch;
+	struct lttng_syscall_latency_tracker *tracker;
 	size_t table_len;
 
 	if (unlikely(in_compat_syscall())) {
-		struct lttng_syscall_filter *filter;
-
-		filter = lttng_rcu_dereference(chan->sc_filter);
-		if (filter) {
-			if (id < 0 || id >= NR_compat_syscalls
-				|| !test_bit(id, filter->sc_compat)) {
-				/* System call filtered out. */
-				return;
-			}
-		}
+		dispatch = chan->compat_sc_dispatch;
 		table = compat_sc_table;
 		table_len = ARRAY_SIZE(compat_sc_table);
 		unknown_event = chan->sc_compat_unknown;
 	} else {
-		struct lttng_syscall_filter *filter;
-
-		filter = lttng_rcu_dereference(chan->sc_filter);
-		if (filter) {
-			if (id < 0 || id >= NR_syscalls
-				|| !test_bit(id, filter->sc)) {
-				/* System call filtered out. */
-				return;
-			}
-		}
+		dispatch = chan->sc_dispatch;
 		table = sc_table;
 		table_len = ARRAY_SIZE(sc_table);
 		unknown_event = chan->sc_unknown;
 	}
 	if (unlikely(id < 0 || id >= table_len)) {
+		/* Out of table system calls only match "all". */
+		if (lttng_rcu_dereference(chan->sc_filter))
+			return;
 		syscall_entry_unknown(unknown_event, regs, id);
 		return;
 	}
-	if (unlikely(in_compat_syscall()))
-		event = chan->compat_sc_table[id];
-	else
-		event = chan->sc_table[id];
-	if (unlikely(!event)) {
+	event = ACCESS_ONCE(dispatch[id].entry);
+	if (!event) {
+		/* System call filtered out. */
+		return;
+	}
+	if (unlikely(event == unknown_event)) {
 		syscall_entry_unknown(unknown_event, regs, id);
 		return;
 	}
+	tracker = lttng_rcu_dereference(chan->sc_latency_tracker);
+	if (tracker) {
+		syscall_latency_entry(tracker, id);
+		return;
+	}
 	entry = &table[id];
 	WARN_ON_ONCE(!entry);
 
@@ -540,51 +679,42 @@ void syscall_exit_probe(void *__data, struct pt_regs *regs, long ret)
 	struct lttng_channel *chan = __data;
 	struct lttng_event *event, *unknown_event;
 	const struct trace_syscall_entry *table, *entry;
+	const struct lttng_syscall_dispatch *dispatch;
+	struct lttng_syscall_latency_tracker *tracker;
 	size_t table_len;
 	long id;
 
 	id = syscall_get_nr(current, regs);
 	if (unlikely(in_compat_syscall())) {
-		struct lttng_syscall_filter *filter;
-
-		filter = lttng_rcu_dereference(chan->sc_filter);
-		if (filter) {
-			if (id < 0 || id >= NR_compat_syscalls
-				|| !test_bit(id, filter->sc_compat)) {
-				/* System call filtered out. */
-				return;
-			}
-		}
+		dispatch = chan->compat_sc_dispatch;
 		table = compat_sc_exit_table;
 		table_len = ARRAY_SIZE(compat_sc_exit_table);
 		unknown_event = chan->compat_sc_exit_unknown;
 	} else {
-		struct lttng_syscall_filter *filter;
-
-		filter = lttng_rcu_dereference(chan->sc_filter);
-		if (filter) {
-			if (id < 0 || id >= NR_syscalls
-				|| !test_bit(id, filter->sc)) {
-				/* System call filtered out. */
-				return;
-			}
-		}
+		dispatch = chan->sc_dispatch;
 		table = sc_exit_table;
 		table_len = ARRAY_SIZE(sc_exit_table);
 		unknown_event = chan->sc_exit_unknown;
 	}
 	if (unlikely(id < 0 || id >= table_len)) {
+		/* Out of table system calls only match "all". */
+		if (lttng_rcu_dereference(chan->sc_filter))
+			return;
 		syscall_exit_unknown(unknown_event, regs, id, ret);
 		return;
 	}
-	if (unlikely(in_compat_syscall()))
-		event = chan->compat_sc_exit_table[id];
-	else
-		event = chan->sc_exit_table[id];
-	if (unlikely(!event)) {
+	event = ACCESS_ONCE(dispatch[id].exit);
+	if (!event) {
+		/* System call filtered out. */
+		return;
+	}
+	if (unlikely(event == unknown_event)) {
 		syscall_exit_unknown(unknown_event, regs, id, ret);
 		return;
 	}
+	tracker = lttng_rcu_dereference(chan->sc_latency_tracker);
+	if (tracker && syscall_latency_exit(chan, tracker, id, ret))
+		return;
 	entry = &table[id];
 	WARN_ON_ONCE(!entry);
 
@@ -776,6 +906,14 @@ int lttng_syscalls_register(struct lttng_channel *chan, void *filter)
 		if (!chan->sc_exit_table)
 			return -ENOMEM;
 	}
+	if (!chan->sc_dispatch) {
+		/* Starts empty: filled by syscall_dispatch_sync(). */
+		chan->sc_dispatch = kcalloc(ARRAY_SIZE(sc_table),
+					sizeof(struct lttng_syscall_dispatch),
+					GFP_KERNEL);
+		if (!chan->sc_dispatch)
+			return -ENOMEM;
+	}
 
 
 #ifdef CONFIG_COMPAT
@@ -794,6 +932,14 @@ int lttng_syscalls_register(struct lttng_channel *chan, void *filter)
 		if (!chan->compat_sc_exit_table)
 			return -ENOMEM;
 	}
+
+	if (!chan->compat_sc_dispatch) {
+		chan->compat_sc_dispatch = kcalloc(ARRAY_SIZE(compat_sc_table),
+					sizeof(struct lttng_syscall_dispatch),
+					GFP_KERNEL);
+		if (!chan->compat_sc_dispatch)
+			return -ENOMEM;
+	}
 #endif
 	if (!chan->sc_unknown) {
 		const struct lttng_event_desc *desc =
@@ -862,6 +1008,39 @@ int lttng_syscalls_register(struct lttng_channel *chan, void *filter)
 		}
 	}
 
+	if (!chan->sc_latency) {
+		const struct lttng_event_desc *desc =
+			&__event_desc___syscall_latency;
+
+		memset(&ev, 0, sizeof(ev));
+		strncpy(ev.name, desc->name, LTTNG_KERNEL_SYM_NAME_LEN);
+		ev.name[LTTNG_KERNEL_SYM_NAME_LEN - 1] = '\0';
+		ev.instrumentation = LTTNG_KERNEL_SYSCALL;
+		chan->sc_latency = _lttng_event_create(chan, &ev, filter,
+						desc, ev.instrumentation);
+		WARN_ON_ONCE(!chan->sc_latency);
+		if (IS_ERR(chan->sc_latency)) {
+			return PTR_ERR(chan->sc_latency);
+		}
+	}
+
+	if (!chan->compat_sc_latency) {
+		const struct lttng_event_desc *desc =
+			&__event_desc___compat_syscall_latency;
+
+		memset(&ev, 0, sizeof(ev));
+		strncpy(ev.name, desc->name, LTTNG_KERNEL_SYM_NAME_LEN);
+		ev.name[LTTNG_KERNEL_SYM_NAME_LEN - 1] = '\0';
+		ev.instrumentation = LTTNG_KERNEL_SYSCALL;
+		chan->compat_sc_latency = _lttng_event_create(chan, &ev,
+						filter, desc,
+						ev.instrumentation);
+		WARN_ON_ONCE(!chan->compat_sc_latency);
+		if (IS_ERR(chan->compat_sc_latency)) {
+			return PTR_ERR(chan->compat_sc_latency);
+		}
+	}
+
 	ret = fill_table(sc_table, ARRAY_SIZE(sc_table),
 			chan->sc_table, chan, filter, SC_TYPE_ENTRY);
 	if (ret)
@@ -883,6 +1062,15 @@ int lttng_syscalls_register(struct lttng_channel *chan, void *filter)
 	if (ret)
 		return ret;
 #endif
+	syscall_dispatch_sync(chan);
+	return lttng_syscalls_arm(chan);
+}
+
+static
+int syscall_probes_register(struct lttng_channel *chan)
+{
+	int ret;
+
 	if (!chan->sys_enter_registered) {
 		ret = lttng_wrapper_tracepoint_probe_register("sys_enter",
 				(void *) syscall_entry_probe, chan);
@@ -900,91 +1088,395 @@ int lttng_syscalls_register(struct lttng_channel *chan, void *filter)
 		if (ret) {
 			WARN_ON_ONCE(lttng_wrapper_tracepoint_probe_unregister("sys_enter",
 				(void *) syscall_entry_probe, chan));
+			chan->sys_enter_registered = 0;
 			return ret;
 		}
 		chan->sys_exit_registered = 1;
 	}
-	return ret;
+	return 0;
 }
 
-/*
- * Only called at session destruction.
- */
-int lttng_syscalls_unregister(struct lttng_channel *chan)
+static
+int syscall_probes_unregister(struct lttng_channel *chan)
 {
 	int ret;
 
-	if (!chan->sc_table)
-		return 0;
-	if (chan->sys_enter_registered) {
+	if (chan->sys_exit_registered) {
 		ret = lttng_wrapper_tracepoint_probe_unregister("sys_exit",
 				(void *) syscall_exit_probe, chan);
 		if (ret)
 			return ret;
-		chan->sys_enter_registered = 0;
+		chan->sys_exit_registered = 0;
 	}
-	if (chan->sys_exit_registered) {
+	if (chan->sys_enter_registered) {
 		ret = lttng_wrapper_tracepoint_probe_unregister("sys_enter",
 				(void *) syscall_entry_probe, chan);
 		if (ret)
 			return ret;
-		chan->sys_exit_registered = 0;
+		chan->sys_enter_registered = 0;
 	}
+	return 0;
+}
+
+/*
+ * Per-task arming. The kernel sends the system calls of every task
+ * through the syscall tracepoints while they have probes. When all the
+ * channels with syscall probes attached have sc_tracked_tasks set and
+ * belong to sessions tracking PIDs or PID namespaces, the task filter
+ * lists these sessions, and only the tasks one of them tracks keep
+ * their syscall tracepoint flag. Fork and exec probes set the flag of
+ * tasks as they are created or change PID, tracker updates set it for
+ * the tasks they affect. Once the filter is gone, every task has its
+ * flag set again, as left by the kernel when the probes were attached.
+ *
+ * The armed channel list and the filter updates are protected by the
+ * sessions lock. Probes read the filter with RCU.
+ */
+struct lttng_syscall_task_filter {
+	unsigned int nr_sessions;
+	struct lttng_session *sessions[];
+};
+
+static LIST_HEAD(sc_armed_channels);
+static struct lttng_syscall_task_filter *sc_task_filter;
+static int sc_task_probes_registered;
+
+/*
+ * Called with RCU read-side lock held, preemption disabled, for tasks
+ * other than current.
+ */
+static
+bool syscall_task_tracked(const struct lttng_syscall_task_filter *filter,
+		struct task_struct *t)
+{
+	unsigned int i;
+
+	for (i = 0; i < filter->nr_sessions; i++) {
+		struct lttng_session *session = filter->sessions[i];
+		struct lttng_pid_tracker *lpf;
+
+		lpf = lttng_rcu_dereference(session->pid_tracker);
+		if (lpf && !lttng_pid_tracker_lookup(lpf, t->pid))
+			continue;
+		lpf = lttng_rcu_dereference(session->pid_ns_tracker);
+		if (lpf && !lttng_pid_tracker_lookup(lpf,
+				lttng_task_pid_ns_inum(t)))
+			continue;
+		return true;
+	}
+	return false;
+}
+
+static
+void syscall_task_update(struct task_struct *t)
+{
+	const struct lttng_syscall_task_filter *filter;
+
+	filter = lttng_rcu_dereference(sc_task_filter);
+	if (!filter)
+		return;
+	lttng_task_syscall_tracepoint_set(t, syscall_task_tracked(filter, t));
+}
+
+static
+void syscall_task_fork(void *data, struct task_struct *parent,
+		struct task_struct *child)
+{
+	syscall_task_update(child);
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,4,0))
+/* A thread other than the leader gets the PID of the leader at exec. */
+static
+void syscall_task_exec(void *data, struct task_struct *p,
+		pid_t old_pid, struct linux_binprm *bprm)
+{
+	syscall_task_update(p);
+}
+#endif
+
+static
+int syscall_task_probes_register(void)
+{
+	int ret;
+
+	if (sc_task_probes_registered)
+		return 0;
+	ret = lttng_wrapper_tracepoint_probe_register("sched_process_fork",
+			(void *) syscall_task_fork, NULL);
+	if (ret)
+		return ret;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,4,0))
+	ret = lttng_wrapper_tracepoint_probe_register("sched_process_exec",
+			(void *) syscall_task_exec, NULL);
+	if (ret) {
+		WARN_ON_ONCE(lttng_wrapper_tracepoint_probe_unregister(
+			"sched_process_fork", (void *) syscall_task_fork,
+			NULL));
+		return ret;
+	}
+#endif
+	sc_task_probes_registered = 1;
+	return 0;
+}
+
+static
+void syscall_task_probes_unregister(void)
+{
+	if (!sc_task_probes_registered)
+		return;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,4,0))
+	WARN_ON_ONCE(lttng_wrapper_tracepoint_probe_unregister(
+		"sched_process_exec", (void *) syscall_task_exec, NULL));
+#endif
+	WARN_ON_ONCE(lttng_wrapper_tracepoint_probe_unregister(
+		"sched_process_fork", (void *) syscall_task_fork, NULL));
+	sc_task_probes_registered = 0;
+}
+
+/*
+ * Returns the filter for the armed channels, NULL if all the tasks
+ * must take the syscall tracepoints, or if it cannot be allocated.
+ */
+static
+struct lttng_syscall_task_filter *syscall_task_filter_create(void)
+{
+	struct lttng_syscall_task_filter *filter;
+	struct lttng_channel *chan;
+	unsigned int nr = 0, i;
+
+	if (list_empty(&sc_armed_channels))
+		return NULL;
+	list_for_each_entry(chan, &sc_armed_channels, sc_armed_node) {
+		if (!chan->sc_tracked_tasks)
+			return NULL;
+		if (!chan->session->pid_tracker
+				&& !chan->session->pid_ns_tracker)
+			return NULL;
+		nr++;
+	}
+	filter = kzalloc(sizeof(*filter) + nr * sizeof(filter->sessions[0]),
+			GFP_KERNEL);
+	if (!filter)
+		return NULL;
+	list_for_each_entry(chan, &sc_armed_channels, sc_armed_node) {
+		for (i = 0; i < filter->nr_sessions; i++) {
+			if (filter->sessions[i] == chan->session)
+				break;
+		}
+		if (i == filter->nr_sessions)
+			filter->sessions[filter->nr_sessions++] = chan->session;
+	}
+	return filter;
+}
+
+static
+bool syscall_task_filter_equal(const struct lttng_syscall_task_filter *a,
+		const struct lttng_syscall_task_filter *b)
+{
+	if (!a || !b)
+		return a == b;
+	return a->nr_sessions == b->nr_sessions
+		&& !memcmp(a->sessions, b->sessions,
+			a->nr_sessions * sizeof(a->sessions[0]));
+}
+
+/* Without filter, every task takes the syscall tracepoints. */
+static
+void syscall_task_filter_apply(const struct lttng_syscall_task_filter *filter,
+		struct task_struct *t)
+{
+	preempt_disable();
+	lttng_task_syscall_tracepoint_set(t,
+		!filter || syscall_task_tracked(filter, t));
+	preempt_enable();
+}
+
+/*
+ * Update the task filter after a change of the armed channels or of
+ * the trackers of their sessions: "pid" is the PID whose tracking
+ * changed, -1 for a change affecting any task, 0 for none. Every task
+ * is updated when the filter changes. Should be called with sessions
+ * lock held.
+ */
+void lttng_syscalls_task_sync(int pid)
+{
+	struct lttng_syscall_task_filter *filter, *old = sc_task_filter;
+	struct task_struct *g, *p;
+
+	filter = syscall_task_filter_create();
+	if (filter && syscall_task_probes_register()) {
+		kfree(filter);
+		filter = NULL;
+	}
+	if (syscall_task_filter_equal(filter, old)) {
+		kfree(filter);
+		filter = old;
+		if (!filter || !pid)
+			return;
+	} else {
+		if (!filter && !old)
+			return;
+		rcu_assign_pointer(sc_task_filter, filter);
+		/* Fork and exec probes see the new filter from then on. */
+		synchronize_trace();
+		kfree(old);
+		pid = -1;
+	}
+	rcu_read_lock();
+	if (pid > 0) {
+		p = pid_task(find_pid_ns(pid, &init_pid_ns), PIDTYPE_PID);
+		if (p)
+			syscall_task_filter_apply(filter, p);
+	} else {
+		for_each_process(g) {
+			p = g;
+			do {
+				syscall_task_filter_apply(filter, p);
+			} while_each_thread(g, p);
+		}
+	}
+	rcu_read_unlock();
+	if (!filter)
+		syscall_task_probes_unregister();
+}
+
+static
+void syscall_task_arm(struct lttng_channel *chan, int armed)
+{
+	if (chan->sc_armed == armed)
+		return;
+	if (armed)
+		list_add(&chan->sc_armed_node, &sc_armed_channels);
+	else
+		list_del(&chan->sc_armed_node);
+	chan->sc_armed = armed;
+	lttng_syscalls_task_sync(0);
+}
+
+/*
+ * The sys_enter/sys_exit probes are only attached while the channel and
+ * its session are both enabled, so that a stopped session leaves the
+ * syscall tracepoints, and the syscall slow path they force on every
+ * task, turned off. Should be called with sessions lock held, after any
+ * change of the channel or session enable state.
+ *
+ * The task flags are restored before the probes are detached: the
+ * kernel only clears them when the last probe goes away.
+ */
+int lttng_syscalls_arm(struct lttng_channel *chan)
+{
+	int ret;
+
+	if (!chan->sc_table)
+		return 0;
+	if (chan->enabled && chan->session->active) {
+		ret = syscall_probes_register(chan);
+		if (ret)
+			return ret;
+		syscall_task_arm(chan, 1);
+		return 0;
+	}
+	syscall_task_arm(chan, 0);
+	return syscall_probes_unregister(chan);
+}
+
+/*
+ * Only called at session destruction.
+ */
+int lttng_syscalls_unregister(struct lttng_channel *chan)
+{
+	int ret;
+
+	if (!chan->sc_table)
+		return 0;
+	syscall_task_arm(chan, 0);
+	ret = syscall_probes_unregister(chan);
+	if (ret)
+		return ret;
 	/* lttng_event destroy will be performed by lttng_session_destroy() */
 	kfree(chan->sc_table);
 	kfree(chan->sc_exit_table);
+	kfree(chan->sc_dispatch);
 #ifdef CONFIG_COMPAT
 	kfree(chan->compat_sc_table);
 	kfree(chan->compat_sc_exit_table);
+	kfree(chan->compat_sc_dispatch);
 #endif
 	kfree(chan->sc_filter);
 	return 0;
 }
 
+/*
+ * Syscall numbers indexed by name, without the table prefix, built at
+ * module init. The nodes of a table are indexed like its entries.
+ */
+#define SYSCALL_NAME_HT_BITS	10
+
+static struct hlist_head sc_name_ht[1 << SYSCALL_NAME_HT_BITS];
+static struct hlist_node sc_name_nodes[ARRAY_SIZE(sc_table)];
+static struct hlist_head compat_sc_name_ht[1 << SYSCALL_NAME_HT_BITS];
+static struct hlist_node compat_sc_name_nodes[ARRAY_SIZE(compat_sc_table)];
+
 static
-int get_syscall_nr(const char *syscall_name)
+u32 syscall_name_hash(const char *name)
 {
-	int syscall_nr = -1;
-	int i;
+	return hash_32(jhash(name, strlen(name), 0), SYSCALL_NAME_HT_BITS);
+}
 
-	for (i = 0; i < ARRAY_SIZE(sc_table); i++) {
-		const struct trace_syscall_entry *entry;
-		const char *it_name;
+static
+void syscall_name_ht_fill(const struct trace_syscall_entry *table,
+		size_t table_len, struct hlist_node *nodes,
+		struct hlist_head *ht, size_t prefix_len)
+{
+	size_t i;
 
-		entry = &sc_table[i];
-		if (!entry->desc)
+	for (i = 0; i < table_len; i++) {
+		if (!table[i].desc)
 			continue;
-		it_name = entry->desc->name;
-		it_name += strlen(SYSCALL_ENTRY_STR);
-		if (!strcmp(syscall_name, it_name)) {
-			syscall_nr = i;
-			break;
-		}
+		hlist_add_head(&nodes[i],
+			&ht[syscall_name_hash(table[i].desc->name + prefix_len)]);
 	}
-	return syscall_nr;
 }
 
 static
-int get_compat_syscall_nr(const char *syscall_name)
+int syscall_name_ht_lookup(const struct trace_syscall_entry *table,
+		const struct hlist_node *nodes, struct hlist_head *ht,
+		size_t prefix_len, const char *syscall_name)
 {
-	int syscall_nr = -1;
-	int i;
+	struct hlist_node *node;
 
-	for (i = 0; i < ARRAY_SIZE(compat_sc_table); i++) {
-		const struct trace_syscall_entry *entry;
-		const char *it_name;
+	hlist_for_each(node, &ht[syscall_name_hash(syscall_name)]) {
+		int nr = node - nodes;
 
-		entry = &compat_sc_table[i];
-		if (!entry->desc)
-			continue;
-		it_name = entry->desc->name;
-		it_name += strlen(COMPAT_SYSCALL_ENTRY_STR);
-		if (!strcmp(syscall_name, it_name)) {
-			syscall_nr = i;
-			break;
-		}
+		if (!strcmp(syscall_name, table[nr].desc->name + prefix_len))
+			return nr;
 	}
-	return syscall_nr;
+	return -1;
+}
+
+static
+int get_syscall_nr(const char *syscall_name)
+{
+	return syscall_name_ht_lookup(sc_table, sc_name_nodes, sc_name_ht,
+			strlen(SYSCALL_ENTRY_STR), syscall_name);
+}
+
+static
+int get_compat_syscall_nr(const char *syscall_name)
+{
+	return syscall_name_ht_lookup(compat_sc_table, compat_sc_name_nodes,
+			compat_sc_name_ht, strlen(COMPAT_SYSCALL_ENTRY_STR),
+			syscall_name);
+}
+
+void lttng_syscalls_init(void)
+{
+	syscall_name_ht_fill(sc_table, ARRAY_SIZE(sc_table), sc_name_nodes,
+			sc_name_ht, strlen(SYSCALL_ENTRY_STR));
+	syscall_name_ht_fill(compat_sc_table, ARRAY_SIZE(compat_sc_table),
+			compat_sc_name_nodes, compat_sc_name_ht,
+			strlen(COMPAT_SYSCALL_ENTRY_STR));
 }
 
 static
@@ -1006,6 +1498,7 @@ int lttng_syscall_filter_enable(struct lttng_channel *chan,
 		if (chan->sc_filter) {
 			filter = chan->sc_filter;
 			rcu_assign_pointer(chan->sc_filter, NULL);
+			syscall_dispatch_sync(chan);
 			synchronize_trace();
 			kfree(filter);
 		}
@@ -1049,6 +1542,7 @@ int lttng_syscall_filter_enable(struct lttng_channel *chan,
 	}
 	if (!chan->sc_filter)
 		rcu_assign_pointer(chan->sc_filter, filter);
+	syscall_dispatch_sync(chan);
 	return 0;
 
 error:
@@ -1117,6 +1611,7 @@ apply_filter:
 	if (!chan->sc_filter)
 		rcu_assign_pointer(chan->sc_filter, filter);
 	chan->syscall_all = 0;
+	syscall_dispatch_sync(chan);
 	return 0;
 
 error:
@@ -1291,6 +1786,42 @@ long lttng_channel_syscall_mask(struct lttng_channel *channel,
 	return ret;
 }
 
+/*
+ * Pairing state is swapped with RCU, so it may be changed while tracing.
+ * Threads already in a system call are then recorded unpaired.
+ */
+int lttng_channel_syscall_latency(struct lttng_channel *channel,
+		const struct lttng_kernel_syscall_latency *param)
+{
+	struct lttng_syscall_latency_tracker *tracker = NULL, *old;
+
+	if (param->enabled) {
+		tracker = lttng_vzalloc(sizeof(*tracker));
+		if (!tracker)
+			return -ENOMEM;
+		tracker->threshold = param->threshold;
+		/* The tracker is touched from the syscall probes. */
+		wrapper_vmalloc_sync_all();
+	}
+	lttng_lock_sessions();
+	old = channel->sc_latency_tracker;
+	rcu_assign_pointer(channel->sc_latency_tracker, tracker);
+	lttng_unlock_sessions();
+	if (old) {
+		synchronize_trace();
+		vfree(old);
+	}
+	return 0;
+}
+
+/*
+ * Only called at channel destruction, after in-flight probes completed.
+ */
+void lttng_syscall_latency_destroy(struct lttng_channel *channel)
+{
+	vfree(channel->sc_latency_tracker);
+}
+
 int lttng_abi_syscall_list(void)
 {
 	struct file *syscall_list_file;
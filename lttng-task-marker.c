@@ -0,0 +1,185 @@
+/*
+ * lttng-task-marker.c
+ *
+ * LTTng task markers. A per-CPU channel with task markers enabled gets a
+ * compact record of the incoming task identity at each sched_switch, so
+ * its events can do without the tid, pid, procname and prio contexts:
+ * readers attribute each event to the task of the last marker seen on
+ * the same CPU.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/version.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <wrapper/ringbuffer/frontend_types.h>
+#include <wrapper/tracepoint.h>
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,9,0))
+#include <linux/sched/rt.h>	/* for MAX_RT_PRIO */
+#endif
+
+static const struct lttng_event_field lttng_task_marker_fields[] = {
+	{
+		.name = "tid",
+		.type = __type_integer(pid_t, 0, 0, -1, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "pid",
+		.type = __type_integer(pid_t, 0, 0, -1, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "prio",
+		.type = __type_integer(int, 0, 0, -1, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "procname",
+		.type = {
+			.atype = atype_array,
+			.u.array = {
+				.elem_type = __type_integer(char, 0, 0, 0,
+						__BYTE_ORDER, 10, UTF8),
+				.length = TASK_COMM_LEN,
+			},
+		},
+	},
+};
+
+static const struct lttng_event_desc lttng_task_marker_desc = {
+	.name = "lttng_task_marker",
+	.fields = lttng_task_marker_fields,
+	.nr_fields = ARRAY_SIZE(lttng_task_marker_fields),
+	.owner = THIS_MODULE,
+};
+
+/*
+ * Called with interrupts off, right before the CPU switches to "next".
+ * The pid tracker is not applied: it tests the outgoing task, and
+ * dropping a marker would misattribute every following event.
+ */
+static
+void lttng_task_marker_probe(void *__data,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0))
+		bool preempt,
+#elif (LINUX_VERSION_CODE < KERNEL_VERSION(2,6,35))
+		struct rq *rq,
+#endif
+		struct task_struct *prev, struct task_struct *next)
+{
+	struct lttng_event *event = __data;
+	struct lttng_probe_ctx lttng_probe_ctx = {
+		.event = event,
+	};
+	struct lttng_channel *chan = event->chan;
+	struct lib_ring_buffer_ctx ctx;
+	pid_t tid, pid;
+	int prio, ret;
+
+	if (unlikely(!ACCESS_ONCE(event->effective_enabled)))
+		return;
+	lttng_event_stats_inc(event, hit);
+	tid = next->pid;
+	pid = next->tgid;
+	prio = next->prio - MAX_RT_PRIO;
+	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx,
+			2 * sizeof(pid_t) + sizeof(int) + TASK_COMM_LEN,
+			lttng_alignof(int), -1);
+	ret = chan->ops->event_reserve(&ctx, event->id);
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(event, ret);
+		return;
+	}
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(tid));
+	chan->ops->event_write(&ctx, &tid, sizeof(tid));
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(pid));
+	chan->ops->event_write(&ctx, &pid, sizeof(pid));
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(prio));
+	chan->ops->event_write(&ctx, &prio, sizeof(prio));
+	chan->ops->event_write(&ctx, next->comm, TASK_COMM_LEN);
+	chan->ops->event_commit(&ctx);
+}
+
+/*
+ * Should be called with sessions mutex held.
+ */
+int lttng_task_marker_unregister(struct lttng_channel *chan)
+{
+	int ret;
+
+	if (!chan->task_marker_registered)
+		return 0;
+	ret = lttng_wrapper_tracepoint_probe_unregister("sched_switch",
+			(void *) lttng_task_marker_probe, chan->task_marker);
+	if (ret)
+		return ret;
+	chan->task_marker_registered = 0;
+	return 0;
+}
+
+/*
+ * The marker event is created on first enable, and lives until the
+ * session is destroyed, like the other events of the channel. Disabling
+ * only detaches the sched_switch probe.
+ */
+int lttng_channel_task_marker(struct lttng_channel *chan, int enable)
+{
+	struct lttng_event *event;
+	int ret = 0;
+
+	/* Markers apply to the following events of the same buffer only. */
+	if (chan->channel_type != PER_CPU_CHANNEL
+			|| chan->chan->backend.config.alloc != RING_BUFFER_ALLOC_PER_CPU
+			|| chan->chan->backend.config.cluster != RING_BUFFER_CLUSTER_CPU)
+		return -EINVAL;
+	lttng_lock_sessions();
+	if (!enable) {
+		ret = lttng_task_marker_unregister(chan);
+		goto unlock;
+	}
+	if (chan->task_marker_registered)
+		goto unlock;
+	if (!chan->task_marker) {
+		struct lttng_kernel_event ev;
+
+		memset(&ev, 0, sizeof(ev));
+		strncpy(ev.name, lttng_task_marker_desc.name,
+			LTTNG_KERNEL_SYM_NAME_LEN);
+		ev.name[LTTNG_KERNEL_SYM_NAME_LEN - 1] = '\0';
+		ev.instrumentation = LTTNG_KERNEL_NOOP;
+		event = _lttng_event_create(chan, &ev, NULL,
+				&lttng_task_marker_desc, ev.instrumentation);
+		if (IS_ERR(event)) {
+			ret = PTR_ERR(event);
+			goto unlock;
+		}
+		/* Noop events need to be explicitly enabled. */
+		ACCESS_ONCE(event->enabled) = 1;
+		lttng_event_update_effective_enabled(event);
+		chan->task_marker = event;
+	}
+	ret = lttng_wrapper_tracepoint_probe_register("sched_switch",
+			(void *) lttng_task_marker_probe, chan->task_marker);
+	if (!ret)
+		chan->task_marker_registered = 1;
+unlock:
+	lttng_unlock_sessions();
+	return ret;
+}
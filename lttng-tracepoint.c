@@ -27,9 +27,13 @@
 #include <linux/slab.h>
 #include <linux/jhash.h>
 #include <linux/module.h>
+#include <linux/vmalloc.h>
+#include <linux/sched.h>
 
+#include <lttng-kernel-version.h>
 #include <lttng-tracepoint.h>
 #include <wrapper/list.h>
+#include <wrapper/vzalloc.h>
 
 /*
  * Protect the tracepoint table. lttng_tracepoint_mutex nests within
@@ -39,10 +43,16 @@
 static
 DEFINE_MUTEX(lttng_tracepoint_mutex);
 
-#define TRACEPOINT_HASH_BITS 6
-#define TRACEPOINT_TABLE_SIZE (1 << TRACEPOINT_HASH_BITS)
+/*
+ * Holds every kernel and module tracepoint: keep the chains short. The
+ * table doubles whenever it holds more tracepoints than buckets.
+ */
+#define TRACEPOINT_HASH_MIN_BITS 10
+#define TRACEPOINT_HASH_MAX_BITS 14
 static
-struct hlist_head tracepoint_table[TRACEPOINT_TABLE_SIZE];
+struct hlist_head *tracepoint_table;
+static
+unsigned int tracepoint_hash_bits, nr_tracepoints;
 
 /*
  * The tracepoint entry is the node contained within the hash table. It
@@ -50,60 +60,131 @@ struct hlist_head tracepoint_table[TRACEPOINT_TABLE_SIZE];
  */
 struct tracepoint_entry {
 	struct hlist_node hlist;
+	u32 hash;			/* jhash of the name */
 	struct tracepoint *tp;
 	int refcount;
 	struct list_head probes;
+	struct list_head batch_node;	/* On tracepoint_batch_head if dirty */
 	char name[0];
 };
 
 struct lttng_tp_probe {
 	struct tracepoint_func tp_func;
 	struct list_head list;
+	unsigned int registered:1;	/* To the kernel tracepoint */
+	unsigned int removed:1;		/* Unregistered within the batch */
 };
 
+/*
+ * Registrations of the batch owner only update the probe lists: the
+ * kernel tracepoints of the entries they touch are updated once each
+ * by lttng_tracepoint_batch_end, and a probe unregistered then
+ * registered again within the batch is left untouched. Protected by
+ * lttng_tracepoint_mutex.
+ */
+static
+struct task_struct *tracepoint_batch_owner;
 static
-int add_probe(struct tracepoint_entry *e, void *probe, void *data)
+LIST_HEAD(tracepoint_batch_head);
+
+static
+int tracepoint_batched(void)
+{
+	return tracepoint_batch_owner == current;
+}
+
+static
+struct lttng_tp_probe *find_probe(struct tracepoint_entry *e,
+		void *probe, void *data)
 {
 	struct lttng_tp_probe *p;
-	int found = 0;
 
 	list_for_each_entry(p, &e->probes, list) {
-		if (p->tp_func.func == probe && p->tp_func.data == data) {
-			found = 1;
-			break;
-		}
+		if (p->tp_func.func == probe && p->tp_func.data == data)
+			return p;
 	}
-	if (found)
-		return -EEXIST;
+	return NULL;
+}
+
+static
+struct lttng_tp_probe *add_probe(struct tracepoint_entry *e,
+		void *probe, void *data)
+{
+	struct lttng_tp_probe *p;
+
+	if (find_probe(e, probe, data))
+		return ERR_PTR(-EEXIST);
 	p = kmalloc(sizeof(struct lttng_tp_probe), GFP_KERNEL);
 	if (!p)
-		return -ENOMEM;
+		return ERR_PTR(-ENOMEM);
 	p->tp_func.func = probe;
 	p->tp_func.data = data;
+	p->registered = 0;
+	p->removed = 0;
 	list_add(&p->list, &e->probes);
-	return 0;
+	return p;
 }
 
 static
-int remove_probe(struct tracepoint_entry *e, void *probe, void *data)
+void remove_probe(struct lttng_tp_probe *p)
 {
-	struct lttng_tp_probe *p;
-	int found = 0;
+	list_del(&p->list);
+	kfree(p);
+}
 
-	list_for_each_entry(p, &e->probes, list) {
-		if (p->tp_func.func == probe && p->tp_func.data == data) {
-			found = 1;
-			break;
+static
+struct hlist_head *tracepoint_table_alloc(unsigned int bits)
+{
+	size_t size = sizeof(struct hlist_head) << bits;
+
+	/* Zeroed hlist heads are empty. */
+	if (size <= PAGE_SIZE)
+		return kzalloc(size, GFP_KERNEL);
+	return lttng_vzalloc(size);
+}
+
+static
+void tracepoint_table_free(struct hlist_head *table)
+{
+	if (is_vmalloc_addr(table))
+		vfree(table);
+	else
+		kfree(table);
+}
+
+static
+struct hlist_head *tracepoint_head(u32 hash)
+{
+	return &tracepoint_table[hash & ((1U << tracepoint_hash_bits) - 1)];
+}
+
+/*
+ * Rehash into a table twice as large, keeping the current one if it
+ * cannot be allocated. Must be called with lttng_tracepoint_mutex held.
+ */
+static
+void grow_tracepoint_table(void)
+{
+	unsigned int bits = tracepoint_hash_bits + 1, i;
+	struct hlist_head *table;
+
+	table = tracepoint_table_alloc(bits);
+	if (!table)
+		return;
+	for (i = 0; i < (1U << tracepoint_hash_bits); i++) {
+		struct tracepoint_entry *e;
+		struct hlist_node *tmp;
+
+		lttng_hlist_for_each_entry_safe(e, tmp, &tracepoint_table[i],
+				hlist) {
+			hlist_del(&e->hlist);
+			hlist_add_head(&e->hlist,
+				&table[e->hash & ((1U << bits) - 1)]);
 		}
 	}
-	if (found) {
-		list_del(&p->list);
-		kfree(p);
-		return 0;
-	} else {
-		WARN_ON(1);
-		return -ENOENT;
-	}
+	tracepoint_table_free(tracepoint_table);
+	tracepoint_table = table;
+	tracepoint_hash_bits = bits;
 }
 
 /*
@@ -118,9 +199,9 @@ struct tracepoint_entry *get_tracepoint(const char *name)
 	struct tracepoint_entry *e;
 	u32 hash = jhash(name, strlen(name), 0);
 
-	head = &tracepoint_table[hash & (TRACEPOINT_TABLE_SIZE - 1)];
+	head = tracepoint_head(hash);
 	lttng_hlist_for_each_entry(e, head, hlist) {
-		if (!strcmp(name, e->name))
+		if (e->hash == hash && !strcmp(name, e->name))
 			return e;
 	}
 	return NULL;
@@ -138,9 +219,9 @@ struct tracepoint_entry *add_tracepoint(const char *name)
 	size_t name_len = strlen(name) + 1;
 	u32 hash = jhash(name, name_len - 1, 0);
 
-	head = &tracepoint_table[hash & (TRACEPOINT_TABLE_SIZE - 1)];
+	head = tracepoint_head(hash);
 	lttng_hlist_for_each_entry(e, head, hlist) {
-		if (!strcmp(name, e->name)) {
+		if (e->hash == hash && !strcmp(name, e->name)) {
 			printk(KERN_NOTICE
 				"tracepoint %s busy\n", name);
 			return ERR_PTR(-EEXIST);        /* Already there */
@@ -154,10 +235,15 @@ struct tracepoint_entry *add_tracepoint(const char *name)
 	if (!e)
 		return ERR_PTR(-ENOMEM);
 	memcpy(&e->name[0], name, name_len);
+	e->hash = hash;
 	e->tp = NULL;
 	e->refcount = 0;
 	INIT_LIST_HEAD(&e->probes);
+	INIT_LIST_HEAD(&e->batch_node);
 	hlist_add_head(&e->hlist, head);
+	if (++nr_tracepoints > (1U << tracepoint_hash_bits)
+			&& tracepoint_hash_bits < TRACEPOINT_HASH_MAX_BITS)
+		grow_tracepoint_table();
 	return e;
 }
 
@@ -168,13 +254,72 @@ struct tracepoint_entry *add_tracepoint(const char *name)
 static
 void remove_tracepoint(struct tracepoint_entry *e)
 {
+	list_del(&e->batch_node);
 	hlist_del(&e->hlist);
+	nr_tracepoints--;
 	kfree(e);
 }
 
+/*
+ * Update the kernel tracepoint of the entry to its probe list. Must be
+ * called with lttng_tracepoint_mutex held.
+ */
+static
+void sync_tracepoint(struct tracepoint_entry *e)
+{
+	struct lttng_tp_probe *p, *tmp;
+	int ret;
+
+	list_del_init(&e->batch_node);
+	list_for_each_entry_safe(p, tmp, &e->probes, list) {
+		if (p->removed) {
+			if (p->registered) {
+				ret = tracepoint_probe_unregister(e->tp,
+					p->tp_func.func, p->tp_func.data);
+				WARN_ON_ONCE(ret);
+			}
+			remove_probe(p);
+			e->refcount--;
+		} else if (e->tp && !p->registered) {
+			ret = tracepoint_probe_register(e->tp,
+					p->tp_func.func, p->tp_func.data);
+			WARN_ON_ONCE(ret);
+			p->registered = 1;
+		}
+	}
+	if (!e->refcount)
+		remove_tracepoint(e);
+}
+
+/*
+ * Defer the kernel tracepoint updates of the registrations of the
+ * calling task until lttng_tracepoint_batch_end. Registrations of other
+ * tasks are applied immediately.
+ */
+void lttng_tracepoint_batch_begin(void)
+{
+	mutex_lock(&lttng_tracepoint_mutex);
+	WARN_ON_ONCE(tracepoint_batch_owner);
+	tracepoint_batch_owner = current;
+	mutex_unlock(&lttng_tracepoint_mutex);
+}
+
+void lttng_tracepoint_batch_end(void)
+{
+	struct tracepoint_entry *e, *tmp;
+
+	mutex_lock(&lttng_tracepoint_mutex);
+	WARN_ON_ONCE(!tracepoint_batched());
+	tracepoint_batch_owner = NULL;
+	list_for_each_entry_safe(e, tmp, &tracepoint_batch_head, batch_node)
+		sync_tracepoint(e);
+	mutex_unlock(&lttng_tracepoint_mutex);
+}
+
 int lttng_tracepoint_probe_register(const char *name, void *probe, void *data)
 {
 	struct tracepoint_entry *e;
+	struct lttng_tp_probe *p;
 	int ret = 0;
 
 	mutex_lock(&lttng_tracepoint_mutex);
@@ -186,16 +331,31 @@ int lttng_tracepoint_probe_register(const char *name, void *probe, void *data)
 			goto end;
 		}
 	}
+	if (tracepoint_batched()) {
+		p = find_probe(e, probe, data);
+		if (p && p->removed) {
+			/* Unregistered within the batch: keep it as is. */
+			p->removed = 0;
+			goto end;
+		}
+	}
 	/* add (probe, data) to entry */
-	ret = add_probe(e, probe, data);
-	if (ret)
+	p = add_probe(e, probe, data);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
 		goto end;
+	}
 	e->refcount++;
-	if (e->tp) {
-		ret = tracepoint_probe_register(e->tp, probe, data);
-		WARN_ON_ONCE(ret);
-		ret = 0;
+	if (!e->tp)
+		goto end;
+	if (tracepoint_batched()) {
+		list_move_tail(&e->batch_node, &tracepoint_batch_head);
+		goto end;
 	}
+	ret = tracepoint_probe_register(e->tp, probe, data);
+	WARN_ON_ONCE(ret);
+	ret = 0;
+	p->registered = 1;
 end:
 	mutex_unlock(&lttng_tracepoint_mutex);
 	return ret;
@@ -204,6 +364,7 @@ end:
 int lttng_tracepoint_probe_unregister(const char *name, void *probe, void *data)
 {
 	struct tracepoint_entry *e;
+	struct lttng_tp_probe *p;
 	int ret = 0;
 
 	mutex_lock(&lttng_tracepoint_mutex);
@@ -212,15 +373,24 @@ int lttng_tracepoint_probe_unregister(const char *name, void *probe, void *data)
 		ret = -ENOENT;
 		goto end;
 	}
-	/* remove (probe, data) from entry */
-	ret = remove_probe(e, probe, data);
-	if (ret)
+	p = find_probe(e, probe, data);
+	if (!p || p->removed) {
+		WARN_ON(1);
+		ret = -ENOENT;
 		goto end;
-	if (e->tp) {
+	}
+	if (p->registered && tracepoint_batched()) {
+		p->removed = 1;
+		list_move_tail(&e->batch_node, &tracepoint_batch_head);
+		goto end;
+	}
+	if (p->registered) {
 		ret = tracepoint_probe_unregister(e->tp, probe, data);
 		WARN_ON_ONCE(ret);
 		ret = 0;
 	}
+	/* remove (probe, data) from entry */
+	remove_probe(p);
 	if (!--e->refcount)
 		remove_tracepoint(e);
 end:
@@ -262,9 +432,12 @@ int lttng_tracepoint_coming(struct tp_module *tp_mod)
 		list_for_each_entry(p, &e->probes, list) {
 			int ret;
 
+			if (p->removed)
+				continue;
 			ret = tracepoint_probe_register(e->tp,
 					p->tp_func.func, p->tp_func.data);
 			WARN_ON_ONCE(ret);
+			p->registered = 1;
 		}
 	}
 	mutex_unlock(&lttng_tracepoint_mutex);
@@ -290,9 +463,12 @@ int lttng_tracepoint_going(struct tp_module *tp_mod)
 		list_for_each_entry(p, &e->probes, list) {
 			int ret;
 
+			if (!p->registered)
+				continue;
 			ret = tracepoint_probe_unregister(e->tp,
 					p->tp_func.func, p->tp_func.data);
 			WARN_ON_ONCE(ret);
+			p->registered = 0;
 		}
 		e->tp = NULL;
 		if (!--e->refcount)
@@ -413,6 +589,10 @@ int __init lttng_tracepoint_init(void)
 {
 	int ret = 0;
 
+	tracepoint_table = tracepoint_table_alloc(TRACEPOINT_HASH_MIN_BITS);
+	if (!tracepoint_table)
+		return -ENOMEM;
+	tracepoint_hash_bits = TRACEPOINT_HASH_MIN_BITS;
 	for_each_kernel_tracepoint(lttng_kernel_tracepoint_add, &ret);
 	if (ret)
 		goto error;
@@ -430,6 +610,8 @@ error_module:
 		WARN_ON(error_ret);
 	}
 error:
+	tracepoint_table_free(tracepoint_table);
+	tracepoint_table = NULL;
 	return ret;
 }
 
@@ -441,11 +623,13 @@ void lttng_tracepoint_exit(void)
 	for_each_kernel_tracepoint(lttng_kernel_tracepoint_remove, &ret);
 	WARN_ON(ret);
 	mutex_lock(&lttng_tracepoint_mutex);
-	for (i = 0; i < TRACEPOINT_TABLE_SIZE; i++) {
+	for (i = 0; i < (1U << tracepoint_hash_bits); i++) {
 		struct hlist_head *head = &tracepoint_table[i];
 
 		/* All tracepoints should be removed */
 		WARN_ON(!hlist_empty(head));
 	}
+	tracepoint_table_free(tracepoint_table);
+	tracepoint_table = NULL;
 	mutex_unlock(&lttng_tracepoint_mutex);
 }
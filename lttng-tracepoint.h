@@ -25,6 +25,8 @@
 
 int lttng_tracepoint_probe_register(const char *name, void *probe, void *data);
 int lttng_tracepoint_probe_unregister(const char *name, void *probe, void *data);
+void lttng_tracepoint_batch_begin(void);
+void lttng_tracepoint_batch_end(void);
 int lttng_tracepoint_init(void);
 void lttng_tracepoint_exit(void);
 
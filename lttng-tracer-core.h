@@ -27,6 +27,13 @@
 #include <linux/list.h>
 #include <linux/percpu.h>
 
+/*
+ * Architectures with efficient unaligned accesses (e.g. x86-64 and arm64)
+ * write packed records: headers, contexts and payload fields are not
+ * padded, and lttng_alignof() is 1, so the metadata declares every field
+ * byte-aligned. Others align data on its natural alignment, since
+ * unaligned stores are slow or trap there.
+ */
 #ifndef CONFIG_HAVE_EFFICIENT_UNALIGNED_ACCESS
 /* Align data on its natural alignment */
 #define RING_BUFFER_ALIGN
@@ -76,6 +76,12 @@
 #define LTTNG_METADATA_TIMEOUT_MSEC	10000
 
 #define LTTNG_RFLAG_EXTENDED		RING_BUFFER_RFLAG_END
-#define LTTNG_RFLAG_END			(LTTNG_RFLAG_EXTENDED << 1)
+/* Dense header: event id classes, and timestamp delta fitting 16 bits. */
+#define LTTNG_RFLAG_ID8			(LTTNG_RFLAG_EXTENDED << 1)
+#define LTTNG_RFLAG_ID16		(LTTNG_RFLAG_EXTENDED << 2)
+#define LTTNG_RFLAG_TS16		(LTTNG_RFLAG_EXTENDED << 3)
+/* Record written to the fragment staging area instead of the buffer. */
+#define LTTNG_RFLAG_FRAGMENT		(LTTNG_RFLAG_EXTENDED << 4)
+#define LTTNG_RFLAG_END			(LTTNG_RFLAG_EXTENDED << 5)
 
 #endif /* _LTTNG_TRACER_H */
@@ -27,6 +27,7 @@
 #include <linux/stringify.h>
 #include <linux/hash.h>
 #include <linux/rcupdate.h>
+#include <linux/percpu.h>
 
 #include <wrapper/tracepoint.h>
 #include <wrapper/rcu.h>
@@ -40,12 +41,127 @@
  *
  * Concurrent updates of the PID hash table are forbidden: the caller
  * must ensure mutual exclusion. This is currently done by holding the
- * sessions_mutex across calls to create, destroy, add, and del
- * functions of this API.
+ * lock of the session owning the tracker across calls to create,
+ * add, and del functions of this API, and the sessions_mutex, with no
+ * concurrent user left, across destroy.
+ *
+ * Each bucket is a sorted array of PIDs, replaced as a whole
+ * (copy-on-write) on update, so lookups probe contiguous memory
+ * instead of walking a chain of nodes. The table doubles its number of
+ * buckets when the average bucket size exceeds
+ * LTTNG_PID_HASH_MAX_LOAD.
  */
-int lttng_pid_tracker_get_node_pid(const struct lttng_pid_hash_node *node)
+
+#define LTTNG_PID_HASH_MAX_LOAD		4
+#define LTTNG_PID_HASH_MAX_BITS		16
+/* Number of replaced buckets kept before waiting for a grace period. */
+#define LTTNG_PID_RETIRED_MAX		64
+
+static
+struct lttng_pid_hash_table *pid_table_alloc(unsigned int order)
+{
+	struct lttng_pid_hash_table *table;
+
+	table = kzalloc(sizeof(*table)
+			+ (sizeof(table->buckets[0]) << order), GFP_KERNEL);
+	if (!table)
+		return NULL;
+	table->order = order;
+	return table;
+}
+
+static
+void pid_table_free(struct lttng_pid_hash_table *table)
 {
-	return node->pid;
+	unsigned int i;
+
+	for (i = 0; i < (1U << table->order); i++)
+		kfree(table->buckets[i]);
+	kfree(table);
+}
+
+static
+struct lttng_pid_hash_bucket *pid_bucket_alloc(unsigned int nr)
+{
+	struct lttng_pid_hash_bucket *bucket;
+
+	bucket = kmalloc(sizeof(*bucket) + nr * sizeof(bucket->pids[0]),
+			GFP_KERNEL);
+	if (!bucket)
+		return NULL;
+	bucket->nr = nr;
+	bucket->retired_next = NULL;
+	return bucket;
+}
+
+/*
+ * Free replaced buckets once no lookup can reference them anymore.
+ */
+static
+void pid_tracker_free_retired(struct lttng_pid_tracker *lpf)
+{
+	struct lttng_pid_hash_bucket *bucket, *next;
+
+	if (!lpf->retired)
+		return;
+	synchronize_trace();
+	for (bucket = lpf->retired; bucket; bucket = next) {
+		next = bucket->retired_next;
+		kfree(bucket);
+	}
+	lpf->retired = NULL;
+	lpf->nr_retired = 0;
+}
+
+/*
+ * Replaced buckets are batched so adding many PIDs does not wait for a
+ * grace period on each insertion.
+ */
+static
+void pid_tracker_retire_bucket(struct lttng_pid_tracker *lpf,
+		struct lttng_pid_hash_bucket *bucket)
+{
+	if (!bucket)
+		return;
+	bucket->retired_next = lpf->retired;
+	lpf->retired = bucket;
+	if (++lpf->nr_retired >= LTTNG_PID_RETIRED_MAX)
+		pid_tracker_free_retired(lpf);
+}
+
+/*
+ * Invalidate the per-cpu verdicts cached by
+ * lttng_pid_tracker_lookup_current() after an update of the table.
+ */
+static
+void pid_tracker_invalidate_cache(struct lttng_pid_tracker *lpf)
+{
+	/* Publish the table update before the new generation. */
+	smp_wmb();
+	ACCESS_ONCE(lpf->generation) = lpf->generation + 1;
+}
+
+/*
+ * Return the index of pid in the bucket, or of the position where it
+ * should be inserted, as ~index, if not found.
+ */
+static inline
+int pid_bucket_search(const struct lttng_pid_hash_bucket *bucket, u32 pid)
+{
+	unsigned int lo = 0, hi = bucket->nr;
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) >> 1;
+		u32 v = bucket->pids[mid];
+
+		if (v == pid)
+			return mid;
+		if (v < pid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return ~lo;
 }
 
 /*
@@ -53,106 +169,244 @@ int lttng_pid_tracker_get_node_pid(const struct lttng_pid_hash_node *node)
  * protected by preemption off at the tracepoint call site.
  * Return 1 if found, 0 if not found.
  */
-bool lttng_pid_tracker_lookup(struct lttng_pid_tracker *lpf, int pid)
+bool lttng_pid_tracker_lookup(struct lttng_pid_tracker *lpf, u32 pid)
 {
-	struct hlist_head *head;
-	struct lttng_pid_hash_node *e;
-	uint32_t hash = hash_32(pid, 32);
-
-	head = &lpf->pid_hash[hash & (LTTNG_PID_TABLE_SIZE - 1)];
-	lttng_hlist_for_each_entry_rcu(e, head, hlist) {
-		if (pid == e->pid)
-			return 1;	/* Found */
+	struct lttng_pid_hash_table *table;
+	struct lttng_pid_hash_bucket *bucket;
+
+	table = lttng_rcu_dereference(lpf->table);
+	bucket = lttng_rcu_dereference(table->buckets[hash_32(pid, table->order)]);
+	if (!bucket)
+		return 0;
+	return pid_bucket_search(bucket, pid) >= 0;
+}
+EXPORT_SYMBOL_GPL(lttng_pid_tracker_lookup);
+
+/*
+ * Rehash all PIDs into a table with twice as many buckets. Only
+ * published once complete, so concurrent lookups see either table.
+ */
+static
+int pid_tracker_grow(struct lttng_pid_tracker *lpf)
+{
+	struct lttng_pid_hash_table *old_table = lpf->table, *table;
+	unsigned int *count, i, j, order = old_table->order + 1;
+	int ret = 0;
+
+	table = pid_table_alloc(order);
+	if (!table)
+		return -ENOMEM;
+	count = kcalloc(1U << order, sizeof(*count), GFP_KERNEL);
+	if (!count) {
+		ret = -ENOMEM;
+		goto error;
+	}
+	for (i = 0; i < (1U << old_table->order); i++) {
+		struct lttng_pid_hash_bucket *bucket = old_table->buckets[i];
+
+		if (!bucket)
+			continue;
+		for (j = 0; j < bucket->nr; j++)
+			count[hash_32(bucket->pids[j], order)]++;
 	}
+	for (i = 0; i < (1U << order); i++) {
+		if (!count[i])
+			continue;
+		table->buckets[i] = pid_bucket_alloc(count[i]);
+		if (!table->buckets[i]) {
+			ret = -ENOMEM;
+			goto error;
+		}
+		table->buckets[i]->nr = 0;
+	}
+	/* Old buckets are sorted: appending keeps the new ones sorted. */
+	for (i = 0; i < (1U << old_table->order); i++) {
+		struct lttng_pid_hash_bucket *bucket = old_table->buckets[i];
+
+		if (!bucket)
+			continue;
+		for (j = 0; j < bucket->nr; j++) {
+			struct lttng_pid_hash_bucket *dest;
+			u32 pid = bucket->pids[j];
+
+			dest = table->buckets[hash_32(pid, order)];
+			dest->pids[dest->nr++] = pid;
+		}
+	}
+	kfree(count);
+	rcu_assign_pointer(lpf->table, table);
+	synchronize_trace();
+	pid_table_free(old_table);
 	return 0;
+
+error:
+	kfree(count);
+	pid_table_free(table);
+	return ret;
 }
-EXPORT_SYMBOL_GPL(lttng_pid_tracker_lookup);
 
 /*
  * Tracker add and del operations support concurrent RCU lookups.
  */
-int lttng_pid_tracker_add(struct lttng_pid_tracker *lpf, int pid)
+int lttng_pid_tracker_add(struct lttng_pid_tracker *lpf, u32 pid)
 {
-	struct hlist_head *head;
-	struct lttng_pid_hash_node *e;
-	uint32_t hash = hash_32(pid, 32);
+	struct lttng_pid_hash_table *table;
+	struct lttng_pid_hash_bucket *old_bucket, *bucket;
+	unsigned int nr = 0, idx;
+	int pos = ~0;
 
-	head = &lpf->pid_hash[hash & (LTTNG_PID_TABLE_SIZE - 1)];
-	lttng_hlist_for_each_entry(e, head, hlist) {
-		if (pid == e->pid)
+	if (lpf->nr_pids >= (LTTNG_PID_HASH_MAX_LOAD << lpf->table->order)
+			&& lpf->table->order < LTTNG_PID_HASH_MAX_BITS) {
+		/* Growing is best effort: a loaded table still works. */
+		(void) pid_tracker_grow(lpf);
+	}
+	table = lpf->table;
+	idx = hash_32(pid, table->order);
+	old_bucket = table->buckets[idx];
+	if (old_bucket) {
+		pos = pid_bucket_search(old_bucket, pid);
+		if (pos >= 0)
 			return -EEXIST;
+		nr = old_bucket->nr;
 	}
-	e = kmalloc(sizeof(struct lttng_pid_hash_node), GFP_KERNEL);
-	if (!e)
+	pos = ~pos;
+	bucket = pid_bucket_alloc(nr + 1);
+	if (!bucket)
 		return -ENOMEM;
-	e->pid = pid;
-	hlist_add_head_rcu(&e->hlist, head);
+	if (old_bucket) {
+		memcpy(bucket->pids, old_bucket->pids,
+			pos * sizeof(bucket->pids[0]));
+		memcpy(&bucket->pids[pos + 1], &old_bucket->pids[pos],
+			(nr - pos) * sizeof(bucket->pids[0]));
+	}
+	bucket->pids[pos] = pid;
+	rcu_assign_pointer(table->buckets[idx], bucket);
+	lpf->nr_pids++;
+	pid_tracker_invalidate_cache(lpf);
+	pid_tracker_retire_bucket(lpf, old_bucket);
 	return 0;
 }
+EXPORT_SYMBOL_GPL(lttng_pid_tracker_add);
 
-static
-void pid_tracker_del_node_rcu(struct lttng_pid_hash_node *e)
+int lttng_pid_tracker_del(struct lttng_pid_tracker *lpf, u32 pid)
 {
-	hlist_del_rcu(&e->hlist);
+	struct lttng_pid_hash_table *table = lpf->table;
+	struct lttng_pid_hash_bucket *old_bucket, *bucket = NULL;
+	unsigned int idx = hash_32(pid, table->order);
+	int pos;
+
+	old_bucket = table->buckets[idx];
+	if (!old_bucket)
+		return -ENOENT;	/* Not found */
+	pos = pid_bucket_search(old_bucket, pid);
+	if (pos < 0)
+		return -ENOENT;	/* Not found */
+	if (old_bucket->nr > 1) {
+		bucket = pid_bucket_alloc(old_bucket->nr - 1);
+		if (!bucket)
+			return -ENOMEM;
+		memcpy(bucket->pids, old_bucket->pids,
+			pos * sizeof(bucket->pids[0]));
+		memcpy(&bucket->pids[pos], &old_bucket->pids[pos + 1],
+			(old_bucket->nr - pos - 1) * sizeof(bucket->pids[0]));
+	}
+	rcu_assign_pointer(table->buckets[idx], bucket);
+	lpf->nr_pids--;
+	pid_tracker_invalidate_cache(lpf);
 	/*
-	 * We choose to use a heavyweight synchronize on removal here,
-	 * since removal of a PID from the tracker mask is a rare
-	 * operation, and we don't want to use more cache lines than
-	 * what we really need when doing the PID lookups, so we don't
-	 * want to afford adding a rcu_head field to those pid hash
-	 * node.
+	 * Removal of a PID from the tracker mask is a rare operation:
+	 * wait for a grace period right away rather than keeping the
+	 * old bucket around.
 	 */
-	synchronize_trace();
-	kfree(e);
+	pid_tracker_retire_bucket(lpf, old_bucket);
+	pid_tracker_free_retired(lpf);
+	return 0;
 }
+EXPORT_SYMBOL_GPL(lttng_pid_tracker_del);
 
 /*
- * This removal is only used on destroy, so it does not need to support
- * concurrent RCU lookups.
+ * Return a pointer to the pos-th tracked PID, or NULL when pos is past
+ * the last one. Called with the tracker update mutex held.
  */
-static
-void pid_tracker_del_node(struct lttng_pid_hash_node *e)
+const u32 *lttng_pid_tracker_get_pos(struct lttng_pid_tracker *lpf,
+		loff_t pos)
 {
-	hlist_del(&e->hlist);
-	kfree(e);
-}
+	struct lttng_pid_hash_table *table = lpf->table;
+	unsigned int i;
 
-int lttng_pid_tracker_del(struct lttng_pid_tracker *lpf, int pid)
-{
-	struct hlist_head *head;
-	struct lttng_pid_hash_node *e;
-	uint32_t hash = hash_32(pid, 32);
+	for (i = 0; i < (1U << table->order); i++) {
+		struct lttng_pid_hash_bucket *bucket = table->buckets[i];
 
-	head = &lpf->pid_hash[hash & (LTTNG_PID_TABLE_SIZE - 1)];
-	/*
-	 * No need of _safe iteration, because we stop traversal as soon
-	 * as we remove the entry.
-	 */
-	lttng_hlist_for_each_entry(e, head, hlist) {
-		if (pid == e->pid) {
-			pid_tracker_del_node_rcu(e);
-			return 0;
-		}
+		if (!bucket)
+			continue;
+		if (pos < bucket->nr)
+			return &bucket->pids[pos];
+		pos -= bucket->nr;
 	}
-	return -ENOENT;	/* Not found */
+	return NULL;
 }
 
 struct lttng_pid_tracker *lttng_pid_tracker_create(void)
 {
-	return kzalloc(sizeof(struct lttng_pid_tracker), GFP_KERNEL);
+	struct lttng_pid_tracker *lpf;
+
+	lpf = kzalloc(sizeof(struct lttng_pid_tracker), GFP_KERNEL);
+	if (!lpf)
+		return NULL;
+	lpf->table = pid_table_alloc(LTTNG_PID_HASH_BITS);
+	if (!lpf->table)
+		goto error_table;
+	lpf->cache = alloc_percpu(u64);
+	if (!lpf->cache)
+		goto error_cache;
+	/* Zeroed cache entries never match a non-zero generation. */
+	lpf->generation = 1;
+	return lpf;
+
+error_cache:
+	pid_table_free(lpf->table);
+error_table:
+	kfree(lpf);
+	return NULL;
 }
+EXPORT_SYMBOL_GPL(lttng_pid_tracker_create);
 
 void lttng_pid_tracker_destroy(struct lttng_pid_tracker *lpf)
 {
-	int i;
+	struct lttng_pid_hash_bucket *bucket, *next;
 
-	for (i = 0; i < LTTNG_PID_TABLE_SIZE; i++) {
-		struct hlist_head *head = &lpf->pid_hash[i];
-		struct lttng_pid_hash_node *e;
-		struct hlist_node *tmp;
-
-		lttng_hlist_for_each_entry_safe(e, tmp, head, hlist)
-			pid_tracker_del_node(e);
+	/* No concurrent lookups: no need to wait for retired buckets. */
+	for (bucket = lpf->retired; bucket; bucket = next) {
+		next = bucket->retired_next;
+		kfree(bucket);
 	}
+	pid_table_free(lpf->table);
+	free_percpu(lpf->cache);
 	kfree(lpf);
 }
+EXPORT_SYMBOL_GPL(lttng_pid_tracker_destroy);
+
+/*
+ * Bytes allocated for the tracker, retired buckets included. Called
+ * with the tracker update mutex held.
+ */
+size_t lttng_pid_tracker_memory_size(struct lttng_pid_tracker *lpf)
+{
+	struct lttng_pid_hash_table *table = lpf->table;
+	struct lttng_pid_hash_bucket *bucket;
+	size_t size;
+	unsigned int i;
+
+	size = sizeof(*lpf) + num_possible_cpus() * sizeof(u64)
+		+ sizeof(*table) + (sizeof(table->buckets[0]) << table->order);
+	for (i = 0; i < (1U << table->order); i++) {
+		bucket = table->buckets[i];
+		if (bucket)
+			size += sizeof(*bucket)
+				+ bucket->nr * sizeof(bucket->pids[0]);
+	}
+	for (bucket = lpf->retired; bucket; bucket = bucket->retired_next)
+		size += sizeof(*bucket) + bucket->nr * sizeof(bucket->pids[0]);
+	return size;
+}
+EXPORT_SYMBOL_GPL(lttng_pid_tracker_memory_size);
@@ -90,6 +90,32 @@
 #undef _ctf_enum
 #define _ctf_enum(_name, _type, _item, _src, _nowrite)
 
+/*
+ * Dictionary-encoded text is recorded as is unless a stage handles it, so
+ * it defaults to the plain array and string of that stage.
+ */
+#undef _ctf_array_text_dict
+#define _ctf_array_text_dict(_item, _src, _length)		\
+	_ctf_array_encoded(char, _item, _src, _length, UTF8, 0, 0)
+
+#undef _ctf_string_dict
+#define _ctf_string_dict(_item, _src)				\
+	_ctf_string(_item, _src, 0, 0)
+
+/* Likewise, delta-encoded integers default to the plain integer. */
+#undef _ctf_integer_delta
+#define _ctf_integer_delta(_type, _item, _src, _base)		\
+	_ctf_integer_ext(_type, _item, _src, __BYTE_ORDER, _base, 0, 0)
+
+/*
+ * skb data is a sequence of bytes. The stages reading it rather than its
+ * length handle it.
+ */
+#undef _ctf_sequence_skb
+#define _ctf_sequence_skb(_item, _skb, _length)			\
+	_ctf_sequence_encoded(uint8_t, _item, (_skb)->data, uint16_t,	\
+		_length, none, __BYTE_ORDER, 16, 0, 0)
+
 /* "write" */
 #undef ctf_integer
 #define ctf_integer(_type, _item, _src)
@@ -136,6 +162,21 @@
 #undef ctf_string
 #define ctf_string(_item, _src)
 
+#undef ctf_array_text_dict
+#define ctf_array_text_dict(_item, _src, _length)
+
+#undef ctf_string_dict
+#define ctf_string_dict(_item, _src)
+
+#undef ctf_integer_delta
+#define ctf_integer_delta(_type, _item, _src)
+
+#undef ctf_integer_hex_delta
+#define ctf_integer_hex_delta(_type, _item, _src)
+
+#undef ctf_sequence_skb
+#define ctf_sequence_skb(_item, _skb, _length)
+
 #undef ctf_enum
 #define ctf_enum(_name, _type, _item, _src)
 
@@ -151,6 +192,30 @@
 #undef ctf_align
 #define ctf_align(_type)
 
+#undef ctf_flow_key
+#define ctf_flow_key(_hash, _bytes)
+
+#undef ctf_summary_key
+#define ctf_summary_key(_key, _subkey)
+
+#undef ctf_summary_value
+#define ctf_summary_value(_value)
+
+#undef ctf_alloc_site
+#define ctf_alloc_site(_site, _bytes_req, _bytes_alloc)
+
+#undef ctf_free_site
+#define ctf_free_site(_site)
+
+#undef ctf_duration
+#define ctf_duration(_key, _ns)
+
+#undef ctf_agg_key
+#define ctf_agg_key(_key)
+
+#undef ctf_agg_value
+#define ctf_agg_value(_value)
+
 /* "nowrite" */
 #undef ctf_integer_nowrite
 #define ctf_integer_nowrite(_type, _item, _src)
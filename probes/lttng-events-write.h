@@ -87,6 +87,29 @@
 #define ctf_enum(_name, _type, _item, _src)			\
 	_ctf_enum(_name, _type, _item, _src, 0, 0)
 
+/* Text recorded as a dictionary id in channels with a string dictionary */
+#undef ctf_array_text_dict
+#define ctf_array_text_dict(_item, _src, _length)		\
+	_ctf_array_text_dict(_item, _src, _length)
+
+#undef ctf_string_dict
+#define ctf_string_dict(_item, _src)				\
+	_ctf_string_dict(_item, _src)
+
+/* Integer recorded as a delta in channels with delta encoding */
+#undef ctf_integer_delta
+#define ctf_integer_delta(_type, _item, _src)			\
+	_ctf_integer_delta(_type, _item, _src, 10)
+
+#undef ctf_integer_hex_delta
+#define ctf_integer_hex_delta(_type, _item, _src)		\
+	_ctf_integer_delta(_type, _item, _src, 16)
+
+/* First bytes of the data of an skb, paged fragments included */
+#undef ctf_sequence_skb
+#define ctf_sequence_skb(_item, _skb, _length)			\
+	_ctf_sequence_skb(_item, _skb, _length)
+
 /* user src */
 #undef ctf_user_integer
 #define ctf_user_integer(_type, _item, _src)				\
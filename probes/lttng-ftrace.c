@@ -25,27 +25,36 @@
  * teardown and callback execution. Therefore, we make this module permanently
  * loaded (unloadable).
  *
- * TODO: Move to register_ftrace_function() (which is exported for
- * modules) for Linux >= 3.0. It is faster (only enables the selected
- * functions), and will stay there.
+ * On Linux >= 3.7, each event has its own ftrace_ops, filtered on the
+ * functions matching its glob, with the event as private data. Setting
+ * the filter of an unregistered ops only builds its hash, so the text is
+ * patched once when the event is armed, whatever the number of matching
+ * functions, and the handler gets its event without any lookup. Ftrace
+ * uses a dedicated trampoline for the functions traced by a single ops.
+ * Older kernels use function probes.
  */
 
 #include <linux/module.h>
 #include <linux/ftrace.h>
 #include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/version.h>
 #include <lttng-events.h>
 #include <wrapper/ringbuffer/frontend_types.h>
 #include <wrapper/ftrace.h>
 #include <wrapper/vmalloc.h>
 #include <lttng-tracer.h>
 
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,7,0))
+#define LTTNG_FTRACE_OPS
+#endif
+
 static
-void lttng_ftrace_handler(unsigned long ip, unsigned long parent_ip, void **data)
+void __lttng_ftrace_handler(struct lttng_event *event, unsigned long ip,
+		unsigned long parent_ip)
 {
-	struct lttng_event *event = *data;
 	struct lttng_probe_ctx lttng_probe_ctx = {
 		.event = event,
-		.interruptible = !irqs_disabled(),
 	};
 	struct lttng_channel *chan = event->chan;
 	struct lib_ring_buffer_ctx ctx;
@@ -53,20 +62,22 @@ void lttng_ftrace_handler(unsigned long ip, unsigned long parent_ip, void **data
 		unsigned long ip;
 		unsigned long parent_ip;
 	} payload;
+	uint64_t filter_stack_data[2] = { ip, parent_ip };
 	int ret;
 
-	if (unlikely(!ACCESS_ONCE(chan->session->active)))
-		return;
-	if (unlikely(!ACCESS_ONCE(chan->enabled)))
+	if (unlikely(!ACCESS_ONCE(event->effective_enabled)))
 		return;
-	if (unlikely(!ACCESS_ONCE(event->enabled)))
+	if (!lttng_event_probe_check(event, &lttng_probe_ctx,
+			(const char *) filter_stack_data))
 		return;
 
 	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx,
 				 sizeof(payload), lttng_alignof(payload), -1);
 	ret = chan->ops->event_reserve(&ctx, event->id);
-	if (ret < 0)
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(event, ret);
 		return;
+	}
 	payload.ip = ip;
 	payload.parent_ip = parent_ip;
 	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(payload));
@@ -75,6 +86,36 @@ void lttng_ftrace_handler(unsigned long ip, unsigned long parent_ip, void **data
 	return;
 }
 
+#ifdef LTTNG_FTRACE_OPS
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,11,0))
+static
+void lttng_ftrace_handler(unsigned long ip, unsigned long parent_ip,
+		struct ftrace_ops *op, struct ftrace_regs *fregs)
+#else
+static
+void lttng_ftrace_handler(unsigned long ip, unsigned long parent_ip,
+		struct ftrace_ops *op, struct pt_regs *regs)
+#endif
+{
+	__lttng_ftrace_handler(op->private, ip, parent_ip);
+}
+
+#else /* LTTNG_FTRACE_OPS */
+
+static
+void lttng_ftrace_handler(unsigned long ip, unsigned long parent_ip, void **data)
+{
+	__lttng_ftrace_handler(*data, ip, parent_ip);
+}
+
+static
+struct ftrace_probe_ops lttng_ftrace_ops = {
+	.func = lttng_ftrace_handler,
+};
+
+#endif /* LTTNG_FTRACE_OPS */
+
 /*
  * Create event description
  */
@@ -130,10 +171,85 @@ error_str:
 	return ret;
 }
 
+#ifdef LTTNG_FTRACE_OPS
+
 static
-struct ftrace_probe_ops lttng_ftrace_ops = {
-	.func = lttng_ftrace_handler,
-};
+int lttng_ftrace_ops_create(struct lttng_event *event)
+{
+	struct ftrace_ops *ops;
+	int ret;
+
+	ops = kzalloc(sizeof(*ops), GFP_KERNEL);
+	if (!ops)
+		return -ENOMEM;
+	ops->func = lttng_ftrace_handler;
+	ops->private = event;
+	ret = ftrace_set_filter(ops,
+			(unsigned char *) event->u.ftrace.symbol_name,
+			strlen(event->u.ftrace.symbol_name), 1);
+	if (ret) {
+		kfree(ops);
+		return ret;
+	}
+	event->u.ftrace.ops = ops;
+	return 0;
+}
+
+static
+void lttng_ftrace_ops_destroy(struct lttng_event *event)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,15,0))
+	ftrace_free_filter(event->u.ftrace.ops);
+#endif
+	kfree(event->u.ftrace.ops);
+}
+
+/*
+ * Only keep the functions patched while the event can record. Should be
+ * called with sessions lock held, after any change of the event
+ * effective enable state.
+ */
+int lttng_ftrace_event_arm(struct lttng_event *event)
+{
+	int ret;
+
+	if (event->effective_enabled == event->u.ftrace.armed)
+		return 0;
+	if (event->effective_enabled)
+		ret = register_ftrace_function(event->u.ftrace.ops);
+	else
+		ret = unregister_ftrace_function(event->u.ftrace.ops);
+	if (!ret)
+		event->u.ftrace.armed = event->effective_enabled;
+	return ret;
+}
+
+#else /* LTTNG_FTRACE_OPS */
+
+static
+int lttng_ftrace_ops_create(struct lttng_event *event)
+{
+	int ret;
+
+	ret = wrapper_register_ftrace_function_probe(event->u.ftrace.symbol_name,
+			&lttng_ftrace_ops, event);
+	if (ret < 0)
+		return ret;
+	return 0;
+}
+
+static
+void lttng_ftrace_ops_destroy(struct lttng_event *event)
+{
+}
+
+int lttng_ftrace_event_arm(struct lttng_event *event)
+{
+	return 0;
+}
+
+#endif /* LTTNG_FTRACE_OPS */
+EXPORT_SYMBOL_GPL(lttng_ftrace_event_arm);
 
 int lttng_ftrace_register(const char *name,
 			  const char *symbol_name,
@@ -152,9 +268,8 @@ int lttng_ftrace_register(const char *name,
 	/* Ensure the memory we just allocated don't trigger page faults */
 	wrapper_vmalloc_sync_all();
 
-	ret = wrapper_register_ftrace_function_probe(event->u.ftrace.symbol_name,
-			&lttng_ftrace_ops, event);
-	if (ret < 0)
+	ret = lttng_ftrace_ops_create(event);
+	if (ret)
 		goto register_error;
 	return 0;
 
@@ -170,13 +285,21 @@ EXPORT_SYMBOL_GPL(lttng_ftrace_register);
 
 void lttng_ftrace_unregister(struct lttng_event *event)
 {
+#ifdef LTTNG_FTRACE_OPS
+	if (event->u.ftrace.armed) {
+		WARN_ON_ONCE(unregister_ftrace_function(event->u.ftrace.ops));
+		event->u.ftrace.armed = 0;
+	}
+#else
 	wrapper_unregister_ftrace_function_probe(event->u.ftrace.symbol_name,
 			&lttng_ftrace_ops, event);
+#endif
 }
 EXPORT_SYMBOL_GPL(lttng_ftrace_unregister);
 
 void lttng_ftrace_destroy_private(struct lttng_event *event)
 {
+	lttng_ftrace_ops_destroy(event);
 	kfree(event->u.ftrace.symbol_name);
 	kfree(event->desc->fields);
 	kfree(event->desc->name);
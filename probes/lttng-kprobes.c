@@ -23,52 +23,337 @@
 #include <linux/module.h>
 #include <linux/kprobes.h>
 #include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
 #include <lttng-events.h>
 #include <wrapper/ringbuffer/frontend_types.h>
 #include <wrapper/vmalloc.h>
-#include <wrapper/irqflags.h>
+#include <wrapper/uaccess.h>
 #include <lttng-tracer.h>
 
+/*
+ * Argument fetch program, compiled from the lttng_kernel_kprobe_args of
+ * the event at creation. Each argument is stored at a precomputed
+ * offset of the payload, after the probe address, following the
+ * alignment of the fields described in the metadata.
+ */
+struct lttng_kprobe_fetch {
+	char name[LTTNG_KERNEL_KPROBE_ARG_NAME_LEN];
+	enum lttng_kernel_kprobe_fetch type;
+	unsigned int reg_offset;	/* REG and DEREF: offset in pt_regs */
+	long offset;			/* STACK: word index, DEREF: byte offset */
+	unsigned int size;
+	unsigned int base;
+	unsigned int signedness:1;
+	size_t payload_offset;
+};
+
+struct lttng_kprobe_args {
+	unsigned int nr_fetch;
+	size_t payload_len;
+	size_t payload_align;
+	struct lttng_kprobe_fetch fetch[];
+};
+
+static
+size_t lttng_kprobe_arg_align(unsigned int size)
+{
+	switch (size) {
+	case 1:
+		return lttng_alignof(uint8_t);
+	case 2:
+		return lttng_alignof(uint16_t);
+	case 4:
+		return lttng_alignof(uint32_t);
+	default:
+		return lttng_alignof(uint64_t);
+	}
+}
+
+#ifdef CONFIG_HAVE_REGS_AND_STACK_ACCESS_API
+
+static
+void lttng_kprobe_arg_store(char *p, unsigned int size, unsigned long word)
+{
+	switch (size) {
+	case 1:
+		*(uint8_t *) p = word;
+		break;
+	case 2:
+		*(uint16_t *) p = word;
+		break;
+	case 4:
+		*(uint32_t *) p = word;
+		break;
+	default:
+		*(uint64_t *) p = word;
+		break;
+	}
+}
+
+/* Value of a stored argument in its filter stack slot. */
+static
+uint64_t lttng_kprobe_arg_load(const struct lttng_kprobe_fetch *fetch,
+		const char *p)
+{
+	switch (fetch->size) {
+	case 1:
+		return fetch->signedness ? (int64_t) *(const int8_t *) p :
+			*(const uint8_t *) p;
+	case 2:
+		return fetch->signedness ? (int64_t) *(const int16_t *) p :
+			*(const uint16_t *) p;
+	case 4:
+		return fetch->signedness ? (int64_t) *(const int32_t *) p :
+			*(const uint32_t *) p;
+	default:
+		return *(const uint64_t *) p;
+	}
+}
+
+static
+void lttng_kprobes_fetch_args(const struct lttng_kprobe_args *args,
+		struct pt_regs *regs, char *payload,
+		uint64_t *filter_stack_data)
+{
+	unsigned int i;
+
+	for (i = 0; i < args->nr_fetch; i++) {
+		const struct lttng_kprobe_fetch *fetch = &args->fetch[i];
+		char *p = payload + fetch->payload_offset;
+		unsigned long addr;
+
+		switch (fetch->type) {
+		case LTTNG_KERNEL_KPROBE_FETCH_REG:
+			lttng_kprobe_arg_store(p, fetch->size,
+				regs_get_register(regs, fetch->reg_offset));
+			break;
+		case LTTNG_KERNEL_KPROBE_FETCH_STACK:
+			lttng_kprobe_arg_store(p, fetch->size,
+				regs_get_kernel_stack_nth(regs, fetch->offset));
+			break;
+		case LTTNG_KERNEL_KPROBE_FETCH_DEREF:
+			addr = regs_get_register(regs, fetch->reg_offset)
+				+ fetch->offset;
+			if (lttng_copy_from_kernel_nofault(p,
+					(const void *) addr, fetch->size))
+				memset(p, 0, fetch->size);
+			break;
+		}
+		filter_stack_data[i] = lttng_kprobe_arg_load(fetch, p);
+	}
+}
+
+static
+int lttng_kprobe_arg_reg_offset(const char *reg, unsigned int *reg_offset)
+{
+	int ret;
+
+	if (strnlen(reg, LTTNG_KERNEL_KPROBE_REG_NAME_LEN)
+			== LTTNG_KERNEL_KPROBE_REG_NAME_LEN)
+		return -EINVAL;
+	ret = regs_query_register_offset(reg);
+	if (ret < 0)
+		return -EINVAL;
+	*reg_offset = ret;
+	return 0;
+}
+
+#else /* CONFIG_HAVE_REGS_AND_STACK_ACCESS_API */
+
+static
+void lttng_kprobes_fetch_args(const struct lttng_kprobe_args *args,
+		struct pt_regs *regs, char *payload,
+		uint64_t *filter_stack_data)
+{
+}
+
+static
+int lttng_kprobe_arg_reg_offset(const char *reg, unsigned int *reg_offset)
+{
+	return -ENOSYS;
+}
+
+#endif /* CONFIG_HAVE_REGS_AND_STACK_ACCESS_API */
+
 static
 int lttng_kprobes_handler_pre(struct kprobe *p, struct pt_regs *regs)
 {
 	struct lttng_event *event =
 		container_of(p, struct lttng_event, u.kprobe.kp);
+	struct lttng_kprobe_args *args = event->u.kprobe.args;
 	struct lttng_probe_ctx lttng_probe_ctx = {
 		.event = event,
-		.interruptible = !lttng_regs_irqs_disabled(regs),
+		.regs = regs,
 	};
 	struct lttng_channel *chan = event->chan;
 	struct lib_ring_buffer_ctx ctx;
 	int ret;
 	unsigned long data = (unsigned long) p->addr;
+	/* ip, then the arguments. */
+	uint64_t filter_stack_data[1 + LTTNG_KERNEL_KPROBE_MAX_ARGS];
+	uint64_t payload[1 + LTTNG_KERNEL_KPROBE_MAX_ARGS];
+	size_t payload_len = sizeof(data), payload_align = lttng_alignof(data);
 
-	if (unlikely(!ACCESS_ONCE(chan->session->active)))
+	if (unlikely(!ACCESS_ONCE(event->effective_enabled)))
 		return 0;
-	if (unlikely(!ACCESS_ONCE(chan->enabled)))
-		return 0;
-	if (unlikely(!ACCESS_ONCE(event->enabled)))
+	filter_stack_data[0] = data;
+	if (args) {
+		/* Do not leak stack contents through alignment padding. */
+		memset(payload, 0, args->payload_len);
+		lttng_kprobes_fetch_args(args, regs, (char *) payload,
+				&filter_stack_data[1]);
+		payload_len = args->payload_len;
+		payload_align = args->payload_align;
+	}
+	memcpy(payload, &data, sizeof(data));
+	if (!lttng_event_probe_check(event, &lttng_probe_ctx,
+			(const char *) filter_stack_data))
 		return 0;
 
-	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx, sizeof(data),
-				 lttng_alignof(data), -1);
+	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx, payload_len,
+				 payload_align, -1);
 	ret = chan->ops->event_reserve(&ctx, event->id);
-	if (ret < 0)
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(event, ret);
 		return 0;
-	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(data));
-	chan->ops->event_write(&ctx, &data, sizeof(data));
+	}
+	lib_ring_buffer_align_ctx(&ctx, payload_align);
+	chan->ops->event_write(&ctx, payload, payload_len);
 	chan->ops->event_commit(&ctx);
 	return 0;
 }
 
+/*
+ * Compile the argument fetch program from the user-space description.
+ * Sets *argsp to NULL if there are no arguments.
+ */
+static
+int lttng_kprobes_compile_args(uint64_t uargs_ptr,
+		struct lttng_kprobe_args **argsp)
+{
+	struct lttng_kernel_kprobe_args *uargs;
+	struct lttng_kprobe_args *args = NULL;
+	size_t offset, align;
+	unsigned int i, j;
+	int ret = 0;
+
+	*argsp = NULL;
+	if (!uargs_ptr)
+		return 0;
+#ifndef CONFIG_HAVE_REGS_AND_STACK_ACCESS_API
+	return -ENOSYS;
+#endif
+	uargs = kmalloc(sizeof(*uargs), GFP_KERNEL);
+	if (!uargs)
+		return -ENOMEM;
+	if (copy_from_user(uargs,
+			(struct lttng_kernel_kprobe_args __user *)
+				(unsigned long) uargs_ptr,
+			sizeof(*uargs))) {
+		ret = -EFAULT;
+		goto end;
+	}
+	if (!uargs->nr_args)
+		goto end;
+	if (uargs->nr_args > LTTNG_KERNEL_KPROBE_MAX_ARGS) {
+		ret = -EINVAL;
+		goto end;
+	}
+	args = kzalloc(sizeof(*args)
+			+ uargs->nr_args * sizeof(struct lttng_kprobe_fetch),
+			GFP_KERNEL);
+	if (!args) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	offset = sizeof(unsigned long);		/* ip */
+	align = lttng_alignof(unsigned long);
+	for (i = 0; i < uargs->nr_args; i++) {
+		struct lttng_kernel_kprobe_arg *uarg = &uargs->args[i];
+		struct lttng_kprobe_fetch *fetch = &args->fetch[i];
+
+		uarg->name[LTTNG_KERNEL_KPROBE_ARG_NAME_LEN - 1] = '\0';
+		if (!uarg->name[0] || !strcmp(uarg->name, "ip")) {
+			ret = -EINVAL;
+			goto error;
+		}
+		for (j = 0; j < i; j++) {
+			if (!strcmp(uarg->name, args->fetch[j].name)) {
+				ret = -EEXIST;
+				goto error;
+			}
+		}
+		switch (uarg->size) {
+		case 1:
+		case 2:
+		case 4:
+		case 8:
+			break;
+		default:
+			ret = -EINVAL;
+			goto error;
+		}
+		if (uarg->signedness > 1
+				|| (uarg->base != 10 && uarg->base != 16)) {
+			ret = -EINVAL;
+			goto error;
+		}
+		switch (uarg->fetch) {
+		case LTTNG_KERNEL_KPROBE_FETCH_REG:
+		case LTTNG_KERNEL_KPROBE_FETCH_DEREF:
+			ret = lttng_kprobe_arg_reg_offset(uarg->reg,
+					&fetch->reg_offset);
+			if (ret)
+				goto error;
+			break;
+		case LTTNG_KERNEL_KPROBE_FETCH_STACK:
+			if (uarg->offset < 0
+					|| uarg->offset >= THREAD_SIZE / sizeof(long)) {
+				ret = -EINVAL;
+				goto error;
+			}
+			break;
+		default:
+			ret = -EINVAL;
+			goto error;
+		}
+		strcpy(fetch->name, uarg->name);
+		fetch->type = uarg->fetch;
+		fetch->offset = uarg->offset;
+		fetch->size = uarg->size;
+		fetch->signedness = uarg->signedness;
+		fetch->base = uarg->base;
+		offset += lib_ring_buffer_align(offset,
+				lttng_kprobe_arg_align(fetch->size));
+		fetch->payload_offset = offset;
+		offset += fetch->size;
+		align = max_t(size_t, align,
+				lttng_kprobe_arg_align(fetch->size));
+	}
+	args->nr_fetch = uargs->nr_args;
+	args->payload_len = offset;
+	args->payload_align = align;
+	*argsp = args;
+	goto end;
+
+error:
+	kfree(args);
+end:
+	kfree(uargs);
+	return ret;
+}
+
 /*
  * Create event description
  */
 static
 int lttng_create_kprobe_event(const char *name, struct lttng_event *event)
 {
+	struct lttng_kprobe_args *args = event->u.kprobe.args;
 	struct lttng_event_field *field;
 	struct lttng_event_desc *desc;
+	unsigned int i, nr_fetch = args ? args->nr_fetch : 0;
 	int ret;
 
 	desc = kzalloc(sizeof(*event->desc), GFP_KERNEL);
@@ -79,9 +364,10 @@ int lttng_create_kprobe_event(const char *name, struct lttng_event *event)
 		ret = -ENOMEM;
 		goto error_str;
 	}
-	desc->nr_fields = 1;
+	desc->nr_fields = 1 + nr_fetch;
 	desc->fields = field =
-		kzalloc(1 * sizeof(struct lttng_event_field), GFP_KERNEL);
+		kzalloc(desc->nr_fields * sizeof(struct lttng_event_field),
+			GFP_KERNEL);
 	if (!field) {
 		ret = -ENOMEM;
 		goto error_field;
@@ -94,6 +380,20 @@ int lttng_create_kprobe_event(const char *name, struct lttng_event *event)
 	field->type.u.basic.integer.reverse_byte_order = 0;
 	field->type.u.basic.integer.base = 16;
 	field->type.u.basic.integer.encoding = lttng_encode_none;
+	for (i = 0; i < nr_fetch; i++) {
+		const struct lttng_kprobe_fetch *fetch = &args->fetch[i];
+
+		field++;
+		field->name = fetch->name;
+		field->type.atype = atype_integer;
+		field->type.u.basic.integer.size = fetch->size * CHAR_BIT;
+		field->type.u.basic.integer.alignment =
+			lttng_kprobe_arg_align(fetch->size) * CHAR_BIT;
+		field->type.u.basic.integer.signedness = fetch->signedness;
+		field->type.u.basic.integer.reverse_byte_order = 0;
+		field->type.u.basic.integer.base = fetch->base;
+		field->type.u.basic.integer.encoding = lttng_encode_none;
+	}
 	desc->owner = THIS_MODULE;
 	event->desc = desc;
 
@@ -110,6 +410,7 @@ int lttng_kprobes_register(const char *name,
 			   const char *symbol_name,
 			   uint64_t offset,
 			   uint64_t addr,
+			   uint64_t args,
 			   struct lttng_event *event)
 {
 	int ret;
@@ -118,9 +419,12 @@ int lttng_kprobes_register(const char *name,
 	if (symbol_name[0] == '\0')
 		symbol_name = NULL;
 
-	ret = lttng_create_kprobe_event(name, event);
+	ret = lttng_kprobes_compile_args(args, &event->u.kprobe.args);
 	if (ret)
 		goto error;
+	ret = lttng_create_kprobe_event(name, event);
+	if (ret)
+		goto event_error;
 	memset(&event->u.kprobe.kp, 0, sizeof(event->u.kprobe.kp));
 	event->u.kprobe.kp.pre_handler = lttng_kprobes_handler_pre;
 	if (symbol_name) {
@@ -138,6 +442,8 @@ int lttng_kprobes_register(const char *name,
 	}
 	event->u.kprobe.kp.offset = offset;
 	event->u.kprobe.kp.addr = (void *) (unsigned long) addr;
+	/* Armed by lttng_kprobes_event_arm() once the event is enabled. */
+	event->u.kprobe.kp.flags = KPROBE_FLAG_DISABLED;
 
 	/*
 	 * Ensure the memory we just allocated don't trigger page faults.
@@ -157,6 +463,8 @@ name_error:
 	kfree(event->desc->fields);
 	kfree(event->desc->name);
 	kfree(event->desc);
+event_error:
+	kfree(event->u.kprobe.args);
 error:
 	return ret;
 }
@@ -168,12 +476,31 @@ void lttng_kprobes_unregister(struct lttng_event *event)
 }
 EXPORT_SYMBOL_GPL(lttng_kprobes_unregister);
 
+/*
+ * Only keep the breakpoint inserted while the event can record, so that
+ * disabled events and stopped sessions do not take the kprobe trap.
+ * Should be called with sessions lock held, after any change of the
+ * event effective enable state.
+ */
+int lttng_kprobes_event_arm(struct lttng_event *event)
+{
+	struct kprobe *kp = &event->u.kprobe.kp;
+
+	if (event->effective_enabled == !kprobe_disabled(kp))
+		return 0;
+	if (event->effective_enabled)
+		return enable_kprobe(kp);
+	return disable_kprobe(kp);
+}
+EXPORT_SYMBOL_GPL(lttng_kprobes_event_arm);
+
 void lttng_kprobes_destroy_private(struct lttng_event *event)
 {
 	kfree(event->u.kprobe.symbol_name);
 	kfree(event->desc->fields);
 	kfree(event->desc->name);
 	kfree(event->desc);
+	kfree(event->u.kprobe.args);
 }
 EXPORT_SYMBOL_GPL(lttng_kprobes_destroy_private);
 
@@ -24,10 +24,12 @@
 #include <linux/kprobes.h>
 #include <linux/slab.h>
 #include <linux/kref.h>
+#include <linux/workqueue.h>
+#include <linux/version.h>
 #include <lttng-events.h>
 #include <wrapper/ringbuffer/frontend_types.h>
 #include <wrapper/vmalloc.h>
-#include <wrapper/irqflags.h>
+#include <wrapper/trace-clock.h>
 #include <lttng-tracer.h>
 
 enum lttng_kretprobe_type {
@@ -35,13 +37,104 @@ enum lttng_kretprobe_type {
 	EVENT_RETURN = 1,
 };
 
+/*
+ * While armed, the kretprobe is checked for entries missed for lack of a
+ * free instance once per period, and its instance pool doubled if any,
+ * up to LTTNG_KRETPROBE_MAXACTIVE_PER_CPU instances per possible CPU.
+ */
+#define LTTNG_KRETPROBE_GROW_PERIOD		(HZ / 10)
+#define LTTNG_KRETPROBE_MAXACTIVE_PER_CPU	16
+
+/*
+ * The instance pool can only be grown on kernels keeping free instances
+ * in a list.
+ */
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,0,0) \
+	&& LINUX_VERSION_CODE < KERNEL_VERSION(5,11,0))
+#define LTTNG_KRETPROBE_GROW
+#endif
+
 struct lttng_krp {
 	struct kretprobe krp;
 	struct lttng_event *event[2];	/* ENTRY and RETURN */
 	struct kref kref_register;
 	struct kref kref_alloc;
+	unsigned int latency:1;		/* Fused entry/return records */
+	u64 latency_threshold;		/* ns */
+#ifdef LTTNG_KRETPROBE_GROW
+	struct delayed_work grow_work;	/* Instance pool growth */
+	int grow_nmissed;		/* nmissed at the last growth */
+#endif
 };
 
+#ifdef LTTNG_KRETPROBE_GROW
+/*
+ * Instances are added to the free list the kernel allocates them in at
+ * registration, and freed with them at unregistration.
+ */
+static
+void lttng_kretprobes_grow(struct kretprobe *krp, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		struct kretprobe_instance *inst;
+		unsigned long flags;
+
+		inst = kmalloc(sizeof(*inst) + krp->data_size, GFP_KERNEL);
+		if (!inst)
+			break;
+		INIT_HLIST_NODE(&inst->hlist);
+		raw_spin_lock_irqsave(&krp->lock, flags);
+		hlist_add_head(&inst->hlist, &krp->free_instances);
+		krp->maxactive++;
+		raw_spin_unlock_irqrestore(&krp->lock, flags);
+	}
+}
+
+static
+void lttng_kretprobes_grow_work(struct work_struct *work)
+{
+	struct lttng_krp *lttng_krp =
+		container_of(work, struct lttng_krp, grow_work.work);
+	struct kretprobe *krp = &lttng_krp->krp;
+	int nmissed = ACCESS_ONCE(krp->nmissed);
+	int max = LTTNG_KRETPROBE_MAXACTIVE_PER_CPU * num_possible_cpus();
+
+	if (nmissed != lttng_krp->grow_nmissed && krp->maxactive < max) {
+		lttng_krp->grow_nmissed = nmissed;
+		lttng_kretprobes_grow(krp, min(krp->maxactive,
+				max - krp->maxactive));
+	}
+	schedule_delayed_work(&lttng_krp->grow_work,
+			LTTNG_KRETPROBE_GROW_PERIOD);
+}
+
+static
+void lttng_kretprobes_grow_start(struct lttng_krp *lttng_krp)
+{
+	lttng_krp->grow_nmissed = ACCESS_ONCE(lttng_krp->krp.nmissed);
+	schedule_delayed_work(&lttng_krp->grow_work,
+			LTTNG_KRETPROBE_GROW_PERIOD);
+}
+
+static
+void lttng_kretprobes_grow_stop(struct lttng_krp *lttng_krp)
+{
+	cancel_delayed_work_sync(&lttng_krp->grow_work);
+}
+#else
+static
+void lttng_kretprobes_grow_start(struct lttng_krp *lttng_krp)
+{
+}
+
+static
+void lttng_kretprobes_grow_stop(struct lttng_krp *lttng_krp)
+{
+}
+#endif
+
 static
 int _lttng_kretprobes_handler(struct kretprobe_instance *krpi,
 			      struct pt_regs *regs,
@@ -53,7 +146,7 @@ int _lttng_kretprobes_handler(struct kretprobe_instance *krpi,
 		lttng_krp->event[type];
 	struct lttng_probe_ctx lttng_probe_ctx = {
 		.event = event,
-		.interruptible = !lttng_regs_irqs_disabled(regs),
+		.regs = regs,
 	};
 	struct lttng_channel *chan = event->chan;
 	struct lib_ring_buffer_ctx ctx;
@@ -61,25 +154,40 @@ int _lttng_kretprobes_handler(struct kretprobe_instance *krpi,
 	struct {
 		unsigned long ip;
 		unsigned long parent_ip;
+		uint64_t duration;	/* Latency return events only */
 	} payload;
+	uint64_t filter_stack_data[3];	/* ip, parent_ip, duration */
+	size_t payload_len = offsetof(typeof(payload), duration);
+	size_t payload_align = lttng_alignof(unsigned long);
 
-	if (unlikely(!ACCESS_ONCE(chan->session->active)))
-		return 0;
-	if (unlikely(!ACCESS_ONCE(chan->enabled)))
-		return 0;
-	if (unlikely(!ACCESS_ONCE(event->enabled)))
+	if (unlikely(!ACCESS_ONCE(event->effective_enabled)))
 		return 0;
 
 	payload.ip = (unsigned long) krpi->rp->kp.addr;
 	payload.parent_ip = (unsigned long) krpi->ret_addr;
+	filter_stack_data[0] = payload.ip;
+	filter_stack_data[1] = payload.parent_ip;
+	if (lttng_krp->latency) {
+		payload.duration = trace_clock_read64() - *(u64 *) krpi->data;
+		if (payload.duration < lttng_krp->latency_threshold)
+			return 0;
+		filter_stack_data[2] = payload.duration;
+		payload_len = sizeof(payload);
+		payload_align = lttng_alignof(payload);
+	}
+	if (!lttng_event_probe_check(event, &lttng_probe_ctx,
+			(const char *) filter_stack_data))
+		return 0;
 
-	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx, sizeof(payload),
-				 lttng_alignof(payload), -1);
+	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx, payload_len,
+				 payload_align, -1);
 	ret = chan->ops->event_reserve(&ctx, event->id);
-	if (ret < 0)
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(event, ret);
 		return 0;
-	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(payload));
-	chan->ops->event_write(&ctx, &payload, sizeof(payload));
+	}
+	lib_ring_buffer_align_ctx(&ctx, payload_align);
+	chan->ops->event_write(&ctx, &payload, payload_len);
 	chan->ops->event_commit(&ctx);
 	return 0;
 }
@@ -88,6 +196,16 @@ static
 int lttng_kretprobes_handler_entry(struct kretprobe_instance *krpi,
 				   struct pt_regs *regs)
 {
+	struct lttng_krp *lttng_krp =
+		container_of(krpi->rp, struct lttng_krp, krp);
+
+	if (lttng_krp->latency) {
+		/* Do not run the return handler if it cannot record. */
+		if (unlikely(!ACCESS_ONCE(lttng_krp->event[EVENT_RETURN]->effective_enabled)))
+			return 1;
+		*(u64 *) krpi->data = trace_clock_read64();
+		return 0;
+	}
 	return _lttng_kretprobes_handler(krpi, regs, EVENT_ENTRY);
 }
 
@@ -103,7 +221,7 @@ int lttng_kretprobes_handler_return(struct kretprobe_instance *krpi,
  */
 static
 int lttng_create_kprobe_event(const char *name, struct lttng_event *event,
-			      enum lttng_kretprobe_type type)
+			      enum lttng_kretprobe_type type, bool latency)
 {
 	struct lttng_event_field *fields;
 	struct lttng_event_desc *desc;
@@ -121,7 +239,7 @@ int lttng_create_kprobe_event(const char *name, struct lttng_event *event,
 		suffix = "_entry";
 		break;
 	case EVENT_RETURN:
-		suffix = "_return";
+		suffix = latency ? "_latency" : "_return";
 		break;
 	}
 	name_len += strlen(suffix);
@@ -133,9 +251,10 @@ int lttng_create_kprobe_event(const char *name, struct lttng_event *event,
 	strcpy(alloc_name, name);
 	strcat(alloc_name, suffix);
 	desc->name = alloc_name;
-	desc->nr_fields = 2;
+	desc->nr_fields = (latency && type == EVENT_RETURN) ? 3 : 2;
 	desc->fields = fields =
-		kzalloc(2 * sizeof(struct lttng_event_field), GFP_KERNEL);
+		kzalloc(desc->nr_fields * sizeof(struct lttng_event_field),
+			GFP_KERNEL);
 	if (!desc->fields) {
 		ret = -ENOMEM;
 		goto error_fields;
@@ -158,6 +277,17 @@ int lttng_create_kprobe_event(const char *name, struct lttng_event *event,
 	fields[1].type.u.basic.integer.base = 16;
 	fields[1].type.u.basic.integer.encoding = lttng_encode_none;
 
+	if (desc->nr_fields > 2) {
+		fields[2].name = "duration";
+		fields[2].type.atype = atype_integer;
+		fields[2].type.u.basic.integer.size = sizeof(uint64_t) * CHAR_BIT;
+		fields[2].type.u.basic.integer.alignment = lttng_alignof(uint64_t) * CHAR_BIT;
+		fields[2].type.u.basic.integer.signedness = lttng_is_signed_type(uint64_t);
+		fields[2].type.u.basic.integer.reverse_byte_order = 0;
+		fields[2].type.u.basic.integer.base = 10;
+		fields[2].type.u.basic.integer.encoding = lttng_encode_none;
+	}
+
 	desc->owner = THIS_MODULE;
 	event->desc = desc;
 
@@ -170,24 +300,38 @@ error_str:
 	return ret;
 }
 
+struct lttng_event *lttng_kretprobes_return_event(struct lttng_event *event)
+{
+	struct lttng_krp *lttng_krp = event->u.kretprobe.lttng_krp;
+
+	return lttng_krp->event[EVENT_RETURN];
+}
+EXPORT_SYMBOL_GPL(lttng_kretprobes_return_event);
+
 int lttng_kretprobes_register(const char *name,
 			   const char *symbol_name,
 			   uint64_t offset,
 			   uint64_t addr,
+			   uint32_t flags,
+			   uint64_t latency_threshold,
 			   struct lttng_event *event_entry,
 			   struct lttng_event *event_return)
 {
 	int ret;
 	struct lttng_krp *lttng_krp;
+	bool latency = flags & LTTNG_KERNEL_KRETPROBE_FLAG_LATENCY;
 
+	if (flags & ~LTTNG_KERNEL_KRETPROBE_FLAG_LATENCY)
+		return -EINVAL;
 	/* Kprobes expects a NULL symbol name if unused */
 	if (symbol_name[0] == '\0')
 		symbol_name = NULL;
 
-	ret = lttng_create_kprobe_event(name, event_entry, EVENT_ENTRY);
+	ret = lttng_create_kprobe_event(name, event_entry, EVENT_ENTRY, latency);
 	if (ret)
 		goto error;
-	ret = lttng_create_kprobe_event(name, event_return, EVENT_RETURN);
+	ret = lttng_create_kprobe_event(name, event_return, EVENT_RETURN,
+			latency);
 	if (ret)
 		goto event_return_error;
 	lttng_krp = kzalloc(sizeof(*lttng_krp), GFP_KERNEL);
@@ -195,6 +339,12 @@ int lttng_kretprobes_register(const char *name,
 		goto krp_error;
 	lttng_krp->krp.entry_handler = lttng_kretprobes_handler_entry;
 	lttng_krp->krp.handler = lttng_kretprobes_handler_return;
+	if (latency) {
+		/* Entry timestamp, kept in the kretprobe instance. */
+		lttng_krp->krp.data_size = sizeof(u64);
+		lttng_krp->latency = 1;
+		lttng_krp->latency_threshold = latency_threshold;
+	}
 	if (symbol_name) {
 		char *alloc_symbol;
 
@@ -212,6 +362,11 @@ int lttng_kretprobes_register(const char *name,
 	}
 	lttng_krp->krp.kp.offset = offset;
 	lttng_krp->krp.kp.addr = (void *) (unsigned long) addr;
+	/* Armed by lttng_kretprobes_event_arm() once an event is enabled. */
+	lttng_krp->krp.kp.flags = KPROBE_FLAG_DISABLED;
+#ifdef LTTNG_KRETPROBE_GROW
+	INIT_DELAYED_WORK(&lttng_krp->grow_work, lttng_kretprobes_grow_work);
+#endif
 
 	/* Allow probe handler to find event structures */
 	lttng_krp->event[EVENT_ENTRY] = event_entry;
@@ -262,6 +417,8 @@ void _lttng_kretprobes_unregister_release(struct kref *kref)
 {
 	struct lttng_krp *lttng_krp =
 		container_of(kref, struct lttng_krp, kref_register);
+
+	lttng_kretprobes_grow_stop(lttng_krp);
 	unregister_kretprobe(&lttng_krp->krp);
 }
 
@@ -306,10 +463,55 @@ int lttng_kretprobes_event_enable_state(struct lttng_event *event,
 	event_return = lttng_krp->event[EVENT_RETURN];
 	ACCESS_ONCE(event->enabled) = enable;
 	ACCESS_ONCE(event_return->enabled) = enable;
-	return 0;
+	lttng_event_update_effective_enabled(event);
+	lttng_event_update_effective_enabled(event_return);
+	return lttng_kretprobes_event_arm(event);
 }
 EXPORT_SYMBOL_GPL(lttng_kretprobes_event_enable_state);
 
+/*
+ * The kretprobe is shared by the entry and return events: keep it
+ * inserted while either of them can record. Return instances already
+ * pending when it is disarmed still fire, and are filtered out by the
+ * effective enable state of the return event. Its instance pool only
+ * grows while armed. Should be called with sessions lock held, after
+ * any change of the effective enable state.
+ */
+int lttng_kretprobes_event_arm(struct lttng_event *event)
+{
+	struct lttng_krp *lttng_krp = event->u.kretprobe.lttng_krp;
+	struct kretprobe *krp = &lttng_krp->krp;
+	int armed, ret;
+
+	armed = lttng_krp->event[EVENT_ENTRY]->effective_enabled
+		|| lttng_krp->event[EVENT_RETURN]->effective_enabled;
+	if (armed == !kprobe_disabled(&krp->kp))
+		return 0;
+	if (armed) {
+		ret = enable_kretprobe(krp);
+		if (!ret)
+			lttng_kretprobes_grow_start(lttng_krp);
+		return ret;
+	}
+	lttng_kretprobes_grow_stop(lttng_krp);
+	return disable_kretprobe(krp);
+}
+EXPORT_SYMBOL_GPL(lttng_kretprobes_event_arm);
+
+/*
+ * Returns missed for lack of a free instance are attributed to the
+ * return event.
+ */
+uint64_t lttng_kretprobes_missed(struct lttng_event *event)
+{
+	struct lttng_krp *lttng_krp = event->u.kretprobe.lttng_krp;
+
+	if (event != lttng_krp->event[EVENT_RETURN])
+		return 0;
+	return (uint64_t) ACCESS_ONCE(lttng_krp->krp.nmissed);
+}
+EXPORT_SYMBOL_GPL(lttng_kretprobes_missed);
+
 MODULE_LICENSE("GPL and additional rights");
 MODULE_AUTHOR("Mathieu Desnoyers");
 MODULE_DESCRIPTION("Linux Trace Toolkit Kretprobes Support");
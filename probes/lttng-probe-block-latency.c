@@ -0,0 +1,233 @@
+/*
+ * probes/lttng-probe-block-latency.c
+ *
+ * LTTng block request latency probe. Pairs the block_rq_issue and
+ * block_rq_complete kernel tracepoints of each request in the kernel,
+ * and emits a single block_rq_latency event per completed request,
+ * optionally only for requests slower than a threshold.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/blkdev.h>
+#include <linux/genhd.h>
+#include <linux/hash.h>
+#include <linux/vmalloc.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <lttng-kernel-version.h>
+#include <wrapper/tracepoint.h>
+#include <wrapper/vmalloc.h>
+#include <wrapper/trace-clock.h>
+
+#define TP_MODULE_NOAUTOLOAD
+#define LTTNG_PACKAGE_BUILD
+#define CREATE_TRACE_POINTS
+#define TRACE_INCLUDE_PATH instrumentation/events/lttng-module
+#define TRACE_INCLUDE_FILE block_rq_latency
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-module/block_rq_latency.h>
+
+DEFINE_TRACE(block_rq_latency);
+
+/* Requests in flight tracked at once, across all devices. */
+#define LTTNG_BLOCK_LATENCY_BITS	14
+#define LTTNG_BLOCK_LATENCY_SLOTS	(1U << LTTNG_BLOCK_LATENCY_BITS)
+/* Slot claimed by an issue, timestamp not yet published. */
+#define LTTNG_BLOCK_LATENCY_BUSY	1UL
+
+/*
+ * Issue time of a request in flight. The table is shared by all CPUs:
+ * a request is often completed from the interrupt of another CPU than
+ * the one which issued it.
+ */
+struct lttng_block_latency_slot {
+	unsigned long rq;
+	u64 timestamp;
+};
+
+static struct lttng_block_latency_slot *latency_table;
+
+static unsigned long threshold_ns;
+module_param(threshold_ns, ulong, 0644);
+MODULE_PARM_DESC(threshold_ns,
+	"Only emit block_rq_latency for requests at least this slow (ns)");
+
+static
+struct lttng_block_latency_slot *latency_slot(struct request *rq)
+{
+	return &latency_table[hash_ptr(rq, LTTNG_BLOCK_LATENCY_BITS)];
+}
+
+/*
+ * A request colliding with another one in flight is not tracked: its
+ * completion finds no match and is not emitted.
+ */
+static
+void lttng_block_latency_issue(void *__data, struct request_queue *q,
+		struct request *rq)
+{
+	struct lttng_block_latency_slot *slot = latency_slot(rq);
+	unsigned long old;
+
+	old = cmpxchg(&slot->rq, 0, LTTNG_BLOCK_LATENCY_BUSY);
+	if (old == (unsigned long) rq) {
+		/* Issued again without completion, e.g. after a requeue. */
+		old = cmpxchg(&slot->rq, (unsigned long) rq,
+				LTTNG_BLOCK_LATENCY_BUSY);
+		if (old != (unsigned long) rq)
+			return;
+	} else if (old) {
+		return;
+	}
+	ACCESS_ONCE(slot->timestamp) = trace_clock_read64();
+	smp_wmb();	/* Timestamp before the request owning it. */
+	ACCESS_ONCE(slot->rq) = (unsigned long) rq;
+}
+
+/*
+ * Returns the issue time of "rq" and frees its slot, or 0 if it is not
+ * tracked.
+ */
+static
+u64 lttng_block_latency_take(struct request *rq)
+{
+	struct lttng_block_latency_slot *slot = latency_slot(rq);
+	u64 timestamp;
+
+	if (ACCESS_ONCE(slot->rq) != (unsigned long) rq)
+		return 0;
+	smp_rmb();	/* Request before its timestamp. */
+	timestamp = ACCESS_ONCE(slot->timestamp);
+	if (cmpxchg(&slot->rq, (unsigned long) rq, 0) != (unsigned long) rq)
+		return 0;
+	return timestamp;
+}
+
+static
+void lttng_block_latency_complete(void *__data, struct request_queue *q,
+		struct request *rq
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,5)	\
+	|| LTTNG_KERNEL_RANGE(3,12,21, 3,13,0)		\
+	|| LTTNG_KERNEL_RANGE(3,10,41, 3,11,0)		\
+	|| LTTNG_KERNEL_RANGE(3,4,91, 3,5,0)		\
+	|| LTTNG_KERNEL_RANGE(3,2,58, 3,3,0)		\
+	|| LTTNG_UBUNTU_KERNEL_RANGE(3,13,11,28, 3,14,0,0)	\
+	|| LTTNG_RHEL_KERNEL_RANGE(3,10,0,229,0,0, 3,11,0,0,0,0))
+		, unsigned int nr_bytes
+#endif
+		)
+{
+	u64 timestamp, latency;
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,5)	\
+	|| LTTNG_KERNEL_RANGE(3,12,21, 3,13,0)		\
+	|| LTTNG_KERNEL_RANGE(3,10,41, 3,11,0)		\
+	|| LTTNG_KERNEL_RANGE(3,4,91, 3,5,0)		\
+	|| LTTNG_KERNEL_RANGE(3,2,58, 3,3,0)		\
+	|| LTTNG_UBUNTU_KERNEL_RANGE(3,13,11,28, 3,14,0,0)	\
+	|| LTTNG_RHEL_KERNEL_RANGE(3,10,0,229,0,0, 3,11,0,0,0,0))
+	/* Partial completion: the request stays in flight. */
+	if (nr_bytes < blk_rq_bytes(rq))
+		return;
+#endif
+	timestamp = lttng_block_latency_take(rq);
+	if (!timestamp)
+		return;
+	latency = trace_clock_read64() - timestamp;
+	if (latency < ACCESS_ONCE(threshold_ns))
+		return;
+	trace_block_rq_latency(rq->rq_disk ? disk_devt(rq->rq_disk) : 0,
+		blk_rq_pos(rq), blk_rq_sectors(rq), latency);
+}
+
+static
+void lttng_block_latency_requeue(void *__data, struct request_queue *q,
+		struct request *rq)
+{
+	(void) lttng_block_latency_take(rq);
+}
+
+static
+int __init lttng_block_latency_init(void)
+{
+	int ret;
+
+	(void) wrapper_lttng_fixup_sig(THIS_MODULE);
+	latency_table = vzalloc(LTTNG_BLOCK_LATENCY_SLOTS
+				* sizeof(struct lttng_block_latency_slot));
+	if (!latency_table)
+		return -ENOMEM;
+	wrapper_vmalloc_sync_all();
+	ret = __lttng_events_init__block_rq();
+	if (ret)
+		goto error_events;
+	ret = lttng_wrapper_tracepoint_probe_register("block_rq_issue",
+			(void *) lttng_block_latency_issue, NULL);
+	if (ret)
+		goto error_issue;
+	ret = lttng_wrapper_tracepoint_probe_register("block_rq_requeue",
+			(void *) lttng_block_latency_requeue, NULL);
+	if (ret)
+		goto error_requeue;
+	ret = lttng_wrapper_tracepoint_probe_register("block_rq_complete",
+			(void *) lttng_block_latency_complete, NULL);
+	if (ret)
+		goto error_complete;
+	return 0;
+
+error_complete:
+	lttng_wrapper_tracepoint_probe_unregister("block_rq_requeue",
+			(void *) lttng_block_latency_requeue, NULL);
+error_requeue:
+	lttng_wrapper_tracepoint_probe_unregister("block_rq_issue",
+			(void *) lttng_block_latency_issue, NULL);
+error_issue:
+	__lttng_events_exit__block_rq();
+error_events:
+	vfree(latency_table);
+	return ret;
+}
+
+module_init(lttng_block_latency_init);
+
+static
+void __exit lttng_block_latency_exit(void)
+{
+	lttng_wrapper_tracepoint_probe_unregister("block_rq_complete",
+			(void *) lttng_block_latency_complete, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("block_rq_requeue",
+			(void *) lttng_block_latency_requeue, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("block_rq_issue",
+			(void *) lttng_block_latency_issue, NULL);
+	__lttng_events_exit__block_rq();
+	/* Wait for the probes in flight before freeing their table. */
+	synchronize_trace();
+	vfree(latency_table);
+}
+
+module_exit(lttng_block_latency_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng block request latency probe");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,237 @@
+/*
+ * probes/lttng-probe-io-uring-latency.c
+ *
+ * LTTng io_uring request latency probe. Pairs the io_uring_submit_sqe
+ * and io_uring_complete kernel tracepoints of each request in the
+ * kernel, by ring and user data, and emits a single io_uring_latency
+ * event per completed request, optionally only for requests slower
+ * than a threshold. With the SUMMARY action, or map channels with the
+ * DURATION key, rings issuing millions of requests per second are
+ * followed without a record per request.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/hash.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <wrapper/tracepoint.h>
+#include <wrapper/vmalloc.h>
+#include <wrapper/trace-clock.h>
+
+#define TP_MODULE_NOAUTOLOAD
+#define LTTNG_PACKAGE_BUILD
+#define CREATE_TRACE_POINTS
+#define TRACE_INCLUDE_PATH instrumentation/events/lttng-module
+#define TRACE_INCLUDE_FILE io_uring_latency
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-module/io_uring_latency.h>
+
+DEFINE_TRACE(io_uring_latency);
+
+/* Requests in flight tracked at once, across all rings. */
+#define LTTNG_IO_URING_LATENCY_BITS	16
+#define LTTNG_IO_URING_LATENCY_SLOTS	(1U << LTTNG_IO_URING_LATENCY_BITS)
+/* Slot claimed by a submission, request not yet published. */
+#define LTTNG_IO_URING_LATENCY_BUSY	1UL
+
+/*
+ * Submission of a request in flight. The table is shared by all CPUs:
+ * requests are often completed by io-wq workers or interrupts on other
+ * CPUs than the submitter.
+ */
+struct lttng_io_uring_latency_slot {
+	unsigned long ctx;
+	u64 user_data;
+	u64 timestamp;
+	u8 opcode;
+};
+
+static struct lttng_io_uring_latency_slot *latency_table;
+
+static unsigned long threshold_ns;
+module_param(threshold_ns, ulong, 0644);
+MODULE_PARM_DESC(threshold_ns,
+	"Only emit io_uring_latency for requests at least this slow (ns)");
+
+static
+struct lttng_io_uring_latency_slot *latency_slot(void *ctx, u64 user_data)
+{
+	return &latency_table[hash_64(user_data ^ (unsigned long) ctx,
+				LTTNG_IO_URING_LATENCY_BITS)];
+}
+
+/*
+ * A request colliding with another one in flight, e.g. sharing its user
+ * data, is not tracked: its completion finds no match and is not
+ * emitted.
+ */
+static
+void lttng_io_uring_latency_submit_sqe(void *__data, void *ctx,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,14,0))
+		void *req, u8 opcode, u64 user_data, u32 flags,
+#else
+		u8 opcode, u64 user_data,
+#endif
+		bool force_nonblock, bool sq_thread)
+{
+	struct lttng_io_uring_latency_slot *slot =
+		latency_slot(ctx, user_data);
+
+	if (cmpxchg(&slot->ctx, 0, LTTNG_IO_URING_LATENCY_BUSY))
+		return;
+	slot->user_data = user_data;
+	slot->opcode = opcode;
+	slot->timestamp = trace_clock_read64();
+	smp_wmb();	/* Request before the ring owning it. */
+	ACCESS_ONCE(slot->ctx) = (unsigned long) ctx;
+}
+
+/*
+ * Returns the submission time of the request and frees its slot, or 0
+ * if it is not tracked.
+ */
+static
+u64 lttng_io_uring_latency_take(void *ctx, u64 user_data, u8 *opcode)
+{
+	struct lttng_io_uring_latency_slot *slot =
+		latency_slot(ctx, user_data);
+	u64 timestamp;
+
+	if (ACCESS_ONCE(slot->ctx) != (unsigned long) ctx)
+		return 0;
+	smp_rmb();	/* Ring before its request. */
+	if (slot->user_data != user_data)
+		return 0;
+	timestamp = slot->timestamp;
+	*opcode = slot->opcode;
+	if (cmpxchg(&slot->ctx, (unsigned long) ctx, 0)
+			!= (unsigned long) ctx)
+		return 0;
+	return timestamp;
+}
+
+static
+void lttng_io_uring_latency_complete(void *__data, void *ctx,
+		u64 user_data, long res
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,12,0))
+		, unsigned cflags
+#endif
+		)
+{
+	u64 timestamp, latency;
+	u8 opcode;
+
+	timestamp = lttng_io_uring_latency_take(ctx, user_data, &opcode);
+	if (!timestamp)
+		return;
+	latency = trace_clock_read64() - timestamp;
+	if (latency < ACCESS_ONCE(threshold_ns))
+		return;
+	trace_io_uring_latency(ctx, opcode, user_data, res, latency);
+}
+
+/*
+ * Requests of a torn down ring may never complete. Their slots are
+ * freed when a ring is created at the same address, so that its
+ * completions are not paired with them.
+ */
+static
+void lttng_io_uring_latency_create(void *__data, int fd, void *ctx,
+		u32 sq_entries, u32 cq_entries, u32 flags)
+{
+	unsigned int i;
+
+	for (i = 0; i < LTTNG_IO_URING_LATENCY_SLOTS; i++) {
+		struct lttng_io_uring_latency_slot *slot = &latency_table[i];
+
+		if (ACCESS_ONCE(slot->ctx) == (unsigned long) ctx)
+			(void) cmpxchg(&slot->ctx, (unsigned long) ctx, 0);
+	}
+}
+
+static
+int __init lttng_io_uring_latency_init(void)
+{
+	int ret;
+
+	(void) wrapper_lttng_fixup_sig(THIS_MODULE);
+	latency_table = vzalloc(LTTNG_IO_URING_LATENCY_SLOTS
+				* sizeof(struct lttng_io_uring_latency_slot));
+	if (!latency_table)
+		return -ENOMEM;
+	wrapper_vmalloc_sync_all();
+	ret = __lttng_events_init__io_uring_latency();
+	if (ret)
+		goto error_events;
+	ret = lttng_wrapper_tracepoint_probe_register("io_uring_create",
+			(void *) lttng_io_uring_latency_create, NULL);
+	if (ret)
+		goto error_create;
+	ret = lttng_wrapper_tracepoint_probe_register("io_uring_submit_sqe",
+			(void *) lttng_io_uring_latency_submit_sqe, NULL);
+	if (ret)
+		goto error_submit;
+	ret = lttng_wrapper_tracepoint_probe_register("io_uring_complete",
+			(void *) lttng_io_uring_latency_complete, NULL);
+	if (ret)
+		goto error_complete;
+	return 0;
+
+error_complete:
+	lttng_wrapper_tracepoint_probe_unregister("io_uring_submit_sqe",
+			(void *) lttng_io_uring_latency_submit_sqe, NULL);
+error_submit:
+	lttng_wrapper_tracepoint_probe_unregister("io_uring_create",
+			(void *) lttng_io_uring_latency_create, NULL);
+error_create:
+	__lttng_events_exit__io_uring_latency();
+error_events:
+	vfree(latency_table);
+	return ret;
+}
+
+module_init(lttng_io_uring_latency_init);
+
+static
+void __exit lttng_io_uring_latency_exit(void)
+{
+	lttng_wrapper_tracepoint_probe_unregister("io_uring_complete",
+			(void *) lttng_io_uring_latency_complete, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("io_uring_submit_sqe",
+			(void *) lttng_io_uring_latency_submit_sqe, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("io_uring_create",
+			(void *) lttng_io_uring_latency_create, NULL);
+	__lttng_events_exit__io_uring_latency();
+	/* Wait for the probes in flight before freeing their table. */
+	synchronize_trace();
+	vfree(latency_table);
+}
+
+module_exit(lttng_io_uring_latency_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng io_uring request latency probe");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
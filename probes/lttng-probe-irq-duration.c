@@ -0,0 +1,226 @@
+/*
+ * probes/lttng-probe-irq-duration.c
+ *
+ * LTTng irq duration probe. Pairs the irq_handler_entry/exit and the
+ * softirq_entry/exit kernel tracepoints on each CPU, and emits a single
+ * irq_duration_handler or irq_duration_softirq event per handler run,
+ * optionally only for handlers slower than a threshold. Map channels
+ * with the DURATION key and the LOG2_DURATION value keep per-vector
+ * histograms of these durations.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/interrupt.h>
+#include <linux/percpu.h>
+#include <linux/version.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <wrapper/tracepoint.h>
+#include <wrapper/trace-clock.h>
+
+#define TP_MODULE_NOAUTOLOAD
+#define LTTNG_PACKAGE_BUILD
+#define CREATE_TRACE_POINTS
+#define TRACE_INCLUDE_PATH instrumentation/events/lttng-module
+#define TRACE_INCLUDE_FILE irq_duration
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-module/irq_duration.h>
+
+DEFINE_TRACE(irq_duration_handler);
+DEFINE_TRACE(irq_duration_softirq);
+
+/* Nesting levels tracked per CPU, deeper handlers are not emitted. */
+#define LTTNG_IRQ_DURATION_NESTING	4
+
+/*
+ * Entry time of the handlers running on a CPU, per nesting level. Only
+ * touched from the CPU it belongs to, in the context it tracks: a
+ * hardirq interrupting a softirq uses the other state.
+ */
+struct lttng_irq_duration_cpu {
+	unsigned int depth;
+	u64 entry[LTTNG_IRQ_DURATION_NESTING];
+};
+
+static DEFINE_PER_CPU(struct lttng_irq_duration_cpu, hardirq_duration);
+static DEFINE_PER_CPU(struct lttng_irq_duration_cpu, softirq_duration);
+
+static unsigned long threshold_ns;
+module_param(threshold_ns, ulong, 0644);
+MODULE_PARM_DESC(threshold_ns,
+	"Only emit irq durations of handlers at least this slow (ns)");
+
+static
+void lttng_irq_duration_enter(struct lttng_irq_duration_cpu *state)
+{
+	unsigned int depth = state->depth;
+
+	if (depth < LTTNG_IRQ_DURATION_NESTING)
+		state->entry[depth] = trace_clock_read64();
+	barrier();	/* Entry time before nested handlers see the depth. */
+	state->depth = depth + 1;
+}
+
+/*
+ * Returns the duration of the handler exiting, or 0 if its entry is not
+ * tracked, e.g. when the probe was loaded while it was running.
+ */
+static
+u64 lttng_irq_duration_exit(struct lttng_irq_duration_cpu *state)
+{
+	unsigned int depth = state->depth;
+	u64 duration;
+
+	if (!depth)
+		return 0;
+	depth--;
+	if (depth < LTTNG_IRQ_DURATION_NESTING)
+		duration = trace_clock_read64() - state->entry[depth];
+	else
+		duration = 0;
+	barrier();
+	state->depth = depth;
+	if (duration < ACCESS_ONCE(threshold_ns))
+		return 0;
+	return duration;
+}
+
+static
+void lttng_irq_duration_handler_entry(void *__data, int irq,
+		struct irqaction *action)
+{
+	lttng_irq_duration_enter(this_cpu_ptr(&hardirq_duration));
+}
+
+static
+void lttng_irq_duration_handler_exit(void *__data, int irq,
+		struct irqaction *action, int ret)
+{
+	u64 duration;
+
+	duration = lttng_irq_duration_exit(this_cpu_ptr(&hardirq_duration));
+	if (duration)
+		trace_irq_duration_handler(irq, ret, duration);
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,37))
+static
+void lttng_irq_duration_softirq_entry(void *__data, unsigned int vec_nr)
+{
+	lttng_irq_duration_enter(this_cpu_ptr(&softirq_duration));
+}
+
+static
+void lttng_irq_duration_softirq_exit(void *__data, unsigned int vec_nr)
+{
+	u64 duration;
+
+	duration = lttng_irq_duration_exit(this_cpu_ptr(&softirq_duration));
+	if (duration)
+		trace_irq_duration_softirq(vec_nr, duration);
+}
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,37)) */
+static
+void lttng_irq_duration_softirq_entry(void *__data,
+		struct softirq_action *h, struct softirq_action *vec)
+{
+	lttng_irq_duration_enter(this_cpu_ptr(&softirq_duration));
+}
+
+static
+void lttng_irq_duration_softirq_exit(void *__data,
+		struct softirq_action *h, struct softirq_action *vec)
+{
+	u64 duration;
+
+	duration = lttng_irq_duration_exit(this_cpu_ptr(&softirq_duration));
+	if (duration)
+		trace_irq_duration_softirq((unsigned int) (h - vec), duration);
+}
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,37)) */
+
+static
+int __init lttng_irq_duration_init(void)
+{
+	int ret;
+
+	(void) wrapper_lttng_fixup_sig(THIS_MODULE);
+	ret = __lttng_events_init__irq_duration();
+	if (ret)
+		return ret;
+	ret = lttng_wrapper_tracepoint_probe_register("irq_handler_entry",
+			(void *) lttng_irq_duration_handler_entry, NULL);
+	if (ret)
+		goto error_handler_entry;
+	ret = lttng_wrapper_tracepoint_probe_register("irq_handler_exit",
+			(void *) lttng_irq_duration_handler_exit, NULL);
+	if (ret)
+		goto error_handler_exit;
+	ret = lttng_wrapper_tracepoint_probe_register("softirq_entry",
+			(void *) lttng_irq_duration_softirq_entry, NULL);
+	if (ret)
+		goto error_softirq_entry;
+	ret = lttng_wrapper_tracepoint_probe_register("softirq_exit",
+			(void *) lttng_irq_duration_softirq_exit, NULL);
+	if (ret)
+		goto error_softirq_exit;
+	return 0;
+
+error_softirq_exit:
+	lttng_wrapper_tracepoint_probe_unregister("softirq_entry",
+			(void *) lttng_irq_duration_softirq_entry, NULL);
+error_softirq_entry:
+	lttng_wrapper_tracepoint_probe_unregister("irq_handler_exit",
+			(void *) lttng_irq_duration_handler_exit, NULL);
+error_handler_exit:
+	lttng_wrapper_tracepoint_probe_unregister("irq_handler_entry",
+			(void *) lttng_irq_duration_handler_entry, NULL);
+error_handler_entry:
+	__lttng_events_exit__irq_duration();
+	return ret;
+}
+
+module_init(lttng_irq_duration_init);
+
+static
+void __exit lttng_irq_duration_exit_module(void)
+{
+	lttng_wrapper_tracepoint_probe_unregister("softirq_exit",
+			(void *) lttng_irq_duration_softirq_exit, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("softirq_entry",
+			(void *) lttng_irq_duration_softirq_entry, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("irq_handler_exit",
+			(void *) lttng_irq_duration_handler_exit, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("irq_handler_entry",
+			(void *) lttng_irq_duration_handler_entry, NULL);
+	__lttng_events_exit__irq_duration();
+	/* Wait for the probes in flight before unloading their code. */
+	synchronize_trace();
+}
+
+module_exit(lttng_irq_duration_exit_module);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng irq duration probe");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
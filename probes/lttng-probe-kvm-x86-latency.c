@@ -0,0 +1,191 @@
+/*
+ * probes/lttng-probe-kvm-x86-latency.c
+ *
+ * LTTng kvm x86 latency probe. Pairs the kvm_exit and kvm_entry kernel
+ * tracepoints of each vcpu thread, and emits a single
+ * kvm_x86_latency_exit event per VM exit with the time spent in the
+ * host, optionally only for exits slower than a threshold.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/hash.h>
+#include <linux/vmalloc.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <wrapper/tracepoint.h>
+#include <wrapper/vmalloc.h>
+#include <wrapper/trace-clock.h>
+
+#define TP_MODULE_NOAUTOLOAD
+#define LTTNG_PACKAGE_BUILD
+#define CREATE_TRACE_POINTS
+#define TRACE_INCLUDE_PATH instrumentation/events/lttng-module/arch/x86/kvm
+#define TRACE_INCLUDE_FILE latency
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-module/arch/x86/kvm/latency.h>
+
+DEFINE_TRACE(kvm_x86_latency_exit);
+
+struct kvm_vcpu;
+
+/* vcpu threads tracked at once, across all VMs. */
+#define LTTNG_KVM_LATENCY_BITS		10
+#define LTTNG_KVM_LATENCY_SLOTS		(1U << LTTNG_KVM_LATENCY_BITS)
+
+/*
+ * Last VM exit of a vcpu thread. A vcpu may be preempted and migrated
+ * between its exit and its next entry, but both run in its thread, which
+ * owns the slot.
+ */
+struct lttng_kvm_latency_slot {
+	unsigned long task;
+	unsigned int exit_reason;
+	u64 timestamp;
+};
+
+static struct lttng_kvm_latency_slot *latency_table;
+
+static unsigned long threshold_ns;
+module_param(threshold_ns, ulong, 0644);
+MODULE_PARM_DESC(threshold_ns,
+	"Only emit kvm_x86_latency_exit for exits at least this slow (ns)");
+
+static
+struct lttng_kvm_latency_slot *latency_slot(struct task_struct *p)
+{
+	return &latency_table[hash_ptr(p, LTTNG_KVM_LATENCY_BITS)];
+}
+
+/*
+ * A vcpu thread colliding with another one is not tracked: a slot
+ * stays owned by its thread until it enters the guest again.
+ */
+static
+void lttng_kvm_latency_exit(void *__data, unsigned int exit_reason,
+		struct kvm_vcpu *vcpu, u32 isa)
+{
+	struct lttng_kvm_latency_slot *slot = latency_slot(current);
+	unsigned long old;
+
+	old = ACCESS_ONCE(slot->task);
+	if (old != (unsigned long) current) {
+		if (old || cmpxchg(&slot->task, 0, (unsigned long) current))
+			return;
+	}
+	slot->exit_reason = exit_reason;
+	slot->timestamp = trace_clock_read64();
+}
+
+static
+void lttng_kvm_latency_entry(void *__data, unsigned int vcpu_id)
+{
+	struct lttng_kvm_latency_slot *slot = latency_slot(current);
+	u64 duration;
+
+	if (ACCESS_ONCE(slot->task) != (unsigned long) current
+			|| !slot->timestamp)
+		return;
+	duration = trace_clock_read64() - slot->timestamp;
+	slot->timestamp = 0;
+	if (duration >= ACCESS_ONCE(threshold_ns))
+		trace_kvm_x86_latency_exit(vcpu_id, slot->exit_reason,
+			duration);
+}
+
+/*
+ * Called when a task exits: frees the slot of a vcpu thread.
+ */
+static
+void lttng_kvm_latency_process_exit(void *__data, struct task_struct *p)
+{
+	struct lttng_kvm_latency_slot *slot = latency_slot(p);
+
+	if (ACCESS_ONCE(slot->task) == (unsigned long) p)
+		(void) cmpxchg(&slot->task, (unsigned long) p, 0);
+}
+
+static
+int __init lttng_kvm_latency_init(void)
+{
+	int ret;
+
+	(void) wrapper_lttng_fixup_sig(THIS_MODULE);
+	latency_table = vzalloc(LTTNG_KVM_LATENCY_SLOTS
+				* sizeof(struct lttng_kvm_latency_slot));
+	if (!latency_table)
+		return -ENOMEM;
+	wrapper_vmalloc_sync_all();
+	ret = __lttng_events_init__kvm_x86_latency();
+	if (ret)
+		goto error_events;
+	ret = lttng_wrapper_tracepoint_probe_register("sched_process_exit",
+			(void *) lttng_kvm_latency_process_exit, NULL);
+	if (ret)
+		goto error_process_exit;
+	ret = lttng_wrapper_tracepoint_probe_register("kvm_exit",
+			(void *) lttng_kvm_latency_exit, NULL);
+	if (ret)
+		goto error_exit;
+	ret = lttng_wrapper_tracepoint_probe_register("kvm_entry",
+			(void *) lttng_kvm_latency_entry, NULL);
+	if (ret)
+		goto error_entry;
+	return 0;
+
+error_entry:
+	lttng_wrapper_tracepoint_probe_unregister("kvm_exit",
+			(void *) lttng_kvm_latency_exit, NULL);
+error_exit:
+	lttng_wrapper_tracepoint_probe_unregister("sched_process_exit",
+			(void *) lttng_kvm_latency_process_exit, NULL);
+error_process_exit:
+	__lttng_events_exit__kvm_x86_latency();
+error_events:
+	vfree(latency_table);
+	return ret;
+}
+
+module_init(lttng_kvm_latency_init);
+
+static
+void __exit lttng_kvm_latency_exit_module(void)
+{
+	lttng_wrapper_tracepoint_probe_unregister("kvm_entry",
+			(void *) lttng_kvm_latency_entry, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("kvm_exit",
+			(void *) lttng_kvm_latency_exit, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("sched_process_exit",
+			(void *) lttng_kvm_latency_process_exit, NULL);
+	__lttng_events_exit__kvm_x86_latency();
+	/* Wait for the probes in flight before freeing their table. */
+	synchronize_trace();
+	vfree(latency_table);
+}
+
+module_exit(lttng_kvm_latency_exit_module);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng kvm x86 latency probe");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,178 @@
+/*
+ * probes/lttng-probe-lock-contention.c
+ *
+ * LTTng lock contention probe. Pairs the lock_contended and
+ * lock_acquired kernel tracepoints of each task, which fire on every
+ * lock operation of lockstat kernels, and emits a lock_contention_wait
+ * event per contended acquisition, folded per lock class by map
+ * channels with the DURATION key and the LOG2_DURATION value, and a
+ * lock_contention_slow event only for waits longer than a threshold.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/lockdep.h>
+#include <linux/sched.h>
+#include <linux/hash.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <wrapper/tracepoint.h>
+#include <wrapper/vmalloc.h>
+#include <wrapper/trace-clock.h>
+
+#define TP_MODULE_NOAUTOLOAD
+#define LTTNG_PACKAGE_BUILD
+#define CREATE_TRACE_POINTS
+#define TRACE_INCLUDE_PATH instrumentation/events/lttng-module
+#define TRACE_INCLUDE_FILE lock_contention
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-module/lock_contention.h>
+
+DEFINE_TRACE(lock_contention_wait);
+DEFINE_TRACE(lock_contention_slow);
+
+/* Tasks waiting for a lock tracked at once, across all CPUs. */
+#define LTTNG_LOCK_CONTENTION_BITS	12
+#define LTTNG_LOCK_CONTENTION_SLOTS	(1U << LTTNG_LOCK_CONTENTION_BITS)
+
+/*
+ * Lock a task is waiting for. Once claimed, the slot is only accessed
+ * by its task, both tracepoints being emitted by the waiter.
+ */
+struct lttng_lock_contention_slot {
+	unsigned long task;
+	struct lockdep_map *lock;
+	u64 timestamp;
+};
+
+static struct lttng_lock_contention_slot *contention_table;
+
+static unsigned long threshold_ns = 1000000;
+module_param(threshold_ns, ulong, 0644);
+MODULE_PARM_DESC(threshold_ns,
+	"Only emit lock_contention_slow for waits at least this long (ns)");
+
+static
+struct lttng_lock_contention_slot *contention_slot(struct task_struct *p)
+{
+	return &contention_table[hash_ptr(p, LTTNG_LOCK_CONTENTION_BITS)];
+}
+
+/*
+ * A task colliding with another waiting task is not tracked. A task
+ * giving up a wait, e.g. interrupted while waiting for a mutex, keeps
+ * its slot until its next contention. A contention nested in the wait,
+ * from an interrupt handler, replaces the outer one, which is lost.
+ */
+static
+void lttng_lock_contention_contended(void *__data, struct lockdep_map *lock,
+		unsigned long ip)
+{
+	struct lttng_lock_contention_slot *slot = contention_slot(current);
+
+	if (ACCESS_ONCE(slot->task) != (unsigned long) current
+			&& cmpxchg(&slot->task, 0, (unsigned long) current))
+		return;
+	slot->lock = lock;
+	slot->timestamp = trace_clock_read64();
+}
+
+/*
+ * Also called for the locks acquired without contention, which have no
+ * matching slot.
+ */
+static
+void lttng_lock_contention_acquired(void *__data, struct lockdep_map *lock,
+		unsigned long ip)
+{
+	struct lttng_lock_contention_slot *slot = contention_slot(current);
+	u64 wait;
+
+	if (ACCESS_ONCE(slot->task) != (unsigned long) current
+			|| slot->lock != lock)
+		return;
+	wait = trace_clock_read64() - slot->timestamp;
+	barrier();	/* Slot content read before release. */
+	ACCESS_ONCE(slot->task) = 0;
+	trace_lock_contention_wait(lock, wait);
+	if (wait < ACCESS_ONCE(threshold_ns))
+		return;
+	trace_lock_contention_slow(lock, ip, wait);
+}
+
+static
+int __init lttng_lock_contention_init(void)
+{
+	int ret;
+
+	(void) wrapper_lttng_fixup_sig(THIS_MODULE);
+	contention_table = vzalloc(LTTNG_LOCK_CONTENTION_SLOTS
+				* sizeof(struct lttng_lock_contention_slot));
+	if (!contention_table)
+		return -ENOMEM;
+	wrapper_vmalloc_sync_all();
+	ret = __lttng_events_init__lock_contention();
+	if (ret)
+		goto error_events;
+	ret = lttng_wrapper_tracepoint_probe_register("lock_contended",
+			(void *) lttng_lock_contention_contended, NULL);
+	if (ret)
+		goto error_contended;
+	ret = lttng_wrapper_tracepoint_probe_register("lock_acquired",
+			(void *) lttng_lock_contention_acquired, NULL);
+	if (ret)
+		goto error_acquired;
+	return 0;
+
+error_acquired:
+	lttng_wrapper_tracepoint_probe_unregister("lock_contended",
+			(void *) lttng_lock_contention_contended, NULL);
+error_contended:
+	__lttng_events_exit__lock_contention();
+error_events:
+	vfree(contention_table);
+	return ret;
+}
+
+module_init(lttng_lock_contention_init);
+
+static
+void __exit lttng_lock_contention_exit(void)
+{
+	lttng_wrapper_tracepoint_probe_unregister("lock_acquired",
+			(void *) lttng_lock_contention_acquired, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("lock_contended",
+			(void *) lttng_lock_contention_contended, NULL);
+	__lttng_events_exit__lock_contention();
+	/* Wait for the probes in flight before freeing their table. */
+	synchronize_trace();
+	vfree(contention_table);
+}
+
+module_exit(lttng_lock_contention_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng lock contention probe");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -22,6 +22,7 @@
  */
 
 #include <linux/module.h>
+#include <linux/moduleparam.h>
 #include <lttng-tracer.h>
 
 /*
@@ -37,6 +38,13 @@
 #define CREATE_TRACE_POINTS
 #define TRACE_INCLUDE_PATH instrumentation/events/lttng-module
 
+static unsigned int payload_snaplen;
+module_param(payload_snaplen, uint, 0644);
+MODULE_PARM_DESC(payload_snaplen,
+		"Number of bytes of packet data recorded by the net_dev_queue, "
+		"netif_receive_skb and netif_rx events (up to 65535, "
+		"default: 0).");
+
 #include <instrumentation/events/lttng-module/net.h>
 
 MODULE_LICENSE("GPL and additional rights");
@@ -0,0 +1,217 @@
+/*
+ * probes/lttng-probe-sched-latency.c
+ *
+ * LTTng scheduler latency probe. Pairs the sched_wakeup and sched_switch
+ * kernel tracepoints of each task in the kernel, and emits a single
+ * sched_wakeup_latency event when a woken up task is switched in,
+ * optionally only for tasks which waited longer than a threshold.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/sched.h>
+#include <linux/hash.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <lttng-kernel-version.h>
+#include <wrapper/tracepoint.h>
+#include <wrapper/vmalloc.h>
+#include <wrapper/trace-clock.h>
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,9,0))
+#include <linux/sched/rt.h>	/* for MAX_RT_PRIO */
+#endif
+
+#define TP_MODULE_NOAUTOLOAD
+#define LTTNG_PACKAGE_BUILD
+#define CREATE_TRACE_POINTS
+#define TRACE_INCLUDE_PATH instrumentation/events/lttng-module
+#define TRACE_INCLUDE_FILE sched_wakeup_latency
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-module/sched_wakeup_latency.h>
+
+DEFINE_TRACE(sched_wakeup_latency);
+
+/* Woken up tasks tracked at once, across all CPUs. */
+#define LTTNG_SCHED_LATENCY_BITS	12
+#define LTTNG_SCHED_LATENCY_SLOTS	(1U << LTTNG_SCHED_LATENCY_BITS)
+/* Slot claimed by a wakeup, timestamp not yet published. */
+#define LTTNG_SCHED_LATENCY_BUSY	1UL
+
+/*
+ * Wakeup time of a task not yet switched in. The table is shared by all
+ * CPUs: a task is often woken up from another CPU than the one it runs
+ * on.
+ */
+struct lttng_sched_latency_slot {
+	unsigned long task;
+	u64 timestamp;
+};
+
+static struct lttng_sched_latency_slot *latency_table;
+
+static unsigned long threshold_ns;
+module_param(threshold_ns, ulong, 0644);
+MODULE_PARM_DESC(threshold_ns,
+	"Only emit sched_wakeup_latency for tasks waiting at least this long (ns)");
+
+static
+struct lttng_sched_latency_slot *latency_slot(struct task_struct *p)
+{
+	return &latency_table[hash_ptr(p, LTTNG_SCHED_LATENCY_BITS)];
+}
+
+/*
+ * A task colliding with another woken up task is not tracked: its
+ * switch finds no match and is not emitted. A task woken up again
+ * before being switched in keeps its first wakeup time.
+ */
+static
+void lttng_sched_latency_wakeup_task(struct task_struct *p)
+{
+	struct lttng_sched_latency_slot *slot = latency_slot(p);
+
+	if (cmpxchg(&slot->task, 0, LTTNG_SCHED_LATENCY_BUSY))
+		return;
+	ACCESS_ONCE(slot->timestamp) = trace_clock_read64();
+	smp_wmb();	/* Timestamp before the task owning it. */
+	ACCESS_ONCE(slot->task) = (unsigned long) p;
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0) || \
+	LTTNG_RT_KERNEL_RANGE(4,1,10,11, 4,2,0,0))
+static
+void lttng_sched_latency_wakeup(void *__data, struct task_struct *p)
+{
+	lttng_sched_latency_wakeup_task(p);
+}
+#elif (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35))
+static
+void lttng_sched_latency_wakeup(void *__data, struct task_struct *p,
+		int success)
+{
+	lttng_sched_latency_wakeup_task(p);
+}
+#else
+static
+void lttng_sched_latency_wakeup(void *__data, struct rq *rq,
+		struct task_struct *p, int success)
+{
+	lttng_sched_latency_wakeup_task(p);
+}
+#endif
+
+/*
+ * Called with interrupts off, right before the CPU switches to "next".
+ */
+static
+void lttng_sched_latency_switch(void *__data,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,4,0))
+		bool preempt,
+#elif (LINUX_VERSION_CODE < KERNEL_VERSION(2,6,35))
+		struct rq *rq,
+#endif
+		struct task_struct *prev, struct task_struct *next)
+{
+	struct lttng_sched_latency_slot *slot = latency_slot(next);
+	u64 timestamp, latency;
+
+	if (ACCESS_ONCE(slot->task) != (unsigned long) next)
+		return;
+	smp_rmb();	/* Task before its timestamp. */
+	timestamp = ACCESS_ONCE(slot->timestamp);
+	if (cmpxchg(&slot->task, (unsigned long) next, 0)
+			!= (unsigned long) next)
+		return;
+	latency = trace_clock_read64() - timestamp;
+	if (latency < ACCESS_ONCE(threshold_ns))
+		return;
+	trace_sched_wakeup_latency(next->pid, next->prio - MAX_RT_PRIO,
+		latency);
+}
+
+static
+int __init lttng_sched_latency_init(void)
+{
+	int ret;
+
+	(void) wrapper_lttng_fixup_sig(THIS_MODULE);
+	latency_table = vzalloc(LTTNG_SCHED_LATENCY_SLOTS
+				* sizeof(struct lttng_sched_latency_slot));
+	if (!latency_table)
+		return -ENOMEM;
+	wrapper_vmalloc_sync_all();
+	ret = __lttng_events_init__sched_wakeup();
+	if (ret)
+		goto error_events;
+	ret = lttng_wrapper_tracepoint_probe_register("sched_wakeup",
+			(void *) lttng_sched_latency_wakeup, NULL);
+	if (ret)
+		goto error_wakeup;
+	ret = lttng_wrapper_tracepoint_probe_register("sched_wakeup_new",
+			(void *) lttng_sched_latency_wakeup, NULL);
+	if (ret)
+		goto error_wakeup_new;
+	ret = lttng_wrapper_tracepoint_probe_register("sched_switch",
+			(void *) lttng_sched_latency_switch, NULL);
+	if (ret)
+		goto error_switch;
+	return 0;
+
+error_switch:
+	lttng_wrapper_tracepoint_probe_unregister("sched_wakeup_new",
+			(void *) lttng_sched_latency_wakeup, NULL);
+error_wakeup_new:
+	lttng_wrapper_tracepoint_probe_unregister("sched_wakeup",
+			(void *) lttng_sched_latency_wakeup, NULL);
+error_wakeup:
+	__lttng_events_exit__sched_wakeup();
+error_events:
+	vfree(latency_table);
+	return ret;
+}
+
+module_init(lttng_sched_latency_init);
+
+static
+void __exit lttng_sched_latency_exit(void)
+{
+	lttng_wrapper_tracepoint_probe_unregister("sched_switch",
+			(void *) lttng_sched_latency_switch, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("sched_wakeup_new",
+			(void *) lttng_sched_latency_wakeup, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("sched_wakeup",
+			(void *) lttng_sched_latency_wakeup, NULL);
+	__lttng_events_exit__sched_wakeup();
+	/* Wait for the probes in flight before freeing their table. */
+	synchronize_trace();
+	vfree(latency_table);
+}
+
+module_exit(lttng_sched_latency_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng scheduler latency probe");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
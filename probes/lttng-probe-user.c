@@ -20,8 +20,86 @@
 
 #include <linux/uaccess.h>
 #include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/version.h>
 #include <probes/lttng-probe-user.h>
 
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,5,0))
+#include <asm/word-at-a-time.h>
+#endif
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,5,0))
+
+/*
+ * Non-zero mask of the "misalign" bytes preceding the string in its first
+ * aligned word.
+ */
+static inline
+unsigned long lttng_strlen_leading_mask(unsigned long misalign)
+{
+#ifdef __BIG_ENDIAN
+	return ~(~0UL >> (misalign * BITS_PER_BYTE));
+#else
+	return (1UL << (misalign * BITS_PER_BYTE)) - 1;
+#endif
+}
+
+/*
+ * Calculate string length. Include final null terminating character if there is
+ * one, or ends at first fault. Disabling page faults ensures that we can safely
+ * call this from pretty much any context, including those where the caller
+ * holds mmap_sem, or any lock which nests in mmap_sem.
+ *
+ * The string is read an aligned word at a time, like strncpy_from_user()
+ * does. An aligned word never crosses a page boundary, so no page the
+ * string does not touch is read, and a fault happens at the same page as
+ * with byte reads.
+ */
+long lttng_strlen_user_inatomic(const char *addr)
+{
+	const struct word_at_a_time constants = WORD_AT_A_TIME_CONSTANTS;
+	unsigned long misalign;
+	const char *waddr;
+	long count;
+	mm_segment_t old_fs;
+
+	if (!addr)
+		return 0;
+
+	misalign = (unsigned long) addr & (sizeof(unsigned long) - 1);
+	waddr = addr - misalign;
+	old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	pagefault_disable();
+	for (;;) {
+		unsigned long v, data;
+
+		if (unlikely(!access_ok(VERIFY_READ,
+				(__force const char __user *) waddr,
+				sizeof(v))))
+			break;
+		if (unlikely(__copy_from_user_inatomic(&v,
+				(__force const char __user *) waddr,
+				sizeof(v))))
+			break;
+		if (waddr < addr)
+			v |= lttng_strlen_leading_mask(misalign);
+		if (has_zero(v, &data, &constants)) {
+			data = prep_zero_mask(v, data, &constants);
+			data = create_zero_mask(data);
+			waddr += find_zero(data) + 1;
+			break;
+		}
+		waddr += sizeof(v);
+	}
+	pagefault_enable();
+	set_fs(old_fs);
+	count = waddr - addr;
+	return max_t(long, count, 0);
+}
+
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,5,0)) */
+
 /*
  * Calculate string length. Include final null terminating character if there is
  * one, or ends at first fault. Disabling page faults ensures that we can safely
@@ -61,4 +139,7 @@ long lttng_strlen_user_inatomic(const char *addr)
 	set_fs(old_fs);
 	return count;
 }
+
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,5,0)) */
+
 EXPORT_SYMBOL_GPL(lttng_strlen_user_inatomic);
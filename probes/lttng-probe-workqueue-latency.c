@@ -0,0 +1,259 @@
+/*
+ * probes/lttng-probe-workqueue-latency.c
+ *
+ * LTTng workqueue latency probe. Pairs the workqueue_queue_work,
+ * workqueue_execute_start and workqueue_execute_end kernel tracepoints
+ * of each work item, and emits a single workqueue_latency_exec event
+ * per executed work, with its queue delay and execution time,
+ * optionally only for works slower than a threshold. Map channels with
+ * the DURATION key and the LOG2_DURATION value keep per-function
+ * histograms of these latencies.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/workqueue.h>
+#include <linux/hash.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
+#include <lttng-events.h>
+#include <lttng-tracer.h>
+#include <wrapper/tracepoint.h>
+#include <wrapper/vmalloc.h>
+#include <wrapper/trace-clock.h>
+
+#define TP_MODULE_NOAUTOLOAD
+#define LTTNG_PACKAGE_BUILD
+#define CREATE_TRACE_POINTS
+#define TRACE_INCLUDE_PATH instrumentation/events/lttng-module
+#define TRACE_INCLUDE_FILE workqueue_latency
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-module/workqueue_latency.h>
+
+DEFINE_TRACE(workqueue_latency_delay);
+DEFINE_TRACE(workqueue_latency_exec);
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,9,0))
+struct pool_workqueue;
+#else
+struct cpu_workqueue_struct;
+#endif
+
+/* Works queued or running tracked at once, across all CPUs. */
+#define LTTNG_WQ_LATENCY_BITS	12
+#define LTTNG_WQ_LATENCY_SLOTS	(1U << LTTNG_WQ_LATENCY_BITS)
+/* Slot claimed, content not yet published. */
+#define LTTNG_WQ_LATENCY_BUSY	1UL
+
+/*
+ * Queue time of a pending work. A work is often queued from another CPU
+ * than the one running it.
+ */
+struct lttng_wq_queue_slot {
+	unsigned long work;
+	u64 timestamp;
+};
+
+/*
+ * Start of a running work. The work function is read at start: the work
+ * may be freed by its function, so it is only used as a key at end.
+ */
+struct lttng_wq_exec_slot {
+	unsigned long work;
+	void *function;
+	u64 delay;
+	u64 timestamp;
+};
+
+static struct lttng_wq_queue_slot *queue_table;
+static struct lttng_wq_exec_slot *exec_table;
+
+static unsigned long threshold_ns;
+module_param(threshold_ns, ulong, 0644);
+MODULE_PARM_DESC(threshold_ns,
+	"Only emit workqueue_latency_exec for works running at least this long (ns)");
+
+static
+unsigned long wq_latency_hash(struct work_struct *work)
+{
+	return hash_ptr(work, LTTNG_WQ_LATENCY_BITS);
+}
+
+/*
+ * A work colliding with another pending one is not tracked, and a work
+ * queued again before running keeps its first queue time.
+ */
+static
+void lttng_wq_latency_queue(void *__data, unsigned int req_cpu,
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,9,0))
+		struct pool_workqueue *pwq,
+#else
+		struct cpu_workqueue_struct *cwq,
+#endif
+		struct work_struct *work)
+{
+	struct lttng_wq_queue_slot *slot = &queue_table[wq_latency_hash(work)];
+
+	if (cmpxchg(&slot->work, 0, LTTNG_WQ_LATENCY_BUSY))
+		return;
+	ACCESS_ONCE(slot->timestamp) = trace_clock_read64();
+	smp_wmb();	/* Timestamp before the work owning it. */
+	ACCESS_ONCE(slot->work) = (unsigned long) work;
+}
+
+/*
+ * Returns the queue time of "work" and frees its slot, or 0 if it is not
+ * tracked.
+ */
+static
+u64 lttng_wq_latency_take_queue(struct work_struct *work)
+{
+	struct lttng_wq_queue_slot *slot = &queue_table[wq_latency_hash(work)];
+	u64 timestamp;
+
+	if (ACCESS_ONCE(slot->work) != (unsigned long) work)
+		return 0;
+	smp_rmb();	/* Work before its timestamp. */
+	timestamp = ACCESS_ONCE(slot->timestamp);
+	if (cmpxchg(&slot->work, (unsigned long) work, 0)
+			!= (unsigned long) work)
+		return 0;
+	return timestamp;
+}
+
+static
+void lttng_wq_latency_execute_start(void *__data, struct work_struct *work)
+{
+	struct lttng_wq_exec_slot *slot = &exec_table[wq_latency_hash(work)];
+	u64 queued, now, delay = 0;
+
+	queued = lttng_wq_latency_take_queue(work);
+	now = trace_clock_read64();
+	if (queued) {
+		delay = now - queued;
+		trace_workqueue_latency_delay((void *) work->func, delay);
+	}
+	if (cmpxchg(&slot->work, 0, LTTNG_WQ_LATENCY_BUSY))
+		return;
+	slot->function = (void *) work->func;
+	slot->delay = delay;
+	ACCESS_ONCE(slot->timestamp) = now;
+	smp_wmb();	/* Content before the work owning it. */
+	ACCESS_ONCE(slot->work) = (unsigned long) work;
+}
+
+/* "work" may have been freed: it is only compared. */
+static
+void lttng_wq_latency_execute_end(void *__data, struct work_struct *work)
+{
+	struct lttng_wq_exec_slot *slot = &exec_table[wq_latency_hash(work)];
+	void *function;
+	u64 delay, timestamp, duration;
+
+	if (ACCESS_ONCE(slot->work) != (unsigned long) work)
+		return;
+	smp_rmb();	/* Work before its content. */
+	function = slot->function;
+	delay = slot->delay;
+	timestamp = ACCESS_ONCE(slot->timestamp);
+	if (cmpxchg(&slot->work, (unsigned long) work, 0)
+			!= (unsigned long) work)
+		return;
+	duration = trace_clock_read64() - timestamp;
+	if (duration < ACCESS_ONCE(threshold_ns))
+		return;
+	trace_workqueue_latency_exec(function, delay, duration);
+}
+
+static
+int __init lttng_wq_latency_init(void)
+{
+	int ret;
+
+	(void) wrapper_lttng_fixup_sig(THIS_MODULE);
+	queue_table = vzalloc(LTTNG_WQ_LATENCY_SLOTS
+				* sizeof(struct lttng_wq_queue_slot));
+	if (!queue_table)
+		return -ENOMEM;
+	exec_table = vzalloc(LTTNG_WQ_LATENCY_SLOTS
+				* sizeof(struct lttng_wq_exec_slot));
+	if (!exec_table) {
+		ret = -ENOMEM;
+		goto error_exec_table;
+	}
+	wrapper_vmalloc_sync_all();
+	ret = __lttng_events_init__workqueue_latency();
+	if (ret)
+		goto error_events;
+	ret = lttng_wrapper_tracepoint_probe_register("workqueue_queue_work",
+			(void *) lttng_wq_latency_queue, NULL);
+	if (ret)
+		goto error_queue;
+	ret = lttng_wrapper_tracepoint_probe_register("workqueue_execute_start",
+			(void *) lttng_wq_latency_execute_start, NULL);
+	if (ret)
+		goto error_execute_start;
+	ret = lttng_wrapper_tracepoint_probe_register("workqueue_execute_end",
+			(void *) lttng_wq_latency_execute_end, NULL);
+	if (ret)
+		goto error_execute_end;
+	return 0;
+
+error_execute_end:
+	lttng_wrapper_tracepoint_probe_unregister("workqueue_execute_start",
+			(void *) lttng_wq_latency_execute_start, NULL);
+error_execute_start:
+	lttng_wrapper_tracepoint_probe_unregister("workqueue_queue_work",
+			(void *) lttng_wq_latency_queue, NULL);
+error_queue:
+	__lttng_events_exit__workqueue_latency();
+error_events:
+	vfree(exec_table);
+error_exec_table:
+	vfree(queue_table);
+	return ret;
+}
+
+module_init(lttng_wq_latency_init);
+
+static
+void __exit lttng_wq_latency_exit(void)
+{
+	lttng_wrapper_tracepoint_probe_unregister("workqueue_execute_end",
+			(void *) lttng_wq_latency_execute_end, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("workqueue_execute_start",
+			(void *) lttng_wq_latency_execute_start, NULL);
+	lttng_wrapper_tracepoint_probe_unregister("workqueue_queue_work",
+			(void *) lttng_wq_latency_queue, NULL);
+	__lttng_events_exit__workqueue_latency();
+	/* Wait for the probes in flight before freeing their tables. */
+	synchronize_trace();
+	vfree(exec_table);
+	vfree(queue_table);
+}
+
+module_exit(lttng_wq_latency_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng workqueue latency probe");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,252 @@
+#ifndef _LTTNG_PROBE_WRITE_H
+#define _LTTNG_PROBE_WRITE_H
+
+/*
+ * lttng-probe-write.h
+ *
+ * Field writes of the probes.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/uaccess.h>
+#include <linux/skbuff.h>
+#include <linux/swab.h>
+#include <lttng-endian.h>
+#include <wrapper/ringbuffer/backend.h>
+#include <lttng-events.h>
+
+/*
+ * The writes of the ring buffer library only depend on the backend of
+ * the configuration. For clients with direct_write set, the probe calls
+ * them inline for the page backend rather than calling the operations
+ * of the client for each field.
+ */
+static const struct lib_ring_buffer_config lttng_probe_write_config = {
+	.backend = RING_BUFFER_PAGE,
+};
+
+/*
+ * Records staged for fragmentation are written through the client.
+ */
+static inline
+int lttng_probe_direct_write(struct lttng_channel *chan,
+		struct lib_ring_buffer_ctx *ctx)
+{
+	return chan->ops->direct_write
+		&& !(ctx->rflags & LTTNG_RFLAG_FRAGMENT);
+}
+
+static inline
+void lttng_probe_event_write(struct lttng_channel *chan,
+		struct lib_ring_buffer_ctx *ctx, const void *src, size_t len)
+{
+	if (likely(lttng_probe_direct_write(chan, ctx)))
+		lib_ring_buffer_write(&lttng_probe_write_config, ctx, src, len);
+	else
+		chan->ops->event_write(ctx, src, len);
+}
+
+static inline
+void lttng_probe_event_write_from_user(struct lttng_channel *chan,
+		struct lib_ring_buffer_ctx *ctx, const void __user *src,
+		size_t len)
+{
+	if (likely(lttng_probe_direct_write(chan, ctx)))
+		lib_ring_buffer_copy_from_user_inatomic(
+				&lttng_probe_write_config, ctx, src, len);
+	else
+		chan->ops->event_write_from_user(ctx, src, len);
+}
+
+static inline
+void lttng_probe_event_strcpy(struct lttng_channel *chan,
+		struct lib_ring_buffer_ctx *ctx, const char *src, size_t len)
+{
+	if (likely(lttng_probe_direct_write(chan, ctx)))
+		lib_ring_buffer_strcpy(&lttng_probe_write_config, ctx, src,
+				len, '#');
+	else
+		chan->ops->event_strcpy(ctx, src, len);
+}
+
+static inline
+void lttng_probe_event_strcpy_from_user(struct lttng_channel *chan,
+		struct lib_ring_buffer_ctx *ctx, const char __user *src,
+		size_t len)
+{
+	if (likely(lttng_probe_direct_write(chan, ctx)))
+		lib_ring_buffer_strcpy_from_user_inatomic(
+				&lttng_probe_write_config, ctx, src, len, '#');
+	else
+		chan->ops->event_strcpy_from_user(ctx, src, len);
+}
+
+/*
+ * Copy the first len bytes of the data of an skb. The paged fragments
+ * are copied by skb_copy_bits() in chunks, the record possibly spanning
+ * several buffer pages. Bytes which cannot be copied are zeroed.
+ */
+static inline
+void lttng_probe_event_write_skb(struct lttng_channel *chan,
+		struct lib_ring_buffer_ctx *ctx, const struct sk_buff *skb,
+		size_t len)
+{
+	size_t offset = min_t(size_t, len, skb_headlen(skb)), chunk;
+	char bounce[64];
+
+	lttng_probe_event_write(chan, ctx, skb->data, offset);
+	for (; offset < len; offset += chunk) {
+		chunk = min_t(size_t, len - offset, sizeof(bounce));
+		if (skb_copy_bits(skb, offset, bounce, chunk))
+			memset(bounce, 0, chunk);
+		lttng_probe_event_write(chan, ctx, bounce, chunk);
+	}
+}
+
+/*
+ * The consecutive user-space fields of an event are copied within a
+ * single section with page faults disabled, opened by the first of
+ * them and closed before the next field needing the usual address
+ * limit, or at the end of the event.
+ */
+struct lttng_probe_uaccess {
+	mm_segment_t old_fs;
+	int open;
+};
+
+static inline
+void lttng_probe_uaccess_begin(struct lttng_probe_uaccess *uaccess)
+{
+	if (uaccess->open)
+		return;
+	uaccess->old_fs = get_fs();
+	set_fs(KERNEL_DS);
+	pagefault_disable();
+	uaccess->open = 1;
+}
+
+static inline
+void lttng_probe_uaccess_end(struct lttng_probe_uaccess *uaccess)
+{
+	if (!uaccess->open)
+		return;
+	pagefault_enable();
+	set_fs(uaccess->old_fs);
+	uaccess->open = 0;
+}
+
+static inline
+void lttng_probe_event_write_from_user_uaccess(struct lttng_channel *chan,
+		struct lttng_probe_uaccess *uaccess,
+		struct lib_ring_buffer_ctx *ctx, const void __user *src,
+		size_t len)
+{
+	if (likely(lttng_probe_direct_write(chan, ctx))) {
+		lttng_probe_uaccess_begin(uaccess);
+		lib_ring_buffer_copy_from_user_uaccess(
+				&lttng_probe_write_config, ctx, src, len);
+	} else {
+		chan->ops->event_write_from_user(ctx, src, len);
+	}
+}
+
+static inline
+void lttng_probe_event_strcpy_from_user_uaccess(struct lttng_channel *chan,
+		struct lttng_probe_uaccess *uaccess,
+		struct lib_ring_buffer_ctx *ctx, const char __user *src,
+		size_t len)
+{
+	if (likely(lttng_probe_direct_write(chan, ctx))) {
+		lttng_probe_uaccess_begin(uaccess);
+		lib_ring_buffer_strcpy_from_user_uaccess(
+				&lttng_probe_write_config, ctx, src, len, '#');
+	} else {
+		chan->ops->event_strcpy_from_user(ctx, src, len);
+	}
+}
+
+/* Bounce buffer of the bitfield arrays converted to little endian. */
+#define LTTNG_PROBE_BITFIELD_CHUNK	64
+
+/*
+ * Convert nr elements of elem_size bytes to little endian, in place, one
+ * native word swap per element.
+ */
+static inline
+void lttng_probe_bitfield_to_le(void *data, size_t elem_size, size_t nr)
+{
+#if (__BYTE_ORDER == __BIG_ENDIAN)
+	size_t i;
+
+	switch (elem_size) {
+	case 2:
+		for (i = 0; i < nr; i++)
+			__swab16s((uint16_t *) data + i);
+		break;
+	case 4:
+		for (i = 0; i < nr; i++)
+			__swab32s((uint32_t *) data + i);
+		break;
+	case 8:
+		for (i = 0; i < nr; i++)
+			__swab64s((uint64_t *) data + i);
+		break;
+	}
+#endif
+}
+
+/*
+ * Bitfield arrays and sequences are recorded in little endian, as an
+ * array of bits. Little endian architectures write them as is. Big
+ * endian ones convert them through a bounce buffer, a chunk at a time,
+ * rather than writing each element on its own. Elements of user-space
+ * arrays which cannot be copied are zeroed.
+ */
+static inline
+void lttng_probe_event_write_bitfield(struct lttng_channel *chan,
+		struct lttng_probe_uaccess *uaccess,
+		struct lib_ring_buffer_ctx *ctx, const void *src,
+		size_t elem_size, size_t nr, int user)
+{
+#if (__BYTE_ORDER == __LITTLE_ENDIAN)
+	if (user)
+		lttng_probe_event_write_from_user_uaccess(chan, uaccess, ctx,
+				(const void __user *) src, elem_size * nr);
+	else
+		lttng_probe_event_write(chan, ctx, src, elem_size * nr);
+#else
+	uint64_t bounce[LTTNG_PROBE_BITFIELD_CHUNK / sizeof(uint64_t)];
+	size_t offset, len = elem_size * nr, chunk;
+
+	if (user)
+		lttng_probe_uaccess_end(uaccess);
+	for (offset = 0; offset < len; offset += chunk) {
+		chunk = min_t(size_t, len - offset, sizeof(bounce));
+		if (!user)
+			memcpy(bounce, (const char *) src + offset, chunk);
+		else if (lib_ring_buffer_copy_from_user_check_nofault(bounce,
+				(const char __user *) src + offset, chunk))
+			memset(bounce, 0, chunk);
+		lttng_probe_bitfield_to_le(bounce, elem_size,
+				chunk / elem_size);
+		lttng_probe_event_write(chan, ctx, bounce, chunk);
+	}
+#endif
+}
+
+#endif /* _LTTNG_PROBE_WRITE_H */
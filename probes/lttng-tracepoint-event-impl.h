@@ -28,10 +28,12 @@
 #include <probes/lttng.h>
 #include <probes/lttng-types.h>
 #include <probes/lttng-probe-user.h>
+#include <probes/lttng-probe-write.h>
 #include <wrapper/vmalloc.h>	/* for wrapper_vmalloc_sync_all() */
 #include <wrapper/ringbuffer/frontend_types.h>
 #include <wrapper/ringbuffer/backend.h>
 #include <wrapper/rcu.h>
+#include <wrapper/pid_namespace.h>
 #include <lttng-events.h>
 #include <lttng-tracer-core.h>
 
@@ -376,6 +378,54 @@ void __event_template_proto___##_name(void);
 	  .user = _user,					\
 	},
 
+#undef _ctf_array_text_dict
+#define _ctf_array_text_dict(_item, _src, _length)		\
+	{							\
+	  .name = #_item,					\
+	  .type =						\
+		{						\
+		  .atype = atype_array,				\
+		  .u =						\
+			{					\
+			  .array =				\
+				{				\
+				  .elem_type = __type_integer(char, 0, 0, 0, __BYTE_ORDER, 10, UTF8), \
+				  .length = _length,		\
+				}				\
+			}					\
+		},						\
+	  .nowrite = 0,						\
+	  .user = 0,						\
+	  .dict = 1,						\
+	},
+
+#undef _ctf_string_dict
+#define _ctf_string_dict(_item, _src)				\
+	{							\
+	  .name = #_item,					\
+	  .type =						\
+		{						\
+		  .atype = atype_string,			\
+		  .u =						\
+			{					\
+			  .basic = { .string = { .encoding = lttng_encode_UTF8 } } \
+			},					\
+		},						\
+	  .nowrite = 0,						\
+	  .user = 0,						\
+	  .dict = 1,						\
+	},
+
+#undef _ctf_integer_delta
+#define _ctf_integer_delta(_type, _item, _src, _base)		\
+	{							\
+	  .name = #_item,					\
+	  .type = __type_integer(_type, 0, 0, -1, __BYTE_ORDER, _base, none),\
+	  .nowrite = 0,						\
+	  .user = 0,						\
+	  .delta = 1,						\
+	},
+
 #undef _ctf_enum
 #define _ctf_enum(_name, _type, _item, _src, _user, _nowrite)	\
 	{							\
@@ -437,6 +487,76 @@ void __event_template_proto___##_name(void);
 
 #include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
 
+/*
+ * Stage 2.1 of the trace events.
+ *
+ * Create the table of field source expressions of the event classes with
+ * local variables, so the filters which do not read fields computed from
+ * them can run before _code_pre.
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <probes/lttng-events-reset.h>
+#include <probes/lttng-events-write.h>
+#include <probes/lttng-events-nowrite.h>
+
+#undef _ctf_integer_ext
+#define _ctf_integer_ext(_type, _item, _src, _byte_order, _base, _user, _nowrite) \
+	#_src,
+
+#undef _ctf_array_encoded
+#define _ctf_array_encoded(_type, _item, _src, _length, _encoding, _user, _nowrite) \
+	#_src " " #_length,
+
+#undef _ctf_array_bitfield
+#define _ctf_array_bitfield(_type, _item, _src, _length, _user, _nowrite) \
+	#_src " " #_length,
+
+#undef _ctf_sequence_encoded
+#define _ctf_sequence_encoded(_type, _item, _src, _length_type,		\
+			_src_length, _encoding, _byte_order, _base, _user, _nowrite) \
+	#_src " " #_src_length,
+
+#undef _ctf_sequence_bitfield
+#define _ctf_sequence_bitfield(_type, _item, _src,		\
+			_length_type, _src_length,		\
+			_user, _nowrite)			\
+	#_src " " #_src_length,
+
+#undef _ctf_string
+#define _ctf_string(_item, _src, _user, _nowrite)		\
+	#_src,
+
+#undef _ctf_enum
+#define _ctf_enum(_name, _type, _item, _src, _user, _nowrite)	\
+	#_src,
+
+/* Custom code may read anything. */
+#undef ctf_custom_field
+#define ctf_custom_field(_type, _item, _code)			\
+	"tp_locvar",
+
+#undef TP_locvar
+#define TP_locvar(...)	__VA_ARGS__
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
+	enum { __event_has_locvar__##_name = sizeof(struct { _locvar }) != 0 }; \
+	static const char * const __event_field_srcs___##_name[] \
+			__attribute__((unused)) = {		     \
+		_fields							     \
+		NULL,							     \
+	};
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+	LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, PARAMS(_locvar), _code_pre, PARAMS(_fields), _code_post)
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
 /*
  * Stage 3 of the trace events.
  *
@@ -492,10 +612,7 @@ static void __event_probe__##_name(void *__data);
 	{										\
 		size_t __seqlen = (_src_length);					\
 											\
-		if (unlikely(++this_cpu_ptr(&lttng_dynamic_len_stack)->offset >= LTTNG_DYNAMIC_LEN_STACK_SIZE)) \
-			goto error;							\
-		barrier();	/* reserve before use. */				\
-		this_cpu_ptr(&lttng_dynamic_len_stack)->stack[this_cpu_ptr(&lttng_dynamic_len_stack)->offset - 1] = __seqlen; \
+		__dynamic_len[__dynamic_len_idx++] = __seqlen;				\
 		__event_len += sizeof(_type) * __seqlen;				\
 	}
 
@@ -512,14 +629,11 @@ static void __event_probe__##_name(void *__data);
  */
 #undef _ctf_string
 #define _ctf_string(_item, _src, _user, _nowrite)			       \
-	if (unlikely(++this_cpu_ptr(&lttng_dynamic_len_stack)->offset >= LTTNG_DYNAMIC_LEN_STACK_SIZE)) \
-		goto error;						       \
-	barrier();	/* reserve before use. */			       \
 	if (_user) {							       \
-		__event_len += this_cpu_ptr(&lttng_dynamic_len_stack)->stack[this_cpu_ptr(&lttng_dynamic_len_stack)->offset - 1] = \
+		__event_len += __dynamic_len[__dynamic_len_idx++] =	       \
 			max_t(size_t, lttng_strlen_user_inatomic(_src), 1);    \
 	} else {							       \
-		__event_len += this_cpu_ptr(&lttng_dynamic_len_stack)->stack[this_cpu_ptr(&lttng_dynamic_len_stack)->offset - 1] = \
+		__event_len += __dynamic_len[__dynamic_len_idx++] =	       \
 			strlen((_src) ? (_src) : __LTTNG_NULL_STRING) + 1; \
 	}
 
@@ -531,6 +645,70 @@ static void __event_probe__##_name(void *__data);
 #define ctf_align(_type)						\
 	__event_len += lib_ring_buffer_align(__event_len, lttng_alignof(_type));
 
+/*
+ * Dictionary ids replace the text in channels with a string dictionary,
+ * the text being defined in the stream before the record.
+ */
+#undef _ctf_array_text_dict
+#define _ctf_array_text_dict(_item, _src, _length)			       \
+	if (__event->string_dict) {					       \
+		__event_len += lib_ring_buffer_align(__event_len, lttng_alignof(uint64_t)); \
+		__event_len += sizeof(uint64_t);			       \
+		lttng_string_dict_define(__event, (_src),		       \
+			strnlen((_src), _length));			       \
+	} else {							       \
+		_ctf_array_encoded(char, _item, _src, _length, UTF8, 0, 0)     \
+	}
+
+#undef _ctf_string_dict
+#define _ctf_string_dict(_item, _src)					       \
+	if (__event->string_dict) {					       \
+		const char *__ctf_tmp_string =				       \
+			((_src) ? (_src) : __LTTNG_NULL_STRING);	       \
+									       \
+		__event_len += lib_ring_buffer_align(__event_len, lttng_alignof(uint64_t)); \
+		__event_len += sizeof(uint64_t);			       \
+		lttng_string_dict_define(__event, __ctf_tmp_string,	       \
+			strlen(__ctf_tmp_string));			       \
+	} else {							       \
+		_ctf_string(_item, _src, 0, 0)				       \
+	}
+
+/*
+ * Delta-encoded integers take a one byte tag, followed by the value or
+ * its difference with the base. The tag and the difference are saved in
+ * two dynamic lengths.
+ */
+#undef _ctf_integer_delta
+#define _ctf_integer_delta(_type, _item, _src, _base)			       \
+	if (__event->delta_state) {					       \
+		union {							       \
+			_type t;					       \
+			uint8_t v8;					       \
+			uint16_t v16;					       \
+			uint32_t v32;					       \
+			uint64_t v64;					       \
+		} __tmp;						       \
+		unsigned int __tag;					       \
+									       \
+		__tmp.t = (_type) (_src);				       \
+		__tag = lttng_delta_encode(__event, __delta_idx++,	       \
+			sizeof(_type) == 1 ? __tmp.v8 :			       \
+			sizeof(_type) == 2 ? __tmp.v16 :		       \
+			sizeof(_type) == 4 ? __tmp.v32 : __tmp.v64,	       \
+			__dynamic_len, &__dynamic_len[__dynamic_len_idx + 1]); \
+		__dynamic_len[__dynamic_len_idx] = __tag;		       \
+		__dynamic_len_idx += 2;					       \
+		__event_len += sizeof(uint8_t);				       \
+		if (__tag >= LTTNG_DELTA_8) {				       \
+			__event_len += lttng_delta_len(__tag);		       \
+		} else {						       \
+			_ctf_integer_ext(_type, _item, _src, __BYTE_ORDER, _base, 0, 0) \
+		}							       \
+	} else {							       \
+		_ctf_integer_ext(_type, _item, _src, __BYTE_ORDER, _base, 0, 0) \
+	}
+
 #undef ctf_custom_field
 #define ctf_custom_field(_type, _item, _code)				\
 	{								\
@@ -551,10 +729,12 @@ static void __event_probe__##_name(void *__data);
 
 #undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
 #define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
-static inline ssize_t __event_get_size__##_name(void *__tp_locvar, _proto)     \
+static inline ssize_t __event_get_size__##_name(size_t *__dynamic_len,   \
+		struct lttng_event *__event, void *__tp_locvar, _proto)	      \
 {									      \
 	size_t __event_len = 0;						      \
 	unsigned int __dynamic_len_idx __attribute__((unused)) = 0;	      \
+	unsigned int __delta_idx __attribute__((unused)) = 0;		      \
 	struct { _locvar } *tp_locvar __attribute__((unused)) = __tp_locvar;  \
 									      \
 	_fields								      \
@@ -567,10 +747,12 @@ error:									      \
 
 #undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS
 #define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
-static inline ssize_t __event_get_size__##_name(void *__tp_locvar)	      \
+static inline ssize_t __event_get_size__##_name(size_t *__dynamic_len,   \
+		struct lttng_event *__event, void *__tp_locvar)		      \
 {									      \
 	size_t __event_len = 0;						      \
 	unsigned int __dynamic_len_idx __attribute__((unused)) = 0;	      \
+	unsigned int __delta_idx __attribute__((unused)) = 0;		      \
 	struct { _locvar } *tp_locvar __attribute__((unused)) = __tp_locvar;  \
 									      \
 	_fields								      \
@@ -694,18 +876,22 @@ error:									      \
 
 #undef _ctf_integer_ext
 #define _ctf_integer_ext(_type, _item, _user_src, _byte_order, _base, _user, _nowrite) \
-	_ctf_integer_ext_isuser##_user(_type, _item, _user_src, _byte_order, _base, _nowrite)
+	if (lttng_filter_field_wanted(__field_mask, __field_idx++)) {	       \
+		_ctf_integer_ext_isuser##_user(_type, _item, _user_src, _byte_order, _base, _nowrite) \
+	} else								       \
+		__stack_data += sizeof(int64_t);
 
 #undef _ctf_array_encoded
 #define _ctf_array_encoded(_type, _item, _src, _length, _encoding, _user, _nowrite) \
-	{								       \
+	if (lttng_filter_field_wanted(__field_mask, __field_idx++)) {	       \
 		unsigned long __ctf_tmp_ulong = (unsigned long) (_length);     \
 		const void *__ctf_tmp_ptr = (_src);			       \
 		memcpy(__stack_data, &__ctf_tmp_ulong, sizeof(unsigned long)); \
 		__stack_data += sizeof(unsigned long);			       \
 		memcpy(__stack_data, &__ctf_tmp_ptr, sizeof(void *));	       \
 		__stack_data += sizeof(void *);				       \
-	}
+	} else								       \
+		__stack_data += sizeof(unsigned long) + sizeof(void *);
 
 #undef _ctf_array_bitfield
 #define _ctf_array_bitfield(_type, _item, _src, _length, _user, _nowrite) \
@@ -714,14 +900,15 @@ error:									      \
 #undef _ctf_sequence_encoded
 #define _ctf_sequence_encoded(_type, _item, _src, _length_type,		       \
 			_src_length, _encoding, _byte_order, _base, _user, _nowrite) \
-	{								       \
+	if (lttng_filter_field_wanted(__field_mask, __field_idx++)) {	       \
 		unsigned long __ctf_tmp_ulong = (unsigned long) (_src_length); \
 		const void *__ctf_tmp_ptr = (_src);			       \
 		memcpy(__stack_data, &__ctf_tmp_ulong, sizeof(unsigned long)); \
 		__stack_data += sizeof(unsigned long);			       \
 		memcpy(__stack_data, &__ctf_tmp_ptr, sizeof(void *));	       \
 		__stack_data += sizeof(void *);				       \
-	}
+	} else								       \
+		__stack_data += sizeof(unsigned long) + sizeof(void *);
 
 #undef _ctf_sequence_bitfield
 #define _ctf_sequence_bitfield(_type, _item, _src,		\
@@ -732,17 +919,25 @@ error:									      \
 
 #undef _ctf_string
 #define _ctf_string(_item, _src, _user, _nowrite)			       \
-	{								       \
+	if (lttng_filter_field_wanted(__field_mask, __field_idx++)) {	       \
 		const void *__ctf_tmp_ptr =				       \
 			((_src) ? (_src) : __LTTNG_NULL_STRING);	       \
 		memcpy(__stack_data, &__ctf_tmp_ptr, sizeof(void *));	       \
 		__stack_data += sizeof(void *);				       \
-	}
+	} else								       \
+		__stack_data += sizeof(void *);
 
 #undef _ctf_enum
 #define _ctf_enum(_name, _type, _item, _src, _user, _nowrite)		       \
 	_ctf_integer_ext(_type, _item, _src, __BYTE_ORDER, 10, _user, _nowrite)
 
+/* Filters only see the linear head of the skb data. */
+#undef _ctf_sequence_skb
+#define _ctf_sequence_skb(_item, _skb, _length)			       \
+	_ctf_sequence_encoded(uint8_t, _item, (_skb)->data, uint16_t,	       \
+		min_t(size_t, _length, skb_headlen(_skb)), none,	       \
+		__BYTE_ORDER, 16, 0, 0)
+
 #undef TP_PROTO
 #define TP_PROTO(...) __VA_ARGS__
 
@@ -756,9 +951,10 @@ error:									      \
 #define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
 static inline								      \
 void __event_prepare_filter_stack__##_name(char *__stack_data,		      \
-		void *__tp_locvar)					      \
+		const unsigned long *__field_mask, void *__tp_locvar)	      \
 {									      \
 	struct { _locvar } *tp_locvar __attribute__((unused)) = __tp_locvar;  \
+	unsigned int __field_idx __attribute__((unused)) = 0;		      \
 									      \
 	_fields								      \
 }
@@ -767,9 +963,10 @@ void __event_prepare_filter_stack__##_name(char *__stack_data,		      \
 #define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
 static inline								      \
 void __event_prepare_filter_stack__##_name(char *__stack_data,		      \
-		void *__tp_locvar, _proto)				      \
+		const unsigned long *__field_mask, void *__tp_locvar, _proto) \
 {									      \
 	struct { _locvar } *tp_locvar __attribute__((unused)) = __tp_locvar;  \
+	unsigned int __field_idx __attribute__((unused)) = 0;		      \
 									      \
 	_fields								      \
 }
@@ -777,50 +974,108 @@ void __event_prepare_filter_stack__##_name(char *__stack_data,		      \
 #include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
 
 /*
- * Stage 5 of the trace events.
+ * Stage 4.2 of tracepoint event generation.
  *
- * Create static inline function that calculates event payload alignment.
+ * Create a compile-time flag telling whether the event payload size is
+ * static: integers, enumerations and arrays only. The size and alignment
+ * functions of such events reduce to constants.
  */
 
 /* Reset all macros within TRACEPOINT_EVENT */
 #include <probes/lttng-events-reset.h>
 #include <probes/lttng-events-write.h>
 
-#undef _ctf_integer_ext
-#define _ctf_integer_ext(_type, _item, _src, _byte_order, _base, _user, _nowrite) \
-	__event_align = max_t(size_t, __event_align, lttng_alignof(_type));
+#undef _ctf_sequence_encoded
+#define _ctf_sequence_encoded(_type, _item, _src, _length_type,			\
+			_src_length, _encoding, _byte_order, _base, _user, _nowrite) \
+	&& 0
 
-#undef _ctf_array_encoded
-#define _ctf_array_encoded(_type, _item, _src, _length, _encoding, _user, _nowrite) \
-	__event_align = max_t(size_t, __event_align, lttng_alignof(_type));
+#undef _ctf_sequence_bitfield
+#define _ctf_sequence_bitfield(_type, _item, _src,		\
+			_length_type, _src_length,		\
+			_user, _nowrite)			\
+	&& 0
 
-#undef _ctf_array_bitfield
-#define _ctf_array_bitfield(_type, _item, _src, _length, _user, _nowrite) \
-	_ctf_array_encoded(_type, _item, _src, _length, none, _user, _nowrite)
+#undef _ctf_string
+#define _ctf_string(_item, _src, _user, _nowrite)			       \
+	&& 0
+
+#undef ctf_custom_field
+#define ctf_custom_field(_type, _item, _code)				\
+	&& 0
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_static_size__##_name = 1 _fields };
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_static_size__##_name = 1 _fields };
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+/*
+ * Stage 4.2.1 of tracepoint event generation.
+ *
+ * Count the dynamic lengths of the event: one per sequence and string
+ * field, two per delta-encoded integer. The probe keeps them on its
+ * stack, between the size computation and the write of the payload.
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <probes/lttng-events-reset.h>
+#include <probes/lttng-events-write.h>
 
 #undef _ctf_sequence_encoded
 #define _ctf_sequence_encoded(_type, _item, _src, _length_type,			\
 			_src_length, _encoding, _byte_order, _base, _user, _nowrite) \
-	__event_align = max_t(size_t, __event_align, lttng_alignof(_length_type)); \
-	__event_align = max_t(size_t, __event_align, lttng_alignof(_type));
+	+ 1
 
 #undef _ctf_sequence_bitfield
 #define _ctf_sequence_bitfield(_type, _item, _src,		\
 			_length_type, _src_length,		\
 			_user, _nowrite)			\
-	_ctf_sequence_encoded(_type, _item, _src, _length_type, _src_length, \
-		none, __LITTLE_ENDIAN, 10, _user, _nowrite)
+	+ 1
 
 #undef _ctf_string
-#define _ctf_string(_item, _src, _user, _nowrite)
+#define _ctf_string(_item, _src, _user, _nowrite)			       \
+	+ 1
 
-#undef _ctf_enum
-#define _ctf_enum(_name, _type, _item, _src, _user, _nowrite)	\
-	_ctf_integer_ext(_type, _item, _src, __BYTE_ORDER, 10, _user, _nowrite)
+#undef _ctf_integer_delta
+#define _ctf_integer_delta(_type, _item, _src, _base)			       \
+	+ 2
 
-#undef ctf_align
-#define ctf_align(_type)						\
-	__event_align = max_t(size_t, __event_align, lttng_alignof(_type));
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_nr_dynamic_len__##_name = 0 _fields };
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_nr_dynamic_len__##_name = 0 _fields };
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+/*
+ * Stage 4.3 of tracepoint event generation.
+ *
+ * Create the flow key function of events declaring a ctf_flow_key():
+ * a hash identifying the flow of the hit and its size in bytes, used
+ * by flow sampling and by maps keyed by flow. It is not recorded.
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <probes/lttng-events-reset.h>
+
+#undef ctf_flow_key
+#define ctf_flow_key(_hash, _bytes)					\
+	__lttng_probe_ctx->flow_hash = (_hash);				\
+	__lttng_probe_ctx->flow_bytes = (_bytes);
 
 #undef TP_PROTO
 #define TP_PROTO(...)	__VA_ARGS__
@@ -828,233 +1083,492 @@ void __event_prepare_filter_stack__##_name(char *__stack_data,		      \
 #undef TP_FIELDS
 #define TP_FIELDS(...)	__VA_ARGS__
 
-#undef TP_locvar
-#define TP_locvar(...)	__VA_ARGS__
-
-#undef ctf_custom_field
-#define ctf_custom_field(_type, _item, _code)		_code
-
-#undef ctf_custom_code
-#define ctf_custom_code(...)						\
-	{								\
-		__VA_ARGS__						\
-	}
-
 #undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
 #define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
-static inline size_t __event_get_align__##_name(void *__tp_locvar, _proto)    \
+static inline								      \
+void __event_get_flow_key__##_name(struct lttng_probe_ctx *__lttng_probe_ctx, \
+		_proto)							      \
 {									      \
-	size_t __event_align = 1;					      \
-	struct { _locvar } *tp_locvar __attribute__((unused)) = __tp_locvar;  \
-									      \
 	_fields								      \
-	return __event_align;						      \
 }
 
-#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS
-#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
-static inline size_t __event_get_align__##_name(void *__tp_locvar)	      \
-{									      \
-	size_t __event_align = 1;					      \
-	struct { _locvar } *tp_locvar __attribute__((unused)) = __tp_locvar;  \
-									      \
-	_fields								      \
-	return __event_align;						      \
-}
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+#include <probes/lttng-events-reset.h>
+
+#undef ctf_flow_key
+#define ctf_flow_key(_hash, _bytes)	|| 1
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_has_flow_key__##_name = 0 _fields };
 
 #include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
 
 /*
- * Stage 6 of tracepoint event generation.
+ * Stage 4.4 of tracepoint event generation.
  *
- * Create the probe function. This function calls event size calculation
- * and writes event data into the buffer.
+ * Create the summary key function of events declaring a
+ * ctf_summary_key(): the key and subkey its hits are counted by with
+ * the SUMMARY action, and the ctf_summary_value() added up per key. It
+ * is not recorded.
  */
 
 /* Reset all macros within TRACEPOINT_EVENT */
 #include <probes/lttng-events-reset.h>
-#include <probes/lttng-events-write.h>
 
-#undef _ctf_integer_ext_fetched
-#define _ctf_integer_ext_fetched(_type, _item, _src, _byte_order, _base, _nowrite) \
-	{								\
-		_type __tmp = _src;					\
-		lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(__tmp));\
-		__chan->ops->event_write(&__ctx, &__tmp, sizeof(__tmp));\
-	}
+#undef ctf_summary_key
+#define ctf_summary_key(_key, _subkey)					\
+	__lttng_probe_ctx->summary_key = (_key);			\
+	__lttng_probe_ctx->summary_subkey = (_subkey);
 
-#undef _ctf_integer_ext_isuser0
-#define _ctf_integer_ext_isuser0(_type, _item, _src, _byte_order, _base, _nowrite) \
-	_ctf_integer_ext_fetched(_type, _item, _src, _byte_order, _base, _nowrite)
+#undef ctf_summary_value
+#define ctf_summary_value(_value)					\
+	__lttng_probe_ctx->summary_value = (_value);
 
-#undef _ctf_integer_ext_isuser1
-#define _ctf_integer_ext_isuser1(_type, _item, _user_src, _byte_order, _base, _nowrite) \
-{									       \
-	union {										\
-		char __array[sizeof(_user_src)];					\
-		__typeof__(_user_src) __v;						\
-	} __tmp_fetch;									\
-	if (lib_ring_buffer_copy_from_user_check_nofault(__tmp_fetch.__array,		\
-				&(_user_src), sizeof(_user_src))) 			\
-		memset(__tmp_fetch.__array, 0, sizeof(__tmp_fetch.__array));		\
-	_ctf_integer_ext_fetched(_type, _item, __tmp_fetch.__v, _byte_order, _base, _nowrite) \
+#undef TP_PROTO
+#define TP_PROTO(...)	__VA_ARGS__
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+static inline								      \
+void __event_get_summary_key__##_name(struct lttng_probe_ctx *__lttng_probe_ctx, \
+		_proto)							      \
+{									      \
+	_fields								      \
 }
 
-#undef _ctf_integer_ext
-#define _ctf_integer_ext(_type, _item, _user_src, _byte_order, _base, _user, _nowrite) \
-	_ctf_integer_ext_isuser##_user(_type, _item, _user_src, _byte_order, _base, _nowrite)
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
 
-#undef _ctf_array_encoded
-#define _ctf_array_encoded(_type, _item, _src, _length, _encoding, _user, _nowrite) \
-	lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(_type));	\
-	if (_user) {							\
-		__chan->ops->event_write_from_user(&__ctx, _src, sizeof(_type) * (_length)); \
-	} else {							\
-		__chan->ops->event_write(&__ctx, _src, sizeof(_type) * (_length)); \
-	}
+/*
+ * Stage 4.5 of tracepoint event generation.
+ *
+ * Create the allocation site function of events declaring a
+ * ctf_alloc_site() or ctf_free_site(): the call site of the hit and the
+ * bytes it allocates, used by maps keyed by call site. It is not
+ * recorded.
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <probes/lttng-events-reset.h>
+
+#undef ctf_alloc_site
+#define ctf_alloc_site(_site, _bytes_req, _bytes_alloc)			\
+	__lttng_probe_ctx->alloc_site = (_site);			\
+	__lttng_probe_ctx->alloc_bytes_req = (_bytes_req);		\
+	__lttng_probe_ctx->alloc_bytes = (_bytes_alloc);		\
+	__lttng_probe_ctx->alloc_op = LTTNG_ALLOC_OP_ALLOC;
+
+#undef ctf_free_site
+#define ctf_free_site(_site)						\
+	__lttng_probe_ctx->alloc_site = (_site);			\
+	__lttng_probe_ctx->alloc_op = LTTNG_ALLOC_OP_FREE;
+
+#undef TP_PROTO
+#define TP_PROTO(...)	__VA_ARGS__
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+static inline								      \
+void __event_get_alloc_site__##_name(struct lttng_probe_ctx *__lttng_probe_ctx, \
+		_proto)							      \
+{									      \
+	_fields								      \
+}
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+#include <probes/lttng-events-reset.h>
+
+#undef ctf_alloc_site
+#define ctf_alloc_site(_site, _bytes_req, _bytes_alloc)	|| 1
+
+#undef ctf_free_site
+#define ctf_free_site(_site)	|| 1
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_has_alloc_site__##_name = 0 _fields };
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+/*
+ * Stage 4.6 of tracepoint event generation.
+ *
+ * Create the duration function of events declaring a ctf_duration():
+ * the duration measured by the hit in ns and the key it is measured
+ * for, used by maps of duration histograms. It is not recorded.
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <probes/lttng-events-reset.h>
+
+#undef ctf_duration
+#define ctf_duration(_key, _ns)						\
+	__lttng_probe_ctx->duration_key = (_key);			\
+	__lttng_probe_ctx->duration = (_ns);
+
+#undef TP_PROTO
+#define TP_PROTO(...)	__VA_ARGS__
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+static inline								      \
+void __event_get_duration__##_name(struct lttng_probe_ctx *__lttng_probe_ctx, \
+		_proto)							      \
+{									      \
+	_fields								      \
+}
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+#include <probes/lttng-events-reset.h>
+
+#undef ctf_duration
+#define ctf_duration(_key, _ns)	|| 1
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_has_duration__##_name = 0 _fields };
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+/*
+ * Stage 4.7 of tracepoint event generation.
+ *
+ * Create a compile-time flag telling whether the event can be recorded by
+ * the table-driven serializer, from its field descriptions and its filter
+ * stack data: integers, enumerations, strings, arrays and sequences. The
+ * probes built with TP_TABLE_DRIVEN record such events with
+ * lttng_event_serialize().
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <probes/lttng-events-reset.h>
+#include <probes/lttng-events-write.h>
 
-#if (__BYTE_ORDER == __LITTLE_ENDIAN)
 #undef _ctf_array_bitfield
 #define _ctf_array_bitfield(_type, _item, _src, _length, _user, _nowrite) \
-	lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(_type));	\
-	if (_user) {							\
-		__chan->ops->event_write_from_user(&__ctx, _src, sizeof(_type) * (_length)); \
-	} else {							\
-		__chan->ops->event_write(&__ctx, _src, sizeof(_type) * (_length)); \
-	}
-#else /* #if (__BYTE_ORDER == __LITTLE_ENDIAN) */
+	&& 0
+
+#undef _ctf_sequence_bitfield
+#define _ctf_sequence_bitfield(_type, _item, _src,		\
+			_length_type, _src_length,		\
+			_user, _nowrite)			\
+	&& 0
+
+#undef _ctf_array_text_dict
+#define _ctf_array_text_dict(_item, _src, _length)			\
+	&& 0
+
+#undef _ctf_string_dict
+#define _ctf_string_dict(_item, _src)					\
+	&& 0
+
+#undef _ctf_integer_delta
+#define _ctf_integer_delta(_type, _item, _src, _base)			\
+	&& 0
+
+#undef _ctf_sequence_skb
+#define _ctf_sequence_skb(_item, _skb, _length)				\
+	&& 0
+
+#undef ctf_align
+#define ctf_align(_type)						\
+	&& 0
+
+#undef ctf_custom_field
+#define ctf_custom_field(_type, _item, _code)				\
+	&& 0
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_table_driven__##_name = 1 _fields };
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_table_driven__##_name = 1 _fields };
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+/*
+ * Stage 4.8 of tracepoint event generation.
+ *
+ * Create the aggregation function of events declaring a ctf_agg_key()
+ * or ctf_agg_value(): the key and the value their hits are aggregated
+ * by in maps keyed by LTTNG_KERNEL_MAP_KEY_AGG, which count, sum or
+ * histogram the values. It is not recorded.
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <probes/lttng-events-reset.h>
+
+#undef ctf_agg_key
+#define ctf_agg_key(_key)						\
+	__lttng_probe_ctx->agg_key = (_key);
+
+#undef ctf_agg_value
+#define ctf_agg_value(_value)						\
+	__lttng_probe_ctx->agg_value = (_value);
+
+#undef TP_PROTO
+#define TP_PROTO(...)	__VA_ARGS__
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+static inline								      \
+void __event_get_agg__##_name(struct lttng_probe_ctx *__lttng_probe_ctx,      \
+		_proto)							      \
+{									      \
+	_fields								      \
+}
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+#include <probes/lttng-events-reset.h>
+
+#undef ctf_agg_key
+#define ctf_agg_key(_key)	|| 1
+
+#undef ctf_agg_value
+#define ctf_agg_value(_value)	|| 1
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+enum { __event_has_agg__##_name = 0 _fields };
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
 /*
- * For big endian, we need to byteswap into little endian.
+ * Stage 5 of the trace events.
+ *
+ * Create static inline function that calculates event payload alignment.
  */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <probes/lttng-events-reset.h>
+#include <probes/lttng-events-write.h>
+
+#undef _ctf_integer_ext
+#define _ctf_integer_ext(_type, _item, _src, _byte_order, _base, _user, _nowrite) \
+	__event_align = max_t(size_t, __event_align, lttng_alignof(_type));
+
+#undef _ctf_array_encoded
+#define _ctf_array_encoded(_type, _item, _src, _length, _encoding, _user, _nowrite) \
+	__event_align = max_t(size_t, __event_align, lttng_alignof(_type));
+
 #undef _ctf_array_bitfield
 #define _ctf_array_bitfield(_type, _item, _src, _length, _user, _nowrite) \
-	lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(_type));	\
-	{								\
-		size_t _i;						\
-									\
-		for (_i = 0; _i < (_length); _i++) {			\
-			_type _tmp;					\
-									\
-			if (_user) {					\
-				if (get_user(_tmp, (_type *) _src + _i)) \
-					_tmp = 0;			\
-			} else {					\
-				_tmp = ((_type *) _src)[_i];		\
-			}						\
-			switch (sizeof(_type)) {			\
-			case 1:						\
-				break;					\
-			case 2:						\
-				_tmp = cpu_to_le16(_tmp);		\
-				break;					\
-			case 4:						\
-				_tmp = cpu_to_le32(_tmp);		\
-				break;					\
-			case 8:						\
-				_tmp = cpu_to_le64(_tmp);		\
-				break;					\
-			default:					\
-				BUG_ON(1);				\
-			}						\
-			__chan->ops->event_write(&__ctx, &_tmp, sizeof(_type)); \
-		}							\
-	}
-#endif /* #else #if (__BYTE_ORDER == __LITTLE_ENDIAN) */
+	_ctf_array_encoded(_type, _item, _src, _length, none, _user, _nowrite)
 
 #undef _ctf_sequence_encoded
-#define _ctf_sequence_encoded(_type, _item, _src, _length_type,		\
+#define _ctf_sequence_encoded(_type, _item, _src, _length_type,			\
 			_src_length, _encoding, _byte_order, _base, _user, _nowrite) \
+	__event_align = max_t(size_t, __event_align, lttng_alignof(_length_type)); \
+	__event_align = max_t(size_t, __event_align, lttng_alignof(_type));
+
+#undef _ctf_sequence_bitfield
+#define _ctf_sequence_bitfield(_type, _item, _src,		\
+			_length_type, _src_length,		\
+			_user, _nowrite)			\
+	_ctf_sequence_encoded(_type, _item, _src, _length_type, _src_length, \
+		none, __LITTLE_ENDIAN, 10, _user, _nowrite)
+
+#undef _ctf_string
+#define _ctf_string(_item, _src, _user, _nowrite)
+
+#undef _ctf_enum
+#define _ctf_enum(_name, _type, _item, _src, _user, _nowrite)	\
+	_ctf_integer_ext(_type, _item, _src, __BYTE_ORDER, 10, _user, _nowrite)
+
+#undef ctf_align
+#define ctf_align(_type)						\
+	__event_align = max_t(size_t, __event_align, lttng_alignof(_type));
+
+#undef _ctf_array_text_dict
+#define _ctf_array_text_dict(_item, _src, _length)			\
+	if (__event->string_dict) {					\
+		__event_align = max_t(size_t, __event_align, lttng_alignof(uint64_t)); \
+	} else {							\
+		_ctf_array_encoded(char, _item, _src, _length, UTF8, 0, 0) \
+	}
+
+#undef _ctf_string_dict
+#define _ctf_string_dict(_item, _src)					\
+	if (__event->string_dict) {					\
+		__event_align = max_t(size_t, __event_align, lttng_alignof(uint64_t)); \
+	}
+
+#undef TP_PROTO
+#define TP_PROTO(...)	__VA_ARGS__
+
+#undef TP_FIELDS
+#define TP_FIELDS(...)	__VA_ARGS__
+
+#undef TP_locvar
+#define TP_locvar(...)	__VA_ARGS__
+
+#undef ctf_custom_field
+#define ctf_custom_field(_type, _item, _code)		_code
+
+#undef ctf_custom_code
+#define ctf_custom_code(...)						\
 	{								\
-		_length_type __tmpl = this_cpu_ptr(&lttng_dynamic_len_stack)->stack[__dynamic_len_idx]; \
-		lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(_length_type));\
-		__chan->ops->event_write(&__ctx, &__tmpl, sizeof(_length_type));\
-	}								\
+		__VA_ARGS__						\
+	}
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+static inline size_t __event_get_align__##_name(struct lttng_event *__event, \
+		void *__tp_locvar, _proto)				      \
+{									      \
+	size_t __event_align = 1;					      \
+	struct { _locvar } *tp_locvar __attribute__((unused)) = __tp_locvar;  \
+									      \
+	_fields								      \
+	return __event_align;						      \
+}
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
+static inline size_t __event_get_align__##_name(struct lttng_event *__event, \
+		void *__tp_locvar)					      \
+{									      \
+	size_t __event_align = 1;					      \
+	struct { _locvar } *tp_locvar __attribute__((unused)) = __tp_locvar;  \
+									      \
+	_fields								      \
+	return __event_align;						      \
+}
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+/*
+ * Stage 6 of tracepoint event generation.
+ *
+ * Create the probe function. This function calls event size calculation
+ * and writes event data into the buffer.
+ */
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <probes/lttng-events-reset.h>
+#include <probes/lttng-events-write.h>
+
+#undef _ctf_integer_ext_fetched
+#define _ctf_integer_ext_fetched(_type, _item, _src, _byte_order, _base, _nowrite) \
+	{								\
+		_type __tmp = _src;					\
+		lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(__tmp));\
+		lttng_probe_event_write(__chan, &__ctx, &__tmp, sizeof(__tmp));\
+	}
+
+#undef _ctf_integer_ext_isuser0
+#define _ctf_integer_ext_isuser0(_type, _item, _src, _byte_order, _base, _nowrite) \
+	_ctf_integer_ext_fetched(_type, _item, _src, _byte_order, _base, _nowrite)
+
+#undef _ctf_integer_ext_isuser1
+#define _ctf_integer_ext_isuser1(_type, _item, _user_src, _byte_order, _base, _nowrite) \
+{									       \
+	union {										\
+		char __array[sizeof(_user_src)];					\
+		__typeof__(_user_src) __v;						\
+	} __tmp_fetch;									\
+	lttng_probe_uaccess_end(&__uaccess);						\
+	if (lib_ring_buffer_copy_from_user_check_nofault(__tmp_fetch.__array,		\
+				&(_user_src), sizeof(_user_src))) 			\
+		memset(__tmp_fetch.__array, 0, sizeof(__tmp_fetch.__array));		\
+	_ctf_integer_ext_fetched(_type, _item, __tmp_fetch.__v, _byte_order, _base, _nowrite) \
+}
+
+#undef _ctf_integer_ext
+#define _ctf_integer_ext(_type, _item, _user_src, _byte_order, _base, _user, _nowrite) \
+	_ctf_integer_ext_isuser##_user(_type, _item, _user_src, _byte_order, _base, _nowrite)
+
+#undef _ctf_array_encoded
+#define _ctf_array_encoded(_type, _item, _src, _length, _encoding, _user, _nowrite) \
 	lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(_type));	\
 	if (_user) {							\
-		__chan->ops->event_write_from_user(&__ctx, _src,	\
-			sizeof(_type) * __get_dynamic_len(dest));	\
+		lttng_probe_event_write_from_user_uaccess(__chan, &__uaccess, \
+			&__ctx, _src, sizeof(_type) * (_length));	\
 	} else {							\
-		__chan->ops->event_write(&__ctx, _src,			\
-			sizeof(_type) * __get_dynamic_len(dest));	\
+		lttng_probe_event_write(__chan, &__ctx, _src, sizeof(_type) * (_length)); \
 	}
 
-#if (__BYTE_ORDER == __LITTLE_ENDIAN)
-#undef _ctf_sequence_bitfield
-#define _ctf_sequence_bitfield(_type, _item, _src,		\
-			_length_type, _src_length,		\
-			_user, _nowrite)			\
+#undef _ctf_array_bitfield
+#define _ctf_array_bitfield(_type, _item, _src, _length, _user, _nowrite) \
+	lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(_type));	\
+	lttng_probe_event_write_bitfield(__chan, &__uaccess, &__ctx,	\
+		_src, sizeof(_type), _length, _user);
+
+#undef _ctf_sequence_encoded
+#define _ctf_sequence_encoded(_type, _item, _src, _length_type,		\
+			_src_length, _encoding, _byte_order, _base, _user, _nowrite) \
 	{								\
-		_length_type __tmpl = this_cpu_ptr(&lttng_dynamic_len_stack)->stack[__dynamic_len_idx] * sizeof(_type) * CHAR_BIT; \
+		_length_type __tmpl = __stackvar.__dynamic_len[__dynamic_len_idx]; \
 		lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(_length_type));\
-		__chan->ops->event_write(&__ctx, &__tmpl, sizeof(_length_type));\
+		lttng_probe_event_write(__chan, &__ctx, &__tmpl, sizeof(_length_type));\
 	}								\
 	lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(_type));	\
 	if (_user) {							\
-		__chan->ops->event_write_from_user(&__ctx, _src,	\
-			sizeof(_type) * __get_dynamic_len(dest));	\
+		lttng_probe_event_write_from_user_uaccess(__chan, &__uaccess, \
+			&__ctx, _src, sizeof(_type) * __get_dynamic_len(dest)); \
 	} else {							\
-		__chan->ops->event_write(&__ctx, _src,			\
+		lttng_probe_event_write(__chan, &__ctx, _src,		\
 			sizeof(_type) * __get_dynamic_len(dest));	\
 	}
-#else /* #if (__BYTE_ORDER == __LITTLE_ENDIAN) */
-/*
- * For big endian, we need to byteswap into little endian.
- */
+
 #undef _ctf_sequence_bitfield
 #define _ctf_sequence_bitfield(_type, _item, _src,		\
 			_length_type, _src_length,		\
 			_user, _nowrite)			\
-	{							\
-		_length_type __tmpl = this_cpu_ptr(&lttng_dynamic_len_stack)->stack[__dynamic_len_idx] * sizeof(_type) * CHAR_BIT; \
+	{								\
+		_length_type __tmpl = __stackvar.__dynamic_len[__dynamic_len_idx] * sizeof(_type) * CHAR_BIT; \
 		lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(_length_type));\
-		__chan->ops->event_write(&__ctx, &__tmpl, sizeof(_length_type));\
+		lttng_probe_event_write(__chan, &__ctx, &__tmpl, sizeof(_length_type));\
 	}								\
 	lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(_type));	\
-	{								\
-		size_t _i, _length;					\
-									\
-		_length = __get_dynamic_len(dest);			\
-		for (_i = 0; _i < _length; _i++) {			\
-			_type _tmp;					\
-									\
-			if (_user) {					\
-				if (get_user(_tmp, (_type *) _src + _i)) \
-					_tmp = 0;			\
-			} else {					\
-				_tmp = ((_type *) _src)[_i];		\
-			}						\
-			switch (sizeof(_type)) {			\
-			case 1:						\
-				break;					\
-			case 2:						\
-				_tmp = cpu_to_le16(_tmp);		\
-				break;					\
-			case 4:						\
-				_tmp = cpu_to_le32(_tmp);		\
-				break;					\
-			case 8:						\
-				_tmp = cpu_to_le64(_tmp);		\
-				break;					\
-			default:					\
-				BUG_ON(1);				\
-			}						\
-			__chan->ops->event_write(&__ctx, &_tmp, sizeof(_type)); \
-		}							\
-	}
-#endif /* #else #if (__BYTE_ORDER == __LITTLE_ENDIAN) */
+	lttng_probe_event_write_bitfield(__chan, &__uaccess, &__ctx,	\
+		_src, sizeof(_type), __get_dynamic_len(dest), _user);
 
 #undef _ctf_string
 #define _ctf_string(_item, _src, _user, _nowrite)		        \
 	if (_user) {							\
 		lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(*(_src))); \
-		__chan->ops->event_strcpy_from_user(&__ctx, _src,	\
-			__get_dynamic_len(dest));			\
+		lttng_probe_event_strcpy_from_user_uaccess(__chan, &__uaccess, \
+			&__ctx, _src, __get_dynamic_len(dest));		\
 	} else {							\
 		const char *__ctf_tmp_string =				\
 			((_src) ? (_src) : __LTTNG_NULL_STRING);	\
 		lib_ring_buffer_align_ctx(&__ctx,			\
 			lttng_alignof(*__ctf_tmp_string));		\
-		__chan->ops->event_strcpy(&__ctx, __ctf_tmp_string,	\
+		lttng_probe_event_strcpy(__chan, &__ctx, __ctf_tmp_string, \
 			__get_dynamic_len(dest));			\
 	}
 
@@ -1066,18 +1580,89 @@ static inline size_t __event_get_align__##_name(void *__tp_locvar)	      \
 #define ctf_align(_type)						\
 	lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(_type));
 
+#undef _ctf_array_text_dict
+#define _ctf_array_text_dict(_item, _src, _length)			\
+	if (__event->string_dict) {					\
+		uint64_t __tmp = lttng_string_dict_id((_src),		\
+			strnlen((_src), _length));			\
+		lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(__tmp));\
+		lttng_probe_event_write(__chan, &__ctx, &__tmp, sizeof(__tmp));\
+	} else {							\
+		_ctf_array_encoded(char, _item, _src, _length, UTF8, 0, 0) \
+	}
+
+#undef _ctf_string_dict
+#define _ctf_string_dict(_item, _src)					\
+	if (__event->string_dict) {					\
+		const char *__ctf_tmp_string =				\
+			((_src) ? (_src) : __LTTNG_NULL_STRING);	\
+		uint64_t __tmp = lttng_string_dict_id(__ctf_tmp_string,	\
+			strlen(__ctf_tmp_string));			\
+		lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(__tmp));\
+		lttng_probe_event_write(__chan, &__ctx, &__tmp, sizeof(__tmp));\
+	} else {							\
+		_ctf_string(_item, _src, 0, 0)				\
+	}
+
+#undef _ctf_integer_delta
+#define _ctf_integer_delta(_type, _item, _src, _base)			\
+	if (__event->delta_state) {					\
+		uint8_t __tag = __stackvar.__dynamic_len[__dynamic_len_idx]; \
+		size_t __delta = __stackvar.__dynamic_len[__dynamic_len_idx + 1]; \
+									\
+		__dynamic_len_idx += 2;					\
+		lttng_probe_event_write(__chan, &__ctx, &__tag, sizeof(__tag)); \
+		switch (__tag) {					\
+		case LTTNG_DELTA_8:					\
+		{							\
+			int8_t __tmp = (int8_t) __delta;		\
+			lttng_probe_event_write(__chan, &__ctx, &__tmp, sizeof(__tmp)); \
+			break;						\
+		}							\
+		case LTTNG_DELTA_16:					\
+		{							\
+			int16_t __tmp = (int16_t) __delta;		\
+			lttng_probe_event_write(__chan, &__ctx, &__tmp, sizeof(__tmp)); \
+			break;						\
+		}							\
+		case LTTNG_DELTA_32:					\
+		{							\
+			int32_t __tmp = (int32_t) __delta;		\
+			lttng_probe_event_write(__chan, &__ctx, &__tmp, sizeof(__tmp)); \
+			break;						\
+		}							\
+		default:						\
+			_ctf_integer_ext(_type, _item, _src, __BYTE_ORDER, _base, 0, 0) \
+		}							\
+	} else {							\
+		_ctf_integer_ext(_type, _item, _src, __BYTE_ORDER, _base, 0, 0) \
+	}
+
+#undef _ctf_sequence_skb
+#define _ctf_sequence_skb(_item, _skb, _length)				\
+	{								\
+		uint16_t __tmpl = __stackvar.__dynamic_len[__dynamic_len_idx]; \
+		lib_ring_buffer_align_ctx(&__ctx, lttng_alignof(uint16_t));\
+		lttng_probe_event_write(__chan, &__ctx, &__tmpl, sizeof(__tmpl));\
+		lttng_probe_event_write_skb(__chan, &__ctx, _skb,	\
+			__get_dynamic_len(dest));			\
+	}
+
 #undef ctf_custom_field
-#define ctf_custom_field(_type, _item, _code)		_code
+#define ctf_custom_field(_type, _item, _code)			\
+	lttng_probe_uaccess_end(&__uaccess);				\
+	_code
 
 #undef ctf_custom_code
 #define ctf_custom_code(...)						\
 	{								\
+		lttng_probe_uaccess_end(&__uaccess);			\
 		__VA_ARGS__						\
 	}
 
 /* Beware: this get len actually consumes the len value */
 #undef __get_dynamic_len
-#define __get_dynamic_len(field)	this_cpu_ptr(&lttng_dynamic_len_stack)->stack[__dynamic_len_idx++]
+#define __get_dynamic_len(field)	__stackvar.__dynamic_len[__dynamic_len_idx++]
 
 #undef TP_PROTO
 #define TP_PROTO(...)	__VA_ARGS__
@@ -1108,6 +1693,81 @@ static inline size_t __event_get_align__##_name(void *__tp_locvar)	      \
 #define _TP_SESSION_CHECK(session, csession)	1
 #endif /* TP_SESSION_CHECK */
 
+/*
+ * Probe modules defining TP_TABLE_DRIVEN record the events eligible to
+ * the table-driven serializer through lttng_event_serialize(), rather than
+ * with size, alignment and write code generated for each event.
+ */
+#ifdef TP_TABLE_DRIVEN
+#define _TP_TABLE_DRIVEN(_name)	__event_table_driven__##_name
+#else /* TP_TABLE_DRIVEN */
+#define _TP_TABLE_DRIVEN(_name)	0
+#endif /* TP_TABLE_DRIVEN */
+
+/*
+ * Evaluate the filters of the event, setting __filter_record to 1 to
+ * record it, to 0 to discard it. Probes first run the filters early, on
+ * the raw arguments before _code_pre and the local variables, when they
+ * only read fields not computed from the local variables: a filter which
+ * is not early then leaves __filter_record to -1 if undecided, and the
+ * filters run again after _code_pre.
+ */
+#undef _TP_PROBE_FILTER
+#define _TP_PROBE_FILTER(_name, _prepare_args, _early)			      \
+{									      \
+	struct lttng_bytecode_runtime *bc_runtime;			      \
+	int __filter_prepared = 0;					      \
+									      \
+	__filter_record = __event->has_enablers_without_bytecode;	      \
+	bc_runtime = lttng_rcu_dereference(__event->filter_fused);	      \
+	if (bc_runtime) {						      \
+		if ((_early) && !bc_runtime->early) {			      \
+			if (!__filter_record)				      \
+				__filter_record = -1;			      \
+		} else {						      \
+			__event_prepare_filter_stack__##_name(__stackvar.__filter_stack_data, \
+					bc_runtime->field_mask, _prepare_args); \
+			if (bc_runtime->filter(bc_runtime, &__lttng_probe_ctx, \
+					__stackvar.__filter_stack_data) & LTTNG_FILTER_RECORD_FLAG) \
+				__filter_record = 1;			      \
+		}							      \
+	} else {							      \
+		lttng_list_for_each_entry_rcu(bc_runtime, &__event->bytecode_runtime_head, node) { \
+			const struct lttng_filter_prefilter *__prefilter =    \
+				ACCESS_ONCE(bc_runtime->prefilter);	      \
+									      \
+			if ((_early) && !bc_runtime->early) {		      \
+				if (!__filter_record)			      \
+					__filter_record = -1;		      \
+				break;					      \
+			}						      \
+			if (__prefilter) {				      \
+				int __prefilter_ret;			      \
+									      \
+				if (!__filter_prepared)			      \
+					__event_prepare_filter_stack__##_name(__stackvar.__filter_stack_data, \
+						&__prefilter->field_mask, _prepare_args); \
+				__prefilter_ret = lttng_filter_prefilter_match(__prefilter, \
+						__stackvar.__filter_stack_data); \
+				if (likely(__prefilter_ret == LTTNG_FILTER_PREFILTER_REJECT)) \
+					continue;			      \
+				if (__prefilter_ret == LTTNG_FILTER_PREFILTER_ACCEPT) { \
+					__filter_record = 1;		      \
+					continue;			      \
+				}					      \
+			}						      \
+			if (!__filter_prepared) {			      \
+				__event_prepare_filter_stack__##_name(__stackvar.__filter_stack_data, \
+						bc_runtime->field_mask, _prepare_args); \
+				__filter_prepared = !bc_runtime->field_mask;  \
+			}						      \
+			if (unlikely(bc_runtime->filter(bc_runtime, &__lttng_probe_ctx, \
+					__stackvar.__filter_stack_data) & LTTNG_FILTER_RECORD_FLAG)) \
+				__filter_record = 1;			      \
+		}							      \
+	}								      \
+}
+
 /*
  * Using twice size for filter stack data to hold size and pointer for
  * each field (worse case). For integers, max size required is 64-bit.
@@ -1123,69 +1783,153 @@ static void __event_probe__##_name(void *__data, _proto)		      \
 	struct lttng_event *__event = __data;				      \
 	struct lttng_probe_ctx __lttng_probe_ctx = {				      \
 		.event = __event,				              \
-		.interruptible = !irqs_disabled(),			      \
 	};								      \
-	struct lttng_channel *__chan = __event->chan;			      \
-	struct lttng_session *__session = __chan->session;		      \
+	struct lttng_channel *__chan;					      \
+	struct lttng_session *__session;				      \
 	struct lib_ring_buffer_ctx __ctx;				      \
 	ssize_t __event_len;						      \
 	size_t __event_align;						      \
-	size_t __orig_dynamic_len_offset, __dynamic_len_idx __attribute__((unused)); \
+	size_t __dynamic_len_idx __attribute__((unused)) = 0;		      \
 	union {								      \
-		size_t __dynamic_len_removed[ARRAY_SIZE(__event_fields___##_name)];   \
+		/* The filter is done with its data once sizes are computed. */ \
+		size_t __dynamic_len[__event_nr_dynamic_len__##_name];	      \
 		char __filter_stack_data[2 * sizeof(unsigned long) * ARRAY_SIZE(__event_fields___##_name)]; \
 	} __stackvar;							      \
+	/* Dynamic lengths of a record with delta fields, with full values. */ \
+	size_t __delta_full_dynamic_len[__event_nr_dynamic_len__##_name];    \
 	int __ret;							      \
 	struct probe_local_vars __tp_locvar;				      \
 	struct probe_local_vars *tp_locvar __attribute__((unused)) =	      \
 			&__tp_locvar;					      \
 	struct lttng_pid_tracker *__lpf;				      \
+	struct lttng_event_sampling *__sampling;			      \
+	int __filter_record, __filter_done;				      \
 									      \
+	if (unlikely(!ACCESS_ONCE(__event->effective_enabled)))		      \
+		return;							      \
+	__chan = __event->chan;						      \
+	__session = __chan->session;					      \
 	if (!_TP_SESSION_CHECK(session, __session))			      \
 		return;							      \
-	if (unlikely(!ACCESS_ONCE(__session->active)))			      \
+	if (unlikely(__session->cpu_mask) &&				      \
+			!cpumask_test_cpu(smp_processor_id(),		      \
+				__session->cpu_mask))			      \
 		return;							      \
-	if (unlikely(!ACCESS_ONCE(__chan->enabled)))			      \
+	lttng_event_stats_inc(__event, hit);				      \
+	__lpf = lttng_rcu_dereference(__session->pid_tracker);		      \
+	if (__lpf && likely(!lttng_pid_tracker_lookup_current(__lpf))) {     \
+		lttng_event_stats_inc(__event, pid_rejected);		      \
 		return;							      \
-	if (unlikely(!ACCESS_ONCE(__event->enabled)))			      \
+	}								      \
+	__lpf = lttng_rcu_dereference(__session->pid_ns_tracker);	      \
+	if (__lpf && likely(!lttng_pid_tracker_lookup(__lpf,		      \
+			lttng_current_pid_ns_inum()))) {		      \
+		lttng_event_stats_inc(__event, pid_rejected);		      \
 		return;							      \
-	__lpf = lttng_rcu_dereference(__session->pid_tracker);		      \
-	if (__lpf && likely(!lttng_pid_tracker_lookup(__lpf, current->pid)))  \
+	}								      \
+	__sampling = ACCESS_ONCE(__event->sampling);			      \
+	if (__event_has_flow_key__##_name) {				      \
+		__event_get_flow_key__##_name(&__lttng_probe_ctx, _args);    \
+		if (unlikely(__sampling) && !lttng_event_flow_sample(__sampling, \
+				__lttng_probe_ctx.flow_hash)) {		      \
+			lttng_event_stats_inc(__event, sampled_out);	      \
+			return;						      \
+		}							      \
+	}								      \
+	if (unlikely(__sampling) && !lttng_event_sample(__sampling)) {	      \
+		lttng_event_stats_inc(__event, sampled_out);		      \
 		return;							      \
-	__orig_dynamic_len_offset = this_cpu_ptr(&lttng_dynamic_len_stack)->offset; \
-	__dynamic_len_idx = __orig_dynamic_len_offset;			      \
+	}								      \
+	if (__event_has_alloc_site__##_name)				      \
+		__event_get_alloc_site__##_name(&__lttng_probe_ctx, _args);  \
+	if (__event_has_duration__##_name)				      \
+		__event_get_duration__##_name(&__lttng_probe_ctx, _args);    \
+	if (__event_has_agg__##_name)					      \
+		__event_get_agg__##_name(&__lttng_probe_ctx, _args);	      \
+	__filter_done = 0;						      \
+	if (unlikely(ACCESS_ONCE(__event->filter_early))		      \
+			&& !list_empty(&__event->bytecode_runtime_head)) {    \
+		_TP_PROBE_FILTER(_name, PARAMS(tp_locvar, _args), 1)	      \
+		if (likely(!__filter_record)) {				      \
+			lttng_event_stats_inc(__event, filtered);	      \
+			return;						      \
+		}							      \
+		__filter_done = __filter_record > 0;			      \
+	}								      \
 	_code_pre							      \
-	if (unlikely(!list_empty(&__event->bytecode_runtime_head))) {	      \
-		struct lttng_bytecode_runtime *bc_runtime;		      \
-		int __filter_record = __event->has_enablers_without_bytecode; \
+	if (unlikely(!__filter_done					      \
+			&& !list_empty(&__event->bytecode_runtime_head))) {   \
+		_TP_PROBE_FILTER(_name, PARAMS(tp_locvar, _args), 0)	      \
+		if (likely(!__filter_record)) {				      \
+			lttng_event_stats_inc(__event, filtered);	      \
+			goto __post;					      \
+		}							      \
+	}								      \
+	if (unlikely(ACCESS_ONCE(__event->action))) {			      \
+		if (ACCESS_ONCE(__event->action) == LTTNG_KERNEL_EVENT_ACTION_SUMMARY) \
+			__event_get_summary_key__##_name(&__lttng_probe_ctx, _args); \
+		if (!lttng_event_action(__event, &__lttng_probe_ctx))	      \
+			goto __post;					      \
+	}								      \
+	if (_TP_TABLE_DRIVEN(_name)) {					      \
+		size_t __table_dynamic_len[__event_nr_dynamic_len__##_name];  \
 									      \
 		__event_prepare_filter_stack__##_name(__stackvar.__filter_stack_data, \
-				tp_locvar, _args);				      \
-		lttng_list_for_each_entry_rcu(bc_runtime, &__event->bytecode_runtime_head, node) { \
-			if (unlikely(bc_runtime->filter(bc_runtime, &__lttng_probe_ctx,	      \
-					__stackvar.__filter_stack_data) & LTTNG_FILTER_RECORD_FLAG)) \
-				__filter_record = 1;			      \
+				NULL, PARAMS(tp_locvar, _args));	      \
+		lttng_event_serialize(__event, &__lttng_probe_ctx,	      \
+				__stackvar.__filter_stack_data,		      \
+				__table_dynamic_len);			      \
+		goto __post;						      \
+	}								      \
+	__event_len = __event_get_size__##_name(__stackvar.__dynamic_len,     \
+			__event, tp_locvar, _args);			      \
+	if (unlikely(__event->delta_state) && __event_len >= 0		      \
+			&& lttng_delta_based(__event, __stackvar.__dynamic_len, \
+				&__lttng_probe_ctx.delta_packet)) {	      \
+		ssize_t __full_len;					      \
+									      \
+		__full_len = __event_get_size__##_name(__delta_full_dynamic_len, \
+				__event, tp_locvar, _args);		      \
+		if (__full_len > __event_len) {				      \
+			__lttng_probe_ctx.delta_len = __event_len;	      \
+			__lttng_probe_ctx.delta_full_len = __full_len;	      \
+		} else if (__full_len < 0) {				      \
+			__event_len = __full_len;			      \
 		}							      \
-		if (likely(!__filter_record))				      \
-			goto __post;					      \
 	}								      \
-	__event_len = __event_get_size__##_name(tp_locvar, _args);	      \
 	if (unlikely(__event_len < 0)) {				      \
 		lib_ring_buffer_lost_event_too_big(__chan->chan);	      \
-		goto __post;						      \
+		lttng_event_stats_reserve_failed(__event, -ENOSPC);	      \
+		goto __delta_abort;					      \
 	}								      \
-	__event_align = __event_get_align__##_name(tp_locvar, _args);         \
+	__event_align = __event_get_align__##_name(__event, tp_locvar, _args);         \
 	lib_ring_buffer_ctx_init(&__ctx, __chan->chan, &__lttng_probe_ctx, __event_len,  \
 				 __event_align, -1);			      \
-	__ret = __chan->ops->event_reserve(&__ctx, __event->id);	      \
-	if (__ret < 0)							      \
-		goto __post;						      \
-	_fields								      \
-	__chan->ops->event_commit(&__ctx);				      \
+	__ret = __chan->ops->event_reserve_preempt_off(&__ctx, __event->id); \
+	if (__ret < 0) {						      \
+		lttng_event_stats_reserve_failed(__event, __ret);	      \
+		goto __delta_abort;					      \
+	}								      \
+	/* Recorded in another packet than its bases: write full values. */ \
+	if (unlikely(__lttng_probe_ctx.delta_full_len)			      \
+			&& __ctx.data_size == __lttng_probe_ctx.delta_full_len) \
+		memcpy(__stackvar.__dynamic_len, __delta_full_dynamic_len,    \
+			sizeof(__delta_full_dynamic_len));		      \
+	{								      \
+		struct lttng_probe_uaccess __uaccess = { .open = 0 };	      \
+									      \
+		_fields							      \
+		lttng_probe_uaccess_end(&__uaccess);			      \
+	}								      \
+	if (unlikely(__event->delta_state))				      \
+		lttng_delta_end(__event, __stackvar.__dynamic_len, &__ctx);  \
+	__chan->ops->event_commit_preempt_off(&__ctx);			      \
+	goto __post;							      \
+__delta_abort:								      \
+	if (unlikely(__event->delta_state))				      \
+		lttng_delta_abort(__event, __stackvar.__dynamic_len);	      \
 __post:									      \
 	_code_post							      \
-	barrier();	/* use before un-reserve. */			      \
-	this_cpu_ptr(&lttng_dynamic_len_stack)->offset = __orig_dynamic_len_offset; \
 	return;								      \
 }
 
@@ -1197,69 +1941,136 @@ static void __event_probe__##_name(void *__data)			      \
 	struct lttng_event *__event = __data;				      \
 	struct lttng_probe_ctx __lttng_probe_ctx = {				      \
 		.event = __event,				              \
-		.interruptible = !irqs_disabled(),			      \
 	};								      \
-	struct lttng_channel *__chan = __event->chan;			      \
-	struct lttng_session *__session = __chan->session;		      \
+	struct lttng_channel *__chan;					      \
+	struct lttng_session *__session;				      \
 	struct lib_ring_buffer_ctx __ctx;				      \
 	ssize_t __event_len;						      \
 	size_t __event_align;						      \
-	size_t __orig_dynamic_len_offset, __dynamic_len_idx __attribute__((unused)); \
+	size_t __dynamic_len_idx __attribute__((unused)) = 0;		      \
 	union {								      \
-		size_t __dynamic_len_removed[ARRAY_SIZE(__event_fields___##_name)];   \
+		/* The filter is done with its data once sizes are computed. */ \
+		size_t __dynamic_len[__event_nr_dynamic_len__##_name];	      \
 		char __filter_stack_data[2 * sizeof(unsigned long) * ARRAY_SIZE(__event_fields___##_name)]; \
 	} __stackvar;							      \
+	/* Dynamic lengths of a record with delta fields, with full values. */ \
+	size_t __delta_full_dynamic_len[__event_nr_dynamic_len__##_name];    \
 	int __ret;							      \
 	struct probe_local_vars __tp_locvar;				      \
 	struct probe_local_vars *tp_locvar __attribute__((unused)) =	      \
 			&__tp_locvar;					      \
 	struct lttng_pid_tracker *__lpf;				      \
+	struct lttng_event_sampling *__sampling;			      \
+	int __filter_record, __filter_done;				      \
 									      \
+	if (unlikely(!ACCESS_ONCE(__event->effective_enabled)))		      \
+		return;							      \
+	__chan = __event->chan;						      \
+	__session = __chan->session;					      \
 	if (!_TP_SESSION_CHECK(session, __session))			      \
 		return;							      \
-	if (unlikely(!ACCESS_ONCE(__session->active)))			      \
+	if (unlikely(__session->cpu_mask) &&				      \
+			!cpumask_test_cpu(smp_processor_id(),		      \
+				__session->cpu_mask))			      \
 		return;							      \
-	if (unlikely(!ACCESS_ONCE(__chan->enabled)))			      \
+	lttng_event_stats_inc(__event, hit);				      \
+	__lpf = lttng_rcu_dereference(__session->pid_tracker);		      \
+	if (__lpf && likely(!lttng_pid_tracker_lookup_current(__lpf))) {     \
+		lttng_event_stats_inc(__event, pid_rejected);		      \
 		return;							      \
-	if (unlikely(!ACCESS_ONCE(__event->enabled)))			      \
+	}								      \
+	__lpf = lttng_rcu_dereference(__session->pid_ns_tracker);	      \
+	if (__lpf && likely(!lttng_pid_tracker_lookup(__lpf,		      \
+			lttng_current_pid_ns_inum()))) {		      \
+		lttng_event_stats_inc(__event, pid_rejected);		      \
 		return;							      \
-	__lpf = lttng_rcu_dereference(__session->pid_tracker);		      \
-	if (__lpf && likely(!lttng_pid_tracker_lookup(__lpf, current->pid)))  \
+	}								      \
+	__sampling = ACCESS_ONCE(__event->sampling);			      \
+	if (unlikely(__sampling) && !lttng_event_sample(__sampling)) {	      \
+		lttng_event_stats_inc(__event, sampled_out);		      \
 		return;							      \
-	__orig_dynamic_len_offset = this_cpu_ptr(&lttng_dynamic_len_stack)->offset; \
-	__dynamic_len_idx = __orig_dynamic_len_offset;			      \
+	}								      \
+	__filter_done = 0;						      \
+	if (unlikely(ACCESS_ONCE(__event->filter_early))		      \
+			&& !list_empty(&__event->bytecode_runtime_head)) {    \
+		_TP_PROBE_FILTER(_name, tp_locvar, 1)			      \
+		if (likely(!__filter_record)) {				      \
+			lttng_event_stats_inc(__event, filtered);	      \
+			return;						      \
+		}							      \
+		__filter_done = __filter_record > 0;			      \
+	}								      \
 	_code_pre							      \
-	if (unlikely(!list_empty(&__event->bytecode_runtime_head))) {	      \
-		struct lttng_bytecode_runtime *bc_runtime;		      \
-		int __filter_record = __event->has_enablers_without_bytecode; \
+	if (unlikely(!__filter_done					      \
+			&& !list_empty(&__event->bytecode_runtime_head))) {   \
+		_TP_PROBE_FILTER(_name, tp_locvar, 0)			      \
+		if (likely(!__filter_record)) {				      \
+			lttng_event_stats_inc(__event, filtered);	      \
+			goto __post;					      \
+		}							      \
+	}								      \
+	if (unlikely(ACCESS_ONCE(__event->action))			      \
+			&& !lttng_event_action(__event, &__lttng_probe_ctx))  \
+		goto __post;						      \
+	if (_TP_TABLE_DRIVEN(_name)) {					      \
+		size_t __table_dynamic_len[__event_nr_dynamic_len__##_name];  \
 									      \
 		__event_prepare_filter_stack__##_name(__stackvar.__filter_stack_data, \
-				tp_locvar);				      \
-		lttng_list_for_each_entry_rcu(bc_runtime, &__event->bytecode_runtime_head, node) { \
-			if (unlikely(bc_runtime->filter(bc_runtime, &__lttng_probe_ctx,	\
-					__stackvar.__filter_stack_data) & LTTNG_FILTER_RECORD_FLAG)) \
-				__filter_record = 1;			      \
+				NULL, tp_locvar);			      \
+		lttng_event_serialize(__event, &__lttng_probe_ctx,	      \
+				__stackvar.__filter_stack_data,		      \
+				__table_dynamic_len);			      \
+		goto __post;						      \
+	}								      \
+	__event_len = __event_get_size__##_name(__stackvar.__dynamic_len,     \
+			__event, tp_locvar);				      \
+	if (unlikely(__event->delta_state) && __event_len >= 0		      \
+			&& lttng_delta_based(__event, __stackvar.__dynamic_len, \
+				&__lttng_probe_ctx.delta_packet)) {	      \
+		ssize_t __full_len;					      \
+									      \
+		__full_len = __event_get_size__##_name(__delta_full_dynamic_len, \
+				__event, tp_locvar);			      \
+		if (__full_len > __event_len) {				      \
+			__lttng_probe_ctx.delta_len = __event_len;	      \
+			__lttng_probe_ctx.delta_full_len = __full_len;	      \
+		} else if (__full_len < 0) {				      \
+			__event_len = __full_len;			      \
 		}							      \
-		if (likely(!__filter_record))				      \
-			goto __post;					      \
 	}								      \
-	__event_len = __event_get_size__##_name(tp_locvar);		      \
 	if (unlikely(__event_len < 0)) {				      \
 		lib_ring_buffer_lost_event_too_big(__chan->chan);	      \
-		goto __post;						      \
+		lttng_event_stats_reserve_failed(__event, -ENOSPC);	      \
+		goto __delta_abort;					      \
 	}								      \
-	__event_align = __event_get_align__##_name(tp_locvar);		      \
+	__event_align = __event_get_align__##_name(__event, tp_locvar);		      \
 	lib_ring_buffer_ctx_init(&__ctx, __chan->chan, &__lttng_probe_ctx, __event_len,  \
 				 __event_align, -1);			      \
-	__ret = __chan->ops->event_reserve(&__ctx, __event->id);	      \
-	if (__ret < 0)							      \
-		goto __post;						      \
-	_fields								      \
-	__chan->ops->event_commit(&__ctx);				      \
+	__ret = __chan->ops->event_reserve_preempt_off(&__ctx, __event->id); \
+	if (__ret < 0) {						      \
+		lttng_event_stats_reserve_failed(__event, __ret);	      \
+		goto __delta_abort;					      \
+	}								      \
+	/* Recorded in another packet than its bases: write full values. */ \
+	if (unlikely(__lttng_probe_ctx.delta_full_len)			      \
+			&& __ctx.data_size == __lttng_probe_ctx.delta_full_len) \
+		memcpy(__stackvar.__dynamic_len, __delta_full_dynamic_len,    \
+			sizeof(__delta_full_dynamic_len));		      \
+	{								      \
+		struct lttng_probe_uaccess __uaccess = { .open = 0 };	      \
+									      \
+		_fields							      \
+		lttng_probe_uaccess_end(&__uaccess);			      \
+	}								      \
+	if (unlikely(__event->delta_state))				      \
+		lttng_delta_end(__event, __stackvar.__dynamic_len, &__ctx);  \
+	__chan->ops->event_commit_preempt_off(&__ctx);			      \
+	goto __post;							      \
+__delta_abort:								      \
+	if (unlikely(__event->delta_state))				      \
+		lttng_delta_abort(__event, __stackvar.__dynamic_len);	      \
 __post:									      \
 	_code_post							      \
-	barrier();	/* use before un-reserve. */			      \
-	this_cpu_ptr(&lttng_dynamic_len_stack)->offset = __orig_dynamic_len_offset; \
 	return;								      \
 }
 
@@ -1267,6 +2078,54 @@ __post:									      \
 
 #undef __get_dynamic_len
 
+/*
+ * Stage 6.1 of tracepoint event generation.
+ *
+ * Create the fanout function. Tracepoints are registered once with it,
+ * whatever the number of events enabled for them in all sessions, and
+ * it calls the probe function of each event. Not created when the probe
+ * callback is overridden.
+ */
+
+#ifndef TP_PROBE_CB
+
+/* Reset all macros within TRACEPOINT_EVENT */
+#include <probes/lttng-events-reset.h>
+
+#undef TP_PROTO
+#define TP_PROTO(...)	__VA_ARGS__
+
+#undef TP_ARGS
+#define TP_ARGS(...)	__VA_ARGS__
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE(_name, _proto, _args, _locvar, _code_pre, _fields, _code_post) \
+static void __event_fanout__##_name(void *__data, _proto)		      \
+{									      \
+	struct lttng_event_fanout *__fanout = __data;			      \
+	struct lttng_event *__event;					      \
+									      \
+	lttng_list_for_each_entry_rcu(__event, &__fanout->events_head,	      \
+			fanout_node)					      \
+		__event_probe__##_name(__event, _args);			      \
+}
+
+#undef LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS
+#define LTTNG_TRACEPOINT_EVENT_CLASS_CODE_NOARGS(_name, _locvar, _code_pre, _fields, _code_post) \
+static void __event_fanout__##_name(void *__data)			      \
+{									      \
+	struct lttng_event_fanout *__fanout = __data;			      \
+	struct lttng_event *__event;					      \
+									      \
+	lttng_list_for_each_entry_rcu(__event, &__fanout->events_head,	      \
+			fanout_node)					      \
+		__event_probe__##_name(__event);			      \
+}
+
+#include TRACE_INCLUDE(TRACE_INCLUDE_FILE)
+
+#endif /* TP_PROBE_CB */
+
 /*
  * Stage 7 of the trace events.
  *
@@ -1279,15 +2138,23 @@ __post:									      \
 
 #ifndef TP_PROBE_CB
 #define TP_PROBE_CB(_template)	&__event_probe__##_template
+#define TP_FANOUT_CB(_template)	&__event_fanout__##_template
+#endif
+
+#ifndef TP_FANOUT_CB
+#define TP_FANOUT_CB(_template)	NULL
 #endif
 
 #undef LTTNG_TRACEPOINT_EVENT_INSTANCE_MAP_NOARGS
 #define LTTNG_TRACEPOINT_EVENT_INSTANCE_MAP_NOARGS(_template, _name, _map)	\
 static const struct lttng_event_desc __event_desc___##_map = {		\
 	.fields = __event_fields___##_template,		     		\
+	.field_srcs = __event_has_locvar__##_template ?			\
+		__event_field_srcs___##_template : NULL,		\
 	.name = #_map,					     		\
 	.kname = #_name,				     		\
 	.probe_callback = (void *) TP_PROBE_CB(_template),   		\
+	.fanout_callback = (void *) TP_FANOUT_CB(_template),		\
 	.nr_fields = ARRAY_SIZE(__event_fields___##_template),		\
 	.owner = THIS_MODULE,				     		\
 };
@@ -0,0 +1,232 @@
+/*
+ * probes/lttng-uprobes.c
+ *
+ * LTTng uprobes integration module. Each event instruments an
+ * instruction of a user-space binary, identified by a file descriptor
+ * and a file offset, in every process mapping it.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/module.h>
+#include <linux/uprobes.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/ptrace.h>
+#include <lttng-events.h>
+#include <wrapper/ringbuffer/frontend_types.h>
+#include <wrapper/vmalloc.h>
+#include <lttng-tracer.h>
+
+struct lttng_uprobe {
+	struct uprobe_consumer consumer;
+	struct lttng_event *event;
+	struct inode *inode;
+	loff_t offset;
+	unsigned int armed:1;
+};
+
+/*
+ * Called in the context of the task hitting the breakpoint, before the
+ * probed instruction is executed.
+ */
+static
+int lttng_uprobes_handler_pre(struct uprobe_consumer *uc, struct pt_regs *regs)
+{
+	struct lttng_uprobe *uprobe =
+		container_of(uc, struct lttng_uprobe, consumer);
+	struct lttng_event *event = uprobe->event;
+	struct lttng_probe_ctx lttng_probe_ctx = {
+		.event = event,
+		.regs = regs,
+	};
+	struct lttng_channel *chan = event->chan;
+	struct lib_ring_buffer_ctx ctx;
+	unsigned long data = (unsigned long) instruction_pointer(regs);
+	uint64_t filter_stack_data[1] = { data };
+	int ret;
+
+	if (unlikely(!ACCESS_ONCE(event->effective_enabled)))
+		return 0;
+	/* The probes expect to run with preemption disabled. */
+	preempt_disable_notrace();
+	if (!lttng_event_probe_check(event, &lttng_probe_ctx,
+			(const char *) filter_stack_data))
+		goto end;
+
+	lib_ring_buffer_ctx_init(&ctx, chan->chan, &lttng_probe_ctx,
+				 sizeof(data), lttng_alignof(data), -1);
+	ret = chan->ops->event_reserve(&ctx, event->id);
+	if (ret < 0) {
+		lttng_event_stats_reserve_failed(event, ret);
+		goto end;
+	}
+	lib_ring_buffer_align_ctx(&ctx, lttng_alignof(data));
+	chan->ops->event_write(&ctx, &data, sizeof(data));
+	chan->ops->event_commit(&ctx);
+end:
+	preempt_enable_notrace();
+	return 0;
+}
+
+/*
+ * Create event description
+ */
+static
+int lttng_create_uprobe_event(const char *name, struct lttng_event *event)
+{
+	struct lttng_event_field *field;
+	struct lttng_event_desc *desc;
+	int ret;
+
+	desc = kzalloc(sizeof(*event->desc), GFP_KERNEL);
+	if (!desc)
+		return -ENOMEM;
+	desc->name = kstrdup(name, GFP_KERNEL);
+	if (!desc->name) {
+		ret = -ENOMEM;
+		goto error_str;
+	}
+	desc->nr_fields = 1;
+	desc->fields = field =
+		kzalloc(1 * sizeof(struct lttng_event_field), GFP_KERNEL);
+	if (!field) {
+		ret = -ENOMEM;
+		goto error_field;
+	}
+	field->name = "ip";
+	field->type.atype = atype_integer;
+	field->type.u.basic.integer.size = sizeof(unsigned long) * CHAR_BIT;
+	field->type.u.basic.integer.alignment = lttng_alignof(unsigned long) * CHAR_BIT;
+	field->type.u.basic.integer.signedness = lttng_is_signed_type(unsigned long);
+	field->type.u.basic.integer.reverse_byte_order = 0;
+	field->type.u.basic.integer.base = 16;
+	field->type.u.basic.integer.encoding = lttng_encode_none;
+	desc->owner = THIS_MODULE;
+	event->desc = desc;
+
+	return 0;
+
+error_field:
+	kfree(desc->name);
+error_str:
+	kfree(desc);
+	return ret;
+}
+
+int lttng_uprobes_register(const char *name, int fd, uint64_t offset,
+		struct lttng_event *event)
+{
+	struct lttng_uprobe *uprobe;
+	struct file *file;
+	int ret;
+
+	file = fget(fd);
+	if (!file)
+		return -EBADF;
+	if (!S_ISREG(file_inode(file)->i_mode)) {
+		ret = -EINVAL;
+		goto error_file;
+	}
+	uprobe = kzalloc(sizeof(*uprobe), GFP_KERNEL);
+	if (!uprobe) {
+		ret = -ENOMEM;
+		goto error_file;
+	}
+	uprobe->event = event;
+	uprobe->inode = igrab(file_inode(file));
+	if (!uprobe->inode) {
+		ret = -EINVAL;
+		goto error_inode;
+	}
+	uprobe->offset = offset;
+	uprobe->consumer.handler = lttng_uprobes_handler_pre;
+	ret = lttng_create_uprobe_event(name, event);
+	if (ret)
+		goto error_event;
+	event->u.uprobe.uprobe = uprobe;
+	/* The handler must not trigger page faults on our allocations. */
+	wrapper_vmalloc_sync_all();
+	fput(file);
+	return 0;
+
+error_event:
+	iput(uprobe->inode);
+error_inode:
+	kfree(uprobe);
+error_file:
+	fput(file);
+	return ret;
+}
+EXPORT_SYMBOL_GPL(lttng_uprobes_register);
+
+void lttng_uprobes_unregister(struct lttng_event *event)
+{
+	struct lttng_uprobe *uprobe = event->u.uprobe.uprobe;
+
+	if (uprobe->armed)
+		uprobe_unregister(uprobe->inode, uprobe->offset,
+				&uprobe->consumer);
+	uprobe->armed = 0;
+}
+EXPORT_SYMBOL_GPL(lttng_uprobes_unregister);
+
+/*
+ * Only keep the breakpoints inserted in the processes mapping the
+ * binary while the event can record. Unregistration waits for the
+ * handlers in flight. Should be called with sessions lock held, after
+ * any change of the event effective enable state.
+ */
+int lttng_uprobes_event_arm(struct lttng_event *event)
+{
+	struct lttng_uprobe *uprobe = event->u.uprobe.uprobe;
+	int ret = 0;
+
+	if (event->effective_enabled == uprobe->armed)
+		return 0;
+	if (event->effective_enabled)
+		ret = uprobe_register(uprobe->inode, uprobe->offset,
+				&uprobe->consumer);
+	else
+		uprobe_unregister(uprobe->inode, uprobe->offset,
+				&uprobe->consumer);
+	if (!ret)
+		uprobe->armed = event->effective_enabled;
+	return ret;
+}
+EXPORT_SYMBOL_GPL(lttng_uprobes_event_arm);
+
+void lttng_uprobes_destroy_private(struct lttng_event *event)
+{
+	struct lttng_uprobe *uprobe = event->u.uprobe.uprobe;
+
+	iput(uprobe->inode);
+	kfree(uprobe);
+	kfree(event->desc->fields);
+	kfree(event->desc->name);
+	kfree(event->desc);
+}
+EXPORT_SYMBOL_GPL(lttng_uprobes_destroy_private);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("Linux Trace Toolkit Uprobes Support");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,159 @@
+/*
+ * lttng-bitfield-bench.c
+ *
+ * LTTng bitfield array conversion benchmark.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Compares the conversion of a bitmap recorded with ctf_array_bitfield()
+ * to little endian, element by element, as the probes used to on big
+ * endian architectures, with its conversion a chunk at a time, as done
+ * by lttng_probe_event_write_bitfield(). Each element or chunk is
+ * copied to a record buffer, standing for a ring buffer write. On
+ * little endian architectures, both only copy.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/bitops.h>
+#include <linux/ktime.h>
+#include <linux/preempt.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/stringify.h>
+
+#include <probes/lttng-probe-write.h>
+
+static unsigned int nr_bits = 4096;
+module_param(nr_bits, uint, 0444);
+MODULE_PARM_DESC(nr_bits, "Number of bits of the bitmap, as a CPU mask");
+
+static unsigned int nr_loops = 100000;
+module_param(nr_loops, uint, 0444);
+MODULE_PARM_DESC(nr_loops, "Number of bitmaps converted per measurement");
+
+static
+void bench_per_element(char *dst, const unsigned long *src, size_t nr)
+{
+	size_t i;
+
+	for (i = 0; i < nr; i++) {
+		unsigned long tmp = src[i];
+
+		switch (sizeof(tmp)) {
+		case 4:
+			tmp = cpu_to_le32(tmp);
+			break;
+		case 8:
+			tmp = cpu_to_le64(tmp);
+			break;
+		}
+		memcpy(dst + i * sizeof(tmp), &tmp, sizeof(tmp));
+	}
+}
+
+static
+void bench_chunked(char *dst, const unsigned long *src, size_t nr)
+{
+	uint64_t bounce[LTTNG_PROBE_BITFIELD_CHUNK / sizeof(uint64_t)];
+	size_t offset, len = nr * sizeof(*src), chunk;
+
+	for (offset = 0; offset < len; offset += chunk) {
+		chunk = min_t(size_t, len - offset, sizeof(bounce));
+		memcpy(bounce, (const char *) src + offset, chunk);
+		lttng_probe_bitfield_to_le(bounce, sizeof(*src),
+				chunk / sizeof(*src));
+		memcpy(dst + offset, bounce, chunk);
+	}
+}
+
+static
+u64 bench_loops(void (*convert)(char *, const unsigned long *, size_t),
+		char *dst, const unsigned long *src, size_t nr)
+{
+	u64 start, end;
+	unsigned int i;
+
+	preempt_disable();
+	start = ktime_to_ns(ktime_get());
+	for (i = 0; i < nr_loops; i++) {
+		convert(dst, src, nr);
+		barrier();
+	}
+	end = ktime_to_ns(ktime_get());
+	preempt_enable();
+	return end - start;
+}
+
+static int __init lttng_bitfield_bench_init(void)
+{
+	size_t nr = BITS_TO_LONGS(nr_bits), i;
+	u64 elem_ns, chunk_ns;
+	unsigned long *src;
+	char *dst, *ref;
+	int ret = 0;
+
+	if (!nr_bits || !nr_loops)
+		return -EINVAL;
+	src = kcalloc(nr, sizeof(*src), GFP_KERNEL);
+	dst = kzalloc(nr * sizeof(*src), GFP_KERNEL);
+	ref = kzalloc(nr * sizeof(*src), GFP_KERNEL);
+	if (!src || !dst || !ref) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	for (i = 0; i < nr; i++)
+		src[i] = (unsigned long) 0x0123456789abcdefULL * (i + 1);
+	bench_per_element(ref, src, nr);
+	bench_chunked(dst, src, nr);
+	if (memcmp(ref, dst, nr * sizeof(*src))) {
+		printk(KERN_ERR "LTTng: bitfield benchmark: conversions differ\n");
+		ret = -EINVAL;
+		goto end;
+	}
+	elem_ns = bench_loops(bench_per_element, dst, src, nr);
+	chunk_ns = bench_loops(bench_chunked, dst, src, nr);
+	printk(KERN_INFO "LTTng: bitfield benchmark: %u bits, %u loops: "
+		"per element %llu ns, chunked %llu ns\n",
+		nr_bits, nr_loops,
+		(unsigned long long) elem_ns,
+		(unsigned long long) chunk_ns);
+end:
+	kfree(ref);
+	kfree(dst);
+	kfree(src);
+	return ret;
+}
+
+module_init(lttng_bitfield_bench_init);
+
+static void __exit lttng_bitfield_bench_exit(void)
+{
+}
+
+module_exit(lttng_bitfield_bench_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng bitfield array conversion benchmark");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,231 @@
+/*
+ * lttng-commit-counter-bench.c
+ *
+ * LTTng ring buffer commit counter layout benchmark.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * A writer thread commits into the counters of one sub-buffer, as the
+ * commit fast path does, while a reader thread pinned on another CPU
+ * reads the counters of the neighbouring sub-buffer, as delivery
+ * checks and get_subbuf do. The writer throughput is printed for the
+ * dense and the cache line commit counter layouts. No trace session is
+ * needed: the counters are allocated by the benchmark itself.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/stringify.h>
+
+#include <lttng-tracer.h>
+#include <wrapper/ringbuffer/config.h>
+#include <wrapper/ringbuffer/frontend_types.h>
+#include <wrapper/ringbuffer/vatomic.h>
+
+static unsigned int nr_commits = 10000000;
+module_param(nr_commits, uint, 0444);
+MODULE_PARM_DESC(nr_commits, "Number of commits of the writer thread");
+
+#define BENCH_NR_SUBBUF		4
+#define BENCH_BATCH		4096	/* Commits between rescheduling points */
+
+/* Commits are atomic across CPUs, as with RING_BUFFER_SYNC_GLOBAL. */
+static const struct lib_ring_buffer_config bench_dense_config = {
+	.alloc = RING_BUFFER_ALLOC_GLOBAL,
+	.sync = RING_BUFFER_SYNC_GLOBAL,
+	.commit_layout = RING_BUFFER_COMMIT_DENSE,
+};
+
+static const struct lib_ring_buffer_config bench_cacheline_config = {
+	.alloc = RING_BUFFER_ALLOC_GLOBAL,
+	.sync = RING_BUFFER_SYNC_GLOBAL,
+	.commit_layout = RING_BUFFER_COMMIT_CACHELINE,
+};
+
+struct bench_ctx {
+	const struct lib_ring_buffer_config *config;
+	struct lib_ring_buffer buf;
+	struct completion writer_done;
+	struct completion reader_done;
+	int stop;
+	u64 duration_ns;
+	unsigned long reads;
+	unsigned long sum;		/* Keeps the reads */
+};
+
+static
+void bench_wait_stop(void)
+{
+	/* Wait for kthread_stop(). */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+}
+
+static
+int bench_writer_fn(void *data)
+{
+	struct bench_ctx *ctx = data;
+	const struct lib_ring_buffer_config *config = ctx->config;
+	struct commit_counters_hot *cc_hot =
+		lib_ring_buffer_commit_hot(config, &ctx->buf, 0);
+	u64 start;
+	unsigned int i;
+
+	start = ktime_to_ns(ktime_get());
+	for (i = 0; i < nr_commits; i++) {
+		v_add(config, 1, &cc_hot->cc);
+		v_set(config, &cc_hot->seq, i);
+		if (!(i % BENCH_BATCH))
+			cond_resched();
+	}
+	ctx->duration_ns = ktime_to_ns(ktime_get()) - start;
+	ACCESS_ONCE(ctx->stop) = 1;
+	complete(&ctx->writer_done);
+	bench_wait_stop();
+	return 0;
+}
+
+static
+int bench_reader_fn(void *data)
+{
+	struct bench_ctx *ctx = data;
+	const struct lib_ring_buffer_config *config = ctx->config;
+	unsigned long reads = 0, sum = 0;
+	unsigned int idx;
+
+	while (!ACCESS_ONCE(ctx->stop)) {
+		for (idx = 1; idx < BENCH_NR_SUBBUF; idx++) {
+			sum += v_read(config,
+				&lib_ring_buffer_commit_hot(config, &ctx->buf,
+							    idx)->cc);
+			sum += v_read(config,
+				&lib_ring_buffer_commit_cold(config, &ctx->buf,
+							     idx)->cc_sb);
+		}
+		if (!(++reads % BENCH_BATCH))
+			cond_resched();
+	}
+	ctx->reads = reads;
+	ctx->sum = sum;
+	complete(&ctx->reader_done);
+	bench_wait_stop();
+	return 0;
+}
+
+static
+int bench_run(const struct lib_ring_buffer_config *config, const char *name,
+		int writer_cpu, int reader_cpu)
+{
+	struct task_struct *writer, *reader;
+	struct bench_ctx *ctx;
+	int ret = 0;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	if (!ctx)
+		return -ENOMEM;
+	ctx->config = config;
+	init_completion(&ctx->writer_done);
+	init_completion(&ctx->reader_done);
+	ctx->buf.commit_hot = kzalloc(BENCH_NR_SUBBUF
+		* lib_ring_buffer_commit_stride(config,
+			sizeof(struct commit_counters_hot)), GFP_KERNEL);
+	ctx->buf.commit_cold = kzalloc(BENCH_NR_SUBBUF
+		* lib_ring_buffer_commit_stride(config,
+			sizeof(struct commit_counters_cold)), GFP_KERNEL);
+	if (!ctx->buf.commit_hot || !ctx->buf.commit_cold) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	writer = kthread_create(bench_writer_fn, ctx, "lttng-cc-bench/w");
+	if (IS_ERR(writer)) {
+		ret = PTR_ERR(writer);
+		goto end;
+	}
+	reader = kthread_create(bench_reader_fn, ctx, "lttng-cc-bench/r");
+	if (IS_ERR(reader)) {
+		ret = PTR_ERR(reader);
+		kthread_stop(writer);
+		goto end;
+	}
+	kthread_bind(writer, writer_cpu);
+	kthread_bind(reader, reader_cpu);
+	wake_up_process(reader);
+	wake_up_process(writer);
+	wait_for_completion(&ctx->writer_done);
+	wait_for_completion(&ctx->reader_done);
+	kthread_stop(writer);
+	kthread_stop(reader);
+	printk(KERN_INFO "LTTng: commit counter benchmark: %s layout, "
+		"%u commits on CPU %d, reader on CPU %d: %llu commits/s, "
+		"%lu reader passes\n",
+		name, nr_commits, writer_cpu, reader_cpu,
+		(unsigned long long) div64_u64((u64) nr_commits * NSEC_PER_SEC,
+			max_t(u64, ctx->duration_ns, 1)),
+		ctx->reads);
+end:
+	kfree(ctx->buf.commit_cold);
+	kfree(ctx->buf.commit_hot);
+	kfree(ctx);
+	return ret;
+}
+
+static int __init lttng_commit_counter_bench_init(void)
+{
+	int writer_cpu, reader_cpu, ret;
+
+	if (!nr_commits)
+		return -EINVAL;
+	writer_cpu = cpumask_first(cpu_online_mask);
+	reader_cpu = cpumask_next(writer_cpu, cpu_online_mask);
+	if (reader_cpu >= nr_cpu_ids)
+		return -ENODEV;	/* Needs two CPUs to share cache lines. */
+	ret = bench_run(&bench_dense_config, "dense", writer_cpu, reader_cpu);
+	if (ret)
+		return ret;
+	return bench_run(&bench_cacheline_config, "cache line",
+			writer_cpu, reader_cpu);
+}
+
+module_init(lttng_commit_counter_bench_init);
+
+static void __exit lttng_commit_counter_bench_exit(void)
+{
+}
+
+module_exit(lttng_commit_counter_bench_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng ring buffer commit counter layout benchmark");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,246 @@
+/*
+ * lttng-control-bench.c
+ *
+ * LTTng control path scalability benchmark.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * For each size, from 1 channel with 1 enabler up to nr_channels
+ * channels with nr_enablers enablers each, a session is set up, started,
+ * resynchronized, has its metadata regenerated and is destroyed, timing
+ * each step. The enablers cycle through exact tracepoint names, star
+ * globbing patterns and system call names. The discard ring buffer
+ * client must be loaded, and the probe modules of the events to enable.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/stringify.h>
+
+#include <lttng-events.h>
+
+static unsigned int nr_channels = 8;
+module_param(nr_channels, uint, 0444);
+MODULE_PARM_DESC(nr_channels, "Largest number of channels per session");
+
+static unsigned int nr_enablers = 256;
+module_param(nr_enablers, uint, 0444);
+MODULE_PARM_DESC(nr_enablers, "Largest number of enablers per channel");
+
+static char *transport = "relay-discard";
+module_param(transport, charp, 0444);
+MODULE_PARM_DESC(transport, "Ring buffer client of the channels");
+
+static const char *bench_names[] = {
+	"sched_switch", "sched_wakeup", "sched_process_fork",
+	"irq_handler_entry", "softirq_entry", "timer_expire_entry",
+	"block_rq_issue", "kmem_kmalloc", "writeback_start",
+	"net_dev_queue",
+};
+
+static const char *bench_globs[] = {
+	"sched_*", "irq_*", "softirq_*", "timer_*", "block_*",
+	"kmem_*", "writeback_*", "net_*", "*", "lttng_*",
+};
+
+static const char *bench_syscalls[] = {
+	"read", "write", "openat", "close", "mmap", "futex",
+	"epoll_wait", "ioctl", "clone", "execve",
+};
+
+enum bench_step {
+	BENCH_STEP_CREATE,	/* Session, channels and enablers */
+	BENCH_STEP_START,	/* Sync, metadata and statedump */
+	BENCH_STEP_SYNC,	/* Full resynchronization */
+	BENCH_STEP_SYNC_ONE,	/* One enabler disabled then enabled */
+	BENCH_STEP_METADATA,	/* Metadata regeneration */
+	BENCH_STEP_DESTROY,	/* Stop and unregistration, freeing deferred */
+	NR_BENCH_STEPS,
+};
+
+static const char *bench_step_names[NR_BENCH_STEPS] = {
+	[BENCH_STEP_CREATE] = "create",
+	[BENCH_STEP_START] = "start",
+	[BENCH_STEP_SYNC] = "sync",
+	[BENCH_STEP_SYNC_ONE] = "sync_one",
+	[BENCH_STEP_METADATA] = "metadata",
+	[BENCH_STEP_DESTROY] = "destroy",
+};
+
+/* Returns the type of enabler of the event. */
+static
+enum lttng_enabler_type bench_event_param(struct lttng_kernel_event *ev,
+		unsigned int i)
+{
+	enum lttng_enabler_type type = LTTNG_ENABLER_NAME;
+	const char *name;
+
+	memset(ev, 0, sizeof(*ev));
+	switch (i % 3) {
+	case 0:
+		name = bench_names[(i / 3) % ARRAY_SIZE(bench_names)];
+		ev->instrumentation = LTTNG_KERNEL_TRACEPOINT;
+		break;
+	case 1:
+		name = bench_globs[(i / 3) % ARRAY_SIZE(bench_globs)];
+		ev->instrumentation = LTTNG_KERNEL_TRACEPOINT;
+		type = LTTNG_ENABLER_STAR_GLOB;
+		break;
+	default:
+		name = bench_syscalls[(i / 3) % ARRAY_SIZE(bench_syscalls)];
+		ev->instrumentation = LTTNG_KERNEL_SYSCALL;
+		break;
+	}
+	strncpy(ev->name, name, LTTNG_KERNEL_SYM_NAME_LEN);
+	ev->name[LTTNG_KERNEL_SYM_NAME_LEN - 1] = '\0';
+	return type;
+}
+
+static
+int bench_session_setup(struct lttng_session *session,
+		unsigned int nr_chan, unsigned int nr_enabler,
+		struct lttng_enabler **first)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < nr_chan; i++) {
+		struct lttng_channel *chan;
+
+		chan = lttng_channel_create(session, transport, NULL,
+				PAGE_SIZE, 2, 0, 0, PER_CPU_CHANNEL);
+		if (!chan)
+			return -ENOENT;
+		for (j = 0; j < nr_enabler; j++) {
+			struct lttng_kernel_event ev;
+			struct lttng_enabler *enabler;
+			enum lttng_enabler_type type;
+
+			type = bench_event_param(&ev, j);
+			enabler = lttng_enabler_create(type, &ev, chan);
+			if (!enabler)
+				return -ENOMEM;
+			lttng_enabler_enable(enabler);
+			if (!*first)
+				*first = enabler;
+		}
+	}
+	return 0;
+}
+
+static
+int bench_session(unsigned int nr_chan, unsigned int nr_enabler,
+		u64 *ns)
+{
+	struct lttng_session *session;
+	struct lttng_enabler *first = NULL;
+	u64 t[NR_BENCH_STEPS + 1];
+	enum bench_step step;
+	int ret;
+
+	t[BENCH_STEP_CREATE] = ktime_to_ns(ktime_get());
+	session = lttng_session_create();
+	if (!session)
+		return -ENOMEM;
+	ret = bench_session_setup(session, nr_chan, nr_enabler, &first);
+	if (ret)
+		goto end;
+	t[BENCH_STEP_START] = ktime_to_ns(ktime_get());
+	ret = lttng_session_enable(session);
+	if (ret)
+		goto end;
+	/* A batch holding any enabler change resynchronizes them all. */
+	t[BENCH_STEP_SYNC] = ktime_to_ns(ktime_get());
+	ret = lttng_session_batch_begin(session);
+	if (ret)
+		goto end;
+	lttng_enabler_disable(first);
+	lttng_enabler_enable(first);
+	ret = lttng_session_batch_commit(session);
+	if (ret)
+		goto end;
+	t[BENCH_STEP_SYNC_ONE] = ktime_to_ns(ktime_get());
+	lttng_enabler_disable(first);
+	lttng_enabler_enable(first);
+	t[BENCH_STEP_METADATA] = ktime_to_ns(ktime_get());
+	ret = lttng_session_metadata_regenerate(session);
+	if (ret)
+		goto end;
+	t[BENCH_STEP_DESTROY] = ktime_to_ns(ktime_get());
+	lttng_session_destroy(session);
+	t[NR_BENCH_STEPS] = ktime_to_ns(ktime_get());
+	session = NULL;
+	for (step = 0; step < NR_BENCH_STEPS; step++)
+		ns[step] = t[step + 1] - t[step];
+end:
+	if (session)
+		lttng_session_destroy(session);
+	return ret;
+}
+
+static int __init lttng_control_bench_init(void)
+{
+	unsigned int nr_chan, nr_enabler;
+	int ret;
+
+	if (!nr_channels || !nr_enablers)
+		return -EINVAL;
+	for (nr_chan = 1; nr_chan <= nr_channels; nr_chan *= 2) {
+		for (nr_enabler = 1; nr_enabler <= nr_enablers;
+				nr_enabler *= 4) {
+			u64 ns[NR_BENCH_STEPS];
+			enum bench_step step;
+
+			ret = bench_session(nr_chan, nr_enabler, ns);
+			if (ret) {
+				printk(KERN_WARNING "LTTng: control benchmark: "
+					"%u channels, %u enablers: error %d\n",
+					nr_chan, nr_enabler, ret);
+				return ret;
+			}
+			for (step = 0; step < NR_BENCH_STEPS; step++)
+				printk(KERN_INFO "LTTng: control benchmark: "
+					"%u channels, %u enablers per channel: "
+					"%s %llu ns\n",
+					nr_chan, nr_enabler,
+					bench_step_names[step],
+					(unsigned long long) ns[step]);
+		}
+	}
+	return 0;
+}
+
+module_init(lttng_control_bench_init);
+
+static void __exit lttng_control_bench_exit(void)
+{
+}
+
+module_exit(lttng_control_bench_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng control path scalability benchmark");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,187 @@
+/*
+ * lttng-event-hit-bench.c
+ *
+ * LTTng event fast path layout benchmark.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/preempt.h>
+#include <linux/slab.h>
+#include <linux/cache.h>
+#include <linux/stddef.h>
+#include <linux/stringify.h>
+
+#include <lttng-events.h>
+
+static unsigned int nr_events = 65536;
+module_param(nr_events, uint, 0444);
+MODULE_PARM_DESC(nr_events, "Number of events, sized to exceed the caches");
+
+static unsigned int nr_hits = 1000000;
+module_param(nr_hits, uint, 0444);
+MODULE_PARM_DESC(nr_hits, "Number of probe hits per measurement");
+
+static unsigned long bench_sink;
+
+#define EVENT_FIELD_LINE(field)	\
+	(offsetof(struct lttng_event, field) / L1_CACHE_BYTES)
+
+/*
+ * The lttng_event fields read by a probe before it reserves space, in
+ * the order of the prologue in probes/lttng-tracepoint-event-impl.h.
+ */
+static
+void bench_probe_hit(struct lttng_event *event)
+{
+	struct lttng_channel *chan;
+
+	if (unlikely(!ACCESS_ONCE(event->effective_enabled)))
+		return;
+	chan = event->chan;
+	if (unlikely(ACCESS_ONCE(event->sampling)))
+		return;
+	if (unlikely(!list_empty(&event->bytecode_runtime_head))
+			&& !event->has_enablers_without_bytecode)
+		return;
+	bench_sink += event->id + (unsigned long) event->ctx
+		+ (unsigned long) chan->session;
+}
+
+/*
+ * Hit events in a scattered order, as a traced workload hitting many
+ * different tracepoints would.
+ */
+static
+u64 bench_hits(struct lttng_event **events)
+{
+	u64 start, end;
+	unsigned int i;
+
+	preempt_disable();
+	start = ktime_to_ns(ktime_get());
+	for (i = 0; i < nr_hits; i++)
+		bench_probe_hit(events[(i * 40503U) % nr_events]);
+	end = ktime_to_ns(ktime_get());
+	preempt_enable();
+	return end - start;
+}
+
+static
+unsigned int event_hot_lines(void)
+{
+	unsigned long lines[] = {
+		EVENT_FIELD_LINE(chan),
+		EVENT_FIELD_LINE(effective_enabled),
+		EVENT_FIELD_LINE(sampling),
+		EVENT_FIELD_LINE(bytecode_runtime_head),
+		EVENT_FIELD_LINE(has_enablers_without_bytecode),
+		EVENT_FIELD_LINE(id),
+		EVENT_FIELD_LINE(ctx),
+	};
+	unsigned int i, j, nr = 0;
+
+	for (i = 0; i < ARRAY_SIZE(lines); i++) {
+		for (j = 0; j < i; j++) {
+			if (lines[j] == lines[i])
+				break;
+		}
+		if (j == i)
+			nr++;
+	}
+	return nr;
+}
+
+static int __init lttng_event_hit_bench_init(void)
+{
+	struct lttng_session *session;
+	struct lttng_channel *chan;
+	struct lttng_event **events;
+	struct kmem_cache *cache;
+	u64 cold_ns, warm_ns;
+	unsigned int i;
+	int ret = 0;
+
+	if (!nr_events || !nr_hits)
+		return -EINVAL;
+	session = kzalloc(sizeof(*session), GFP_KERNEL);
+	chan = kzalloc(sizeof(*chan), GFP_KERNEL);
+	events = kcalloc(nr_events, sizeof(*events), GFP_KERNEL);
+	/* Same allocation as the tracer event cache. */
+	cache = KMEM_CACHE(lttng_event, SLAB_HWCACHE_ALIGN);
+	if (!session || !chan || !events || !cache) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	session->active = 1;
+	chan->session = session;
+	chan->enabled = 1;
+	for (i = 0; i < nr_events; i++) {
+		events[i] = kmem_cache_zalloc(cache, GFP_KERNEL);
+		if (!events[i]) {
+			ret = -ENOMEM;
+			goto end;
+		}
+		events[i]->id = i;
+		events[i]->chan = chan;
+		events[i]->enabled = 1;
+		events[i]->effective_enabled = 1;
+		INIT_LIST_HEAD(&events[i]->bytecode_runtime_head);
+	}
+	cold_ns = bench_hits(events);
+	warm_ns = bench_hits(events);
+	printk(KERN_INFO "LTTng: event hit benchmark: struct lttng_event %zu bytes, "
+		"%u probe-read cache lines, %u events, %u hits: "
+		"first pass %llu ns, second pass %llu ns\n",
+		sizeof(struct lttng_event), event_hot_lines(),
+		nr_events, nr_hits,
+		(unsigned long long) cold_ns,
+		(unsigned long long) warm_ns);
+end:
+	if (events && cache) {
+		for (i = 0; i < nr_events; i++) {
+			if (events[i])
+				kmem_cache_free(cache, events[i]);
+		}
+	}
+	if (cache)
+		kmem_cache_destroy(cache);
+	kfree(events);
+	kfree(chan);
+	kfree(session);
+	return ret;
+}
+
+module_init(lttng_event_hit_bench_init);
+
+static void __exit lttng_event_hit_bench_exit(void)
+{
+}
+
+module_exit(lttng_event_hit_bench_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng event fast path layout benchmark");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,549 @@
+/*
+ * lttng-filter-bench.c
+ *
+ * LTTng filter bytecode benchmark. Runs a corpus of linked bytecodes
+ * through validation, specialization and each execution mode, on a
+ * synthetic event payload, on each online CPU.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/preempt.h>
+#include <linux/slab.h>
+#include <linux/cpu.h>
+#include <linux/workqueue.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+#include <linux/stringify.h>
+
+#include <lttng-events.h>
+#include <lttng-filter.h>
+
+static unsigned int nr_evals = 1000000;
+module_param(nr_evals, uint, 0444);
+MODULE_PARM_DESC(nr_evals, "Number of evaluations per measurement");
+
+#define BENCH_BYTECODE_LEN	512
+
+/*
+ * Filter stack data of the synthetic event, laid out as
+ * lttng_filter_field_index() expects.
+ */
+#define BENCH_FIELD_ID		0
+#define BENCH_FIELD_LEN		(BENCH_FIELD_ID + sizeof(int64_t))
+#define BENCH_FIELD_NAME	(BENCH_FIELD_LEN + sizeof(int64_t))
+#define BENCH_FIELD_PATH	(BENCH_FIELD_NAME + sizeof(void *))
+#define BENCH_STACK_DATA_LEN	(BENCH_FIELD_PATH + sizeof(void *))
+
+#define BENCH_ID		42
+#define BENCH_LEN		1500
+#define BENCH_NAME		"sched_switch"
+#define BENCH_PATH		"/tmp/trace/data"
+
+static const struct lttng_event_field bench_fields[] = {
+	{
+		.name = "id",
+		.type = __type_integer(int64_t, 0, 0, -1, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "len",
+		.type = __type_integer(int64_t, 0, 0, -1, __BYTE_ORDER, 10, none),
+	},
+	{
+		.name = "name",
+		.type = {
+			.atype = atype_string,
+			.u.basic.string.encoding = lttng_encode_UTF8,
+		},
+	},
+	{
+		.name = "path",
+		.type = {
+			.atype = atype_string,
+			.u.basic.string.encoding = lttng_encode_UTF8,
+		},
+		.user = 1,
+	},
+};
+
+static const struct lttng_event_desc bench_desc = {
+	.name = "lttng_filter_bench",
+	.fields = bench_fields,
+	.nr_fields = ARRAY_SIZE(bench_fields),
+	.owner = THIS_MODULE,
+};
+
+/* Bytecode as left by the relocations of the link. */
+struct bench_bytecode {
+	uint16_t len;
+	int overflow;
+	char data[BENCH_BYTECODE_LEN];
+};
+
+struct bench_case {
+	const char *name;
+	int (*build)(struct bench_bytecode *bc);
+	uint64_t expect;	/* Filter result on the synthetic event */
+};
+
+enum bench_mode {
+	BENCH_MODE_INTERPRETER,	/* Specialized bytecode */
+	BENCH_MODE_OPTIMIZED,	/* With superinstructions */
+	BENCH_MODE_JIT,		/* Native code */
+	NR_BENCH_MODES,
+};
+
+static const char *bench_mode_names[NR_BENCH_MODES] = {
+	[BENCH_MODE_INTERPRETER] = "interpreter",
+	[BENCH_MODE_OPTIMIZED] = "optimized",
+	[BENCH_MODE_JIT] = "jit",
+};
+
+struct bench_run {
+	struct bytecode_runtime *runtime;
+	const char *stack_data;
+	uint64_t result;
+	u64 ns;
+};
+
+static
+void emit(struct bench_bytecode *bc, const void *p, size_t len)
+{
+	if (bc->len + len > sizeof(bc->data)) {
+		bc->overflow = 1;
+		return;
+	}
+	memcpy(&bc->data[bc->len], p, len);
+	bc->len += len;
+}
+
+static
+void emit_op(struct bench_bytecode *bc, filter_opcode_t op)
+{
+	emit(bc, &op, sizeof(op));
+}
+
+static
+void emit_ref(struct bench_bytecode *bc, filter_opcode_t op, uint16_t offset)
+{
+	struct field_ref ref = { .offset = offset };
+
+	emit_op(bc, op);
+	emit(bc, &ref, sizeof(ref));
+}
+
+static
+void emit_s64(struct bench_bytecode *bc, int64_t v)
+{
+	struct literal_numeric lit = { .v = v };
+
+	emit_op(bc, FILTER_OP_LOAD_S64);
+	emit(bc, &lit, sizeof(lit));
+}
+
+static
+void emit_string(struct bench_bytecode *bc, filter_opcode_t op,
+		const char *str)
+{
+	emit_op(bc, op);
+	emit(bc, str, strlen(str) + 1);
+}
+
+/* "field <op> v" */
+static
+void emit_cmp_s64(struct bench_bytecode *bc, uint16_t offset,
+		filter_opcode_t op, int64_t v)
+{
+	emit_ref(bc, FILTER_OP_LOAD_FIELD_REF_S64, offset);
+	emit_s64(bc, v);
+	emit_op(bc, op);
+}
+
+/* Returns the offset of the logical op, to patch once its target is known. */
+static
+uint16_t emit_logical(struct bench_bytecode *bc, filter_opcode_t op)
+{
+	struct logical_op insn = { .op = op };
+	uint16_t at = bc->len;
+
+	emit(bc, &insn, sizeof(insn));
+	return at;
+}
+
+static
+void patch_logical(struct bench_bytecode *bc, uint16_t at)
+{
+	struct logical_op insn;
+
+	memcpy(&insn, &bc->data[at], sizeof(insn));
+	insn.skip_offset = bc->len;
+	memcpy(&bc->data[at], &insn, sizeof(insn));
+}
+
+static
+int build_int_eq(struct bench_bytecode *bc)
+{
+	emit_cmp_s64(bc, BENCH_FIELD_ID, FILTER_OP_EQ, BENCH_ID);
+	emit_op(bc, FILTER_OP_RETURN);
+	return 0;
+}
+
+static
+int build_int_range(struct bench_bytecode *bc)
+{
+	uint16_t and_pc;
+
+	emit_cmp_s64(bc, BENCH_FIELD_ID, FILTER_OP_GE, 10);
+	and_pc = emit_logical(bc, FILTER_OP_AND);
+	emit_cmp_s64(bc, BENCH_FIELD_ID, FILTER_OP_LT, 100);
+	patch_logical(bc, and_pc);
+	emit_op(bc, FILTER_OP_RETURN);
+	return 0;
+}
+
+static
+int build_string_eq(struct bench_bytecode *bc)
+{
+	emit_ref(bc, FILTER_OP_LOAD_FIELD_REF_STRING, BENCH_FIELD_NAME);
+	emit_string(bc, FILTER_OP_LOAD_STRING, BENCH_NAME);
+	emit_op(bc, FILTER_OP_EQ);
+	emit_op(bc, FILTER_OP_RETURN);
+	return 0;
+}
+
+static
+int build_glob_prefix(struct bench_bytecode *bc)
+{
+	emit_ref(bc, FILTER_OP_LOAD_FIELD_REF_STRING, BENCH_FIELD_NAME);
+	emit_string(bc, FILTER_OP_LOAD_STAR_GLOB_STRING, "sched_*");
+	emit_op(bc, FILTER_OP_EQ);
+	emit_op(bc, FILTER_OP_RETURN);
+	return 0;
+}
+
+static
+int build_glob_infix(struct bench_bytecode *bc)
+{
+	emit_ref(bc, FILTER_OP_LOAD_FIELD_REF_STRING, BENCH_FIELD_NAME);
+	emit_string(bc, FILTER_OP_LOAD_STAR_GLOB_STRING, "*_sw*ch");
+	emit_op(bc, FILTER_OP_EQ);
+	emit_op(bc, FILTER_OP_RETURN);
+	return 0;
+}
+
+static
+int build_user_string_eq(struct bench_bytecode *bc)
+{
+	emit_ref(bc, FILTER_OP_LOAD_FIELD_REF_USER_STRING, BENCH_FIELD_PATH);
+	emit_string(bc, FILTER_OP_LOAD_STRING, BENCH_PATH);
+	emit_op(bc, FILTER_OP_EQ);
+	emit_op(bc, FILTER_OP_RETURN);
+	return 0;
+}
+
+static
+int build_context_pid(struct bench_bytecode *bc)
+{
+	int idx;
+
+	idx = lttng_get_context_index(lttng_static_ctx, "pid");
+	if (idx < 0)
+		return idx;
+	emit_ref(bc, FILTER_OP_GET_CONTEXT_REF_S64, idx);
+	emit_s64(bc, 0);
+	emit_op(bc, FILTER_OP_GT);
+	emit_op(bc, FILTER_OP_RETURN);
+	return 0;
+}
+
+static const int64_t bench_set[] = { 1, 3, 5, 7, 11, 13, 17, BENCH_ID };
+
+/* "id == 1 || id == 3 || ...", the last term matching. */
+static
+int build_int_or_chain(struct bench_bytecode *bc)
+{
+	uint16_t or_pc[ARRAY_SIZE(bench_set) - 1];
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(bench_set); i++) {
+		emit_cmp_s64(bc, BENCH_FIELD_ID, FILTER_OP_EQ, bench_set[i]);
+		if (i < ARRAY_SIZE(or_pc))
+			or_pc[i] = emit_logical(bc, FILTER_OP_OR);
+	}
+	for (i = 0; i < ARRAY_SIZE(or_pc); i++)
+		patch_logical(bc, or_pc[i]);
+	emit_op(bc, FILTER_OP_RETURN);
+	return 0;
+}
+
+/* The same filter as build_int_or_chain, as a set membership test. */
+static
+int build_int_set(struct bench_bytecode *bc)
+{
+	struct set_op insn = {
+		.op = FILTER_OP_IN_S64_SET,
+		.nr_elem = ARRAY_SIZE(bench_set),
+		.len = ARRAY_SIZE(bench_set) * sizeof(struct literal_numeric),
+	};
+	unsigned int i;
+
+	emit_ref(bc, FILTER_OP_LOAD_FIELD_REF_S64, BENCH_FIELD_ID);
+	emit(bc, &insn, sizeof(insn));
+	for (i = 0; i < ARRAY_SIZE(bench_set); i++) {
+		struct literal_numeric lit = { .v = bench_set[i] };
+
+		emit(bc, &lit, sizeof(lit));
+	}
+	emit_op(bc, FILTER_OP_RETURN);
+	return 0;
+}
+
+/*
+ * "(id > 0 || len == 0) && (id > 1 || len == 1) && ... && name == "sched_*"",
+ * every conjunction evaluated.
+ */
+static
+int build_bool_tree(struct bench_bytecode *bc)
+{
+	uint16_t and_pc[8];
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(and_pc); i++) {
+		uint16_t or_pc;
+
+		emit_cmp_s64(bc, BENCH_FIELD_ID, FILTER_OP_GT, i);
+		or_pc = emit_logical(bc, FILTER_OP_OR);
+		emit_cmp_s64(bc, BENCH_FIELD_LEN, FILTER_OP_EQ, i);
+		patch_logical(bc, or_pc);
+		and_pc[i] = emit_logical(bc, FILTER_OP_AND);
+	}
+	emit_ref(bc, FILTER_OP_LOAD_FIELD_REF_STRING, BENCH_FIELD_NAME);
+	emit_string(bc, FILTER_OP_LOAD_STAR_GLOB_STRING, "sched_*");
+	emit_op(bc, FILTER_OP_EQ);
+	for (i = 0; i < ARRAY_SIZE(and_pc); i++)
+		patch_logical(bc, and_pc[i]);
+	emit_op(bc, FILTER_OP_RETURN);
+	return 0;
+}
+
+static const struct bench_case bench_corpus[] = {
+	{ "int_eq", build_int_eq, 1 },
+	{ "int_range", build_int_range, 1 },
+	{ "string_eq", build_string_eq, 1 },
+	{ "glob_prefix", build_glob_prefix, 1 },
+	{ "glob_infix", build_glob_infix, 1 },
+	{ "user_string_eq", build_user_string_eq, 1 },
+	{ "context_pid", build_context_pid, 1 },
+	{ "int_or_chain", build_int_or_chain, 1 },
+	{ "int_set", build_int_set, 1 },
+	{ "bool_tree", build_bool_tree, 1 },
+};
+
+/*
+ * Same steps as the link of a bytecode to an event, up to the execution
+ * mode.
+ */
+static
+struct bytecode_runtime *bench_runtime_create(const struct bench_bytecode *bc,
+		enum bench_mode mode)
+{
+	struct bytecode_runtime *runtime;
+	int ret;
+
+	runtime = kzalloc(sizeof(*runtime) + bc->len, GFP_KERNEL);
+	if (!runtime)
+		return ERR_PTR(-ENOMEM);
+	runtime->desc = &bench_desc;
+	runtime->len = bc->len;
+	memcpy(runtime->data, bc->data, bc->len);
+	ret = lttng_filter_validate_bytecode(runtime);
+	if (ret)
+		goto error;
+	ret = lttng_filter_specialize_bytecode(runtime);
+	if (ret)
+		goto error;
+	switch (mode) {
+	case BENCH_MODE_INTERPRETER:
+		runtime->p.filter = lttng_filter_interpret_bytecode;
+		break;
+	case BENCH_MODE_OPTIMIZED:
+		lttng_filter_optimize_bytecode(runtime);
+		runtime->p.filter = lttng_filter_interpret_bytecode;
+		break;
+	case BENCH_MODE_JIT:
+		ret = lttng_filter_jit_compile(runtime);
+		if (ret)
+			goto error;
+		runtime->p.filter = runtime->jit_code;
+		break;
+	default:
+		ret = -EINVAL;
+		goto error;
+	}
+	return runtime;
+
+error:
+	kfree(runtime);
+	return ERR_PTR(ret);
+}
+
+static
+void bench_runtime_destroy(struct bytecode_runtime *runtime)
+{
+	lttng_filter_jit_free(runtime);
+	kfree(runtime);
+}
+
+/* As seen from a probe: preemption off. */
+static
+long bench_evals(void *arg)
+{
+	struct bench_run *run = arg;
+	struct bytecode_runtime *runtime = run->runtime;
+	struct lttng_probe_ctx lttng_probe_ctx = {
+		.event = NULL,
+	};
+	uint64_t result = 0;
+	u64 start, end;
+	unsigned int i;
+
+	preempt_disable();
+	start = ktime_to_ns(ktime_get());
+	for (i = 0; i < nr_evals; i++)
+		result = runtime->p.filter(runtime, &lttng_probe_ctx,
+				run->stack_data);
+	end = ktime_to_ns(ktime_get());
+	preempt_enable();
+	run->result = result;
+	run->ns = end - start;
+	return 0;
+}
+
+static
+int bench_case_run(const struct bench_case *bcase, const char *stack_data)
+{
+	struct bench_bytecode *bc;
+	enum bench_mode mode;
+	int ret, cpu;
+
+	bc = kzalloc(sizeof(*bc), GFP_KERNEL);
+	if (!bc)
+		return -ENOMEM;
+	ret = bcase->build(bc);
+	if (ret)
+		goto end;
+	if (bc->overflow) {
+		ret = -EOVERFLOW;
+		goto end;
+	}
+	for (mode = 0; mode < NR_BENCH_MODES; mode++) {
+		struct bench_run run = {
+			.stack_data = stack_data,
+		};
+
+		run.runtime = bench_runtime_create(bc, mode);
+		if (IS_ERR(run.runtime)) {
+			ret = PTR_ERR(run.runtime);
+			/*
+			 * As on link, bytecode the JIT does not handle
+			 * stays on the interpreter.
+			 */
+			if (mode == BENCH_MODE_JIT) {
+				printk(KERN_INFO "LTTng: filter benchmark: "
+					"%s: not JIT-compiled (%d)\n",
+					bcase->name, ret);
+				ret = 0;
+				continue;
+			}
+			printk(KERN_WARNING "LTTng: filter benchmark: %s: "
+				"%s setup error %d\n",
+				bcase->name, bench_mode_names[mode], ret);
+			goto end;
+		}
+		get_online_cpus();
+		for_each_online_cpu(cpu) {
+			u64 ps;
+
+			work_on_cpu(cpu, bench_evals, &run);
+			if (run.result != bcase->expect) {
+				printk(KERN_WARNING "LTTng: filter benchmark: "
+					"%s: %s result %llu, expected %llu\n",
+					bcase->name, bench_mode_names[mode],
+					(unsigned long long) run.result,
+					(unsigned long long) bcase->expect);
+				ret = -EINVAL;
+				break;
+			}
+			ps = div_u64(run.ns * 1000, nr_evals);
+			printk(KERN_INFO "LTTng: filter benchmark: cpu %d: "
+				"%s: %s: %llu.%03llu ns per evaluation\n",
+				cpu, bcase->name, bench_mode_names[mode],
+				(unsigned long long) div_u64(ps, 1000),
+				(unsigned long long) (ps % 1000));
+		}
+		put_online_cpus();
+		bench_runtime_destroy(run.runtime);
+		if (ret)
+			goto end;
+	}
+end:
+	kfree(bc);
+	return ret;
+}
+
+static int __init lttng_filter_bench_init(void)
+{
+	char stack_data[BENCH_STACK_DATA_LEN] __aligned(sizeof(int64_t));
+	const char *name = BENCH_NAME, *path = BENCH_PATH;
+	int64_t id = BENCH_ID, len = BENCH_LEN;
+	unsigned int i;
+	int ret;
+
+	if (!nr_evals)
+		return -EINVAL;
+	memcpy(&stack_data[BENCH_FIELD_ID], &id, sizeof(id));
+	memcpy(&stack_data[BENCH_FIELD_LEN], &len, sizeof(len));
+	memcpy(&stack_data[BENCH_FIELD_NAME], &name, sizeof(name));
+	/* Read from user space by the interpreter, with KERNEL_DS. */
+	memcpy(&stack_data[BENCH_FIELD_PATH], &path, sizeof(path));
+	for (i = 0; i < ARRAY_SIZE(bench_corpus); i++) {
+		ret = bench_case_run(&bench_corpus[i], stack_data);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+module_init(lttng_filter_bench_init);
+
+static void __exit lttng_filter_bench_exit(void)
+{
+}
+
+module_exit(lttng_filter_bench_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng filter bytecode benchmark");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,212 @@
+/*
+ * lttng-nmi-bench.c
+ *
+ * LTTng NMI recording stress benchmark.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The session is set up from user space beforehand, with the client
+ * (discard or overwrite) under test and lttng_test_filter_event enabled.
+ * Loading this module hits the event from pinned kernel threads, while
+ * a cycles counter on each CPU hits it from its overflow handler, in
+ * NMI context on architectures with NMI-based PMU interrupts. The number
+ * of hits of each context is printed: without lost records, the trace
+ * holds all of them, the records of the overflow handler having an
+ * "intfield" of 0.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/hardirq.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/stringify.h>
+#include <linux/version.h>
+
+#include <lttng-events.h>
+#include <wrapper/perf.h>
+#include <wrapper/tracepoint.h>
+
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-module/lttng-test.h>
+
+static unsigned int nr_events = 1000000;
+module_param(nr_events, uint, 0444);
+MODULE_PARM_DESC(nr_events, "Number of events per thread");
+
+static unsigned long sample_period = 100000;
+module_param(sample_period, ulong, 0444);
+MODULE_PARM_DESC(sample_period, "Cycles between counter overflows");
+
+#define BENCH_BATCH		1024	/* Events between rescheduling points */
+
+#if defined(CONFIG_PERF_EVENTS) \
+	&& (LINUX_VERSION_CODE >= KERNEL_VERSION(3,1,0))
+
+struct bench_thread {
+	struct task_struct *task;
+	struct completion done;
+};
+
+static atomic_long_t nmi_hits, irq_hits;
+
+static
+void bench_hit(unsigned int seqnum)
+{
+	long values[] = { 1, 2, 3 };
+	char text[10] = "test";
+
+	trace_lttng_test_filter_event(seqnum, seqnum, values, text,
+		strlen(text), text);
+}
+
+static
+void bench_overflow(struct perf_event *pevent,
+		struct perf_sample_data *data, struct pt_regs *regs)
+{
+	if (in_nmi())
+		atomic_long_inc(&nmi_hits);
+	else
+		atomic_long_inc(&irq_hits);
+	bench_hit(0);
+}
+
+static
+int bench_thread_fn(void *data)
+{
+	struct bench_thread *thread = data;
+	unsigned int i;
+
+	for (i = 0; i < nr_events; i++) {
+		bench_hit(i + 1);
+		if (!(i % BENCH_BATCH))
+			cond_resched();
+	}
+	complete(&thread->done);
+	/* Wait for kthread_stop(). */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+static int __init lttng_nmi_bench_init(void)
+{
+	struct perf_event_attr attr;
+	struct perf_event **counters;
+	struct bench_thread *threads;
+	unsigned int i, nr = 0;
+	int cpu, ret = 0;
+
+	if (!nr_events || !sample_period)
+		return -EINVAL;
+	threads = kcalloc(nr_cpu_ids, sizeof(*threads), GFP_KERNEL);
+	counters = kcalloc(nr_cpu_ids, sizeof(*counters), GFP_KERNEL);
+	if (!threads || !counters) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.size = sizeof(attr);
+	attr.sample_period = sample_period;
+	attr.pinned = 1;
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		struct perf_event *pevent;
+
+		pevent = wrapper_perf_event_create_sampler(&attr, cpu,
+				bench_overflow, NULL);
+		if (!pevent || IS_ERR(pevent)) {
+			ret = -EINVAL;
+			break;
+		}
+		counters[cpu] = pevent;
+	}
+	for_each_online_cpu(cpu) {
+		struct bench_thread *thread = &threads[nr];
+
+		if (ret)
+			break;
+		init_completion(&thread->done);
+		thread->task = kthread_create(bench_thread_fn, thread,
+				"lttng-nmi-bench/%d", cpu);
+		if (IS_ERR(thread->task)) {
+			ret = PTR_ERR(thread->task);
+			break;
+		}
+		kthread_bind(thread->task, cpu);
+		nr++;
+	}
+	put_online_cpus();
+	for (i = 0; i < nr; i++)
+		wake_up_process(threads[i].task);
+	for (i = 0; i < nr; i++) {
+		wait_for_completion(&threads[i].done);
+		kthread_stop(threads[i].task);
+	}
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+		if (counters[cpu])
+			perf_event_release_kernel(counters[cpu]);
+	}
+	if (ret)
+		goto end;
+	printk(KERN_INFO "LTTng: NMI benchmark: %u threads, %u events per "
+		"thread, %ld hits from NMI, %ld hits from interrupts\n",
+		nr, nr_events, atomic_long_read(&nmi_hits),
+		atomic_long_read(&irq_hits));
+end:
+	kfree(counters);
+	kfree(threads);
+	return ret;
+}
+
+#else
+
+static int __init lttng_nmi_bench_init(void)
+{
+	return -ENOSYS;
+}
+
+#endif
+
+module_init(lttng_nmi_bench_init);
+
+static void __exit lttng_nmi_bench_exit(void)
+{
+}
+
+module_exit(lttng_nmi_bench_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng NMI recording stress benchmark");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
@@ -0,0 +1,228 @@
+/*
+ * lttng-ring-buffer-bench.c
+ *
+ * LTTng ring buffer stress benchmark.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * The session is set up from user space beforehand, with the client
+ * (discard or overwrite), output (splice or mmap) and sub-buffer size
+ * under test, and lttng_test_filter_event or lttng_test_payload_event
+ * enabled. Loading this module then hits the event from pinned kernel
+ * threads, and prints the throughput and the distribution of the probe
+ * latency, from the tracepoint call to the record commit. Lost records
+ * are those reported for the channel by the consumer.
+ */
+
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/ktime.h>
+#include <linux/kthread.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/stringify.h>
+
+#include <lttng-events.h>
+#include <wrapper/tracepoint.h>
+
+#define LTTNG_INSTRUMENTATION
+#include <instrumentation/events/lttng-module/lttng-test.h>
+
+static unsigned int nr_threads;
+module_param(nr_threads, uint, 0444);
+MODULE_PARM_DESC(nr_threads, "Number of pinned threads, 0 for one per online CPU");
+
+static unsigned int nr_events = 1000000;
+module_param(nr_events, uint, 0444);
+MODULE_PARM_DESC(nr_events, "Number of events per thread");
+
+static unsigned int payload_len;
+module_param(payload_len, uint, 0444);
+MODULE_PARM_DESC(payload_len, "Size of the lttng_test_payload_event payload, 0 to hit lttng_test_filter_event");
+
+#define BENCH_PAYLOAD_MAX	65536
+#define BENCH_HIST_BUCKETS	32	/* log2 of the latency in ns */
+#define BENCH_BATCH		1024	/* Events between rescheduling points */
+
+struct bench_thread {
+	struct task_struct *task;
+	struct completion done;
+	u64 duration_ns;
+	u64 histogram[BENCH_HIST_BUCKETS];
+};
+
+static char *bench_payload;
+
+static
+void bench_hit(unsigned int i)
+{
+	long values[] = { 1, 2, 3 };
+	char text[10] = "test";
+
+	if (payload_len)
+		trace_lttng_test_payload_event(bench_payload, payload_len);
+	else
+		trace_lttng_test_filter_event(i, i, values, text,
+			strlen(text), text);
+}
+
+/*
+ * A single clock read per event: each latency sample also covers the
+ * loop and the clock read itself.
+ */
+static
+int bench_thread_fn(void *data)
+{
+	struct bench_thread *thread = data;
+	u64 start, prev, now;
+	unsigned int i;
+
+	start = prev = ktime_to_ns(ktime_get());
+	for (i = 0; i < nr_events; i++) {
+		u64 delta;
+		unsigned int bucket;
+
+		bench_hit(i);
+		now = ktime_to_ns(ktime_get());
+		delta = now - prev;
+		bucket = delta ? ilog2(delta) : 0;
+		if (bucket >= BENCH_HIST_BUCKETS)
+			bucket = BENCH_HIST_BUCKETS - 1;
+		thread->histogram[bucket]++;
+		if (!(i % BENCH_BATCH)) {
+			cond_resched();
+			now = ktime_to_ns(ktime_get());
+		}
+		prev = now;
+	}
+	thread->duration_ns = prev - start;
+	complete(&thread->done);
+	/* Wait for kthread_stop(). */
+	set_current_state(TASK_INTERRUPTIBLE);
+	while (!kthread_should_stop()) {
+		schedule();
+		set_current_state(TASK_INTERRUPTIBLE);
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+/* Upper bound, in ns, of the latency of "permille" of the events. */
+static
+u64 bench_percentile(const u64 *histogram, u64 total, unsigned int permille)
+{
+	u64 count = 0;
+	unsigned int i;
+
+	for (i = 0; i < BENCH_HIST_BUCKETS; i++) {
+		count += histogram[i];
+		if (count * 1000 >= total * permille)
+			break;
+	}
+	return 2ULL << min_t(unsigned int, i, BENCH_HIST_BUCKETS - 1);
+}
+
+static int __init lttng_ring_buffer_bench_init(void)
+{
+	u64 histogram[BENCH_HIST_BUCKETS] = { 0 };
+	struct bench_thread *threads;
+	u64 total, duration_ns = 0;
+	unsigned int i, j, nr = 0;
+	int cpu, ret = 0;
+
+	if (!nr_threads)
+		nr_threads = num_online_cpus();
+	if (!nr_events || payload_len > BENCH_PAYLOAD_MAX)
+		return -EINVAL;
+	bench_payload = kmalloc(max_t(unsigned int, payload_len, 1), GFP_KERNEL);
+	threads = kcalloc(nr_threads, sizeof(*threads), GFP_KERNEL);
+	if (!bench_payload || !threads) {
+		ret = -ENOMEM;
+		goto end;
+	}
+	for (i = 0; i < payload_len; i++)
+		bench_payload[i] = (char) i;
+	cpu = cpumask_first(cpu_online_mask);
+	for (nr = 0; nr < nr_threads; nr++) {
+		struct bench_thread *thread = &threads[nr];
+
+		init_completion(&thread->done);
+		thread->task = kthread_create(bench_thread_fn, thread,
+				"lttng-rb-bench/%u", nr);
+		if (IS_ERR(thread->task)) {
+			ret = PTR_ERR(thread->task);
+			break;
+		}
+		/* Threads beyond the number of CPUs share them. */
+		kthread_bind(thread->task, cpu);
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+	for (i = 0; i < nr; i++)
+		wake_up_process(threads[i].task);
+	for (i = 0; i < nr; i++) {
+		wait_for_completion(&threads[i].done);
+		kthread_stop(threads[i].task);
+		duration_ns = max(duration_ns, threads[i].duration_ns);
+		for (j = 0; j < BENCH_HIST_BUCKETS; j++)
+			histogram[j] += threads[i].histogram[j];
+	}
+	if (ret)
+		goto end;
+	total = (u64) nr * nr_events;
+	printk(KERN_INFO "LTTng: ring buffer benchmark: %u threads, %u events "
+		"per thread, %s (%u bytes payload): %llu events/s, latency "
+		"p50 < %llu ns, p90 < %llu ns, p99 < %llu ns, p99.9 < %llu ns\n",
+		nr, nr_events,
+		payload_len ? "lttng_test_payload_event" : "lttng_test_filter_event",
+		payload_len,
+		(unsigned long long) div64_u64(total * NSEC_PER_SEC,
+			max_t(u64, duration_ns, 1)),
+		(unsigned long long) bench_percentile(histogram, total, 500),
+		(unsigned long long) bench_percentile(histogram, total, 900),
+		(unsigned long long) bench_percentile(histogram, total, 990),
+		(unsigned long long) bench_percentile(histogram, total, 999));
+end:
+	kfree(threads);
+	kfree(bench_payload);
+	return ret;
+}
+
+module_init(lttng_ring_buffer_bench_init);
+
+static void __exit lttng_ring_buffer_bench_exit(void)
+{
+}
+
+module_exit(lttng_ring_buffer_bench_exit);
+
+MODULE_LICENSE("GPL and additional rights");
+MODULE_AUTHOR("agent <agent@local>");
+MODULE_DESCRIPTION("LTTng ring buffer stress benchmark");
+MODULE_VERSION(__stringify(LTTNG_MODULES_MAJOR_VERSION) "."
+	__stringify(LTTNG_MODULES_MINOR_VERSION) "."
+	__stringify(LTTNG_MODULES_PATCHLEVEL_VERSION)
+	LTTNG_MODULES_EXTRAVERSION);
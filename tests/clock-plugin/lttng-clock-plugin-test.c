@@ -60,6 +60,7 @@ struct lttng_trace_clock ltc = {
 	.uuid = trace_clock_uuid_example,
 	.name = trace_clock_name_example,
 	.description = trace_clock_description_example,
+	.nmi_safe = 1,
 };
 
 static __init
@@ -39,6 +39,11 @@
 #include <instrumentation/events/lttng-module/lttng-test.h>
 
 DEFINE_TRACE(lttng_test_filter_event);
+DEFINE_TRACE(lttng_test_payload_event);
+
+/* Hit by the benchmark modules. */
+EXPORT_TRACEPOINT_SYMBOL_GPL(lttng_test_filter_event);
+EXPORT_TRACEPOINT_SYMBOL_GPL(lttng_test_payload_event);
 
 #define LTTNG_TEST_FILTER_EVENT_FILE	"lttng-test-filter-event"
 
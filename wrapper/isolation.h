@@ -0,0 +1,78 @@
+#ifndef _LTTNG_WRAPPER_ISOLATION_H
+#define _LTTNG_WRAPPER_ISOLATION_H
+
+/*
+ * wrapper/isolation.h
+ *
+ * wrapper around nohz_full CPU isolation and housekeeping CPU selection.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/version.h>
+#include <linux/cpumask.h>
+#include <linux/smp.h>
+#include <linux/tick.h>
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,15,0))
+#include <linux/sched/isolation.h>
+#endif
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0))
+
+static inline
+bool lttng_cpu_is_isolated(int cpu)
+{
+	return tick_nohz_full_cpu(cpu);
+}
+
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0)) */
+
+static inline
+bool lttng_cpu_is_isolated(int cpu)
+{
+	return false;
+}
+
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0)) */
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,15,0))
+
+static inline
+int lttng_housekeeping_any_cpu(void)
+{
+	return housekeeping_any_cpu(HK_FLAG_TIMER);
+}
+
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,15,0)) */
+
+/*
+ * The housekeeping mask is not exported to modules on older kernels: use
+ * the current cpu unless it is isolated, else the first online cpu, which
+ * handles timekeeping when nohz_full is enabled.
+ */
+static inline
+int lttng_housekeeping_any_cpu(void)
+{
+	int cpu = raw_smp_processor_id();
+
+	if (!lttng_cpu_is_isolated(cpu))
+		return cpu;
+	return cpumask_first(cpu_online_mask);
+}
+
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,15,0)) */
+
+#endif /* _LTTNG_WRAPPER_ISOLATION_H */
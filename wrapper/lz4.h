@@ -0,0 +1,79 @@
+#ifndef _LTTNG_WRAPPER_LZ4_H
+#define _LTTNG_WRAPPER_LZ4_H
+
+/*
+ * wrapper/lz4.h
+ *
+ * wrapper around the kernel LZ4 compressor, whose API changed in 4.11.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/version.h>
+
+#if defined(CONFIG_LZ4_COMPRESS) || defined(CONFIG_LZ4_COMPRESS_MODULE)
+
+#include <linux/lz4.h>
+
+#define LTTNG_HAVE_LZ4
+#define LTTNG_LZ4_MEM_COMPRESS	LZ4_MEM_COMPRESS
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0))
+
+static inline
+size_t lttng_lz4_compress_bound(size_t len)
+{
+	return LZ4_compressBound(len);
+}
+
+/*
+ * Returns 0 on success and updates *dst_len with the compressed size,
+ * else returns a negative error value.
+ */
+static inline
+int lttng_lz4_compress(const void *src, size_t src_len,
+		void *dst, size_t *dst_len, void *wrkmem)
+{
+	int ret;
+
+	ret = LZ4_compress_default(src, dst, src_len, *dst_len, wrkmem);
+	if (ret <= 0)
+		return -ENOSPC;
+	*dst_len = ret;
+	return 0;
+}
+
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0)) */
+
+static inline
+size_t lttng_lz4_compress_bound(size_t len)
+{
+	return lz4_compressbound(len);
+}
+
+static inline
+int lttng_lz4_compress(const void *src, size_t src_len,
+		void *dst, size_t *dst_len, void *wrkmem)
+{
+	if (lz4_compress(src, src_len, dst, dst_len, wrkmem))
+		return -ENOSPC;
+	return 0;
+}
+
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,11,0)) */
+
+#endif /* #if defined(CONFIG_LZ4_COMPRESS) || defined(CONFIG_LZ4_COMPRESS_MODULE) */
+
+#endif /* _LTTNG_WRAPPER_LZ4_H */
@@ -0,0 +1,92 @@
+#ifndef _LTTNG_WRAPPER_MODULE_H
+#define _LTTNG_WRAPPER_MODULE_H
+
+/*
+ * wrapper/module.h
+ *
+ * wrapper around the layout of loaded modules, their list and the
+ * kernel symbol table iteration.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/kallsyms.h>
+
+/* Address and size of the module core text and data. */
+static inline
+unsigned long lttng_module_core_base(struct module *mod)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,5,0))
+	return (unsigned long) mod->core_layout.base;
+#else
+	return (unsigned long) mod->module_core;
+#endif
+}
+
+static inline
+unsigned long lttng_module_core_size(struct module *mod)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,5,0))
+	return mod->core_layout.size;
+#else
+	return mod->core_size;
+#endif
+}
+
+/* kallsyms_on_each_symbol() is not exported from 5.12 on. */
+#if defined(CONFIG_KALLSYMS) \
+	&& (LINUX_VERSION_CODE < KERNEL_VERSION(5,12,0))
+#define LTTNG_HAVE_KALLSYMS_ON_EACH_SYMBOL
+
+static inline
+int wrapper_kallsyms_on_each_symbol(int (*fn)(void *, const char *,
+		struct module *, unsigned long), void *data)
+{
+	return kallsyms_on_each_symbol(fn, data);
+}
+#endif
+
+/* List of the loaded modules, not exported, walked with RCU. */
+#ifdef CONFIG_KALLSYMS_ALL
+
+#include <wrapper/kallsyms.h>
+
+static inline
+struct list_head *wrapper_get_modules_list(void)
+{
+	struct list_head *ptr_modules;
+
+	ptr_modules = (struct list_head *) kallsyms_lookup_dataptr("modules");
+	if (!ptr_modules) {
+		printk_once(KERN_WARNING "LTTng: modules symbol lookup failed.\n");
+		return NULL;
+	}
+	return ptr_modules;
+}
+
+#else
+
+static inline
+struct list_head *wrapper_get_modules_list(void)
+{
+	/* Feature currently unavailable without KALLSYMS_ALL */
+	return NULL;
+}
+
+#endif
+
+#endif /* _LTTNG_WRAPPER_MODULE_H */
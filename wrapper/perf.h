@@ -34,6 +34,17 @@ wrapper_perf_event_create_kernel_counter(struct perf_event_attr *attr,
 {
 	return perf_event_create_kernel_counter(attr, cpu, task, callback, NULL);
 }
+
+/* Per-cpu counter with "context" as overflow_handler_context. */
+static inline struct perf_event *
+wrapper_perf_event_create_sampler(struct perf_event_attr *attr,
+				int cpu,
+				perf_overflow_handler_t callback,
+				void *context)
+{
+	return perf_event_create_kernel_counter(attr, cpu, NULL, callback,
+			context);
+}
 #else /* (LINUX_VERSION_CODE >= KERNEL_VERSION(3,1,0)) */
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,37))
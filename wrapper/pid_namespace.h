@@ -0,0 +1,82 @@
+#ifndef _LTTNG_WRAPPER_PID_NAMESPACE_H
+#define _LTTNG_WRAPPER_PID_NAMESPACE_H
+
+/*
+ * wrapper/pid_namespace.h
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/version.h>
+#include <linux/pid_namespace.h>
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,8,0))
+
+#define LTTNG_HAVE_PID_NS_INUM
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,19,0))
+static inline
+unsigned int lttng_pid_ns_inum(struct pid_namespace *ns)
+{
+	return ns->ns.inum;
+}
+#else
+static inline
+unsigned int lttng_pid_ns_inum(struct pid_namespace *ns)
+{
+	return ns->proc_inum;
+}
+#endif
+
+/*
+ * Inode number of the PID namespace of a task, as shown by
+ * /proc/<pid>/ns/pid. Returns 0 while the task is being reaped. Called
+ * with RCU read-side lock held for tasks other than current.
+ */
+static inline
+unsigned int lttng_task_pid_ns_inum(struct task_struct *t)
+{
+	struct pid_namespace *ns = task_active_pid_ns(t);
+
+	if (!ns)
+		return 0;
+	return lttng_pid_ns_inum(ns);
+}
+
+static inline
+unsigned int lttng_current_pid_ns_inum(void)
+{
+	return lttng_task_pid_ns_inum(current);
+}
+
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,8,0)) */
+
+static inline
+unsigned int lttng_task_pid_ns_inum(struct task_struct *t)
+{
+	return 0;
+}
+
+static inline
+unsigned int lttng_current_pid_ns_inum(void)
+{
+	return 0;
+}
+
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,8,0)) */
+
+#endif /* _LTTNG_WRAPPER_PID_NAMESPACE_H */
@@ -21,13 +21,36 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <linux/version.h>
 #include <linux/poll.h>
+#include <linux/wait.h>
 
 /*
- * Note: poll_wait_set_exclusive() is defined as no-op. Thundering herd
- * effect can be noticed with large number of consumer threads.
+ * Note: poll_wait_set_exclusive() is defined as no-op. poll() cannot
+ * register exclusive waiters from a driver. Since Linux 4.5, consumer
+ * thread pools can avoid the thundering herd effect by registering the
+ * stream file descriptors with EPOLLEXCLUSIVE: the ring buffer wakeups use
+ * wake_up_interruptible(), which wakes a single exclusive waiter.
  */
 
 #define poll_wait_set_exclusive(poll_table)
 
+/*
+ * Detach epoll waiters from a wait queue about to be freed, as the file
+ * they poll outlives it.
+ */
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,16,0))
+static inline
+void lttng_wake_up_pollfree(wait_queue_head_t *wq)
+{
+	wake_up_pollfree(wq);
+}
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,16,0)) */
+static inline
+void lttng_wake_up_pollfree(wait_queue_head_t *wq)
+{
+	wake_up_poll(wq, POLLHUP | POLLFREE);
+}
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,16,0)) */
+
 #endif /* _LTTNG_WRAPPER_POLL_H */
@@ -0,0 +1,89 @@
+#ifndef _LTTNG_WRAPPER_PVCLOCK_H
+#define _LTTNG_WRAPPER_PVCLOCK_H
+
+/*
+ * wrapper/pvclock.h
+ *
+ * wrapper around the paravirtualized clock parameters of KVM guests.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/version.h>
+#include <linux/types.h>
+#include <linux/errno.h>
+#include <linux/compiler.h>
+
+/*
+ * Parameters converting the guest TSC to the host-provided time:
+ * system_time + ((tsc - tsc_timestamp) << tsc_shift) * tsc_to_system_mul
+ * >> 32, with a negative tsc_shift shifting right.
+ */
+struct lttng_pvclock_params {
+	uint64_t tsc_timestamp;
+	uint64_t system_time;
+	uint32_t tsc_to_system_mul;
+	int8_t tsc_shift;
+	uint8_t flags;
+};
+
+#if defined(CONFIG_PARAVIRT_CLOCK) \
+	&& (LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0))
+
+#include <asm/pvclock.h>
+
+/*
+ * The parameters of CPU 0, which all CPUs share when
+ * PVCLOCK_TSC_STABLE_BIT is set in the flags. Returns -ENOENT unless
+ * running as a guest with a stable paravirtualized clock. Can be called
+ * from any context.
+ */
+static inline
+int lttng_pvclock_read(struct lttng_pvclock_params *params)
+{
+	struct pvclock_vsyscall_time_info *pvti;
+	const struct pvclock_vcpu_time_info *src;
+	u32 version;
+
+	pvti = pvclock_get_pvti_cpu0_va();
+	if (!pvti)
+		return -ENOENT;
+	src = &pvti->pvti;
+	do {
+		version = ACCESS_ONCE(src->version);
+		smp_rmb();	/* Version before parameters */
+		params->tsc_timestamp = src->tsc_timestamp;
+		params->system_time = src->system_time;
+		params->tsc_to_system_mul = src->tsc_to_system_mul;
+		params->tsc_shift = src->tsc_shift;
+		params->flags = src->flags;
+		smp_rmb();	/* Parameters before version */
+	} while ((version & 1) || version != ACCESS_ONCE(src->version));
+	return 0;
+}
+
+#else
+
+static inline
+int lttng_pvclock_read(struct lttng_pvclock_params *params)
+{
+	return -ENOENT;
+}
+
+#endif
+
+#endif /* _LTTNG_WRAPPER_PVCLOCK_H */
@@ -0,0 +1 @@
+#include <lib/ringbuffer/crash.h>
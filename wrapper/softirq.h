@@ -0,0 +1,80 @@
+#ifndef _LTTNG_WRAPPER_SOFTIRQ_H
+#define _LTTNG_WRAPPER_SOFTIRQ_H
+
+/*
+ * wrapper/softirq.h
+ *
+ * wrapper around the softirq vector tables, which are not exported.
+ * Using KALLSYMS to get their address when available.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/interrupt.h>
+
+#ifdef CONFIG_KALLSYMS_ALL
+
+#include <linux/kallsyms.h>
+#include <wrapper/kallsyms.h>
+
+static inline
+const char * const *wrapper_get_softirq_to_name(void)
+{
+	const char * const *ptr_softirq_to_name;
+
+	ptr_softirq_to_name = (const char * const *)
+		kallsyms_lookup_dataptr("softirq_to_name");
+	if (!ptr_softirq_to_name) {
+		printk_once(KERN_WARNING "LTTng: softirq_to_name symbol lookup failed.\n");
+		return NULL;
+	}
+	return ptr_softirq_to_name;
+}
+
+static inline
+struct softirq_action *wrapper_get_softirq_vec(void)
+{
+	struct softirq_action *ptr_softirq_vec;
+
+	ptr_softirq_vec = (struct softirq_action *)
+		kallsyms_lookup_dataptr("softirq_vec");
+	if (!ptr_softirq_vec) {
+		printk_once(KERN_WARNING "LTTng: softirq_vec symbol lookup failed.\n");
+		return NULL;
+	}
+	return ptr_softirq_vec;
+}
+
+#else
+
+static inline
+const char * const *wrapper_get_softirq_to_name(void)
+{
+	/* Feature currently unavailable without KALLSYMS_ALL */
+	return NULL;
+}
+
+static inline
+struct softirq_action *wrapper_get_softirq_vec(void)
+{
+	/* Feature currently unavailable without KALLSYMS_ALL */
+	return NULL;
+}
+
+#endif
+
+#endif /* _LTTNG_WRAPPER_SOFTIRQ_H */
@@ -26,6 +26,8 @@
  */
 
 #include <linux/splice.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/version.h>
 
 ssize_t wrapper_splice_to_pipe(struct pipe_inode_info *pipe,
 			       struct splice_pipe_desc *spd);
@@ -34,4 +36,35 @@ ssize_t wrapper_splice_to_pipe(struct pipe_inode_info *pipe,
 #define PIPE_DEF_BUFFERS 16
 #endif
 
+/*
+ * Number of free pipe slots. Only a lower bound without the pipe lock:
+ * the pipe reader can free slots concurrently.
+ */
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,5,0))
+static inline
+unsigned int wrapper_pipe_free_slots(struct pipe_inode_info *pipe)
+{
+	unsigned int used = pipe_occupancy(READ_ONCE(pipe->head),
+					   READ_ONCE(pipe->tail));
+
+	return used < pipe->max_usage ? pipe->max_usage - used : 0;
+}
+#elif (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35))
+static inline
+unsigned int wrapper_pipe_free_slots(struct pipe_inode_info *pipe)
+{
+	unsigned int used = ACCESS_ONCE(pipe->nrbufs);
+
+	return used < pipe->buffers ? pipe->buffers - used : 0;
+}
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35)) */
+static inline
+unsigned int wrapper_pipe_free_slots(struct pipe_inode_info *pipe)
+{
+	unsigned int used = ACCESS_ONCE(pipe->nrbufs);
+
+	return used < PIPE_BUFFERS ? PIPE_BUFFERS - used : 0;
+}
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35)) */
+
 #endif /* _LTTNG_WRAPPER_SPLICE_H */
@@ -0,0 +1,62 @@
+#ifndef _LTTNG_WRAPPER_STACKTRACE_H
+#define _LTTNG_WRAPPER_STACKTRACE_H
+
+/*
+ * wrapper/stacktrace.h
+ *
+ * wrapper around kernel stack trace capture.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/version.h>
+#include <linux/kernel.h>
+#include <linux/stacktrace.h>
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0))
+
+static inline
+unsigned int lttng_stack_trace_save(unsigned long *entries,
+		unsigned int max_entries, unsigned int skip)
+{
+	return stack_trace_save(entries, max_entries, skip);
+}
+
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0)) */
+
+/*
+ * Some architectures end the trace with a ULONG_MAX entry when it
+ * fits: it is not a frame.
+ */
+static inline
+unsigned int lttng_stack_trace_save(unsigned long *entries,
+		unsigned int max_entries, unsigned int skip)
+{
+	struct stack_trace trace = {
+		.nr_entries = 0,
+		.max_entries = max_entries,
+		.entries = entries,
+		.skip = skip,
+	};
+
+	save_stack_trace(&trace);
+	if (trace.nr_entries && entries[trace.nr_entries - 1] == ULONG_MAX)
+		trace.nr_entries--;
+	return trace.nr_entries;
+}
+
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0)) */
+
+#endif /* _LTTNG_WRAPPER_STACKTRACE_H */
@@ -0,0 +1,62 @@
+#ifndef _LTTNG_WRAPPER_SWAP_H
+#define _LTTNG_WRAPPER_SWAP_H
+
+/*
+ * wrapper/swap.h
+ *
+ * wrapper around the swap area table and its lock, which are not
+ * exported. Using KALLSYMS to get their address when available.
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/swap.h>
+#include <linux/spinlock.h>
+
+#if defined(CONFIG_SWAP) && defined(CONFIG_KALLSYMS_ALL)
+
+#include <linux/kallsyms.h>
+#include <wrapper/kallsyms.h>
+
+/* Table of MAX_SWAPFILES entries, protected by the lock. */
+static inline
+struct swap_info_struct **wrapper_get_swap_info(spinlock_t **lock)
+{
+	struct swap_info_struct **ptr_swap_info;
+
+	ptr_swap_info = (struct swap_info_struct **)
+		kallsyms_lookup_dataptr("swap_info");
+	*lock = (spinlock_t *) kallsyms_lookup_dataptr("swap_lock");
+	if (!ptr_swap_info || !*lock) {
+		printk_once(KERN_WARNING "LTTng: swap_info symbol lookup failed.\n");
+		return NULL;
+	}
+	return ptr_swap_info;
+}
+
+#else
+
+static inline
+struct swap_info_struct **wrapper_get_swap_info(spinlock_t **lock)
+{
+	/* Feature currently unavailable without SWAP and KALLSYMS_ALL */
+	return NULL;
+}
+
+#endif
+
+#endif /* _LTTNG_WRAPPER_SWAP_H */
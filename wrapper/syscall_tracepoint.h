@@ -0,0 +1,50 @@
+#ifndef _LTTNG_WRAPPER_SYSCALL_TRACEPOINT_H
+#define _LTTNG_WRAPPER_SYSCALL_TRACEPOINT_H
+
+/*
+ * wrapper/syscall_tracepoint.h
+ *
+ * wrapper around the per-task flag sending the system calls of a task
+ * through the sys_enter and sys_exit tracepoints.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/version.h>
+#include <linux/sched.h>
+#include <linux/thread_info.h>
+
+#if defined(CONFIG_GENERIC_ENTRY) \
+	&& (LINUX_VERSION_CODE >= KERNEL_VERSION(5,11,0))
+static inline
+void lttng_task_syscall_tracepoint_set(struct task_struct *t, bool traced)
+{
+	if (traced)
+		set_task_syscall_work(t, SYSCALL_TRACEPOINT);
+	else
+		clear_task_syscall_work(t, SYSCALL_TRACEPOINT);
+}
+#else
+static inline
+void lttng_task_syscall_tracepoint_set(struct task_struct *t, bool traced)
+{
+	if (traced)
+		set_tsk_thread_flag(t, TIF_SYSCALL_TRACEPOINT);
+	else
+		clear_tsk_thread_flag(t, TIF_SYSCALL_TRACEPOINT);
+}
+#endif
+
+#endif /* _LTTNG_WRAPPER_SYSCALL_TRACEPOINT_H */
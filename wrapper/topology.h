@@ -0,0 +1,61 @@
+#ifndef _LTTNG_WRAPPER_TOPOLOGY_H
+#define _LTTNG_WRAPPER_TOPOLOGY_H
+
+/*
+ * wrapper/topology.h
+ *
+ * wrapper around the cpu topology masks: SMT siblings and cpus sharing
+ * the last-level cache.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/version.h>
+#include <linux/cpumask.h>
+#include <linux/topology.h>
+
+#ifdef CONFIG_X86
+#include <asm/smp.h>
+#endif
+
+/*
+ * The masks are only meaningful for online cpus: the architecture
+ * clears them when a cpu goes offline.
+ */
+static inline
+const struct cpumask *lttng_topology_smt_cpumask(int cpu)
+{
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,2,0))
+	return topology_sibling_cpumask(cpu);
+#else
+	return topology_thread_cpumask(cpu);
+#endif
+}
+
+/*
+ * Architectures other than x86 do not expose the last-level cache
+ * sharing to modules: fall back on the cpus of the same package.
+ */
+static inline
+const struct cpumask *lttng_topology_llc_cpumask(int cpu)
+{
+#ifdef CONFIG_X86
+	return cpu_llc_shared_mask(cpu);
+#else
+	return topology_core_cpumask(cpu);
+#endif
+}
+
+#endif /* _LTTNG_WRAPPER_TOPOLOGY_H */
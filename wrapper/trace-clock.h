@@ -47,6 +47,29 @@
 
 extern struct lttng_trace_clock *lttng_trace_clock;
 
+/*
+ * The static key is enabled while a clock plugin is registered, so the
+ * monotonic clock is read without loading the plugin pointer. Kernels
+ * without the static branch interface check the pointer on each read.
+ */
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0))
+#include <linux/jump_label.h>
+
+#define LTTNG_TRACE_CLOCK_STATIC_KEY
+
+DECLARE_STATIC_KEY_FALSE(lttng_trace_clock_plugin);
+
+static inline bool lttng_trace_clock_plugin_enabled(void)
+{
+	return static_branch_unlikely(&lttng_trace_clock_plugin);
+}
+#else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)) */
+static inline bool lttng_trace_clock_plugin_enabled(void)
+{
+	return true;
+}
+#endif /* #else #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4,3,0)) */
+
 /*
  * Upstream Linux commit 27727df240c7 ("Avoid taking lock in NMI path with
  * CONFIG_DEBUG_TIMEKEEPING") introduces a buggy ktime_get_mono_fast_ns().
@@ -174,22 +197,36 @@ static inline void put_trace_clock(void)
 {
 }
 
+/*
+ * The plugin pointer is still checked once the static key is enabled: it
+ * is cleared after the key is disabled, so a reader may observe the key
+ * enabled and the pointer cleared.
+ */
 static inline u64 trace_clock_read64(void)
 {
-	struct lttng_trace_clock *ltc = ACCESS_ONCE(lttng_trace_clock);
+	struct lttng_trace_clock *ltc;
 
+	if (!lttng_trace_clock_plugin_enabled())
+		return trace_clock_read64_monotonic();
+	ltc = ACCESS_ONCE(lttng_trace_clock);
 	if (likely(!ltc)) {
 		return trace_clock_read64_monotonic();
 	} else {
 		read_barrier_depends();	/* load ltc before content */
+		/* Same as the monotonic clock without NMI-safe reads. */
+		if (unlikely(!ltc->nmi_safe) && in_nmi())
+			return (u64) -EIO;
 		return ltc->read64();
 	}
 }
 
 static inline u64 trace_clock_freq(void)
 {
-	struct lttng_trace_clock *ltc = ACCESS_ONCE(lttng_trace_clock);
+	struct lttng_trace_clock *ltc;
 
+	if (!lttng_trace_clock_plugin_enabled())
+		return trace_clock_freq_monotonic();
+	ltc = ACCESS_ONCE(lttng_trace_clock);
 	if (!ltc) {
 		return trace_clock_freq_monotonic();
 	} else {
@@ -46,12 +46,24 @@
 
 #define lttng_wrapper_tracepoint_probe_register lttng_tracepoint_probe_register
 #define lttng_wrapper_tracepoint_probe_unregister lttng_tracepoint_probe_unregister
+#define lttng_wrapper_tracepoint_batch_begin lttng_tracepoint_batch_begin
+#define lttng_wrapper_tracepoint_batch_end lttng_tracepoint_batch_end
 
 #else /* #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3,15,0)) */
 
 #define lttng_wrapper_tracepoint_probe_register kabi_2635_tracepoint_probe_register
 #define lttng_wrapper_tracepoint_probe_unregister kabi_2635_tracepoint_probe_unregister
 
+static inline
+void lttng_wrapper_tracepoint_batch_begin(void)
+{
+}
+
+static inline
+void lttng_wrapper_tracepoint_batch_end(void)
+{
+}
+
 static inline
 int lttng_tracepoint_init(void)
 {
@@ -0,0 +1,41 @@
+#ifndef _LTTNG_WRAPPER_UACCESS_H
+#define _LTTNG_WRAPPER_UACCESS_H
+
+/*
+ * wrapper/uaccess.h
+ *
+ * Copyright (C) 2026 agent <agent@local>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; only
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <linux/version.h>
+#include <linux/uaccess.h>
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,8,0))
+static inline
+long lttng_copy_from_kernel_nofault(void *dst, const void *src, size_t size)
+{
+	return copy_from_kernel_nofault(dst, src, size);
+}
+#else
+static inline
+long lttng_copy_from_kernel_nofault(void *dst, const void *src, size_t size)
+{
+	return probe_kernel_read(dst, (void *) src, size);
+}
+#endif
+
+#endif /* _LTTNG_WRAPPER_UACCESS_H */